@@ -0,0 +1,169 @@
+/*******************************************************************************
+ * @brief       Broadphase benchmark.
+ * @file        Main.cpp
+ * @author      Wynand Marais
+ * @copyright   WM Software Product License
+ * @details     Compare the AABBTree and SweepAndPrune broadphases on a crowd of
+ *              units moving on a flat map, i.e. an RTS battle. Every tick all
+ *              the units move and the overlapping pairs are found. The unit
+ *              counts can be passed on the command line, e.g.
+ *              "AnubisBenchmark_Broadphase 1000 4000 16000".
+ ******************************************************************************/
+#include "../../Include/Anubis/Common.hpp"
+#include "../../Include/Anubis/Physics.hpp"
+
+#include <chrono>
+#include <random>
+
+using namespace Anubis;
+using namespace Anubis::Physics;
+
+/* The number of ticks to simulate per run. */
+#define kTICK_COUNT     200
+
+/* The map area per unit, keeps the density the same for all unit counts. */
+#define kAREA_PER_UNIT  25.0f
+
+/* The distance a unit moves per tick. */
+#define kUNIT_SPEED     0.2f
+
+/* The half size of a unit's box on the ground plane. */
+#define kUNIT_RADIUS    0.5f
+
+/* The height of a unit's box. */
+#define kUNIT_HEIGHT    2.0f
+
+/******************************************************************************/
+/* A unit walking on the map. */
+struct Unit
+{
+  float fX, fZ, fVelX, fVelZ;
+  int32_t fProxy;
+};
+
+/******************************************************************************/
+/* Return the box of a unit. */
+AABB unitBox(const Unit & unit)
+{
+  return AABB(Math::Vector4f(unit.fX - kUNIT_RADIUS, 0.0f,
+                             unit.fZ - kUNIT_RADIUS, 1.0f),
+              Math::Vector4f(unit.fX + kUNIT_RADIUS, kUNIT_HEIGHT,
+                             unit.fZ + kUNIT_RADIUS, 1.0f));
+}
+
+/******************************************************************************/
+/* Run the crowd simulation on the broadphase and return the average time per
+ * tick in micro seconds. The number of pairs found is returned so that the
+ * two broadphases can be checked against each other. */
+template <typename BroadphaseType>
+double runCrowd(BroadphaseType & broadphase, size_t unitCount,
+                uint64_t & pairCount)
+{
+  /* Place the units randomly on a square map. */
+  std::mt19937 rng(42);
+  const float mapSize = std::sqrt(float(unitCount) * kAREA_PER_UNIT);
+  std::uniform_real_distribution<float> pos(0.0f, mapSize);
+  std::uniform_real_distribution<float> angle(0.0f,
+    Math::Constants::twoPi<float>());
+
+  std::vector<Unit> units(unitCount);
+  for(Unit & unit : units)
+  {
+    float a = angle(rng);
+    unit.fX = pos(rng);
+    unit.fZ = pos(rng);
+    unit.fVelX = std::cos(a) * kUNIT_SPEED;
+    unit.fVelZ = std::sin(a) * kUNIT_SPEED;
+    unit.fProxy = broadphase.insert(unitBox(unit), &unit);
+  }
+
+  /* Simulate the ticks. */
+  pairCount = 0;
+  auto start = std::chrono::steady_clock::now();
+  for(size_t tick = 0; tick < kTICK_COUNT; tick++)
+  {
+    /* Move the units, bouncing off the edges of the map. */
+    for(Unit & unit : units)
+    {
+      if(unit.fX + unit.fVelX < 0.0f || unit.fX + unit.fVelX > mapSize)
+      {
+        unit.fVelX = -unit.fVelX;
+      }
+
+      if(unit.fZ + unit.fVelZ < 0.0f || unit.fZ + unit.fVelZ > mapSize)
+      {
+        unit.fVelZ = -unit.fVelZ;
+      }
+
+      unit.fX += unit.fVelX;
+      unit.fZ += unit.fVelZ;
+      broadphase.move(unit.fProxy, unitBox(unit),
+                      Math::Vector4f(unit.fVelX, 0.0f, unit.fVelZ, 0.0f));
+    }
+
+    /* Find the candidate pairs, only the tight overlaps are counted so that
+     * the fat boxes of the tree do not skew the numbers. */
+    broadphase.queryPairs([&](int32_t proxyA, int32_t proxyB)
+    {
+      const Unit * a = static_cast<const Unit*>(broadphase.getUserData(proxyA));
+      const Unit * b = static_cast<const Unit*>(broadphase.getUserData(proxyB));
+      if(unitBox(*a).overlaps(unitBox(*b)))
+      {
+        ++pairCount;
+      }
+    });
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  /* Return the average time per tick. */
+  return std::chrono::duration<double, std::micro>(end - start).count() /
+         kTICK_COUNT;
+}
+
+/******************************************************************************/
+int main(int argc, char * argv[])
+{
+  /* Read the unit counts from the command line. */
+  std::vector<size_t> unitCounts;
+  for(int i = 1; i < argc; i++)
+  {
+    unitCounts.push_back(size_t(std::strtoul(argv[i], nullptr, 10)));
+  }
+
+  if(unitCounts.empty())
+  {
+    unitCounts = {500, 1000, 2000, 4000, 8000, 16000};
+  }
+
+  /* Print the header of the results table. */
+  std::cout << std::setw(8) << "Units" << std::setw(16) << "AABBTree (us)"
+            << std::setw(16) << "SAP (us)" << std::setw(12) << "Speedup"
+            << std::setw(12) << "Pairs" << std::endl;
+
+  for(size_t unitCount : unitCounts)
+  {
+    /* Run the same crowd on both broadphases. */
+    uint64_t treePairs = 0, sapPairs = 0;
+    AABBTree tree;
+    double treeTime = runCrowd(tree, unitCount, treePairs);
+
+    SweepAndPrune sap(SweepAndPrune::Axes::X);
+    sap.reserve(unitCount);
+    double sapTime = runCrowd(sap, unitCount, sapPairs);
+
+    /* Both broadphases must find the same pairs. */
+    if(treePairs != sapPairs)
+    {
+      std::cerr << "Pair count mismatch: " << treePairs << " != " << sapPairs
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    std::cout << std::setw(8) << unitCount << std::setw(16) << std::fixed
+              << std::setprecision(1) << treeTime << std::setw(16) << sapTime
+              << std::setw(11) << std::setprecision(2) << treeTime / sapTime
+              << "x" << std::setw(12) << treePairs / kTICK_COUNT << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
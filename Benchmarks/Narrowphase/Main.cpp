@@ -0,0 +1,300 @@
+/*******************************************************************************
+ * @brief       Narrowphase benchmark.
+ * @file        Main.cpp
+ * @author      Wynand Marais
+ * @copyright   WM Software Product License
+ * @details     Time every pair type of the narrowphase. The primitive pairs
+ *              are timed one pair at a time and as structure of array batches,
+ *              the mesh pairs are timed against a terrain grid. The number of
+ *              primitive pairs can be passed on the command line, e.g.
+ *              "AnubisBenchmark_Narrowphase 100000".
+ ******************************************************************************/
+#include "../../Include/Anubis/Common.hpp"
+#include "../../Include/Anubis/Physics.hpp"
+
+#include <chrono>
+#include <random>
+
+using namespace Anubis;
+using namespace Anubis::Physics;
+
+/* The number of times every set of pairs is tested. */
+#define kREPEAT_COUNT   20
+
+/* The size of the cube the primitives are placed in. */
+#define kWORLD_SIZE     10.0f
+
+/* The number of quads along each side of the terrain grid. */
+#define kTERRAIN_QUADS  32
+
+/* The size of a terrain quad. */
+#define kQUAD_SIZE      1.0f
+
+/* The number of volumes tested against the terrain. */
+#define kMESH_QUERIES   1000
+
+/* The largest number of contacts per mesh test. */
+#define kMAX_CONTACTS   256
+
+/******************************************************************************/
+/* Structure of arrays storage for the random boxes. */
+struct Boxes
+{
+  std::vector<float> fMinX, fMinY, fMinZ, fMaxX, fMaxY, fMaxZ;
+  std::vector<BoundingBox> fBoxes;
+
+  Narrowphase::BoxArrays arrays() const
+  {
+    return Narrowphase::BoxArrays{fMinX.data(), fMinY.data(), fMinZ.data(),
+                                  fMaxX.data(), fMaxY.data(), fMaxZ.data()};
+  }
+};
+
+/******************************************************************************/
+/* Structure of arrays storage for the random spheres. */
+struct Spheres
+{
+  std::vector<float> fX, fY, fZ, fRadius;
+  std::vector<BoundingSphere> fSpheres;
+
+  Narrowphase::SphereArrays arrays() const
+  {
+    return Narrowphase::SphereArrays{fX.data(), fY.data(), fZ.data(),
+                                     fRadius.data()};
+  }
+};
+
+/******************************************************************************/
+/* Create random boxes. */
+Boxes makeBoxes(std::mt19937 & rng, size_t count, float height)
+{
+  std::uniform_real_distribution<float> pos(0.0f, kWORLD_SIZE);
+  std::uniform_real_distribution<float> size(0.5f, 3.0f);
+  Boxes boxes;
+  for(size_t i = 0; i < count; i++)
+  {
+    float x = pos(rng), y = height < 0.0f ? pos(rng) : height, z = pos(rng);
+    float w = size(rng), h = size(rng), d = size(rng);
+    boxes.fMinX.push_back(x);
+    boxes.fMinY.push_back(y - h * 0.5f);
+    boxes.fMinZ.push_back(z);
+    boxes.fMaxX.push_back(x + w);
+    boxes.fMaxY.push_back(y + h * 0.5f);
+    boxes.fMaxZ.push_back(z + d);
+    boxes.fBoxes.push_back(BoundingBox(x, x + w, y - h * 0.5f, y + h * 0.5f,
+                                       z, z + d));
+  }
+  return boxes;
+}
+
+/******************************************************************************/
+/* Create random spheres. */
+Spheres makeSpheres(std::mt19937 & rng, size_t count, float height)
+{
+  std::uniform_real_distribution<float> pos(0.0f, kWORLD_SIZE);
+  std::uniform_real_distribution<float> radius(0.5f, 3.0f);
+  Spheres spheres;
+  for(size_t i = 0; i < count; i++)
+  {
+    float x = pos(rng), y = height < 0.0f ? pos(rng) : height, z = pos(rng);
+    float r = radius(rng);
+    spheres.fX.push_back(x);
+    spheres.fY.push_back(y);
+    spheres.fZ.push_back(z);
+    spheres.fRadius.push_back(r);
+    spheres.fSpheres.push_back(BoundingSphere(x, y, z, r));
+  }
+  return spheres;
+}
+
+/******************************************************************************/
+/* Create a bumpy terrain grid at y = 0 offset by the origin. */
+BoundingMesh makeTerrain(float originX, float originZ)
+{
+  std::vector<Math::Vector4f> vertices;
+  std::vector<uint32_t> indices;
+  const uint32_t side = kTERRAIN_QUADS + 1;
+  for(uint32_t z = 0; z < side; z++)
+  {
+    for(uint32_t x = 0; x < side; x++)
+    {
+      vertices.push_back(Math::Vector4f::makePosition(
+        originX + float(x) * kQUAD_SIZE,
+        0.25f * std::sin(float(x) * 0.7f) * std::cos(float(z) * 0.5f),
+        originZ + float(z) * kQUAD_SIZE));
+    }
+  }
+
+  for(uint32_t z = 0; z < kTERRAIN_QUADS; z++)
+  {
+    for(uint32_t x = 0; x < kTERRAIN_QUADS; x++)
+    {
+      uint32_t i = z * side + x;
+      indices.insert(indices.end(), {i, i + side, i + 1,
+                                     i + 1, i + side, i + side + 1});
+    }
+  }
+  return BoundingMesh(vertices, indices);
+}
+
+/******************************************************************************/
+/* Time a function and return the time per test in nano seconds. */
+template <typename Func>
+double timeTests(size_t testCount, uint64_t & hits, Func && func)
+{
+  hits = 0;
+  auto start = std::chrono::steady_clock::now();
+  for(size_t repeat = 0; repeat < kREPEAT_COUNT; repeat++)
+  {
+    hits += func();
+  }
+  auto end = std::chrono::steady_clock::now();
+  hits /= kREPEAT_COUNT;
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         double(testCount * kREPEAT_COUNT);
+}
+
+/******************************************************************************/
+/* Print a row of the results table. */
+void printRow(const char * name, double time, uint64_t hits)
+{
+  std::cout << std::setw(24) << std::left << name << std::right
+            << std::setw(12) << std::fixed << std::setprecision(2) << time
+            << std::setw(12) << hits << std::endl;
+}
+
+/******************************************************************************/
+int main(int argc, char * argv[])
+{
+  /* Read the number of primitive pairs from the command line. */
+  size_t pairCount = argc > 1 ? size_t(std::strtoul(argv[1], nullptr, 10)) :
+                                100000;
+
+  /* Create the volumes, the spread of positions keeps some pairs apart. */
+  std::mt19937 rng(7);
+  Boxes boxesA = makeBoxes(rng, pairCount, -1.0f);
+  Boxes boxesB = makeBoxes(rng, pairCount, -1.0f);
+  Spheres spheresA = makeSpheres(rng, pairCount, -1.0f);
+  Spheres spheresB = makeSpheres(rng, pairCount, -1.0f);
+  std::vector<uint32_t> pairs(pairCount);
+  std::vector<Contact> contacts(std::max<size_t>(pairCount, kMAX_CONTACTS));
+
+  std::cout << std::setw(24) << std::left << "Pair" << std::right
+            << std::setw(12) << "ns / test" << std::setw(12) << "Contacts"
+            << std::endl;
+
+  /* The primitive pairs one at a time and batched. */
+  uint64_t hits;
+  double time = timeTests(pairCount, hits, [&]()
+  {
+    size_t count = 0;
+    for(size_t i = 0; i < pairCount; i++)
+    {
+      count += Narrowphase::collide(boxesA.fBoxes[i], boxesB.fBoxes[i],
+                                    contacts[count]) ? 1 : 0;
+    }
+    return count;
+  });
+  printRow("Box - Box", time, hits);
+
+  time = timeTests(pairCount, hits, [&]()
+  {
+    return Narrowphase::collide(boxesA.arrays(), boxesB.arrays(), pairCount,
+                                pairs.data(), contacts.data());
+  });
+  printRow("Box - Box (batch)", time, hits);
+
+  time = timeTests(pairCount, hits, [&]()
+  {
+    size_t count = 0;
+    for(size_t i = 0; i < pairCount; i++)
+    {
+      count += Narrowphase::collide(boxesA.fBoxes[i], spheresB.fSpheres[i],
+                                    contacts[count]) ? 1 : 0;
+    }
+    return count;
+  });
+  printRow("Box - Sphere", time, hits);
+
+  time = timeTests(pairCount, hits, [&]()
+  {
+    return Narrowphase::collide(boxesA.arrays(), spheresB.arrays(),
+                                pairCount, pairs.data(), contacts.data());
+  });
+  printRow("Box - Sphere (batch)", time, hits);
+
+  time = timeTests(pairCount, hits, [&]()
+  {
+    size_t count = 0;
+    for(size_t i = 0; i < pairCount; i++)
+    {
+      count += Narrowphase::collide(spheresA.fSpheres[i],
+                                    spheresB.fSpheres[i],
+                                    contacts[count]) ? 1 : 0;
+    }
+    return count;
+  });
+  printRow("Sphere - Sphere", time, hits);
+
+  time = timeTests(pairCount, hits, [&]()
+  {
+    return Narrowphase::collide(spheresA.arrays(), spheresB.arrays(),
+                                pairCount, pairs.data(), contacts.data());
+  });
+  printRow("Sphere - Sphere (batch)", time, hits);
+
+  /* The mesh pairs against volumes resting on the terrain. */
+  const float terrainSize = kTERRAIN_QUADS * kQUAD_SIZE;
+  BoundingMesh terrain = makeTerrain(0.0f, 0.0f);
+  Boxes boxesOnTerrain = makeBoxes(rng, kMESH_QUERIES, 0.0f);
+  Spheres spheresOnTerrain = makeSpheres(rng, kMESH_QUERIES, 0.0f);
+  for(size_t i = 0; i < kMESH_QUERIES; i++)
+  {
+    /* Spread the volumes over the terrain without scaling them. */
+    float scale = terrainSize / kWORLD_SIZE;
+    float x = boxesOnTerrain.fMinX[i] * scale;
+    float z = boxesOnTerrain.fMinZ[i] * scale;
+    boxesOnTerrain.fBoxes[i] = BoundingBox(x,
+      x + boxesOnTerrain.fMaxX[i] - boxesOnTerrain.fMinX[i],
+      boxesOnTerrain.fMinY[i], boxesOnTerrain.fMaxY[i], z,
+      z + boxesOnTerrain.fMaxZ[i] - boxesOnTerrain.fMinZ[i]);
+    spheresOnTerrain.fSpheres[i] = BoundingSphere(
+      spheresOnTerrain.fX[i] * scale, 0.0f, spheresOnTerrain.fZ[i] * scale,
+      spheresOnTerrain.fRadius[i]);
+  }
+
+  time = timeTests(kMESH_QUERIES, hits, [&]()
+  {
+    size_t count = 0;
+    for(const BoundingBox & box : boxesOnTerrain.fBoxes)
+    {
+      count += Narrowphase::collide(box, terrain, contacts.data(),
+                                    kMAX_CONTACTS);
+    }
+    return count;
+  });
+  printRow("Box - Mesh", time, hits);
+
+  time = timeTests(kMESH_QUERIES, hits, [&]()
+  {
+    size_t count = 0;
+    for(const BoundingSphere & sphere : spheresOnTerrain.fSpheres)
+    {
+      count += Narrowphase::collide(sphere, terrain, contacts.data(),
+                                    kMAX_CONTACTS);
+    }
+    return count;
+  });
+  printRow("Sphere - Mesh", time, hits);
+
+  /* A terrain tile overlapping half of the other tile. */
+  BoundingMesh tile = makeTerrain(terrainSize * 0.5f, 0.0f);
+  time = timeTests(1, hits, [&]()
+  {
+    return Narrowphase::collide(terrain, tile, contacts.data(),
+                                kMAX_CONTACTS);
+  });
+  printRow("Mesh - Mesh", time, hits);
+
+  return EXIT_SUCCESS;
+}
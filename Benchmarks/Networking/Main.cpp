@@ -0,0 +1,324 @@
+/*******************************************************************************
+ * @brief       UDP batching benchmark.
+ * @file        Main.cpp
+ * @author      Wynand Marais
+ * @copyright   WM Software Product License
+ * @details     Send bursts of datagrams over the loopback interface and
+ *              receive them again: with one system call per datagram into
+ *              vectors with IPEndPoints and into pooled packets with
+ *              SocketAddresses (Socket::sendTo() and Socket::recvFrom()),
+ *              with the batches of the UDPServer and with the same batches
+ *              moved through an io_uring, if the kernel supports it.
+ *              The heap allocations of every path are counted by replacing
+ *              the global operator new. The results are printed as JSON so
+ *              that the paths can be compared. The options are:
+ *
+ *              --count N   The number of datagrams per path.
+ *              --size N    The length of every datagram in bytes.
+ *              --batch N   The batch size, also the length of every burst.
+ ******************************************************************************/
+#include "../../Include/Anubis/Common.hpp"
+#include "../../Include/Anubis/Networking.hpp"
+
+#include <chrono>
+#include <new>
+#include <string>
+
+using namespace Anubis;
+using namespace Anubis::Networking;
+
+/* The loopback address the sockets are bound too. */
+#define kNODE_NAME  "127.0.0.1"
+
+/******************************************************************************/
+/* The number of heap allocations made by the process. */
+static std::atomic<size_t> gAllocs(0);
+
+void * operator new(size_t size)
+{
+  ++gAllocs;
+  if(void * ptr = std::malloc(size ? size : 1))
+  {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void * ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void * ptr, size_t) noexcept
+{
+  std::free(ptr);
+}
+
+/******************************************************************************/
+/* The command line options. */
+struct Options
+{
+  size_t fCount = 200000;
+  size_t fSize = 256;
+  size_t fBatch = 64;
+};
+
+/******************************************************************************/
+/* The results of a path. */
+struct PathReport
+{
+  double fMs = 0.0;
+  size_t fDatagrams = 0;
+  size_t fSysCalls = 0;
+  size_t fAllocs = 0;
+};
+
+/******************************************************************************/
+/* Write a path report as JSON. */
+static void write(std::ostream & os, const char * name,
+                  const PathReport & report)
+{
+  os << "    \"" << name << "\": {\n      \"ms\": " << report.fMs
+     << ",\n      \"datagrams\": " << report.fDatagrams
+     << ",\n      \"sysCalls\": " << report.fSysCalls
+     << ",\n      \"allocsPerDatagram\": "
+     << double(report.fAllocs) / double(report.fDatagrams)
+     << ",\n      \"datagramsPerSec\": "
+     << double(report.fDatagrams) / report.fMs * 1000.0 << "\n    }";
+}
+
+/******************************************************************************/
+/* Send and receive the datagrams one at a time. */
+static PathReport runSingle(const Options & options)
+{
+  const IPEndPoint localEP(0, kNODE_NAME, IPEndPoint::Preferences::IPv4Only);
+  Socket rx(Socket::Types::UDP, Socket::Versions::IPv4);
+  Socket tx(Socket::Types::UDP, Socket::Versions::IPv4);
+  rx.bind(localEP);
+  tx.bind(localEP);
+  const IPEndPoint rxEP = rx.getEP();
+
+  std::vector<uint8_t> data(options.fSize, 0xA5);
+  std::vector<uint8_t> received;
+  IPEndPoint peer(rxEP);
+
+  PathReport report;
+  const size_t allocs = gAllocs;
+  auto start = std::chrono::steady_clock::now();
+  while(report.fDatagrams < options.fCount)
+  {
+    const size_t burst = std::min(options.fBatch,
+                                  options.fCount - report.fDatagrams);
+    for(size_t i = 0; i < burst; i++)
+    {
+      tx.sendTo(rxEP, data);
+    }
+    for(size_t i = 0; i < burst; i++)
+    {
+      rx.recvFrom(peer, received, options.fSize);
+    }
+    report.fDatagrams += burst;
+    report.fSysCalls += 2 * burst;
+  }
+  auto end = std::chrono::steady_clock::now();
+  report.fMs = std::chrono::duration<double, std::milli>(end - start).count();
+  report.fAllocs = gAllocs - allocs;
+  return report;
+}
+
+/******************************************************************************/
+/* Send and receive the datagrams one at a time with pooled packets. */
+static PathReport runPooled(const Options & options)
+{
+  const IPEndPoint localEP(0, kNODE_NAME, IPEndPoint::Preferences::IPv4Only);
+  Socket rx(Socket::Types::UDP, Socket::Versions::IPv4);
+  Socket tx(Socket::Types::UDP, Socket::Versions::IPv4);
+  rx.bind(localEP);
+  tx.bind(localEP);
+  const SocketAddress rxAddr(rx.getEP());
+
+  PacketPool pool(options.fSize);
+  PacketPool::Packet data = pool.acquire();
+  memset(data.data(), 0xA5, options.fSize);
+  data.resize(options.fSize);
+  std::vector<PacketPool::Packet> received(options.fBatch);
+  SocketAddress peer;
+
+  PathReport report;
+  const size_t allocs = gAllocs;
+  auto start = std::chrono::steady_clock::now();
+  while(report.fDatagrams < options.fCount)
+  {
+    const size_t burst = std::min(options.fBatch,
+                                  options.fCount - report.fDatagrams);
+    for(size_t i = 0; i < burst; i++)
+    {
+      tx.sendTo(rxAddr, data);
+    }
+    for(size_t i = 0; i < burst; i++)
+    {
+      received[i] = pool.acquire();
+      rx.recvFrom(peer, received[i]);
+    }
+    report.fDatagrams += burst;
+    report.fSysCalls += 2 * burst;
+  }
+  auto end = std::chrono::steady_clock::now();
+  report.fMs = std::chrono::duration<double, std::milli>(end - start).count();
+  report.fAllocs = gAllocs - allocs;
+  return report;
+}
+
+/******************************************************************************/
+/* Send and receive the datagrams in batches. */
+static PathReport runBatched(const Options & options)
+{
+  const IPEndPoint localEP(0, kNODE_NAME, IPEndPoint::Preferences::IPv4Only);
+  UDPServer rx(localEP, options.fSize, options.fBatch);
+  UDPServer tx(localEP, options.fSize, options.fBatch);
+  const SocketAddress rxAddr(rx.getEP());
+
+  std::vector<uint8_t> data(options.fSize, 0xA5);
+
+  PathReport report;
+  const size_t allocs = gAllocs;
+  auto start = std::chrono::steady_clock::now();
+  while(report.fDatagrams < options.fCount)
+  {
+    const size_t burst = std::min(options.fBatch,
+                                  options.fCount - report.fDatagrams);
+    for(size_t i = 0; i < burst; i++)
+    {
+      tx.send(rxAddr, data.data(), data.size());
+    }
+    tx.flush();
+    ++report.fSysCalls;
+
+    /* Loopback delivers the burst before flush() returns, but keep reading
+     * in case the batch was split. */
+    for(size_t received = 0; received < burst; ++report.fSysCalls)
+    {
+      received += rx.receive();
+    }
+    report.fDatagrams += burst;
+  }
+  auto end = std::chrono::steady_clock::now();
+  report.fMs = std::chrono::duration<double, std::milli>(end - start).count();
+  report.fAllocs = gAllocs - allocs;
+  return report;
+}
+
+/******************************************************************************/
+/* Send and receive the batches through io_uring, the system calls are the
+ * ones counted by the rings. */
+static PathReport runRing(const Options & options)
+{
+  const IPEndPoint localEP(0, kNODE_NAME, IPEndPoint::Preferences::IPv4Only);
+  Socket rx(Socket::Types::UDP, Socket::Versions::IPv4);
+  Socket tx(Socket::Types::UDP, Socket::Versions::IPv4);
+  rx.bind(localEP);
+  tx.bind(localEP);
+  const SocketAddress rxAddr(rx.getEP());
+
+  std::unique_ptr<IOUring> rxRing = IOUring::create(rx, options.fSize,
+                                                    options.fBatch);
+  std::unique_ptr<IOUring> txRing = IOUring::create(tx, options.fSize,
+                                                    options.fBatch);
+  PacketPool pool(options.fSize);
+  DatagramBatch rxBatch(pool, options.fBatch);
+  DatagramBatch txBatch(pool, options.fBatch);
+  std::vector<uint8_t> data(options.fSize, 0xA5);
+
+  PathReport report;
+  const size_t allocs = gAllocs;
+  auto start = std::chrono::steady_clock::now();
+  while(report.fDatagrams < options.fCount)
+  {
+    const size_t burst = std::min(options.fBatch,
+                                  options.fCount - report.fDatagrams);
+    txBatch.clear();
+    for(size_t i = 0; i < burst; i++)
+    {
+      txBatch.push(rxAddr, data.data(), data.size());
+    }
+    txRing->sendToBatch(txBatch);
+
+    for(size_t received = 0; received < burst;)
+    {
+      received += rxRing->recvFromBatch(rxBatch);
+    }
+    report.fDatagrams += burst;
+  }
+  auto end = std::chrono::steady_clock::now();
+  report.fMs = std::chrono::duration<double, std::milli>(end - start).count();
+  report.fAllocs = gAllocs - allocs;
+  report.fSysCalls = rxRing->getSysCalls() + txRing->getSysCalls();
+  return report;
+}
+
+/******************************************************************************/
+int main(int argc, char * argv[])
+{
+  /* Read the options. */
+  Options options;
+  for(int i = 1; i + 1 < argc; i += 2)
+  {
+    std::string name = argv[i], value = argv[i + 1];
+    if(name == "--count")
+    {
+      options.fCount = size_t(std::strtoul(value.c_str(), nullptr, 10));
+    }
+    else if(name == "--size")
+    {
+      options.fSize = size_t(std::strtoul(value.c_str(), nullptr, 10));
+    }
+    else if(name == "--batch")
+    {
+      options.fBatch = std::max<size_t>(
+        size_t(std::strtoul(value.c_str(), nullptr, 10)), 1);
+    }
+    else
+    {
+      std::cerr << "Unknown option: " << name << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  try
+  {
+    const PathReport single = runSingle(options);
+    const PathReport pooled = runPooled(options);
+    const PathReport batched = runBatched(options);
+    const bool ring = IOUring::isSupported();
+    const PathReport uring = ring ? runRing(options) : PathReport();
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "{\n  \"count\": " << options.fCount
+              << ",\n  \"size\": " << options.fSize
+              << ",\n  \"batch\": " << options.fBatch
+              << ",\n  \"paths\": {\n";
+    write(std::cout, "single", single);
+    std::cout << ",\n";
+    write(std::cout, "pooled", pooled);
+    std::cout << ",\n";
+    write(std::cout, "batched", batched);
+    if(ring)
+    {
+      std::cout << ",\n";
+      write(std::cout, "ioUring", uring);
+    }
+    std::cout << "\n  },\n  \"speedup\": " << single.fMs / batched.fMs;
+    if(ring)
+    {
+      std::cout << ",\n  \"ioUringSpeedup\": " << batched.fMs / uring.fMs;
+    }
+    std::cout << "\n}" << std::endl;
+  }
+  catch(const std::exception & e)
+  {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,725 @@
+/*******************************************************************************
+ * @brief       Physics stress benchmark.
+ * @file        Main.cpp
+ * @author      Wynand Marais
+ * @copyright   WM Software Product License
+ * @details     Build standard scenes and time every phase of their updates:
+ *              a large Scene hierarchy (insert, transform, sync, remove), a
+ *              pile of rigid spheres, a dense crowd of units with players
+ *              that the units are replicated too, and a storm of rays
+ *              against a terrain. The results are printed as JSON so that
+ *              runs of different builds and CPU dispatch levels can be
+ *              compared. The scenes only depend on the seed, the random
+ *              numbers are derived from the raw output of std::mt19937 which
+ *              is the same for every standard library. The options are:
+ *
+ *              --seed N      The seed of the scenes, 1 by default.
+ *              --scale F     Multiply the size of every scene, 1 by default.
+ *              --threads N   The threads of the pool, 0 for the hardware.
+ *              --ticks N     The number of ticks per simulation.
+ *              --scene NAME  Only run the named scene.
+ ******************************************************************************/
+#include "../../Include/Anubis/Common.hpp"
+#include "../../Include/Anubis/Physics.hpp"
+
+#include <chrono>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+  #include <sys/resource.h>
+#endif /* __unix__ || __APPLE__ */
+
+using namespace Anubis;
+using namespace Anubis::Physics;
+
+/* The number of nodes of the hierarchy scene at scale 1. */
+#define kHIERARCHY_NODES  50000
+
+/* The number of bodies of the pile scene at scale 1. */
+#define kPILE_BODIES      2000
+
+/* The number of units of the crowd scene at scale 1. */
+#define kCROWD_UNITS      20000
+
+/* The number of rays per tick of the ray storm at scale 1. */
+#define kSTORM_RAYS       20000
+
+/* The radius of the spheres of the pile. */
+#define kSPHERE_RADIUS    0.5f
+
+/* The map area per unit of the crowd. */
+#define kAREA_PER_UNIT    25.0f
+
+/* The distance a unit moves per tick. */
+#define kUNIT_SPEED       0.2f
+
+/* The number of units per player that the units are replicated too. */
+#define kUNITS_PER_PLAYER 100
+
+/* The radius of interest of the players. */
+#define kINTEREST_RADIUS  40.0f
+
+/* The number of neighbours every unit looks for. */
+#define kNEIGHBOURS       8
+
+/* The number of quads along each side of the terrain. */
+#define kTERRAIN_QUADS    256
+
+/******************************************************************************/
+/* The command line options. */
+struct Options
+{
+  uint32_t fSeed = 1;
+  float fScale = 1.0f;
+  size_t fThreads = 0;
+  size_t fTicks = 120;
+  std::string fScene;
+};
+
+/******************************************************************************/
+/* Random numbers that only depend on the seed. */
+class Random
+{
+  std::mt19937 fEngine;
+
+public:
+  Random(uint32_t seed) : fEngine(seed) {}
+
+  float uniform(float low, float high)
+  {
+    return low + float(fEngine() >> 8) / float(1 << 24) * (high - low);
+  }
+
+  uint32_t below(uint32_t count)
+  {
+    return uint32_t(uint64_t(fEngine()) * count >> 32);
+  }
+};
+
+/******************************************************************************/
+/* The results of a scene: the total time of every phase, counters and the
+ * peak memory of the process once the scene finished. */
+class SceneReport
+{
+  std::string fName;
+  std::vector<std::pair<std::string, double>> fPhases;
+  std::vector<std::pair<std::string, std::string>> fCounters;
+  size_t fTicks = 1;
+
+public:
+  SceneReport(const std::string & name) : fName(name) {}
+
+  /* Run func and add the time it took to the phase. */
+  template <typename Func> void time(const std::string & phase, Func && func)
+  {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto end = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    for(std::pair<std::string, double> & entry : fPhases)
+    {
+      if(entry.first == phase)
+      {
+        entry.second += ms;
+        return;
+      }
+    }
+    fPhases.push_back(std::make_pair(phase, ms));
+  }
+
+  void setCounter(const std::string & name, size_t value)
+  {
+    fCounters.push_back(std::make_pair(name, std::to_string(value)));
+  }
+
+  void setCounter(const std::string & name, double value)
+  {
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(3) << value;
+    fCounters.push_back(std::make_pair(name, text.str()));
+  }
+
+  void setCounter(const std::string & name, const std::string & value)
+  {
+    fCounters.push_back(std::make_pair(name, "\"" + value + "\""));
+  }
+
+  void setTicks(size_t ticks)
+  {
+    fTicks = ticks;
+  }
+
+  void write(std::ostream & os, size_t peakKB) const
+  {
+    os << "    {\n      \"name\": \"" << fName << "\",\n"
+       << "      \"ticks\": " << fTicks << ",\n      \"phases\": {";
+    for(size_t i = 0; i < fPhases.size(); i++)
+    {
+      os << (i ? "," : "") << "\n        \"" << fPhases[i].first
+         << "\": {\"totalMs\": " << fPhases[i].second << ", \"perTickMs\": "
+         << fPhases[i].second / double(fTicks) << "}";
+    }
+    os << "\n      },\n      \"counters\": {";
+    for(size_t i = 0; i < fCounters.size(); i++)
+    {
+      os << (i ? "," : "") << "\n        \"" << fCounters[i].first << "\": "
+         << fCounters[i].second;
+    }
+    os << "\n      },\n      \"peakMemoryKB\": " << peakKB << "\n    }";
+  }
+};
+
+/******************************************************************************/
+/* Return the peak resident memory of the process in kilobytes, 0 if it's not
+ * known on this platform. */
+size_t peakMemoryKB()
+{
+  #if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    #ifdef __APPLE__
+      return size_t(usage.ru_maxrss) / 1024;
+    #else
+      return size_t(usage.ru_maxrss);
+    #endif /* __APPLE__ */
+  #else
+    return 0;
+  #endif /* __unix__ || __APPLE__ */
+}
+
+/******************************************************************************/
+/* Create a sub object with a UUID derived from a number. */
+std::shared_ptr<Common::SubObj> makeObj(uint32_t id)
+{
+  uint8_t octets[Common::UUID::kOctetCount] = {};
+  memcpy(octets, &id, sizeof(id));
+  std::shared_ptr<Common::SubObj> obj = std::make_shared<Common::SubObj>();
+  obj->setID(Common::UUID(octets));
+  return obj;
+}
+
+/******************************************************************************/
+/* Build a random hierarchy, update it's transforms, mirror it into a second
+ * scene and tear it down a subtree at a time. */
+void runHierarchy(const Options & options, Random & random, TaskPool & pool,
+                  SceneReport & report)
+{
+  const uint32_t count = std::max(uint32_t(kHIERARCHY_NODES * options.fScale),
+                                  2u);
+  std::vector<std::shared_ptr<Common::SubObj>> objs;
+  std::vector<Common::UUID> ids;
+  for(uint32_t i = 0; i < count; i++)
+  {
+    objs.push_back(makeObj(i + 1));
+    ids.push_back(objs.back()->getID());
+  }
+
+  /* Every node is the child of a random earlier node. */
+  Scene source, mirror;
+  report.time("insert", [&]()
+  {
+    source.insert(Common::kNullUUID, objs[0]);
+    for(uint32_t i = 1; i < count; i++)
+    {
+      source.insert(ids[random.below(i)], objs[i]);
+    }
+  });
+
+  report.time("setTransform", [&]()
+  {
+    for(uint32_t i = 0; i < count; i++)
+    {
+      source.setTransform(ids[i], Math::Matrix4f::translate(Math::Vector4f(
+        random.uniform(-1.0f, 1.0f), random.uniform(-1.0f, 1.0f),
+        random.uniform(-1.0f, 1.0f), 1.0f)));
+    }
+  });
+  report.time("updateTransforms", [&]() { source.updateTransforms(); });
+  report.time("updateTransformsPool", [&]()
+  {
+    source.updateTransforms(&pool);
+  });
+  report.time("syncFull", [&]() { mirror.sync(&source); });
+
+  /* Save the level and load it back, to compare with building it by
+   * insert(). */
+  std::vector<uint8_t> snapshotData;
+  SceneSnapshot snapshot;
+  Scene loaded;
+  report.time("snapshotWrite", [&]()
+  {
+    SceneSnapshot::write(source, snapshotData);
+  });
+  report.time("snapshotLoad", [&]()
+  {
+    snapshot.open(snapshotData.data(), snapshotData.size());
+    snapshot.load(loaded);
+  });
+
+  /* Remove random subtrees until half the nodes are gone. */
+  size_t removed = 0;
+  report.time("remove", [&]()
+  {
+    while(source.getNodeCount() > count / 2)
+    {
+      removed += source.remove(ids[1 + random.below(count - 1)]);
+    }
+  });
+  report.time("syncShrink", [&]() { mirror.sync(&source); });
+
+  report.setCounter("nodes", size_t(count));
+  report.setCounter("removedSubtrees", size_t(removed));
+  report.setCounter("mirroredNodes", size_t(mirror.getNodeCount()));
+  report.setCounter("snapshotBytes", size_t(snapshotData.size()));
+  report.setCounter("loadedNodes", size_t(loaded.getNodeCount()));
+}
+
+/******************************************************************************/
+/* Drop a pile of spheres on the ground and let it settle, with the broadphase,
+ * narrowphase, solver and sleeping running every tick. */
+void runPile(const Options & options, Random & random, TaskPool & pool,
+             SceneReport & report)
+{
+  const float kStep = 1.0f / 60.0f;
+  typedef RigidBodyWorld::BodyID BodyID;
+  const size_t count = std::max(size_t(kPILE_BODIES * options.fScale),
+                                size_t(1));
+  const size_t side = size_t(std::ceil(std::sqrt(float(count) / 4.0f)));
+
+  /* Columns of spheres four high with a little jitter. */
+  RigidBodyWorld world;
+  ContactSolver solver;
+  Islands islands;
+  AABBTree tree;
+  world.reserve(count);
+  std::vector<BodyID> bodies(count);
+  std::vector<int32_t> proxies(count);
+  std::vector<Math::Vector4f> previous(count);
+  auto sphereBox = [&](const Math::Vector4f & centre)
+  {
+    Math::Vector4f extent(kSPHERE_RADIUS, kSPHERE_RADIUS, kSPHERE_RADIUS,
+                          0.0f);
+    return AABB(centre - extent, centre + extent);
+  };
+  for(size_t i = 0; i < count; i++)
+  {
+    RigidBodyWorld::BodyDesc desc;
+    desc.fPosition = Math::Vector4f(
+      float(i % side) * 1.05f + random.uniform(-0.02f, 0.02f),
+      0.6f + float(i / (side * side)) * 1.1f,
+      float((i / side) % side) * 1.05f + random.uniform(-0.02f, 0.02f), 1.0f);
+    desc.fInertia = Math::Vector4f(0.1f, 0.1f, 0.1f, 0.0f);
+    bodies[i] = world.add(desc);
+    previous[i] = desc.fPosition;
+    proxies[i] = tree.insert(sphereBox(desc.fPosition), &bodies[i]);
+  }
+
+  std::vector<ContactSolver::Constraint> constraints;
+  size_t contactTotal = 0;
+  for(size_t tick = 0; tick < options.fTicks; tick++)
+  {
+    report.time("integrateVelocities", [&]()
+    {
+      world.integrateVelocities(kStep, &pool);
+    });
+
+    /* Move the proxies of the bodies. */
+    report.time("broadphase", [&]()
+    {
+      for(size_t i = 0; i < count; i++)
+      {
+        Math::Vector4f position = world.position(bodies[i]);
+        tree.move(proxies[i], sphereBox(position), position - previous[i]);
+        previous[i] = position;
+      }
+    });
+
+    /* The contacts with the ground and between the spheres. */
+    report.time("narrowphase", [&]()
+    {
+      constraints.clear();
+      for(size_t i = 0; i < count; i++)
+      {
+        if(previous[i].y() < kSPHERE_RADIUS)
+        {
+          Contact contact = {Math::Vector4f(previous[i].x(), 0.0f,
+            previous[i].z(), 1.0f), Math::Vector4f(0.0f, -1.0f, 0.0f, 0.0f),
+            kSPHERE_RADIUS - previous[i].y()};
+          constraints.push_back({bodies[i], RigidBodyWorld::kNullBody,
+                                 contact, 0.5f});
+        }
+      }
+      tree.queryPairs([&](int32_t proxyA, int32_t proxyB)
+      {
+        BodyID a = *static_cast<BodyID*>(tree.getUserData(proxyA));
+        BodyID b = *static_cast<BodyID*>(tree.getUserData(proxyB));
+        if(!world.isAwake(a) && !world.isAwake(b))
+        {
+          return;
+        }
+        Math::Vector4f pa = world.position(a), pb = world.position(b);
+        Contact contact;
+        if(Narrowphase::collide(
+             BoundingSphere(pa.x(), pa.y(), pa.z(), kSPHERE_RADIUS),
+             BoundingSphere(pb.x(), pb.y(), pb.z(), kSPHERE_RADIUS), contact))
+        {
+          constraints.push_back({a, b, contact, 0.5f});
+        }
+      });
+      contactTotal += constraints.size();
+    });
+
+    report.time("solve", [&]()
+    {
+      solver.solve(world, constraints.data(), constraints.size(), kStep,
+                   &pool);
+    });
+    report.time("integratePositions", [&]()
+    {
+      world.integratePositions(kStep, &pool);
+    });
+    report.time("islands", [&]()
+    {
+      islands.update(world, constraints.data(), constraints.size(), kStep);
+    });
+  }
+
+  report.setTicks(options.fTicks);
+  report.setCounter("bodies", size_t(count));
+  report.setCounter("contactsPerTick", double(contactTotal) /
+                                       double(std::max(options.fTicks,
+                                                       size_t(1))));
+  report.setCounter("colours", size_t(solver.colourCount()));
+  report.setCounter("islands", size_t(islands.islandCount()));
+  report.setCounter("awakeBodies", size_t(world.awakeCount()));
+  std::ostringstream checksum;
+  checksum << std::hex << std::setw(16) << std::setfill('0')
+           << world.checksum();
+  report.setCounter("checksum", checksum.str());
+}
+
+/******************************************************************************/
+/* A dense crowd walking on a flat map: the units move, the overlapping pairs
+ * are found and every unit looks for it's nearest neighbours. */
+void runCrowd(const Options & options, Random & random, TaskPool & pool,
+              SceneReport & report)
+{
+  const size_t count = std::max(size_t(kCROWD_UNITS * options.fScale),
+                                size_t(1));
+  const float mapSize = std::sqrt(float(count) * kAREA_PER_UNIT);
+
+  struct Unit
+  {
+    float fX, fZ, fVelX, fVelZ;
+    int32_t fProxy, fEntity;
+  };
+  auto unitBox = [](const Unit & unit)
+  {
+    return AABB(Math::Vector4f(unit.fX - 0.5f, 0.0f, unit.fZ - 0.5f, 1.0f),
+                Math::Vector4f(unit.fX + 0.5f, 2.0f, unit.fZ + 0.5f, 1.0f));
+  };
+
+  SweepAndPrune sap(SweepAndPrune::Axes::X);
+  SpatialGrid grid(4.0f);
+  sap.reserve(count);
+  std::vector<Unit> units(count);
+  std::vector<Math::Vector4f> positions(count);
+  for(Unit & unit : units)
+  {
+    float angle = random.uniform(0.0f, Math::Constants::twoPi<float>());
+    unit.fX = random.uniform(0.0f, mapSize);
+    unit.fZ = random.uniform(0.0f, mapSize);
+    unit.fVelX = std::cos(angle) * kUNIT_SPEED;
+    unit.fVelZ = std::sin(angle) * kUNIT_SPEED;
+    unit.fProxy = sap.insert(unitBox(unit), &unit);
+    unit.fEntity = grid.insert(Math::Vector4f(unit.fX, 0.0f, unit.fZ, 1.0f),
+                               &unit);
+  }
+
+  /* Some of the units are players that the units are replicated too. */
+  InterestManager interest(kINTEREST_RADIUS);
+  std::vector<int32_t> interestEntities(count), players;
+  for(size_t i = 0; i < count; i++)
+  {
+    interestEntities[i] = interest.addEntity(
+      Math::Vector4f(units[i].fX, 0.0f, units[i].fZ, 1.0f));
+    if(i % kUNITS_PER_PLAYER == 0)
+    {
+      players.push_back(interest.addClient(
+        Math::Vector4f(units[i].fX, 0.0f, units[i].fZ, 1.0f),
+        kINTEREST_RADIUS));
+    }
+  }
+
+  std::vector<SpatialGrid::Neighbour> neighbours(count * kNEIGHBOURS);
+  std::vector<uint32_t> found(count);
+  uint64_t pairTotal = 0, neighbourTotal = 0, eventTotal = 0, dueTotal = 0;
+  for(size_t tick = 0; tick < options.fTicks; tick++)
+  {
+    /* Move the units, bouncing off the edges of the map. */
+    report.time("move", [&]()
+    {
+      for(size_t i = 0; i < count; i++)
+      {
+        Unit & unit = units[i];
+        if(unit.fX + unit.fVelX < 0.0f || unit.fX + unit.fVelX > mapSize)
+        {
+          unit.fVelX = -unit.fVelX;
+        }
+        if(unit.fZ + unit.fVelZ < 0.0f || unit.fZ + unit.fVelZ > mapSize)
+        {
+          unit.fVelZ = -unit.fVelZ;
+        }
+        unit.fX += unit.fVelX;
+        unit.fZ += unit.fVelZ;
+        positions[i] = Math::Vector4f(unit.fX, 0.0f, unit.fZ, 1.0f);
+        sap.move(unit.fProxy, unitBox(unit),
+                 Math::Vector4f(unit.fVelX, 0.0f, unit.fVelZ, 0.0f));
+        grid.move(unit.fEntity, positions[i]);
+      }
+    });
+
+    report.time("pairs", [&]()
+    {
+      sap.queryPairs([&](int32_t, int32_t) { ++pairTotal; });
+    });
+
+    report.time("neighbours", [&]()
+    {
+      BatchQuery::nearest(grid, positions.data(), count, kNEIGHBOURS, 8.0f,
+                          neighbours.data(), found.data(), &pool);
+    });
+    for(uint32_t n : found)
+    {
+      neighbourTotal += n;
+    }
+
+    report.time("interest", [&]()
+    {
+      for(size_t i = 0; i < count; i++)
+      {
+        interest.moveEntity(interestEntities[i], positions[i]);
+      }
+      for(size_t i = 0; i < players.size(); i++)
+      {
+        interest.moveClient(players[i], positions[i * kUNITS_PER_PLAYER]);
+      }
+      interest.update(&pool);
+    });
+    eventTotal += interest.getEvents().size();
+    for(int32_t player : players)
+    {
+      dueTotal += interest.getDue(player).size();
+    }
+  }
+
+  const double ticks = double(std::max(options.fTicks, size_t(1)));
+  report.setTicks(options.fTicks);
+  report.setCounter("units", size_t(count));
+  report.setCounter("pairsPerTick", double(pairTotal) / ticks);
+  report.setCounter("neighboursPerTick", double(neighbourTotal) / ticks);
+  report.setCounter("players", size_t(players.size()));
+  report.setCounter("interestEventsPerTick", double(eventTotal) / ticks);
+  report.setCounter("replicatedPerPlayerTick", double(dueTotal) /
+                    (ticks * double(std::max<size_t>(players.size(), 1))));
+}
+
+/******************************************************************************/
+/* Cast rays from units standing on a terrain to random targets, one at a
+ * time, as serial batches and as batches on the pool. */
+void runRayStorm(const Options & options, Random & random, TaskPool & pool,
+                 SceneReport & report)
+{
+  /* A bumpy terrain grid. */
+  std::vector<Math::Vector4f> vertices;
+  std::vector<uint32_t> indices;
+  const uint32_t side = kTERRAIN_QUADS + 1;
+  for(uint32_t z = 0; z < side; z++)
+  {
+    for(uint32_t x = 0; x < side; x++)
+    {
+      vertices.push_back(Math::Vector4f::makePosition(float(x),
+        random.uniform(-2.0f, 2.0f), float(z)));
+      if(x > 0 && z > 0)
+      {
+        uint32_t i = z * side + x;
+        indices.insert(indices.end(), {i - side - 1, i - 1, i,
+                                       i - side - 1, i, i - side});
+      }
+    }
+  }
+  auto start = std::chrono::steady_clock::now();
+  BoundingMesh mesh(vertices, indices);
+  auto end = std::chrono::steady_clock::now();
+
+  /* Every group of rays shares an eye and looks within a field of view, as a
+   * unit checking the targets in front of it. */
+  const size_t count = std::max(size_t(kSTORM_RAYS * options.fScale),
+                                size_t(1));
+  std::vector<Math::Ray> rays;
+  std::vector<float> maxT;
+  Math::Vector4f eye;
+  float facing = 0.0f;
+  for(size_t i = 0; i < count; i++)
+  {
+    if(i % 16 == 0)
+    {
+      eye = Math::Vector4f(random.uniform(0.0f, kTERRAIN_QUADS), 2.5f,
+                           random.uniform(0.0f, kTERRAIN_QUADS), 1.0f);
+      facing = random.uniform(0.0f, Math::Constants::twoPi<float>());
+    }
+    const float angle = facing + random.uniform(-0.5f, 0.5f);
+    const float range = random.uniform(5.0f, 40.0f);
+    Math::Vector4f target(eye.x() + std::cos(angle) * range,
+                          random.uniform(-1.0f, 3.0f),
+                          eye.z() + std::sin(angle) * range, 1.0f);
+    Math::Vector4f direction = target - eye;
+    const float length = direction.length();
+    rays.push_back(Math::Ray(eye, direction * (1.0f / length)));
+    maxT.push_back(length);
+  }
+
+  std::vector<BatchQuery::RayHit> hits(count);
+  std::vector<uint8_t> blocked(count);
+  size_t singleHits = 0, blockedTotal = 0;
+  const size_t ticks = std::max(options.fTicks / 10, size_t(1));
+  for(size_t tick = 0; tick < ticks; tick++)
+  {
+    report.time("single", [&]()
+    {
+      for(size_t i = 0; i < count; i++)
+      {
+        float distance;
+        size_t triangle;
+        singleHits += mesh.raycast(rays[i], maxT[i], distance, triangle);
+      }
+    });
+    report.time("batch", [&]()
+    {
+      BatchQuery::raycast(mesh, rays.data(), maxT.data(), count, hits.data());
+    });
+    report.time("batchPool", [&]()
+    {
+      BatchQuery::raycast(mesh, rays.data(), maxT.data(), count, hits.data(),
+                          &pool);
+    });
+    report.time("occludedPool", [&]()
+    {
+      BatchQuery::occluded(mesh, rays.data(), maxT.data(), count,
+                           blocked.data(), &pool);
+    });
+    for(uint8_t isBlocked : blocked)
+    {
+      blockedTotal += isBlocked;
+    }
+  }
+
+  report.setTicks(ticks);
+  report.setCounter("triangles", size_t(mesh.triangleCount()));
+  report.setCounter("buildMs",
+    std::chrono::duration<double, std::milli>(end - start).count());
+  report.setCounter("rays", size_t(count));
+  report.setCounter("hitsPerTick", double(singleHits) / double(ticks));
+  report.setCounter("blockedPerTick", double(blockedTotal) / double(ticks));
+}
+
+/******************************************************************************/
+int main(int argc, char * argv[])
+{
+  /* Read the options. */
+  Options options;
+  for(int i = 1; i < argc; i += 2)
+  {
+    std::string name = argv[i];
+    if(name != "--seed" && name != "--scale" && name != "--threads" &&
+       name != "--ticks" && name != "--scene")
+    {
+      std::cerr << "Unknown option: " << name << std::endl;
+      return EXIT_FAILURE;
+    }
+    if(i + 1 == argc)
+    {
+      std::cerr << "Missing the value of option: " << name << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    std::string value = argv[i + 1];
+    if(name == "--seed")
+    {
+      options.fSeed = uint32_t(std::strtoul(value.c_str(), nullptr, 10));
+    }
+    else if(name == "--scale")
+    {
+      options.fScale = std::strtof(value.c_str(), nullptr);
+    }
+    else if(name == "--threads")
+    {
+      options.fThreads = size_t(std::strtoul(value.c_str(), nullptr, 10));
+    }
+    else if(name == "--ticks")
+    {
+      options.fTicks = size_t(std::strtoul(value.c_str(), nullptr, 10));
+    }
+    else
+    {
+      options.fScene = value;
+    }
+  }
+
+  /* The scenes, each gets it's own generator so they can run alone. */
+  typedef std::function<void(const Options &, Random &, TaskPool &,
+                             SceneReport &)> SceneFunc;
+  const std::pair<const char *, SceneFunc> scenes[] = {
+    {"hierarchy", runHierarchy},
+    {"pile", runPile},
+    {"crowd", runCrowd},
+    {"rayStorm", runRayStorm}
+  };
+
+  /* The build options that change the results or the speed. */
+  #ifdef ANUBIS_HAS_SSE
+    const char * sse = "true";
+  #else
+    const char * sse = "false";
+  #endif /* ANUBIS_HAS_SSE */
+  #ifdef ANUBIS_DETERMINISTIC
+    const char * deterministic = "true";
+  #else
+    const char * deterministic = "false";
+  #endif /* ANUBIS_DETERMINISTIC */
+  #ifdef __FMA__
+    const char * fma = "true";
+  #else
+    const char * fma = "false";
+  #endif /* __FMA__ */
+
+  TaskPool pool(options.fThreads);
+  std::cout << std::fixed << std::setprecision(3)
+            << "{\n  \"build\": {\n    \"sse\": " << sse
+            << ",\n    \"deterministic\": " << deterministic
+            << ",\n    \"fma\": " << fma << "\n  },\n  \"seed\": " << options.fSeed
+            << ",\n  \"scale\": " << options.fScale
+            << ",\n  \"threads\": " << pool.getThreadCount()
+            << ",\n  \"scenes\": [\n";
+
+  bool first = true;
+  for(size_t i = 0; i < sizeof(scenes) / sizeof(scenes[0]); i++)
+  {
+    if(!options.fScene.empty() && options.fScene != scenes[i].first)
+    {
+      continue;
+    }
+    Random random(options.fSeed + uint32_t(i));
+    SceneReport report(scenes[i].first);
+    scenes[i].second(options, random, pool, report);
+    std::cout << (first ? "" : ",\n");
+    report.write(std::cout, peakMemoryKB());
+    first = false;
+  }
+  std::cout << "\n  ]\n}" << std::endl;
+
+  return EXIT_SUCCESS;
+}
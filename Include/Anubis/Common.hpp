@@ -12,6 +12,7 @@
 #include "Common/Log.hpp"
 #include "Common/Memory.hpp"
 #include "Common/Misc.hpp"
+#include "Common/Pool.hpp"
 #include "Common/SubObj.hpp"
 #include "Common/UUID.hpp"
 
@@ -30,6 +30,25 @@ namespace Anubis
 
       /* The memory where all the elements are stored. */
       std::unique_ptr<T[]> fElements;
+
+      /*********************************************************************//**
+       * Advance the head past a newly added element. The mutex must be held.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE void advanceHead()
+      {
+        /* Increment the head position. */
+        ++fHead;
+
+        /* Wrap the index to 0 if overflows. */
+        if(fHead >= kMaxCount)
+        {
+          fHead = 0;
+        }
+
+        /* Increment the item count. This must be done right at the end else
+         * a race condition can occur with pop(). */
+        ++fCount;
+      }
     public:
 
       /*********************************************************************//**
@@ -87,18 +106,39 @@ namespace Anubis
         /* Add the element to the queue. */
         fElements[fHead] = element;
 
-        /* Increment the head position. */
-        ++fHead;
+        /* Advance the head position. */
+        advanceHead();
 
-        /* Wrap the index to 0 if overflows. */
-        if(fHead >= kMaxCount)
+        /* Return true to indicate that item was inserted into the queue. */
+        return true;
+      }
+
+      /*********************************************************************//**
+       * Move a new element into the head position of the queue.
+       *
+       * @param element The element to be enqueued, it's left moved from only
+       *                if it was inserted.
+       * @return        True if the lement was inserted, else false. (This will
+       *                only ever be fase if the queue is full.)
+       ************************************************************************/
+      bool push(T && element)
+      {
+        /* Check if the queue is full. */
+        if(isFull())
         {
-          fHead = 0;
+          /* Return false to indicate the element was not added because the
+           * queue is full. */
+          return false;
         }
 
-        /* Increment the item count. This must be done right at the end else
-         * a race condition can occur with pop(). */
-        ++fCount;
+        /* Lock the access mutex. */
+        std::lock_guard<std::mutex> lock(fMutex);
+
+        /* Move the element into the queue. */
+        fElements[fHead] = std::move(element);
+
+        /* Advance the head position. */
+        advanceHead();
 
         /* Return true to indicate that item was inserted into the queue. */
         return true;
@@ -123,8 +163,9 @@ namespace Anubis
         /* Lock the access mutex. */
         std::lock_guard<std::mutex> lock(fMutex);
 
-        /* Read the current value. */
-        element = fElements[fTail];
+        /* Move the current value out, so the queue doesn't keep a copy of
+         * it (i.e. a reference to a pooled buffer) until it's overwritten. */
+        element = std::move(fElements[fTail]);
 
         /* Advance the tail position. */
         ++fTail;
@@ -33,6 +33,27 @@ namespace Anubis
      **************************************************************************/
     static float sumAngles(float angle1, float angle2);
 
+    /***********************************************************************//**
+     * Calculate the sine of an angle. If ANUBIS_DETERMINISTIC is defined, it's
+     * calculated with a polynomial that only uses basic arithmetic, so the
+     * result does not depend on the C library, otherwise std::sin() is used.
+     *
+     * @param angle The angle in radians.
+     * @return      The sine of the angle.
+     **************************************************************************/
+    static float sin(float angle);
+
+    /***********************************************************************//**
+     * Calculate the cosine of an angle. If ANUBIS_DETERMINISTIC is defined,
+     * it's calculated with a polynomial that only uses basic arithmetic, so
+     * the result does not depend on the C library, otherwise std::cos() is
+     * used.
+     *
+     * @param angle The angle in radians.
+     * @return      The cosine of the angle.
+     **************************************************************************/
+    static float cos(float angle);
+
 
   };
 }
@@ -34,7 +34,10 @@
 
 #include <boost/filesystem.hpp>
 
-//#define ANUBIS_HAS_SSE
+#if ANUBIS_COMPILER == ANUBIS_COMPILER_MSVC
+  #include <intrin.h>
+#endif /* ANUBIS_COMPILER_MSVC */
+
 #define ANUBIS_HOST_IS_LITTLE_ENDIAN
 
 #ifdef ANUBIS_OS_WINDOWS
@@ -68,6 +71,49 @@ namespace Anubis
 
 
     };
+
+    class Bits
+    {
+
+    public:
+
+      /*********************************************************************//**
+       * Return the index of the lowest set bit, e.g. to walk the lanes of a
+       * SIMD comparison mask.
+       *
+       * @param value The bits, at least one must be set.
+       * @return      The number of trailing zero bits.
+       ************************************************************************/
+      static int countTrailingZeros(uint32_t value)
+      {
+        assert(value != 0 && "No bit is set.");
+        #if ANUBIS_COMPILER == ANUBIS_COMPILER_MSVC
+          unsigned long index;
+          _BitScanForward(&index, value);
+          return int(index);
+        #else
+          return __builtin_ctz(value);
+        #endif /* ANUBIS_COMPILER_MSVC */
+      }
+
+      /*********************************************************************//**
+       * Return the index of the lowest set bit of a 64 bit value.
+       *
+       * @param value The bits, at least one must be set.
+       * @return      The number of trailing zero bits.
+       ************************************************************************/
+      static int countTrailingZeros64(uint64_t value)
+      {
+        assert(value != 0 && "No bit is set.");
+        #if ANUBIS_COMPILER == ANUBIS_COMPILER_MSVC
+          unsigned long index;
+          _BitScanForward64(&index, value);
+          return int(index);
+        #else
+          return __builtin_ctzll(value);
+        #endif /* ANUBIS_COMPILER_MSVC */
+      }
+    };
   }
 
   namespace Math
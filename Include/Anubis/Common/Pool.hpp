@@ -0,0 +1,200 @@
+#ifndef ANUBIS_COMMON_POOL_HPP
+#define ANUBIS_COMMON_POOL_HPP
+
+#include "Misc.hpp"
+
+namespace Anubis
+{
+  namespace Common
+  {
+    /***********************************************************************//**
+     * A fixed slot size object pool. Memory is requested from the allocator
+     * in slabs of kSlabCount objects and is never returned to it until the
+     * pool is destroyed. Destroyed objects are placed on an intrusive free
+     * list and recycled by the next create(), thus once the pool has grown to
+     * the peak object count (or reserve() was called), create() and destroy()
+     * never touch the heap.
+     *
+     * The pool is not thread safe, it is intended to be owned by a single
+     * container (i.e. a Scene) which controls access to it.
+     **************************************************************************/
+    template <typename T, size_t kSlabCount = 1024> class Pool final
+    {
+      /*********************************************************************//**
+       * A single slot in a slab. While the slot is free the memory is used to
+       * link it into the free list, otherwise it stores the object.
+       ************************************************************************/
+      union Slot
+      {
+        /** The next free slot when this slot is on the free list. */
+        Slot * fNext;
+
+        /** The storage for the object. */
+        alignas(T) uint8_t fStorage[sizeof(T)];
+      };
+
+      /** All the slabs that has been allocated. */
+      std::vector<std::unique_ptr<Slot[]>> fSlabs;
+
+      /** The head of the list of recycled slots. */
+      Slot * fFreeList;
+
+      /** The index of the slab that new slots are bumped from. */
+      size_t fSlabIndex;
+
+      /** The index of the next never used slot in the current slab. */
+      size_t fSlotIndex;
+
+      /** The number of live objects. */
+      size_t fCount;
+
+      /** Delete the copy constructor. */
+      Pool(const Pool &) = delete;
+
+      /** Delete the assignment operator. */
+      Pool & operator = (const Pool &) = delete;
+
+      /*********************************************************************//**
+       * Return an unused slot, either from the free list or from the current
+       * slab. A new slab is only allocated when all the existing ones are
+       * exhausted.
+       *
+       * @return  The pointer to an unused slot.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE Slot * acquire()
+      {
+        /* Prefer recycled slots since they are most likely still cached. */
+        if(fFreeList != nullptr)
+        {
+          Slot * slot = fFreeList;
+          fFreeList = slot->fNext;
+          return slot;
+        }
+
+        /* Check if the current slab is exhausted. */
+        if(fSlotIndex >= kSlabCount)
+        {
+          ++fSlabIndex;
+          fSlotIndex = 0;
+        }
+
+        /* Allocate a new slab if there is none left to bump from. */
+        if(fSlabIndex >= fSlabs.size())
+        {
+          fSlabs.push_back(std::unique_ptr<Slot[]>(new Slot[kSlabCount]));
+        }
+
+        /* Bump the next slot from the slab. */
+        return &(fSlabs[fSlabIndex][fSlotIndex++]);
+      }
+
+    public:
+
+      /*********************************************************************//**
+       * Create an empty pool. No memory is allocated until the first object
+       * is created or reserve() is called.
+       ************************************************************************/
+      Pool() : fFreeList(nullptr), fSlabIndex(0), fSlotIndex(0), fCount(0) {}
+
+      /*********************************************************************//**
+       * Release all the slabs. Any objects that are still alive are not
+       * destroyed, the owner of the pool is responsible for destroying them.
+       ************************************************************************/
+      ~Pool() = default;
+
+      /*********************************************************************//**
+       * Make sure that at least count objects can be created without the pool
+       * having to request memory from the allocator.
+       *
+       * @param count The number of objects to reserve space for.
+       ************************************************************************/
+      void reserve(size_t count)
+      {
+        /* Calculate the number of slabs required to store count objects. */
+        size_t slabCount = (count + kSlabCount - 1) / kSlabCount;
+
+        /* Allocate the missing slabs. */
+        while(fSlabs.size() < slabCount)
+        {
+          fSlabs.push_back(std::unique_ptr<Slot[]>(new Slot[kSlabCount]));
+        }
+      }
+
+      /*********************************************************************//**
+       * Construct a new object in the pool.
+       *
+       * @param args  The arguments to pass to the object's constructor.
+       * @return      The pointer to the newly constructed object.
+       ************************************************************************/
+      template <typename... Args> ANUBIS_FORCE_INLINE T * create(Args&&... args)
+      {
+        /* Get a slot to construct the object in. */
+        Slot * slot = acquire();
+
+        /* Construct the object in place. */
+        T * obj = new (slot->fStorage) T(std::forward<Args>(args)...);
+
+        /* Increment the live object count. */
+        ++fCount;
+
+        /* Return the constructed object. */
+        return obj;
+      }
+
+      /*********************************************************************//**
+       * Destroy an object that was created by this pool and recycle its slot.
+       *
+       * @param obj The object to destroy.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE void destroy(T * obj)
+      {
+        /* Invoke the destructor. */
+        obj->~T();
+
+        /* Push the slot onto the free list. */
+        Slot * slot = reinterpret_cast<Slot*>(obj);
+        slot->fNext = fFreeList;
+        fFreeList = slot;
+
+        /* Decrement the live object count. */
+        --fCount;
+      }
+
+      /*********************************************************************//**
+       * Return every slot to the pool in constant time while keeping all the
+       * slabs for reuse. No destructors are invoked, thus the owner must have
+       * released any resources held by the live objects before calling this.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE void reset() noexcept
+      {
+        fFreeList = nullptr;
+        fSlabIndex = 0;
+        fSlotIndex = 0;
+        fCount = 0;
+      }
+
+      /*********************************************************************//**
+       * Return the number of live objects in the pool.
+       *
+       * @return  The number of live objects.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t size() const noexcept
+      {
+        return fCount;
+      }
+
+      /*********************************************************************//**
+       * Return the number of objects that can be stored without allocating
+       * another slab.
+       *
+       * @return  The capacity of the pool.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t capacity() const noexcept
+      {
+        return fSlabs.size() * kSlabCount;
+      }
+    };
+  }
+}
+
+#endif /* ANUBIS_COMMON_POOL_HPP */
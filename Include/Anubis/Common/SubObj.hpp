@@ -29,6 +29,16 @@ namespace Anubis
        ************************************************************************/
       ANUBIS_INLINE SubObj(const UUID & uuid) : fCompUUID(uuid) {}
 
+      /*********************************************************************//**
+       * Create a new sub component object with a specific uuid that belongs
+       * to a specific component, i.e. when it is read back from a file.
+       *
+       * @param uuid      The UUID of the object.
+       * @param compUUID  The UUID of the component it belongs too.
+       ************************************************************************/
+      ANUBIS_INLINE SubObj(const UUID & uuid, const UUID & compUUID) :
+        IdentObj(uuid), fCompUUID(compUUID) {}
+
       /*********************************************************************//**
        * An empty virtual destructor to ensure that the subclass' destructor
        * is invoked.
@@ -32,6 +32,17 @@ namespace Anubis
        ************************************************************************/
       UUID(bool isNull = false);
 
+      /*********************************************************************//**
+       * Create a UUID from kOctetCount octets, i.e. when it is read back from
+       * a file or a network packet.
+       *
+       * @param octets  The octets of the UUID.
+       ************************************************************************/
+      explicit UUID(const uint8_t * octets)
+      {
+        memcpy(fOctets, octets, kOctetCount);
+      }
+
       UUID(const UUID & cp)
       {
         memcpy(fOctets, cp.fOctets, kOctetCount);
@@ -126,6 +137,37 @@ namespace Anubis
         return result >= 0;
       }
 
+      /*********************************************************************//**
+       * Return a pointer to the kOctetCount octets of the UUID.
+       *
+       * @return  The octets of the UUID.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE const uint8_t * octets() const noexcept
+      {
+        return fOctets;
+      }
+
+      /*********************************************************************//**
+       * Calculate a hash of the UUID suitable for hash tables. The octets are
+       * folded into a 64 bit value and then mixed so that UUIDs which only
+       * differ in a few octets still spread evenly over the buckets.
+       *
+       * @return  The hash of the UUID.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t hash() const noexcept
+      {
+        /* Fold the two halves of the UUID together. */
+        uint64_t lo, hi;
+        memcpy(&lo, fOctets, sizeof(uint64_t));
+        memcpy(&hi, fOctets + sizeof(uint64_t), sizeof(uint64_t));
+        uint64_t h = lo ^ (hi * 0x9E3779B97F4A7C15ULL);
+
+        /* Mix the bits (splitmix64 finaliser). */
+        h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+        return static_cast<size_t>(h ^ (h >> 31));
+      }
+
       /*********************************************************************//**
        * Write the UUID out as a string to the specified output stream.
        *
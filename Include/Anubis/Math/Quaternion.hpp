@@ -53,6 +53,46 @@ namespace Anubis
        ************************************************************************/
       static Quaternion fromEuler(float xRot, float yRot, float zRot);
 
+      /*********************************************************************//**
+       * Return the x component of the quaternion.
+       *
+       * @return  The x component.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE float x() const noexcept
+      {
+        return fX;
+      }
+
+      /*********************************************************************//**
+       * Return the y component of the quaternion.
+       *
+       * @return  The y component.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE float y() const noexcept
+      {
+        return fY;
+      }
+
+      /*********************************************************************//**
+       * Return the z component of the quaternion.
+       *
+       * @return  The z component.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE float z() const noexcept
+      {
+        return fZ;
+      }
+
+      /*********************************************************************//**
+       * Return the w component of the quaternion.
+       *
+       * @return  The w component.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE float w() const noexcept
+      {
+        return fW;
+      }
+
       /*********************************************************************//**
        * Calculate and return the conjugate of the quaternion without modifying
        * the original quaternion.
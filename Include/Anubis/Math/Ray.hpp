@@ -1,13 +1,73 @@
 #ifndef ANUBIS_MATH_RAY_HPP
 #define ANUBIS_MATH_RAY_HPP
 
+#include "Vector4f.hpp"
+
 namespace Anubis
 {
   namespace Math
   {
-    class Ray
+    /***********************************************************************//**
+     * A half infinite line starting at an origin and extending along a
+     * direction. The direction is not required to be normalised, distances
+     * along the ray are expressed in multiples of the direction's length.
+     **************************************************************************/
+    class Ray final
     {
+      /** The starting position of the ray. */
+      Vector4f fOrigin;
+
+      /** The direction of the ray. */
+      Vector4f fDirection;
+
+    public:
+
+      /*********************************************************************//**
+       * Create a ray at the origin pointing along the positive Z axis.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE Ray() : fOrigin(0.0f, 0.0f, 0.0f, 1.0f),
+        fDirection(0.0f, 0.0f, 1.0f, 0.0f) {}
+
+      /*********************************************************************//**
+       * Create a ray from an origin and a direction.
+       *
+       * @param origin    The starting position of the ray.
+       * @param direction The direction of the ray.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE Ray(const Vector4f & origin,
+                              const Vector4f & direction) :
+        fOrigin(origin), fDirection(direction) {}
+
+      /*********************************************************************//**
+       * Return the starting position of the ray.
+       *
+       * @return  The origin of the ray.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE const Vector4f & origin() const noexcept
+      {
+        return fOrigin;
+      }
+
+      /*********************************************************************//**
+       * Return the direction of the ray.
+       *
+       * @return  The direction of the ray.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE const Vector4f & direction() const noexcept
+      {
+        return fDirection;
+      }
 
+      /*********************************************************************//**
+       * Return the position at the specified distance along the ray.
+       *
+       * @param t The distance along the ray.
+       * @return  The position origin + direction * t.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE Vector4f pointAt(float t) const noexcept
+      {
+        return fOrigin + fDirection * t;
+      }
     };
   }
 }
@@ -250,7 +250,9 @@ namespace Anubis
        * performance as normalise(). The function uses reciprocal square root
        * which allows for the user multiplication instead of a slower division,
        * however the reciprocal is only an approximation and if accuracy is
-       * required, use normalise() instead.
+       * required, use normalise() instead. If ANUBIS_DETERMINISTIC is
+       * defined, the reciprocal square root is not used since it's precision
+       * differs between CPUs, and this is the same as normalise().
        *
        * <B>SSE Version Requirements:</B>
        *
@@ -263,17 +265,12 @@ namespace Anubis
        ************************************************************************/
       ANUBIS_FORCE_INLINE void normaliseFast() noexcept
       {
-        #ifdef ANUBIS_HAS_SSE
+        #if defined(ANUBIS_HAS_SSE) && !defined(ANUBIS_DETERMINISTIC)
           simd128_t reciprocal = _mm_rsqrt_ps(_mm_dp_ps(fSIMD, fSIMD, 0x77));
           fSIMD = _mm_blend_ps(_mm_mul_ps(fSIMD, reciprocal), fSIMD, 0x08);
-        #endif /* ANUBIS_HAS_SSE */
-
-        #ifndef ANUBIS_HAS_SIMD
-          float len = length();
-          fMem[kX] /= len;
-          fMem[kY] /= len;
-          fMem[kZ] /= len;
-        #endif /* ANUBIS_HAS_SIMD */
+        #else
+          normalise();
+        #endif /* ANUBIS_HAS_SSE && !ANUBIS_DETERMINISTIC */
       }
 
       /*********************************************************************//**
@@ -573,6 +570,69 @@ namespace Anubis
         return *this;
       }
 
+      /*********************************************************************//**
+       * Return the component wise minimum of two vectors, including the W
+       * component. Like _mm_min_ps, the rhs component is returned if the
+       * components are equal or either is NaN, so the scalar and SSE builds
+       * agree on the sign of zero.
+       *
+       * @param lhs The first vector.
+       * @param rhs The second vector.
+       * @return    The component wise minimum.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE static Vector4f min(const Vector4f & lhs,
+                                              const Vector4f & rhs) noexcept
+      {
+        /* The result of the function. */
+        Vector4f result;
+
+        #ifdef ANUBIS_HAS_SSE
+          result.fSIMD = _mm_min_ps(lhs.fSIMD, rhs.fSIMD);
+        #endif /* ANUBIS_HAS_SSE */
+
+        #ifndef ANUBIS_HAS_SIMD
+          for(size_t i = 0; i < kComponentCount; i++)
+          {
+            result.fMem[i] = lhs.fMem[i] < rhs.fMem[i] ? lhs.fMem[i] :
+                                                         rhs.fMem[i];
+          }
+        #endif /* ANUBIS_HAS_SIMD */
+
+        /* Return the result of the function. */
+        return result;
+      }
+
+      /*********************************************************************//**
+       * Return the component wise maximum of two vectors, including the W
+       * component. Like _mm_max_ps, the rhs component is returned if the
+       * components are equal or either is NaN.
+       *
+       * @param lhs The first vector.
+       * @param rhs The second vector.
+       * @return    The component wise maximum.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE static Vector4f max(const Vector4f & lhs,
+                                              const Vector4f & rhs) noexcept
+      {
+        /* The result of the function. */
+        Vector4f result;
+
+        #ifdef ANUBIS_HAS_SSE
+          result.fSIMD = _mm_max_ps(lhs.fSIMD, rhs.fSIMD);
+        #endif /* ANUBIS_HAS_SSE */
+
+        #ifndef ANUBIS_HAS_SIMD
+          for(size_t i = 0; i < kComponentCount; i++)
+          {
+            result.fMem[i] = lhs.fMem[i] > rhs.fMem[i] ? lhs.fMem[i] :
+                                                         rhs.fMem[i];
+          }
+        #endif /* ANUBIS_HAS_SIMD */
+
+        /* Return the result of the function. */
+        return result;
+      }
+
       /*********************************************************************//**
        *
        ************************************************************************/
@@ -1,7 +1,15 @@
 #ifndef ANUBIS_NETWORKING_HPP
 #define ANUBIS_NETWORKING_HPP
 
+#include "Networking/Buffer.hpp"
+#include "Networking/IOUring.hpp"
 #include "Networking/IPEndPoint.hpp"
+#include "Networking/PacketPool.hpp"
 #include "Networking/Socket.hpp"
+#include "Networking/SocketAddress.hpp"
+#include "Networking/TCPServer.hpp"
+#include "Networking/UDPConnection.hpp"
+#include "Networking/UDPServer.hpp"
+#include "Networking/UDPShardedServer.hpp"
 
 #endif /* ANUBIS_NETWORKING_HPP */
@@ -0,0 +1,84 @@
+#ifndef ANUBIS_NETWORKING_BUFFER_HPP
+#define ANUBIS_NETWORKING_BUFFER_HPP
+
+#include "../Common/Misc.hpp"
+#include "PacketPool.hpp"
+
+namespace Anubis
+{
+  namespace Networking
+  {
+    /***********************************************************************//**
+     * A view of bytes to send, i.e. a header, a chunk or a payload. A list of
+     * buffers is gathered by the Socket into a single system call, thus the
+     * parts of a message never have to be copied into one vector. The buffer
+     * does not own the bytes, they must stay valid until the call returns.
+     **************************************************************************/
+    struct ConstBuffer
+    {
+      /** The first byte. */
+      const uint8_t * fData;
+
+      /** The number of bytes. */
+      size_t fLen;
+
+      /*********************************************************************//**
+       * Refer to a range of bytes.
+       *
+       * @param data  The first byte.
+       * @param len   The number of bytes.
+       ************************************************************************/
+      ConstBuffer(const void * data, size_t len) :
+        fData(static_cast<const uint8_t*>(data)), fLen(len) {}
+
+      /*********************************************************************//**
+       * Refer to the contents of a vector.
+       *
+       * @param data  The vector.
+       ************************************************************************/
+      ConstBuffer(const std::vector<uint8_t> & data) :
+        fData(data.data()), fLen(data.size()) {}
+
+      /*********************************************************************//**
+       * Refer to the contents of a pooled packet.
+       *
+       * @param packet  The packet.
+       ************************************************************************/
+      ConstBuffer(const PacketPool::Packet & packet) :
+        fData(packet.data()), fLen(packet.size()) {}
+    };
+
+    /***********************************************************************//**
+     * A view of bytes to receive into. A list of buffers is scattered into by
+     * the Socket with a single system call, i.e. to read a fixed size header
+     * and the payload that follows it into diffirent places.
+     **************************************************************************/
+    struct MutableBuffer
+    {
+      /** The first byte. */
+      uint8_t * fData;
+
+      /** The number of bytes. */
+      size_t fLen;
+
+      /*********************************************************************//**
+       * Refer to a range of bytes.
+       *
+       * @param data  The first byte.
+       * @param len   The number of bytes.
+       ************************************************************************/
+      MutableBuffer(void * data, size_t len) :
+        fData(static_cast<uint8_t*>(data)), fLen(len) {}
+
+      /*********************************************************************//**
+       * Refer to the contents of a vector, it's size is not changed.
+       *
+       * @param data  The vector.
+       ************************************************************************/
+      MutableBuffer(std::vector<uint8_t> & data) :
+        fData(data.data()), fLen(data.size()) {}
+    };
+  }
+}
+
+#endif /* ANUBIS_NETWORKING_BUFFER_HPP */
@@ -0,0 +1,121 @@
+#ifndef ANUBIS_NETWORKING_IO_URING_HPP
+#define ANUBIS_NETWORKING_IO_URING_HPP
+
+#include "../Common/Misc.hpp"
+#include "Socket.hpp"
+
+namespace Anubis
+{
+  namespace Networking
+  {
+    /***********************************************************************//**
+     * An io_uring backend for the batched datagram calls of a UDP Socket,
+     * used by the UDPServer on Linux kernels that support it.
+     *
+     * A ring of receive buffers is registered with the kernel once and a
+     * single multishot receive stays armed for the life of the ring, the
+     * kernel picks a buffer for every datagram that arrives and posts a
+     * completion for it. Collecting the datagrams that already arrived thus
+     * costs no system call at all, only waiting for one does. The datagrams
+     * are copied from the registered buffers into the batch's pooled packets
+     * and the buffers are handed straight back to the kernel.
+     *
+     * The sends of a batch are queued as one submission per datagram and
+     * submitted with a single system call. They don't wait for buffer space,
+     * so they are finished when the call returns and the batch can be reused
+     * straight away, and successful sends post no completion.
+     *
+     * The socket is registered as a fixed file too. The receive is armed by
+     * the first recvFromBatch() and it's completions are run by that thread,
+     * thus all the receives must be made by the same thread, sends may be
+     * made by another.
+     **************************************************************************/
+    class IOUring final
+    {
+      /** A class to store the ring and the registered buffers. */
+      struct Data;
+
+      /** The instance of the ring. */
+      std::unique_ptr<Data> fData;
+
+      /*********************************************************************//**
+       * Take over a ring that was set up by create().
+       *
+       * @param data  The ring.
+       ************************************************************************/
+      IOUring(std::unique_ptr<Data> & data);
+
+      /** Delete the copy constructor. */
+      IOUring(const IOUring &) = delete;
+
+      /** Delete the assignment operator. */
+      IOUring & operator = (const IOUring &) = delete;
+
+    public:
+      /*********************************************************************//**
+       * Check once if the kernel supports the features the ring requires,
+       * i.e. registered buffer rings and multishot receives (Linux 6.0).
+       *
+       * @return  True if a ring can be created, else false.
+       ************************************************************************/
+      static bool isSupported();
+
+      /*********************************************************************//**
+       * Create a ring for a bound UDP socket.
+       *
+       * @param socket    The socket, it must outlive the ring.
+       * @param maxPktLen The length of the receive buffers, longer datagrams
+       *                  are truncated.
+       * @param batchSize The maximum number of datagrams per batch.
+       * @return          The ring, or nullptr if io_uring is not supported,
+       *                  in which case the socket's own calls must be used.
+       ************************************************************************/
+      static std::unique_ptr<IOUring> create(Socket & socket, size_t maxPktLen,
+                                             size_t batchSize);
+
+      /*********************************************************************//**
+       * Cancel the receive and close the ring.
+       ************************************************************************/
+      ~IOUring();
+
+      /*********************************************************************//**
+       * Collect the datagrams that were received, up to the batch's capacity,
+       * like Socket::recvFromBatch().
+       *
+       * @param batch The batch to receive into, it's cleared first.
+       * @param wait  Block until at least one datagram arrives if true, else
+       *              return straight away.
+       * @return      The number of datagrams received, 0 if the receive was
+       *              woken by wake().
+       ************************************************************************/
+      size_t recvFromBatch(DatagramBatch & batch, bool wait = true);
+
+      /*********************************************************************//**
+       * Wake the thread that is blocked in recvFromBatch(), or the next one
+       * to call it if none is, from any other thread.
+       ************************************************************************/
+      void wake();
+
+      /*********************************************************************//**
+       * Send all the datagrams of a batch with a single submission, like
+       * Socket::sendToBatch().
+       *
+       * @param batch The datagrams, at most batchSize.
+       * @return      The number of datagrams submitted. The ones the socket
+       *              has no room for are dropped like any other lost
+       *              datagram.
+       ************************************************************************/
+      size_t sendToBatch(const DatagramBatch & batch);
+
+      /*********************************************************************//**
+       * Return the number of system calls made by the ring, i.e. to compare
+       * it with the other backends.
+       *
+       * @return  The number of calls to io_uring_enter().
+       ************************************************************************/
+      size_t getSysCalls() const;
+    };
+  }
+}
+
+#endif /* ANUBIS_NETWORKING_IO_URING_HPP */
@@ -7,9 +7,11 @@ namespace Anubis
 {
   namespace Networking
   {
-    /** Forward declare the the socket class so it can be made a friend of the
-     * IPEndPoint class. */
+    /** Forward declare the the socket, datagram batch and socket address
+     * classes so they can be made friends of the IPEndPoint class. */
     class Socket;
+    class DatagramBatch;
+    class SocketAddress;
 
     /***********************************************************************//**
      * A class for containing the address information of an IP End Point. The
@@ -22,6 +24,12 @@ namespace Anubis
        * dangerouse functions and memory has to be exposed). */
       friend class Socket;
 
+      /** The datagram batches store the address data of their peers. */
+      friend class DatagramBatch;
+
+      /** The socket addresses are copies of the address data. */
+      friend class SocketAddress;
+
       /** The number of octets (uint8_t / bytes) in an IPv4 Address. */
       static const size_t kIPv4OctetCount = 4;
 
@@ -0,0 +1,313 @@
+#ifndef ANUBIS_NETWORKING_PACKET_POOL_HPP
+#define ANUBIS_NETWORKING_PACKET_POOL_HPP
+
+#include "../Common/Misc.hpp"
+
+namespace Anubis
+{
+  namespace Networking
+  {
+    /***********************************************************************//**
+     * A pool of fixed size packet buffers, i.e. one MTU sized buffer per
+     * datagram. Memory is requested from the allocator in slabs of slabCount
+     * buffers and is never returned to it until the pool is destroyed.
+     * Released buffers are placed on an intrusive free list and recycled by
+     * the next acquire(), thus once the pool has grown to the peak number of
+     * packets in flight (or reserve() was called), no packet touches the heap.
+     *
+     * The buffers are handed out as reference counted Packet handles, copying
+     * a handle only increments the count, thus queues and sockets pass packets
+     * around without copying the bytes. The last handle returns the buffer to
+     * the pool. acquire() and the release of the last handle are thread safe,
+     * so packets may be received on one thread and consumed on another, but a
+     * single handle must not be shared between threads without locking. The
+     * pool must outlive all of it's packets.
+     **************************************************************************/
+    class PacketPool final
+    {
+      /*********************************************************************//**
+       * The header in front of every buffer in a slab.
+       ************************************************************************/
+      struct Header
+      {
+        /** The number of handles that refer to the buffer. */
+        std::atomic<uint32_t> fRefs;
+
+        /** The length of the packet in bytes. */
+        uint32_t fLen;
+
+        /** The pool that the buffer belongs too. */
+        PacketPool * fPool;
+
+        /** The next free buffer when this buffer is on the free list. */
+        Header * fNext;
+      };
+
+    public:
+      /*********************************************************************//**
+       * A reference counted handle to a buffer of the pool. A default
+       * constructed handle refers to no buffer.
+       ************************************************************************/
+      class Packet final
+      {
+        friend class PacketPool;
+
+        /** The header of the buffer, or nullptr. */
+        Header * fHeader;
+
+        /*******************************************************************//**
+         * Take over a reference to the buffer.
+         *
+         * @param header  The header of the buffer.
+         **********************************************************************/
+        explicit Packet(Header * header) : fHeader(header) {}
+
+      public:
+        /*******************************************************************//**
+         * Create a handle that refers to no buffer.
+         **********************************************************************/
+        Packet() : fHeader(nullptr) {}
+
+        /*******************************************************************//**
+         * Add a reference to the buffer of cp.
+         *
+         * @param cp  The handle to copy.
+         **********************************************************************/
+        Packet(const Packet & cp) : fHeader(cp.fHeader)
+        {
+          if(fHeader)
+          {
+            fHeader->fRefs.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+
+        /*******************************************************************//**
+         * Take the reference of mv, which is left empty.
+         *
+         * @param mv  The handle to move.
+         **********************************************************************/
+        Packet(Packet && mv) noexcept : fHeader(mv.fHeader)
+        {
+          mv.fHeader = nullptr;
+        }
+
+        /*******************************************************************//**
+         * Release the reference to the buffer.
+         **********************************************************************/
+        ~Packet()
+        {
+          reset();
+        }
+
+        /*******************************************************************//**
+         * Refer to the buffer of rhs instead.
+         *
+         * @param rhs The handle to copy.
+         * @return    This handle.
+         **********************************************************************/
+        Packet & operator = (const Packet & rhs)
+        {
+          Packet(rhs).swap(*this);
+          return *this;
+        }
+
+        /*******************************************************************//**
+         * Take the reference of rhs instead, which is left empty.
+         *
+         * @param rhs The handle to move.
+         * @return    This handle.
+         **********************************************************************/
+        Packet & operator = (Packet && rhs) noexcept
+        {
+          Packet(std::move(rhs)).swap(*this);
+          return *this;
+        }
+
+        /*******************************************************************//**
+         * Exchange the buffers of two handles.
+         *
+         * @param other The other handle.
+         **********************************************************************/
+        ANUBIS_FORCE_INLINE void swap(Packet & other) noexcept
+        {
+          std::swap(fHeader, other.fHeader);
+        }
+
+        /*******************************************************************//**
+         * Release the reference to the buffer, the handle is left empty.
+         **********************************************************************/
+        void reset();
+
+        /*******************************************************************//**
+         * Check if the handle refers to a buffer.
+         *
+         * @return  True if the handle refers to a buffer, else false.
+         **********************************************************************/
+        ANUBIS_FORCE_INLINE explicit operator bool () const
+        {
+          return fHeader != nullptr;
+        }
+
+        /*******************************************************************//**
+         * Check if this is the only handle of the buffer, thus it's safe to
+         * write too.
+         *
+         * @return  True if the buffer is not shared, else false.
+         **********************************************************************/
+        ANUBIS_FORCE_INLINE bool unique() const
+        {
+          return fHeader &&
+                 fHeader->fRefs.load(std::memory_order_acquire) == 1;
+        }
+
+        /*******************************************************************//**
+         * Return the bytes of the packet.
+         *
+         * @return  The first byte of the buffer.
+         **********************************************************************/
+        ANUBIS_FORCE_INLINE uint8_t * data()
+        {
+          return reinterpret_cast<uint8_t*>(fHeader + 1);
+        }
+
+        /*******************************************************************//**
+         * Return the bytes of the packet.
+         *
+         * @return  The first byte of the buffer.
+         **********************************************************************/
+        ANUBIS_FORCE_INLINE const uint8_t * data() const
+        {
+          return reinterpret_cast<const uint8_t*>(fHeader + 1);
+        }
+
+        /*******************************************************************//**
+         * Return the length of the packet.
+         *
+         * @return  The length in bytes, 0 for an empty handle.
+         **********************************************************************/
+        ANUBIS_FORCE_INLINE size_t size() const
+        {
+          return fHeader ? fHeader->fLen : 0;
+        }
+
+        /*******************************************************************//**
+         * Return the size of the buffer, i.e. the longest possible packet.
+         *
+         * @return  The size in bytes, 0 for an empty handle.
+         **********************************************************************/
+        size_t capacity() const;
+
+        /*******************************************************************//**
+         * Set the length of the packet. The bytes are not touched.
+         *
+         * @param len The new length, at most capacity().
+         **********************************************************************/
+        ANUBIS_FORCE_INLINE void resize(size_t len)
+        {
+          assert(len <= capacity() && "Packet length exceeds the buffer.");
+          fHeader->fLen = uint32_t(len);
+        }
+      };
+
+    private:
+      /** The size of every buffer in bytes. */
+      const size_t kBufferLen;
+
+      /** The distance between two headers in a slab. */
+      const size_t kStride;
+
+      /** The number of buffers per slab. */
+      const size_t kSlabCount;
+
+      /** All the slabs that have been allocated. */
+      std::vector<std::unique_ptr<uint8_t[]>> fSlabs;
+
+      /** The head of the list of free buffers. */
+      Header * fFreeList;
+
+      /** The number of buffers that are in use. */
+      size_t fCount;
+
+      /** The lock of the free list and the slabs. */
+      std::mutex fMutex;
+
+      /** Delete the copy constructor. */
+      PacketPool(const PacketPool &) = delete;
+
+      /** Delete the assignment operator. */
+      PacketPool & operator = (const PacketPool &) = delete;
+
+      /*********************************************************************//**
+       * Allocate another slab and put it's buffers on the free list. The
+       * mutex must be held.
+       ************************************************************************/
+      void grow();
+
+      /*********************************************************************//**
+       * Return a buffer to the free list, called by the last handle.
+       *
+       * @param header  The header of the buffer.
+       ************************************************************************/
+      void release(Header * header);
+
+    public:
+      /*********************************************************************//**
+       * Create an empty pool. No memory is allocated until the first packet
+       * is acquired or reserve() is called.
+       *
+       * @param bufferLen The size of every buffer, the default of 512 matches
+       *                  the UDPServer's default packet length.
+       * @param slabCount The number of buffers allocated at a time.
+       ************************************************************************/
+      PacketPool(size_t bufferLen = 512, size_t slabCount = 256);
+
+      /*********************************************************************//**
+       * Release all the slabs. All the packets must have been released.
+       ************************************************************************/
+      ~PacketPool();
+
+      /*********************************************************************//**
+       * Make sure that at least count packets can be in use without the pool
+       * having to request memory from the allocator.
+       *
+       * @param count The number of packets to reserve space for.
+       ************************************************************************/
+      void reserve(size_t count);
+
+      /*********************************************************************//**
+       * Return an unused buffer, the pool only grows if all the buffers are in
+       * use. The packet's length is set to 0.
+       *
+       * @return  The handle of the buffer.
+       ************************************************************************/
+      Packet acquire();
+
+      /*********************************************************************//**
+       * Return the size of every buffer.
+       *
+       * @return  The size in bytes.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t getBufferLen() const
+      {
+        return kBufferLen;
+      }
+
+      /*********************************************************************//**
+       * Return the number of buffers that are in use.
+       *
+       * @return  The number of buffers referred to by a handle.
+       ************************************************************************/
+      size_t size();
+
+      /*********************************************************************//**
+       * Return the number of buffers that can be in use without allocating
+       * another slab.
+       *
+       * @return  The capacity of the pool.
+       ************************************************************************/
+      size_t capacity();
+    };
+  }
+}
+
+#endif /* ANUBIS_NETWORKING_PACKET_POOL_HPP */
@@ -2,12 +2,196 @@
 #define ANUBIS_NETWORK_SOCKET_HPP
 
 #include "../Common.hpp"
+#include "Buffer.hpp"
 #include "IPEndPoint.hpp"
+#include "PacketPool.hpp"
+#include "SocketAddress.hpp"
 
 namespace Anubis
 {
   namespace Networking
   {
+    /***********************************************************************//**
+     * A set of datagrams that a Socket receives or sends with a single system
+     * call where the platform supports it, i.e. recvmmsg() and sendmmsg() on
+     * Linux. Elsewhere the datagrams are moved one call at a time. Every
+     * datagram is a packet of a PacketPool and has room for the address of
+     * it's peer, thus a batch never allocates once it's created.
+     *
+     * Received packets are handed out with take() without copying them, the
+     * next receive refills the slot from the pool. Packets that are pushed
+     * for sending are referenced, not copied, and stay referenced until the
+     * slot is reused.
+     **************************************************************************/
+    class DatagramBatch final
+    {
+      /** The socket reads and writes the datagrams directly. */
+      friend class Socket;
+
+      /** A class to store the platform specific message headers. */
+      struct Data;
+
+      /** The instance of the platform specific data. */
+      std::unique_ptr<Data> fData;
+
+      /** The pool that the packets come from. */
+      PacketPool & fPool;
+
+      /** The maximum number of datagrams in the batch. */
+      const size_t kCapacity;
+
+      /** The number of datagrams in the batch. */
+      size_t fCount;
+
+      /** The packets of the datagrams, the length of a packet is the length
+       * of it's datagram. */
+      std::vector<PacketPool::Packet> fPackets;
+
+      DatagramBatch(const DatagramBatch &) = delete;
+      DatagramBatch & operator = (const DatagramBatch &) = delete;
+
+      /*********************************************************************//**
+       * Make sure that a slot holds a packet that nobody else refers too, so
+       * it can be received into.
+       *
+       * @param index The index of the slot.
+       * @return      The packet of the slot.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE PacketPool::Packet & writable(size_t index)
+      {
+        if(!fPackets[index].unique())
+        {
+          fPackets[index] = fPool.acquire();
+        }
+        return fPackets[index];
+      }
+
+    public:
+      /*********************************************************************//**
+       * Create an empty batch. The datagrams longer than the pool's buffers
+       * are truncated when received.
+       *
+       * @param pool      The pool of the packets, it must outlive the batch.
+       * @param capacity  The maximum number of datagrams in the batch.
+       ************************************************************************/
+      DatagramBatch(PacketPool & pool, size_t capacity);
+
+      /*********************************************************************//**
+       * Release the packets of the batch.
+       ************************************************************************/
+      ~DatagramBatch();
+
+      /*********************************************************************//**
+       * Return the maximum number of datagrams in the batch.
+       *
+       * @return  The capacity of the batch.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t capacity() const
+      {
+        return kCapacity;
+      }
+
+      /*********************************************************************//**
+       * Return the number of datagrams in the batch.
+       *
+       * @return  The number of datagrams.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t size() const
+      {
+        return fCount;
+      }
+
+      /*********************************************************************//**
+       * Return true if the batch can't hold another datagram.
+       *
+       * @return  True if the batch is full, else false.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE bool full() const
+      {
+        return fCount == kCapacity;
+      }
+
+      /*********************************************************************//**
+       * Remove all the datagrams from the batch.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE void clear()
+      {
+        fCount = 0;
+      }
+
+      /*********************************************************************//**
+       * Return the payload of a datagram.
+       *
+       * @param index The index of the datagram.
+       * @return      The first byte of the payload.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE const uint8_t * data(size_t index) const
+      {
+        return fPackets[index].data();
+      }
+
+      /*********************************************************************//**
+       * Return the length of a datagram's payload.
+       *
+       * @param index The index of the datagram.
+       * @return      The length in bytes.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t length(size_t index) const
+      {
+        return fPackets[index].size();
+      }
+
+      /*********************************************************************//**
+       * Take the packet of a received datagram out of the batch without
+       * copying it.
+       *
+       * @param index The index of the datagram.
+       * @return      The packet, it's length is the datagram's length.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE PacketPool::Packet take(size_t index)
+      {
+        return std::move(fPackets[index]);
+      }
+
+      /*********************************************************************//**
+       * Return the peer of a datagram, i.e. the sender of a received datagram.
+       *
+       * @param index The index of the datagram.
+       * @return      The end point of the peer.
+       ************************************************************************/
+      IPEndPoint endPoint(size_t index) const;
+
+      /*********************************************************************//**
+       * Return the address of a datagram's peer without allocating, i.e. to
+       * find the client that sent a received datagram.
+       *
+       * @param index The index of the datagram.
+       * @return      The address of the peer.
+       ************************************************************************/
+      SocketAddress address(size_t index) const;
+
+      /*********************************************************************//**
+       * Append a copy of a datagram to the batch.
+       *
+       * @param ep    The address to send the datagram too.
+       * @param data  The payload.
+       * @param len   The length of the payload.
+       * @return      True if the datagram was added, false if the batch is
+       *              full or the payload is longer than the pool's buffers.
+       ************************************************************************/
+      bool push(const SocketAddress & ep, const uint8_t * data, size_t len);
+
+      /*********************************************************************//**
+       * Append a datagram to the batch without copying it's payload.
+       *
+       * @param ep      The address to send the datagram too.
+       * @param packet  The payload.
+       * @return        True if the datagram was added, false if the batch is
+       *                full.
+       ************************************************************************/
+      bool push(const SocketAddress & ep, const PacketPool::Packet & packet);
+    };
+
     /***********************************************************************//**
      * A wrapper class around the sockets() layer to abstract away Winsock and
      * Posix socket interfaces. This class is designed to only work with IP
@@ -21,9 +205,21 @@ namespace Anubis
       /** The instance of the platform specific data. */
       std::unique_ptr<Data> fData;
 
+      /** The io_uring backend submits the socket's calls itself. */
+      friend class IOUring;
+
+      /** The sharded UDP server sets the socket options of it's shards. */
+      friend class UDPShardedServer;
 
       Socket(std::unique_ptr<Data> & data);
 
+      /*********************************************************************//**
+       * Return the OS handle of the socket.
+       *
+       * @return  The handle, i.e. the file descriptor.
+       ************************************************************************/
+      intptr_t getHandle() const;
+
     public:
 
       /** The list of supported Socket Types. */
@@ -42,6 +238,10 @@ namespace Anubis
         IPv6  = 6
       };
 
+      /** The maximum number of buffers that make up a datagram, the stream
+       * calls accept any number and gather this many per system call. */
+      static const size_t kMaxBuffers = 16;
+
       /*********************************************************************//**
        * Create a socket using the specified socket type and IP version. If
        * useIPv4 == true, then an IPv4 socket is created, if useIPv4 == false,
@@ -86,10 +286,59 @@ namespace Anubis
 
       void shutdown();
 
+      /*********************************************************************//**
+       * Stop receiving on the socket. A thread that is blocked in a receive
+       * returns straight away, as do all later receives.
+       ************************************************************************/
+      void shutdownRecv();
+
       bool send(const std::vector<uint8_t> & data);
 
       bool recv(std::vector<uint8_t> & data, size_t len);
 
+      /*********************************************************************//**
+       * Used by TCP sockets to send all the bytes of a range.
+       *
+       * @param data  The first byte.
+       * @param len   The number of bytes.
+       * @return      True if the bytes were sent, else false if the connection
+       *              was closed.
+       ************************************************************************/
+      bool send(const uint8_t * data, size_t len);
+
+      /*********************************************************************//**
+       * Used by TCP sockets to send all the bytes of a list of buffers, i.e. a
+       * header followed by a payload, gathered with as few system calls as
+       * possible and without copying them.
+       *
+       * @param buffers The buffers to send in order.
+       * @param count   The number of buffers.
+       * @return        True if the bytes were sent, else false if the
+       *                connection was closed.
+       ************************************************************************/
+      bool send(const ConstBuffer * buffers, size_t count);
+
+      /*********************************************************************//**
+       * Used by TCP sockets to recieve exactly len bytes into a range.
+       *
+       * @param data  The first byte to recieve into.
+       * @param len   The number of bytes.
+       * @return      True if all the bytes were recieved, else false if the
+       *              connection was closed.
+       ************************************************************************/
+      bool recv(uint8_t * data, size_t len);
+
+      /*********************************************************************//**
+       * Used by TCP sockets to fill a list of buffers in order, scattered with
+       * as few system calls as possible.
+       *
+       * @param buffers The buffers to recieve into.
+       * @param count   The number of buffers.
+       * @return        True if all the buffers were filled, else false if the
+       *                connection was closed.
+       ************************************************************************/
+      bool recv(const MutableBuffer * buffers, size_t count);
+
       /*********************************************************************//**
        * Use by UDP sockets to send a single datagram to a peer specified by
        * ep.
@@ -115,6 +364,138 @@ namespace Anubis
        ************************************************************************/
       bool recvFrom(IPEndPoint & ep, std::vector<uint8_t> & data,
                     size_t maxLen);
+
+      /*********************************************************************//**
+       * Used by UDP sockets to send a single pooled packet to a peer. An
+       * IPEndPoint converts to the address without allocating.
+       *
+       * @param addr    The address to send the datagram too.
+       * @param packet  The datagram.
+       * @return        True if the datagram was sent, else false if the
+       *                socket was shutdown.
+       ************************************************************************/
+      bool sendTo(const SocketAddress & addr,
+                  const PacketPool::Packet & packet);
+
+      /*********************************************************************//**
+       * Used by UDP sockets to send a single datagram from a range of bytes.
+       *
+       * @param addr  The address to send the datagram too.
+       * @param data  The first byte of the datagram.
+       * @param len   The length of the datagram.
+       * @return      True if the datagram was sent, else false if the socket
+       *              was shutdown.
+       ************************************************************************/
+      bool sendTo(const SocketAddress & addr, const uint8_t * data,
+                  size_t len);
+
+      /*********************************************************************//**
+       * Used by UDP sockets to send a single datagram that is gathered from a
+       * list of buffers, i.e. a header, chunks and a payload, without copying
+       * them.
+       *
+       * @param addr    The address to send the datagram too.
+       * @param buffers The parts of the datagram in order.
+       * @param count   The number of buffers, at most kMaxBuffers.
+       * @return        True if the datagram was sent, else false if the
+       *                socket was shutdown.
+       ************************************************************************/
+      bool sendTo(const SocketAddress & addr, const ConstBuffer * buffers,
+                  size_t count);
+
+      /*********************************************************************//**
+       * Used by UDP sockets to recieve a single whole datagram straight into
+       * a pooled packet, without allocating.
+       *
+       * @param ep      Used to return IPEndPoint of the peer that send the
+       *                datagram that was recieved.
+       * @param packet  A packet that nobody else refers too, i.e. one that was
+       *                just acquired. It's length is set to the length of the
+       *                datagram, longer datagrams are truncated.
+       * @return        True if a datagram was recieved, else false if the
+       *                socket was shutdown.
+       ************************************************************************/
+      bool recvFrom(IPEndPoint & ep, PacketPool::Packet & packet);
+
+      /*********************************************************************//**
+       * Used for UDP sockets to recieve a single whole datagram into a range
+       * of bytes.
+       *
+       * @param ep      Used to return IPEndPoint of the peer that send the
+       *                datagram that was recieved.
+       * @param data    The first byte to recieve into.
+       * @param maxLen  The size of the range, longer datagrams are truncated.
+       * @param len     Used to return the length of the datagram.
+       * @return        True if a datagram was recieved, else false if the
+       *                socket was shutdown.
+       ************************************************************************/
+      bool recvFrom(IPEndPoint & ep, uint8_t * data, size_t maxLen,
+                    size_t & len);
+
+      /*********************************************************************//**
+       * Used for UDP sockets to recieve a single whole datagram that is
+       * scattered over a list of buffers in order.
+       *
+       * @param ep      Used to return IPEndPoint of the peer that send the
+       *                datagram that was recieved.
+       * @param buffers The buffers to recieve into.
+       * @param count   The number of buffers, at most kMaxBuffers.
+       * @param len     Used to return the length of the datagram.
+       * @return        True if a datagram was recieved, else false if the
+       *                socket was shutdown.
+       ************************************************************************/
+      bool recvFrom(IPEndPoint & ep, const MutableBuffer * buffers,
+                    size_t count, size_t & len);
+
+      /*********************************************************************//**
+       * Used for UDP sockets to recieve a single whole datagram that is
+       * scattered over a list of buffers, without allocating.
+       *
+       * @param addr    Used to return the address of the peer that send the
+       *                datagram that was recieved.
+       * @param buffers The buffers to recieve into.
+       * @param count   The number of buffers, at most kMaxBuffers.
+       * @param len     Used to return the length of the datagram.
+       * @return        True if a datagram was recieved, else false if the
+       *                socket was shutdown.
+       ************************************************************************/
+      bool recvFrom(SocketAddress & addr, const MutableBuffer * buffers,
+                    size_t count, size_t & len);
+
+      /*********************************************************************//**
+       * Used for UDP sockets to recieve a single whole datagram straight into
+       * a pooled packet, without allocating.
+       *
+       * @param addr    Used to return the address of the peer that send the
+       *                datagram that was recieved.
+       * @param packet  A packet that nobody else refers too. It's length is
+       *                set to the length of the datagram.
+       * @return        True if a datagram was recieved, else false if the
+       *                socket was shutdown.
+       ************************************************************************/
+      bool recvFrom(SocketAddress & addr, PacketPool::Packet & packet);
+
+      /*********************************************************************//**
+       * Used by UDP sockets to receive as many datagrams as the batch can
+       * hold with a single system call. The batch is cleared first.
+       *
+       * @param batch Used to return the datagrams and their peers.
+       * @param wait  Block until at least one datagram arrives if true, else
+       *              return straight away.
+       * @return      The number of datagrams received.
+       ************************************************************************/
+      size_t recvFromBatch(DatagramBatch & batch, bool wait = true);
+
+      /*********************************************************************//**
+       * Used by UDP sockets to send all the datagrams of a batch to their
+       * peers with as few system calls as possible. A datagram whose peer
+       * can't be reached is dropped with a warning and the rest are sent.
+       *
+       * @param batch The datagrams to send.
+       * @return      The number of datagrams sent, less than the batch size
+       *              if the socket would block or peers can't be reached.
+       ************************************************************************/
+      size_t sendToBatch(const DatagramBatch & batch);
     };
   }
 }
@@ -0,0 +1,196 @@
+#ifndef ANUBIS_NETWORKING_SOCKET_ADDRESS_HPP
+#define ANUBIS_NETWORKING_SOCKET_ADDRESS_HPP
+
+#include "../Common/Misc.hpp"
+#include "IPEndPoint.hpp"
+
+namespace Anubis
+{
+  namespace Networking
+  {
+    /***********************************************************************//**
+     * A lightweight, trivially copyable IP address and port, used on the hot
+     * path instead of an IPEndPoint, which allocates and starts the socket
+     * library for every copy. The OS specific address is stored inline and
+     * normalised (only the family, port, address and IPv6 scope are kept,
+     * everything else is zero), thus two addresses are compared and hashed
+     * as plain bytes, i.e. to find the client of a received datagram in an
+     * std::unordered_map without allocating.
+     **************************************************************************/
+    class SocketAddress final
+    {
+      /** The socket reads and writes the address data directly. */
+      friend class Socket;
+
+      /** The datagram batches store the address data of their peers. */
+      friend class DatagramBatch;
+
+      /** The TCP server stores the address data of it's clients. */
+      friend class TCPServer;
+
+      /** The io_uring backend reads the addresses of received datagrams. */
+      friend class IOUring;
+
+    public:
+      /** The size of the inline storage, enough for an IPv6 address. */
+      static const size_t kStorageLen = 28;
+
+    private:
+      /** The normalised OS specific address data. */
+      alignas(8) uint8_t fStorage[kStorageLen];
+
+      /** The length of the OS specific address data, 0 if empty. */
+      uint32_t fLen;
+
+      /*********************************************************************//**
+       * Copy and normalise OS specific address data.
+       *
+       * @param addrData  The address data, i.e. a sockaddr_in.
+       * @param dataLen   The length of the address data.
+       ************************************************************************/
+      SocketAddress(const void * addrData, size_t dataLen);
+
+    public:
+      /*********************************************************************//**
+       * Create an empty address.
+       ************************************************************************/
+      SocketAddress() : fStorage(), fLen(0) {}
+
+      /*********************************************************************//**
+       * Copy the address of an end point. The node name is not kept.
+       *
+       * @param ep  The end point.
+       ************************************************************************/
+      SocketAddress(const IPEndPoint & ep);
+
+      /*********************************************************************//**
+       * Create an end point of the address, i.e. to print it. This allocates,
+       * thus it's not meant for the hot path.
+       *
+       * @return  The end point.
+       ************************************************************************/
+      IPEndPoint toEndPoint() const;
+
+      /*********************************************************************//**
+       * Return the OS specific address data.
+       *
+       * @return  The pointer to the address data.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE const uint8_t * addrData() const
+      {
+        return fStorage;
+      }
+
+      /*********************************************************************//**
+       * Return the length of the OS specific address data.
+       *
+       * @return  The length of the address data, 0 if empty.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t addrDataLen() const
+      {
+        return fLen;
+      }
+
+      /*********************************************************************//**
+       * Check if the address is empty.
+       *
+       * @return  True if no address is stored, else false.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE bool empty() const
+      {
+        return fLen == 0;
+      }
+
+      /*********************************************************************//**
+       * Check if the address is an IPv4 address.
+       *
+       * @return  True if an IPv4 address is stored, else false.
+       ************************************************************************/
+      bool isIPv4() const;
+
+      /*********************************************************************//**
+       * Check if the address is an IPv6 address.
+       *
+       * @return  True if an IPv6 address is stored, else false.
+       ************************************************************************/
+      bool isIPv6() const;
+
+      /*********************************************************************//**
+       * Return the port, which is at the same place for both IP versions.
+       *
+       * @return  The port number.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE uint16_t port() const
+      {
+        return uint16_t(fStorage[2] << 8 | fStorage[3]);
+      }
+
+      /*********************************************************************//**
+       * Compare two addresses.
+       *
+       * @param rhs The address to compare too.
+       * @return    True if the family, port and address match.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE bool operator == (const SocketAddress & rhs) const
+      {
+        return fLen == rhs.fLen &&
+               memcmp(fStorage, rhs.fStorage, kStorageLen) == 0;
+      }
+
+      /*********************************************************************//**
+       * Compare two addresses.
+       *
+       * @param rhs The address to compare too.
+       * @return    True if the addresses differ.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE bool operator != (const SocketAddress & rhs) const
+      {
+        return !(*this == rhs);
+      }
+
+      /*********************************************************************//**
+       * Calculate a hash of the address suitable for hash tables. The storage
+       * is folded into a 64 bit value and then mixed, like the UUID's hash.
+       *
+       * @return  The hash of the address.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t hash() const noexcept
+      {
+        /* Fold the storage together, an IPv4 address only uses the first
+         * word. */
+        uint64_t a, b, c;
+        uint32_t d;
+        memcpy(&a, fStorage, sizeof(uint64_t));
+        memcpy(&b, fStorage + 8, sizeof(uint64_t));
+        memcpy(&c, fStorage + 16, sizeof(uint64_t));
+        memcpy(&d, fStorage + 24, sizeof(uint32_t));
+        uint64_t h = a ^ (b * 0x9E3779B97F4A7C15ULL) ^
+                     (c * 0xC2B2AE3D27D4EB4FULL) ^
+                     (uint64_t(d) * 0x165667B19E3779F9ULL);
+
+        /* Mix the bits (splitmix64 finaliser). */
+        h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+        return static_cast<size_t>(h ^ (h >> 31));
+      }
+    };
+  }
+}
+
+/***************************************************************************//**
+ * Hash socket addresses with their own hash, so they can be used as the keys
+ * of standard unordered containers.
+ ******************************************************************************/
+namespace std
+{
+  template <> struct hash<Anubis::Networking::SocketAddress>
+  {
+    size_t operator () (const Anubis::Networking::SocketAddress & addr) const
+      noexcept
+    {
+      return addr.hash();
+    }
+  };
+}
+
+#endif /* ANUBIS_NETWORKING_SOCKET_ADDRESS_HPP */
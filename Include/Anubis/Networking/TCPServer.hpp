@@ -3,72 +3,219 @@
 
 #include "../Common.hpp"
 #include "Socket.hpp"
+#include "SocketAddress.hpp"
+
+#include <unordered_map>
 
 namespace Anubis
 {
   namespace Networking
   {
-    class TCPServer
+    /***********************************************************************//**
+     * A TCP server that serves many mostly idle connections with a small,
+     * fixed number of IO threads instead of threads per connection.
+     *
+     * Every IO thread owns an epoll instance. The sockets are non-blocking
+     * and registered edge-triggered for reading and writing once, thus the
+     * threads sleep until a connection has new data or room to write and
+     * never touch epoll on the hot path. New connections are accepted by the
+     * first IO thread and spread over the threads round robin.
+     *
+     * The bytes that are received are handed to the data handler on the
+     * connection's IO thread, straight out of a per thread buffer. The
+     * handler returns how many bytes it consumed, i.e. the complete messages,
+     * and only the rest is kept by the connection, so an idle connection
+     * holds no buffers. Connections that buffer more than maxBuffered
+     * unconsumed bytes are disconnected.
+     *
+     * send() may be called from any thread. It writes straight to the socket
+     * and only buffers what the socket doesn't take, the IO thread writes the
+     * rest once the socket drains. A connection never buffers more than
+     * maxBuffered bytes to send, send() returns false instead, which is the
+     * backpressure signal to slow down or to drop the client.
+     *
+     * The server is only implemented with epoll, i.e. on Linux.
+     **************************************************************************/
+    class TCPServer final
     {
-      struct Client
-      {
-        /** Define the maximum queue length for packet reception. */
-        static const size_t kMaxRxQueueLen = 4096;
-
-        /** Define the maximum queue length for packet transmission. */
-        static const size_t kMaxTxQueueLen = 4096;
+    public:
+      /** The identifier of a connection, never reused by a server. */
+      typedef uint64_t ConnectionID;
 
-        /** The unique ID of the connected client. This can be used to uniquely
-         * identify a user. */
-        Common::UUID fID;
+      /** Called on an IO thread when a client connected, before any of it's
+       * data is handled. */
+      typedef std::function<void(ConnectionID id, const SocketAddress & peer)>
+        ConnectHandler;
 
-        /** The name of the connected client. */
-        std::string fName;
+      /** Called on the connection's IO thread with all the unconsumed bytes
+       * of the connection, returns the number of bytes it consumed. */
+      typedef std::function<size_t(ConnectionID id, const uint8_t * data,
+                                   size_t len)> DataHandler;
 
-        /** The socket of the connected client. */
-        std::unique_ptr<Socket> fSocket;
+      /** Called on the connection's IO thread once a connection is closed,
+       * no more data is handled for it afterwards. */
+      typedef std::function<void(ConnectionID id)> DisconnectHandler;
 
-        /** The queue where all the recieved packets are stored. */
-        Common::CircularQueue<std::vector<uint8_t>, kMaxRxQueueLen> fRxQueue;
+    private:
+      /** The state of a connection. */
+      struct Connection;
 
-        /** The circular queue where all the tx packets are stored. */
-        Common::CircularQueue<std::vector<uint8_t>, kMaxTxQueueLen> fTxQueue;
+      /** An IO thread and it's epoll instance. */
+      struct Worker;
 
-        /** The mutex used to control access to the Rx queue. */
-        std::mutex fRxMutex;
+      /** The handlers of the connection events. */
+      ConnectHandler fOnConnect;
+      DataHandler fOnData;
+      DisconnectHandler fOnDisconnect;
 
-        /** The mutex used to control access to the client queue. */
+      /** The maximum number of bytes a connection buffers per direction. */
+      const size_t kMaxBuffered;
 
-        /** The thread used to read data from the client. */
-        std::thread fRxThread;
+      /** The handle of the listen socket. */
+      int fListenHandle;
 
-        /** The thread used to write data to the client. */
-        std::thread fTxThread;
+      /** The local end point of the listen socket. */
+      SocketAddress fLocalAddr;
 
-      public:
+      /** The IO threads. */
+      std::vector<std::unique_ptr<Worker>> fWorkers;
 
-        Client(std::unique_ptr<Socket> & socket);
-        ~Client();
-      };
+      /** The open connections by ID. */
+      std::unordered_map<ConnectionID, std::shared_ptr<Connection>>
+        fConnections;
 
-      /** The socket to listen on for new connections. */
-      std::unique_ptr<Socket> fListenSocket;
+      /** The lock of the connections. */
+      mutable std::mutex fMutex;
 
-      /** The list of connected clients. */
-      std::vector<std::unique_ptr<Client>> fClients;
+      /** The ID of the next connection. */
+      ConnectionID fNextID;
 
-      std::thread fThread;
+      /** The IO thread that gets the next connection. */
+      size_t fNextWorker;
 
+      /** Cleared to stop the IO threads. */
       std::atomic_bool fIsExecuting;
 
-      /** The monitoring thread. */
-      void listenThread();
+      /** Delete the copy constructor. */
+      TCPServer(const TCPServer &) = delete;
+
+      /** Delete the assignment operator. */
+      TCPServer & operator = (const TCPServer &) = delete;
+
+      /*********************************************************************//**
+       * Wait for and handle the events of an IO thread until the server
+       * stops.
+       *
+       * @param worker  The IO thread's state.
+       ************************************************************************/
+      void run(Worker & worker);
+
+      /*********************************************************************//**
+       * Accept all the pending connections.
+       ************************************************************************/
+      void accept();
+
+      /*********************************************************************//**
+       * Read all the available bytes of a connection and hand them to the
+       * data handler.
+       *
+       * @param worker  The connection's IO thread.
+       * @param conn    The connection.
+       * @return        False if the connection must be closed.
+       ************************************************************************/
+      bool read(Worker & worker, Connection & conn);
+
+      /*********************************************************************//**
+       * Write as much of a connection's buffered bytes as the socket takes.
+       * The connection's mutex must be held.
+       *
+       * @param conn  The connection.
+       * @return      False if the connection failed.
+       ************************************************************************/
+      static bool flush(Connection & conn);
+
+      /*********************************************************************//**
+       * Close a connection on it's IO thread and report it.
+       *
+       * @param worker  The connection's IO thread.
+       * @param conn    The connection.
+       ************************************************************************/
+      void close(Worker & worker, Connection & conn);
+
+      /*********************************************************************//**
+       * Find an open connection.
+       *
+       * @param id  The ID of the connection.
+       * @return    The connection, or nullptr if it's not open.
+       ************************************************************************/
+      std::shared_ptr<Connection> find(ConnectionID id) const;
 
     public:
-
-      TCPServer(IPEndPoint localEP);
+      /*********************************************************************//**
+       * Bind to the local end point and start serving connections.
+       *
+       * @param localEP       The local end point to listen on, port 0 picks a
+       *                      free port.
+       * @param onConnect     Called when a client connected, may be nullptr.
+       * @param onData        Called with the received bytes.
+       * @param onDisconnect  Called when a connection closed, may be nullptr.
+       * @param ioThreads     The number of IO threads, at least 1.
+       * @param maxBuffered   The maximum number of bytes buffered per
+       *                      connection and direction.
+       ************************************************************************/
+      TCPServer(const IPEndPoint & localEP, ConnectHandler onConnect,
+                DataHandler onData, DisconnectHandler onDisconnect,
+                size_t ioThreads = 1, size_t maxBuffered = 1 << 20);
+
+      /*********************************************************************//**
+       * Stop the IO threads and close all the connections, the disconnect
+       * handler is not called.
+       ************************************************************************/
       ~TCPServer();
 
+      /*********************************************************************//**
+       * Return the local end point, i.e. to find the port that was chosen
+       * when binding to port 0.
+       *
+       * @return  The local end point of the listen socket.
+       ************************************************************************/
+      IPEndPoint getEP() const;
+
+      /*********************************************************************//**
+       * Send bytes to a connection. They are either written straight away or
+       * buffered until the socket drains, the order is always kept.
+       *
+       * @param id    The ID of the connection.
+       * @param data  The bytes.
+       * @param len   The number of bytes.
+       * @return      True if the bytes were sent or buffered, else false if
+       *              the connection is closed or it would buffer more than
+       *              maxBuffered bytes, in which case nothing is sent.
+       ************************************************************************/
+      bool send(ConnectionID id, const uint8_t * data, size_t len);
+
+      /*********************************************************************//**
+       * Return the number of bytes a connection has buffered to send.
+       *
+       * @param id  The ID of the connection.
+       * @return    The number of bytes, 0 if the connection is closed.
+       ************************************************************************/
+      size_t getBuffered(ConnectionID id) const;
+
+      /*********************************************************************//**
+       * Close a connection. It's closed by it's IO thread, which calls the
+       * disconnect handler.
+       *
+       * @param id  The ID of the connection.
+       ************************************************************************/
+      void disconnect(ConnectionID id);
+
+      /*********************************************************************//**
+       * Return the number of open connections.
+       *
+       * @return  The number of connections.
+       ************************************************************************/
+      size_t getConnectionCount() const;
     };
   }
 }
@@ -0,0 +1,214 @@
+#ifndef ANUBIS_NETWORKING_UDP_CONNECTION_HPP
+#define ANUBIS_NETWORKING_UDP_CONNECTION_HPP
+
+#include "../Common.hpp"
+#include "UDPServer.hpp"
+
+#include <chrono>
+
+namespace Anubis
+{
+  namespace Networking
+  {
+    /***********************************************************************//**
+     * The state of one peer of a UDP connection, which carries several
+     * channels of messages in the same UDPPackets.
+     *
+     * Every packet that is written gets the next sequence number and acks
+     * the most recent packet that was received plus the 32 before it in the
+     * AckBits bitfield, thus every ack is repeated in many packets and the
+     * loss of one packet loses no acks.
+     *
+     * The messages of an UnreliableSequenced channel are sent once, a message
+     * that arrives after a newer one of the same channel is dropped. The
+     * messages of a ReliableOrdered channel are kept until a packet that
+     * carried them is acked and are resent once no ack arrived within the
+     * retransmission timeout, which is derived from the round trip times of
+     * the acked packets like TCP's. Only the messages that are unacked are
+     * resent, never whole packets.
+     *
+     * A lost reliable message only holds back the later messages of it's own
+     * channel until it's resend arrives, the other channels and all the
+     * unreliable messages are handed out as soon as they arrive.
+     *
+     * Every message is stored in a pooled packet, thus the connection does
+     * not allocate once it's pools are warm. It's not thread safe.
+     **************************************************************************/
+    class UDPConnection final
+    {
+    public:
+      /** The kinds of channels. */
+      enum class ChannelTypes
+      {
+        /** Sent once, older messages than the last one received are
+         * dropped. */
+        UnreliableSequenced,
+
+        /** Resent until acked and handed out in order. */
+        ReliableOrdered
+      };
+
+      /** The clock that times the resends. */
+      typedef std::chrono::steady_clock Clock;
+
+      /** Called by read() with every message that is handed out. */
+      typedef std::function<void(size_t channel, const uint8_t * data,
+                                 size_t len)> MessageHandler;
+
+      /** The maximum number of unacked messages per channel, also the
+       * number of packets whose acks are tracked. */
+      static const size_t kWindowLen = 256;
+
+    private:
+      /** The state of a channel. */
+      struct Channel;
+
+      /** The messages that a sent packet carried. */
+      struct SentPacket;
+
+      /** The maximum length of any packet. */
+      const size_t kMaxPktLen;
+
+      /** The buffers of the queued and buffered messages. */
+      PacketPool fPool;
+
+      /** The channels. */
+      std::vector<std::unique_ptr<Channel>> fChannels;
+
+      /** The packets that were sent, by sequence number. */
+      std::vector<SentPacket> fSent;
+
+      /** The sequence number of the next packet. */
+      uint16_t fLocalSeq;
+
+      /** The most recent sequence number that was received. Until a packet
+       * is received it's 65535, which the peer only sends after 65535
+       * others. */
+      uint16_t fRemoteSeq;
+
+      /** The packets before fRemoteSeq that were received. */
+      uint32_t fAckBits;
+
+      /** Indicate if any packet was received. */
+      bool fHasReceived;
+
+      /** Indicate if packets with messages were received since the last
+       * write. */
+      bool fIsAckPending;
+
+      /** The smoothed round trip time and it's variation. */
+      Clock::duration fRTT;
+      Clock::duration fRTTVar;
+
+      /** Indicate if a round trip time was measured. */
+      bool fHasRTT;
+
+      /** Delete the copy constructor. */
+      UDPConnection(const UDPConnection &) = delete;
+
+      /** Delete the assignment operator. */
+      UDPConnection & operator = (const UDPConnection &) = delete;
+
+      /*********************************************************************//**
+       * Handle an ack of a sent packet.
+       *
+       * @param seq The sequence number of the packet.
+       * @param now The current time.
+       ************************************************************************/
+      void ack(uint16_t seq, Clock::time_point now);
+
+      /*********************************************************************//**
+       * Record that a packet was received.
+       *
+       * @param seq The sequence number of the packet.
+       ************************************************************************/
+      void received(uint16_t seq);
+
+    public:
+      /*********************************************************************//**
+       * Create the connection's state.
+       *
+       * @param channels  The types of the channels, a message's channel is the
+       *                  index in this list.
+       * @param maxPktLen The maximum length of the packets that are written,
+       *                  the same as the UDPServer's.
+       ************************************************************************/
+      UDPConnection(const std::vector<ChannelTypes> & channels,
+                    size_t maxPktLen = 512);
+
+      /*********************************************************************//**
+       * Release the messages.
+       ************************************************************************/
+      ~UDPConnection();
+
+      /*********************************************************************//**
+       * Return the maximum length of a message.
+       *
+       * @return  The number of bytes that fit into a packet with one message.
+       ************************************************************************/
+      size_t getMaxMessageLen() const;
+
+      /*********************************************************************//**
+       * Queue a message to be written into the next packets.
+       *
+       * @param channel The index of the channel.
+       * @param data    The bytes of the message.
+       * @param len     The length of the message.
+       * @return        True if the message was queued, else false if it's
+       *                too long or the channel has kWindowLen unacked
+       *                messages.
+       ************************************************************************/
+      bool queue(size_t channel, const uint8_t * data, size_t len);
+
+      /*********************************************************************//**
+       * Write the next packet: the acks, the reliable messages that were not
+       * sent or whose resend is due and then the unreliable ones, as many as
+       * fit. Call it until it returns false to write everything that's due.
+       *
+       * @param packet  A cleared packet, it's type is not changed.
+       * @param now     The current time.
+       * @return        True if the packet must be sent, else false if there
+       *                are no messages or acks to send.
+       ************************************************************************/
+      bool write(UDPPacket & packet, Clock::time_point now = Clock::now());
+
+      /*********************************************************************//**
+       * Read a received packet, handle it's acks and hand out it's messages.
+       *
+       * @param data      The bytes of the datagram.
+       * @param len       The length of the datagram.
+       * @param onMessage Called with every message that is handed out.
+       * @param now       The current time.
+       * @return          True if the packet was read, else false if it's
+       *                  malformed or longer than the maximum packet
+       *                  length, in which case none of it is used.
+       ************************************************************************/
+      bool read(const uint8_t * data, size_t len,
+                const MessageHandler & onMessage,
+                Clock::time_point now = Clock::now());
+
+      /*********************************************************************//**
+       * Return the smoothed round trip time.
+       *
+       * @return  The round trip time, 0 until a packet was acked.
+       ************************************************************************/
+      Clock::duration getRTT() const;
+
+      /*********************************************************************//**
+       * Return the time after which an unacked reliable message is resent.
+       *
+       * @return  The retransmission timeout.
+       ************************************************************************/
+      Clock::duration getResendTimeout() const;
+
+      /*********************************************************************//**
+       * Return the number of reliable messages that are not acked yet.
+       *
+       * @return  The number of messages over all the channels.
+       ************************************************************************/
+      size_t getUnacked() const;
+    };
+  }
+}
+
+#endif /* ANUBIS_NETWORKING_UDP_CONNECTION_HPP */
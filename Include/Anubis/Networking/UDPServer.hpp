@@ -1,6 +1,7 @@
 #ifndef ANUBIS_NETWORKING_UDP_SERVER_HPP
 #define ANUBIS_NETWORKING_UDP_SERVER_HPP
 
+#include "IOUring.hpp"
 #include "Socket.hpp"
 #include "IPEndPoint.hpp"
 #include "../Common/Misc.hpp"
@@ -11,13 +12,13 @@ namespace Anubis
   {
     class UDPPacket
     {
-      /** The maximum length of any UDP packet. */
-      const size_t kMaxPktLen;
+      /** The connection reads the headers of received datagrams. */
+      friend class UDPConnection;
 
       /** The minimum length of the packet in bytes. The minimum size include
-       * enough space to store the Type (uint16_t), SeqNum (uint16_t) and
-       * AckNum (uint16_t). */
-      static const size_t kMinPktLen = 6;
+       * enough space to store the Type (uint16_t), SeqNum (uint16_t), AckNum
+       * (uint16_t) and AckBits (uint32_t). */
+      static const size_t kMinPktLen = 10;
 
       /** The type of the packet. */
       static const size_t kTypeIndex = 0;
@@ -28,25 +29,62 @@ namespace Anubis
       /** The index of the ack number in the packet. */
       static const size_t kAckNumIndex = 4;
 
+      /** The index of the bitfield that acks the 32 packets before the ack
+       * number. */
+      static const size_t kAckBitsIndex = 6;
+
       /* The data of the packet. */
-      std::vector<uint8_t> fData;
+      PacketPool::Packet fData;
 
     public:
 
 
 
       /*********************************************************************//**
-       * Create a new packet and initialise the contents to null.
+       * Create a new packet in a pooled buffer and clear it's header.
        *
-       * @param maxPktLen The maximum length of the packet in bytes.
+       * @param packet  A packet that nobody else refers too, i.e. one that was
+       *                just acquired from the pool.
        ************************************************************************/
-      UDPPacket(size_t maxPktLen = 512);
+      UDPPacket(PacketPool::Packet packet);
 
       /*********************************************************************//**
-       * Clear the contents of the packet.
+       * Clear the contents of the packet. Only the header is zeroed, the rest
+       * of the buffer is overwritten by whatever is appended.
        ************************************************************************/
       void clear();
 
+      /*********************************************************************//**
+       * Return the pooled buffer of the packet, i.e. to queue or send it
+       * without copying.
+       *
+       * @return  The packet's buffer.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE const PacketPool::Packet & getPacket() const
+      {
+        return fData;
+      }
+
+      /*********************************************************************//**
+       * Return the number of bytes that can still be appended.
+       *
+       * @return  The free space of the buffer.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t getRemaining() const
+      {
+        return fData.capacity() - fData.size();
+      }
+
+      /*********************************************************************//**
+       * Append bytes to the end of the packet.
+       *
+       * @param data  The bytes.
+       * @param len   The number of bytes.
+       * @return      True if the bytes were appended, else false if they
+       *              don't fit, in which case the packet is unchanged.
+       ************************************************************************/
+      bool append(const uint8_t * data, size_t len);
+
       /*********************************************************************//**
        * Set the sequence number of the packet.
        *
@@ -72,6 +110,22 @@ namespace Anubis
 
       uint16_t getAckNum() const;
 
+      /*********************************************************************//**
+       * Set the bitfield of the packets before the ack number that were
+       * received, bit n acks ackNum - 1 - n.
+       *
+       * @param ackBits The bitfield.
+       ************************************************************************/
+      void setAckBits(uint32_t ackBits);
+
+      /*********************************************************************//**
+       * Retrieves the bitfield of the packets before the ack number that were
+       * received.
+       *
+       * @return  The bitfield.
+       ************************************************************************/
+      uint32_t getAckBits() const;
+
       class Chunk
       {
         std::vector<uint8_t> fData;
@@ -107,8 +161,30 @@ namespace Anubis
 
 
 
+    /***********************************************************************//**
+     * A UDP socket that moves datagrams in batches. Received datagrams are
+     * read into a preallocated batch, up to batchSize per system call, and
+     * sent datagrams are queued in a second batch that is flushed with a
+     * single system call once it's full or when flush() is called. On Linux
+     * the batches use recvmmsg() and sendmmsg(), elsewhere they fall back to
+     * one system call per datagram. On Linux kernels that support it the
+     * batches may be moved through an io_uring instead, see IOUring.
+     **************************************************************************/
     class UDPServer
     {
+    public:
+      /** The ways the datagrams are moved between the batches and the
+       * socket. */
+      enum class Backends
+      {
+        /** The socket's own (batched) system calls. */
+        Syscalls,
+
+        /** An io_uring, if the kernel supports it, else the system calls. */
+        IOUring
+      };
+
+    private:
       /** The maximum size of the client circular queue. */
       static const size_t kMaxPktQueueLen = 4096;
 
@@ -125,15 +201,30 @@ namespace Anubis
         std::unique_ptr<IPEndPoint> fEndPoint;
 
         /** The thread safe RX packet queue. */
-        Common::CircularQueue<std::vector<uint8_t>, kMaxPktQueueLen> fRxQueue;
+        Common::CircularQueue<PacketPool::Packet, kMaxPktQueueLen> fRxQueue;
 
         /** The thread safe TX packet queue. */
-        Common::CircularQueue<std::vector<uint8_t>, kMaxPktQueueLen> fTxQueue;
+        Common::CircularQueue<PacketPool::Packet, kMaxPktQueueLen> fTxQueue;
       };
 
       /** The socket used to send / recieve datagrams. */
       std::unique_ptr<Socket> fSocket;
 
+      /** The ring that moves the datagrams, nullptr for the system calls. */
+      std::unique_ptr<IOUring> fRing;
+
+      /** The buffers of all the datagrams, declared before the batches since
+       * they hold it's packets. */
+      PacketPool fPool;
+
+      /** The datagrams of the last receive. */
+      DatagramBatch fRxBatch;
+
+      /** The datagrams waiting to be sent. */
+      DatagramBatch fTxBatch;
+
+      /** Set once the server stopped receiving. */
+      std::atomic_bool fIsStopped;
 
       UDPServer(const UDPServer &) = delete;
       UDPServer & operator = (const UDPServer &) = delete;
@@ -150,13 +241,125 @@ namespace Anubis
        *                  specifically tuned to try and avoid fragmentation of
        *                  the packet. In networks where jumbo frames etc are
        *                  used, this can be set to a much higher value.
+       * @param batchSize The maximum number of datagrams that are received or
+       *                  sent with a single system call.
+       * @param backend   The way the datagrams are moved, an io_uring falls
+       *                  back to the system calls if it's not supported. The
+       *                  datagrams must then always be received by the same
+       *                  thread.
+       ************************************************************************/
+      UDPServer(IPEndPoint localEP, size_t maxPktLen = 512,
+                size_t batchSize = 64,
+                Backends backend = Backends::Syscalls);
+
+      /*********************************************************************//**
+       * Initialise the new UDPServer with a socket that is already bound,
+       * i.e. one that was given socket options the server doesn't set.
+       *
+       * @param socket    The bound UDP socket.
+       * @param maxPktLen The maximum length (in bytes) of any packet that is
+       *                  send or received.
+       * @param batchSize The maximum number of datagrams that are received or
+       *                  sent with a single system call.
+       * @param backend   The way the datagrams are moved.
        ************************************************************************/
-      UDPServer(IPEndPoint localEP, size_t maxPktLen = 512);
+      UDPServer(std::unique_ptr<Socket> socket, size_t maxPktLen = 512,
+                size_t batchSize = 64,
+                Backends backend = Backends::Syscalls);
 
+      /*********************************************************************//**
+       * Flush the queued datagrams and close the socket.
+       ************************************************************************/
       ~UDPServer();
 
+      /*********************************************************************//**
+       * Return the local end point, i.e. to find the port that was chosen
+       * when binding to port 0.
+       *
+       * @return  The local end point of the socket.
+       ************************************************************************/
+      IPEndPoint getEP() const;
 
+      /*********************************************************************//**
+       * Return the way the datagrams are moved, i.e. to check if the io_uring
+       * was supported.
+       *
+       * @return  The backend in use.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE Backends getBackend() const
+      {
+        return fRing ? Backends::IOUring : Backends::Syscalls;
+      }
 
+      /*********************************************************************//**
+       * Receive all the datagrams that are queued by the OS, up to the batch
+       * size. The datagrams of the previous receive are discarded.
+       *
+       * @param wait  Block until at least one datagram arrives if true, else
+       *              return straight away.
+       * @return      The number of datagrams received, always 0 once the
+       *              server is stopped.
+       ************************************************************************/
+      size_t receive(bool wait = true);
+
+      /*********************************************************************//**
+       * Stop receiving, i.e. to end a receive thread. A thread that is blocked
+       * in receive() returns straight away, as do all later receives. The
+       * datagrams can still be sent.
+       ************************************************************************/
+      void stop();
+
+      /*********************************************************************//**
+       * Return the datagrams of the last receive. They stay valid until the
+       * next call to receive(), unless their packets are taken out.
+       *
+       * @return  The received datagrams.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE DatagramBatch & getReceived()
+      {
+        return fRxBatch;
+      }
+
+      /*********************************************************************//**
+       * Return the pool of the server's packets, used to acquire packets to
+       * send without copying them.
+       *
+       * @return  The packet pool.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE PacketPool & getPool()
+      {
+        return fPool;
+      }
+
+      /*********************************************************************//**
+       * Queue a datagram to be sent. The queue is flushed first if it's full.
+       *
+       * @param ep    The address to send the datagram too.
+       * @param data  The datagram bytes.
+       * @param len   The length of the datagram.
+       * @return      True if the datagram was queued, else false if it's
+       *              longer than maxPktLen.
+       ************************************************************************/
+      bool send(const SocketAddress & ep, const uint8_t * data, size_t len);
+
+      /*********************************************************************//**
+       * Queue a pooled packet to be sent without copying it. The queue is
+       * flushed first if it's full.
+       *
+       * @param ep      The address to send the datagram too.
+       * @param packet  The datagram, it must not be changed until it's sent.
+       ************************************************************************/
+      void send(const SocketAddress & ep, const PacketPool::Packet & packet);
+
+      /*********************************************************************//**
+       * Send all the queued datagrams.
+       *
+       * @return  The number of datagrams sent, less than the number queued
+       *          if the socket would block or peers can't be reached, in
+       *          which case the rest are dropped like any other lost
+       *          datagram.
+       ************************************************************************/
+      size_t flush();
     };
   }
 }
@@ -0,0 +1,116 @@
+#ifndef ANUBIS_NETWORKING_UDP_SHARDED_SERVER_HPP
+#define ANUBIS_NETWORKING_UDP_SHARDED_SERVER_HPP
+
+#include "../Common.hpp"
+#include "UDPServer.hpp"
+
+namespace Anubis
+{
+  namespace Networking
+  {
+    /***********************************************************************//**
+     * A UDP server that spreads the receiving of datagrams over several
+     * threads. Every shard is a UDPServer with it's own socket, all of them
+     * bound to the same end point with SO_REUSEPORT, and it's own thread that
+     * receives batches and hands them to the receive handler.
+     *
+     * The kernel picks the socket of every datagram with a small BPF program
+     * that hashes the client's address and port, getShard() calculates the
+     * same hash. Thus all the datagrams of a client are handled by the same
+     * thread, so the client's state and queues only ever have one producer
+     * and the shards never lock each other.
+     *
+     * The datagrams that the handler queues on it's shard are flushed when it
+     * returns. A shard is not thread safe, datagrams that are sent by other
+     * threads must be handed to the shard's thread, i.e. through a queue that
+     * it drains in the handler.
+     *
+     * Sharding needs SO_REUSEPORT with BPF steering, i.e. Linux. Elsewhere,
+     * or if the kernel refuses the program, the server falls back to a single
+     * shard.
+     **************************************************************************/
+    class UDPShardedServer final
+    {
+    public:
+      /** Called on a shard's thread after every receive, the datagrams are
+       * in server.getReceived(). */
+      typedef std::function<void(size_t shard, UDPServer & server)>
+        ReceiveHandler;
+
+    private:
+      /** A shard's server and thread. */
+      struct Shard;
+
+      /** The handler of the received datagrams. */
+      ReceiveHandler fOnReceive;
+
+      /** The shards, in the order their sockets were bound. */
+      std::vector<std::unique_ptr<Shard>> fShards;
+
+      /** Cleared to stop the shard threads. */
+      std::atomic_bool fIsExecuting;
+
+      /** Delete the copy constructor. */
+      UDPShardedServer(const UDPShardedServer &) = delete;
+
+      /** Delete the assignment operator. */
+      UDPShardedServer & operator = (const UDPShardedServer &) = delete;
+
+      /*********************************************************************//**
+       * Receive and handle the datagrams of a shard until the server stops.
+       *
+       * @param shard The shard.
+       ************************************************************************/
+      void run(Shard & shard);
+
+    public:
+      /*********************************************************************//**
+       * Bind the shards to the local end point and start receiving.
+       *
+       * @param localEP   The local end point, port 0 picks a free port.
+       * @param onReceive Called with the received datagrams of a shard.
+       * @param shards    The number of shards, 0 for one per hardware thread.
+       * @param maxPktLen The maximum length (in bytes) of any packet that is
+       *                  send or received.
+       * @param batchSize The maximum number of datagrams that are received or
+       *                  sent with a single system call.
+       * @param backend   The way every shard moves it's datagrams.
+       ************************************************************************/
+      UDPShardedServer(const IPEndPoint & localEP, ReceiveHandler onReceive,
+                       size_t shards = 0, size_t maxPktLen = 512,
+                       size_t batchSize = 64,
+                       UDPServer::Backends backend =
+                         UDPServer::Backends::Syscalls);
+
+      /*********************************************************************//**
+       * Stop the shard threads and flush their queued datagrams.
+       ************************************************************************/
+      ~UDPShardedServer();
+
+      /*********************************************************************//**
+       * Return the local end point, i.e. to find the port that was chosen
+       * when binding to port 0.
+       *
+       * @return  The local end point that all the shards are bound too.
+       ************************************************************************/
+      IPEndPoint getEP() const;
+
+      /*********************************************************************//**
+       * Return the number of shards, 1 if sharding is not supported.
+       *
+       * @return  The number of shards.
+       ************************************************************************/
+      size_t getShardCount() const;
+
+      /*********************************************************************//**
+       * Return the shard that receives the datagrams of a client.
+       *
+       * @param addr  The address of the client.
+       * @return      The index of the shard.
+       ************************************************************************/
+      size_t getShard(const SocketAddress & addr) const;
+    };
+  }
+}
+
+#endif /* ANUBIS_NETWORKING_UDP_SHARDED_SERVER_HPP */
@@ -1,13 +1,30 @@
 #ifndef ANUBIS_PHYSICS_HPP
 #define ANUBIS_PHYSICS_HPP
 
+#include "Physics/AABB.hpp"
+#include "Physics/AABBTree.hpp"
+#include "Physics/BatchQuery.hpp"
 #include "Physics/BoundingBox.hpp"
 #include "Physics/BoundingMesh.hpp"
 #include "Physics/BoundingSphere.hpp"
 #include "Physics/BoundingVolume.hpp"
+#include "Physics/BoundingVolumeSet.hpp"
+#include "Physics/Broadphase.hpp"
 #include "Physics/CameraNode.hpp"
+#include "Physics/ContactSolver.hpp"
+#include "Physics/ContinuousCollision.hpp"
+#include "Physics/InterestManager.hpp"
+#include "Physics/Islands.hpp"
+#include "Physics/Lane4.hpp"
+#include "Physics/Narrowphase.hpp"
 #include "Physics/PhysicsContext.hpp"
+#include "Physics/RigidBodyWorld.hpp"
 #include "Physics/Scene.hpp"
+#include "Physics/SceneSnapshot.hpp"
+#include "Physics/SpatialGrid.hpp"
+#include "Physics/SweepAndPrune.hpp"
 #include "Physics/TaskPool.hpp"
+#include "Physics/TraversalStack.hpp"
+#include "Physics/Triangle.hpp"
 
 #endif /* ANUBIS_PHYSICS_HPP */
@@ -0,0 +1,213 @@
+#ifndef ANUBIS_PHYSICS_AABB_HPP
+#define ANUBIS_PHYSICS_AABB_HPP
+
+#include "../Math/Ray.hpp"
+#include "../Math/Vector4f.hpp"
+
+namespace Anubis
+{
+  namespace Physics
+  {
+    /***********************************************************************//**
+     * An axis aligned bounding box described by it's minimum and maximum
+     * corners. This is the common currency of the broadphase, every bounding
+     * volume can be reduced to one.
+     **************************************************************************/
+    struct AABB
+    {
+      /** The corner with the smallest coordinates. */
+      Math::Vector4f fMin;
+
+      /** The corner with the largest coordinates. */
+      Math::Vector4f fMax;
+
+      /*********************************************************************//**
+       * Create an empty box at the origin.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE AABB() {}
+
+      /*********************************************************************//**
+       * Create a box from it's minimum and maximum corners.
+       *
+       * @param min The corner with the smallest coordinates.
+       * @param max The corner with the largest coordinates.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE AABB(const Math::Vector4f & min,
+                               const Math::Vector4f & max) :
+        fMin(min), fMax(max) {}
+
+      /*********************************************************************//**
+       * Return the smallest box that contains both boxes.
+       *
+       * @param lhs The first box.
+       * @param rhs The second box.
+       * @return    The union of the two boxes.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE static AABB merge(const AABB & lhs,
+                                            const AABB & rhs) noexcept
+      {
+        return AABB(Math::Vector4f::min(lhs.fMin, rhs.fMin),
+                    Math::Vector4f::max(lhs.fMax, rhs.fMax));
+      }
+
+      /*********************************************************************//**
+       * Return true if the two boxes overlap, touching boxes are considered to
+       * overlap.
+       *
+       * @param rhs The box to test against.
+       * @return    True if the boxes overlap, else false.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE bool overlaps(const AABB & rhs) const noexcept
+      {
+        return fMin.x() <= rhs.fMax.x() && rhs.fMin.x() <= fMax.x() &&
+               fMin.y() <= rhs.fMax.y() && rhs.fMin.y() <= fMax.y() &&
+               fMin.z() <= rhs.fMax.z() && rhs.fMin.z() <= fMax.z();
+      }
+
+      /*********************************************************************//**
+       * Return true if the specified box is completely inside this box.
+       *
+       * @param rhs The box to test.
+       * @return    True if rhs is contained in this box, else false.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE bool contains(const AABB & rhs) const noexcept
+      {
+        return fMin.x() <= rhs.fMin.x() && rhs.fMax.x() <= fMax.x() &&
+               fMin.y() <= rhs.fMin.y() && rhs.fMax.y() <= fMax.y() &&
+               fMin.z() <= rhs.fMin.z() && rhs.fMax.z() <= fMax.z();
+      }
+
+      /*********************************************************************//**
+       * Return the surface area of the box, used as the cost metric when
+       * building bounding volume hierarchies.
+       *
+       * @return  The surface area of the box.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE float surfaceArea() const noexcept
+      {
+        float dx = fMax.x() - fMin.x();
+        float dy = fMax.y() - fMin.y();
+        float dz = fMax.z() - fMin.z();
+        return 2.0f * (dx * dy + dy * dz + dz * dx);
+      }
+
+      /*********************************************************************//**
+       * Return a copy of the box grown by the margin on every side.
+       *
+       * @param margin  The distance to grow the box by.
+       * @return        The enlarged box.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE AABB fatten(float margin) const noexcept
+      {
+        Math::Vector4f offset(margin, margin, margin, 0.0f);
+        return AABB(fMin - offset, fMax + offset);
+      }
+
+      /*********************************************************************//**
+       * Clip the interval of a ray against one slab of a box.
+       *
+       * A ray parallel to the slab has an infinite reciprocal and a NaN
+       * distance when it lies in one of the slab's planes. Such a ray is on
+       * the boundary of the slab, thus the interval is left unclipped and a
+       * ray along the shared face of two boxes hits both.
+       *
+       * @param min     The minimum bound of the slab.
+       * @param max     The maximum bound of the slab.
+       * @param origin  The origin of the ray on the slab's axis.
+       * @param invDir  The reciprocal of the ray direction on the axis.
+       * @param tEntry  The entry distance, returns the clipped distance.
+       * @param tExit   The exit distance, returns the clipped distance.
+       * @return        False if the bounds are NaN, else true.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE static bool clipSlab(float min, float max,
+        float origin, float invDir, float & tEntry, float & tExit) noexcept
+      {
+        const float t1 = (min - origin) * invDir;
+        const float t2 = (max - origin) * invDir;
+        if(t1 == t1 && t2 == t2)
+        {
+          tEntry = std::max(tEntry, std::min(t1, t2));
+          tExit = std::min(tExit, std::max(t1, t2));
+        }
+        return min <= max;
+      }
+
+      #ifdef ANUBIS_HAS_SSE
+      /*********************************************************************//**
+       * Clip the intervals of four rays against one slab of four boxes, in
+       * the same way as clipSlab().
+       *
+       * @param min     The minimum bounds of the slabs.
+       * @param max     The maximum bounds of the slabs.
+       * @param origin  The origins of the rays on the slab's axis.
+       * @param invDir  The reciprocals of the ray directions on the axis.
+       * @param tEntry  The entry distances, returns the clipped distances.
+       * @param tExit   The exit distances, returns the clipped distances.
+       * @return        A mask whose lanes are cleared if the bounds are NaN.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE static __m128 clipSlab4(__m128 min, __m128 max,
+        __m128 origin, __m128 invDir, __m128 & tEntry,
+        __m128 & tExit) noexcept
+      {
+        const __m128 t1 = _mm_mul_ps(_mm_sub_ps(min, origin), invDir);
+        const __m128 t2 = _mm_mul_ps(_mm_sub_ps(max, origin), invDir);
+        const __m128 isInPlane = _mm_cmpunord_ps(t1, t2);
+        tEntry = _mm_blendv_ps(_mm_max_ps(tEntry, _mm_min_ps(t1, t2)), tEntry,
+                               isInPlane);
+        tExit = _mm_blendv_ps(_mm_min_ps(tExit, _mm_max_ps(t1, t2)), tExit,
+                              isInPlane);
+        return _mm_cmple_ps(min, max);
+      }
+      #endif /* ANUBIS_HAS_SSE */
+
+      /*********************************************************************//**
+       * Intersect a ray with the box using the slab method. The reciprocal of
+       * the ray direction is passed in so that it can be calculated once when
+       * testing a ray against many boxes. A ray that lies in a face plane of
+       * the box counts as inside that slab, see clipSlab(), and boxes with
+       * NaN bounds are never hit.
+       *
+       * @param origin    The origin of the ray.
+       * @param invDir    The component wise reciprocal of the ray direction.
+       * @param maxT      The maximum distance along the ray to test.
+       * @param tEntry    Returns the distance where the ray enters the box.
+       * @param tExit     Returns the distance where the ray exits the box.
+       * @return          True if the ray hits the box in [0, maxT].
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE bool intersect(const Math::Vector4f & origin,
+        const Math::Vector4f & invDir, float maxT, float & tEntry,
+        float & tExit) const noexcept
+      {
+        /* Start with the whole ray and clip it against the three slabs. */
+        tEntry = -std::numeric_limits<float>::infinity();
+        tExit = std::numeric_limits<float>::infinity();
+        bool isValid = clipSlab(fMin.x(), fMax.x(), origin.x(), invDir.x(),
+                                tEntry, tExit);
+        isValid &= clipSlab(fMin.y(), fMax.y(), origin.y(), invDir.y(),
+                            tEntry, tExit);
+        isValid &= clipSlab(fMin.z(), fMax.z(), origin.z(), invDir.z(),
+                            tEntry, tExit);
+
+        /* The ray hits if the slab intervals overlap within [0, maxT]. */
+        return isValid && tEntry <= tExit && tExit >= 0.0f && tEntry <= maxT;
+      }
+
+      /*********************************************************************//**
+       * Return the component wise reciprocal of the ray direction for use
+       * with intersect().
+       *
+       * @param ray The ray.
+       * @return    The reciprocal of the ray's direction.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE static Math::Vector4f inverseDirection(
+        const Math::Ray & ray) noexcept
+      {
+        const Math::Vector4f & dir = ray.direction();
+        return Math::Vector4f(1.0f / dir.x(), 1.0f / dir.y(), 1.0f / dir.z(),
+                              0.0f);
+      }
+    };
+  }
+}
+
+#endif /* ANUBIS_PHYSICS_AABB_HPP */
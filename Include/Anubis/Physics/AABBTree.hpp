@@ -0,0 +1,424 @@
+#ifndef ANUBIS_PHYSICS_AABB_TREE_HPP
+#define ANUBIS_PHYSICS_AABB_TREE_HPP
+
+#include "../Common/Misc.hpp"
+#include "Broadphase.hpp"
+#include "TraversalStack.hpp"
+
+namespace Anubis
+{
+  namespace Physics
+  {
+    /***********************************************************************//**
+     * A dynamic bounding volume hierarchy of axis aligned boxes used as the
+     * collision broadphase. Every object is stored in a leaf as a proxy with a
+     * "fat" box, i.e. the object's box grown by a margin, so that objects
+     * which move a little do not have to be reinserted every frame. Leaves are
+     * inserted at the sibling that minimises the surface area of the tree and
+     * AVL style rotations keep the tree balanced, thus insert, remove and move
+     * are O(log n).
+     *
+     * The nodes are stored in a single array and refer to each other by index
+     * so that the tree can grow without invalidating proxies. Freed nodes are
+     * recycled through a free list.
+     **************************************************************************/
+    class AABBTree final : public Broadphase
+    {
+    public:
+      /** The index used to indicate the absence of a node. */
+      static const int32_t kNullNode = kNullProxy;
+
+      /** The default distance that the boxes of the proxies are grown by. */
+      static constexpr float kDefaultMargin = 0.1f;
+
+      /** The number of frames of displacement that a moving proxy's box is
+       * extended by in the direction of the motion. */
+      static constexpr float kDisplacementMultiplier = 2.0f;
+
+    private:
+      /*********************************************************************//**
+       * A node in the tree. Leaves hold the proxies, internal nodes always
+       * have exactly two children.
+       ************************************************************************/
+      struct Node
+      {
+        /** The (fat) box of the node. Internal nodes contain their children. */
+        AABB fBox;
+
+        /** The user data of the proxy if this is a leaf. */
+        void * fUserData;
+
+        union
+        {
+          /** The parent of the node while the node is in the tree. */
+          int32_t fParent;
+
+          /** The next free node while the node is on the free list. */
+          int32_t fNext;
+        };
+
+        /** The first child or kNullNode for leaves. */
+        int32_t fChild1;
+
+        /** The second child or kNullNode for leaves. */
+        int32_t fChild2;
+
+        /** The height of the subtree (0 for leaves, -1 for free nodes). */
+        int32_t fHeight;
+
+        /*******************************************************************//**
+         * Return true if the node is a leaf (i.e. holds a proxy).
+         *
+         * @return  True if it's a leaf, else false.
+         **********************************************************************/
+        ANUBIS_FORCE_INLINE bool isLeaf() const
+        {
+          return fChild1 == kNullNode;
+        }
+      };
+
+      /** The storage of all the nodes, used and free. */
+      std::vector<Node> fNodes;
+
+      /** The index of the root node. */
+      int32_t fRoot;
+
+      /** The head of the list of free nodes. */
+      int32_t fFreeList;
+
+      /** The number of proxies in the tree. */
+      size_t fProxyCount;
+
+      /** The distance that the boxes of the proxies are grown by. */
+      float fMargin;
+
+      /*********************************************************************//**
+       * Take a node from the free list, growing the node storage if needed.
+       *
+       * @return  The index of the node.
+       ************************************************************************/
+      int32_t allocateNode();
+
+      /*********************************************************************//**
+       * Return a node to the free list.
+       *
+       * @param index The index of the node.
+       ************************************************************************/
+      void freeNode(int32_t index);
+
+      /*********************************************************************//**
+       * Link a leaf into the tree next to the sibling that results in the
+       * smallest increase in surface area.
+       *
+       * @param leaf  The index of the leaf.
+       ************************************************************************/
+      void insertLeaf(int32_t leaf);
+
+      /*********************************************************************//**
+       * Unlink a leaf from the tree, the leaf node itself is not freed.
+       *
+       * @param leaf  The index of the leaf.
+       ************************************************************************/
+      void removeLeaf(int32_t leaf);
+
+      /*********************************************************************//**
+       * Refit the boxes and heights of the ancestors of a node, balancing
+       * each of them on the way up to the root.
+       *
+       * @param index The index of the first ancestor to refit.
+       ************************************************************************/
+      void refit(int32_t index);
+
+      /*********************************************************************//**
+       * Perform a left or right rotation if the subtree rooted at the node is
+       * imbalanced.
+       *
+       * @param index The index of the root of the subtree.
+       * @return      The index of the new root of the subtree.
+       ************************************************************************/
+      int32_t balance(int32_t index);
+
+    public:
+
+      /*********************************************************************//**
+       * Create an empty tree.
+       *
+       * @param margin  The distance that the boxes of the proxies are grown
+       *                by.
+       ************************************************************************/
+      AABBTree(float margin = kDefaultMargin);
+
+      /*********************************************************************//**
+       * Remove all the proxies from the tree, the node storage is kept.
+       ************************************************************************/
+      void clear() override;
+
+      /*********************************************************************//**
+       * Create a proxy for an object.
+       *
+       * @param box       The tight box of the object.
+       * @param userData  The user data to associate with the proxy.
+       * @return          The proxy ID.
+       ************************************************************************/
+      int32_t insert(const AABB & box, void * userData) override;
+
+      /*********************************************************************//**
+       * Destroy a proxy.
+       *
+       * @param proxy The ID of the proxy to destroy.
+       ************************************************************************/
+      void remove(int32_t proxy) override;
+
+      /*********************************************************************//**
+       * Update the box of a proxy. The proxy is only reinserted if the new box
+       * is no longer contained in the fat box, in which case the fat box is
+       * also extended along the displacement to anticipate further motion.
+       *
+       * @param proxy         The ID of the proxy.
+       * @param box           The new tight box of the object.
+       * @param displacement  The displacement of the object since the last
+       *                      move.
+       * @return              True if the proxy was reinserted, else false.
+       ************************************************************************/
+      bool move(int32_t proxy, const AABB & box,
+                const Math::Vector4f & displacement) override;
+
+      /*********************************************************************//**
+       * Return the user data that was associated with the proxy.
+       *
+       * @param proxy The ID of the proxy.
+       * @return      The user data of the proxy.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE void * getUserData(int32_t proxy) const override
+      {
+        return fNodes[proxy].fUserData;
+      }
+
+      /*********************************************************************//**
+       * Return the fat box of the proxy.
+       *
+       * @param proxy The ID of the proxy.
+       * @return      The fat box of the proxy.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE const AABB & getFatAABB(int32_t proxy) const
+      {
+        return fNodes[proxy].fBox;
+      }
+
+      /*********************************************************************//**
+       * Return the number of proxies in the tree.
+       *
+       * @return  The number of proxies.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t size() const override
+      {
+        return fProxyCount;
+      }
+
+      /*********************************************************************//**
+       * Return the height of the tree, 0 if it only contains a single leaf.
+       *
+       * @return  The height of the tree.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE int32_t getHeight() const
+      {
+        return fRoot == kNullNode ? 0 : fNodes[fRoot].fHeight;
+      }
+
+      /*********************************************************************//**
+       * Check that the structure of the tree is consistent (parent links,
+       * heights and boxes). Intended for testing.
+       *
+       * @return  True if the tree is consistent, else false.
+       ************************************************************************/
+      bool validate() const;
+
+      /*********************************************************************//**
+       * Invoke the callback for every proxy whose fat box overlaps the box.
+       *
+       * @param box       The box to query.
+       * @param callback  Invoked as bool callback(int32_t proxy), return false
+       *                  to terminate the query.
+       ************************************************************************/
+      template <typename Callback>
+      void queryAABB(const AABB & box, Callback && callback) const
+      {
+        /* The nodes that still have to be visited. */
+        TraversalStack<int32_t> stack;
+        if(fRoot != kNullNode)
+        {
+          stack.push(fRoot);
+        }
+
+        while(!stack.empty())
+        {
+          /* Skip the subtree if it does not overlap the box. */
+          const Node & node = fNodes[stack.pop()];
+          if(!node.fBox.overlaps(box))
+          {
+            continue;
+          }
+
+          /* Report the leaves and descend into the internal nodes. */
+          if(node.isLeaf())
+          {
+            if(!callback(int32_t(&node - fNodes.data())))
+            {
+              return;
+            }
+          }
+          else
+          {
+            stack.push(node.fChild1);
+            stack.push(node.fChild2);
+          }
+        }
+      }
+
+      /*********************************************************************//**
+       * Invoke the callback for every proxy whose fat box is hit by the ray
+       * within maxT. The callback returns the new maximum distance, which
+       * allows a closest hit query to clip the ray as closer hits are found.
+       *
+       * @param ray       The ray to cast.
+       * @param maxT      The maximum distance along the ray.
+       * @param callback  Invoked as float callback(int32_t proxy, float maxT),
+       *                  return maxT to continue, a smaller value to clip the
+       *                  ray or a negative value to terminate the query.
+       ************************************************************************/
+      template <typename Callback>
+      void queryRay(const Math::Ray & ray, float maxT,
+                    Callback && callback) const
+      {
+        /* Calculate the reciprocal of the direction once for all boxes. */
+        const Math::Vector4f invDir = AABB::inverseDirection(ray);
+
+        /* The nodes that still have to be visited. */
+        TraversalStack<int32_t> stack;
+        if(fRoot != kNullNode)
+        {
+          stack.push(fRoot);
+        }
+
+        while(!stack.empty())
+        {
+          /* Skip the subtree if the ray misses it. */
+          const Node & node = fNodes[stack.pop()];
+          float tEntry, tExit;
+          if(!node.fBox.intersect(ray.origin(), invDir, maxT, tEntry, tExit))
+          {
+            continue;
+          }
+
+          /* Report the leaves and descend into the internal nodes. */
+          if(node.isLeaf())
+          {
+            maxT = callback(int32_t(&node - fNodes.data()), maxT);
+            if(maxT < 0.0f)
+            {
+              return;
+            }
+          }
+          else
+          {
+            stack.push(node.fChild1);
+            stack.push(node.fChild2);
+          }
+        }
+      }
+
+      /*********************************************************************//**
+       * Invoke the callback once for every pair of proxies whose fat boxes
+       * overlap. The tree is traversed against itself so that every subtree
+       * pair that does not overlap is rejected with a single test.
+       *
+       * @param callback  Invoked as void callback(int32_t proxyA,
+       *                  int32_t proxyB) with proxyA < proxyB.
+       ************************************************************************/
+      template <typename Callback> void queryPairs(Callback && callback) const
+      {
+        /* The node pairs that still have to be visited. A pair of the same
+         * node stands for the pairs within that subtree. */
+        TraversalStack<std::pair<int32_t, int32_t>> stack;
+        if(fRoot != kNullNode)
+        {
+          stack.push(std::make_pair(fRoot, fRoot));
+        }
+
+        while(!stack.empty())
+        {
+          std::pair<int32_t, int32_t> pair = stack.pop();
+          const Node & a = fNodes[pair.first];
+          const Node & b = fNodes[pair.second];
+
+          /* Find the pairs within a subtree. */
+          if(pair.first == pair.second)
+          {
+            if(!a.isLeaf())
+            {
+              stack.push(std::make_pair(a.fChild1, a.fChild1));
+              stack.push(std::make_pair(a.fChild2, a.fChild2));
+              stack.push(std::make_pair(a.fChild1, a.fChild2));
+            }
+            continue;
+          }
+
+          /* Skip the pair if the subtrees do not overlap. */
+          if(!a.fBox.overlaps(b.fBox))
+          {
+            continue;
+          }
+
+          /* Report leaf pairs, otherwise descend into the larger node. */
+          if(a.isLeaf() && b.isLeaf())
+          {
+            callback(std::min(pair.first, pair.second),
+                     std::max(pair.first, pair.second));
+          }
+          else if(b.isLeaf() || (!a.isLeaf() &&
+                  a.fBox.surfaceArea() >= b.fBox.surfaceArea()))
+          {
+            stack.push(std::make_pair(a.fChild1, pair.second));
+            stack.push(std::make_pair(a.fChild2, pair.second));
+          }
+          else
+          {
+            stack.push(std::make_pair(pair.first, b.fChild1));
+            stack.push(std::make_pair(pair.first, b.fChild2));
+          }
+        }
+      }
+
+      /*********************************************************************//**
+       * Append the proxies whose fat boxes overlap the box to the vector.
+       *
+       * @param box     The box to query.
+       * @param proxies The vector that the proxy IDs are appended to.
+       ************************************************************************/
+      void queryAABB(const AABB & box,
+                     std::vector<int32_t> & proxies) const override
+      {
+        queryAABB(box, [&proxies](int32_t proxy)
+        {
+          proxies.push_back(proxy);
+          return true;
+        });
+      }
+
+      /*********************************************************************//**
+       * Append every pair of proxies whose fat boxes overlap to the vector.
+       *
+       * @param pairs The vector that the pairs are appended to.
+       ************************************************************************/
+      void queryPairs(std::vector<ProxyPair> & pairs) const override
+      {
+        queryPairs([&pairs](int32_t proxyA, int32_t proxyB)
+        {
+          pairs.push_back(ProxyPair(proxyA, proxyB));
+        });
+      }
+    };
+  }
+}
+
+#endif /* ANUBIS_PHYSICS_AABB_TREE_HPP */
@@ -0,0 +1,158 @@
+#ifndef ANUBIS_PHYSICS_BATCH_QUERY_HPP
+#define ANUBIS_PHYSICS_BATCH_QUERY_HPP
+
+#include "../Common/Misc.hpp"
+#include "AABBTree.hpp"
+#include "BoundingMesh.hpp"
+#include "Narrowphase.hpp"
+#include "SpatialGrid.hpp"
+#include "TaskPool.hpp"
+
+namespace Anubis
+{
+  namespace Physics
+  {
+    /***********************************************************************//**
+     * Runs arrays of independent queries against the acceleration structures
+     * in one call, for systems such as AI that issue thousands of queries per
+     * tick. The results are written to buffers supplied by the caller, thus a
+     * batch never allocates for it's results.
+     *
+     * The queries are split into chunks that are spread over the threads of
+     * a TaskPool, so the cost of waking the workers is paid once per batch
+     * rather than once per query. The structures are only read, thus they
+     * must not be modified while a batch runs. Rays are traced against meshes
+     * in packets of BoundingMesh::kPacketSize consecutive rays, so the rays
+     * of a batch should be ordered such that neighbours are coherent, e.g.
+     * grouped by origin.
+     **************************************************************************/
+    class BatchQuery final
+    {
+    public:
+      /*********************************************************************//**
+       * The result of a ray query.
+       ************************************************************************/
+      struct RayHit
+      {
+        /** The distance to the hit, or the maximum distance on a miss. */
+        float fDistance;
+
+        /** The index of the triangle hit, or BoundingMesh::kNoTriangle. */
+        uint32_t fTriangle;
+      };
+
+      /*********************************************************************//**
+       * The result of a sweep query.
+       ************************************************************************/
+      struct SweepHit
+      {
+        /** The contact at the time of impact, only set on a hit. */
+        Contact fContact;
+
+        /** The fraction of the motion at the impact, 1 on a miss. */
+        float fTime;
+
+        /** True if the sphere hit the mesh. */
+        bool fHit;
+      };
+
+      /*********************************************************************//**
+       * Find the triangles that rays hit first.
+       *
+       * @param mesh  The mesh.
+       * @param rays  The rays.
+       * @param maxT  The maximum distance along every ray.
+       * @param count The number of rays.
+       * @param hits  Returns the hit of every ray.
+       * @param pool  The worker pool to use, or nullptr to run serially.
+       ************************************************************************/
+      static void raycast(const BoundingMesh & mesh, const Math::Ray * rays,
+                          const float * maxT, size_t count, RayHit * hits,
+                          TaskPool * pool = nullptr);
+
+      /*********************************************************************//**
+       * Test if rays are blocked by a mesh, e.g. for line of sight checks.
+       * A ray stops at the first triangle it finds, which is cheaper than
+       * finding the closest.
+       *
+       * @param mesh    The mesh.
+       * @param rays    The rays.
+       * @param maxT    The maximum distance along every ray.
+       * @param count   The number of rays.
+       * @param blocked Returns 1 for the rays that hit the mesh, else 0.
+       * @param pool    The worker pool to use, or nullptr to run serially.
+       ************************************************************************/
+      static void occluded(const BoundingMesh & mesh, const Math::Ray * rays,
+                           const float * maxT, size_t count, uint8_t * blocked,
+                           TaskPool * pool = nullptr);
+
+      /*********************************************************************//**
+       * Find when moving spheres first touch a mesh.
+       *
+       * @param mesh    The mesh.
+       * @param spheres The spheres at the start of their motions.
+       * @param motions The displacements of the spheres.
+       * @param count   The number of spheres.
+       * @param hits    Returns the hit of every sphere.
+       * @param pool    The worker pool to use, or nullptr to run serially.
+       ************************************************************************/
+      static void sweep(const BoundingMesh & mesh,
+                        const BoundingSphere * spheres,
+                        const Math::Vector4f * motions, size_t count,
+                        SweepHit * hits, TaskPool * pool = nullptr);
+
+      /*********************************************************************//**
+       * Test if spheres overlap a mesh.
+       *
+       * @param mesh      The mesh.
+       * @param spheres   The spheres.
+       * @param count     The number of spheres.
+       * @param overlaps  Returns 1 for the spheres that touch the mesh, else
+       *                  0.
+       * @param pool      The worker pool to use, or nullptr to run serially.
+       ************************************************************************/
+      static void overlap(const BoundingMesh & mesh,
+                          const BoundingSphere * spheres, size_t count,
+                          uint8_t * overlaps, TaskPool * pool = nullptr);
+
+      /*********************************************************************//**
+       * Find the proxies of a tree whose boxes overlap boxes. Query i writes
+       * it's proxies to proxies[i * capacity] onwards.
+       *
+       * @param tree      The tree.
+       * @param boxes     The boxes.
+       * @param count     The number of boxes.
+       * @param capacity  The number of proxies stored per box.
+       * @param proxies   Returns the proxies, count * capacity entries.
+       * @param found     Returns the number of proxies found per box, which
+       *                  is larger than the capacity if some were dropped.
+       * @param pool      The worker pool to use, or nullptr to run serially.
+       ************************************************************************/
+      static void overlap(const AABBTree & tree, const AABB * boxes,
+                          size_t count, size_t capacity, int32_t * proxies,
+                          uint32_t * found, TaskPool * pool = nullptr);
+
+      /*********************************************************************//**
+       * Find the k entities of a grid closest to positions. Query i writes
+       * it's neighbours to neighbours[i * k] onwards, closest first.
+       *
+       * @param grid        The grid.
+       * @param positions   The centres of the queries.
+       * @param count       The number of positions.
+       * @param k           The number of entities to find per position.
+       * @param maxRadius   The maximum distance to search.
+       * @param neighbours  Returns the neighbours, count * k entries.
+       * @param found       Returns the number of neighbours found per
+       *                    position.
+       * @param pool        The worker pool to use, or nullptr to run serially.
+       ************************************************************************/
+      static void nearest(const SpatialGrid & grid,
+                          const Math::Vector4f * positions, size_t count,
+                          size_t k, float maxRadius,
+                          SpatialGrid::Neighbour * neighbours,
+                          uint32_t * found, TaskPool * pool = nullptr);
+    };
+  }
+}
+
+#endif /* ANUBIS_PHYSICS_BATCH_QUERY_HPP */
@@ -17,8 +17,22 @@ namespace Anubis
 
       BoundingBox(float x1, float x2, float y1, float y2, float z1, float z2);
 
+      /*********************************************************************//**
+       * Calculate the distances where the ray crosses the surface of the box.
+       * If the ray starts inside the box, only the exit distance is returned.
+       *
+       * @param ray       The ray to check for intersections.
+       * @param distances Used to return the intersection distances.
+       ************************************************************************/
       void intersect(const Math::Ray & ray, std::vector<float> & distances);
 
+      /*********************************************************************//**
+       * Return the box as an axis aligned box with ordered corners.
+       *
+       * @return  The axis aligned box.
+       ************************************************************************/
+      AABB aabb() const;
+
     };
   }
 }
@@ -0,0 +1,573 @@
+#ifndef ANUBIS_PHYSICS_BOUNDING_MESH_HPP
+#define ANUBIS_PHYSICS_BOUNDING_MESH_HPP
+
+#include "../Math/Vector4f.hpp"
+#include "BoundingVolume.hpp"
+#include "TraversalStack.hpp"
+#include "Triangle.hpp"
+
+namespace Anubis
+{
+  namespace Physics
+  {
+    /***********************************************************************//**
+     * A bounding volume described by a triangle mesh, i.e. terrain or static
+     * level geometry. The triangles are not required to form a closed
+     * surface, each triangle is treated as double sided.
+     *
+     * The triangles are stored in a bounding volume hierarchy that is built
+     * once with the surface area heuristic and then flattened into nodes with
+     * four children each. The boxes of the four children of a node are stored
+     * as structure of arrays in two cache lines, thus a ray or a box is tested
+     * against all four children at once with SIMD. The triangles are
+     * reordered during the build so that every leaf refers to a contiguous
+     * range of triangles.
+     *
+     * Packets of up to four rays can be traced together, every node is then
+     * fetched once for the whole packet and each child box is tested against
+     * the four rays at once with SIMD. This pays off for coherent rays, such
+     * as the visibility checks from one unit to it's neighbours. Once only
+     * one ray of a packet reaches a subtree it's traced alone.
+     **************************************************************************/
+    class BoundingMesh final : public BoundingVolume
+    {
+    public:
+      /** The largest number of triangles in a leaf of the hierarchy. */
+      static constexpr uint32_t kMaxLeafTriangles = 8;
+
+      /** The largest number of rays in a packet. */
+      static constexpr size_t kPacketSize = 4;
+
+      /** The triangle index of the rays that do not hit the mesh. */
+      static constexpr uint32_t kNoTriangle = 0xFFFFFFFF;
+
+    private:
+      /** The child count used to mark the unused child slots of a node. */
+      static constexpr uint32_t kEmptySlot = 0xFFFFFFFF;
+
+      /*********************************************************************//**
+       * A node of the hierarchy with up to four children. The children are
+       * packed at the front, unused slots are marked with kEmptySlot.
+       ************************************************************************/
+      struct alignas(64) Node
+      {
+        /** The minimum X coordinates of the children's boxes. */
+        float fMinX[4];
+
+        /** The minimum Y coordinates of the children's boxes. */
+        float fMinY[4];
+
+        /** The minimum Z coordinates of the children's boxes. */
+        float fMinZ[4];
+
+        /** The maximum X coordinates of the children's boxes. */
+        float fMaxX[4];
+
+        /** The maximum Y coordinates of the children's boxes. */
+        float fMaxY[4];
+
+        /** The maximum Z coordinates of the children's boxes. */
+        float fMaxZ[4];
+
+        /** The node index of internal children or the first triangle of
+         * leaves. */
+        uint32_t fChildren[4];
+
+        /** The triangle count of leaves, 0 for internal children or
+         * kEmptySlot for unused slots. */
+        uint32_t fCounts[4];
+      };
+
+      /*********************************************************************//**
+       * A node of the binary hierarchy that is built before it is flattened.
+       ************************************************************************/
+      struct BuildNode
+      {
+        /** The box of the node. */
+        AABB fBox;
+
+        /** The children of internal nodes. */
+        uint32_t fChildren[2];
+
+        /** The first triangle of leaves. */
+        uint32_t fFirst;
+
+        /** The triangle count of leaves, 0 for internal nodes. */
+        uint32_t fCount;
+      };
+
+      /*********************************************************************//**
+       * A packet of rays stored as structure of arrays.
+       ************************************************************************/
+      struct alignas(16) RayPacket
+      {
+        /** The origins of the rays, by axis. */
+        float fOrigin[3][kPacketSize];
+
+        /** The directions of the rays, by axis. */
+        float fDirection[3][kPacketSize];
+
+        /** The reciprocals of the ray directions, by axis. */
+        float fInvDir[3][kPacketSize];
+
+        /** The distances to the closest hits so far. */
+        float fMaxT[kPacketSize];
+      };
+
+      /** The vertices of the mesh. */
+      std::vector<Math::Vector4f> fVertices;
+
+      /** The vertex indexes of the triangles, three per triangle. */
+      std::vector<uint32_t> fIndices;
+
+      /** The nodes of the hierarchy, the first node is the root. */
+      std::vector<Node> fNodes;
+
+      /** The box that encloses all the vertices. */
+      AABB fBounds;
+
+      /*********************************************************************//**
+       * Build the hierarchy over the triangles and reorder the triangles to
+       * match the leaves.
+       ************************************************************************/
+      void build();
+
+      /*********************************************************************//**
+       * Recursively build the binary hierarchy over a range of triangles with
+       * the binned surface area heuristic.
+       *
+       * @param nodes     The binary nodes.
+       * @param order     The triangle order, partitioned during the build.
+       * @param centroids The centroids of the triangles.
+       * @param bounds    The boxes of the triangles.
+       * @param first     The first triangle of the range in the order.
+       * @param count     The number of triangles in the range.
+       * @return          The index of the node that was created.
+       ************************************************************************/
+      static uint32_t buildBinary(std::vector<BuildNode> & nodes,
+                                  std::vector<uint32_t> & order,
+                                  const std::vector<Math::Vector4f> & centroids,
+                                  const std::vector<AABB> & bounds,
+                                  uint32_t first, uint32_t count);
+
+      /*********************************************************************//**
+       * Recursively collapse a binary node and it's descendants into a node
+       * with four children.
+       *
+       * @param nodes The binary nodes.
+       * @param index The index of the binary node.
+       * @return      The index of the flattened node.
+       ************************************************************************/
+      uint32_t flatten(const std::vector<BuildNode> & nodes, uint32_t index);
+
+      /*********************************************************************//**
+       * Test the ray against the four children of a node.
+       *
+       * @param node    The node.
+       * @param origin  The origin of the ray.
+       * @param invDir  The reciprocal of the ray direction.
+       * @param maxT    The maximum distance along the ray.
+       * @param tEntry  Returns the entry distances of the children.
+       * @return        A mask with bit k set if child k is hit.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE static int rayMask4(const Node & node,
+        const Math::Vector4f & origin, const Math::Vector4f & invDir,
+        float maxT, float * tEntry)
+      {
+        #ifdef ANUBIS_HAS_SSE
+          /* Clip the whole ray against the slabs of the four children. */
+          const __m128 inf =
+            _mm_set1_ps(std::numeric_limits<float>::infinity());
+          __m128 entry = _mm_sub_ps(_mm_setzero_ps(), inf), exit = inf;
+          __m128 isValid = AABB::clipSlab4(_mm_load_ps(node.fMinX),
+            _mm_load_ps(node.fMaxX), _mm_set1_ps(origin.x()),
+            _mm_set1_ps(invDir.x()), entry, exit);
+          isValid = _mm_and_ps(isValid, AABB::clipSlab4(
+            _mm_load_ps(node.fMinY), _mm_load_ps(node.fMaxY),
+            _mm_set1_ps(origin.y()), _mm_set1_ps(invDir.y()), entry, exit));
+          isValid = _mm_and_ps(isValid, AABB::clipSlab4(
+            _mm_load_ps(node.fMinZ), _mm_load_ps(node.fMaxZ),
+            _mm_set1_ps(origin.z()), _mm_set1_ps(invDir.z()), entry, exit));
+
+          /* The ray hits if the intervals overlap within [0, maxT]. */
+          _mm_storeu_ps(tEntry, entry);
+          return _mm_movemask_ps(_mm_and_ps(_mm_and_ps(
+            _mm_cmple_ps(entry, exit),
+            _mm_cmpge_ps(exit, _mm_setzero_ps())),
+            _mm_and_ps(_mm_cmple_ps(entry, _mm_set1_ps(maxT)), isValid)));
+        #else
+          /* Test the children one by one. */
+          int mask = 0;
+          for(size_t k = 0; k < 4; k++)
+          {
+            AABB box(Math::Vector4f(node.fMinX[k], node.fMinY[k],
+                                    node.fMinZ[k], 1.0f),
+                     Math::Vector4f(node.fMaxX[k], node.fMaxY[k],
+                                    node.fMaxZ[k], 1.0f));
+            float tExit;
+            if(box.intersect(origin, invDir, maxT, tEntry[k], tExit))
+            {
+              mask |= 1 << k;
+            }
+          }
+          return mask;
+        #endif /* ANUBIS_HAS_SSE */
+      }
+
+      /*********************************************************************//**
+       * Trace a ray through the subtree of a node.
+       *
+       * @param root      The node.
+       * @param ray       The ray.
+       * @param maxT      The maximum distance along the ray, returns the
+       *                  distance to the hit.
+       * @param triangle  Returns the index of the triangle that was hit.
+       * @param anyHit    Stop at the first triangle hit rather than the
+       *                  closest.
+       * @return          True if a triangle was hit, else false.
+       ************************************************************************/
+      bool traceRay(uint32_t root, const Math::Ray & ray, float & maxT,
+                    uint32_t & triangle, bool anyHit) const;
+
+      /*********************************************************************//**
+       * Intersect a triangle with the rays of a packet.
+       *
+       * @param triangle  The triangle.
+       * @param packet    The rays.
+       * @param t         Returns the distances to the crossings.
+       * @return          A mask with bit k set if ray k crosses the triangle
+       *                  before it's closest hit so far.
+       ************************************************************************/
+      static int intersectPacket(const Triangle & triangle,
+                                 const RayPacket & packet, float * t);
+
+      /*********************************************************************//**
+       * Test a child of a node against the rays of a packet.
+       *
+       * @param node    The node.
+       * @param child   The index of the child.
+       * @param packet  The rays.
+       * @param tEntry  Returns the entry distances of the rays.
+       * @return        A mask with bit k set if ray k hits the child.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE static int packetMask(const Node & node,
+        size_t child, const RayPacket & packet, float * tEntry)
+      {
+        #ifdef ANUBIS_HAS_SSE
+          /* Clip the four rays against the slabs of the child. */
+          const __m128 inf =
+            _mm_set1_ps(std::numeric_limits<float>::infinity());
+          __m128 entry = _mm_sub_ps(_mm_setzero_ps(), inf), exit = inf;
+          __m128 isValid = AABB::clipSlab4(_mm_set1_ps(node.fMinX[child]),
+            _mm_set1_ps(node.fMaxX[child]), _mm_load_ps(packet.fOrigin[0]),
+            _mm_load_ps(packet.fInvDir[0]), entry, exit);
+          isValid = _mm_and_ps(isValid, AABB::clipSlab4(
+            _mm_set1_ps(node.fMinY[child]), _mm_set1_ps(node.fMaxY[child]),
+            _mm_load_ps(packet.fOrigin[1]), _mm_load_ps(packet.fInvDir[1]),
+            entry, exit));
+          isValid = _mm_and_ps(isValid, AABB::clipSlab4(
+            _mm_set1_ps(node.fMinZ[child]), _mm_set1_ps(node.fMaxZ[child]),
+            _mm_load_ps(packet.fOrigin[2]), _mm_load_ps(packet.fInvDir[2]),
+            entry, exit));
+
+          /* A ray hits if the intervals overlap within [0, maxT]. */
+          _mm_storeu_ps(tEntry, entry);
+          return _mm_movemask_ps(_mm_and_ps(_mm_and_ps(
+            _mm_cmple_ps(entry, exit),
+            _mm_cmpge_ps(exit, _mm_setzero_ps())),
+            _mm_and_ps(_mm_cmple_ps(entry, _mm_load_ps(packet.fMaxT)),
+                       isValid)));
+        #else
+          /* Test the rays one by one. */
+          AABB box(Math::Vector4f(node.fMinX[child], node.fMinY[child],
+                                  node.fMinZ[child], 1.0f),
+                   Math::Vector4f(node.fMaxX[child], node.fMaxY[child],
+                                  node.fMaxZ[child], 1.0f));
+          int mask = 0;
+          for(size_t k = 0; k < kPacketSize; k++)
+          {
+            Math::Vector4f origin(packet.fOrigin[0][k], packet.fOrigin[1][k],
+                                  packet.fOrigin[2][k], 1.0f);
+            Math::Vector4f invDir(packet.fInvDir[0][k], packet.fInvDir[1][k],
+                                  packet.fInvDir[2][k], 0.0f);
+            float tExit;
+            if(box.intersect(origin, invDir, packet.fMaxT[k], tEntry[k], tExit))
+            {
+              mask |= 1 << k;
+            }
+          }
+          return mask;
+        #endif /* ANUBIS_HAS_SSE */
+      }
+
+      /*********************************************************************//**
+       * Test a box against the four children of a node.
+       *
+       * @param node  The node.
+       * @param box   The box.
+       * @return      A mask with bit k set if the box overlaps child k.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE static int overlapMask4(const Node & node,
+                                                  const AABB & box)
+      {
+        #ifdef ANUBIS_HAS_SSE
+          __m128 x = _mm_and_ps(
+            _mm_cmple_ps(_mm_load_ps(node.fMinX), _mm_set1_ps(box.fMax.x())),
+            _mm_cmple_ps(_mm_set1_ps(box.fMin.x()), _mm_load_ps(node.fMaxX)));
+          __m128 y = _mm_and_ps(
+            _mm_cmple_ps(_mm_load_ps(node.fMinY), _mm_set1_ps(box.fMax.y())),
+            _mm_cmple_ps(_mm_set1_ps(box.fMin.y()), _mm_load_ps(node.fMaxY)));
+          __m128 z = _mm_and_ps(
+            _mm_cmple_ps(_mm_load_ps(node.fMinZ), _mm_set1_ps(box.fMax.z())),
+            _mm_cmple_ps(_mm_set1_ps(box.fMin.z()), _mm_load_ps(node.fMaxZ)));
+          return _mm_movemask_ps(_mm_and_ps(_mm_and_ps(x, y), z));
+        #else
+          int mask = 0;
+          for(size_t k = 0; k < 4; k++)
+          {
+            if(node.fMinX[k] <= box.fMax.x() && box.fMin.x() <= node.fMaxX[k] &&
+               node.fMinY[k] <= box.fMax.y() && box.fMin.y() <= node.fMaxY[k] &&
+               node.fMinZ[k] <= box.fMax.z() && box.fMin.z() <= node.fMaxZ[k])
+            {
+              mask |= 1 << k;
+            }
+          }
+          return mask;
+        #endif /* ANUBIS_HAS_SSE */
+      }
+
+    public:
+
+      /*********************************************************************//**
+       * Create a mesh from a list of vertices and triangles and build it's
+       * hierarchy.
+       *
+       * @param vertices  The vertices of the mesh.
+       * @param indices   The vertex indexes of the triangles, three per
+       *                  triangle.
+       ************************************************************************/
+      BoundingMesh(const std::vector<Math::Vector4f> & vertices,
+                   const std::vector<uint32_t> & indices);
+
+      /*********************************************************************//**
+       * Load a mesh and it's hierarchy that was stored with serialise(),
+       * without rebuilding the hierarchy. The data is in the byte order of
+       * the host that stored it. Truncated or corrupted data, such as an
+       * index or a child outside the mesh, raises a runtime exception.
+       *
+       * @param data  The serialised mesh.
+       * @param size  The size of the data in bytes.
+       ************************************************************************/
+      BoundingMesh(const uint8_t * data, size_t size);
+
+      /*********************************************************************//**
+       * Return the number of triangles in the mesh.
+       *
+       * @return  The number of triangles.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t triangleCount() const
+      {
+        return fIndices.size() / 3;
+      }
+
+      /*********************************************************************//**
+       * Return a triangle of the mesh.
+       *
+       * @param index The index of the triangle.
+       * @return      The triangle.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE Triangle triangle(size_t index) const
+      {
+        return Triangle{fVertices[fIndices[index * 3]],
+                        fVertices[fIndices[index * 3 + 1]],
+                        fVertices[fIndices[index * 3 + 2]]};
+      }
+
+      /*********************************************************************//**
+       * Return the corners of a triangle.
+       *
+       * @param index The index of the triangle.
+       * @param a     Returns the first corner.
+       * @param b     Returns the second corner.
+       * @param c     Returns the third corner.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE void triangle(size_t index, Math::Vector4f & a,
+                                        Math::Vector4f & b,
+                                        Math::Vector4f & c) const
+      {
+        a = fVertices[fIndices[index * 3]];
+        b = fVertices[fIndices[index * 3 + 1]];
+        c = fVertices[fIndices[index * 3 + 2]];
+      }
+
+      /*********************************************************************//**
+       * Return the vertices of the mesh.
+       *
+       * @return  The vertices of the mesh.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE const std::vector<Math::Vector4f> & vertices() const
+      {
+        return fVertices;
+      }
+
+      /*********************************************************************//**
+       * Return the vertex indexes of the triangles in the order of the
+       * hierarchy's leaves.
+       *
+       * @return  The vertex indexes, three per triangle.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE const std::vector<uint32_t> & indices() const
+      {
+        return fIndices;
+      }
+
+      /*********************************************************************//**
+       * Return the number of nodes in the hierarchy.
+       *
+       * @return  The number of nodes.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t nodeCount() const
+      {
+        return fNodes.size();
+      }
+
+      /*********************************************************************//**
+       * Invoke the callback for the triangles in the leaves whose boxes
+       * overlap the box. The triangles themselves are not tested.
+       *
+       * @param box       The box to query.
+       * @param callback  Invoked as bool callback(size_t triangle), return
+       *                  false to terminate the query.
+       ************************************************************************/
+      template <typename Callback>
+      void queryAABB(const AABB & box, Callback && callback) const
+      {
+        /* Start at the root unless the box misses the whole mesh. */
+        TraversalStack<uint32_t> stack;
+        if(!fNodes.empty() && fBounds.overlaps(box))
+        {
+          stack.push(0);
+        }
+
+        while(!stack.empty())
+        {
+          /* Visit the children that overlap the box. */
+          const Node & node = fNodes[stack.pop()];
+          int mask = overlapMask4(node, box);
+          while(mask)
+          {
+            int k = Common::Bits::countTrailingZeros(mask);
+            mask &= mask - 1;
+
+            /* Descend into internal children. */
+            uint32_t count = node.fCounts[k];
+            if(count == 0)
+            {
+              stack.push(node.fChildren[k]);
+              continue;
+            }
+
+            /* Skip the unused slots. */
+            if(count == kEmptySlot)
+            {
+              continue;
+            }
+
+            /* Report the triangles of leaves. */
+            for(uint32_t i = 0; i < count; i++)
+            {
+              if(!callback(size_t(node.fChildren[k] + i)))
+              {
+                return;
+              }
+            }
+          }
+        }
+      }
+
+      /*********************************************************************//**
+       * Find the triangle that the ray hits first.
+       *
+       * @param ray       The ray.
+       * @param maxT      The maximum distance along the ray.
+       * @param distance  Returns the distance to the hit.
+       * @param triangle  Returns the index of the triangle that was hit.
+       * @return          True if a triangle was hit, else false.
+       ************************************************************************/
+      bool raycast(const Math::Ray & ray, float maxT, float & distance,
+                   size_t & triangle) const;
+
+      /*********************************************************************//**
+       * Find the triangles that a packet of rays hit first, tracing the rays
+       * through the hierarchy together.
+       *
+       * @param rays      The rays.
+       * @param count     The number of rays, at most kPacketSize.
+       * @param maxT      The maximum distances along the rays, returns the
+       *                  distances to the hits.
+       * @param triangles Returns the indexes of the triangles that were hit,
+       *                  or kNoTriangle.
+       * @param anyHit    Stop a ray at the first triangle it hits rather than
+       *                  the closest, e.g. for visibility checks.
+       * @return          A mask with bit k set if ray k hit a triangle.
+       ************************************************************************/
+      int raycast(const Math::Ray * rays, size_t count, float * maxT,
+                  uint32_t * triangles, bool anyHit = false) const;
+
+      /*********************************************************************//**
+       * Return true if any triangle overlaps the box.
+       *
+       * @param box The box.
+       * @return    True if the box touches the mesh, else false.
+       ************************************************************************/
+      bool overlaps(const AABB & box) const;
+
+      /*********************************************************************//**
+       * Return true if any triangle overlaps the sphere.
+       *
+       * @param centre  The centre of the sphere.
+       * @param radius  The radius of the sphere.
+       * @return        True if the sphere touches the mesh, else false.
+       ************************************************************************/
+      bool overlaps(const Math::Vector4f & centre, float radius) const;
+
+      /*********************************************************************//**
+       * Find the point of the mesh closest to a position.
+       *
+       * @param position    The position.
+       * @param maxDistance Only points within this distance are considered.
+       * @param point       Returns the closest point.
+       * @param triangle    Returns the index of the triangle of the point.
+       * @return            True if a point within the distance was found.
+       ************************************************************************/
+      bool closestPoint(const Math::Vector4f & position, float maxDistance,
+                        Math::Vector4f & point, size_t & triangle) const;
+
+      /*********************************************************************//**
+       * Append the vertices, the triangles and the built hierarchy to a byte
+       * buffer so that the mesh can be loaded without rebuilding it.
+       *
+       * @param data  The buffer the mesh is appended to.
+       ************************************************************************/
+      void serialise(std::vector<uint8_t> & data) const;
+
+      /*********************************************************************//**
+       * Calculate the distances where the ray crosses the triangles of the
+       * mesh, in ascending order.
+       *
+       * @param ray       The ray to check for intersections.
+       * @param distances Used to return the intersection distances.
+       ************************************************************************/
+      void intersect(const Math::Ray & ray, std::vector<float> & distances);
+
+      /*********************************************************************//**
+       * Return the axis aligned box that encloses the mesh.
+       *
+       * @return  The enclosing axis aligned box.
+       ************************************************************************/
+      AABB aabb() const;
+    };
+  }
+}
+
+#endif /* ANUBIS_PHYSICS_BOUNDING_MESH_HPP */
@@ -0,0 +1,74 @@
+#ifndef ANUBIS_PHYSICS_BOUNDING_SPHERE_HPP
+#define ANUBIS_PHYSICS_BOUNDING_SPHERE_HPP
+
+#include "../Math/Vector4f.hpp"
+#include "BoundingVolume.hpp"
+
+namespace Anubis
+{
+  namespace Physics
+  {
+    /***********************************************************************//**
+     * A bounding volume described by a centre and a radius.
+     **************************************************************************/
+    class BoundingSphere final : public BoundingVolume
+    {
+      /** The centre of the sphere. */
+      Math::Vector4f fCentre;
+
+      /** The radius of the sphere. */
+      float fRadius;
+
+    public:
+
+      /*********************************************************************//**
+       * Create a sphere from it's centre and radius.
+       *
+       * @param x       The X coordinate of the centre.
+       * @param y       The Y coordinate of the centre.
+       * @param z       The Z coordinate of the centre.
+       * @param radius  The radius of the sphere.
+       ************************************************************************/
+      BoundingSphere(float x, float y, float z, float radius);
+
+      /*********************************************************************//**
+       * Return the centre of the sphere.
+       *
+       * @return  The centre of the sphere.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE const Math::Vector4f & centre() const
+      {
+        return fCentre;
+      }
+
+      /*********************************************************************//**
+       * Return the radius of the sphere.
+       *
+       * @return  The radius of the sphere.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE float radius() const
+      {
+        return fRadius;
+      }
+
+      /*********************************************************************//**
+       * Calculate the distances where the ray crosses the surface of the
+       * sphere. If the ray starts inside the sphere, only the exit distance is
+       * returned.
+       *
+       * @param ray       The ray to check for intersections.
+       * @param distances Used to return the intersection distances.
+       ************************************************************************/
+      void intersect(const Math::Ray & ray, std::vector<float> & distances);
+
+      /*********************************************************************//**
+       * Return the axis aligned box that encloses the sphere.
+       *
+       * @return  The enclosing axis aligned box.
+       ************************************************************************/
+      AABB aabb() const;
+    };
+  }
+}
+
+#endif /* ANUBIS_PHYSICS_BOUNDING_SPHERE_HPP */
@@ -3,6 +3,7 @@
 
 #include "../Common/UUID.hpp"
 #include "../Math/Ray.hpp"
+#include "AABB.hpp"
 
 namespace Anubis
 {
@@ -13,7 +14,7 @@ namespace Anubis
      **************************************************************************/
     class BoundingVolume
     {
-    protected:
+    public:
       /** The diffirent bounding volume types. */
       enum class Types
       {
@@ -27,6 +28,8 @@ namespace Anubis
         Mesh
       };
 
+    protected:
+
       /** The UUID of the bounding volume. */
       Common::UUID fUUID;
 
@@ -69,6 +72,17 @@ namespace Anubis
         return fUUID;
       }
 
+      /*********************************************************************//**
+       * Return the type of the bounding volume, used to dispatch to the type
+       * specific code without a virtual call.
+       *
+       * @return  The type of the bounding volume.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE Types type() const
+      {
+        return fType;
+      }
+
       /*********************************************************************//**
        * Set the UUID of the bounding volume.
        *
@@ -89,6 +103,14 @@ namespace Anubis
        ************************************************************************/
       virtual void intersect(const Math::Ray & ray,
                              std::vector<float> & distances) = 0;
+
+      /*********************************************************************//**
+       * Return the axis aligned box that encloses the bounding volume, used to
+       * insert the volume into the broadphase.
+       *
+       * @return  The enclosing axis aligned box.
+       ************************************************************************/
+      virtual AABB aabb() const = 0;
     };
   }
 }
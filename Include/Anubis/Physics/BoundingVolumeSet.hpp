@@ -0,0 +1,299 @@
+#ifndef ANUBIS_PHYSICS_BOUNDING_VOLUME_SET_HPP
+#define ANUBIS_PHYSICS_BOUNDING_VOLUME_SET_HPP
+
+#include "../Common/Misc.hpp"
+#include "BoundingBox.hpp"
+#include "BoundingSphere.hpp"
+
+namespace Anubis
+{
+  namespace Physics
+  {
+    /***********************************************************************//**
+     * A collection of bounding volumes optimised for ray casts. Instead of
+     * calling BoundingVolume::intersect() through the vtable for every
+     * volume, the volumes of each type are copied into their own contiguous
+     * structure of arrays and every type is tested in a tight loop, four
+     * volumes at a time when SSE is available. The type is encoded in the
+     * volume ID so that single volume queries dispatch on the tag with a
+     * switch rather than a virtual call.
+     *
+     * The queries write the hits into a buffer provided by the caller and
+     * never allocate, the buffer is typically on the stack.
+     *
+     * Only boxes and spheres can be added. A BoundingMesh is queried through
+     * it's own hierarchy with BoundingMesh::raycast(), typically after a ray
+     * hit it's bounds in the set, and adding one raises a runtime exception.
+     **************************************************************************/
+    class BoundingVolumeSet final
+    {
+    public:
+      /** The ID of a volume in the set, the top bits store the type. */
+      typedef uint32_t VolumeID;
+
+      /** The ID used to indicate the absence of a volume. */
+      static constexpr VolumeID kNullVolume = 0xFFFFFFFF;
+
+      /*********************************************************************//**
+       * A ray cast hit.
+       ************************************************************************/
+      struct RayHit
+      {
+        /** The volume that was hit. */
+        VolumeID fVolume;
+
+        /** The distance along the ray where it first crosses the surface of
+         * the volume. */
+        float fDistance;
+      };
+
+    private:
+      /** The number of bits the type is shifted by in a volume ID. */
+      static constexpr uint32_t kTypeShift = 30;
+
+      /** The mask of the slot index in a volume ID. */
+      static constexpr uint32_t kSlotMask = (1u << kTypeShift) - 1;
+
+      /*********************************************************************//**
+       * Maps the stable slot indexes of a type to the dense indexes of it's
+       * arrays. The arrays stay packed when volumes are removed by moving the
+       * last volume into the gap.
+       ************************************************************************/
+      struct Slots
+      {
+        /** The dense index of every slot, or the next free slot if the slot
+         * is on the free list. */
+        std::vector<uint32_t> fDense;
+
+        /** The slot of every dense index. */
+        std::vector<uint32_t> fSlots;
+
+        /** The head of the list of free slots. */
+        uint32_t fFreeList = kNullVolume;
+
+        /*******************************************************************//**
+         * Free every slot, keeping the memory.
+         **********************************************************************/
+        ANUBIS_FORCE_INLINE void clear()
+        {
+          fDense.clear();
+          fSlots.clear();
+          fFreeList = kNullVolume;
+        }
+      };
+
+      /** The minimum X coordinates of the boxes. */
+      std::vector<float> fBoxMinX;
+
+      /** The minimum Y coordinates of the boxes. */
+      std::vector<float> fBoxMinY;
+
+      /** The minimum Z coordinates of the boxes. */
+      std::vector<float> fBoxMinZ;
+
+      /** The maximum X coordinates of the boxes. */
+      std::vector<float> fBoxMaxX;
+
+      /** The maximum Y coordinates of the boxes. */
+      std::vector<float> fBoxMaxY;
+
+      /** The maximum Z coordinates of the boxes. */
+      std::vector<float> fBoxMaxZ;
+
+      /** The slots of the boxes. */
+      Slots fBoxSlots;
+
+      /** The X coordinates of the sphere centres. */
+      std::vector<float> fSphereX;
+
+      /** The Y coordinates of the sphere centres. */
+      std::vector<float> fSphereY;
+
+      /** The Z coordinates of the sphere centres. */
+      std::vector<float> fSphereZ;
+
+      /** The radii of the spheres. */
+      std::vector<float> fSphereRadius;
+
+      /** The slots of the spheres. */
+      Slots fSphereSlots;
+
+      /*********************************************************************//**
+       * Make a volume ID from a type and a slot.
+       *
+       * @param type  The type of the volume.
+       * @param slot  The slot of the volume.
+       * @return      The volume ID.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE static VolumeID makeID(BoundingVolume::Types type,
+                                                 uint32_t slot)
+      {
+        return (static_cast<uint32_t>(type) << kTypeShift) | slot;
+      }
+
+      /*********************************************************************//**
+       * Return the slot of a volume ID.
+       *
+       * @param volume  The volume ID.
+       * @return        The slot of the volume.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE static uint32_t slotOf(VolumeID volume)
+      {
+        return volume & kSlotMask;
+      }
+
+      /*********************************************************************//**
+       * Allocate a slot that maps to the specified dense index.
+       *
+       * @param slots The slots of the type.
+       * @param dense The dense index of the new volume.
+       * @return      The slot.
+       ************************************************************************/
+      static uint32_t allocateSlot(Slots & slots, uint32_t dense);
+
+      /*********************************************************************//**
+       * Free the slot of a volume after the last volume was moved into it's
+       * dense index.
+       *
+       * @param slots The slots of the type.
+       * @param slot  The slot to free.
+       * @return      The dense index that the slot mapped to.
+       ************************************************************************/
+      static uint32_t releaseSlot(Slots & slots, uint32_t slot);
+
+      /*********************************************************************//**
+       * Invoke the callback for every box the ray hits within [0, maxT].
+       *
+       * @param ray       The ray.
+       * @param maxT      The maximum distance along the ray.
+       * @param callback  Invoked as void callback(uint32_t dense, float t).
+       ************************************************************************/
+      template <typename Callback>
+      void forEachBoxHit(const Math::Ray & ray, float maxT,
+                         Callback && callback) const;
+
+      /*********************************************************************//**
+       * Invoke the callback for every sphere the ray hits within [0, maxT].
+       *
+       * @param ray       The ray.
+       * @param maxT      The maximum distance along the ray.
+       * @param callback  Invoked as void callback(uint32_t dense, float t).
+       ************************************************************************/
+      template <typename Callback>
+      void forEachSphereHit(const Math::Ray & ray, float maxT,
+                            Callback && callback) const;
+
+    public:
+
+      /*********************************************************************//**
+       * Create an empty set.
+       ************************************************************************/
+      BoundingVolumeSet() {}
+
+      /*********************************************************************//**
+       * Make sure that the specified number of volumes of each type can be
+       * stored without allocating.
+       *
+       * @param boxCount    The number of boxes.
+       * @param sphereCount The number of spheres.
+       ************************************************************************/
+      void reserve(size_t boxCount, size_t sphereCount);
+
+      /*********************************************************************//**
+       * Remove all the volumes, the memory is kept.
+       ************************************************************************/
+      void clear();
+
+      /*********************************************************************//**
+       * Copy a volume into the set. Only boxes and spheres are supported,
+       * any other type raises a runtime exception.
+       *
+       * @param volume  The volume to add.
+       * @return        The ID of the volume in the set.
+       ************************************************************************/
+      VolumeID add(const BoundingVolume & volume);
+
+      /*********************************************************************//**
+       * Replace a volume with a volume of the same type, i.e. after it moved.
+       *
+       * @param id      The ID of the volume to replace.
+       * @param volume  The new volume.
+       ************************************************************************/
+      void update(VolumeID id, const BoundingVolume & volume);
+
+      /*********************************************************************//**
+       * Remove a volume from the set. The IDs of the other volumes remain
+       * valid.
+       *
+       * @param id  The ID of the volume to remove.
+       ************************************************************************/
+      void remove(VolumeID id);
+
+      /*********************************************************************//**
+       * Return the type of a volume.
+       *
+       * @param id  The ID of the volume.
+       * @return    The type of the volume.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE static BoundingVolume::Types typeOf(VolumeID id)
+      {
+        return static_cast<BoundingVolume::Types>(id >> kTypeShift);
+      }
+
+      /*********************************************************************//**
+       * Return the number of volumes in the set.
+       *
+       * @return  The number of volumes.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t size() const
+      {
+        return fBoxMinX.size() + fSphereX.size();
+      }
+
+      /*********************************************************************//**
+       * Find every volume the ray hits within [0, maxT]. Every volume is
+       * reported once with the distance where the ray first crosses it's
+       * surface, which is the exit distance if the ray starts inside the
+       * volume. The hits are not sorted.
+       *
+       * @param ray       The ray.
+       * @param maxT      The maximum distance along the ray.
+       * @param hits      The buffer the hits are written to.
+       * @param capacity  The number of hits the buffer can store.
+       * @return          The number of volumes hit, if this is greater than
+       *                  the capacity only the first capacity hits were
+       *                  written.
+       ************************************************************************/
+      size_t intersect(const Math::Ray & ray, float maxT, RayHit * hits,
+                       size_t capacity) const;
+
+      /*********************************************************************//**
+       * Find the volume that the ray hits first.
+       *
+       * @param ray   The ray.
+       * @param maxT  The maximum distance along the ray.
+       * @param hit   Returns the closest hit.
+       * @return      True if a volume was hit, else false.
+       ************************************************************************/
+      bool intersectClosest(const Math::Ray & ray, float maxT,
+                            RayHit & hit) const;
+
+      /*********************************************************************//**
+       * Calculate the distances where the ray crosses the surface of a single
+       * volume, the same as BoundingVolume::intersect() but without the
+       * virtual call or the allocation.
+       *
+       * @param id        The ID of the volume.
+       * @param ray       The ray.
+       * @param distances The buffer the distances are written to, two entries
+       *                  are sufficient for boxes and spheres.
+       * @param capacity  The number of distances the buffer can store.
+       * @return          The number of distances written.
+       ************************************************************************/
+      size_t intersect(VolumeID id, const Math::Ray & ray, float * distances,
+                       size_t capacity) const;
+    };
+  }
+}
+
+#endif /* ANUBIS_PHYSICS_BOUNDING_VOLUME_SET_HPP */
@@ -0,0 +1,125 @@
+#ifndef ANUBIS_PHYSICS_BROADPHASE_HPP
+#define ANUBIS_PHYSICS_BROADPHASE_HPP
+
+#include "../Common/Misc.hpp"
+#include "AABB.hpp"
+
+namespace Anubis
+{
+  namespace Physics
+  {
+    /***********************************************************************//**
+     * The common interface of the collision broadphases. A broadphase stores
+     * a box per object (a proxy) and reports the pairs of proxies whose boxes
+     * overlap. Which implementation works best depends on the scene, thus the
+     * physics code only talks to this interface and the implementation is
+     * selected when the broadphase is created.
+     *
+     * The implementations also provide template versions of the queries that
+     * invoke a callback directly, which should be used when the concrete type
+     * is known.
+     **************************************************************************/
+    class Broadphase
+    {
+    public:
+      /** The index used to indicate the absence of a proxy. */
+      static const int32_t kNullProxy = -1;
+
+      /** A pair of overlapping proxies, the first is the smaller ID. */
+      typedef std::pair<int32_t, int32_t> ProxyPair;
+
+      /** The diffirent broadphase implementations. */
+      enum class Types
+      {
+        /** A dynamic AABB tree, see AABBTree. Best for scenes with a wide
+         * range of object sizes and many static objects. */
+        AABBTree,
+
+        /** Sweep and prune, see SweepAndPrune. Best for dense crowds of
+         * similar sized objects that move every frame. */
+        SweepAndPrune
+      };
+
+      /*********************************************************************//**
+       * Create a broadphase of the specified type.
+       *
+       * @param type  The implementation to create.
+       * @return      The new broadphase.
+       ************************************************************************/
+      static std::unique_ptr<Broadphase> create(Types type);
+
+      /*********************************************************************//**
+       * A blank virtual destructor to ensure that the destructor of any
+       * subclass is invoked upon destruction.
+       ************************************************************************/
+      virtual ~Broadphase() {}
+
+      /*********************************************************************//**
+       * Remove all the proxies.
+       ************************************************************************/
+      virtual void clear() = 0;
+
+      /*********************************************************************//**
+       * Create a proxy for an object.
+       *
+       * @param box       The box of the object.
+       * @param userData  The user data to associate with the proxy.
+       * @return          The proxy ID.
+       ************************************************************************/
+      virtual int32_t insert(const AABB & box, void * userData) = 0;
+
+      /*********************************************************************//**
+       * Destroy a proxy.
+       *
+       * @param proxy The ID of the proxy to destroy.
+       ************************************************************************/
+      virtual void remove(int32_t proxy) = 0;
+
+      /*********************************************************************//**
+       * Update the box of a proxy after the object moved.
+       *
+       * @param proxy         The ID of the proxy.
+       * @param box           The new box of the object.
+       * @param displacement  The displacement of the object since the last
+       *                      move.
+       * @return              True if the stored box changed, else false.
+       ************************************************************************/
+      virtual bool move(int32_t proxy, const AABB & box,
+                        const Math::Vector4f & displacement) = 0;
+
+      /*********************************************************************//**
+       * Return the user data that was associated with the proxy.
+       *
+       * @param proxy The ID of the proxy.
+       * @return      The user data of the proxy.
+       ************************************************************************/
+      virtual void * getUserData(int32_t proxy) const = 0;
+
+      /*********************************************************************//**
+       * Return the number of proxies.
+       *
+       * @return  The number of proxies.
+       ************************************************************************/
+      virtual size_t size() const = 0;
+
+      /*********************************************************************//**
+       * Append the proxies whose boxes overlap the box to the vector.
+       *
+       * @param box     The box to query.
+       * @param proxies The vector that the proxy IDs are appended to.
+       ************************************************************************/
+      virtual void queryAABB(const AABB & box,
+                             std::vector<int32_t> & proxies) const = 0;
+
+      /*********************************************************************//**
+       * Append every pair of proxies whose boxes overlap to the vector. The
+       * order of the pairs is implementation specific.
+       *
+       * @param pairs The vector that the pairs are appended to.
+       ************************************************************************/
+      virtual void queryPairs(std::vector<ProxyPair> & pairs) const = 0;
+    };
+  }
+}
+
+#endif /* ANUBIS_PHYSICS_BROADPHASE_HPP */
@@ -0,0 +1,280 @@
+#ifndef ANUBIS_PHYSICS_CONTACT_SOLVER_HPP
+#define ANUBIS_PHYSICS_CONTACT_SOLVER_HPP
+
+#include "../Common/Misc.hpp"
+#include "Narrowphase.hpp"
+#include "RigidBodyWorld.hpp"
+#include "TaskPool.hpp"
+
+namespace Anubis
+{
+  namespace Physics
+  {
+    /***********************************************************************//**
+     * Solves the non-penetration and friction constraints of contacts between
+     * rigid bodies with sequential impulses, i.e. projected Gauss-Seidel on
+     * the velocities. It runs between RigidBodyWorld::integrateVelocities()
+     * and RigidBodyWorld::integratePositions().
+     *
+     * The constraints are greedily coloured so that no two constraints of
+     * the same colour share a dynamic body. The constraints of a colour are
+     * packed four to a block and solved four at a time with SIMD, and the
+     * blocks of a colour are split between the threads of a pool, since
+     * they never write the same body. The colours are solved one after the
+     * other. The colouring only depends on the order of the constraints, so
+     * the results are identical for any number of threads. Constraints that
+     * do not fit in kMaxColours colours are solved one at a time after the
+     * colours.
+     *
+     * The accumulated impulses are kept between calls and used to warm start
+     * the contacts of the same pair of bodies at nearby points.
+     *
+     * Sleeping bodies touched by awake bodies that move are woken. The
+     * constraints without an awake dynamic body are skipped.
+     *
+     * A contact with a negative depth is speculative, the bodies are apart by
+     * -depth and the constraint only stops them from closing more than the
+     * gap in one step. See ContinuousCollision.
+     **************************************************************************/
+    class ContactSolver final
+    {
+    public:
+      /*********************************************************************//**
+       * A contact between two bodies.
+       ************************************************************************/
+      struct Constraint
+      {
+        /** The first body. */
+        RigidBodyWorld::BodyID fBodyA;
+
+        /** The second body, or kNullBody for static geometry that is not a
+         * body of the world. */
+        RigidBodyWorld::BodyID fBodyB;
+
+        /** The contact, the normal points from A towards B. */
+        Contact fContact;
+
+        /** The coefficient of friction. */
+        float fFriction;
+      };
+
+      /** The number of colours before constraints are solved serially. */
+      static constexpr size_t kMaxColours = 64;
+
+    private:
+      /** The body index used for the lanes without a body. */
+      static constexpr uint32_t kNoBody = 0xFFFFFFFF;
+
+      /** The number of constraints in a block. */
+      static constexpr size_t kLaneWidth = 4;
+
+      /*********************************************************************//**
+       * One row, i.e. one direction, of the constraints of a block.
+       ************************************************************************/
+      struct Row
+      {
+        /** The direction of the row. */
+        float fDirection[3][kLaneWidth];
+
+        /** rA x direction. */
+        float fAngularA[3][kLaneWidth];
+
+        /** rB x direction. */
+        float fAngularB[3][kLaneWidth];
+
+        /** The world inverse inertia of A times fAngularA. */
+        float fInertiaA[3][kLaneWidth];
+
+        /** The world inverse inertia of B times fAngularB. */
+        float fInertiaB[3][kLaneWidth];
+
+        /** The inverse of the effective mass along the row. */
+        float fEffectiveMass[kLaneWidth];
+
+        /** The accumulated impulse. */
+        float fImpulse[kLaneWidth];
+      };
+
+      /*********************************************************************//**
+       * Four constraints without shared dynamic bodies, stored as structure
+       * of arrays.
+       ************************************************************************/
+      struct alignas(16) Block
+      {
+        /** The dense indexes of the first bodies. */
+        uint32_t fBodyA[kLaneWidth];
+
+        /** The dense indexes of the second bodies. */
+        uint32_t fBodyB[kLaneWidth];
+
+        /** The inverse masses of the first bodies. */
+        float fInvMassA[kLaneWidth];
+
+        /** The inverse masses of the second bodies. */
+        float fInvMassB[kLaneWidth];
+
+        /** The separating velocity that removes the penetration. */
+        float fBias[kLaneWidth];
+
+        /** The coefficients of friction. */
+        float fFriction[kLaneWidth];
+
+        /** The normal row followed by the two friction rows. */
+        Row fRows[3];
+      };
+
+      /*********************************************************************//**
+       * The impulses of a contact kept for warm starting.
+       ************************************************************************/
+      struct CachedImpulse
+      {
+        /** The IDs of the bodies. */
+        uint64_t fKey;
+
+        /** The point of the contact. */
+        Math::Vector4f fPoint;
+
+        /** The normal and friction impulses. */
+        float fImpulses[3];
+      };
+
+      /** The blocks, ordered by colour. */
+      std::vector<Block> fBlocks;
+
+      /** The first block of every colour, followed by the first block of
+       * the serial constraints and the number of blocks. */
+      std::vector<uint32_t> fColourStarts;
+
+      /** The block and lane of every constraint, block * 4 + lane, or
+       * kNoBody if it's skipped. */
+      std::vector<uint32_t> fLanes;
+
+      /** The colours used by every dynamic body, one bit per colour. */
+      std::vector<uint64_t> fBodyColours;
+
+      /** The impulses of the last solve, sorted by key. */
+      std::vector<CachedImpulse> fCache;
+
+      /** The number of iterations. */
+      size_t fIterations;
+
+      /** The fraction of the penetration removed per step. */
+      float fBaumgarte;
+
+      /** The penetration that is allowed without correction. */
+      float fSlop;
+
+      /*********************************************************************//**
+       * Colour the constraints and build the blocks.
+       *
+       * @param world       The bodies.
+       * @param constraints The constraints.
+       * @param count       The number of constraints.
+       * @param dt          The time step in seconds.
+       ************************************************************************/
+      void prepare(RigidBodyWorld & world, const Constraint * constraints,
+                   size_t count, float dt);
+
+      /*********************************************************************//**
+       * Find the impulses of the last solve for a constraint.
+       *
+       * @param constraint  The constraint.
+       * @return            The closest cached contact of the same pair of
+       *                    bodies, or nullptr if there is none.
+       ************************************************************************/
+      const CachedImpulse * findCached(const Constraint & constraint) const;
+
+      /*********************************************************************//**
+       * Apply the impulses of the last solve to the matching constraints.
+       *
+       * @param world       The bodies.
+       * @param constraints The constraints.
+       * @param count       The number of constraints.
+       ************************************************************************/
+      void warmStart(RigidBodyWorld & world, const Constraint * constraints,
+                     size_t count);
+
+      /*********************************************************************//**
+       * Run one iteration over a range of blocks.
+       *
+       * @param world The bodies.
+       * @param begin The first block.
+       * @param end   The block after the last.
+       ************************************************************************/
+      void solveBlocks(RigidBodyWorld & world, size_t begin, size_t end);
+
+    public:
+
+      /*********************************************************************//**
+       * Create a solver.
+       *
+       * @param iterations  The number of iterations per solve.
+       ************************************************************************/
+      ContactSolver(size_t iterations = 8);
+
+      /*********************************************************************//**
+       * Set the number of iterations per solve.
+       *
+       * @param iterations  The number of iterations.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE void setIterations(size_t iterations)
+      {
+        fIterations = iterations;
+      }
+
+      /*********************************************************************//**
+       * Set how penetration is corrected.
+       *
+       * @param baumgarte The fraction of the penetration removed per step.
+       * @param slop      The penetration that is allowed without correction.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE void setStabilisation(float baumgarte, float slop)
+      {
+        fBaumgarte = baumgarte;
+        fSlop = slop;
+      }
+
+      /*********************************************************************//**
+       * Solve the constraints by changing the velocities of the bodies.
+       *
+       * @param world       The bodies.
+       * @param constraints The constraints.
+       * @param count       The number of constraints.
+       * @param dt          The time step in seconds.
+       * @param pool        The worker pool to use, or nullptr to run
+       *                    serially.
+       ************************************************************************/
+      void solve(RigidBodyWorld & world, const Constraint * constraints,
+                 size_t count, float dt, TaskPool * pool = nullptr);
+
+      /*********************************************************************//**
+       * Return the number of colours used by the last solve.
+       *
+       * @return  The number of colours.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t colourCount() const
+      {
+        return fColourStarts.empty() ? 0 : fColourStarts.size() - 2;
+      }
+
+      /*********************************************************************//**
+       * Return the normal impulse applied to a constraint by the last solve.
+       *
+       * @param constraint  The index of the constraint.
+       * @return            The accumulated normal impulse, 0 if the
+       *                    constraint was skipped.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE float normalImpulse(size_t constraint) const
+      {
+        const uint32_t lane = fLanes[constraint];
+        if(lane == kNoBody)
+        {
+          return 0.0f;
+        }
+        return fBlocks[lane / kLaneWidth].fRows[0].fImpulse[lane % kLaneWidth];
+      }
+    };
+  }
+}
+
+#endif /* ANUBIS_PHYSICS_CONTACT_SOLVER_HPP */
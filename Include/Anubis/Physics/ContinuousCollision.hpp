@@ -0,0 +1,194 @@
+#ifndef ANUBIS_PHYSICS_CONTINUOUS_COLLISION_HPP
+#define ANUBIS_PHYSICS_CONTINUOUS_COLLISION_HPP
+
+#include "../Common/Misc.hpp"
+#include "BoundingBox.hpp"
+#include "BoundingMesh.hpp"
+#include "ContactSolver.hpp"
+#include "RigidBodyWorld.hpp"
+
+namespace Anubis
+{
+  namespace Physics
+  {
+    /***********************************************************************//**
+     * Stops fast spherical bodies of a RigidBodyWorld from passing through
+     * static boxes and meshes between two steps.
+     *
+     * Only the registered bodies that move further than a fraction of their
+     * radius in a step are swept, the others are left to the discrete
+     * contacts, so slow bodies cost one speed test per step. The sweeps use
+     * Narrowphase::sweep(). There are two modes:
+     *
+     * - TimeOfImpact: beginStep() records where the fast bodies start and
+     *   endStep(), after RigidBodyWorld::integratePositions(), moves every
+     *   body that hit the geometry back to the time of impact, slides it
+     *   along the surface for the rest of the step and removes the velocity
+     *   into the surface. It's exact but drops the time after the impact.
+     * - Speculative: beginStep() adds a contact with a negative depth, the
+     *   gap, where a fast body would first hit the geometry during the step,
+     *   and the ContactSolver stops the body from closing more than the
+     *   gap. It's cheaper and keeps the time of the step, but a body can
+     *   be stopped short of a surface it would have glanced off.
+     *
+     * Both run after RigidBodyWorld::integrateVelocities(), beginStep()
+     * before ContactSolver::solve(). Collisions between bodies are left to
+     * the discrete contacts.
+     **************************************************************************/
+    class ContinuousCollision final
+    {
+    public:
+      /*********************************************************************//**
+       * How the fast bodies are kept from passing through the geometry.
+       ************************************************************************/
+      enum class Mode
+      {
+        TimeOfImpact,
+        Speculative
+      };
+
+    private:
+      /*********************************************************************//**
+       * A registered body.
+       ************************************************************************/
+      struct Body
+      {
+        /** The ID of the body. */
+        RigidBodyWorld::BodyID fId;
+
+        /** The radius of the bounding sphere around the centre of mass. */
+        float fRadius;
+      };
+
+      /*********************************************************************//**
+       * A fast body of the current step.
+       ************************************************************************/
+      struct Sweep
+      {
+        /** The registered body. */
+        Body fBody;
+
+        /** The position at the start of the step. */
+        Math::Vector4f fStart;
+      };
+
+      /** The registered bodies. */
+      std::vector<Body> fBodies;
+
+      /** The fast bodies of the current step. */
+      std::vector<Sweep> fSweeps;
+
+      /** The static boxes. */
+      std::vector<BoundingBox> fBoxes;
+
+      /** The static meshes, owned by the caller. */
+      std::vector<const BoundingMesh *> fMeshes;
+
+      /** The mode. */
+      Mode fMode;
+
+      /** The fraction of it's radius a body must move in a step to be
+       * swept. */
+      float fSpeedFactor;
+
+      /** The coefficient of friction of the speculative contacts. */
+      float fFriction;
+
+      /*********************************************************************//**
+       * Find the first piece of static geometry a sphere touches.
+       *
+       * @param sphere  The sphere at the start of the motion.
+       * @param motion  The displacement of the sphere.
+       * @param toi     Returns the fraction of the motion at the impact.
+       * @param contact Returns the contact at the impact.
+       * @return        True if the sphere touches the geometry.
+       ************************************************************************/
+      bool sweep(const BoundingSphere & sphere, const Math::Vector4f & motion,
+                 float & toi, Contact & contact) const;
+
+    public:
+
+      /*********************************************************************//**
+       * Create the continuous collision.
+       *
+       * @param mode        The mode.
+       * @param speedFactor The fraction of it's radius a body must move in a
+       *                    step to be swept.
+       ************************************************************************/
+      ContinuousCollision(Mode mode = Mode::TimeOfImpact,
+                          float speedFactor = 0.5f);
+
+      /*********************************************************************//**
+       * Sweep a body when it moves fast.
+       *
+       * @param id      The ID of the body.
+       * @param radius  The radius of a sphere around the centre of mass that
+       *                bounds the body.
+       ************************************************************************/
+      void addBody(RigidBodyWorld::BodyID id, float radius);
+
+      /*********************************************************************//**
+       * Stop sweeping a body, e.g. before it's removed from the world.
+       *
+       * @param id  The ID of the body.
+       ************************************************************************/
+      void removeBody(RigidBodyWorld::BodyID id);
+
+      /*********************************************************************//**
+       * Add a static box, it's copied.
+       *
+       * @param box The box.
+       ************************************************************************/
+      void addStatic(const BoundingBox & box);
+
+      /*********************************************************************//**
+       * Add a static mesh, it must outlive the continuous collision.
+       *
+       * @param mesh  The mesh.
+       ************************************************************************/
+      void addStatic(const BoundingMesh & mesh);
+
+      /*********************************************************************//**
+       * Set the coefficient of friction of the speculative contacts.
+       *
+       * @param friction  The coefficient of friction.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE void setFriction(float friction)
+      {
+        fFriction = friction;
+      }
+
+      /*********************************************************************//**
+       * Find the fast bodies of the step. In the speculative mode, add their
+       * contacts to the constraints.
+       *
+       * @param world       The bodies, after the velocities are integrated.
+       * @param dt          The time step in seconds.
+       * @param constraints The constraints to add the speculative contacts
+       *                    to.
+       ************************************************************************/
+      void beginStep(const RigidBodyWorld & world, float dt,
+                     std::vector<ContactSolver::Constraint> & constraints);
+
+      /*********************************************************************//**
+       * In the time of impact mode, move the fast bodies that hit the
+       * geometry back to the impact.
+       *
+       * @param world The bodies, after the positions are integrated.
+       ************************************************************************/
+      void endStep(RigidBodyWorld & world);
+
+      /*********************************************************************//**
+       * Return the number of bodies swept by the current step.
+       *
+       * @return  The number of fast bodies.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t fastBodyCount() const
+      {
+        return fSweeps.size();
+      }
+    };
+  }
+}
+
+#endif /* ANUBIS_PHYSICS_CONTINUOUS_COLLISION_HPP */
@@ -0,0 +1,306 @@
+#ifndef ANUBIS_PHYSICS_INTEREST_MANAGER_HPP
+#define ANUBIS_PHYSICS_INTEREST_MANAGER_HPP
+
+#include "../Common/Misc.hpp"
+#include "../Math/Vector4f.hpp"
+#include "SpatialGrid.hpp"
+#include "TaskPool.hpp"
+
+namespace Anubis
+{
+  namespace Physics
+  {
+    /***********************************************************************//**
+     * Decides which entities every client of a server needs to know about, so
+     * that replication only sends each client the entities near it.
+     *
+     * The entities are kept in a SpatialGrid and every client has a position
+     * and a radius of interest. Every update() each client queries the grid
+     * and merges the result with it's current relevancy set, which is kept
+     * sorted by entity handle. The difference is reported as enter and leave
+     * events, thus a client only pays for the entities that changed. An
+     * entity only leaves once it's further than the radius plus a margin, so
+     * entities on the border of the area don't enter and leave every tick.
+     *
+     * The relevant entities are not all sent every tick. Each one accumulates
+     * a weight per tick of it's priority scaled by how close it is to the
+     * client, and it's due to be sent whenever the weight reaches one, thus
+     * near and important entities are sent every tick while distant ones
+     * are sent every few ticks, but at least every maxInterval ticks.
+     *
+     * The clients are independent, thus update() spreads them over a
+     * TaskPool. The events are always reported in client order, regardless
+     * of the number of threads.
+     **************************************************************************/
+    class InterestManager final
+    {
+    public:
+      /** The handle used to indicate the absence of a client or entity. */
+      static constexpr int32_t kNull = -1;
+
+      /*********************************************************************//**
+       * A change of a client's relevancy set.
+       ************************************************************************/
+      struct Event
+      {
+        /** The kinds of changes. */
+        enum class Types : uint8_t
+        {
+          /** The entity became relevant to the client. */
+          Enter,
+
+          /** The entity is no longer relevant to the client. */
+          Leave
+        };
+
+        /** The kind of change. */
+        Types fType;
+
+        /** The handle of the client. */
+        int32_t fClient;
+
+        /** The handle of the entity. */
+        int32_t fEntity;
+      };
+
+    private:
+      /*********************************************************************//**
+       * An entity in a client's relevancy set.
+       ************************************************************************/
+      struct Relevant
+      {
+        /** The handle of the entity. */
+        int32_t fEntity;
+
+        /** The generation of the entity's handle when it entered, used to
+         * detect a handle that was reused by another entity. */
+        uint32_t fGeneration;
+
+        /** The weight accumulated since the entity was last due. */
+        float fWeight;
+
+        /*******************************************************************//**
+         * Order entities by handle.
+         *
+         * @param rhs The entity to compare to.
+         * @return    True if this entity comes first.
+         **********************************************************************/
+        ANUBIS_FORCE_INLINE bool operator < (const Relevant & rhs) const
+        {
+          return fEntity < rhs.fEntity;
+        }
+      };
+
+      /*********************************************************************//**
+       * The state of a client.
+       ************************************************************************/
+      struct Client
+      {
+        /** The centre of the client's area of interest. */
+        Math::Vector4f fPosition;
+
+        /** The radius of the client's area of interest, or a negative value
+         * if the client record is free. */
+        float fRadius;
+
+        /** The relevant entities, sorted by handle. */
+        std::vector<Relevant> fRelevant;
+
+        /** The relevancy set being built by an update. */
+        std::vector<Relevant> fScratch;
+
+        /** The entities found by the grid query. */
+        std::vector<SpatialGrid::Neighbour> fFound;
+
+        /** The events of the last update. */
+        std::vector<Event> fEvents;
+
+        /** The entities due to be sent after the last update. */
+        std::vector<int32_t> fDue;
+      };
+
+      /** The grid of entities. */
+      SpatialGrid fGrid;
+
+      /** The priorities of the entities, indexed by handle. */
+      std::vector<float> fPriorities;
+
+      /** The generations of the entity handles, incremented when a handle is
+       * released. */
+      std::vector<uint32_t> fGenerations;
+
+      /** The clients, indexed by handle. */
+      std::vector<Client> fClients;
+
+      /** The handles of the free client records. */
+      std::vector<int32_t> fFreeClients;
+
+      /** The events of all the clients of the last update. */
+      std::vector<Event> fEvents;
+
+      /** The fraction of the radius an entity may move past before it
+       * leaves. */
+      float fLeaveMargin;
+
+      /** The smallest weight per tick, so that every relevant entity is
+       * sent at least every so many ticks. */
+      float fMinWeight;
+
+      /*********************************************************************//**
+       * Rebuild the relevancy set of a client and find it's due entities.
+       *
+       * @param handle  The handle of the client.
+       ************************************************************************/
+      void updateClient(int32_t handle);
+
+    public:
+      /*********************************************************************//**
+       * Create a manager without clients or entities.
+       *
+       * @param cellSize    The size of the grid's cells, about the most common
+       *                    radius of interest works best.
+       * @param leaveMargin The fraction of the radius an entity may move past
+       *                    before it leaves a client's set.
+       * @param maxInterval The largest number of ticks between two updates of
+       *                    a relevant entity.
+       ************************************************************************/
+      InterestManager(float cellSize, float leaveMargin = 0.1f,
+                      uint32_t maxInterval = 8);
+
+      /*********************************************************************//**
+       * Add an entity.
+       *
+       * @param position  The position of the entity.
+       * @param priority  The weight of the entity per tick at the client's
+       *                  position, 1 is sent every tick when close by.
+       * @return          The handle of the entity.
+       ************************************************************************/
+      int32_t addEntity(const Math::Vector4f & position, float priority = 1.0f);
+
+      /*********************************************************************//**
+       * Remove an entity. It leaves the clients on the next update.
+       *
+       * @param entity  The handle of the entity.
+       ************************************************************************/
+      void removeEntity(int32_t entity);
+
+      /*********************************************************************//**
+       * Update the position of an entity.
+       *
+       * @param entity    The handle of the entity.
+       * @param position  The new position.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE void moveEntity(int32_t entity,
+                                          const Math::Vector4f & position)
+      {
+        fGrid.move(entity, position);
+      }
+
+      /*********************************************************************//**
+       * Change the priority of an entity.
+       *
+       * @param entity    The handle of the entity.
+       * @param priority  The new priority.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE void setPriority(int32_t entity, float priority)
+      {
+        fPriorities[entity] = priority;
+      }
+
+      /*********************************************************************//**
+       * Add a client. It's relevancy set is filled by the next update.
+       *
+       * @param position  The centre of the area of interest.
+       * @param radius    The radius of the area of interest.
+       * @return          The handle of the client.
+       ************************************************************************/
+      int32_t addClient(const Math::Vector4f & position, float radius);
+
+      /*********************************************************************//**
+       * Remove a client, no leave events are reported for it.
+       *
+       * @param client  The handle of the client.
+       ************************************************************************/
+      void removeClient(int32_t client);
+
+      /*********************************************************************//**
+       * Move the area of interest of a client.
+       *
+       * @param client    The handle of the client.
+       * @param position  The new centre of the area of interest.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE void moveClient(int32_t client,
+                                          const Math::Vector4f & position)
+      {
+        fClients[client].fPosition = position;
+      }
+
+      /*********************************************************************//**
+       * Change the radius of interest of a client.
+       *
+       * @param client  The handle of the client.
+       * @param radius  The new radius.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE void setRadius(int32_t client, float radius)
+      {
+        fClients[client].fRadius = radius;
+      }
+
+      /*********************************************************************//**
+       * Update the relevancy sets of all the clients from the current
+       * positions, collect the enter and leave events and find the entities
+       * that are due to be sent this tick.
+       *
+       * @param pool  The worker pool to use, or nullptr to run serially.
+       ************************************************************************/
+      void update(TaskPool * pool = nullptr);
+
+      /*********************************************************************//**
+       * Return the events of the last update, grouped by client in handle
+       * order. The leave events of a client precede it's enter events.
+       *
+       * @return  The events.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE const std::vector<Event> & getEvents() const
+      {
+        return fEvents;
+      }
+
+      /*********************************************************************//**
+       * Return the entities that are due to be sent to a client after the
+       * last update, in handle order. Entities that just entered are always
+       * due.
+       *
+       * @param client  The handle of the client.
+       * @return        The handles of the due entities.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE const std::vector<int32_t> & getDue(
+        int32_t client) const
+      {
+        return fClients[client].fDue;
+      }
+
+      /*********************************************************************//**
+       * Return the number of entities relevant to a client.
+       *
+       * @param client  The handle of the client.
+       * @return        The size of the client's relevancy set.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t getRelevantCount(int32_t client) const
+      {
+        return fClients[client].fRelevant.size();
+      }
+
+      /*********************************************************************//**
+       * Check if an entity is in a client's relevancy set.
+       *
+       * @param client  The handle of the client.
+       * @param entity  The handle of the entity.
+       * @return        True if the entity is relevant to the client.
+       ************************************************************************/
+      bool isRelevant(int32_t client, int32_t entity) const;
+    };
+  }
+}
+
+#endif /* ANUBIS_PHYSICS_INTEREST_MANAGER_HPP */
@@ -0,0 +1,115 @@
+#ifndef ANUBIS_PHYSICS_ISLANDS_HPP
+#define ANUBIS_PHYSICS_ISLANDS_HPP
+
+#include "../Common/Misc.hpp"
+#include "ContactSolver.hpp"
+#include "RigidBodyWorld.hpp"
+
+namespace Anubis
+{
+  namespace Physics
+  {
+    /***********************************************************************//**
+     * Puts the bodies of a RigidBodyWorld to sleep once they come to rest.
+     * It runs at the end of a step, after RigidBodyWorld::integratePositions().
+     *
+     * The awake dynamic bodies are split into islands, the connected
+     * components of the contact graph, with union-find. Static and kinematic
+     * bodies do not join islands, since they do not carry impulses from one
+     * body to another. Every body has a timer of how long it's been below the
+     * velocity thresholds, and the timer of an island is the smallest timer
+     * of it's bodies and of the kinematic bodies that touch it. An island
+     * goes to sleep as a whole once it's timer reaches the time to sleep, so
+     * a body never sleeps while something it touches still moves.
+     *
+     * A sleeping island wakes as a whole, when one of it's bodies is touched
+     * by an awake body that moves (see ContactSolver) or when a force,
+     * impulse or new state is applied to one of it's bodies.
+     **************************************************************************/
+    class Islands final
+    {
+    private:
+      /** The union-find parent of every awake body, by dense index. */
+      std::vector<uint32_t> fParents;
+
+      /** The timer of every island, by the dense index of it's root. */
+      std::vector<float> fTimers;
+
+      /** The first body of every island in fMembers, by the dense index of
+       * it's root, followed by the number of bodies. */
+      std::vector<uint32_t> fStarts;
+
+      /** The IDs of the bodies grouped by island. */
+      std::vector<RigidBodyWorld::BodyID> fMembers;
+
+      /** The number of islands found by the last update. */
+      size_t fIslandCount;
+
+      /** The linear speed below which a body is at rest. */
+      float fLinearThreshold;
+
+      /** The angular speed below which a body is at rest. */
+      float fAngularThreshold;
+
+      /** How long an island must be at rest before it sleeps, in seconds. */
+      float fTimeToSleep;
+
+      /*********************************************************************//**
+       * Find the root of the island of a body, halving the paths on the way.
+       *
+       * @param body  The dense index of the body.
+       * @return      The dense index of the root.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE uint32_t find(uint32_t body)
+      {
+        while(fParents[body] != body)
+        {
+          fParents[body] = fParents[fParents[body]];
+          body = fParents[body];
+        }
+        return body;
+      }
+
+    public:
+
+      /*********************************************************************//**
+       * Create the islands.
+       *
+       * @param linearThreshold   The linear speed below which a body is at
+       *                          rest.
+       * @param angularThreshold  The angular speed below which a body is at
+       *                          rest.
+       * @param timeToSleep       How long an island must be at rest before
+       *                          it sleeps, in seconds.
+       ************************************************************************/
+      Islands(float linearThreshold = 0.05f, float angularThreshold = 0.05f,
+              float timeToSleep = 0.5f);
+
+      /*********************************************************************//**
+       * Update the sleep timers of the awake bodies, find their islands and
+       * put the islands that are at rest to sleep.
+       *
+       * @param world       The bodies.
+       * @param constraints The contacts of the step.
+       * @param count       The number of contacts.
+       * @param dt          The time step in seconds.
+       ************************************************************************/
+      void update(RigidBodyWorld & world,
+                  const ContactSolver::Constraint * constraints, size_t count,
+                  float dt);
+
+      /*********************************************************************//**
+       * Return the number of islands found by the last update, including the
+       * islands it put to sleep.
+       *
+       * @return  The number of islands.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t islandCount() const
+      {
+        return fIslandCount;
+      }
+    };
+  }
+}
+
+#endif /* ANUBIS_PHYSICS_ISLANDS_HPP */
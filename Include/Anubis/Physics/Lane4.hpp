@@ -0,0 +1,250 @@
+#ifndef ANUBIS_PHYSICS_LANE4_HPP
+#define ANUBIS_PHYSICS_LANE4_HPP
+
+#include "../Common/Misc.hpp"
+
+namespace Anubis
+{
+  namespace Physics
+  {
+    /***********************************************************************//**
+     * The same component of four bodies or constraints. It wraps an SSE
+     * register when SSE is available, so the structure of arrays kernels of
+     * the solver and the integrator are written once for both builds. The
+     * scalar operations match the SSE instructions bit for bit, including
+     * min() and max() on equal components of different signs, so both builds
+     * produce the same results.
+     **************************************************************************/
+    struct Lane4
+    {
+      #ifdef ANUBIS_HAS_SSE
+        /** The components. */
+        __m128 f;
+
+        static ANUBIS_FORCE_INLINE Lane4 load(const float * p)
+        {
+          return Lane4{_mm_loadu_ps(p)};
+        }
+
+        static ANUBIS_FORCE_INLINE Lane4 set(float v)
+        {
+          return Lane4{_mm_set1_ps(v)};
+        }
+
+        static ANUBIS_FORCE_INLINE Lane4 min(const Lane4 & a, const Lane4 & b)
+        {
+          return Lane4{_mm_min_ps(a.f, b.f)};
+        }
+
+        static ANUBIS_FORCE_INLINE Lane4 max(const Lane4 & a, const Lane4 & b)
+        {
+          return Lane4{_mm_max_ps(a.f, b.f)};
+        }
+
+        static ANUBIS_FORCE_INLINE Lane4 select(const Lane4 & mask,
+                                                const Lane4 & a,
+                                                const Lane4 & b)
+        {
+          __m128 m = _mm_cmpneq_ps(mask.f, _mm_setzero_ps());
+          return Lane4{_mm_or_ps(_mm_and_ps(m, a.f), _mm_andnot_ps(m, b.f))};
+        }
+
+        ANUBIS_FORCE_INLINE void store(float * p) const
+        {
+          _mm_storeu_ps(p, f);
+        }
+
+        ANUBIS_FORCE_INLINE Lane4 operator + (const Lane4 & rhs) const
+        {
+          return Lane4{_mm_add_ps(f, rhs.f)};
+        }
+
+        ANUBIS_FORCE_INLINE Lane4 operator - (const Lane4 & rhs) const
+        {
+          return Lane4{_mm_sub_ps(f, rhs.f)};
+        }
+
+        ANUBIS_FORCE_INLINE Lane4 operator - () const
+        {
+          return Lane4{_mm_sub_ps(_mm_setzero_ps(), f)};
+        }
+
+        ANUBIS_FORCE_INLINE Lane4 operator * (const Lane4 & rhs) const
+        {
+          return Lane4{_mm_mul_ps(f, rhs.f)};
+        }
+
+        ANUBIS_FORCE_INLINE Lane4 operator / (const Lane4 & rhs) const
+        {
+          return Lane4{_mm_div_ps(f, rhs.f)};
+        }
+
+        ANUBIS_FORCE_INLINE Lane4 sqrt() const
+        {
+          return Lane4{_mm_sqrt_ps(f)};
+        }
+      #else
+        /** The components. */
+        float f[4];
+
+        static ANUBIS_FORCE_INLINE Lane4 load(const float * p)
+        {
+          return Lane4{{p[0], p[1], p[2], p[3]}};
+        }
+
+        static ANUBIS_FORCE_INLINE Lane4 set(float v)
+        {
+          return Lane4{{v, v, v, v}};
+        }
+
+        static ANUBIS_FORCE_INLINE Lane4 min(const Lane4 & a, const Lane4 & b)
+        {
+          return Lane4{{a.f[0] < b.f[0] ? a.f[0] : b.f[0],
+                        a.f[1] < b.f[1] ? a.f[1] : b.f[1],
+                        a.f[2] < b.f[2] ? a.f[2] : b.f[2],
+                        a.f[3] < b.f[3] ? a.f[3] : b.f[3]}};
+        }
+
+        static ANUBIS_FORCE_INLINE Lane4 max(const Lane4 & a, const Lane4 & b)
+        {
+          return Lane4{{a.f[0] > b.f[0] ? a.f[0] : b.f[0],
+                        a.f[1] > b.f[1] ? a.f[1] : b.f[1],
+                        a.f[2] > b.f[2] ? a.f[2] : b.f[2],
+                        a.f[3] > b.f[3] ? a.f[3] : b.f[3]}};
+        }
+
+        static ANUBIS_FORCE_INLINE Lane4 select(const Lane4 & mask,
+                                                const Lane4 & a,
+                                                const Lane4 & b)
+        {
+          return Lane4{{mask.f[0] != 0.0f ? a.f[0] : b.f[0],
+                        mask.f[1] != 0.0f ? a.f[1] : b.f[1],
+                        mask.f[2] != 0.0f ? a.f[2] : b.f[2],
+                        mask.f[3] != 0.0f ? a.f[3] : b.f[3]}};
+        }
+
+        ANUBIS_FORCE_INLINE void store(float * p) const
+        {
+          memcpy(p, f, sizeof(f));
+        }
+
+        ANUBIS_FORCE_INLINE Lane4 operator + (const Lane4 & rhs) const
+        {
+          return Lane4{{f[0] + rhs.f[0], f[1] + rhs.f[1], f[2] + rhs.f[2],
+                        f[3] + rhs.f[3]}};
+        }
+
+        ANUBIS_FORCE_INLINE Lane4 operator - (const Lane4 & rhs) const
+        {
+          return Lane4{{f[0] - rhs.f[0], f[1] - rhs.f[1], f[2] - rhs.f[2],
+                        f[3] - rhs.f[3]}};
+        }
+
+        ANUBIS_FORCE_INLINE Lane4 operator - () const
+        {
+          return Lane4{{-f[0], -f[1], -f[2], -f[3]}};
+        }
+
+        ANUBIS_FORCE_INLINE Lane4 operator * (const Lane4 & rhs) const
+        {
+          return Lane4{{f[0] * rhs.f[0], f[1] * rhs.f[1], f[2] * rhs.f[2],
+                        f[3] * rhs.f[3]}};
+        }
+
+        ANUBIS_FORCE_INLINE Lane4 operator / (const Lane4 & rhs) const
+        {
+          return Lane4{{f[0] / rhs.f[0], f[1] / rhs.f[1], f[2] / rhs.f[2],
+                        f[3] / rhs.f[3]}};
+        }
+
+        ANUBIS_FORCE_INLINE Lane4 sqrt() const
+        {
+          return Lane4{{std::sqrt(f[0]), std::sqrt(f[1]), std::sqrt(f[2]),
+                        std::sqrt(f[3])}};
+        }
+      #endif /* ANUBIS_HAS_SSE */
+    };
+
+    /***********************************************************************//**
+     * A vector for each of four bodies or constraints.
+     **************************************************************************/
+    struct Vec3x4
+    {
+      /** The components. */
+      Lane4 x, y, z;
+
+      static ANUBIS_FORCE_INLINE Vec3x4 load(const float * x, const float * y,
+                                             const float * z)
+      {
+        return Vec3x4{Lane4::load(x), Lane4::load(y), Lane4::load(z)};
+      }
+
+      ANUBIS_FORCE_INLINE void store(float * px, float * py, float * pz) const
+      {
+        x.store(px);
+        y.store(py);
+        z.store(pz);
+      }
+
+      ANUBIS_FORCE_INLINE Vec3x4 operator + (const Vec3x4 & rhs) const
+      {
+        return Vec3x4{x + rhs.x, y + rhs.y, z + rhs.z};
+      }
+
+      ANUBIS_FORCE_INLINE Vec3x4 operator - (const Vec3x4 & rhs) const
+      {
+        return Vec3x4{x - rhs.x, y - rhs.y, z - rhs.z};
+      }
+
+      ANUBIS_FORCE_INLINE Vec3x4 operator * (const Lane4 & rhs) const
+      {
+        return Vec3x4{x * rhs, y * rhs, z * rhs};
+      }
+
+      /*********************************************************************//**
+       * Pick the lanes of a where the mask is not zero and of b elsewhere.
+       *
+       * @param mask  The mask.
+       * @param a     The vectors used where the mask is not zero.
+       * @param b     The vectors used where the mask is zero.
+       * @return      The selected vectors.
+       ************************************************************************/
+      static ANUBIS_FORCE_INLINE Vec3x4 select(const Lane4 & mask,
+                                               const Vec3x4 & a,
+                                               const Vec3x4 & b)
+      {
+        return Vec3x4{Lane4::select(mask, a.x, b.x),
+                      Lane4::select(mask, a.y, b.y),
+                      Lane4::select(mask, a.z, b.z)};
+      }
+
+      ANUBIS_FORCE_INLINE Lane4 dot(const Vec3x4 & rhs) const
+      {
+        return x * rhs.x + y * rhs.y + z * rhs.z;
+      }
+
+      ANUBIS_FORCE_INLINE Vec3x4 cross(const Vec3x4 & rhs) const
+      {
+        return Vec3x4{y * rhs.z - z * rhs.y, z * rhs.x - x * rhs.z,
+                      x * rhs.y - y * rhs.x};
+      }
+
+      /*********************************************************************//**
+       * Rotate the vectors by unit quaternions,
+       * v + 2w(q x v) + q x 2(q x v).
+       *
+       * @param q The vector parts of the quaternions.
+       * @param w The scalar parts of the quaternions.
+       * @return  The rotated vectors.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE Vec3x4 rotate(const Vec3x4 & q,
+                                        const Lane4 & w) const
+      {
+        Vec3x4 t = q.cross(*this) * Lane4::set(2.0f);
+        return *this + t * w + q.cross(t);
+      }
+    };
+  }
+}
+
+#endif /* ANUBIS_PHYSICS_LANE4_HPP */
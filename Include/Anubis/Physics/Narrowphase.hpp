@@ -0,0 +1,263 @@
+#ifndef ANUBIS_PHYSICS_NARROWPHASE_HPP
+#define ANUBIS_PHYSICS_NARROWPHASE_HPP
+
+#include "../Common/Misc.hpp"
+#include "BoundingBox.hpp"
+#include "BoundingMesh.hpp"
+#include "BoundingSphere.hpp"
+
+namespace Anubis
+{
+  namespace Physics
+  {
+    /***********************************************************************//**
+     * A contact between two bounding volumes A and B.
+     **************************************************************************/
+    struct Contact
+    {
+      /** The point of contact in world space. */
+      Math::Vector4f fPoint;
+
+      /** The unit length contact normal pointing from A towards B, moving B
+       * by fNormal * fDepth separates the volumes. */
+      Math::Vector4f fNormal;
+
+      /** The penetration depth along the normal. */
+      float fDepth;
+    };
+
+    /***********************************************************************//**
+     * The narrowphase collision tests for every pair of bounding volume types.
+     * The tests never allocate, the contacts are written to a buffer provided
+     * by the caller and the number of contacts written is returned. The pairs
+     * of primitives produce at most one contact, the mesh pairs produce one
+     * contact per overlapping triangle.
+     *
+     * BoundingBox is axis aligned, thus the box tests work on axis aligned
+     * boxes. The batch versions of the primitive pairs test the ith volume of
+     * A against the ith volume of B for arrays of volumes stored as structure
+     * of arrays, four pairs at a time when SSE is available.
+     *
+     * The sweep tests find the time of impact of a sphere moving along a
+     * straight line, so fast volumes cannot pass through thin ones between
+     * two steps. They are exact, the sphere and box sweep solves the
+     * piecewise quadratic distance between the box and the path of the
+     * centre, and the sphere and triangle sweep tests the face, the edges
+     * and the corners of every triangle in turn.
+     **************************************************************************/
+    class Narrowphase final
+    {
+    public:
+      /*********************************************************************//**
+       * A batch of axis aligned boxes stored as structure of arrays.
+       ************************************************************************/
+      struct BoxArrays
+      {
+        /** The minimum X coordinates of the boxes. */
+        const float * fMinX;
+
+        /** The minimum Y coordinates of the boxes. */
+        const float * fMinY;
+
+        /** The minimum Z coordinates of the boxes. */
+        const float * fMinZ;
+
+        /** The maximum X coordinates of the boxes. */
+        const float * fMaxX;
+
+        /** The maximum Y coordinates of the boxes. */
+        const float * fMaxY;
+
+        /** The maximum Z coordinates of the boxes. */
+        const float * fMaxZ;
+      };
+
+      /*********************************************************************//**
+       * A batch of spheres stored as structure of arrays.
+       ************************************************************************/
+      struct SphereArrays
+      {
+        /** The X coordinates of the centres. */
+        const float * fX;
+
+        /** The Y coordinates of the centres. */
+        const float * fY;
+
+        /** The Z coordinates of the centres. */
+        const float * fZ;
+
+        /** The radii of the spheres. */
+        const float * fRadius;
+      };
+
+      /*********************************************************************//**
+       * Test two boxes. The normal is the axis of least penetration.
+       *
+       * @param a       The first box.
+       * @param b       The second box.
+       * @param contact Returns the contact if the boxes overlap.
+       * @return        True if the boxes overlap, else false.
+       ************************************************************************/
+      static bool collide(const BoundingBox & a, const BoundingBox & b,
+                          Contact & contact);
+
+      /*********************************************************************//**
+       * Test a box and a sphere. If the centre of the sphere is inside the
+       * box, the normal points through the nearest face of the box.
+       *
+       * @param a       The box.
+       * @param b       The sphere.
+       * @param contact Returns the contact if the volumes overlap.
+       * @return        True if the volumes overlap, else false.
+       ************************************************************************/
+      static bool collide(const BoundingBox & a, const BoundingSphere & b,
+                          Contact & contact);
+
+      /*********************************************************************//**
+       * Test two spheres.
+       *
+       * @param a       The first sphere.
+       * @param b       The second sphere.
+       * @param contact Returns the contact if the spheres overlap.
+       * @return        True if the spheres overlap, else false.
+       ************************************************************************/
+      static bool collide(const BoundingSphere & a, const BoundingSphere & b,
+                          Contact & contact);
+
+      /*********************************************************************//**
+       * Test a box against the triangles of a mesh using the separating axis
+       * test, one contact is generated per overlapping triangle.
+       *
+       * @param a         The box.
+       * @param b         The mesh.
+       * @param contacts  The buffer the contacts are written to.
+       * @param capacity  The number of contacts the buffer can store.
+       * @return          The number of contacts written.
+       ************************************************************************/
+      static size_t collide(const BoundingBox & a, const BoundingMesh & b,
+                            Contact * contacts, size_t capacity);
+
+      /*********************************************************************//**
+       * Test a sphere against the triangles of a mesh, one contact is
+       * generated per overlapping triangle.
+       *
+       * @param a         The sphere.
+       * @param b         The mesh.
+       * @param contacts  The buffer the contacts are written to.
+       * @param capacity  The number of contacts the buffer can store.
+       * @return          The number of contacts written.
+       ************************************************************************/
+      static size_t collide(const BoundingSphere & a, const BoundingMesh & b,
+                            Contact * contacts, size_t capacity);
+
+      /*********************************************************************//**
+       * Test the triangles of two meshes against each other using the
+       * separating axis test, one contact is generated per overlapping pair
+       * of triangles. The contact point is the middle of the segment along
+       * which the triangles intersect.
+       *
+       * @param a         The first mesh.
+       * @param b         The second mesh.
+       * @param contacts  The buffer the contacts are written to.
+       * @param capacity  The number of contacts the buffer can store.
+       * @return          The number of contacts written.
+       ************************************************************************/
+      static size_t collide(const BoundingMesh & a, const BoundingMesh & b,
+                            Contact * contacts, size_t capacity);
+
+      /*********************************************************************//**
+       * Test two volumes of any type, dispatching on their type tags. If the
+       * pair is handled in the opposite order, the normals are flipped so that
+       * they always point from a to b.
+       *
+       * @param a         The first volume.
+       * @param b         The second volume.
+       * @param contacts  The buffer the contacts are written to.
+       * @param capacity  The number of contacts the buffer can store.
+       * @return          The number of contacts written.
+       ************************************************************************/
+      static size_t collide(const BoundingVolume & a, const BoundingVolume & b,
+                            Contact * contacts, size_t capacity);
+
+      /*********************************************************************//**
+       * Test count pairs of boxes, pair i is a[i] and b[i].
+       *
+       * @param a         The first boxes of the pairs.
+       * @param b         The second boxes of the pairs.
+       * @param count     The number of pairs.
+       * @param pairs     Returns the indexes of the overlapping pairs, must be
+       *                  able to store count entries.
+       * @param contacts  Returns the contacts of the overlapping pairs, must be
+       *                  able to store count entries.
+       * @return          The number of overlapping pairs.
+       ************************************************************************/
+      static size_t collide(const BoxArrays & a, const BoxArrays & b,
+                            size_t count, uint32_t * pairs,
+                            Contact * contacts);
+
+      /*********************************************************************//**
+       * Test count pairs of boxes and spheres, pair i is a[i] and b[i].
+       *
+       * @param a         The boxes of the pairs.
+       * @param b         The spheres of the pairs.
+       * @param count     The number of pairs.
+       * @param pairs     Returns the indexes of the overlapping pairs, must be
+       *                  able to store count entries.
+       * @param contacts  Returns the contacts of the overlapping pairs, must be
+       *                  able to store count entries.
+       * @return          The number of overlapping pairs.
+       ************************************************************************/
+      static size_t collide(const BoxArrays & a, const SphereArrays & b,
+                            size_t count, uint32_t * pairs,
+                            Contact * contacts);
+
+      /*********************************************************************//**
+       * Test count pairs of spheres, pair i is a[i] and b[i].
+       *
+       * @param a         The first spheres of the pairs.
+       * @param b         The second spheres of the pairs.
+       * @param count     The number of pairs.
+       * @param pairs     Returns the indexes of the overlapping pairs, must be
+       *                  able to store count entries.
+       * @param contacts  Returns the contacts of the overlapping pairs, must be
+       *                  able to store count entries.
+       * @return          The number of overlapping pairs.
+       ************************************************************************/
+      static size_t collide(const SphereArrays & a, const SphereArrays & b,
+                            size_t count, uint32_t * pairs,
+                            Contact * contacts);
+
+      /*********************************************************************//**
+       * Find when a moving sphere first touches a box.
+       *
+       * @param a       The sphere at the start of the motion.
+       * @param motion  The displacement of the sphere.
+       * @param b       The box.
+       * @param toi     Returns the fraction of the motion at which the
+       *                volumes first touch, 0 if they overlap at the start.
+       * @param contact Returns the contact at the time of impact, the normal
+       *                points from the sphere towards the box.
+       * @return        True if the volumes touch during the motion.
+       ************************************************************************/
+      static bool sweep(const BoundingSphere & a, const Math::Vector4f & motion,
+                        const BoundingBox & b, float & toi, Contact & contact);
+
+      /*********************************************************************//**
+       * Find when a moving sphere first touches the triangles of a mesh.
+       *
+       * @param a       The sphere at the start of the motion.
+       * @param motion  The displacement of the sphere.
+       * @param b       The mesh.
+       * @param toi     Returns the fraction of the motion at which the
+       *                volumes first touch, 0 if they overlap at the start.
+       * @param contact Returns the contact at the time of impact, the normal
+       *                points from the sphere towards the mesh.
+       * @return        True if the volumes touch during the motion.
+       ************************************************************************/
+      static bool sweep(const BoundingSphere & a, const Math::Vector4f & motion,
+                        const BoundingMesh & b, float & toi, Contact & contact);
+    };
+  }
+}
+
+#endif /* ANUBIS_PHYSICS_NARROWPHASE_HPP */
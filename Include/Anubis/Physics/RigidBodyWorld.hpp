@@ -0,0 +1,544 @@
+#ifndef ANUBIS_PHYSICS_RIGID_BODY_WORLD_HPP
+#define ANUBIS_PHYSICS_RIGID_BODY_WORLD_HPP
+
+#include "../Common/Misc.hpp"
+#include "../Math/Quaternion.hpp"
+#include "../Math/Vector4f.hpp"
+#include "Lane4.hpp"
+#include "TaskPool.hpp"
+
+namespace Anubis
+{
+  namespace Physics
+  {
+    /***********************************************************************//**
+     * The rigid bodies of a simulation. The state of the bodies is stored as
+     * structure of arrays, one array per component, and the integrator
+     * advances kLaneWidth bodies at a time with SSE. The arrays are padded to
+     * a multiple of kLaneWidth with inert bodies so that the integrator never
+     * needs a scalar tail loop.
+     *
+     * Bodies are referred to by stable IDs. Removing a body moves the last
+     * body into the gap so the arrays stay packed.
+     *
+     * Bodies can be put to sleep an island at a time, see Islands. The awake
+     * bodies are kept at the front of the arrays and the sleeping bodies
+     * after them, so the integrator only visits the lane groups of the awake
+     * bodies and callers that keep other structures in sync, such as the
+     * broadphase, can restrict their updates to the first awakeCount()
+     * bodies. Waking a body wakes the rest of it's island. Setting the state
+     * of a body or applying a force to it wakes it.
+     *
+     * The integrator is semi-implicit Euler: the velocities are updated from
+     * the forces first and the new velocities are used to update the
+     * positions and orientations. The inertia is stored as the inverse of
+     * the principal moments in body space, the gyroscopic term is ignored.
+     *
+     * The integrator only uses operations that are correctly rounded, thus
+     * the scalar and SSE builds produce the same state bit for bit, and so do
+     * different compilers when ANUBIS_DETERMINISTIC stops them from fusing
+     * operations. checksum() summarises the state to compare simulations.
+     **************************************************************************/
+    class RigidBodyWorld final
+    {
+    public:
+      /** The ID of a body in the world. */
+      typedef uint32_t BodyID;
+
+      /** The ID used to indicate the absence of a body. */
+      static constexpr BodyID kNullBody = 0xFFFFFFFF;
+
+      /** The number of bodies integrated together. */
+      static constexpr size_t kLaneWidth = 4;
+
+      /*********************************************************************//**
+       * The arrays that store the state of the bodies.
+       ************************************************************************/
+      enum class Fields
+      {
+        PositionX, PositionY, PositionZ,
+        OrientationX, OrientationY, OrientationZ, OrientationW,
+        LinearVelocityX, LinearVelocityY, LinearVelocityZ,
+        AngularVelocityX, AngularVelocityY, AngularVelocityZ,
+        ForceX, ForceY, ForceZ,
+        TorqueX, TorqueY, TorqueZ,
+        InverseMass,
+        InverseInertiaX, InverseInertiaY, InverseInertiaZ,
+        GravityScale,
+
+        /** How long the body has been almost at rest, in seconds. */
+        SleepTimer,
+
+        /** The number of arrays. */
+        Count
+      };
+
+      /*********************************************************************//**
+       * The description of a new body.
+       ************************************************************************/
+      struct BodyDesc
+      {
+        /** The position of the centre of mass. */
+        Math::Vector4f fPosition = Math::Vector4f(0.0f, 0.0f, 0.0f, 1.0f);
+
+        /** The unit orientation of the body. */
+        Math::Quaternion fOrientation = Math::Quaternion(0.0f, 0.0f, 0.0f,
+                                                         1.0f);
+
+        /** The linear velocity. */
+        Math::Vector4f fLinearVelocity;
+
+        /** The angular velocity in world space. */
+        Math::Vector4f fAngularVelocity;
+
+        /** The mass, 0 for static or kinematic bodies that are not affected
+         * by forces. */
+        float fMass = 1.0f;
+
+        /** The principal moments of inertia in body space, a moment of 0
+         * prevents rotation about that axis. */
+        Math::Vector4f fInertia = Math::Vector4f(1.0f, 1.0f, 1.0f, 0.0f);
+
+        /** The multiplier of the gravity applied to the body. */
+        float fGravityScale = 1.0f;
+      };
+
+    private:
+      /*********************************************************************//**
+       * Maps the stable IDs to the dense indexes of the arrays.
+       ************************************************************************/
+      struct Slots
+      {
+        /** The dense index of every ID, or the next free ID if the ID is on
+         * the free list. */
+        std::vector<uint32_t> fDense;
+
+        /** The ID of every dense index. */
+        std::vector<uint32_t> fSlots;
+
+        /** The head of the list of free IDs. */
+        uint32_t fFreeList = kNullBody;
+      };
+
+      /** The state arrays, indexed by Fields. */
+      std::vector<float> fFields[size_t(Fields::Count)];
+
+      /** The mapping of IDs to dense indexes. */
+      Slots fSlots;
+
+      /** The number of bodies, excluding the padding. */
+      size_t fCount;
+
+      /** The number of awake bodies, which come first in the arrays. */
+      size_t fAwakeCount;
+
+      /** The next body of the island of every sleeping ID, the islands are
+       * circular lists. */
+      std::vector<uint32_t> fIslandNext;
+
+      /** The acceleration due to gravity. */
+      Math::Vector4f fGravity;
+
+      /** The fraction of the linear velocity lost per second. */
+      float fLinearDamping;
+
+      /** The fraction of the angular velocity lost per second. */
+      float fAngularDamping;
+
+      /*********************************************************************//**
+       * Return a component of a body.
+       *
+       * @param field The component.
+       * @param dense The dense index of the body.
+       * @return      The reference to the component.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE float & at(Fields field, size_t dense)
+      {
+        return fFields[size_t(field)][dense];
+      }
+
+      /*********************************************************************//**
+       * Return a component of a body.
+       *
+       * @param field The component.
+       * @param dense The dense index of the body.
+       * @return      The component.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE float at(Fields field, size_t dense) const
+      {
+        return fFields[size_t(field)][dense];
+      }
+
+      /*********************************************************************//**
+       * Return three consecutive components of a body as a vector.
+       *
+       * @param first The X component.
+       * @param id    The ID of the body.
+       * @param w     The W component of the vector.
+       * @return      The vector.
+       ************************************************************************/
+      Math::Vector4f getVector(Fields first, BodyID id, float w) const;
+
+      /*********************************************************************//**
+       * Set three consecutive components of a body from a vector.
+       *
+       * @param first The X component.
+       * @param id    The ID of the body.
+       * @param value The vector.
+       ************************************************************************/
+      void setVector(Fields first, BodyID id, const Math::Vector4f & value);
+
+      /*********************************************************************//**
+       * Reset a dense index to an inert body that never moves.
+       *
+       * @param dense The dense index.
+       ************************************************************************/
+      void resetLane(size_t dense);
+
+      /*********************************************************************//**
+       * Swap two bodies in the arrays.
+       *
+       * @param a The dense index of the first body.
+       * @param b The dense index of the second body.
+       ************************************************************************/
+      void swapBodies(size_t a, size_t b);
+
+      /*********************************************************************//**
+       * Load three consecutive components of a lane group.
+       *
+       * @param first The X component.
+       * @param dense The dense index of the first body of the group.
+       * @return      The vectors of the group.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE Vec3x4 loadVector(Fields first, size_t dense) const
+      {
+        return Vec3x4::load(data(first) + dense,
+                            data(Fields(size_t(first) + 1)) + dense,
+                            data(Fields(size_t(first) + 2)) + dense);
+      }
+
+      /*********************************************************************//**
+       * Store three consecutive components of a lane group.
+       *
+       * @param first The X component.
+       * @param dense The dense index of the first body of the group.
+       * @param value The vectors of the group.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE void storeVector(Fields first, size_t dense,
+                                           const Vec3x4 & value)
+      {
+        value.store(data(first) + dense,
+                    data(Fields(size_t(first) + 1)) + dense,
+                    data(Fields(size_t(first) + 2)) + dense);
+      }
+
+      /*********************************************************************//**
+       * Update the velocities of a range of lane groups.
+       *
+       * @param begin The first lane group.
+       * @param end   The lane group after the last.
+       * @param dt    The time step in seconds.
+       ************************************************************************/
+      void integrateVelocityGroups(size_t begin, size_t end, float dt);
+
+      /*********************************************************************//**
+       * Update the positions and orientations of a range of lane groups.
+       *
+       * @param begin The first lane group.
+       * @param end   The lane group after the last.
+       * @param dt    The time step in seconds.
+       ************************************************************************/
+      void integratePositionGroups(size_t begin, size_t end, float dt);
+
+      /*********************************************************************//**
+       * Return which lanes of a lane group hold awake bodies.
+       *
+       * @param dense The dense index of the first body of the group.
+       * @return      1 for the awake lanes, 0 for the others.
+       ************************************************************************/
+      Lane4 awakeLanes(size_t dense) const;
+
+      /*********************************************************************//**
+       * Invoke kernel(begin, end) over the lane groups of the awake bodies,
+       * split between the threads of the pool if one is supplied.
+       *
+       * @param pool    The worker pool to use, or nullptr to run serially.
+       * @param kernel  The kernel.
+       ************************************************************************/
+      template <typename Kernel>
+      void forEachGroup(TaskPool * pool, Kernel && kernel);
+
+    public:
+
+      /*********************************************************************//**
+       * Create an empty world with standard gravity along -Y and no damping.
+       ************************************************************************/
+      RigidBodyWorld();
+
+      /*********************************************************************//**
+       * Reserve the storage for a number of bodies.
+       *
+       * @param count The number of bodies.
+       ************************************************************************/
+      void reserve(size_t count);
+
+      /*********************************************************************//**
+       * Remove all the bodies.
+       ************************************************************************/
+      void clear();
+
+      /*********************************************************************//**
+       * Add a body.
+       *
+       * @param desc  The description of the body.
+       * @return      The ID of the body.
+       ************************************************************************/
+      BodyID add(const BodyDesc & desc);
+
+      /*********************************************************************//**
+       * Remove a body, it's ID may be reused by later bodies.
+       *
+       * @param id  The ID of the body.
+       ************************************************************************/
+      void remove(BodyID id);
+
+      /*********************************************************************//**
+       * Return the number of bodies.
+       *
+       * @return  The number of bodies.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t size() const
+      {
+        return fCount;
+      }
+
+      /*********************************************************************//**
+       * Return the number of awake bodies, the dense indexes of the awake
+       * bodies are 0 to awakeCount() - 1.
+       *
+       * @return  The number of awake bodies.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t awakeCount() const
+      {
+        return fAwakeCount;
+      }
+
+      /*********************************************************************//**
+       * Return whether a body is awake.
+       *
+       * @param id  The ID of the body.
+       * @return    True if the body is awake.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE bool isAwake(BodyID id) const
+      {
+        return fSlots.fDense[id] < fAwakeCount;
+      }
+
+      /*********************************************************************//**
+       * Wake a body and the rest of it's island.
+       *
+       * @param id  The ID of the body.
+       ************************************************************************/
+      void wake(BodyID id);
+
+      /*********************************************************************//**
+       * Put an island of awake bodies to sleep. Their velocities and forces
+       * are cleared and they are not integrated until one of them is woken.
+       *
+       * @param bodies  The IDs of the bodies of the island.
+       * @param count   The number of bodies.
+       ************************************************************************/
+      void sleep(const BodyID * bodies, size_t count);
+
+      /*********************************************************************//**
+       * Return the dense index of a body, valid until the next removal or
+       * change of the awake bodies.
+       *
+       * @param id  The ID of the body.
+       * @return    The index of the body in the arrays.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t denseIndex(BodyID id) const
+      {
+        return fSlots.fDense[id];
+      }
+
+      /*********************************************************************//**
+       * Return the ID of the body at a dense index.
+       *
+       * @param dense The index of the body in the arrays.
+       * @return      The ID of the body.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE BodyID bodyAt(size_t dense) const
+      {
+        return fSlots.fSlots[dense];
+      }
+
+      /*********************************************************************//**
+       * Return one of the state arrays. The array has size() entries followed
+       * by the padding.
+       *
+       * @param field The array.
+       * @return      The array.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE float * data(Fields field)
+      {
+        return fFields[size_t(field)].data();
+      }
+
+      /*********************************************************************//**
+       * Return one of the state arrays. The array has size() entries followed
+       * by the padding.
+       *
+       * @param field The array.
+       * @return      The array.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE const float * data(Fields field) const
+      {
+        return fFields[size_t(field)].data();
+      }
+
+      /*********************************************************************//**
+       * Return the position of a body.
+       *
+       * @param id  The ID of the body.
+       * @return    The position of the centre of mass.
+       ************************************************************************/
+      Math::Vector4f position(BodyID id) const;
+
+      /*********************************************************************//**
+       * Return the orientation of a body.
+       *
+       * @param id  The ID of the body.
+       * @return    The unit orientation.
+       ************************************************************************/
+      Math::Quaternion orientation(BodyID id) const;
+
+      /*********************************************************************//**
+       * Return the linear velocity of a body.
+       *
+       * @param id  The ID of the body.
+       * @return    The linear velocity.
+       ************************************************************************/
+      Math::Vector4f linearVelocity(BodyID id) const;
+
+      /*********************************************************************//**
+       * Return the angular velocity of a body.
+       *
+       * @param id  The ID of the body.
+       * @return    The angular velocity in world space.
+       ************************************************************************/
+      Math::Vector4f angularVelocity(BodyID id) const;
+
+      /*********************************************************************//**
+       * Move a body.
+       *
+       * @param id        The ID of the body.
+       * @param position  The new position of the centre of mass.
+       ************************************************************************/
+      void setPosition(BodyID id, const Math::Vector4f & position);
+
+      /*********************************************************************//**
+       * Rotate a body.
+       *
+       * @param id          The ID of the body.
+       * @param orientation The new unit orientation.
+       ************************************************************************/
+      void setOrientation(BodyID id, const Math::Quaternion & orientation);
+
+      /*********************************************************************//**
+       * Set the linear velocity of a body.
+       *
+       * @param id        The ID of the body.
+       * @param velocity  The new linear velocity.
+       ************************************************************************/
+      void setLinearVelocity(BodyID id, const Math::Vector4f & velocity);
+
+      /*********************************************************************//**
+       * Set the angular velocity of a body.
+       *
+       * @param id        The ID of the body.
+       * @param velocity  The new angular velocity in world space.
+       ************************************************************************/
+      void setAngularVelocity(BodyID id, const Math::Vector4f & velocity);
+
+      /*********************************************************************//**
+       * Apply a force through the centre of mass of a body until the next
+       * step.
+       *
+       * @param id    The ID of the body.
+       * @param force The force in world space.
+       ************************************************************************/
+      void applyForce(BodyID id, const Math::Vector4f & force);
+
+      /*********************************************************************//**
+       * Apply a torque to a body until the next step.
+       *
+       * @param id      The ID of the body.
+       * @param torque  The torque in world space.
+       ************************************************************************/
+      void applyTorque(BodyID id, const Math::Vector4f & torque);
+
+      /*********************************************************************//**
+       * Calculate a 64 bit FNV-1a hash of the exact state of all the bodies
+       * in the order of the arrays, including their IDs. Two simulations
+       * that ran the same steps from the same state have the same checksum.
+       *
+       * @return  The checksum.
+       ************************************************************************/
+      uint64_t checksum() const;
+
+      /*********************************************************************//**
+       * Set the acceleration due to gravity.
+       *
+       * @param gravity The acceleration.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE void setGravity(const Math::Vector4f & gravity)
+      {
+        fGravity = gravity;
+      }
+
+      /*********************************************************************//**
+       * Set the fraction of the velocities lost per second.
+       *
+       * @param linear  The linear damping.
+       * @param angular The angular damping.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE void setDamping(float linear, float angular)
+      {
+        fLinearDamping = linear;
+        fAngularDamping = angular;
+      }
+
+      /*********************************************************************//**
+       * Update the velocities of the awake bodies from gravity and the applied
+       * forces and torques, then clear the forces and torques. This is the
+       * first half of a step, the constraints are solved before the second.
+       *
+       * @param dt    The time step in seconds.
+       * @param pool  The worker pool to use, or nullptr to run serially.
+       ************************************************************************/
+      void integrateVelocities(float dt, TaskPool * pool = nullptr);
+
+      /*********************************************************************//**
+       * Move the awake bodies with their velocities. This is the second half of
+       * a step.
+       *
+       * @param dt    The time step in seconds.
+       * @param pool  The worker pool to use, or nullptr to run serially.
+       ************************************************************************/
+      void integratePositions(float dt, TaskPool * pool = nullptr);
+
+      /*********************************************************************//**
+       * Advance the awake bodies by a time step without constraints, i.e.
+       * integrateVelocities() followed by integratePositions(). If a pool is
+       * supplied, the lane groups are split between it's threads.
+       *
+       * @param dt    The time step in seconds.
+       * @param pool  The worker pool to use, or nullptr to run serially.
+       ************************************************************************/
+      void integrate(float dt, TaskPool * pool = nullptr);
+    };
+  }
+}
+
+#endif /* ANUBIS_PHYSICS_RIGID_BODY_WORLD_HPP */
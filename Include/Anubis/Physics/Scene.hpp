@@ -2,9 +2,12 @@
 #define ANUBIS_PHYSICS_SCENE_HPP
 
 #include "../Common/Misc.hpp"
+#include "../Common/Pool.hpp"
 #include "../Common/UUID.hpp"
 #include "../Math/Matrix4f.hpp"
+#include "AABB.hpp"
 #include "BoundingVolume.hpp"
+#include "TaskPool.hpp"
  #include "../Common/SubObj.hpp"
 
 namespace Anubis
@@ -14,9 +17,15 @@ namespace Anubis
     /***********************************************************************//**
      * The scene graph that describes the environment. Note that the scene is
      * not directly renderable.
+     *
+     * The nodes of the scene are allocated from a per scene pool and the
+     * children of a node are stored as an intrusive linked list, thus once the
+     * pool has grown to the peak node count (or reserve() was called) the
+     * insert, remove and sync operations do not allocate any memory.
      **************************************************************************/
     class Scene
     {
+    protected:
       /*********************************************************************//**
        * A node in the scene's tree structure.
        ************************************************************************/
@@ -26,8 +35,24 @@ namespace Anubis
          * this is the root node of the tree. */
         Node * fParent;
 
-        /** The list of children of this node. */
-        std::vector<std::unique_ptr<Node>> fChildren;
+        /** The first child of this node. */
+        Node * fFirstChild;
+
+        /** The last child of this node, used to append children in O(1). */
+        Node * fLastChild;
+
+        /** The next child of this node's parent. */
+        Node * fNextSibling;
+
+        /** The previous child of this node's parent. */
+        Node * fPrevSibling;
+
+        /** The number of children of this node. */
+        size_t fChildCount;
+
+        /** The UUID of the subobject, cached to avoid dereferencing the data
+         * pointer during lookups. */
+        Common::UUID fID;
 
         /** The subobject contained in this node. */
         std::shared_ptr<Common::SubObj> fData;
@@ -38,47 +63,20 @@ namespace Anubis
         /** The transform of this node relative to the world. */
         Math::Matrix4f fWorldTransform;
 
+        /** The bounds of the node's contents relative to the node. */
+        AABB fBounds;
+
         /*******************************************************************//**
          * Create a node with with no children and the specified parent.
-         * @param parent
+         *
+         * @param parent  The parent of the node.
+         * @param data    The subobject contained in the node.
          **********************************************************************/
         ANUBIS_FORCE_INLINE Node(Node * parent = nullptr,
-                                 std::shared_ptr<Common::SubObj> subObj = nullptr) :
-          fParent(parent) {}
-
-        ANUBIS_FORCE_INLINE Node(Node * parent = nullptr) :
-          fParent(parent) {}
-
-//        /*******************************************************************//**
-//         * Create a scene node with the. Note that the node will not take
-//         * ownership of the parent pointer, but will for all the child pointers.
-//         * This prevent's cycling references but is still safe to use since the
-//         * ownership of the parent node is controlled by the parent's parent.
-//         * Thus unless there is a bug in the tree code, all operations are safe.
-//         *
-//         * @param parent    The parent node of this node.
-//         * @param children  The child nodes of this node. Note that the vector
-//         *                  of children that is passed in will no longer be
-//         *                  valid after this function has been executed.
-//         **********************************************************************/
-//        ANUBIS_FORCE_INLINE Node(Node * parent,
-//          std::vector<std::unique_ptr<Node>> & children) :
-//              fParent(parent)
-//        {
-//          /* Reserve space for all the children. */
-//          fChildren.reserve(children.size());
-
-//          /* Iterate through all the children and move the ownership to this
-//           * node. */
-//          for(size_t i = 0; i < children.size(); i++)
-//          {
-//            fChildren.push_back(std::move(children[i]));
-//          }
-
-//          /* Clear the orignal vector since none of the pointers in it will be
-//           * valid anymore. */
-//          children.clear();
-//        }
+                                 std::shared_ptr<Common::SubObj> data = nullptr)
+          : fParent(parent), fFirstChild(nullptr), fLastChild(nullptr),
+            fNextSibling(nullptr), fPrevSibling(nullptr), fChildCount(0),
+            fID(data ? data->getID() : Common::kNullUUID), fData(data) {}
 
         /*******************************************************************//**
          * Empty virtual destructor to ensure that any subclass' destrutor will
@@ -97,13 +95,65 @@ namespace Anubis
           return fParent == nullptr;
         }
 
-        ANUBIS_FORCE_INLINE void addChild(std::unique_ptr<Node> & child)
+        /*******************************************************************//**
+         * Append a child to the end of this node's children.
+         *
+         * @param child The child to append. It must not be linked to another
+         *              parent.
+         **********************************************************************/
+        ANUBIS_FORCE_INLINE void addChild(Node * child)
         {
           /* Set the parent of the child. */
           child->fParent = this;
+          child->fNextSibling = nullptr;
+          child->fPrevSibling = fLastChild;
+
+          /* Link the child to the end of the list. */
+          if(fLastChild)
+          {
+            fLastChild->fNextSibling = child;
+          }
+          else
+          {
+            fFirstChild = child;
+          }
+
+          fLastChild = child;
+          ++fChildCount;
+        }
 
-          /* Add the child to this node's children. */
-          fChildren.push_back(std::move(child));
+        /*******************************************************************//**
+         * Unlink a child from this node's children. The child's own children
+         * are not affected.
+         *
+         * @param child The child to unlink.
+         **********************************************************************/
+        ANUBIS_FORCE_INLINE void removeChild(Node * child)
+        {
+          /* Unlink the child from its siblings. */
+          if(child->fPrevSibling)
+          {
+            child->fPrevSibling->fNextSibling = child->fNextSibling;
+          }
+          else
+          {
+            fFirstChild = child->fNextSibling;
+          }
+
+          if(child->fNextSibling)
+          {
+            child->fNextSibling->fPrevSibling = child->fPrevSibling;
+          }
+          else
+          {
+            fLastChild = child->fPrevSibling;
+          }
+
+          /* Clear the child's links. */
+          child->fParent = nullptr;
+          child->fNextSibling = nullptr;
+          child->fPrevSibling = nullptr;
+          --fChildCount;
         }
 
         /*******************************************************************//**
@@ -114,7 +164,7 @@ namespace Anubis
          **********************************************************************/
         ANUBIS_FORCE_INLINE bool isLeaf() const
         {
-          return fChildren.size() == 0;
+          return fFirstChild == nullptr;
         }
 
         /*******************************************************************//**
@@ -129,7 +179,7 @@ namespace Anubis
         }
       };
 
-
+    private:
       /*********************************************************************//**
        * In order to optimise tree syncrhonisation, instead of rebuilding the
        * tree each frame, a list of changes are tracked and a sync action
@@ -165,6 +215,77 @@ namespace Anubis
        * performed. */
       std::vector<ChangeRecord> fChangeHistory;
 
+      /** The pool that all the nodes of this scene are allocated from. */
+      Common::Pool<Node> fNodePool;
+
+      /** An open addressing (linear probing) hash table of all the nodes with
+       * data, keyed on the node's UUID. Empty slots are nullptr. The size is
+       * always a power of two. */
+      std::vector<Node*> fIndex;
+
+      /** The number of nodes stored in the index. */
+      size_t fIndexCount;
+
+      /** The roots of the independent subtrees that the transform update is
+       * split into. Kept as a member so the memory is reused every update. */
+      std::vector<Node*> fTransformRoots;
+
+      /** Scratch memory used while splitting the tree into subtrees. */
+      std::vector<Node*> fTransformScratch;
+
+      /** The snapshots read and write the nodes directly. */
+      friend class SceneSnapshot;
+
+      /** Delete the copy constructor. */
+      Scene(const Scene &) = delete;
+
+      /** Delete the assignment operator. */
+      Scene & operator = (const Scene &) = delete;
+
+      /*********************************************************************//**
+       * Resize the index to hold at least count nodes at a load factor of no
+       * more than 50% and reinsert all the nodes in the tree.
+       *
+       * @param count The number of nodes the index must be able to hold.
+       ************************************************************************/
+      void resizeIndex(size_t count);
+
+      /*********************************************************************//**
+       * Clear the index and insert every node of the tree into it.
+       ************************************************************************/
+      void rebuildIndex();
+
+      /*********************************************************************//**
+       * Add the node to the index. Nodes without data are not indexed.
+       *
+       * @param node  The node to add to the index.
+       ************************************************************************/
+      void indexNode(Node * node);
+
+      /*********************************************************************//**
+       * Remove the node from the index. Nothing is done if the node is not
+       * indexed.
+       *
+       * @param node  The node to remove from the index.
+       ************************************************************************/
+      void unindexNode(Node * node);
+
+      /*********************************************************************//**
+       * Destroy the node and all its descendants and return them to the pool.
+       * The node must allready be unlinked from it's parent.
+       *
+       * @param node  The root of the subtree to destroy.
+       ************************************************************************/
+      void destroySubtree(Node * node);
+
+      /*********************************************************************//**
+       * Calculate the world transform of the node from it's parent's world
+       * transform and then do the same for all of it's descendants.
+       *
+       * @param node  The root of the subtree to update.
+       ************************************************************************/
+      static void updateSubtreeTransforms(Node * node);
+
     protected:
 
       /** Indicate if a change histry should be kept. Without it, changes
@@ -172,14 +293,12 @@ namespace Anubis
       bool fTrackChanges;
 
       /** The root node of the tree. */
-      std::unique_ptr<Node> fRootNode;
-
-
-      size_t getNodeCount() const { return 0; }
-
+      Node * fRootNode;
 
       /*********************************************************************//**
        * Sync the child nodes of the srcParent node to the dstParent node.
+       * Existing nodes in the destination are reused and only the difference
+       * in node count is created or destroyed.
        *
        * @param srcParent The node where the children will be synced / mirrored
        *                  from.
@@ -188,11 +307,73 @@ namespace Anubis
        ***********************************************************************/
       void syncChildren(const Node * srcParent, Node *dstParent);
 
-
-      Node * find(const Common::UUID & uuid);
+      /*********************************************************************//**
+       * Find the node with the specified UUID.
+       *
+       * @param uuid  The UUID of the node's data.
+       * @return      The node or nullptr if it was not found.
+       ************************************************************************/
+      Node * find(const Common::UUID & uuid) const;
 
     public:
 
+      /** The minimum number of nodes in the scene before the transform update
+       * is split over multiple threads. Smaller scenes are faster to update
+       * serially than to synchronise the workers. */
+      static const size_t kMinParallelTransformNodes = 4096;
+
+      /** The number of subtrees per thread that the transform update aims
+       * for, so that uneven subtrees can be balanced between threads. */
+      static const size_t kTransformSubtreesPerThread = 8;
+
+      /*********************************************************************//**
+       * Create an empty scene.
+       *
+       * @param trackChanges  Indicate if a history of changes must be kept.
+       ************************************************************************/
+      Scene(bool trackChanges = false);
+
+      /*********************************************************************//**
+       * Destroy all the nodes in the scene.
+       ************************************************************************/
+      virtual ~Scene();
+
+      /*********************************************************************//**
+       * Return the number of nodes in the scene.
+       *
+       * @return  The number of nodes in the scene.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t getNodeCount() const
+      {
+        return fNodePool.size();
+      }
+
+      /*********************************************************************//**
+       * Pre-allocate the memory for nodeCount nodes so that no memory is
+       * allocated by insert(), remove() or sync() until the scene grows past
+       * that size.
+       *
+       * @param nodeCount The number of nodes to reserve memory for.
+       ************************************************************************/
+      void reserve(size_t nodeCount);
+
+      /*********************************************************************//**
+       * Remove all the nodes from the scene. The memory of the nodes is kept
+       * for reuse and is returned to the pool in a single operation.
+       ************************************************************************/
+      void clear();
+
+      /*********************************************************************//**
+       * Check if the scene contains a node with the specified UUID.
+       *
+       * @param nodeID  The UUID of the node.
+       * @return        True if the node exist, else false.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE bool contains(const Common::UUID & nodeID) const
+      {
+        return find(nodeID) != nullptr;
+      }
+
       /*********************************************************************//**
        * Change to contents of this scene to reflect the contents of the
        * supplied scene.
@@ -223,6 +404,58 @@ namespace Anubis
        ************************************************************************/
       bool remove(const Common::UUID & nodeID);
 
+      /*********************************************************************//**
+       * Set the transform of the node relative to it's parent. The world
+       * transforms are only recalculated by updateTransforms().
+       *
+       * @param nodeID    The ID of the node.
+       * @param transform The new transform relative to the parent.
+       * @return          True if the node was found, else false.
+       ************************************************************************/
+      bool setTransform(const Common::UUID & nodeID,
+                        const Math::Matrix4f & transform);
+
+      /*********************************************************************//**
+       * Retrieve the world transform of the node that was calculated by the
+       * last updateTransforms().
+       *
+       * @param nodeID    The ID of the node.
+       * @param transform Used to return the world transform.
+       * @return          True if the node was found, else false.
+       ************************************************************************/
+      bool getWorldTransform(const Common::UUID & nodeID,
+                             Math::Matrix4f & transform) const;
+
+      /*********************************************************************//**
+       * Set the bounds of the node's contents relative to the node.
+       *
+       * @param nodeID  The ID of the node.
+       * @param bounds  The new bounds.
+       * @return        True if the node was found, else false.
+       ************************************************************************/
+      bool setBounds(const Common::UUID & nodeID, const AABB & bounds);
+
+      /*********************************************************************//**
+       * Retrieve the bounds of the node's contents relative to the node.
+       *
+       * @param nodeID  The ID of the node.
+       * @param bounds  Used to return the bounds.
+       * @return        True if the node was found, else false.
+       ************************************************************************/
+      bool getBounds(const Common::UUID & nodeID, AABB & bounds) const;
+
+      /*********************************************************************//**
+       * Recalculate the world transform of every node in the scene. If a task
+       * pool is supplied and the scene has at least kMinParallelTransformNodes
+       * nodes, the tree is split into independent subtrees which are updated
+       * concurrently. Since every world transform only depends on the node's
+       * ancestors, the result is identical to the serial update regardless of
+       * the number of threads.
+       *
+       * @param pool  The worker pool to use, or nullptr to update serially.
+       ************************************************************************/
+      void updateTransforms(TaskPool * pool = nullptr);
+
     };
   }
 }
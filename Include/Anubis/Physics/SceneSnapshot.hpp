@@ -0,0 +1,283 @@
+#ifndef ANUBIS_PHYSICS_SCENE_SNAPSHOT_HPP
+#define ANUBIS_PHYSICS_SCENE_SNAPSHOT_HPP
+
+#include "../Common/Misc.hpp"
+#include "../Common/SubObj.hpp"
+#include "../Common/UUID.hpp"
+#include "../Math/Matrix4f.hpp"
+#include "AABB.hpp"
+#include "Scene.hpp"
+
+namespace Anubis
+{
+  namespace Physics
+  {
+    /***********************************************************************//**
+     * A read only, versioned binary image of a Scene, used to load levels
+     * without rebuilding them node by node.
+     *
+     * The nodes are stored in pre-order as a set of flat arrays: the node and
+     * component UUIDs, the index of every node's parent, the local and world
+     * transforms and the bounds. Every array starts on a kSectionAlignment
+     * boundary and uses the in memory layout of it's type, thus a snapshot
+     * file is memory mapped and read in place without any deserialisation.
+     * Since a parent always precedes it's children, load() rebuilds a Scene
+     * in a single pass with one allocation for the pool, one for the index
+     * and one for all the node data.
+     *
+     * Snapshots are written in the host's byte order and are rejected by a
+     * host with a diffirent byte order or by a version they don't match.
+     **************************************************************************/
+    class SceneSnapshot final
+    {
+    public:
+      /** The version of the format written by this build. */
+      static const uint32_t kVersion = 1;
+
+      /** The parent index of the root node. */
+      static constexpr const uint32_t kNoParent = 0xFFFFFFFF;
+
+      /** The alignment of every array in the snapshot. */
+      static const size_t kSectionAlignment = 64;
+
+      /** Creates the data of a node from it's UUID and component UUID. */
+      typedef std::function<std::shared_ptr<Common::SubObj>(
+        const Common::UUID & id, const Common::UUID & compID)> DataFactory;
+
+    private:
+      /*********************************************************************//**
+       * The header at the start of a snapshot. The sections are given as
+       * offsets from the start of the snapshot.
+       ************************************************************************/
+      struct Header
+      {
+        /** The magic number that identifies a snapshot. */
+        uint32_t fMagic;
+
+        /** The version of the format. */
+        uint32_t fVersion;
+
+        /** A known value used to detect a diffirent byte order. */
+        uint32_t fByteOrder;
+
+        /** The number of nodes. */
+        uint32_t fNodeCount;
+
+        /** The total size of the snapshot in bytes. */
+        uint64_t fSize;
+
+        /** The offset of the local transforms. */
+        uint64_t fTransforms;
+
+        /** The offset of the world transforms. */
+        uint64_t fWorldTransforms;
+
+        /** The offset of the bounds. */
+        uint64_t fBounds;
+
+        /** The offset of the node UUIDs. */
+        uint64_t fIDs;
+
+        /** The offset of the component UUIDs. */
+        uint64_t fCompIDs;
+
+        /** The offset of the parent indices. */
+        uint64_t fParents;
+      };
+
+      /** The start of the snapshot. */
+      const uint8_t * fData;
+
+      /** The size of the snapshot in bytes. */
+      size_t fSize;
+
+      /** True if the snapshot is a memory mapped file that must be unmapped,
+       * otherwise the memory belongs to the caller or to fBuffer. */
+      bool fMapped;
+
+      /** The copy of a file that could not be mapped. */
+      std::vector<Math::Matrix4f> fBuffer;
+
+      /** The number of nodes. */
+      uint32_t fNodeCount;
+
+      /** The local transforms of the nodes. */
+      const Math::Matrix4f * fTransforms;
+
+      /** The world transforms of the nodes. */
+      const Math::Matrix4f * fWorldTransforms;
+
+      /** The bounds of the nodes. */
+      const AABB * fBounds;
+
+      /** The octets of the node UUIDs. */
+      const uint8_t * fIDs;
+
+      /** The octets of the component UUIDs. */
+      const uint8_t * fCompIDs;
+
+      /** The parent indices of the nodes. */
+      const uint32_t * fParents;
+
+      /** Delete the copy constructor. */
+      SceneSnapshot(const SceneSnapshot &) = delete;
+
+      /** Delete the assignment operator. */
+      SceneSnapshot & operator = (const SceneSnapshot &) = delete;
+
+      /*********************************************************************//**
+       * Check the header and the hierarchy of the snapshot at fData and set up
+       * the sections.
+       *
+       * @return  True if the snapshot is valid, else false.
+       ************************************************************************/
+      bool validate();
+
+    public:
+      /*********************************************************************//**
+       * Create an empty snapshot.
+       ************************************************************************/
+      SceneSnapshot();
+
+      /*********************************************************************//**
+       * Release the snapshot.
+       ************************************************************************/
+      ~SceneSnapshot();
+
+      /*********************************************************************//**
+       * Write a snapshot of the scene to a buffer.
+       *
+       * @param scene   The scene.
+       * @param buffer  Returns the snapshot.
+       ************************************************************************/
+      static void write(const Scene & scene, std::vector<uint8_t> & buffer);
+
+      /*********************************************************************//**
+       * Write a snapshot of the scene to a file.
+       *
+       * @param scene The scene.
+       * @param path  The path of the file.
+       * @return      True if the file was written, else false.
+       ************************************************************************/
+      static bool write(const Scene & scene, const std::string & path);
+
+      /*********************************************************************//**
+       * Map a snapshot file into memory. Any previous snapshot is closed. On
+       * platforms without memory mapping the file is read into memory.
+       *
+       * @param path  The path of the file.
+       * @return      True if the file is a valid snapshot, else false.
+       ************************************************************************/
+      bool open(const std::string & path);
+
+      /*********************************************************************//**
+       * Use a snapshot that is allready in memory, i.e. a buffer filled by
+       * write(). The memory is not copied, thus it must be aligned to
+       * ANUBIS_SIMD_MEM_ALIGNMENT and must outlive the snapshot.
+       *
+       * @param data  The start of the snapshot.
+       * @param size  The size of the snapshot in bytes.
+       * @return      True if the memory holds a valid snapshot, else false.
+       ************************************************************************/
+      bool open(const void * data, size_t size);
+
+      /*********************************************************************//**
+       * Release the snapshot.
+       ************************************************************************/
+      void close();
+
+      /*********************************************************************//**
+       * Replace the contents of the scene with the snapshot. The world
+       * transforms are restored as they were written, thus no
+       * updateTransforms() is required. Nodes with a null UUID get no data.
+       *
+       * @param scene   The scene to load into.
+       * @param factory Creates the data of every node, or nullptr to create
+       *                plain sub objects, which are then allocated as a
+       *                single block.
+       * @return        True if the snapshot is open, else false.
+       ************************************************************************/
+      bool load(Scene & scene, const DataFactory & factory = nullptr) const;
+
+      /*********************************************************************//**
+       * Return the number of nodes in the snapshot, 0 if it's not open.
+       *
+       * @return  The number of nodes.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE uint32_t getNodeCount() const
+      {
+        return fNodeCount;
+      }
+
+      /*********************************************************************//**
+       * Return the UUID of a node.
+       *
+       * @param node  The index of the node in pre-order.
+       * @return      The UUID of the node's data.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE Common::UUID id(uint32_t node) const
+      {
+        return Common::UUID(fIDs + size_t(node) * Common::UUID::kOctetCount);
+      }
+
+      /*********************************************************************//**
+       * Return the UUID of the component that a node's data belongs too.
+       *
+       * @param node  The index of the node in pre-order.
+       * @return      The component UUID of the node's data.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE Common::UUID compID(uint32_t node) const
+      {
+        return Common::UUID(fCompIDs +
+                            size_t(node) * Common::UUID::kOctetCount);
+      }
+
+      /*********************************************************************//**
+       * Return the index of a node's parent.
+       *
+       * @param node  The index of the node in pre-order.
+       * @return      The index of the parent, or kNoParent for the root.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE uint32_t parent(uint32_t node) const
+      {
+        return fParents[node];
+      }
+
+      /*********************************************************************//**
+       * Return the transform of a node relative to it's parent.
+       *
+       * @param node  The index of the node in pre-order.
+       * @return      The local transform.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE const Math::Matrix4f & transform(uint32_t node) const
+      {
+        return fTransforms[node];
+      }
+
+      /*********************************************************************//**
+       * Return the transform of a node relative to the world.
+       *
+       * @param node  The index of the node in pre-order.
+       * @return      The world transform.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE const Math::Matrix4f & worldTransform(
+        uint32_t node) const
+      {
+        return fWorldTransforms[node];
+      }
+
+      /*********************************************************************//**
+       * Return the bounds of a node's contents relative to the node.
+       *
+       * @param node  The index of the node in pre-order.
+       * @return      The bounds.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE const AABB & bounds(uint32_t node) const
+      {
+        return fBounds[node];
+      }
+    };
+  }
+}
+
+#endif /* ANUBIS_PHYSICS_SCENE_SNAPSHOT_HPP */
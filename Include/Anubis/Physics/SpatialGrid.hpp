@@ -0,0 +1,487 @@
+#ifndef ANUBIS_PHYSICS_SPATIAL_GRID_HPP
+#define ANUBIS_PHYSICS_SPATIAL_GRID_HPP
+
+#include "../Common/Misc.hpp"
+#include "../Math/Vector4f.hpp"
+#include "TaskPool.hpp"
+
+namespace Anubis
+{
+  namespace Physics
+  {
+    /***********************************************************************//**
+     * A uniform grid of cubic cells used to answer neighbour queries, i.e.
+     * "all the units within r of p" and "the k closest units to p", for point
+     * entities. Only the cells that contain (or contained) entities exist,
+     * they are found through a hash table keyed on the integer cell
+     * coordinates, thus the world does not need to be bounded. Cells that
+     * became empty are kept so that entities crossing back and forth don't
+     * reallocate them, compact() frees them, i.e. after the units spread over
+     * a large part of the map.
+     *
+     * Every cell stores it's entities in a contiguous array of positions so
+     * that a query streams through memory. An entity that moves within it's
+     * cell is updated in place and an entity that changes cells is swapped
+     * out of the old cell's array and appended to the new one, thus every
+     * update is O(1).
+     *
+     * Queries do not modify the grid, thus any number of them can run
+     * concurrently as long as the grid is not updated at the same time. The
+     * batched queries use this to spread the queries over a TaskPool.
+     *
+     * For best results, make the cell size about the same as the most common
+     * query radius.
+     **************************************************************************/
+    class SpatialGrid final
+    {
+    public:
+      /** The index used to indicate the absence of an entity. */
+      static constexpr int32_t kNullEntity = -1;
+
+      /*********************************************************************//**
+       * An entity found by a query.
+       ************************************************************************/
+      struct Neighbour
+      {
+        /** The handle of the entity. */
+        int32_t fEntity;
+
+        /** The squared distance from the query position to the entity. */
+        float fDistanceSq;
+
+        /*******************************************************************//**
+         * Order neighbours from the closest to the furthest, ties are broken
+         * by the handle so that the order is deterministic.
+         *
+         * @param rhs The neighbour to compare to.
+         * @return    True if this neighbour comes first.
+         **********************************************************************/
+        ANUBIS_FORCE_INLINE bool operator < (const Neighbour & rhs) const
+        {
+          return fDistanceSq < rhs.fDistanceSq ||
+            (fDistanceSq == rhs.fDistanceSq && fEntity < rhs.fEntity);
+        }
+      };
+
+    private:
+      /*********************************************************************//**
+       * An entity stored in a cell.
+       ************************************************************************/
+      struct Entry
+      {
+        /** The position of the entity. */
+        float fX, fY, fZ;
+
+        /** The handle of the entity. */
+        int32_t fEntity;
+      };
+
+      /*********************************************************************//**
+       * A cell of the grid.
+       ************************************************************************/
+      struct Cell
+      {
+        /** The integer coordinates of the cell. */
+        int32_t fX, fY, fZ;
+
+        /** The entities in the cell. */
+        std::vector<Entry> fEntries;
+      };
+
+      /*********************************************************************//**
+       * The record of an entity, indexed by the entity handle.
+       ************************************************************************/
+      struct Entity
+      {
+        /** The user data of the entity. */
+        void * fUserData;
+
+        /** The index of the entity's cell or kNullEntity if the record is
+         * free. */
+        int32_t fCell;
+
+        /** The index of the entity in the cell's entries, or the next free
+         * record while the record is on the free list. */
+        int32_t fSlot;
+      };
+
+      /** The size of the cells. */
+      float fCellSize;
+
+      /** The reciprocal of the cell size. */
+      float fInvCellSize;
+
+      /** All the cells that have been created. */
+      std::vector<Cell> fCells;
+
+      /** The open addressing hash table mapping cell coordinates to indexes in
+       * fCells. The size is always a power of two. */
+      std::vector<int32_t> fTable;
+
+      /** The entity records. */
+      std::vector<Entity> fEntities;
+
+      /** The head of the list of free entity records. */
+      int32_t fFreeList;
+
+      /** The number of entities in the grid. */
+      size_t fEntityCount;
+
+      /** The smallest coordinates of all the cells that were created. */
+      int32_t fMinCell[3];
+
+      /** The largest coordinates of all the cells that were created. */
+      int32_t fMaxCell[3];
+
+      /*********************************************************************//**
+       * Return the hash of cell coordinates.
+       *
+       * @param x The X coordinate of the cell.
+       * @param y The Y coordinate of the cell.
+       * @param z The Z coordinate of the cell.
+       * @return  The hash of the coordinates.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE static size_t hashCell(int32_t x, int32_t y,
+                                                 int32_t z)
+      {
+        return size_t(uint32_t(x) * 73856093u ^ uint32_t(y) * 19349663u ^
+                      uint32_t(z) * 83492791u);
+      }
+
+      /*********************************************************************//**
+       * Return the coordinate of the cell containing a position component.
+       *
+       * @param value The position component.
+       * @return      The cell coordinate.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE int32_t cellCoord(float value) const
+      {
+        return int32_t(std::floor(value * fInvCellSize));
+      }
+
+      /*********************************************************************//**
+       * Find the index of a cell.
+       *
+       * @param x The X coordinate of the cell.
+       * @param y The Y coordinate of the cell.
+       * @param z The Z coordinate of the cell.
+       * @return  The index of the cell or kNullEntity if it does not exist.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE int32_t findCell(int32_t x, int32_t y,
+                                           int32_t z) const
+      {
+        /* Nothing to find in an empty table. */
+        if(fTable.empty())
+        {
+          return kNullEntity;
+        }
+
+        /* Probe until the cell or an empty slot is found. */
+        const size_t mask = fTable.size() - 1;
+        for(size_t i = hashCell(x, y, z) & mask; ; i = (i + 1) & mask)
+        {
+          int32_t index = fTable[i];
+          if(index == kNullEntity)
+          {
+            return kNullEntity;
+          }
+
+          const Cell & cell = fCells[index];
+          if(cell.fX == x && cell.fY == y && cell.fZ == z)
+          {
+            return index;
+          }
+        }
+      }
+
+      /*********************************************************************//**
+       * Find the index of a cell, creating it if it does not exist.
+       *
+       * @param x The X coordinate of the cell.
+       * @param y The Y coordinate of the cell.
+       * @param z The Z coordinate of the cell.
+       * @return  The index of the cell.
+       ************************************************************************/
+      int32_t findOrCreateCell(int32_t x, int32_t y, int32_t z);
+
+      /*********************************************************************//**
+       * Resize the hash table and reinsert all the cells.
+       *
+       * @param size  The new size of the table, a power of two of at least
+       *              twice the number of cells.
+       ************************************************************************/
+      void rebuildTable(size_t size);
+
+      /*********************************************************************//**
+       * Remove an entity from it's cell by moving the last entry of the cell
+       * into it's slot.
+       *
+       * @param entity  The handle of the entity.
+       ************************************************************************/
+      void unlink(int32_t entity);
+
+      /*********************************************************************//**
+       * Append an entity to a cell.
+       *
+       * @param entity    The handle of the entity.
+       * @param cell      The index of the cell.
+       * @param position  The position of the entity.
+       ************************************************************************/
+      void link(int32_t entity, int32_t cell, const Math::Vector4f & position);
+
+      /*********************************************************************//**
+       * Visit the existing cells on the surface of the cube of cells at
+       * Chebyshev distance ring around a centre cell.
+       *
+       * @param cx        The X coordinate of the centre cell.
+       * @param cy        The Y coordinate of the centre cell.
+       * @param cz        The Z coordinate of the centre cell.
+       * @param ring      The distance of the shell in cells.
+       * @param callback  Invoked as void callback(const Cell & cell).
+       ************************************************************************/
+      template <typename Callback> void forEachCellInRing(int32_t cx,
+        int32_t cy, int32_t cz, int32_t ring, Callback && callback) const
+      {
+        /* Clamp the shell's bounding cube to the created cells. */
+        int32_t x0 = std::max(cx - ring, fMinCell[0]);
+        int32_t x1 = std::min(cx + ring, fMaxCell[0]);
+        int32_t y0 = std::max(cy - ring, fMinCell[1]);
+        int32_t y1 = std::min(cy + ring, fMaxCell[1]);
+        int32_t z0 = std::max(cz - ring, fMinCell[2]);
+        int32_t z1 = std::min(cz + ring, fMaxCell[2]);
+
+        for(int32_t x = x0; x <= x1; x++)
+        {
+          for(int32_t y = y0; y <= y1; y++)
+          {
+            /* Rows on the shell's X or Y faces are entirely on the shell. */
+            if(std::abs(x - cx) == ring || std::abs(y - cy) == ring)
+            {
+              for(int32_t z = z0; z <= z1; z++)
+              {
+                int32_t index = findCell(x, y, z);
+                if(index != kNullEntity)
+                {
+                  callback(fCells[index]);
+                }
+              }
+              continue;
+            }
+
+            /* Other rows only touch the shell at their Z ends. */
+            int32_t index = cz - ring >= z0 ? findCell(x, y, cz - ring) :
+                                              kNullEntity;
+            if(index != kNullEntity)
+            {
+              callback(fCells[index]);
+            }
+
+            index = cz + ring <= z1 ? findCell(x, y, cz + ring) : kNullEntity;
+            if(index != kNullEntity)
+            {
+              callback(fCells[index]);
+            }
+          }
+        }
+      }
+
+    public:
+
+      /*********************************************************************//**
+       * Create an empty grid.
+       *
+       * @param cellSize  The size of the cells.
+       ************************************************************************/
+      SpatialGrid(float cellSize);
+
+      /*********************************************************************//**
+       * Remove all the entities and cells.
+       ************************************************************************/
+      void clear();
+
+      /*********************************************************************//**
+       * Add an entity to the grid.
+       *
+       * @param position  The position of the entity.
+       * @param userData  The user data to associate with the entity.
+       * @return          The handle of the entity.
+       ************************************************************************/
+      int32_t insert(const Math::Vector4f & position, void * userData);
+
+      /*********************************************************************//**
+       * Remove an entity from the grid.
+       *
+       * @param entity  The handle of the entity.
+       ************************************************************************/
+      void remove(int32_t entity);
+
+      /*********************************************************************//**
+       * Update the position of an entity in O(1).
+       *
+       * @param entity    The handle of the entity.
+       * @param position  The new position of the entity.
+       ************************************************************************/
+      void move(int32_t entity, const Math::Vector4f & position);
+
+      /*********************************************************************//**
+       * Free the cells that have no entities and shrink the hash table to
+       * fit the remaining cells. The entity handles do not change.
+       ************************************************************************/
+      void compact();
+
+      /*********************************************************************//**
+       * Return the user data that was associated with the entity.
+       *
+       * @param entity  The handle of the entity.
+       * @return        The user data of the entity.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE void * getUserData(int32_t entity) const
+      {
+        return fEntities[entity].fUserData;
+      }
+
+      /*********************************************************************//**
+       * Return the number of entities in the grid.
+       *
+       * @return  The number of entities.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t size() const
+      {
+        return fEntityCount;
+      }
+
+      /*********************************************************************//**
+       * Return the number of cells, including the empty ones that compact()
+       * has not freed yet.
+       *
+       * @return  The number of cells.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t getCellCount() const
+      {
+        return fCells.size();
+      }
+
+      /*********************************************************************//**
+       * Return the size of the cells.
+       *
+       * @return  The size of the cells.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE float getCellSize() const
+      {
+        return fCellSize;
+      }
+
+      /*********************************************************************//**
+       * Invoke the callback for every entity within the radius of a position.
+       *
+       * @param position  The centre of the query.
+       * @param radius    The radius of the query.
+       * @param callback  Invoked as void callback(int32_t entity,
+       *                  float distanceSq).
+       ************************************************************************/
+      template <typename Callback> void queryRadius(
+        const Math::Vector4f & position, float radius,
+        Callback && callback) const
+      {
+        /* Find the range of existing cells overlapped by the query. */
+        const float px = position.x(), py = position.y(), pz = position.z();
+        const float radiusSq = radius * radius;
+        int32_t x0 = std::max(cellCoord(px - radius), fMinCell[0]);
+        int32_t x1 = std::min(cellCoord(px + radius), fMaxCell[0]);
+        int32_t y0 = std::max(cellCoord(py - radius), fMinCell[1]);
+        int32_t y1 = std::min(cellCoord(py + radius), fMaxCell[1]);
+        int32_t z0 = std::max(cellCoord(pz - radius), fMinCell[2]);
+        int32_t z1 = std::min(cellCoord(pz + radius), fMaxCell[2]);
+
+        for(int32_t x = x0; x <= x1; x++)
+        {
+          for(int32_t y = y0; y <= y1; y++)
+          {
+            for(int32_t z = z0; z <= z1; z++)
+            {
+              /* Skip the cells that do not exist. */
+              int32_t index = findCell(x, y, z);
+              if(index == kNullEntity)
+              {
+                continue;
+              }
+
+              /* Test the entities of the cell. */
+              for(const Entry & entry : fCells[index].fEntries)
+              {
+                float dx = entry.fX - px;
+                float dy = entry.fY - py;
+                float dz = entry.fZ - pz;
+                float distanceSq = dx * dx + dy * dy + dz * dz;
+                if(distanceSq <= radiusSq)
+                {
+                  callback(entry.fEntity, distanceSq);
+                }
+              }
+            }
+          }
+        }
+      }
+
+      /*********************************************************************//**
+       * Find all the entities within the radius of a position.
+       *
+       * @param position    The centre of the query.
+       * @param radius      The radius of the query.
+       * @param neighbours  Used to return the entities, in no specific order.
+       *                    The vector is cleared first.
+       ************************************************************************/
+      void queryRadius(const Math::Vector4f & position, float radius,
+                       std::vector<Neighbour> & neighbours) const;
+
+      /*********************************************************************//**
+       * Find the k entities closest to a position. The search expands one
+       * shell of cells at a time and stops as soon as no closer entity can be
+       * found.
+       *
+       * @param position    The centre of the query.
+       * @param k           The number of entities to find.
+       * @param maxRadius   The maximum distance to search.
+       * @param neighbours  Used to return the entities, ordered from the
+       *                    closest to the furthest. The vector is cleared
+       *                    first.
+       ************************************************************************/
+      void queryNearest(const Math::Vector4f & position, size_t k,
+                        float maxRadius,
+                        std::vector<Neighbour> & neighbours) const;
+
+      /*********************************************************************//**
+       * Run a radius query for every position. If a pool is supplied the
+       * queries are spread over it's threads. The result vectors are reused,
+       * thus repeated batches do not allocate once they reached their peak
+       * sizes.
+       *
+       * @param positions The centres of the queries.
+       * @param radius    The radius of the queries.
+       * @param results   Used to return the neighbours of every position.
+       * @param pool      The worker pool to use, or nullptr to run serially.
+       ************************************************************************/
+      void queryRadius(const std::vector<Math::Vector4f> & positions,
+                       float radius,
+                       std::vector<std::vector<Neighbour>> & results,
+                       TaskPool * pool = nullptr) const;
+
+      /*********************************************************************//**
+       * Run a nearest neighbour query for every position. If a pool is
+       * supplied the queries are spread over it's threads.
+       *
+       * @param positions The centres of the queries.
+       * @param k         The number of entities to find per position.
+       * @param maxRadius The maximum distance to search.
+       * @param results   Used to return the neighbours of every position.
+       * @param pool      The worker pool to use, or nullptr to run serially.
+       ************************************************************************/
+      void queryNearest(const std::vector<Math::Vector4f> & positions,
+                        size_t k, float maxRadius,
+                        std::vector<std::vector<Neighbour>> & results,
+                        TaskPool * pool = nullptr) const;
+    };
+  }
+}
+
+#endif /* ANUBIS_PHYSICS_SPATIAL_GRID_HPP */
@@ -0,0 +1,380 @@
+#ifndef ANUBIS_PHYSICS_SWEEP_AND_PRUNE_HPP
+#define ANUBIS_PHYSICS_SWEEP_AND_PRUNE_HPP
+
+#include "../Common/Misc.hpp"
+#include "Broadphase.hpp"
+
+namespace Anubis
+{
+  namespace Physics
+  {
+    /***********************************************************************//**
+     * A sweep and prune broadphase intended for dense crowds of similar sized
+     * objects that move every frame, i.e. units on a mostly flat map.
+     *
+     * The boxes are kept in arrays sorted by their minimum endpoint on the
+     * sweep axis. Since objects only move a little per frame, move() restores
+     * the order with an insertion sort step that is usually only a few swaps,
+     * so there is no tree to rebalance. The bounds are stored as structure of
+     * arrays, thus when sweeping, four candidates are tested against the two
+     * remaining axes at a time with SIMD.
+     *
+     * For planar maps, choose the sweep axis along which the units are most
+     * spread out (X or Z), never the up axis.
+     **************************************************************************/
+    class SweepAndPrune final : public Broadphase
+    {
+    public:
+      /** The axes that can be used as the sweep axis. */
+      enum class Axes
+      {
+        /** Sweep along the X axis. */
+        X,
+
+        /** Sweep along the Y axis. */
+        Y,
+
+        /** Sweep along the Z axis. */
+        Z
+      };
+
+    private:
+      /*********************************************************************//**
+       * The record of a proxy, indexed by the proxy ID.
+       ************************************************************************/
+      struct Proxy
+      {
+        /** The user data of the proxy. */
+        void * fUserData;
+
+        /** The index of the proxy in the sorted arrays or kNullProxy if the
+         * proxy is free. */
+        int32_t fSortedIndex;
+
+        /** The next free proxy while the proxy is on the free list. */
+        int32_t fNext;
+      };
+
+      /** The component index of the sweep axis. */
+      size_t fAxisS;
+
+      /** The component index of the first of the other axes. */
+      size_t fAxisA;
+
+      /** The component index of the second of the other axes. */
+      size_t fAxisB;
+
+      /** The minimum endpoints on the sweep axis in ascending order. */
+      std::vector<float> fMinS;
+
+      /** The maximum endpoints on the sweep axis in sorted order. */
+      std::vector<float> fMaxS;
+
+      /** The minimum endpoints on the first other axis in sorted order. */
+      std::vector<float> fMinA;
+
+      /** The maximum endpoints on the first other axis in sorted order. */
+      std::vector<float> fMaxA;
+
+      /** The minimum endpoints on the second other axis in sorted order. */
+      std::vector<float> fMinB;
+
+      /** The maximum endpoints on the second other axis in sorted order. */
+      std::vector<float> fMaxB;
+
+      /** The proxy ID of every entry in the sorted arrays. */
+      std::vector<int32_t> fSortedProxies;
+
+      /** The proxy records. */
+      std::vector<Proxy> fProxies;
+
+      /** The head of the list of free proxy records. */
+      int32_t fFreeList;
+
+      /*********************************************************************//**
+       * Write the bounds of a box into an entry of the sorted arrays.
+       *
+       * @param index The index of the entry.
+       * @param box   The box to write.
+       ************************************************************************/
+      void setBounds(size_t index, const AABB & box);
+
+      /*********************************************************************//**
+       * Swap two entries of the sorted arrays.
+       *
+       * @param i The index of the first entry.
+       * @param j The index of the second entry.
+       ************************************************************************/
+      void swapEntries(size_t i, size_t j);
+
+      /*********************************************************************//**
+       * Move an entry towards the front or the back of the sorted arrays until
+       * it is in order again, i.e. a single insertion sort step.
+       *
+       * @param index The index of the entry that was changed.
+       ************************************************************************/
+      void restoreOrder(size_t index);
+
+      /*********************************************************************//**
+       * Test the four entries starting at index against bounds on the two
+       * axes other than the sweep axis.
+       *
+       * @param index The index of the first entry.
+       * @param minA  The minimum on the first other axis.
+       * @param maxA  The maximum on the first other axis.
+       * @param minB  The minimum on the second other axis.
+       * @param maxB  The maximum on the second other axis.
+       * @return      A mask with bit k set if entry index + k overlaps.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE int overlapMask4(size_t index, float minA, float maxA,
+        float minB, float maxB) const
+      {
+        #ifdef ANUBIS_HAS_SSE
+          /* Test four candidates at a time. */
+          __m128 a = _mm_and_ps(
+            _mm_cmple_ps(_mm_loadu_ps(&fMinA[index]), _mm_set1_ps(maxA)),
+            _mm_cmple_ps(_mm_set1_ps(minA), _mm_loadu_ps(&fMaxA[index])));
+          __m128 b = _mm_and_ps(
+            _mm_cmple_ps(_mm_loadu_ps(&fMinB[index]), _mm_set1_ps(maxB)),
+            _mm_cmple_ps(_mm_set1_ps(minB), _mm_loadu_ps(&fMaxB[index])));
+          return _mm_movemask_ps(_mm_and_ps(a, b));
+        #else
+          /* Test the candidates one by one. */
+          int mask = 0;
+          for(size_t k = 0; k < 4; k++)
+          {
+            if(fMinA[index + k] <= maxA && minA <= fMaxA[index + k] &&
+               fMinB[index + k] <= maxB && minB <= fMaxB[index + k])
+            {
+              mask |= 1 << k;
+            }
+          }
+          return mask;
+        #endif /* ANUBIS_HAS_SSE */
+      }
+
+      /*********************************************************************//**
+       * Compare the minimum sweep endpoints of the four entries starting at
+       * index against a value.
+       *
+       * @param index The index of the first entry.
+       * @param value The value to compare against.
+       * @return      A mask with bit k set if the endpoint of entry index + k
+       *              is not greater than the value.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE int sweepMask4(size_t index, float value) const
+      {
+        #ifdef ANUBIS_HAS_SSE
+          return _mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(&fMinS[index]),
+                                              _mm_set1_ps(value)));
+        #else
+          int mask = 0;
+          for(size_t k = 0; k < 4; k++)
+          {
+            mask |= (fMinS[index + k] <= value ? 1 : 0) << k;
+          }
+          return mask;
+        #endif /* ANUBIS_HAS_SSE */
+      }
+
+    public:
+
+      /*********************************************************************//**
+       * Create an empty broadphase.
+       *
+       * @param sweepAxis The axis along which the boxes are sorted.
+       ************************************************************************/
+      SweepAndPrune(Axes sweepAxis = Axes::X);
+
+      /*********************************************************************//**
+       * Make sure that count proxies can be stored without allocating.
+       *
+       * @param count The number of proxies.
+       ************************************************************************/
+      void reserve(size_t count);
+
+      /*********************************************************************//**
+       * Remove all the proxies, the memory is kept.
+       ************************************************************************/
+      void clear() override;
+
+      /*********************************************************************//**
+       * Create a proxy for an object.
+       *
+       * @param box       The box of the object.
+       * @param userData  The user data to associate with the proxy.
+       * @return          The proxy ID.
+       ************************************************************************/
+      int32_t insert(const AABB & box, void * userData) override;
+
+      /*********************************************************************//**
+       * Destroy a proxy. This is O(n) since the sorted arrays are compacted.
+       *
+       * @param proxy The ID of the proxy to destroy.
+       ************************************************************************/
+      void remove(int32_t proxy) override;
+
+      /*********************************************************************//**
+       * Update the box of a proxy and restore the sort order.
+       *
+       * @param proxy         The ID of the proxy.
+       * @param box           The new box of the object.
+       * @param displacement  Unused, the box is stored as is.
+       * @return              Always true.
+       ************************************************************************/
+      bool move(int32_t proxy, const AABB & box,
+                const Math::Vector4f & displacement) override;
+
+      /*********************************************************************//**
+       * Return the user data that was associated with the proxy.
+       *
+       * @param proxy The ID of the proxy.
+       * @return      The user data of the proxy.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE void * getUserData(int32_t proxy) const override
+      {
+        return fProxies[proxy].fUserData;
+      }
+
+      /*********************************************************************//**
+       * Return the number of proxies.
+       *
+       * @return  The number of proxies.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t size() const override
+      {
+        return fSortedProxies.size();
+      }
+
+      /*********************************************************************//**
+       * Invoke the callback for every proxy whose box overlaps the box. Only
+       * the entries whose minimum sweep endpoint is not past the box are
+       * visited, thus region queries are linear in the worst case; use an
+       * AABBTree when region queries dominate.
+       *
+       * @param box       The box to query.
+       * @param callback  Invoked as bool callback(int32_t proxy), return false
+       *                  to terminate the query.
+       ************************************************************************/
+      template <typename Callback>
+      void queryAABB(const AABB & box, Callback && callback) const
+      {
+        /* The bounds of the query box. */
+        const float * min = box.fMin.memory();
+        const float * max = box.fMax.memory();
+        const size_t count = size();
+
+        for(size_t i = 0; i < count; i++)
+        {
+          /* The remaining entries start past the box. */
+          if(fMinS[i] > max[fAxisS])
+          {
+            return;
+          }
+
+          /* Test the remaining axes. */
+          if(min[fAxisS] <= fMaxS[i] &&
+             fMinA[i] <= max[fAxisA] && min[fAxisA] <= fMaxA[i] &&
+             fMinB[i] <= max[fAxisB] && min[fAxisB] <= fMaxB[i])
+          {
+            if(!callback(fSortedProxies[i]))
+            {
+              return;
+            }
+          }
+        }
+      }
+
+      /*********************************************************************//**
+       * Invoke the callback once for every pair of proxies whose boxes
+       * overlap. Every entry is swept against the following entries until
+       * their minimum sweep endpoint passes it's maximum sweep endpoint.
+       *
+       * @param callback  Invoked as void callback(int32_t proxyA,
+       *                  int32_t proxyB) with proxyA < proxyB.
+       ************************************************************************/
+      template <typename Callback> void queryPairs(Callback && callback) const
+      {
+        const size_t count = size();
+        for(size_t i = 0; i < count; i++)
+        {
+          /* The bounds of the current entry. */
+          const float maxS = fMaxS[i];
+          const float minA = fMinA[i], maxA = fMaxA[i];
+          const float minB = fMinB[i], maxB = fMaxB[i];
+          const int32_t proxy = fSortedProxies[i];
+
+          /* Sweep four candidates at a time. */
+          size_t j = i + 1;
+          bool isDone = false;
+          while(j + 4 <= count)
+          {
+            /* Find the candidates that start before the entry ends. */
+            int sweepMask = sweepMask4(j, maxS);
+
+            /* Report the candidates that also overlap on the other axes. */
+            int mask = sweepMask & overlapMask4(j, minA, maxA, minB, maxB);
+            while(mask)
+            {
+              int k = Common::Bits::countTrailingZeros(mask);
+              int32_t other = fSortedProxies[j + k];
+              callback(std::min(proxy, other), std::max(proxy, other));
+              mask &= mask - 1;
+            }
+
+            /* The rest of the entries are past the entry. */
+            if(sweepMask != 0xF)
+            {
+              isDone = true;
+              break;
+            }
+
+            j += 4;
+          }
+
+          /* Sweep the remaining candidates one by one. */
+          for(; !isDone && j < count && fMinS[j] <= maxS; j++)
+          {
+            if(fMinA[j] <= maxA && minA <= fMaxA[j] &&
+               fMinB[j] <= maxB && minB <= fMaxB[j])
+            {
+              int32_t other = fSortedProxies[j];
+              callback(std::min(proxy, other), std::max(proxy, other));
+            }
+          }
+        }
+      }
+
+      /*********************************************************************//**
+       * Append the proxies whose boxes overlap the box to the vector.
+       *
+       * @param box     The box to query.
+       * @param proxies The vector that the proxy IDs are appended to.
+       ************************************************************************/
+      void queryAABB(const AABB & box,
+                     std::vector<int32_t> & proxies) const override
+      {
+        queryAABB(box, [&proxies](int32_t proxy)
+        {
+          proxies.push_back(proxy);
+          return true;
+        });
+      }
+
+      /*********************************************************************//**
+       * Append every pair of proxies whose boxes overlap to the vector.
+       *
+       * @param pairs The vector that the pairs are appended to.
+       ************************************************************************/
+      void queryPairs(std::vector<ProxyPair> & pairs) const override
+      {
+        queryPairs([&pairs](int32_t proxyA, int32_t proxyB)
+        {
+          pairs.push_back(ProxyPair(proxyA, proxyB));
+        });
+      }
+    };
+  }
+}
+
+#endif /* ANUBIS_PHYSICS_SWEEP_AND_PRUNE_HPP */
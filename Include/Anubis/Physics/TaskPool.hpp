@@ -0,0 +1,145 @@
+#ifndef ANUBIS_PHYSICS_TASK_POOL_HPP
+#define ANUBIS_PHYSICS_TASK_POOL_HPP
+
+#include "../Common/Misc.hpp"
+
+namespace Anubis
+{
+  namespace Physics
+  {
+    /***********************************************************************//**
+     * A fixed size pool of worker threads used to split data parallel physics
+     * work (i.e. transform updates, broadphase queries and solver batches)
+     * over the available cores.
+     *
+     * Work is submitted with parallelFor(), which splits a range of indexes
+     * into chunks that the workers and the calling thread claim until the
+     * whole range has been processed. The call blocks until all the chunks
+     * are complete, thus the pool behaves like a parallel for loop and no
+     * synchronisation is needed by the caller. No memory is allocated per
+     * call.
+     **************************************************************************/
+    class TaskPool final
+    {
+      /** The function signature used to invoke a chunk of work. */
+      typedef void (*ChunkFuncPtr)(void * ctx, size_t begin, size_t end);
+
+      /** The worker threads. */
+      std::vector<std::thread> fThreads;
+
+      /** The mutex protecting the job state. */
+      std::mutex fMutex;
+
+      /** Signals the workers that a new job is available. */
+      std::condition_variable fWorkCV;
+
+      /** Signals the calling thread that the workers finished the job. */
+      std::condition_variable fDoneCV;
+
+      /** The function invoked for every chunk of the current job. */
+      ChunkFuncPtr fFunc;
+
+      /** The context passed to the chunk function. */
+      void * fCtx;
+
+      /** The number of items in the current job. */
+      size_t fCount;
+
+      /** The number of items per chunk. */
+      size_t fGrainSize;
+
+      /** The next item that has not been claimed. */
+      std::atomic_size_t fNext;
+
+      /** The number of workers that are still busy with the current job. */
+      size_t fBusyCount;
+
+      /** Incremented for every job so that workers can detect new work. */
+      uint64_t fGeneration;
+
+      /** Indicate whether the worker threads should keep running. */
+      bool fIsExecuting;
+
+      /** The first exception thrown by a chunk of the current job. */
+      std::exception_ptr fException;
+
+      /** Delete the copy constructor. */
+      TaskPool(const TaskPool &) = delete;
+
+      /** Delete the assignment operator. */
+      TaskPool & operator = (const TaskPool &) = delete;
+
+      /*********************************************************************//**
+       * The entry point of the worker threads.
+       ************************************************************************/
+      void threadEntry();
+
+      /*********************************************************************//**
+       * Claim and process chunks of the current job until none are left.
+       ************************************************************************/
+      void processChunks();
+
+      /*********************************************************************//**
+       * Run a job over the range [0, count) and wait for it to complete.
+       *
+       * @param count     The number of items to process.
+       * @param grainSize The number of items per chunk.
+       * @param func      The function invoked for every chunk.
+       * @param ctx       The context passed to func.
+       ************************************************************************/
+      void run(size_t count, size_t grainSize, ChunkFuncPtr func, void * ctx);
+
+    public:
+
+      /*********************************************************************//**
+       * Create the pool. The calling thread of parallelFor() also processes
+       * chunks, thus threadCount - 1 worker threads are created. A thread
+       * count of 0 uses the number of hardware threads.
+       *
+       * @param threadCount The total number of threads to process work on.
+       ************************************************************************/
+      TaskPool(size_t threadCount = 0);
+
+      /*********************************************************************//**
+       * Stop and join all the worker threads.
+       ************************************************************************/
+      ~TaskPool();
+
+      /*********************************************************************//**
+       * Return the number of threads that process work, including the calling
+       * thread.
+       *
+       * @return  The number of threads.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE size_t getThreadCount() const
+      {
+        return fThreads.size() + 1;
+      }
+
+      /*********************************************************************//**
+       * Invoke func(begin, end) for consecutive chunks of grainSize items
+       * covering the range [0, count). The chunks are processed concurrently
+       * and the function returns once all of them are complete. If any chunk
+       * throws an exception, the first exception is rethrown on the calling
+       * thread.
+       *
+       * @param count     The number of items to process.
+       * @param grainSize The maximum number of items per chunk.
+       * @param func      The callable invoked as func(begin, end).
+       ************************************************************************/
+      template <typename Func>
+      void parallelFor(size_t count, size_t grainSize, Func && func)
+      {
+        /* The type of the callable without the reference. */
+        typedef typename std::remove_reference<Func>::type FuncType;
+
+        run(count, grainSize, [](void * ctx, size_t begin, size_t end)
+        {
+          (*static_cast<FuncType*>(ctx))(begin, end);
+        }, const_cast<void*>(static_cast<const void*>(&func)));
+      }
+    };
+  }
+}
+
+#endif /* ANUBIS_PHYSICS_TASK_POOL_HPP */
@@ -0,0 +1,71 @@
+#ifndef ANUBIS_PHYSICS_TRAVERSAL_STACK_HPP
+#define ANUBIS_PHYSICS_TRAVERSAL_STACK_HPP
+
+#include "../Common/Misc.hpp"
+
+namespace Anubis
+{
+  namespace Physics
+  {
+    /***********************************************************************//**
+     * The stack used to traverse trees during queries. The first kLocalCount
+     * entries live on the call stack, thus a query on a reasonably balanced
+     * tree never allocates, while degenerate trees spill over to the heap.
+     **************************************************************************/
+    template <typename T> class TraversalStack final
+    {
+      /** The number of entries that are stored without allocating. */
+      static const size_t kLocalCount = 128;
+
+      /** The entries stored on the call stack. */
+      T fLocal[kLocalCount];
+
+      /** The entries that did not fit in the local storage. */
+      std::vector<T> fOverflow;
+
+      /** The number of entries on the stack. */
+      size_t fCount;
+
+    public:
+
+      /** Create an empty stack. */
+      ANUBIS_FORCE_INLINE TraversalStack() : fCount(0) {}
+
+      /** Push an entry onto the stack. */
+      ANUBIS_FORCE_INLINE void push(const T & value)
+      {
+        if(fCount < kLocalCount)
+        {
+          fLocal[fCount] = value;
+        }
+        else
+        {
+          fOverflow.push_back(value);
+        }
+        ++fCount;
+      }
+
+      /** Pop the top entry of the stack. */
+      ANUBIS_FORCE_INLINE T pop()
+      {
+        --fCount;
+        if(fCount < kLocalCount)
+        {
+          return fLocal[fCount];
+        }
+
+        T value = fOverflow.back();
+        fOverflow.pop_back();
+        return value;
+      }
+
+      /** Return true if the stack is empty. */
+      ANUBIS_FORCE_INLINE bool empty() const
+      {
+        return fCount == 0;
+      }
+    };
+  }
+}
+
+#endif /* ANUBIS_PHYSICS_TRAVERSAL_STACK_HPP */
@@ -0,0 +1,218 @@
+#ifndef ANUBIS_PHYSICS_TRIANGLE_HPP
+#define ANUBIS_PHYSICS_TRIANGLE_HPP
+
+#include "../Math/Vector4f.hpp"
+#include "AABB.hpp"
+
+namespace Anubis
+{
+  namespace Physics
+  {
+    /***********************************************************************//**
+     * A triangle described by it's three corners, the geometric queries that
+     * are shared by the mesh code. The triangles are double sided.
+     **************************************************************************/
+    struct Triangle
+    {
+      /** The first corner. */
+      Math::Vector4f fA;
+
+      /** The second corner. */
+      Math::Vector4f fB;
+
+      /** The third corner. */
+      Math::Vector4f fC;
+
+      /*********************************************************************//**
+       * Return the box that encloses the triangle.
+       *
+       * @return  The enclosing box.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE AABB bounds() const noexcept
+      {
+        return AABB(Math::Vector4f::min(Math::Vector4f::min(fA, fB), fC),
+                    Math::Vector4f::max(Math::Vector4f::max(fA, fB), fC));
+      }
+
+      /*********************************************************************//**
+       * Return the point of the triangle closest to p, see Real-Time
+       * Collision Detection 5.1.5.
+       *
+       * @param p The point.
+       * @return  The closest point on the triangle.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE Math::Vector4f closestPoint(
+        const Math::Vector4f & p) const noexcept
+      {
+        /* Check if p is in the vertex region outside a. */
+        Math::Vector4f ab = fB - fA, ac = fC - fA, ap = p - fA;
+        float d1 = ab.dot(ap), d2 = ac.dot(ap);
+        if(d1 <= 0.0f && d2 <= 0.0f)
+        {
+          return fA;
+        }
+
+        /* Check if p is in the vertex region outside b. */
+        Math::Vector4f bp = p - fB;
+        float d3 = ab.dot(bp), d4 = ac.dot(bp);
+        if(d3 >= 0.0f && d4 <= d3)
+        {
+          return fB;
+        }
+
+        /* Check if p is in the edge region of ab. */
+        float vc = d1 * d4 - d3 * d2;
+        if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+        {
+          return fA + ab * (d1 / (d1 - d3));
+        }
+
+        /* Check if p is in the vertex region outside c. */
+        Math::Vector4f cp = p - fC;
+        float d5 = ab.dot(cp), d6 = ac.dot(cp);
+        if(d6 >= 0.0f && d5 <= d6)
+        {
+          return fC;
+        }
+
+        /* Check if p is in the edge region of ac. */
+        float vb = d5 * d2 - d1 * d6;
+        if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+        {
+          return fA + ac * (d2 / (d2 - d6));
+        }
+
+        /* Check if p is in the edge region of bc. */
+        float va = d3 * d6 - d5 * d4;
+        if(va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+        {
+          return fB + (fC - fB) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+        }
+
+        /* p is inside the face region. */
+        float denom = 1.0f / (va + vb + vc);
+        return fA + ab * (vb * denom) + ac * (vc * denom);
+      }
+
+      /*********************************************************************//**
+       * Intersect a ray with the triangle using the Moller-Trumbore
+       * algorithm.
+       *
+       * @param origin    The origin of the ray.
+       * @param direction The direction of the ray.
+       * @param t         Returns the distance along the ray of the crossing.
+       * @return          True if the ray crosses the triangle at t >= 0.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE bool intersect(const Math::Vector4f & origin,
+        const Math::Vector4f & direction, float & t) const noexcept
+      {
+        /* The ray is parallel to the triangle. */
+        Math::Vector4f edge1 = fB - fA, edge2 = fC - fA;
+        Math::Vector4f p = direction.cross(edge2);
+        float det = edge1.dot(p);
+        if(det == 0.0f)
+        {
+          return false;
+        }
+
+        /* Calculate the barycentric coordinates of the crossing. */
+        float invDet = 1.0f / det;
+        Math::Vector4f s = origin - fA;
+        float u = s.dot(p) * invDet;
+        if(u < 0.0f || u > 1.0f)
+        {
+          return false;
+        }
+
+        Math::Vector4f q = s.cross(edge1);
+        float v = direction.dot(q) * invDet;
+        if(v < 0.0f || u + v > 1.0f)
+        {
+          return false;
+        }
+
+        /* Only the crossings in front of the ray count. */
+        t = edge2.dot(q) * invDet;
+        return t >= 0.0f;
+      }
+
+      /*********************************************************************//**
+       * Return true if the triangle overlaps the box, using the 13 axes of
+       * Akenine-Moller's separating axis test.
+       *
+       * @param box The box.
+       * @return    True if the triangle and the box overlap.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE bool overlaps(const AABB & box) const noexcept
+      {
+        /* Work relative to the centre of the box. */
+        Math::Vector4f centre = (box.fMin + box.fMax) * 0.5f;
+        Math::Vector4f extent = (box.fMax - box.fMin) * 0.5f;
+        Math::Vector4f v[3] = {fA - centre, fB - centre, fC - centre};
+
+        /* The face normals of the box are the bounds of the triangle. */
+        for(size_t axis = 0; axis < 3; axis++)
+        {
+          float e = extent.memory()[axis];
+          float p0 = v[0].memory()[axis];
+          float p1 = v[1].memory()[axis];
+          float p2 = v[2].memory()[axis];
+          if(std::min(std::min(p0, p1), p2) > e ||
+             std::max(std::max(p0, p1), p2) < -e)
+          {
+            return false;
+          }
+        }
+
+        /* Test an axis, the box interval is symmetric around the origin. */
+        auto isSeparating = [&](const Math::Vector4f & axis)
+        {
+          float radius = extent.x() * std::fabs(axis.x()) +
+                         extent.y() * std::fabs(axis.y()) +
+                         extent.z() * std::fabs(axis.z());
+          float p0 = axis.dot(v[0]), p1 = axis.dot(v[1]);
+          float p2 = axis.dot(v[2]);
+          return std::min(std::min(p0, p1), p2) > radius ||
+                 std::max(std::max(p0, p1), p2) < -radius;
+        };
+
+        /* The normal of the triangle. */
+        const Math::Vector4f edges[3] = {v[1] - v[0], v[2] - v[1],
+                                         v[0] - v[2]};
+        if(isSeparating(edges[0].cross(edges[1])))
+        {
+          return false;
+        }
+
+        /* The cross products of the box axes and the triangle edges. */
+        for(const Math::Vector4f & edge : edges)
+        {
+          if(isSeparating(Math::Vector4f(0.0f, -edge.z(), edge.y(), 0.0f)) ||
+             isSeparating(Math::Vector4f(edge.z(), 0.0f, -edge.x(), 0.0f)) ||
+             isSeparating(Math::Vector4f(-edge.y(), edge.x(), 0.0f, 0.0f)))
+          {
+            return false;
+          }
+        }
+
+        return true;
+      }
+
+      /*********************************************************************//**
+       * Return true if the triangle overlaps the sphere.
+       *
+       * @param centre  The centre of the sphere.
+       * @param radius  The radius of the sphere.
+       * @return        True if the triangle and the sphere overlap.
+       ************************************************************************/
+      ANUBIS_FORCE_INLINE bool overlaps(const Math::Vector4f & centre,
+                                        float radius) const noexcept
+      {
+        Math::Vector4f offset = closestPoint(centre) - centre;
+        return offset.dot(offset) <= radius * radius;
+      }
+    };
+  }
+}
+
+#endif /* ANUBIS_PHYSICS_TRIANGLE_HPP */
@@ -2,6 +2,7 @@
 #define ANUBIS_SIMULATION_CONTEXT_HPP
 
 #include "../Common.hpp"
+#include "../Physics/RigidBodyWorld.hpp"
 
 namespace Anubis
 {
@@ -90,6 +91,10 @@ namespace Anubis
                        std::exception_ptr * exPtr);
 
     protected:
+      /** The rigid bodies of the simulation. They are integrated by the
+       * physics thread in updatePhysics() and must only be accessed by the
+       * other threads in their sync functions. */
+      Physics::RigidBodyWorld fBodies;
 
       virtual void syncNetwork(bool isFirstFrame);
       virtual void updateNetwork(float dt, bool isFirstFrame);
@@ -2,6 +2,30 @@
 
 using namespace Anubis;
 
+#ifdef ANUBIS_DETERMINISTIC
+/******************************************************************************/
+/* Reduce an angle to [-Pi/4, Pi/4] and return the sine and cosine of the
+ * reduced angle with minimax polynomials (Cephes). The quadrant is returned
+ * in quadrant. Pi/2 is split into three parts so the reduction is exact for
+ * angles up to a few thousand radians. */
+static void sinCos(float angle, float & sine, float & cosine, int & quadrant)
+{
+  const float k2OverPi = 0.63661975f;
+  const float kPiOver2A = 1.5703125f;
+  const float kPiOver2B = 4.837512969970703125e-4f;
+  const float kPiOver2C = 7.54978995489188216e-8f;
+
+  const float j = std::floor(angle * k2OverPi + 0.5f);
+  const float x = ((angle - j * kPiOver2A) - j * kPiOver2B) - j * kPiOver2C;
+  const float z = x * x;
+  quadrant = int(int64_t(j) & 3);
+  sine = x + x * z * (-1.6666654611e-1f + z * (8.3321608736e-3f +
+                      z * -1.9515295891e-4f));
+  cosine = 1.0f - 0.5f * z + z * z * (4.166664568298827e-2f +
+           z * (-1.388731625493765e-3f + z * 2.443315711809948e-5f));
+}
+#endif /* ANUBIS_DETERMINISTIC */
+
 /******************************************************************************/
 bool Float::compare(float a, float b, float epsilon)
 {
@@ -46,3 +70,31 @@ float Float::sumAngles(float angle1, float angle2)
   /* Return the angle. */
   return angle1;
 }
+
+/******************************************************************************/
+float Float::sin(float angle)
+{
+  #ifdef ANUBIS_DETERMINISTIC
+    float sine, cosine;
+    int quadrant;
+    sinCos(angle, sine, cosine, quadrant);
+    const float values[4] = {sine, cosine, -sine, -cosine};
+    return values[quadrant];
+  #else
+    return std::sin(angle);
+  #endif /* ANUBIS_DETERMINISTIC */
+}
+
+/******************************************************************************/
+float Float::cos(float angle)
+{
+  #ifdef ANUBIS_DETERMINISTIC
+    float sine, cosine;
+    int quadrant;
+    sinCos(angle, sine, cosine, quadrant);
+    const float values[4] = {cosine, -sine, -cosine, sine};
+    return values[quadrant];
+  #else
+    return std::cos(angle);
+  #endif /* ANUBIS_DETERMINISTIC */
+}
@@ -17,12 +17,12 @@ Quaternion Quaternion::fromEuler(float xRot, float yRot, float zRot)
 
   /* Precompute and cache common trig identities to avoid expensive
    * recalculations. */
-  float sina = std::sin(a);
-  float sinb = std::sin(b);
-  float sing = std::sin(g);
-  float cosa = std::cos(a);
-  float cosb = std::cos(b);
-  float cosg = std::cos(g);
+  float sina = Float::sin(a);
+  float sinb = Float::sin(b);
+  float sing = Float::sin(g);
+  float cosa = Float::cos(a);
+  float cosb = Float::cos(b);
+  float cosg = Float::cos(g);
 
   /* Build the quaternion. */
   float w = cosg * cosb * cosa + sing * sinb * sing;
@@ -41,13 +41,13 @@ Quaternion Quaternion::fromAxisAndAngle(const Vector4f & vec, float angle)
   angle *= 0.5f;
 
   /* Calculate the sin of the angle. */
-  float sa = std::sin(angle);
+  float sa = Float::sin(angle);
 
   /* Build the quaternion. */
   float x = vec.x() * sa;
   float y = vec.y() * sa;
   float z = vec.z() * sa;
-  float w = std::cos(angle);
+  float w = Float::cos(angle);
 
   /* Normalise and return the quaternion. */
   return Quaternion(x, y, z, w).normalise();
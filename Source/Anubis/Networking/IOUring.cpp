@@ -0,0 +1,691 @@
+#include "../../../Include/Anubis/Common/System.hpp"
+#include "../../../Include/Anubis/Networking/IOUring.hpp"
+
+/* The ring needs provided buffer rings and multishot receives, the kernel
+ * headers tell if they are known at all, the kernel is probed at run time. */
+#if ANUBIS_OS == ANUBIS_OS_UNIX && defined(__linux__)
+  #include <linux/io_uring.h>
+  #if defined(IORING_RECV_MULTISHOT) && defined(IORING_SETUP_TASKRUN_FLAG)
+    #define ANUBIS_HAS_IO_URING
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+  #endif /* IORING_RECV_MULTISHOT && IORING_SETUP_TASKRUN_FLAG */
+#endif /* ANUBIS_OS == ANUBIS_OS_UNIX && __linux__ */
+
+using namespace Anubis::Networking;
+
+#ifdef ANUBIS_HAS_IO_URING
+
+/* The user data of the submissions. */
+static const uint64_t kRecvTag = 1;
+static const uint64_t kSendTag = 2;
+static const uint64_t kCancelTag = 3;
+static const uint64_t kWakeTag = 4;
+
+/* The group of the registered receive buffers. */
+static const uint16_t kBufGroup = 0;
+
+/* The space reserved for the address in front of every payload. */
+static const size_t kNameLen = SocketAddress::kStorageLen;
+
+/******************************************************************************/
+static size_t nextPowerOf2(size_t value)
+{
+  size_t result = 1;
+  while(result < value)
+  {
+    result <<= 1;
+  }
+  return result;
+}
+
+/******************************************************************************/
+struct IOUring::Data final
+{
+  /** The file descriptor of the ring. */
+  int fRing;
+
+  /** The mapped submission and completion rings. */
+  void * fSqMap;
+  size_t fSqMapLen;
+  void * fCqMap;
+  size_t fCqMapLen;
+
+  /** The mapped submission entries. */
+  struct io_uring_sqe * fSqes;
+  size_t fSqesLen;
+
+  /** The fields of the submission ring. */
+  unsigned * fSqHead;
+  unsigned * fSqTail;
+  unsigned * fSqFlags;
+  unsigned * fSqArray;
+  unsigned fSqMask;
+  unsigned fSqEntries;
+
+  /** The local tail and the number of entries that were not submitted. */
+  unsigned fSqLocalTail;
+  unsigned fToSubmit;
+
+  /** The fields of the completion ring. */
+  unsigned * fCqHead;
+  unsigned * fCqTail;
+  unsigned fCqMask;
+  struct io_uring_cqe * fCqes;
+
+  /** The registered ring of receive buffers and the buffers themselves. The
+   * ring is addressed as an array, since the header's io_uring_buf_ring has
+   * another layout in C++, the tail overlays the first entry's resv. */
+  struct io_uring_buf * fBufRing;
+  size_t fBufRingLen;
+  std::unique_ptr<uint8_t[]> fBuffers;
+  size_t fBufLen;
+  size_t fMaxPktLen;
+  uint16_t fBufCount;
+  uint16_t fBufTail;
+
+  /** The message header of the multishot receive, it only sets the space
+   * reserved for the address. */
+  struct msghdr fRecvHdr;
+
+  /** Indicate if the multishot receive is armed. */
+  bool fIsArmed;
+
+  /** The message headers, vectors and addresses of the sends. */
+  std::vector<struct msghdr> fSendHdrs;
+  std::vector<struct iovec> fSendVecs;
+  std::vector<SocketAddress> fSendAddrs;
+
+  /** The lock of the rings, it's not held while waiting. */
+  std::mutex fMutex;
+
+  /** The number of system calls made. */
+  std::atomic<size_t> fSysCalls;
+
+  /** Create an empty ring. */
+  Data();
+
+  /** Unmap and close the ring. */
+  ~Data();
+
+  /** Delete the copy constructor. */
+  Data(const Data &) = delete;
+
+  /** Delete the assignment operator. */
+  Data & operator = (const Data &) = delete;
+
+  bool init(unsigned sqEntries, unsigned cqEntries);
+  bool initBuffers(size_t count, size_t bufLen);
+  struct io_uring_sqe * getSqe();
+  int enter(unsigned toSubmit, unsigned minComplete, unsigned flags);
+  int submit(unsigned minComplete = 0, unsigned flags = 0);
+  void armReceive(int fd, unsigned sqeFlags);
+  void recycle(uint16_t bid);
+};
+
+/******************************************************************************/
+IOUring::Data::Data() :
+  fRing(-1), fSqMap(MAP_FAILED), fSqMapLen(0), fCqMap(MAP_FAILED),
+  fCqMapLen(0), fSqes(nullptr), fSqesLen(0), fSqHead(nullptr),
+  fSqTail(nullptr), fSqFlags(nullptr), fSqArray(nullptr), fSqMask(0),
+  fSqEntries(0), fSqLocalTail(0), fToSubmit(0), fCqHead(nullptr),
+  fCqTail(nullptr), fCqMask(0), fCqes(nullptr), fBufRing(nullptr),
+  fBufRingLen(0), fBufLen(0), fMaxPktLen(0), fBufCount(0), fBufTail(0),
+  fRecvHdr(), fIsArmed(false), fSysCalls(0)
+{
+}
+
+/******************************************************************************/
+IOUring::Data::~Data()
+{
+  /* Closing the ring releases the registered file and buffers. */
+  if(fRing >= 0)
+  {
+    close(fRing);
+  }
+  if(fSqes)
+  {
+    munmap(fSqes, fSqesLen);
+  }
+  if(fCqMap != MAP_FAILED && fCqMap != fSqMap)
+  {
+    munmap(fCqMap, fCqMapLen);
+  }
+  if(fSqMap != MAP_FAILED)
+  {
+    munmap(fSqMap, fSqMapLen);
+  }
+  if(fBufRing)
+  {
+    munmap(fBufRing, fBufRingLen);
+  }
+}
+
+/******************************************************************************/
+bool IOUring::Data::init(unsigned sqEntries, unsigned cqEntries)
+{
+  /* Run the completions when the thread enters the kernel anyway instead of
+   * interrupting it, the flag tells when it has to. */
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN |
+                 IORING_SETUP_TASKRUN_FLAG;
+  params.cq_entries = cqEntries;
+  fRing = int(syscall(__NR_io_uring_setup, sqEntries, &params));
+  if(fRing < 0)
+  {
+    return false;
+  }
+
+  /* Map the rings, newer kernels share one mapping. */
+  fSqMapLen = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  fCqMapLen = params.cq_off.cqes +
+              params.cq_entries * sizeof(struct io_uring_cqe);
+  const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if(single)
+  {
+    fSqMapLen = fCqMapLen = std::max(fSqMapLen, fCqMapLen);
+  }
+  fSqMap = mmap(nullptr, fSqMapLen, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, fRing, IORING_OFF_SQ_RING);
+  if(fSqMap == MAP_FAILED)
+  {
+    return false;
+  }
+  fCqMap = single ? fSqMap :
+           mmap(nullptr, fCqMapLen, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, fRing, IORING_OFF_CQ_RING);
+  if(fCqMap == MAP_FAILED)
+  {
+    return false;
+  }
+  fSqesLen = params.sq_entries * sizeof(struct io_uring_sqe);
+  void * sqes = mmap(nullptr, fSqesLen, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fRing, IORING_OFF_SQES);
+  if(sqes == MAP_FAILED)
+  {
+    return false;
+  }
+  fSqes = static_cast<struct io_uring_sqe*>(sqes);
+
+  uint8_t * sq = static_cast<uint8_t*>(fSqMap);
+  fSqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+  fSqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  fSqFlags = reinterpret_cast<unsigned*>(sq + params.sq_off.flags);
+  fSqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  fSqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  fSqEntries = params.sq_entries;
+  fSqLocalTail = *fSqTail;
+
+  uint8_t * cq = static_cast<uint8_t*>(fCqMap);
+  fCqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  fCqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  fCqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  fCqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+  return true;
+}
+
+/******************************************************************************/
+bool IOUring::Data::initBuffers(size_t count, size_t bufLen)
+{
+  /* The ring of buffer descriptors must be page aligned. */
+  fBufRingLen = count * sizeof(struct io_uring_buf);
+  void * ring = mmap(nullptr, fBufRingLen, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(ring == MAP_FAILED)
+  {
+    return false;
+  }
+  fBufRing = static_cast<struct io_uring_buf*>(ring);
+
+  struct io_uring_buf_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = uint64_t(uintptr_t(fBufRing));
+  reg.ring_entries = unsigned(count);
+  reg.bgid = kBufGroup;
+  if(syscall(__NR_io_uring_register, fRing, IORING_REGISTER_PBUF_RING, &reg,
+             1) != 0)
+  {
+    return false;
+  }
+
+  /* Hand all the buffers to the kernel. */
+  fBufLen = bufLen;
+  fBufCount = uint16_t(count);
+  fBuffers.reset(new uint8_t[count * bufLen]);
+  for(size_t i = 0; i < count; i++)
+  {
+    recycle(uint16_t(i));
+  }
+  return true;
+}
+
+/******************************************************************************/
+struct io_uring_sqe * IOUring::Data::getSqe()
+{
+  /* Submit the queued entries if the ring is full. */
+  unsigned head = __atomic_load_n(fSqHead, __ATOMIC_ACQUIRE);
+  if(fSqLocalTail - head >= fSqEntries)
+  {
+    submit();
+  }
+
+  const unsigned index = fSqLocalTail & fSqMask;
+  struct io_uring_sqe * sqe = &fSqes[index];
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+  fSqArray[index] = index;
+  ++fSqLocalTail;
+  ++fToSubmit;
+  return sqe;
+}
+
+/******************************************************************************/
+int IOUring::Data::enter(unsigned toSubmit, unsigned minComplete,
+                         unsigned flags)
+{
+  int result;
+  do
+  {
+    ++fSysCalls;
+    result = int(syscall(__NR_io_uring_enter, fRing, toSubmit, minComplete,
+                         flags, nullptr, 0));
+  }
+  while(result < 0 && errno == EINTR && toSubmit == 0);
+  return result;
+}
+
+/******************************************************************************/
+int IOUring::Data::submit(unsigned minComplete, unsigned flags)
+{
+  __atomic_store_n(fSqTail, fSqLocalTail, __ATOMIC_RELEASE);
+  int result = enter(fToSubmit, minComplete, flags);
+  if(result > 0)
+  {
+    fToSubmit -= std::min(fToSubmit, unsigned(result));
+  }
+  return result;
+}
+
+/******************************************************************************/
+void IOUring::Data::armReceive(int fd, unsigned sqeFlags)
+{
+  /* The kernel picks a registered buffer for every datagram and keeps the
+   * receive armed until it runs out of them. */
+  fRecvHdr.msg_namelen = socklen_t(kNameLen);
+  struct io_uring_sqe * sqe = getSqe();
+  sqe->opcode = IORING_OP_RECVMSG;
+  sqe->fd = fd;
+  sqe->flags = uint8_t(sqeFlags | IOSQE_BUFFER_SELECT);
+  sqe->addr = uint64_t(uintptr_t(&fRecvHdr));
+  sqe->len = 1;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->buf_group = kBufGroup;
+  sqe->user_data = kRecvTag;
+  fIsArmed = true;
+}
+
+/******************************************************************************/
+void IOUring::Data::recycle(uint16_t bid)
+{
+  struct io_uring_buf * buf = &fBufRing[fBufTail & uint16_t(fBufCount - 1)];
+  buf->addr = uint64_t(uintptr_t(fBuffers.get() + bid * fBufLen));
+  buf->len = uint32_t(fBufLen);
+  buf->bid = bid;
+  ++fBufTail;
+  __atomic_store_n(&fBufRing[0].resv, fBufTail, __ATOMIC_RELEASE);
+}
+
+/******************************************************************************/
+IOUring::IOUring(std::unique_ptr<Data> & data) : fData(std::move(data))
+{
+}
+
+/******************************************************************************/
+bool IOUring::isSupported()
+{
+  /* Arm a multishot receive on a spare socket and cancel it again, older
+   * kernels reject it straight away. */
+  static const bool supported = []()
+  {
+    Data data;
+    if(!data.init(4, 8) || !data.initBuffers(4, 64))
+    {
+      return false;
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if(fd < 0)
+    {
+      return false;
+    }
+    data.armReceive(fd, 0);
+    struct io_uring_sqe * sqe = data.getSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = kRecvTag;
+    sqe->user_data = kCancelTag;
+
+    /* The receive was armed if it was cancelled. */
+    bool result = false;
+    if(data.submit(2, IORING_ENTER_GETEVENTS) == 2)
+    {
+      unsigned head = *data.fCqHead;
+      unsigned tail = __atomic_load_n(data.fCqTail, __ATOMIC_ACQUIRE);
+      for(; head != tail; ++head)
+      {
+        const struct io_uring_cqe & cqe = data.fCqes[head & data.fCqMask];
+        if(cqe.user_data == kRecvTag)
+        {
+          result = cqe.res == -ECANCELED;
+        }
+      }
+    }
+    close(fd);
+    return result;
+  }();
+  return supported;
+}
+
+/******************************************************************************/
+std::unique_ptr<IOUring> IOUring::create(Socket & socket, size_t maxPktLen,
+                                         size_t batchSize)
+{
+  if(!isSupported())
+  {
+    return nullptr;
+  }
+
+  /* Keep enough buffers for a few batches in flight, the completion ring
+   * has room for one per buffer and a failed send per datagram. */
+  batchSize = std::max<size_t>(batchSize, 1);
+  const size_t bufCount = std::min<size_t>(
+    nextPowerOf2(std::max<size_t>(4 * batchSize, 64)), 32768);
+  std::unique_ptr<Data> data = std::make_unique<Data>();
+  if(!data->init(unsigned(nextPowerOf2(batchSize + 1)),
+                 unsigned(nextPowerOf2(bufCount + batchSize))))
+  {
+    return nullptr;
+  }
+
+  /* Every buffer holds the receive header, the address and the payload. */
+  const size_t bufLen = (sizeof(struct io_uring_recvmsg_out) + kNameLen +
+                         maxPktLen + 63) / 64 * 64;
+  if(!data->initBuffers(bufCount, bufLen))
+  {
+    return nullptr;
+  }
+  data->fMaxPktLen = maxPktLen;
+
+  int fd = int(socket.getHandle());
+  if(syscall(__NR_io_uring_register, data->fRing, IORING_REGISTER_FILES, &fd,
+             1) != 0)
+  {
+    return nullptr;
+  }
+
+  /* Point the send headers at their vectors and addresses once. */
+  data->fSendHdrs.resize(batchSize);
+  data->fSendVecs.resize(batchSize);
+  data->fSendAddrs.resize(batchSize);
+  memset(data->fSendHdrs.data(), 0, batchSize * sizeof(struct msghdr));
+  for(size_t i = 0; i < batchSize; i++)
+  {
+    data->fSendHdrs[i].msg_iov = &data->fSendVecs[i];
+    data->fSendHdrs[i].msg_iovlen = 1;
+  }
+
+  return std::unique_ptr<IOUring>(new IOUring(data));
+}
+
+/******************************************************************************/
+IOUring::~IOUring()
+{
+  /* Wait for the receive to end before the buffers are released. */
+  std::lock_guard<std::mutex> lock(fData->fMutex);
+  if(fData->fIsArmed)
+  {
+    struct io_uring_sqe * sqe = fData->getSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = kRecvTag;
+    sqe->user_data = kCancelTag;
+    fData->submit();
+
+    while(fData->fIsArmed)
+    {
+      unsigned head = *fData->fCqHead;
+      unsigned tail = __atomic_load_n(fData->fCqTail, __ATOMIC_ACQUIRE);
+      if(head == tail)
+      {
+        if(fData->enter(0, 1, IORING_ENTER_GETEVENTS) < 0)
+        {
+          break;
+        }
+        continue;
+      }
+      for(; head != tail; ++head)
+      {
+        const struct io_uring_cqe & cqe = fData->fCqes[head & fData->fCqMask];
+        if(cqe.user_data == kRecvTag && !(cqe.flags & IORING_CQE_F_MORE))
+        {
+          fData->fIsArmed = false;
+        }
+      }
+      __atomic_store_n(fData->fCqHead, head, __ATOMIC_RELEASE);
+    }
+  }
+}
+
+/******************************************************************************/
+size_t IOUring::recvFromBatch(DatagramBatch & batch, bool wait)
+{
+  Data & data = *fData;
+  std::unique_lock<std::mutex> lock(data.fMutex);
+  batch.clear();
+
+  bool isWoken = false;
+  for(;;)
+  {
+    /* Arm the receive again once the kernel ended it, i.e. after it ran out
+     * of buffers. The datagrams wait in the socket meanwhile. */
+    if(!data.fIsArmed)
+    {
+      data.armReceive(0, IOSQE_FIXED_FILE);
+    }
+
+    /* Only enter the kernel if there is something to submit, completions
+     * to run or completions that overflowed. */
+    const unsigned flags = __atomic_load_n(data.fSqFlags, __ATOMIC_ACQUIRE);
+    if(data.fToSubmit > 0 ||
+       (flags & (IORING_SQ_TASKRUN | IORING_SQ_CQ_OVERFLOW)))
+    {
+      data.submit(0, IORING_ENTER_GETEVENTS);
+    }
+
+    /* Collect the completions, the ones that don't fit into the batch are
+     * left for the next call. */
+    unsigned head = *data.fCqHead;
+    const unsigned tail = __atomic_load_n(data.fCqTail, __ATOMIC_ACQUIRE);
+    for(; head != tail && !batch.full(); ++head)
+    {
+      const struct io_uring_cqe & cqe = data.fCqes[head & data.fCqMask];
+
+      /* A wake ends the receive even if nothing arrived. Successful sends
+       * post no completion, failed ones are dropped. */
+      if(cqe.user_data == kWakeTag)
+      {
+        isWoken = true;
+      }
+      if(cqe.user_data != kRecvTag)
+      {
+        continue;
+      }
+      if(!(cqe.flags & IORING_CQE_F_MORE))
+      {
+        data.fIsArmed = false;
+      }
+      if(cqe.res < 0 || !(cqe.flags & IORING_CQE_F_BUFFER))
+      {
+        continue;
+      }
+
+      /* The buffer starts with the lengths, then the address and then the
+       * payload, which is truncated to the buffer. */
+      const uint16_t bid = uint16_t(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+      const uint8_t * buf = data.fBuffers.get() + bid * data.fBufLen;
+      struct io_uring_recvmsg_out out;
+      memcpy(&out, buf, sizeof(out));
+      const uint8_t * name = buf + sizeof(out);
+      const uint8_t * payload = name + kNameLen;
+      batch.push(SocketAddress(name, std::min<size_t>(out.namelen, kNameLen)),
+                 payload, std::min<size_t>(out.payloadlen, data.fMaxPktLen));
+      data.recycle(bid);
+    }
+    __atomic_store_n(data.fCqHead, head, __ATOMIC_RELEASE);
+
+    if(batch.size() > 0 || !wait || isWoken)
+    {
+      break;
+    }
+    if(!data.fIsArmed)
+    {
+      continue;
+    }
+
+    /* Wait for a completion without blocking the sends. */
+    lock.unlock();
+    data.enter(0, 1, IORING_ENTER_GETEVENTS);
+    lock.lock();
+  }
+
+  return batch.size();
+}
+
+/******************************************************************************/
+size_t IOUring::sendToBatch(const DatagramBatch & batch)
+{
+  Data & data = *fData;
+  std::lock_guard<std::mutex> lock(data.fMutex);
+  assert(batch.size() <= data.fSendHdrs.size() &&
+         "The batch is larger than the ring's batch size.");
+
+  const size_t count = std::min(batch.size(), data.fSendHdrs.size());
+  for(size_t i = 0; i < count; i++)
+  {
+    data.fSendAddrs[i] = batch.address(i);
+    data.fSendVecs[i].iov_base = const_cast<uint8_t*>(batch.data(i));
+    data.fSendVecs[i].iov_len = batch.length(i);
+    data.fSendHdrs[i].msg_name =
+      const_cast<uint8_t*>(data.fSendAddrs[i].addrData());
+    data.fSendHdrs[i].msg_namelen =
+      socklen_t(data.fSendAddrs[i].addrDataLen());
+
+    /* Not waiting for buffer space finishes the send during the submit. */
+    struct io_uring_sqe * sqe = data.getSqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = 0;
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_CQE_SKIP_SUCCESS;
+    sqe->addr = uint64_t(uintptr_t(&data.fSendHdrs[i]));
+    sqe->len = 1;
+    sqe->msg_flags = MSG_DONTWAIT;
+    sqe->user_data = kSendTag;
+  }
+
+  /* The batch is reused once this returns, thus everything is submitted. */
+  while(data.fToSubmit > 0)
+  {
+    if(data.submit() < 0)
+    {
+      ANUBIS_THROW_RUNTIME_EXCEPTION("io_uring_enter() failed with error "
+                                     "code: " << errno);
+    }
+  }
+
+  /* Drop the completions of failed sends at the head, the receives are left
+   * for the receiving thread. */
+  unsigned head = *data.fCqHead;
+  const unsigned tail = __atomic_load_n(data.fCqTail, __ATOMIC_ACQUIRE);
+  while(head != tail && data.fCqes[head & data.fCqMask].user_data == kSendTag)
+  {
+    ++head;
+  }
+  __atomic_store_n(data.fCqHead, head, __ATOMIC_RELEASE);
+
+  return count;
+}
+
+/******************************************************************************/
+void IOUring::wake()
+{
+  /* A no-op posts a completion that the receiving thread is waiting for. */
+  Data & data = *fData;
+  std::lock_guard<std::mutex> lock(data.fMutex);
+  struct io_uring_sqe * sqe = data.getSqe();
+  sqe->opcode = IORING_OP_NOP;
+  sqe->user_data = kWakeTag;
+  while(data.fToSubmit > 0)
+  {
+    if(data.submit() < 0)
+    {
+      ANUBIS_THROW_RUNTIME_EXCEPTION("io_uring_enter() failed with error "
+                                     "code: " << errno);
+    }
+  }
+}
+
+/******************************************************************************/
+size_t IOUring::getSysCalls() const
+{
+  return fData->fSysCalls;
+}
+
+#else
+
+/******************************************************************************/
+struct IOUring::Data final
+{
+};
+
+/******************************************************************************/
+IOUring::IOUring(std::unique_ptr<Data> & data) : fData(std::move(data))
+{
+}
+
+/******************************************************************************/
+bool IOUring::isSupported()
+{
+  return false;
+}
+
+/******************************************************************************/
+std::unique_ptr<IOUring> IOUring::create(Socket &, size_t, size_t)
+{
+  return nullptr;
+}
+
+/******************************************************************************/
+IOUring::~IOUring() = default;
+
+/******************************************************************************/
+size_t IOUring::recvFromBatch(DatagramBatch &, bool)
+{
+  return 0;
+}
+
+/******************************************************************************/
+size_t IOUring::sendToBatch(const DatagramBatch &)
+{
+  return 0;
+}
+
+/******************************************************************************/
+void IOUring::wake()
+{
+}
+
+/******************************************************************************/
+size_t IOUring::getSysCalls() const
+{
+  return 0;
+}
+
+#endif /* ANUBIS_HAS_IO_URING */
@@ -0,0 +1,106 @@
+#include "../../../Include/Anubis/Networking/PacketPool.hpp"
+
+using namespace Anubis::Networking;
+
+/******************************************************************************/
+void PacketPool::Packet::reset()
+{
+  /* The last handle returns the buffer to it's pool. */
+  if(fHeader && fHeader->fRefs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+  {
+    fHeader->fPool->release(fHeader);
+  }
+  fHeader = nullptr;
+}
+
+/******************************************************************************/
+size_t PacketPool::Packet::capacity() const
+{
+  return fHeader ? fHeader->fPool->kBufferLen : 0;
+}
+
+/******************************************************************************/
+PacketPool::PacketPool(size_t bufferLen, size_t slabCount) :
+  kBufferLen(bufferLen),
+  kStride((sizeof(Header) + bufferLen + alignof(std::max_align_t) - 1) /
+          alignof(std::max_align_t) * alignof(std::max_align_t)),
+  kSlabCount(std::max<size_t>(slabCount, 1)), fFreeList(nullptr), fCount(0)
+{
+}
+
+/******************************************************************************/
+PacketPool::~PacketPool()
+{
+  assert(fCount == 0 && "Packets outlived their pool.");
+}
+
+/******************************************************************************/
+void PacketPool::grow()
+{
+  fSlabs.push_back(std::unique_ptr<uint8_t[]>(
+    new uint8_t[kSlabCount * kStride]));
+
+  /* Link the buffers in reverse, so they are handed out in address order. */
+  uint8_t * slab = fSlabs.back().get();
+  for(size_t i = kSlabCount; i-- > 0;)
+  {
+    Header * header = new (slab + i * kStride) Header();
+    header->fPool = this;
+    header->fNext = fFreeList;
+    fFreeList = header;
+  }
+}
+
+/******************************************************************************/
+void PacketPool::release(Header * header)
+{
+  std::lock_guard<std::mutex> lock(fMutex);
+  header->fNext = fFreeList;
+  fFreeList = header;
+  --fCount;
+}
+
+/******************************************************************************/
+void PacketPool::reserve(size_t count)
+{
+  std::lock_guard<std::mutex> lock(fMutex);
+  while(fSlabs.size() * kSlabCount < count)
+  {
+    grow();
+  }
+}
+
+/******************************************************************************/
+PacketPool::Packet PacketPool::acquire()
+{
+  Header * header;
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    if(fFreeList == nullptr)
+    {
+      grow();
+    }
+    header = fFreeList;
+    fFreeList = header->fNext;
+    ++fCount;
+  }
+
+  /* The handle owns the only reference. */
+  header->fRefs.store(1, std::memory_order_relaxed);
+  header->fLen = 0;
+  return Packet(header);
+}
+
+/******************************************************************************/
+size_t PacketPool::size()
+{
+  std::lock_guard<std::mutex> lock(fMutex);
+  return fCount;
+}
+
+/******************************************************************************/
+size_t PacketPool::capacity()
+{
+  std::lock_guard<std::mutex> lock(fMutex);
+  return fSlabs.size() * kSlabCount;
+}
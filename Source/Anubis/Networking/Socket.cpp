@@ -3,6 +3,29 @@
 
 using namespace Anubis::Networking;
 
+/* Linux can move a whole batch of datagrams with one system call. */
+#if ANUBIS_OS == ANUBIS_OS_UNIX && defined(__linux__)
+  #define ANUBIS_HAS_MMSG
+#endif /* ANUBIS_OS == ANUBIS_OS_UNIX && __linux__ */
+
+/******************************************************************************/
+struct DatagramBatch::Data final
+{
+  /** The addresses of the peers. */
+  std::vector<struct sockaddr_storage> fAddrs;
+
+  /** The lengths of the addresses. */
+  std::vector<socklen_t> fAddrLens;
+
+  #ifdef ANUBIS_HAS_MMSG
+    /** The message headers, they point at the addresses and vectors. */
+    std::vector<struct mmsghdr> fHeaders;
+
+    /** The IO vectors, they point at the payloads. */
+    std::vector<struct iovec> fVectors;
+  #endif /* ANUBIS_HAS_MMSG */
+};
+
 /******************************************************************************/
 struct Socket::Data final
 {
@@ -114,6 +137,201 @@ int Socket::Data::getSocketErrorCode()
   #endif
 }
 
+/******************************************************************************/
+/* Return true if the error code means that the operation would block. */
+static bool isWouldBlock(int code)
+{
+  #if ANUBIS_OS == ANUBIS_OS_WINDOWS
+    return code == WSAEWOULDBLOCK;
+  #elif ANUBIS_OS == ANUBIS_OS_UNIX || ANUBIS_OS == ANUBIS_OS_OSX
+    return code == EAGAIN || code == EWOULDBLOCK;
+  #endif
+}
+
+/******************************************************************************/
+/* Return true if the error code means that a signal interrupted the call. */
+static bool isInterrupted(int code)
+{
+  #if ANUBIS_OS == ANUBIS_OS_WINDOWS
+    return code == WSAEINTR;
+  #elif ANUBIS_OS == ANUBIS_OS_UNIX || ANUBIS_OS == ANUBIS_OS_OSX
+    return code == EINTR;
+  #endif
+}
+
+/******************************************************************************/
+/* Return true if the error code means that a datagram's peer can't be sent
+ * to, while the socket itself is fine. */
+static bool isUnreachable(int code)
+{
+  #if ANUBIS_OS == ANUBIS_OS_WINDOWS
+    return code == WSAEHOSTUNREACH || code == WSAENETUNREACH ||
+           code == WSAEACCES || code == WSAEINVAL || code == WSAEADDRNOTAVAIL;
+  #elif ANUBIS_OS == ANUBIS_OS_UNIX || ANUBIS_OS == ANUBIS_OS_OSX
+    return code == EHOSTUNREACH || code == ENETUNREACH || code == EACCES ||
+           code == EINVAL || code == EPERM || code == EADDRNOTAVAIL;
+  #endif
+}
+
+/******************************************************************************/
+/* The platform's scatter / gather vector. */
+#if ANUBIS_OS == ANUBIS_OS_WINDOWS
+  typedef WSABUF IOVector;
+#elif ANUBIS_OS == ANUBIS_OS_UNIX || ANUBIS_OS == ANUBIS_OS_OSX
+  typedef struct iovec IOVector;
+#endif
+
+/******************************************************************************/
+/* Point a vector at a range of bytes. */
+static void setVector(IOVector & vector, const uint8_t * data, size_t len)
+{
+  #if ANUBIS_OS == ANUBIS_OS_WINDOWS
+    vector.buf = reinterpret_cast<CHAR*>(const_cast<uint8_t*>(data));
+    vector.len = ULONG(len);
+  #elif ANUBIS_OS == ANUBIS_OS_UNIX || ANUBIS_OS == ANUBIS_OS_OSX
+    vector.iov_base = const_cast<uint8_t*>(data);
+    vector.iov_len = len;
+  #endif
+}
+
+/******************************************************************************/
+/* Move all the bytes of a list of buffers through a stream socket. The io
+ * function is called with up to kMaxBuffers vectors and returns the number
+ * of bytes it moved, 0 if the connection was closed. The vectors are
+ * rebuilt after a partial transfer, so the buffers are never copied. */
+template <typename Buffer, typename IOFunc>
+static bool transferAll(const Buffer * buffers, size_t count, IOFunc && io)
+{
+  /* The first buffer that is not done and the bytes of it that are. */
+  size_t index = 0;
+  size_t offset = 0;
+  while(true)
+  {
+    /* Skip the finished buffers. */
+    while(index < count && offset == buffers[index].fLen)
+    {
+      ++index;
+      offset = 0;
+    }
+    if(index == count)
+    {
+      return true;
+    }
+
+    /* Gather the rest of the buffers. */
+    IOVector vectors[Socket::kMaxBuffers];
+    size_t size = 0;
+    for(size_t i = index; i < count && size < Socket::kMaxBuffers; i++)
+    {
+      const size_t skip = i == index ? offset : 0;
+      if(buffers[i].fLen > skip)
+      {
+        setVector(vectors[size++], buffers[i].fData + skip,
+                  buffers[i].fLen - skip);
+      }
+    }
+
+    /* Move as many bytes as possible. */
+    long result = io(vectors, size);
+    if(result == 0)
+    {
+      return false;
+    }
+
+    /* Advance past the bytes that were moved. */
+    for(size_t moved = size_t(result); moved > 0;)
+    {
+      const size_t left = buffers[index].fLen - offset;
+      if(moved >= left)
+      {
+        moved -= left;
+        ++index;
+        offset = 0;
+      }
+      else
+      {
+        offset += moved;
+        moved = 0;
+      }
+    }
+  }
+}
+
+/******************************************************************************/
+DatagramBatch::DatagramBatch(PacketPool & pool, size_t capacity) :
+  fData(std::make_unique<Data>()), fPool(pool), kCapacity(capacity),
+  fCount(0), fPackets(capacity)
+{
+  fData->fAddrs.resize(kCapacity);
+  fData->fAddrLens.resize(kCapacity, 0);
+
+  #ifdef ANUBIS_HAS_MMSG
+    /* Point the headers at the addresses and vectors once, only the packets
+     * and lengths change between calls. */
+    fData->fHeaders.resize(kCapacity);
+    fData->fVectors.resize(kCapacity);
+    memset(fData->fHeaders.data(), 0, kCapacity * sizeof(struct mmsghdr));
+    for(size_t i = 0; i < kCapacity; i++)
+    {
+      fData->fHeaders[i].msg_hdr.msg_name = &fData->fAddrs[i];
+      fData->fHeaders[i].msg_hdr.msg_iov = &fData->fVectors[i];
+      fData->fHeaders[i].msg_hdr.msg_iovlen = 1;
+    }
+  #endif /* ANUBIS_HAS_MMSG */
+}
+
+/******************************************************************************/
+DatagramBatch::~DatagramBatch() = default;
+
+/******************************************************************************/
+IPEndPoint DatagramBatch::endPoint(size_t index) const
+{
+  return IPEndPoint(&fData->fAddrs[index], fData->fAddrLens[index]);
+}
+
+/******************************************************************************/
+SocketAddress DatagramBatch::address(size_t index) const
+{
+  return SocketAddress(&fData->fAddrs[index], fData->fAddrLens[index]);
+}
+
+/******************************************************************************/
+bool DatagramBatch::push(const SocketAddress & ep, const uint8_t * data,
+                         size_t len)
+{
+  /* Check that the datagram fits. */
+  if(full() || len > fPool.getBufferLen())
+  {
+    return false;
+  }
+
+  /* Copy the payload into the slot's packet. */
+  PacketPool::Packet & packet = writable(fCount);
+  memcpy(packet.data(), data, len);
+  packet.resize(len);
+  return push(ep, packet);
+}
+
+/******************************************************************************/
+bool DatagramBatch::push(const SocketAddress & ep,
+                         const PacketPool::Packet & packet)
+{
+  if(full())
+  {
+    return false;
+  }
+
+  /* Refer to the packet and copy the address. */
+  if(&fPackets[fCount] != &packet)
+  {
+    fPackets[fCount] = packet;
+  }
+  memcpy(&fData->fAddrs[fCount], ep.addrData(), ep.addrDataLen());
+  fData->fAddrLens[fCount] = socklen_t(ep.addrDataLen());
+  ++fCount;
+  return true;
+}
+
 /******************************************************************************/
 Socket::Socket(std::unique_ptr<Data> & data)
 {
@@ -121,6 +339,12 @@ Socket::Socket(std::unique_ptr<Data> & data)
   fData = std::move(data);
 }
 
+/******************************************************************************/
+intptr_t Socket::getHandle() const
+{
+  return intptr_t(fData->fHandle);
+}
+
 /******************************************************************************/
 Socket::Socket(Types type, Versions version)
 {
@@ -158,7 +382,7 @@ IPEndPoint Socket::getEP() const
   struct sockaddr_storage addrData;
 
   /* The length of the address. */
-  socklen_t addrLen = 0;
+  socklen_t addrLen = sizeof(struct sockaddr_storage);
 
   /* Read the socket's address information. */
   if(getsockname(fData->fHandle,
@@ -228,41 +452,34 @@ void Socket::shutdown()
 }
 
 /******************************************************************************/
-bool Socket::send(const std::vector<uint8_t> & data)
+void Socket::shutdownRecv()
 {
-  /* The number of bytes that were sent. */
-  size_t bytesSent = 0;
+  #if ANUBIS_OS == ANUBIS_OS_WINDOWS
+    int how = SD_RECEIVE;
+  #elif ANUBIS_OS == ANUBIS_OS_UNIX || ANUBIS_OS == ANUBIS_OS_OSX
+    int how = SHUT_RD;
+  #endif
 
-  /* Keep looping until all bytes are sent. */
-  while(bytesSent != data.size())
+  /* Unconnected UDP sockets report ENOTCONN, but are shutdown anyway. */
+  if(::shutdown(fData->fHandle, how) != 0)
   {
-    /* Send as many bytes as possible. */
-    int result = ::send(fData->fHandle,
-                        reinterpret_cast<const char*>(data.data() + bytesSent),
-                        data.size() - bytesSent, 0);
-
-    /* Check if the bytes were sent. */
-    if(result > 0)
-    {
-      /* Increment the number of bytes sent. */
-      bytesSent += result;
-    }
-    /* Check if the connection was closed. */
-    else if(result == 0)
-    {
-      /* Return false to indicate that the connection was closed. */
-      return false;
-    }
-    /* Otherwise an error occured. */
-    else
+    const int code = Socket::Data::getSocketErrorCode();
+    #if ANUBIS_OS == ANUBIS_OS_WINDOWS
+      if(code != WSAENOTCONN)
+    #else
+      if(code != ENOTCONN)
+    #endif
     {
-      ANUBIS_THROW_RUNTIME_EXCEPTION("send() failed with error code: " <<
-                                     Socket::Data::getSocketErrorCode());
+      ANUBIS_THROW_RUNTIME_EXCEPTION("shutdown() failed with error code: " <<
+                                     code);
     }
   }
+}
 
-  /* Return the number of bytes sent. */
-  return bytesSent;
+/******************************************************************************/
+bool Socket::send(const std::vector<uint8_t> & data)
+{
+  return send(data.data(), data.size());
 }
 
 /******************************************************************************/
@@ -271,114 +488,259 @@ bool Socket::recv(std::vector<uint8_t> & data, size_t len)
   /* Resize the buffer based on what was expected to be read. */
   data.resize(len);
 
-  /* Read the bytes. */
-  size_t bytesRead = 0;
+  /* Read straight into the vector. */
+  return recv(data.data(), len);
+}
 
-  /* Keep reading until all the requested data is read. */
-  while(bytesRead != len)
-  {
-    /* Perform a read. */
-    int result = ::recv(fData->fHandle,
-                        reinterpret_cast<char*>(data.data() + bytesRead),
-                        len - bytesRead, 0);
-
-    /* Check if an error occured. */
-    /* Check if data was read. */
-    if(result > 0)
-    {
-      /* Increment the bytes read counter. */
-      bytesRead += result;
-    }
-    /* Check if the socket was closed. */
-    else if(result == 0)
-    {
-      /* Retur false to indicate that the socket was closed. */
-      return false;
-    }
-    /* Else and error occured. */
-    else
-    {
-      ANUBIS_THROW_RUNTIME_EXCEPTION("recv() failed with error code: " <<
-                                     Socket::Data::getSocketErrorCode());
-    }
-  }
+/******************************************************************************/
+bool Socket::send(const uint8_t * data, size_t len)
+{
+  const ConstBuffer buffer(data, len);
+  return send(&buffer, 1);
+}
 
-  /* Resize the buffer based on what was read. This should only every be
-   * called when the socket has been shutdown during a read, at which point
-   * the bytesRead is expected to be 0. */
-  data.resize(bytesRead);
+/******************************************************************************/
+bool Socket::recv(uint8_t * data, size_t len)
+{
+  const MutableBuffer buffer(data, len);
+  return recv(&buffer, 1);
+}
 
-  /* Return true to indicate that the data was read. */
-  return true;
+/******************************************************************************/
+bool Socket::send(const ConstBuffer * buffers, size_t count)
+{
+  return transferAll(buffers, count, [this](IOVector * vectors, size_t size)
+  {
+    #if ANUBIS_OS == ANUBIS_OS_WINDOWS
+      DWORD bytesSent = 0;
+      if(WSASend(fData->fHandle, vectors, DWORD(size), &bytesSent, 0, nullptr,
+                 nullptr) != 0)
+      {
+        ANUBIS_THROW_RUNTIME_EXCEPTION("WSASend() failed with error code: " <<
+                                       Socket::Data::getSocketErrorCode());
+      }
+      return long(bytesSent);
+    #elif ANUBIS_OS == ANUBIS_OS_UNIX || ANUBIS_OS == ANUBIS_OS_OSX
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = vectors;
+      msg.msg_iovlen = size;
+      ssize_t result = sendmsg(fData->fHandle, &msg, 0);
+      if(result < 0)
+      {
+        ANUBIS_THROW_RUNTIME_EXCEPTION("sendmsg() failed with error code: " <<
+                                       Socket::Data::getSocketErrorCode());
+      }
+      return long(result);
+    #endif
+  });
+}
+
+/******************************************************************************/
+bool Socket::recv(const MutableBuffer * buffers, size_t count)
+{
+  return transferAll(buffers, count, [this](IOVector * vectors, size_t size)
+  {
+    #if ANUBIS_OS == ANUBIS_OS_WINDOWS
+      DWORD bytesRead = 0;
+      DWORD flags = 0;
+      if(WSARecv(fData->fHandle, vectors, DWORD(size), &bytesRead, &flags,
+                 nullptr, nullptr) != 0)
+      {
+        ANUBIS_THROW_RUNTIME_EXCEPTION("WSARecv() failed with error code: " <<
+                                       Socket::Data::getSocketErrorCode());
+      }
+      return long(bytesRead);
+    #elif ANUBIS_OS == ANUBIS_OS_UNIX || ANUBIS_OS == ANUBIS_OS_OSX
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = vectors;
+      msg.msg_iovlen = size;
+      ssize_t result = recvmsg(fData->fHandle, &msg, 0);
+      if(result < 0)
+      {
+        ANUBIS_THROW_RUNTIME_EXCEPTION("recvmsg() failed with error code: " <<
+                                       Socket::Data::getSocketErrorCode());
+      }
+      return long(result);
+    #endif
+  });
 }
 
 /******************************************************************************/
 bool Socket::sendTo(const IPEndPoint & ep, const std::vector<uint8_t> & data)
 {
-  /* The number of bytes that were sent. */
-  size_t bytesSent = 0;
+  return sendTo(ep, data.data(), data.size());
+}
 
-  /* Keep looping until all bytes are sent. */
-  while(bytesSent != data.size())
+/******************************************************************************/
+bool Socket::sendTo(const SocketAddress & addr,
+                    const PacketPool::Packet & packet)
+{
+  const ConstBuffer buffer(packet);
+  return sendTo(addr, &buffer, 1);
+}
+
+/******************************************************************************/
+bool Socket::sendTo(const SocketAddress & addr, const uint8_t * data,
+                    size_t len)
+{
+  const ConstBuffer buffer(data, len);
+  return sendTo(addr, &buffer, 1);
+}
+
+/******************************************************************************/
+bool Socket::sendTo(const SocketAddress & addr, const ConstBuffer * buffers,
+                    size_t count)
+{
+  /* A datagram must be sent with a single call. */
+  if(count > kMaxBuffers)
   {
-    /* Send as many bytes as possible. */
-    int result = sendto(fData->fHandle,
-                        reinterpret_cast<const char*>(data.data() + bytesSent),
-                        data.size() - bytesSent, 0,
-                        reinterpret_cast<const struct sockaddr*>(ep.addrData()),
-                        ep.addrDataLen());
-
-    /* Check if some bytes were sent. */
-    if(result > 0)
-    {
-      /* Increment the bytes sent. */
-      bytesSent += result;
-    }
-    /* Else check if the socket was shutdown. */
-    else if(result == 0)
-    {
-      /* Return false to indicate that the socket was shut down. */
-      return false;
-    }
-    /* Else an error occured. */
-    else
-    {
-      ANUBIS_THROW_RUNTIME_EXCEPTION("sendto() failed with error code: " <<
-                                     Socket::Data::getSocketErrorCode());
-    }
+    ANUBIS_THROW_RUNTIME_EXCEPTION("A datagram can't be gathered from " <<
+                                   count << " buffers, the maximum is " <<
+                                   kMaxBuffers << ".");
+  }
+  IOVector vectors[kMaxBuffers];
+  size_t len = 0;
+  for(size_t i = 0; i < count; i++)
+  {
+    setVector(vectors[i], buffers[i].fData, buffers[i].fLen);
+    len += buffers[i].fLen;
   }
 
-  /* Return true to indicate that the data was sent. */
-  return true;
+  /* Send the datagram. */
+  #if ANUBIS_OS == ANUBIS_OS_WINDOWS
+    DWORD bytesSent = 0;
+    int result = WSASendTo(fData->fHandle, vectors, DWORD(count), &bytesSent,
+                           0, reinterpret_cast<const struct sockaddr*>(
+                             addr.addrData()), int(addr.addrDataLen()),
+                           nullptr, nullptr) == 0 ? int(bytesSent) : -1;
+  #elif ANUBIS_OS == ANUBIS_OS_UNIX || ANUBIS_OS == ANUBIS_OS_OSX
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = const_cast<uint8_t*>(addr.addrData());
+    msg.msg_namelen = socklen_t(addr.addrDataLen());
+    msg.msg_iov = vectors;
+    msg.msg_iovlen = count;
+    ssize_t result = sendmsg(fData->fHandle, &msg, 0);
+  #endif
+
+  /* Check if an error occured. */
+  if(result < 0)
+  {
+    ANUBIS_THROW_RUNTIME_EXCEPTION("sendto() failed with error code: " <<
+                                   Socket::Data::getSocketErrorCode());
+  }
+
+  /* Return false if the socket was shutdown. */
+  return result > 0 || len == 0;
 }
 
 /******************************************************************************/
 bool Socket::recvFrom(IPEndPoint & ep, std::vector<uint8_t> & data,
                       size_t maxLen)
 {
+  /* Resize the buffer based on what was expected to be read. */
+  data.resize(maxLen);
+
+  /* Read the datagram and shrink the vector to it's length. */
+  size_t len = 0;
+  const bool result = recvFrom(ep, data.data(), maxLen, len);
+  data.resize(len);
+  return result;
+}
+
+/******************************************************************************/
+bool Socket::recvFrom(IPEndPoint & ep, PacketPool::Packet & packet)
+{
+  /* Read the bytes straight into the packet's buffer. */
+  size_t len = 0;
+  const bool result = recvFrom(ep, packet.data(), packet.capacity(), len);
+  packet.resize(len);
+  return result;
+}
+
+/******************************************************************************/
+bool Socket::recvFrom(IPEndPoint & ep, uint8_t * data, size_t maxLen,
+                      size_t & len)
+{
+  const MutableBuffer buffer(data, maxLen);
+  return recvFrom(ep, &buffer, 1, len);
+}
+
+/******************************************************************************/
+bool Socket::recvFrom(IPEndPoint & ep, const MutableBuffer * buffers,
+                      size_t count, size_t & len)
+{
+  /* Only build the end point if a datagram was recieved. */
+  SocketAddress addr;
+  const bool result = recvFrom(addr, buffers, count, len);
+  if(result)
+  {
+    ep = addr.toEndPoint();
+  }
+  return result;
+}
+
+/******************************************************************************/
+bool Socket::recvFrom(SocketAddress & addr, PacketPool::Packet & packet)
+{
+  /* Read the bytes straight into the packet's buffer. */
+  const MutableBuffer buffer(packet.data(), packet.capacity());
+  size_t len = 0;
+  const bool result = recvFrom(addr, &buffer, 1, len);
+  packet.resize(len);
+  return result;
+}
+
+/******************************************************************************/
+bool Socket::recvFrom(SocketAddress & addr, const MutableBuffer * buffers,
+                      size_t count, size_t & len)
+{
+  /* A datagram must be recieved with a single call. */
+  if(count > kMaxBuffers)
+  {
+    ANUBIS_THROW_RUNTIME_EXCEPTION("A datagram can't be scattered over " <<
+                                   count << " buffers, the maximum is " <<
+                                   kMaxBuffers << ".");
+  }
+  IOVector vectors[kMaxBuffers];
+  for(size_t i = 0; i < count; i++)
+  {
+    setVector(vectors[i], buffers[i].fData, buffers[i].fLen);
+  }
+
   /* A location to store the socket address. */
   struct sockaddr_storage addrData;
 
   /* The length of the address. */
   socklen_t addrDataLen = sizeof(struct sockaddr_storage);
 
-  /* Resize the buffer based on what was expected to be read. */
-  data.resize(maxLen);
-
-  /* Read the bytes. */
-  int result = recvfrom(fData->fHandle,
-                        reinterpret_cast<char*>(data.data()), data.size(), 0,
-                        reinterpret_cast<struct sockaddr*>(&addrData),
-                        &addrDataLen);
+  /* Read the datagram. */
+  #if ANUBIS_OS == ANUBIS_OS_WINDOWS
+    DWORD bytesRead = 0;
+    DWORD flags = 0;
+    int result = WSARecvFrom(fData->fHandle, vectors, DWORD(count), &bytesRead,
+                             &flags, reinterpret_cast<struct sockaddr*>(
+                               &addrData), &addrDataLen, nullptr, nullptr) == 0 ?
+                 int(bytesRead) : -1;
+  #elif ANUBIS_OS == ANUBIS_OS_UNIX || ANUBIS_OS == ANUBIS_OS_OSX
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &addrData;
+    msg.msg_namelen = addrDataLen;
+    msg.msg_iov = vectors;
+    msg.msg_iovlen = count;
+    ssize_t result = recvmsg(fData->fHandle, &msg, 0);
+    addrDataLen = msg.msg_namelen;
+  #endif
 
   /* Check if the packet was read. */
   if(result > 0)
   {
-    /* Resize the vector. */
-    data.resize(result);
-
-    /* Set the EP where the data came from. */
-    ep = IPEndPoint(&addrData, addrDataLen);
+    /* Set the length and the address where the data came from. */
+    len = size_t(result);
+    addr = SocketAddress(&addrData, addrDataLen);
 
     /* Return true to indicate that the datagram was read. */
     return true;
@@ -387,6 +749,7 @@ bool Socket::recvFrom(IPEndPoint & ep, std::vector<uint8_t> & data,
   else if(result == 0)
   {
     /* Return false to indicate the shutdown. */
+    len = 0;
     return false;
   }
 
@@ -394,3 +757,184 @@ bool Socket::recvFrom(IPEndPoint & ep, std::vector<uint8_t> & data,
   ANUBIS_THROW_RUNTIME_EXCEPTION("recvfrom() failed with result: " << result
     << ", error code: " << Socket::Data::getSocketErrorCode() << ".");
 }
+
+/******************************************************************************/
+size_t Socket::recvFromBatch(DatagramBatch & batch, bool wait)
+{
+  DatagramBatch::Data & data = *batch.fData;
+  batch.clear();
+
+  #ifdef ANUBIS_HAS_MMSG
+    /* Receive into packets that nobody else refers too. */
+    for(size_t i = 0; i < batch.kCapacity; i++)
+    {
+      PacketPool::Packet & packet = batch.writable(i);
+      data.fVectors[i].iov_base = packet.data();
+      data.fVectors[i].iov_len = packet.capacity();
+      data.fHeaders[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+    }
+
+    /* Receive as many datagrams as are queued, after waiting for the first
+     * one if requested. */
+    int result;
+    do
+    {
+      result = recvmmsg(fData->fHandle, data.fHeaders.data(),
+                        unsigned(batch.kCapacity),
+                        wait ? MSG_WAITFORONE : MSG_DONTWAIT, nullptr);
+    }
+    while(result < 0 && isInterrupted(Socket::Data::getSocketErrorCode()));
+
+    if(result < 0)
+    {
+      const int code = Socket::Data::getSocketErrorCode();
+      if(isWouldBlock(code))
+      {
+        return 0;
+      }
+      ANUBIS_THROW_RUNTIME_EXCEPTION("recvmmsg() failed with error code: " <<
+                                     code);
+    }
+
+    for(int i = 0; i < result; i++)
+    {
+      batch.fPackets[i].resize(data.fHeaders[i].msg_len);
+      data.fAddrLens[i] = data.fHeaders[i].msg_hdr.msg_namelen;
+    }
+    batch.fCount = size_t(result);
+  #else
+    /* Receive one datagram per call, only the first call may block. */
+    int flags = 0;
+    #ifdef MSG_DONTWAIT
+      if(!wait)
+      {
+        flags = MSG_DONTWAIT;
+      }
+    #endif /* MSG_DONTWAIT */
+    while(!batch.full())
+    {
+      const size_t i = batch.fCount;
+      PacketPool::Packet & packet = batch.writable(i);
+      data.fAddrLens[i] = sizeof(struct sockaddr_storage);
+      int result = recvfrom(fData->fHandle,
+                            reinterpret_cast<char*>(packet.data()),
+                            int(packet.capacity()), flags,
+                            reinterpret_cast<struct sockaddr*>(&data.fAddrs[i]),
+                            &data.fAddrLens[i]);
+      if(result < 0)
+      {
+        const int code = Socket::Data::getSocketErrorCode();
+        if(isInterrupted(code))
+        {
+          continue;
+        }
+        if(isWouldBlock(code))
+        {
+          break;
+        }
+        ANUBIS_THROW_RUNTIME_EXCEPTION("recvfrom() failed with error code: "
+                                       << code);
+      }
+      packet.resize(size_t(result));
+      ++batch.fCount;
+
+      #ifdef MSG_DONTWAIT
+        flags = MSG_DONTWAIT;
+      #else
+        break;
+      #endif /* MSG_DONTWAIT */
+    }
+  #endif /* ANUBIS_HAS_MMSG */
+
+  return batch.fCount;
+}
+
+/******************************************************************************/
+size_t Socket::sendToBatch(const DatagramBatch & batch)
+{
+  DatagramBatch::Data & data = *batch.fData;
+  size_t sent = 0;
+
+  #ifdef ANUBIS_HAS_MMSG
+    /* Point the vectors at the packets. */
+    for(size_t i = 0; i < batch.fCount; i++)
+    {
+      data.fVectors[i].iov_base = const_cast<uint8_t*>(batch.data(i));
+      data.fVectors[i].iov_len = batch.length(i);
+      data.fHeaders[i].msg_hdr.msg_namelen = data.fAddrLens[i];
+    }
+
+    /* The kernel may send fewer datagrams than requested, it stops at the
+     * first one that fails. */
+    size_t next = 0;
+    while(next < batch.fCount)
+    {
+      int result = sendmmsg(fData->fHandle, data.fHeaders.data() + next,
+                            unsigned(batch.fCount - next), 0);
+      if(result < 0)
+      {
+        const int code = Socket::Data::getSocketErrorCode();
+        if(isInterrupted(code))
+        {
+          continue;
+        }
+        if(isWouldBlock(code))
+        {
+          break;
+        }
+        if(!isUnreachable(code))
+        {
+          ANUBIS_THROW_RUNTIME_EXCEPTION("sendmmsg() failed with error "
+                                         "code: " << code);
+        }
+
+        /* Drop the datagram like any other lost one and send the rest. */
+        ANUBIS_LOG_WARN("Dropped a datagram, sendmmsg() failed with error "
+                        "code: " << code);
+        ++next;
+        continue;
+      }
+      next += size_t(result);
+      sent += size_t(result);
+    }
+  #else
+    /* Send one datagram per call. */
+    size_t next = 0;
+    while(next < batch.fCount)
+    {
+      int result = sendto(fData->fHandle,
+                          reinterpret_cast<const char*>(batch.data(next)),
+                          int(batch.length(next)), 0,
+                          reinterpret_cast<const struct sockaddr*>(
+                            &data.fAddrs[next]), data.fAddrLens[next]);
+      if(result < 0)
+      {
+        const int code = Socket::Data::getSocketErrorCode();
+        if(isInterrupted(code))
+        {
+          continue;
+        }
+        if(isWouldBlock(code))
+        {
+          break;
+        }
+        if(!isUnreachable(code))
+        {
+          ANUBIS_THROW_RUNTIME_EXCEPTION("sendto() failed with error code: "
+                                         << code);
+        }
+
+        /* Drop the datagram like any other lost one and send the rest. */
+        ANUBIS_LOG_WARN("Dropped a datagram, sendto() failed with error "
+                        "code: " << code);
+      }
+      else
+      {
+        ++sent;
+      }
+      ++next;
+    }
+  #endif /* ANUBIS_HAS_MMSG */
+
+  return sent;
+}
@@ -0,0 +1,68 @@
+#include "../../../Include/Anubis/Common/System.hpp"
+#include "../../../Include/Anubis/Networking/SocketAddress.hpp"
+
+using namespace Anubis::Networking;
+
+/* The storage must hold every supported address and be copyable as bytes. */
+static_assert(sizeof(struct sockaddr_in6) <= SocketAddress::kStorageLen,
+              "SocketAddress::kStorageLen is too small for an IPv6 address.");
+static_assert(std::is_trivially_copyable<SocketAddress>::value,
+              "SocketAddress must be trivially copyable.");
+
+/******************************************************************************/
+SocketAddress::SocketAddress(const void * addrData, size_t dataLen) :
+  fStorage(), fLen(0)
+{
+  /* Only copy the fields that identify the peer, so that equal addresses are
+   * equal bytes. */
+  const struct sockaddr * addr = static_cast<const struct sockaddr*>(addrData);
+  if(addr->sa_family == AF_INET && dataLen >= sizeof(struct sockaddr_in))
+  {
+    const struct sockaddr_in * src =
+      static_cast<const struct sockaddr_in*>(addrData);
+    struct sockaddr_in * dst = reinterpret_cast<struct sockaddr_in*>(fStorage);
+    dst->sin_family = AF_INET;
+    dst->sin_port = src->sin_port;
+    dst->sin_addr = src->sin_addr;
+    fLen = sizeof(struct sockaddr_in);
+  }
+  else if(addr->sa_family == AF_INET6 && dataLen >= sizeof(struct sockaddr_in6))
+  {
+    const struct sockaddr_in6 * src =
+      static_cast<const struct sockaddr_in6*>(addrData);
+    struct sockaddr_in6 * dst = reinterpret_cast<struct sockaddr_in6*>(fStorage);
+    dst->sin6_family = AF_INET6;
+    dst->sin6_port = src->sin6_port;
+    dst->sin6_addr = src->sin6_addr;
+    dst->sin6_scope_id = src->sin6_scope_id;
+    fLen = sizeof(struct sockaddr_in6);
+  }
+}
+
+/******************************************************************************/
+SocketAddress::SocketAddress(const IPEndPoint & ep) :
+  SocketAddress(ep.addrData(), ep.addrDataLen())
+{
+}
+
+/******************************************************************************/
+IPEndPoint SocketAddress::toEndPoint() const
+{
+  return IPEndPoint(const_cast<uint8_t*>(fStorage), fLen);
+}
+
+/******************************************************************************/
+bool SocketAddress::isIPv4() const
+{
+  return fLen != 0 &&
+         reinterpret_cast<const struct sockaddr*>(fStorage)->sa_family ==
+         AF_INET;
+}
+
+/******************************************************************************/
+bool SocketAddress::isIPv6() const
+{
+  return fLen != 0 &&
+         reinterpret_cast<const struct sockaddr*>(fStorage)->sa_family ==
+         AF_INET6;
+}
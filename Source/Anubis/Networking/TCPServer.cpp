@@ -1,34 +1,582 @@
+#include "../../../Include/Anubis/Common/System/SocketWrapper.hpp"
 #include "../../../Include/Anubis/Networking/TCPServer.hpp"
 
+/* The server waits for the readiness of it's sockets with epoll. */
+#if ANUBIS_OS == ANUBIS_OS_UNIX && defined(__linux__)
+  #define ANUBIS_HAS_EPOLL
+  #include <netinet/tcp.h>
+  #include <sys/epoll.h>
+  #include <sys/eventfd.h>
+  #include <unistd.h>
+#endif /* ANUBIS_OS == ANUBIS_OS_UNIX && __linux__ */
+
 using namespace Anubis::Networking;
 
+/* The size of every IO thread's receive buffer. */
+static const size_t kReadLen = 64 * 1024;
+
+/* The maximum number of events handled per wait. */
+static const int kMaxEvents = 256;
+
+/******************************************************************************/
+struct TCPServer::Worker final
+{
+  /** The epoll instance. */
+  int fEpoll;
+
+  /** The event that wakes the thread up to stop. */
+  int fWake;
+
+  /** The buffer that all the connections of the thread receive into. */
+  std::vector<uint8_t> fBuffer;
+
+  /** The thread. */
+  std::thread fThread;
+
+  /** Create a worker without handles. */
+  Worker() : fEpoll(-1), fWake(-1), fBuffer(kReadLen) {}
+};
+
+/******************************************************************************/
+struct TCPServer::Connection final
+{
+  /** The ID of the connection. */
+  ConnectionID fID;
+
+  /** The handle of the socket. */
+  int fHandle;
+
+  /** The address of the client. */
+  SocketAddress fPeer;
+
+  /** The IO thread that serves the connection. */
+  Worker * fWorker;
+
+  /** The received bytes that the data handler didn't consume yet, only
+   * touched by the connection's IO thread. */
+  std::vector<uint8_t> fRxBuffer;
+
+  /** The lock of the send buffer and the handle. */
+  std::mutex fMutex;
+
+  /** The bytes that the socket didn't take yet. */
+  std::vector<uint8_t> fTxBuffer;
+
+  /** The number of bytes of the send buffer that are already written. */
+  size_t fTxOffset;
+
+  /** Indicate if the connection was not closed yet. */
+  bool fIsOpen;
+
+  /** Create an open connection. */
+  Connection(ConnectionID id, int handle, const SocketAddress & peer,
+             Worker * worker) :
+    fID(id), fHandle(handle), fPeer(peer), fWorker(worker), fTxOffset(0),
+    fIsOpen(true) {}
+};
+
+#ifdef ANUBIS_HAS_EPOLL
+
+/******************************************************************************/
+static bool isWouldBlock(int code)
+{
+  return code == EAGAIN || code == EWOULDBLOCK;
+}
+
 /******************************************************************************/
-TCPServer::TCPServer(IPEndPoint localEP) :
+TCPServer::TCPServer(const IPEndPoint & localEP, ConnectHandler onConnect,
+                     DataHandler onData, DisconnectHandler onDisconnect,
+                     size_t ioThreads, size_t maxBuffered) :
+  fOnConnect(std::move(onConnect)), fOnData(std::move(onData)),
+  fOnDisconnect(std::move(onDisconnect)), kMaxBuffered(maxBuffered),
+  fListenHandle(-1), fLocalAddr(localEP), fNextID(1), fNextWorker(0),
   fIsExecuting(true)
 {
-  try
+  assert(fOnData && "The TCPServer requires a data handler.");
+  Anubis::System::startSocketLib();
+
+  /* Create the non-blocking listen socket and bind it. */
+  const struct sockaddr * addr =
+    reinterpret_cast<const struct sockaddr*>(fLocalAddr.addrData());
+  fListenHandle = socket(addr->sa_family,
+                         SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                         IPPROTO_TCP);
+  if(fListenHandle == INVALID_SOCKET)
+  {
+    ANUBIS_THROW_RUNTIME_EXCEPTION("socket() failed with error code: " <<
+                                   errno);
+  }
+
+  int reuse = 1;
+  setsockopt(fListenHandle, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  if(bind(fListenHandle, addr, socklen_t(fLocalAddr.addrDataLen())) != 0)
+  {
+    ANUBIS_THROW_RUNTIME_EXCEPTION("bind() failed with error code: " << errno);
+  }
+  if(::listen(fListenHandle, SOMAXCONN) != 0)
+  {
+    ANUBIS_THROW_RUNTIME_EXCEPTION("listen() failed with error code: " <<
+                                   errno);
+  }
+
+  /* Remember the bound address, i.e. the port picked for port 0. */
+  struct sockaddr_storage bound;
+  socklen_t boundLen = sizeof(bound);
+  if(getsockname(fListenHandle, reinterpret_cast<struct sockaddr*>(&bound),
+                 &boundLen) == 0)
+  {
+    fLocalAddr = SocketAddress(&bound, boundLen);
+  }
+
+  /* Create the epoll instances, every one with an event to wake it up. */
+  fWorkers.resize(std::max<size_t>(ioThreads, 1));
+  for(std::unique_ptr<Worker> & worker : fWorkers)
+  {
+    worker = std::make_unique<Worker>();
+    worker->fEpoll = epoll_create1(EPOLL_CLOEXEC);
+    worker->fWake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(worker->fEpoll < 0 || worker->fWake < 0)
+    {
+      ANUBIS_THROW_RUNTIME_EXCEPTION("epoll_create1() or eventfd() failed "
+                                     "with error code: " << errno);
+    }
+
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.ptr = worker.get();
+    epoll_ctl(worker->fEpoll, EPOLL_CTL_ADD, worker->fWake, &event);
+  }
+
+  /* The first IO thread accepts the connections, the listen socket is
+   * marked by a null pointer. */
+  struct epoll_event event = {};
+  event.events = EPOLLIN | EPOLLET;
+  event.data.ptr = nullptr;
+  if(epoll_ctl(fWorkers.front()->fEpoll, EPOLL_CTL_ADD, fListenHandle,
+               &event) != 0)
+  {
+    ANUBIS_THROW_RUNTIME_EXCEPTION("epoll_ctl() failed with error code: " <<
+                                   errno);
+  }
+
+  for(std::unique_ptr<Worker> & worker : fWorkers)
+  {
+    worker->fThread = std::thread(&TCPServer::run, this, std::ref(*worker));
+  }
+}
+
+/******************************************************************************/
+TCPServer::~TCPServer()
+{
+  /* Stop the IO threads. */
+  fIsExecuting = false;
+  for(std::unique_ptr<Worker> & worker : fWorkers)
+  {
+    uint64_t one = 1;
+    ssize_t written = write(worker->fWake, &one, sizeof(one));
+    (void)written;
+  }
+  for(std::unique_ptr<Worker> & worker : fWorkers)
+  {
+    if(worker->fThread.joinable())
+    {
+      worker->fThread.join();
+    }
+  }
+
+  /* Close all the connections, no handler is called anymore. */
+  for(auto & entry : fConnections)
+  {
+    std::lock_guard<std::mutex> lock(entry.second->fMutex);
+    entry.second->fIsOpen = false;
+    ::close(entry.second->fHandle);
+  }
+  fConnections.clear();
+
+  for(std::unique_ptr<Worker> & worker : fWorkers)
+  {
+    ::close(worker->fEpoll);
+    ::close(worker->fWake);
+  }
+  ::close(fListenHandle);
+  Anubis::System::stopSocketLib();
+}
+
+/******************************************************************************/
+void TCPServer::run(Worker & worker)
+{
+  struct epoll_event events[kMaxEvents];
+  while(fIsExecuting)
+  {
+    int count = epoll_wait(worker.fEpoll, events, kMaxEvents, -1);
+    if(count < 0)
+    {
+      if(errno == EINTR)
+      {
+        continue;
+      }
+      ANUBIS_THROW_RUNTIME_EXCEPTION("epoll_wait() failed with error code: " <<
+                                     errno);
+    }
+
+    for(int i = 0; i < count; ++i)
+    {
+      void * ptr = events[i].data.ptr;
+      if(ptr == nullptr)
+      {
+        accept();
+        continue;
+      }
+
+      /* The wake up event only interrupts the wait. */
+      if(ptr == &worker)
+      {
+        continue;
+      }
+
+      /* Only this thread closes the connection, so it stays valid until
+       * then. */
+      Connection & conn = *static_cast<Connection*>(ptr);
+      uint32_t flags = events[i].events;
+      bool isOpen = true;
+      if(flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+      {
+        isOpen = read(worker, conn);
+      }
+      if(isOpen && (flags & EPOLLOUT))
+      {
+        std::lock_guard<std::mutex> lock(conn.fMutex);
+        isOpen = flush(conn);
+      }
+      if(!isOpen)
+      {
+        close(worker, conn);
+      }
+    }
+  }
+}
+
+/******************************************************************************/
+void TCPServer::accept()
+{
+  /* The listen socket is edge triggered, thus accept until it's drained. */
+  for(;;)
+  {
+    struct sockaddr_storage addr;
+    socklen_t addrLen = sizeof(addr);
+    int handle = accept4(fListenHandle, reinterpret_cast<struct sockaddr*>(&addr),
+                         &addrLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if(handle < 0)
+    {
+      if(errno == EINTR || errno == ECONNABORTED)
+      {
+        continue;
+      }
+
+      /* Out of handles or memory, the pending connections are retried with
+       * the next one. */
+      if(!isWouldBlock(errno))
+      {
+        ANUBIS_LOG_WARN("accept4() failed with error code: " << errno);
+      }
+      return;
+    }
+
+    /* Game messages are small and latency sensitive. */
+    int noDelay = 1;
+    setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    /* Hand the connection to the next IO thread. */
+    std::shared_ptr<Connection> conn;
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      Worker * worker = fWorkers[fNextWorker++ % fWorkers.size()].get();
+      conn = std::make_shared<Connection>(fNextID++, handle,
+                                          SocketAddress(&addr, addrLen),
+                                          worker);
+      fConnections.emplace(conn->fID, conn);
+    }
+
+    /* Report the connection before it's registered, so it's data is never
+     * handled first. */
+    if(fOnConnect)
+    {
+      fOnConnect(conn->fID, conn->fPeer);
+    }
+
+    struct epoll_event event = {};
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.ptr = conn.get();
+    if(epoll_ctl(conn->fWorker->fEpoll, EPOLL_CTL_ADD, handle, &event) != 0)
+    {
+      close(*conn->fWorker, *conn);
+    }
+  }
+}
+
+/******************************************************************************/
+bool TCPServer::read(Worker & worker, Connection & conn)
+{
+  /* The socket is edge triggered, thus read until it's drained. */
+  for(;;)
+  {
+    ssize_t received = recv(conn.fHandle, worker.fBuffer.data(),
+                            worker.fBuffer.size(), 0);
+    if(received == 0)
+    {
+      return false;
+    }
+    if(received < 0)
+    {
+      if(errno == EINTR)
+      {
+        continue;
+      }
+      return isWouldBlock(errno);
+    }
+
+    /* Hand the bytes over straight from the thread's buffer, unless there
+     * are unconsumed bytes they have to follow. */
+    std::vector<uint8_t> & rx = conn.fRxBuffer;
+    const uint8_t * data = worker.fBuffer.data();
+    size_t len = size_t(received);
+    if(!rx.empty())
+    {
+      rx.insert(rx.end(), data, data + len);
+      data = rx.data();
+      len = rx.size();
+    }
+
+    size_t consumed = fOnData(conn.fID, data, len);
+    assert(consumed <= len && "Consumed more bytes than received.");
+    if(consumed >= len)
+    {
+      /* Idle connections hold no buffers. */
+      std::vector<uint8_t>().swap(rx);
+    }
+    else if(rx.empty())
+    {
+      rx.assign(data + consumed, data + len);
+    }
+    else
+    {
+      rx.erase(rx.begin(), rx.begin() + consumed);
+    }
+
+    /* A client that never completes a message is dropped. */
+    if(rx.size() > kMaxBuffered)
+    {
+      return false;
+    }
+  }
+}
+
+/******************************************************************************/
+bool TCPServer::flush(Connection & conn)
+{
+  if(!conn.fIsOpen)
+  {
+    return false;
+  }
+
+  std::vector<uint8_t> & tx = conn.fTxBuffer;
+  while(conn.fTxOffset < tx.size())
+  {
+    ssize_t sent = ::send(conn.fHandle, tx.data() + conn.fTxOffset,
+                          tx.size() - conn.fTxOffset, MSG_NOSIGNAL);
+    if(sent < 0)
+    {
+      if(errno == EINTR)
+      {
+        continue;
+      }
+
+      /* The IO thread writes the rest once the socket drains. */
+      return isWouldBlock(errno);
+    }
+    conn.fTxOffset += size_t(sent);
+  }
+
+  std::vector<uint8_t>().swap(tx);
+  conn.fTxOffset = 0;
+  return true;
+}
+
+/******************************************************************************/
+void TCPServer::close(Worker & worker, Connection & conn)
+{
+  {
+    std::lock_guard<std::mutex> lock(conn.fMutex);
+    conn.fIsOpen = false;
+    epoll_ctl(worker.fEpoll, EPOLL_CTL_DEL, conn.fHandle, nullptr);
+    ::close(conn.fHandle);
+    std::vector<uint8_t>().swap(conn.fTxBuffer);
+  }
+
+  /* The connection may be destroyed once it's removed. */
+  ConnectionID id = conn.fID;
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fConnections.erase(id);
+  }
+
+  if(fOnDisconnect)
+  {
+    fOnDisconnect(id);
+  }
+}
+
+/******************************************************************************/
+bool TCPServer::send(ConnectionID id, const uint8_t * data, size_t len)
+{
+  std::shared_ptr<Connection> conn = find(id);
+  if(!conn)
+  {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(conn->fMutex);
+  size_t buffered = conn->fTxBuffer.size() - conn->fTxOffset;
+  if(!conn->fIsOpen || buffered + len > kMaxBuffered)
   {
-    /* Create the listen socket. */
-    fListenSocket = std::make_unique<Socket>(Socket::Types::TCP);
+    return false;
+  }
 
-    /* Create the thread to listen for new connections. */
-    fThread = std::thread(&TCPServer::listenThread, this);
+  /* Write straight to the socket unless older bytes are waiting. */
+  size_t sent = 0;
+  while(buffered == 0 && sent < len)
+  {
+    ssize_t result = ::send(conn->fHandle, data + sent, len - sent,
+                            MSG_NOSIGNAL);
+    if(result >= 0)
+    {
+      sent += size_t(result);
+    }
+    else if(errno == EINTR)
+    {
+      continue;
+    }
+    else if(isWouldBlock(errno))
+    {
+      break;
+    }
+    else
+    {
+      /* Let the IO thread close the failed connection. */
+      ::shutdown(conn->fHandle, SHUT_RDWR);
+      return false;
+    }
   }
-  catch(...)
+
+  conn->fTxBuffer.insert(conn->fTxBuffer.end(), data + sent, data + len);
+  return true;
+}
+
+/******************************************************************************/
+void TCPServer::disconnect(ConnectionID id)
+{
+  std::shared_ptr<Connection> conn = find(id);
+  if(conn)
   {
-    /* Clear the execution flag. */
-    fIsExecuting = false;
+    /* The shutdown wakes up the IO thread, which closes the connection. */
+    std::lock_guard<std::mutex> lock(conn->fMutex);
+    if(conn->fIsOpen)
+    {
+      ::shutdown(conn->fHandle, SHUT_RDWR);
+    }
   }
 }
 
+#else
+
+/******************************************************************************/
+TCPServer::TCPServer(const IPEndPoint & localEP, ConnectHandler onConnect,
+                     DataHandler onData, DisconnectHandler onDisconnect,
+                     size_t ioThreads, size_t maxBuffered) :
+  fOnConnect(std::move(onConnect)), fOnData(std::move(onData)),
+  fOnDisconnect(std::move(onDisconnect)), kMaxBuffered(maxBuffered),
+  fListenHandle(-1), fLocalAddr(localEP), fNextID(1), fNextWorker(0),
+  fIsExecuting(false)
+{
+  (void)ioThreads;
+  ANUBIS_THROW_RUNTIME_EXCEPTION("The TCPServer requires epoll.");
+}
+
 /******************************************************************************/
 TCPServer::~TCPServer()
 {
+}
+
+/******************************************************************************/
+void TCPServer::run(Worker &)
+{
+}
+
+/******************************************************************************/
+void TCPServer::accept()
+{
+}
+
+/******************************************************************************/
+bool TCPServer::read(Worker &, Connection &)
+{
+  return false;
+}
+
+/******************************************************************************/
+bool TCPServer::flush(Connection &)
+{
+  return false;
+}
+
+/******************************************************************************/
+void TCPServer::close(Worker &, Connection &)
+{
+}
+
+/******************************************************************************/
+bool TCPServer::send(ConnectionID, const uint8_t *, size_t)
+{
+  return false;
+}
+
+/******************************************************************************/
+void TCPServer::disconnect(ConnectionID)
+{
+}
+
+#endif /* ANUBIS_HAS_EPOLL */
+
+/******************************************************************************/
+IPEndPoint TCPServer::getEP() const
+{
+  return fLocalAddr.toEndPoint();
+}
 
+/******************************************************************************/
+std::shared_ptr<TCPServer::Connection> TCPServer::find(ConnectionID id) const
+{
+  std::lock_guard<std::mutex> lock(fMutex);
+  auto it = fConnections.find(id);
+  return it == fConnections.end() ? nullptr : it->second;
 }
 
 /******************************************************************************/
-void TCPServer::listenThread()
+size_t TCPServer::getBuffered(ConnectionID id) const
 {
+  std::shared_ptr<Connection> conn = find(id);
+  if(!conn)
+  {
+    return 0;
+  }
+
+  std::lock_guard<std::mutex> lock(conn->fMutex);
+  return conn->fTxBuffer.size() - conn->fTxOffset;
+}
 
+/******************************************************************************/
+size_t TCPServer::getConnectionCount() const
+{
+  std::lock_guard<std::mutex> lock(fMutex);
+  return fConnections.size();
 }
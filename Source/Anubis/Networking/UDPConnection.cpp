@@ -0,0 +1,491 @@
+#include "../../../Include/Anubis/Networking/UDPConnection.hpp"
+
+using namespace Anubis;
+using namespace Anubis::Networking;
+
+/* The length of a message's header: the channel (uint8_t), the ID (uint16_t)
+ * and the length (uint16_t). */
+static const size_t kMsgHeaderLen = 5;
+
+/* The resend timeout before the first round trip was measured and it's
+ * bounds afterwards. */
+static const UDPConnection::Clock::duration kInitialTimeout =
+  std::chrono::milliseconds(100);
+static const UDPConnection::Clock::duration kMinTimeout =
+  std::chrono::milliseconds(10);
+static const UDPConnection::Clock::duration kMaxTimeout =
+  std::chrono::seconds(1);
+
+/******************************************************************************/
+/* Compare two sequence numbers or message IDs that wrap around. */
+static bool isNewer(uint16_t lhs, uint16_t rhs)
+{
+  return int16_t(uint16_t(lhs - rhs)) > 0;
+}
+
+/******************************************************************************/
+struct UDPConnection::Channel final
+{
+  /** A message that is queued, waiting for it's ack or buffered until the
+   * ones before it arrive. */
+  struct Message
+  {
+    /** The ID of the message in it's channel. */
+    uint16_t fID;
+
+    /** Indicate if the slot holds a message. */
+    bool fIsPending;
+
+    /** Indicate if the message was sent at least once. */
+    bool fIsSent;
+
+    /** The time the message was last sent. */
+    Clock::time_point fSentAt;
+
+    /** The bytes of the message. */
+    PacketPool::Packet fData;
+
+    /** Create an empty slot. */
+    Message() : fID(0), fIsPending(false), fIsSent(false) {}
+  };
+
+  /** The type of the channel. */
+  ChannelTypes fType;
+
+  /** The ID of the next message that is queued. */
+  uint16_t fNextID;
+
+  /** The oldest reliable message that is not acked. */
+  uint16_t fOldestID;
+
+  /** The unacked reliable messages, by ID. */
+  std::vector<Message> fSlots;
+
+  /** The unreliable messages that are waiting to be written. */
+  std::vector<Message> fQueue;
+
+  /** The next reliable message to hand out, or the newest unreliable
+   * message that was handed out. */
+  uint16_t fRecvID;
+
+  /** Indicate if an unreliable message was handed out. */
+  bool fHasRecv;
+
+  /** The reliable messages that arrived before the ones before them, by
+   * ID. */
+  std::vector<Message> fRecvSlots;
+
+  /** Create an empty channel. */
+  Channel(ChannelTypes type) : fType(type), fNextID(0), fOldestID(0),
+    fRecvID(0), fHasRecv(false)
+  {
+    if(type == ChannelTypes::ReliableOrdered)
+    {
+      fSlots.resize(kWindowLen);
+      fRecvSlots.resize(kWindowLen);
+    }
+    else
+    {
+      fQueue.reserve(kWindowLen);
+    }
+  }
+};
+
+/******************************************************************************/
+struct UDPConnection::SentPacket final
+{
+  /** A reliable message that a packet carried. */
+  struct MessageRef
+  {
+    uint16_t fChannel;
+    uint16_t fID;
+  };
+
+  /** The sequence number of the packet. */
+  uint16_t fSeq;
+
+  /** Indicate if the slot holds a packet. */
+  bool fIsValid;
+
+  /** Indicate if the packet was acked. */
+  bool fIsAcked;
+
+  /** The time the packet was written. */
+  Clock::time_point fSentAt;
+
+  /** The reliable messages of the packet. */
+  std::vector<MessageRef> fRefs;
+
+  /** Create an empty slot. */
+  SentPacket() : fSeq(0), fIsValid(false), fIsAcked(false) {}
+};
+
+/******************************************************************************/
+UDPConnection::UDPConnection(const std::vector<ChannelTypes> & channels,
+                             size_t maxPktLen) :
+  kMaxPktLen(maxPktLen), fPool(maxPktLen), fSent(kWindowLen), fLocalSeq(0),
+  fRemoteSeq(UINT16_MAX), fAckBits(0), fHasReceived(false),
+  fIsAckPending(false), fRTT(0), fRTTVar(0), fHasRTT(false)
+{
+  assert(channels.size() <= 256 && "A message stores it's channel in a byte.");
+  assert(maxPktLen > UDPPacket::kMinPktLen + kMsgHeaderLen &&
+         "The packets can't hold a message.");
+
+  for(ChannelTypes type : channels)
+  {
+    fChannels.push_back(std::make_unique<Channel>(type));
+  }
+
+  /* Size the lists of the sent messages for the fullest packet once. */
+  const size_t maxRefs = (maxPktLen - UDPPacket::kMinPktLen) / kMsgHeaderLen;
+  for(SentPacket & sent : fSent)
+  {
+    sent.fRefs.reserve(maxRefs);
+  }
+}
+
+/******************************************************************************/
+UDPConnection::~UDPConnection()
+{
+}
+
+/******************************************************************************/
+size_t UDPConnection::getMaxMessageLen() const
+{
+  return std::min<size_t>(kMaxPktLen - UDPPacket::kMinPktLen - kMsgHeaderLen,
+                          UINT16_MAX);
+}
+
+/******************************************************************************/
+bool UDPConnection::queue(size_t channel, const uint8_t * data, size_t len)
+{
+  if(channel >= fChannels.size() || len > getMaxMessageLen())
+  {
+    return false;
+  }
+
+  Channel & ch = *fChannels[channel];
+  Channel::Message * msg;
+  if(ch.fType == ChannelTypes::ReliableOrdered)
+  {
+    /* The receiver only buffers a window of messages. */
+    if(uint16_t(ch.fNextID - ch.fOldestID) >= kWindowLen)
+    {
+      return false;
+    }
+    msg = &ch.fSlots[ch.fNextID % kWindowLen];
+  }
+  else
+  {
+    if(ch.fQueue.size() >= kWindowLen)
+    {
+      return false;
+    }
+    ch.fQueue.emplace_back();
+    msg = &ch.fQueue.back();
+  }
+
+  msg->fID = ch.fNextID++;
+  msg->fIsPending = true;
+  msg->fIsSent = false;
+  msg->fData = fPool.acquire();
+  memcpy(msg->fData.data(), data, len);
+  msg->fData.resize(len);
+  return true;
+}
+
+/******************************************************************************/
+bool UDPConnection::write(UDPPacket & packet, Clock::time_point now)
+{
+  const uint16_t seq = fLocalSeq;
+  SentPacket & sent = fSent[seq % kWindowLen];
+  sent.fRefs.clear();
+
+  bool hasMessages = false;
+  auto append = [&](size_t channel, const Channel::Message & msg)
+  {
+    const size_t len = msg.fData.size();
+    if(packet.getRemaining() < kMsgHeaderLen + len)
+    {
+      return false;
+    }
+    uint8_t header[kMsgHeaderLen];
+    header[0] = uint8_t(channel);
+    writeLE<uint16_t>(header + 1, 2, msg.fID);
+    writeLE<uint16_t>(header + 3, 2, uint16_t(len));
+    packet.append(header, kMsgHeaderLen);
+    packet.append(msg.fData.data(), len);
+    hasMessages = true;
+    return true;
+  };
+
+  /* The reliable messages that were never sent or whose ack is overdue. */
+  const Clock::duration timeout = getResendTimeout();
+  for(size_t c = 0; c < fChannels.size(); c++)
+  {
+    Channel & ch = *fChannels[c];
+    if(ch.fType != ChannelTypes::ReliableOrdered)
+    {
+      continue;
+    }
+    for(uint16_t id = ch.fOldestID; id != ch.fNextID; ++id)
+    {
+      Channel::Message & msg = ch.fSlots[id % kWindowLen];
+      if(!msg.fIsPending || (msg.fIsSent && now - msg.fSentAt < timeout) ||
+         !append(c, msg))
+      {
+        continue;
+      }
+      msg.fIsSent = true;
+      msg.fSentAt = now;
+      sent.fRefs.push_back({uint16_t(c), id});
+    }
+  }
+
+  /* The unreliable messages in order, the ones that don't fit wait for the
+   * next packet. */
+  for(size_t c = 0; c < fChannels.size(); c++)
+  {
+    std::vector<Channel::Message> & queue = fChannels[c]->fQueue;
+    size_t count = 0;
+    while(count < queue.size() && append(c, queue[count]))
+    {
+      count++;
+    }
+    queue.erase(queue.begin(), queue.begin() + ptrdiff_t(count));
+  }
+
+  if(!hasMessages && !fIsAckPending)
+  {
+    return false;
+  }
+
+  packet.setSeqNumber(seq);
+  packet.setAckNum(fRemoteSeq);
+  packet.setAckBits(fAckBits);
+
+  sent.fSeq = seq;
+  sent.fIsValid = true;
+  sent.fIsAcked = false;
+  sent.fSentAt = now;
+  ++fLocalSeq;
+  fIsAckPending = false;
+  return true;
+}
+
+/******************************************************************************/
+bool UDPConnection::read(const uint8_t * data, size_t len,
+                         const MessageHandler & onMessage,
+                         Clock::time_point now)
+{
+  /* Check the whole packet before any of it is used. A packet longer than
+   * the pool's buffers could overflow them when it's messages are
+   * buffered. */
+  if(len < UDPPacket::kMinPktLen || len > kMaxPktLen)
+  {
+    return false;
+  }
+  for(size_t offset = UDPPacket::kMinPktLen; offset < len;)
+  {
+    if(len - offset < kMsgHeaderLen || data[offset] >= fChannels.size())
+    {
+      return false;
+    }
+    const size_t msgLen = readLE<uint16_t>(data + offset + 3, 2);
+    offset += kMsgHeaderLen;
+    if(msgLen > len - offset)
+    {
+      return false;
+    }
+    offset += msgLen;
+  }
+
+  /* Handle the acks, every one of them is repeated in later packets. */
+  const uint16_t ackNum = readLE<uint16_t>(data + UDPPacket::kAckNumIndex, 2);
+  const uint32_t ackBits = readLE<uint32_t>(data + UDPPacket::kAckBitsIndex,
+                                            4);
+  ack(ackNum, now);
+  for(uint16_t i = 0; i < 32; i++)
+  {
+    if(ackBits & (uint32_t(1) << i))
+    {
+      ack(uint16_t(ackNum - 1 - i), now);
+    }
+  }
+  received(readLE<uint16_t>(data + UDPPacket::kSeqNumIndex, 2));
+
+  /* Only packets with messages need an ack of their own, else two idle
+   * peers would ack each other's acks forever. */
+  if(len > UDPPacket::kMinPktLen)
+  {
+    fIsAckPending = true;
+  }
+
+  /* Hand out the messages. */
+  for(size_t offset = UDPPacket::kMinPktLen; offset < len;)
+  {
+    const size_t channel = data[offset];
+    const uint16_t id = readLE<uint16_t>(data + offset + 1, 2);
+    const size_t msgLen = readLE<uint16_t>(data + offset + 3, 2);
+    const uint8_t * msgData = data + offset + kMsgHeaderLen;
+    offset += kMsgHeaderLen + msgLen;
+
+    Channel & ch = *fChannels[channel];
+    if(ch.fType == ChannelTypes::UnreliableSequenced)
+    {
+      /* Drop the messages that are older than one already handed out. */
+      if(!ch.fHasRecv || isNewer(id, ch.fRecvID))
+      {
+        ch.fHasRecv = true;
+        ch.fRecvID = id;
+        onMessage(channel, msgData, msgLen);
+      }
+    }
+    else if(id == ch.fRecvID)
+    {
+      /* Hand out the message and the ones after it that were buffered. */
+      onMessage(channel, msgData, msgLen);
+      for(++ch.fRecvID;; ++ch.fRecvID)
+      {
+        Channel::Message & next = ch.fRecvSlots[ch.fRecvID % kWindowLen];
+        if(!next.fIsPending || next.fID != ch.fRecvID)
+        {
+          break;
+        }
+        onMessage(channel, next.fData.data(), next.fData.size());
+        next.fIsPending = false;
+        next.fData.reset();
+      }
+    }
+    else if(isNewer(id, ch.fRecvID) &&
+            uint16_t(id - ch.fRecvID) < kWindowLen)
+    {
+      /* Buffer the message until the ones before it arrive, duplicates are
+       * dropped. */
+      Channel::Message & slot = ch.fRecvSlots[id % kWindowLen];
+      if(!slot.fIsPending)
+      {
+        slot.fID = id;
+        slot.fIsPending = true;
+        slot.fData = fPool.acquire();
+        memcpy(slot.fData.data(), msgData, msgLen);
+        slot.fData.resize(msgLen);
+      }
+    }
+  }
+
+  return true;
+}
+
+/******************************************************************************/
+void UDPConnection::ack(uint16_t seq, Clock::time_point now)
+{
+  SentPacket & sent = fSent[seq % kWindowLen];
+  if(!sent.fIsValid || sent.fIsAcked || sent.fSeq != seq)
+  {
+    return;
+  }
+  sent.fIsAcked = true;
+
+  /* Smooth the round trip time like TCP (RFC 6298). */
+  const Clock::duration sample = now - sent.fSentAt;
+  if(!fHasRTT)
+  {
+    fRTT = sample;
+    fRTTVar = sample / 2;
+    fHasRTT = true;
+  }
+  else
+  {
+    const Clock::duration diff = fRTT > sample ? fRTT - sample :
+                                                 sample - fRTT;
+    fRTTVar = (3 * fRTTVar + diff) / 4;
+    fRTT = (7 * fRTT + sample) / 8;
+  }
+
+  /* Release the reliable messages of the packet, whichever packet carried
+   * them first. */
+  for(const SentPacket::MessageRef & ref : sent.fRefs)
+  {
+    Channel & ch = *fChannels[ref.fChannel];
+    Channel::Message & msg = ch.fSlots[ref.fID % kWindowLen];
+    if(msg.fIsPending && msg.fID == ref.fID)
+    {
+      msg.fIsPending = false;
+      msg.fData.reset();
+    }
+    while(ch.fOldestID != ch.fNextID &&
+          !ch.fSlots[ch.fOldestID % kWindowLen].fIsPending)
+    {
+      ++ch.fOldestID;
+    }
+  }
+}
+
+/******************************************************************************/
+void UDPConnection::received(uint16_t seq)
+{
+  if(!fHasReceived)
+  {
+    fRemoteSeq = seq;
+    fAckBits = 0;
+    fHasReceived = true;
+  }
+  else if(isNewer(seq, fRemoteSeq))
+  {
+    /* Shift the bitfield, the previous most recent packet becomes a bit. */
+    const uint16_t shift = uint16_t(seq - fRemoteSeq);
+    if(shift < 32)
+    {
+      fAckBits = (fAckBits << shift) | (uint32_t(1) << (shift - 1));
+    }
+    else
+    {
+      fAckBits = shift == 32 ? uint32_t(1) << 31 : 0;
+    }
+    fRemoteSeq = seq;
+  }
+  else
+  {
+    /* An older packet arrived late, or a duplicate. */
+    const uint16_t age = uint16_t(fRemoteSeq - seq);
+    if(age >= 1 && age <= 32)
+    {
+      fAckBits |= uint32_t(1) << (age - 1);
+    }
+  }
+}
+
+/******************************************************************************/
+UDPConnection::Clock::duration UDPConnection::getRTT() const
+{
+  return fRTT;
+}
+
+/******************************************************************************/
+UDPConnection::Clock::duration UDPConnection::getResendTimeout() const
+{
+  if(!fHasRTT)
+  {
+    return kInitialTimeout;
+  }
+  return std::min(std::max(fRTT + 4 * fRTTVar, kMinTimeout), kMaxTimeout);
+}
+
+/******************************************************************************/
+size_t UDPConnection::getUnacked() const
+{
+  size_t count = 0;
+  for(const std::unique_ptr<Channel> & ch : fChannels)
+  {
+    if(ch->fType != ChannelTypes::ReliableOrdered)
+    {
+      continue;
+    }
+    for(uint16_t id = ch->fOldestID; id != ch->fNextID; ++id)
+    {
+      count += ch->fSlots[id % kWindowLen].fIsPending ? 1 : 0;
+    }
+  }
+  return count;
+}
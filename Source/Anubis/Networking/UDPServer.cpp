@@ -3,16 +3,9 @@
 using namespace Anubis::Networking;
 
 /******************************************************************************/
-UDPPacket::UDPPacket(size_t maxPktLen) : kMaxPktLen(maxPktLen)
+UDPPacket::UDPPacket(PacketPool::Packet packet) : fData(std::move(packet))
 {
-  /* Reserver enough space in the vector. */
-  fData.reserve(kMaxPktLen);
-
-  /* Set the minimum size of the packet. */
-  fData.resize(kMinPktLen);
-
-  /* Clear the memory. */
-  memset(fData.data(), 0, kMaxPktLen);
+  clear();
 }
 
 /******************************************************************************/
@@ -21,8 +14,21 @@ void UDPPacket::clear()
   /* Reset the size of the packet back to it's minimum size. */
   fData.resize(kMinPktLen);
 
-  /* Clear the memory. */
-  memset(fData.data(), 0, kMaxPktLen);
+  /* Clear the header. */
+  memset(fData.data(), 0, kMinPktLen);
+}
+
+/******************************************************************************/
+bool UDPPacket::append(const uint8_t * data, size_t len)
+{
+  if(len > getRemaining())
+  {
+    return false;
+  }
+  const size_t offset = fData.size();
+  fData.resize(offset + len);
+  memcpy(fData.data() + offset, data, len);
+  return true;
 }
 
 /******************************************************************************/
@@ -53,6 +59,20 @@ uint16_t UDPPacket::getAckNum() const
                           fData.size() - kAckNumIndex);
 }
 
+/******************************************************************************/
+void UDPPacket::setAckBits(uint32_t ackBits)
+{
+  writeLE<uint32_t>(fData.data() + kAckBitsIndex,
+                    fData.size() - kAckBitsIndex, ackBits);
+}
+
+/******************************************************************************/
+uint32_t UDPPacket::getAckBits() const
+{
+  return readLE<uint32_t>(fData.data() + kAckBitsIndex,
+                          fData.size() - kAckBitsIndex);
+}
+
 /******************************************************************************/
 void UDPPacket::Chunk::setState(uint8_t state)
 {
@@ -107,14 +127,115 @@ void UDPPacket::Chunk::getTargets(const std::vector<uint16_t> & targets)
 
 
 
-///******************************************************************************/
-//UDPServer::UDPServer(IPEndPoint localEP, size_t maxPktLen)
-//{
+/******************************************************************************/
+static std::unique_ptr<Socket> createSocket(const IPEndPoint & localEP)
+{
+  /* Create a socket of the same IP version as the end point. */
+  std::unique_ptr<Socket> socket = std::make_unique<Socket>(
+    Socket::Types::UDP, localEP.isIPv4() ? Socket::Versions::IPv4 :
+                                           Socket::Versions::IPv6);
+  socket->bind(localEP);
+  return socket;
+}
 
-//}
+/******************************************************************************/
+UDPServer::UDPServer(IPEndPoint localEP, size_t maxPktLen, size_t batchSize,
+                     Backends backend) :
+  UDPServer(createSocket(localEP), maxPktLen, batchSize, backend)
+{
+}
 
-///******************************************************************************/
-//UDPServer::~UDPServer()
-//{
+/******************************************************************************/
+UDPServer::UDPServer(std::unique_ptr<Socket> socket, size_t maxPktLen,
+                     size_t batchSize, Backends backend) :
+  kMaxPktLen(maxPktLen), fSocket(std::move(socket)), fPool(maxPktLen),
+  fRxBatch(fPool, batchSize), fTxBatch(fPool, batchSize), fIsStopped(false)
+{
+  /* Every slot of both batches holds a packet, plus as many again for the
+   * received packets that are taken out. */
+  fPool.reserve(3 * batchSize);
+
+  if(backend == Backends::IOUring)
+  {
+    fRing = IOUring::create(*fSocket, maxPktLen, batchSize);
+  }
+}
 
-//}
+/******************************************************************************/
+UDPServer::~UDPServer()
+{
+  /* Send the packets that are still queued. */
+  flush();
+}
+
+/******************************************************************************/
+IPEndPoint UDPServer::getEP() const
+{
+  return fSocket->getEP();
+}
+
+/******************************************************************************/
+size_t UDPServer::receive(bool wait)
+{
+  /* A stopped socket returns empty datagrams, they are not handed out. */
+  if(!fIsStopped)
+  {
+    const size_t count = fRing ? fRing->recvFromBatch(fRxBatch, wait) :
+                                 fSocket->recvFromBatch(fRxBatch, wait);
+    if(!fIsStopped)
+    {
+      return count;
+    }
+  }
+  fRxBatch.clear();
+  return 0;
+}
+
+/******************************************************************************/
+void UDPServer::stop()
+{
+  fIsStopped = true;
+  if(fRing)
+  {
+    fRing->wake();
+  }
+  else
+  {
+    fSocket->shutdownRecv();
+  }
+}
+
+/******************************************************************************/
+bool UDPServer::send(const SocketAddress & ep, const uint8_t * data,
+                     size_t len)
+{
+  if(fTxBatch.full())
+  {
+    flush();
+  }
+  return fTxBatch.push(ep, data, len);
+}
+
+/******************************************************************************/
+void UDPServer::send(const SocketAddress & ep,
+                     const PacketPool::Packet & packet)
+{
+  if(fTxBatch.full())
+  {
+    flush();
+  }
+  fTxBatch.push(ep, packet);
+}
+
+/******************************************************************************/
+size_t UDPServer::flush()
+{
+  size_t sent = 0;
+  if(fTxBatch.size() > 0)
+  {
+    sent = fRing ? fRing->sendToBatch(fTxBatch) :
+                   fSocket->sendToBatch(fTxBatch);
+    fTxBatch.clear();
+  }
+  return sent;
+}
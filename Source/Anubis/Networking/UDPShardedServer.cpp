@@ -0,0 +1,220 @@
+#include "../../../Include/Anubis/Common/System/SocketWrapper.hpp"
+#include "../../../Include/Anubis/Networking/UDPShardedServer.hpp"
+
+/* The datagrams are steered to the shards by a classic BPF program. */
+#if ANUBIS_OS == ANUBIS_OS_UNIX && defined(__linux__)
+  #include <linux/filter.h>
+  #if defined(SO_REUSEPORT) && defined(SO_ATTACH_REUSEPORT_CBPF)
+    #define ANUBIS_HAS_REUSEPORT_STEERING
+  #endif /* SO_REUSEPORT && SO_ATTACH_REUSEPORT_CBPF */
+#endif /* ANUBIS_OS == ANUBIS_OS_UNIX && __linux__ */
+
+using namespace Anubis::Networking;
+
+/* The multiplier of the shard hash, the golden ratio. */
+static const uint32_t kShardHashMul = 0x9E3779B1u;
+
+/******************************************************************************/
+struct UDPShardedServer::Shard final
+{
+  /** The index of the shard, i.e. of it's socket in the SO_REUSEPORT
+   * group. */
+  size_t fIndex;
+
+  /** The server of the shard's socket. */
+  std::unique_ptr<UDPServer> fServer;
+
+  /** The thread that receives the shard's datagrams. */
+  std::thread fThread;
+};
+
+/******************************************************************************/
+/* Hash the last word of a client's address and it's port to a shard, exactly
+ * like the steering program does. */
+static size_t hashShard(uint32_t addr, uint16_t port, size_t count)
+{
+  const uint32_t hash = (addr ^ port) * kShardHashMul;
+  return size_t(hash >> 16) % count;
+}
+
+#ifdef ANUBIS_HAS_REUSEPORT_STEERING
+
+/******************************************************************************/
+/* Let the socket share it's port with the other shards. */
+static bool setReusePort(int handle)
+{
+  int enable = 1;
+  return setsockopt(handle, SOL_SOCKET, SO_REUSEPORT, &enable,
+                    sizeof(enable)) == 0;
+}
+
+/******************************************************************************/
+/* Attach the program that picks the socket of every datagram to the group.
+ * It reads the source address and port from the IP and UDP headers, the
+ * last word of an IPv6 address is an IPv4 address for mapped clients, thus
+ * both hash the same. */
+static bool attachSteering(int handle, size_t count)
+{
+  const uint32_t kNet = uint32_t(SKF_NET_OFF);
+  struct sock_filter code[] =
+  {
+    /* Check the IP version. */
+    BPF_STMT(BPF_LD | BPF_B | BPF_ABS, kNet),
+    BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 4),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 4, 0, 5),
+
+    /* IPv4: M[0] = the port after the variable length header, A = the
+     * address. */
+    BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, kNet),
+    BPF_STMT(BPF_LD | BPF_H | BPF_IND, kNet),
+    BPF_STMT(BPF_ST, 0),
+    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, kNet + 12),
+    BPF_STMT(BPF_JMP | BPF_JA, 3),
+
+    /* IPv6: M[0] = the port after the fixed header, A = the address. */
+    BPF_STMT(BPF_LD | BPF_H | BPF_ABS, kNet + 40),
+    BPF_STMT(BPF_ST, 0),
+    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, kNet + 20),
+
+    /* Return the index of the socket, see hashShard(). */
+    BPF_STMT(BPF_LDX | BPF_W | BPF_MEM, 0),
+    BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0),
+    BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, kShardHashMul),
+    BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 16),
+    BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, uint32_t(count)),
+    BPF_STMT(BPF_RET | BPF_A, 0)
+  };
+
+  struct sock_fprog program;
+  program.len = sizeof(code) / sizeof(code[0]);
+  program.filter = code;
+  return setsockopt(handle, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program,
+                    sizeof(program)) == 0;
+}
+
+#endif /* ANUBIS_HAS_REUSEPORT_STEERING */
+
+/******************************************************************************/
+UDPShardedServer::UDPShardedServer(const IPEndPoint & localEP,
+                                   ReceiveHandler onReceive, size_t shards,
+                                   size_t maxPktLen, size_t batchSize,
+                                   UDPServer::Backends backend) :
+  fOnReceive(onReceive), fIsExecuting(true)
+{
+  #ifdef ANUBIS_HAS_REUSEPORT_STEERING
+    if(shards == 0)
+    {
+      shards = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+  #else
+    shards = 1;
+  #endif /* ANUBIS_HAS_REUSEPORT_STEERING */
+
+  /* Bind the first socket to find the port, the others join it's group. The
+   * index of a socket in the group is the order it was bound in. */
+  IPEndPoint ep(localEP);
+  for(size_t i = 0; i < shards; i++)
+  {
+    std::unique_ptr<Socket> socket = std::make_unique<Socket>(
+      Socket::Types::UDP, localEP.isIPv4() ? Socket::Versions::IPv4 :
+                                             Socket::Versions::IPv6);
+    #ifdef ANUBIS_HAS_REUSEPORT_STEERING
+      if(shards > 1 && !setReusePort(int(socket->getHandle())))
+      {
+        if(i > 0)
+        {
+          ANUBIS_THROW_RUNTIME_EXCEPTION("setsockopt() failed with error "
+                                         "code: " << errno);
+        }
+        ANUBIS_LOG_WARN("SO_REUSEPORT is not supported, using one shard.");
+        shards = 1;
+      }
+    #endif /* ANUBIS_HAS_REUSEPORT_STEERING */
+    socket->bind(ep);
+
+    if(i == 0)
+    {
+      ep = socket->getEP();
+      #ifdef ANUBIS_HAS_REUSEPORT_STEERING
+        if(shards > 1 && !attachSteering(int(socket->getHandle()), shards))
+        {
+          ANUBIS_LOG_WARN("SO_ATTACH_REUSEPORT_CBPF failed, using one "
+                          "shard.");
+          shards = 1;
+        }
+      #endif /* ANUBIS_HAS_REUSEPORT_STEERING */
+    }
+
+    std::unique_ptr<Shard> shard = std::make_unique<Shard>();
+    shard->fIndex = i;
+    shard->fServer = std::make_unique<UDPServer>(std::move(socket), maxPktLen,
+                                                 batchSize, backend);
+    fShards.push_back(std::move(shard));
+  }
+
+  /* Only start the threads once all the shards exist. */
+  for(std::unique_ptr<Shard> & shard : fShards)
+  {
+    shard->fThread = std::thread(&UDPShardedServer::run, this,
+                                 std::ref(*shard));
+  }
+}
+
+/******************************************************************************/
+UDPShardedServer::~UDPShardedServer()
+{
+  fIsExecuting = false;
+  for(std::unique_ptr<Shard> & shard : fShards)
+  {
+    shard->fServer->stop();
+  }
+  for(std::unique_ptr<Shard> & shard : fShards)
+  {
+    if(shard->fThread.joinable())
+    {
+      shard->fThread.join();
+    }
+  }
+}
+
+/******************************************************************************/
+void UDPShardedServer::run(Shard & shard)
+{
+  while(fIsExecuting)
+  {
+    if(shard.fServer->receive() > 0)
+    {
+      fOnReceive(shard.fIndex, *shard.fServer);
+      shard.fServer->flush();
+    }
+  }
+}
+
+/******************************************************************************/
+IPEndPoint UDPShardedServer::getEP() const
+{
+  return fShards.front()->fServer->getEP();
+}
+
+/******************************************************************************/
+size_t UDPShardedServer::getShardCount() const
+{
+  return fShards.size();
+}
+
+/******************************************************************************/
+size_t UDPShardedServer::getShard(const SocketAddress & addr) const
+{
+  if(fShards.size() == 1)
+  {
+    return 0;
+  }
+
+  /* The last word of the address, in host order like the program reads it.
+   * An IPv4 address starts at byte 4, an IPv6 address at byte 8. */
+  const uint8_t * data = addr.addrData();
+  const uint8_t * word = data + (addr.isIPv4() ? 4 : 20);
+  const uint32_t last = uint32_t(word[0]) << 24 | uint32_t(word[1]) << 16 |
+                        uint32_t(word[2]) << 8 | uint32_t(word[3]);
+  return hashShard(last, addr.port(), fShards.size());
+}
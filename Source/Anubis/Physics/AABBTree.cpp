@@ -0,0 +1,452 @@
+#include "../../../Include/Anubis/Physics/AABBTree.hpp"
+
+using namespace Anubis::Physics;
+
+/******************************************************************************/
+AABBTree::AABBTree(float margin) : fRoot(kNullNode), fFreeList(kNullNode),
+  fProxyCount(0), fMargin(margin) {}
+
+/******************************************************************************/
+int32_t AABBTree::allocateNode()
+{
+  /* Grow the storage if there are no free nodes left. */
+  if(fFreeList == kNullNode)
+  {
+    /* Double the capacity and link the new nodes into the free list. */
+    size_t oldSize = fNodes.size();
+    size_t newSize = std::max<size_t>(16, oldSize * 2);
+    fNodes.resize(newSize);
+
+    for(size_t i = oldSize; i < newSize; i++)
+    {
+      fNodes[i].fNext = i + 1 < newSize ? int32_t(i + 1) : kNullNode;
+      fNodes[i].fHeight = -1;
+    }
+
+    fFreeList = int32_t(oldSize);
+  }
+
+  /* Pop the head of the free list. */
+  int32_t index = fFreeList;
+  Node & node = fNodes[index];
+  fFreeList = node.fNext;
+
+  /* Initialise the node as a leaf without a parent. */
+  node.fParent = kNullNode;
+  node.fChild1 = kNullNode;
+  node.fChild2 = kNullNode;
+  node.fHeight = 0;
+  node.fUserData = nullptr;
+  return index;
+}
+
+/******************************************************************************/
+void AABBTree::freeNode(int32_t index)
+{
+  /* Push the node onto the free list. */
+  fNodes[index].fNext = fFreeList;
+  fNodes[index].fHeight = -1;
+  fFreeList = index;
+}
+
+/******************************************************************************/
+void AABBTree::clear()
+{
+  /* Link all the nodes into the free list. */
+  for(size_t i = 0; i < fNodes.size(); i++)
+  {
+    fNodes[i].fNext = i + 1 < fNodes.size() ? int32_t(i + 1) : kNullNode;
+    fNodes[i].fHeight = -1;
+  }
+
+  /* Reset the tree. */
+  fFreeList = fNodes.empty() ? kNullNode : 0;
+  fRoot = kNullNode;
+  fProxyCount = 0;
+}
+
+/******************************************************************************/
+int32_t AABBTree::insert(const AABB & box, void * userData)
+{
+  /* Create the leaf with a fat box. */
+  int32_t proxy = allocateNode();
+  fNodes[proxy].fBox = box.fatten(fMargin);
+  fNodes[proxy].fUserData = userData;
+
+  /* Link the leaf into the tree. */
+  insertLeaf(proxy);
+  ++fProxyCount;
+  return proxy;
+}
+
+/******************************************************************************/
+void AABBTree::remove(int32_t proxy)
+{
+  /* Unlink and free the leaf. */
+  removeLeaf(proxy);
+  freeNode(proxy);
+  --fProxyCount;
+}
+
+/******************************************************************************/
+bool AABBTree::move(int32_t proxy, const AABB & box,
+                    const Math::Vector4f & displacement)
+{
+  /* Nothing to do while the object remains inside the fat box. */
+  Node & node = fNodes[proxy];
+  if(node.fBox.contains(box))
+  {
+    return false;
+  }
+
+  /* Grow the box by the margin and extend it along the displacement. */
+  AABB fat = box.fatten(fMargin);
+  Math::Vector4f d = displacement * kDisplacementMultiplier;
+  fat.fMin = Math::Vector4f::min(fat.fMin, fat.fMin + d);
+  fat.fMax = Math::Vector4f::max(fat.fMax, fat.fMax + d);
+
+  /* Reinsert the leaf, the proxy ID remains the same. */
+  removeLeaf(proxy);
+  fNodes[proxy].fBox = fat;
+  insertLeaf(proxy);
+  return true;
+}
+
+/******************************************************************************/
+void AABBTree::insertLeaf(int32_t leaf)
+{
+  /* The first leaf becomes the root. */
+  if(fRoot == kNullNode)
+  {
+    fRoot = leaf;
+    fNodes[leaf].fParent = kNullNode;
+    return;
+  }
+
+  /* Descend to the sibling that results in the smallest tree area. */
+  const AABB leafBox = fNodes[leaf].fBox;
+  int32_t index = fRoot;
+  while(!fNodes[index].isLeaf())
+  {
+    const Node & node = fNodes[index];
+    float area = node.fBox.surfaceArea();
+    float combinedArea = AABB::merge(node.fBox, leafBox).surfaceArea();
+
+    /* The cost of making a new parent for this node and the leaf. */
+    float cost = 2.0f * combinedArea;
+
+    /* The minimum cost of pushing the leaf further down the tree. */
+    float inheritanceCost = 2.0f * (combinedArea - area);
+
+    /* The cost of descending into each child. */
+    float childCost[2];
+    int32_t children[2] = {node.fChild1, node.fChild2};
+    for(int i = 0; i < 2; i++)
+    {
+      const Node & child = fNodes[children[i]];
+      float merged = AABB::merge(child.fBox, leafBox).surfaceArea();
+      childCost[i] = child.isLeaf() ? merged + inheritanceCost :
+        merged - child.fBox.surfaceArea() + inheritanceCost;
+    }
+
+    /* Stop when creating a new parent here is the cheapest option. */
+    if(cost < childCost[0] && cost < childCost[1])
+    {
+      break;
+    }
+
+    /* Descend into the cheapest child. */
+    index = childCost[0] < childCost[1] ? children[0] : children[1];
+  }
+
+  /* Create a new parent for the sibling and the leaf. Note that the node
+   * storage might move, thus no references are held across the allocation. */
+  int32_t sibling = index;
+  int32_t oldParent = fNodes[sibling].fParent;
+  int32_t newParent = allocateNode();
+  fNodes[newParent].fParent = oldParent;
+  fNodes[newParent].fBox = AABB::merge(leafBox, fNodes[sibling].fBox);
+  fNodes[newParent].fHeight = fNodes[sibling].fHeight + 1;
+  fNodes[newParent].fChild1 = sibling;
+  fNodes[newParent].fChild2 = leaf;
+  fNodes[sibling].fParent = newParent;
+  fNodes[leaf].fParent = newParent;
+
+  /* Replace the sibling with the new parent. */
+  if(oldParent != kNullNode)
+  {
+    if(fNodes[oldParent].fChild1 == sibling)
+    {
+      fNodes[oldParent].fChild1 = newParent;
+    }
+    else
+    {
+      fNodes[oldParent].fChild2 = newParent;
+    }
+  }
+  else
+  {
+    fRoot = newParent;
+  }
+
+  /* Fix the boxes and heights of the ancestors. */
+  refit(fNodes[leaf].fParent);
+}
+
+/******************************************************************************/
+void AABBTree::removeLeaf(int32_t leaf)
+{
+  /* Removing the root leaves an empty tree. */
+  if(leaf == fRoot)
+  {
+    fRoot = kNullNode;
+    return;
+  }
+
+  /* The parent is removed and the sibling takes it's place. */
+  int32_t parent = fNodes[leaf].fParent;
+  int32_t grandParent = fNodes[parent].fParent;
+  int32_t sibling = fNodes[parent].fChild1 == leaf ?
+    fNodes[parent].fChild2 : fNodes[parent].fChild1;
+
+  if(grandParent != kNullNode)
+  {
+    /* Connect the sibling to the grand parent. */
+    if(fNodes[grandParent].fChild1 == parent)
+    {
+      fNodes[grandParent].fChild1 = sibling;
+    }
+    else
+    {
+      fNodes[grandParent].fChild2 = sibling;
+    }
+    fNodes[sibling].fParent = grandParent;
+    freeNode(parent);
+
+    /* Fix the boxes and heights of the ancestors. */
+    refit(grandParent);
+  }
+  else
+  {
+    /* The sibling becomes the root. */
+    fRoot = sibling;
+    fNodes[sibling].fParent = kNullNode;
+    freeNode(parent);
+  }
+
+  /* The leaf is no longer linked to the tree. */
+  fNodes[leaf].fParent = kNullNode;
+}
+
+/******************************************************************************/
+void AABBTree::refit(int32_t index)
+{
+  while(index != kNullNode)
+  {
+    /* Balance the subtree first, it may have a new root. */
+    index = balance(index);
+
+    /* Recalculate the box and height from the children. */
+    Node & node = fNodes[index];
+    const Node & child1 = fNodes[node.fChild1];
+    const Node & child2 = fNodes[node.fChild2];
+    node.fHeight = 1 + std::max(child1.fHeight, child2.fHeight);
+    node.fBox = AABB::merge(child1.fBox, child2.fBox);
+
+    /* Move up to the parent. */
+    index = node.fParent;
+  }
+}
+
+/******************************************************************************/
+int32_t AABBTree::balance(int32_t iA)
+{
+  /* Leaves and nodes with only leaf children can not be imbalanced. */
+  Node & a = fNodes[iA];
+  if(a.isLeaf() || a.fHeight < 2)
+  {
+    return iA;
+  }
+
+  int32_t iB = a.fChild1;
+  int32_t iC = a.fChild2;
+  Node & b = fNodes[iB];
+  Node & c = fNodes[iC];
+  int32_t balance = c.fHeight - b.fHeight;
+
+  /* Rotate C up if the right subtree is too high. */
+  if(balance > 1)
+  {
+    int32_t iF = c.fChild1;
+    int32_t iG = c.fChild2;
+    Node & f = fNodes[iF];
+    Node & g = fNodes[iG];
+
+    /* Swap A and C. */
+    c.fChild1 = iA;
+    c.fParent = a.fParent;
+    a.fParent = iC;
+
+    /* A's old parent now points to C. */
+    if(c.fParent != kNullNode)
+    {
+      if(fNodes[c.fParent].fChild1 == iA)
+      {
+        fNodes[c.fParent].fChild1 = iC;
+      }
+      else
+      {
+        fNodes[c.fParent].fChild2 = iC;
+      }
+    }
+    else
+    {
+      fRoot = iC;
+    }
+
+    /* Keep the higher grand child under C and give the other to A. */
+    if(f.fHeight > g.fHeight)
+    {
+      c.fChild2 = iF;
+      a.fChild2 = iG;
+      g.fParent = iA;
+      a.fBox = AABB::merge(b.fBox, g.fBox);
+      c.fBox = AABB::merge(a.fBox, f.fBox);
+      a.fHeight = 1 + std::max(b.fHeight, g.fHeight);
+      c.fHeight = 1 + std::max(a.fHeight, f.fHeight);
+    }
+    else
+    {
+      c.fChild2 = iG;
+      a.fChild2 = iF;
+      f.fParent = iA;
+      a.fBox = AABB::merge(b.fBox, f.fBox);
+      c.fBox = AABB::merge(a.fBox, g.fBox);
+      a.fHeight = 1 + std::max(b.fHeight, f.fHeight);
+      c.fHeight = 1 + std::max(a.fHeight, g.fHeight);
+    }
+
+    return iC;
+  }
+
+  /* Rotate B up if the left subtree is too high. */
+  if(balance < -1)
+  {
+    int32_t iD = b.fChild1;
+    int32_t iE = b.fChild2;
+    Node & d = fNodes[iD];
+    Node & e = fNodes[iE];
+
+    /* Swap A and B. */
+    b.fChild1 = iA;
+    b.fParent = a.fParent;
+    a.fParent = iB;
+
+    /* A's old parent now points to B. */
+    if(b.fParent != kNullNode)
+    {
+      if(fNodes[b.fParent].fChild1 == iA)
+      {
+        fNodes[b.fParent].fChild1 = iB;
+      }
+      else
+      {
+        fNodes[b.fParent].fChild2 = iB;
+      }
+    }
+    else
+    {
+      fRoot = iB;
+    }
+
+    /* Keep the higher grand child under B and give the other to A. */
+    if(d.fHeight > e.fHeight)
+    {
+      b.fChild2 = iD;
+      a.fChild1 = iE;
+      e.fParent = iA;
+      a.fBox = AABB::merge(c.fBox, e.fBox);
+      b.fBox = AABB::merge(a.fBox, d.fBox);
+      a.fHeight = 1 + std::max(c.fHeight, e.fHeight);
+      b.fHeight = 1 + std::max(a.fHeight, d.fHeight);
+    }
+    else
+    {
+      b.fChild2 = iE;
+      a.fChild1 = iD;
+      d.fParent = iA;
+      a.fBox = AABB::merge(c.fBox, d.fBox);
+      b.fBox = AABB::merge(a.fBox, e.fBox);
+      a.fHeight = 1 + std::max(c.fHeight, d.fHeight);
+      b.fHeight = 1 + std::max(a.fHeight, e.fHeight);
+    }
+
+    return iB;
+  }
+
+  /* The subtree is balanced. */
+  return iA;
+}
+
+/******************************************************************************/
+bool AABBTree::validate() const
+{
+  /* An empty tree is valid. */
+  if(fRoot == kNullNode)
+  {
+    return fProxyCount == 0;
+  }
+
+  /* The root must not have a parent. */
+  if(fNodes[fRoot].fParent != kNullNode)
+  {
+    return false;
+  }
+
+  /* Check every node in the tree. */
+  size_t leafCount = 0;
+  std::vector<int32_t> stack(1, fRoot);
+  while(!stack.empty())
+  {
+    int32_t index = stack.back();
+    stack.pop_back();
+    const Node & node = fNodes[index];
+
+    if(node.isLeaf())
+    {
+      /* Leaves have a height of 0 and no second child. */
+      if(node.fHeight != 0 || node.fChild2 != kNullNode)
+      {
+        return false;
+      }
+      ++leafCount;
+      continue;
+    }
+
+    /* The children must point back to this node. */
+    const Node & child1 = fNodes[node.fChild1];
+    const Node & child2 = fNodes[node.fChild2];
+    if(child1.fParent != index || child2.fParent != index)
+    {
+      return false;
+    }
+
+    /* The height must be correct. */
+    if(node.fHeight != 1 + std::max(child1.fHeight, child2.fHeight))
+    {
+      return false;
+    }
+
+    /* The box must contain the children. */
+    if(!node.fBox.contains(child1.fBox) || !node.fBox.contains(child2.fBox))
+    {
+      return false;
+    }
+
+    stack.push_back(node.fChild1);
+    stack.push_back(node.fChild2);
+  }
+
+  /* Every proxy must be in the tree. */
+  return leafCount == fProxyCount;
+}
@@ -0,0 +1,166 @@
+#include "../../../Include/Anubis/Physics/BatchQuery.hpp"
+
+using namespace Anubis;
+using namespace Anubis::Physics;
+
+/** The number of queries per chunk of work. */
+static const size_t kQueryGrainSize = 64;
+
+/******************************************************************************/
+/* Run func(begin, end) over the queries on the pool or on this thread. */
+template <typename Func>
+static void runQueries(size_t count, TaskPool * pool, Func && func)
+{
+  if(pool)
+  {
+    pool->parallelFor(count, kQueryGrainSize, func);
+  }
+  else
+  {
+    func(0, count);
+  }
+}
+
+/******************************************************************************/
+/* Trace the rays of a range in packets, the chunks are multiples of the
+ * packet size so every packet but the last is full. */
+template <typename Func>
+static void runPackets(size_t count, TaskPool * pool, Func && func)
+{
+  const size_t packets = (count + BoundingMesh::kPacketSize - 1) /
+                         BoundingMesh::kPacketSize;
+  auto tracePackets = [&](size_t begin, size_t end)
+  {
+    for(size_t packet = begin; packet < end; packet++)
+    {
+      const size_t first = packet * BoundingMesh::kPacketSize;
+      func(first, std::min(count - first, BoundingMesh::kPacketSize));
+    }
+  };
+  if(pool)
+  {
+    pool->parallelFor(packets, kQueryGrainSize / BoundingMesh::kPacketSize,
+                      tracePackets);
+  }
+  else
+  {
+    tracePackets(0, packets);
+  }
+}
+
+/******************************************************************************/
+void BatchQuery::raycast(const BoundingMesh & mesh, const Math::Ray * rays,
+                         const float * maxT, size_t count, RayHit * hits,
+                         TaskPool * pool)
+{
+  runPackets(count, pool, [&](size_t first, size_t size)
+  {
+    float distances[BoundingMesh::kPacketSize];
+    uint32_t triangles[BoundingMesh::kPacketSize];
+    std::copy(maxT + first, maxT + first + size, distances);
+    mesh.raycast(rays + first, size, distances, triangles);
+    for(size_t k = 0; k < size; k++)
+    {
+      hits[first + k] = RayHit{distances[k], triangles[k]};
+    }
+  });
+}
+
+/******************************************************************************/
+void BatchQuery::occluded(const BoundingMesh & mesh, const Math::Ray * rays,
+                          const float * maxT, size_t count, uint8_t * blocked,
+                          TaskPool * pool)
+{
+  runPackets(count, pool, [&](size_t first, size_t size)
+  {
+    float distances[BoundingMesh::kPacketSize];
+    uint32_t triangles[BoundingMesh::kPacketSize];
+    std::copy(maxT + first, maxT + first + size, distances);
+    int mask = mesh.raycast(rays + first, size, distances, triangles, true);
+    for(size_t k = 0; k < size; k++)
+    {
+      blocked[first + k] = uint8_t((mask >> k) & 1);
+    }
+  });
+}
+
+/******************************************************************************/
+void BatchQuery::sweep(const BoundingMesh & mesh,
+                       const BoundingSphere * spheres,
+                       const Math::Vector4f * motions, size_t count,
+                       SweepHit * hits, TaskPool * pool)
+{
+  runQueries(count, pool, [&](size_t begin, size_t end)
+  {
+    for(size_t i = begin; i < end; i++)
+    {
+      SweepHit & hit = hits[i];
+      hit.fHit = Narrowphase::sweep(spheres[i], motions[i], mesh, hit.fTime,
+                                    hit.fContact);
+      if(!hit.fHit)
+      {
+        hit.fTime = 1.0f;
+      }
+    }
+  });
+}
+
+/******************************************************************************/
+void BatchQuery::overlap(const BoundingMesh & mesh,
+                         const BoundingSphere * spheres, size_t count,
+                         uint8_t * overlaps, TaskPool * pool)
+{
+  runQueries(count, pool, [&](size_t begin, size_t end)
+  {
+    for(size_t i = begin; i < end; i++)
+    {
+      overlaps[i] = mesh.overlaps(spheres[i].centre(), spheres[i].radius());
+    }
+  });
+}
+
+/******************************************************************************/
+void BatchQuery::overlap(const AABBTree & tree, const AABB * boxes,
+                         size_t count, size_t capacity, int32_t * proxies,
+                         uint32_t * found, TaskPool * pool)
+{
+  runQueries(count, pool, [&](size_t begin, size_t end)
+  {
+    for(size_t i = begin; i < end; i++)
+    {
+      /* Keep counting past the capacity so the caller sees the overflow. */
+      int32_t * results = proxies + i * capacity;
+      uint32_t total = 0;
+      tree.queryAABB(boxes[i], [&](int32_t proxy)
+      {
+        if(total < capacity)
+        {
+          results[total] = proxy;
+        }
+        ++total;
+        return true;
+      });
+      found[i] = total;
+    }
+  });
+}
+
+/******************************************************************************/
+void BatchQuery::nearest(const SpatialGrid & grid,
+                         const Math::Vector4f * positions, size_t count,
+                         size_t k, float maxRadius,
+                         SpatialGrid::Neighbour * neighbours, uint32_t * found,
+                         TaskPool * pool)
+{
+  runQueries(count, pool, [&](size_t begin, size_t end)
+  {
+    /* The scratch vector is shared by the queries of a chunk. */
+    std::vector<SpatialGrid::Neighbour> results;
+    for(size_t i = begin; i < end; i++)
+    {
+      grid.queryNearest(positions[i], k, maxRadius, results);
+      std::copy(results.begin(), results.end(), neighbours + i * k);
+      found[i] = uint32_t(results.size());
+    }
+  });
+}
@@ -11,5 +11,29 @@ BoundingBox::BoundingBox(float x1, float x2, float y1, float y2, float z1,
 void BoundingBox::intersect(const Math::Ray & ray,
                             std::vector<float> & distances)
 {
+  /* Intersect the ray with the slabs of the box. */
+  float tEntry, tExit;
+  if(!aabb().intersect(ray.origin(), AABB::inverseDirection(ray),
+                       std::numeric_limits<float>::max(), tEntry, tExit))
+  {
+    return;
+  }
 
+  /* The entry point is behind the ray if it starts inside the box. */
+  if(tEntry >= 0.0f)
+  {
+    distances.push_back(tEntry);
+  }
+
+  /* Add the exit point. */
+  distances.push_back(tExit);
+}
+
+/******************************************************************************/
+AABB BoundingBox::aabb() const
+{
+  return AABB(Math::Vector4f(std::min(fX1, fX2), std::min(fY1, fY2),
+                             std::min(fZ1, fZ2), 1.0f),
+              Math::Vector4f(std::max(fX1, fX2), std::max(fY1, fY2),
+                             std::max(fZ1, fZ2), 1.0f));
 }
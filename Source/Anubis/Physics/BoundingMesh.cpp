@@ -0,0 +1,920 @@
+#include "../../../Include/Anubis/Physics/BoundingMesh.hpp"
+
+using namespace Anubis::Physics;
+
+/** The number of bins used to evaluate the surface area heuristic. */
+static const size_t kBinCount = 12;
+
+/** The cost of traversing a node relative to testing a triangle. */
+static const float kTraversalCost = 1.0f;
+
+/** The magic number at the start of a serialised mesh, "AMSH". */
+static const uint32_t kSerialMagic = 0x48534D41;
+
+/** The version of the serialised format. */
+static const uint32_t kSerialVersion = 1;
+
+/******************************************************************************/
+/* Append raw bytes to a buffer. */
+static void appendBytes(std::vector<uint8_t> & data, const void * bytes,
+                        size_t size)
+{
+  const uint8_t * begin = static_cast<const uint8_t*>(bytes);
+  data.insert(data.end(), begin, begin + size);
+}
+
+/******************************************************************************/
+/* Read raw bytes from a buffer, exits if the buffer is too short. */
+static void readBytes(const uint8_t * data, size_t size, size_t & offset,
+                      void * bytes, size_t count)
+{
+  if(size - offset < count || offset > size)
+  {
+    ANUBIS_THROW_RUNTIME_EXCEPTION("The serialised mesh is truncated.");
+  }
+  memcpy(bytes, data + offset, count);
+  offset += count;
+}
+
+/******************************************************************************/
+BoundingMesh::BoundingMesh(const std::vector<Math::Vector4f> & vertices,
+                           const std::vector<uint32_t> & indices) :
+  BoundingVolume(Types::Mesh), fVertices(vertices), fIndices(indices)
+{
+  /* Every triangle needs three vertex indexes. */
+  if(fIndices.size() % 3 != 0)
+  {
+    ANUBIS_THROW_RUNTIME_EXCEPTION("The number of mesh indexes must be a "
+                                   "multiple of three.");
+  }
+
+  /* Calculate the box that encloses the vertices. */
+  if(!fVertices.empty())
+  {
+    fBounds = AABB(fVertices[0], fVertices[0]);
+    for(const Math::Vector4f & vertex : fVertices)
+    {
+      fBounds = AABB::merge(fBounds, AABB(vertex, vertex));
+    }
+  }
+
+  /* Build the hierarchy. */
+  build();
+}
+
+/******************************************************************************/
+BoundingMesh::BoundingMesh(const uint8_t * data, size_t size) :
+  BoundingVolume(Types::Mesh)
+{
+  /* Read and check the header. */
+  size_t offset = 0;
+  uint32_t header[5];
+  readBytes(data, size, offset, header, sizeof(header));
+  if(header[0] != kSerialMagic || header[1] != kSerialVersion)
+  {
+    ANUBIS_THROW_RUNTIME_EXCEPTION("The data is not a serialised mesh.");
+  }
+
+  /* Read the bounds. */
+  float bounds[6];
+  readBytes(data, size, offset, bounds, sizeof(bounds));
+  fBounds = AABB(Math::Vector4f(bounds[0], bounds[1], bounds[2], 1.0f),
+                 Math::Vector4f(bounds[3], bounds[4], bounds[5], 1.0f));
+
+  /* Make sure the data holds all the vertices, indexes and nodes before
+   * anything is allocated. The counts are 32 bit, thus the 64 bit products
+   * and sums can't overflow. */
+  const uint64_t required = uint64_t(header[2]) * 3 * sizeof(float) +
+                            uint64_t(header[3]) * sizeof(uint32_t) +
+                            uint64_t(header[4]) * sizeof(Node);
+  if(required > uint64_t(size - offset))
+  {
+    ANUBIS_THROW_RUNTIME_EXCEPTION("The serialised mesh is truncated.");
+  }
+
+  /* Every triangle needs three vertex indexes. */
+  if(header[3] % 3 != 0)
+  {
+    ANUBIS_THROW_RUNTIME_EXCEPTION("The serialised mesh is corrupt.");
+  }
+
+  /* Read the vertices. */
+  fVertices.resize(header[2]);
+  for(Math::Vector4f & vertex : fVertices)
+  {
+    float xyz[3];
+    readBytes(data, size, offset, xyz, sizeof(xyz));
+    vertex = Math::Vector4f(xyz[0], xyz[1], xyz[2], 1.0f);
+  }
+
+  /* Read the triangles and the nodes. */
+  fIndices.resize(header[3]);
+  readBytes(data, size, offset, fIndices.data(),
+            fIndices.size() * sizeof(uint32_t));
+  fNodes.resize(header[4]);
+  readBytes(data, size, offset, fNodes.data(), fNodes.size() * sizeof(Node));
+
+  /* Make sure the triangles refer to existing vertices. */
+  for(uint32_t index : fIndices)
+  {
+    if(index >= fVertices.size())
+    {
+      ANUBIS_THROW_RUNTIME_EXCEPTION("The serialised mesh is corrupt.");
+    }
+  }
+
+  /* Make sure the nodes form a tree: every internal child follows it's
+   * parent and has no other parent, and every leaf refers to existing
+   * triangles. Thus the traversals never loop or read out of bounds. */
+  const uint64_t triangles = triangleCount();
+  std::vector<bool> isChild(fNodes.size(), false);
+  for(size_t i = 0; i < fNodes.size(); i++)
+  {
+    const Node & node = fNodes[i];
+    for(size_t k = 0; k < 4; k++)
+    {
+      uint32_t child = node.fChildren[k];
+      uint32_t count = node.fCounts[k];
+      if(count == kEmptySlot)
+      {
+        continue;
+      }
+
+      if(count == 0 ? child <= i || child >= fNodes.size() || isChild[child] :
+                      uint64_t(child) + count > triangles)
+      {
+        ANUBIS_THROW_RUNTIME_EXCEPTION("The serialised mesh is corrupt.");
+      }
+
+      if(count == 0)
+      {
+        isChild[child] = true;
+      }
+    }
+  }
+}
+
+/******************************************************************************/
+void BoundingMesh::build()
+{
+  /* An empty mesh has no hierarchy. */
+  fNodes.clear();
+  const uint32_t count = uint32_t(triangleCount());
+  if(count == 0)
+  {
+    return;
+  }
+
+  /* Calculate the box and the centroid of every triangle. */
+  std::vector<AABB> bounds(count);
+  std::vector<Math::Vector4f> centroids(count);
+  std::vector<uint32_t> order(count);
+  for(uint32_t i = 0; i < count; i++)
+  {
+    bounds[i] = triangle(i).bounds();
+    centroids[i] = (bounds[i].fMin + bounds[i].fMax) * 0.5f;
+    order[i] = i;
+  }
+
+  /* Build the binary hierarchy. */
+  std::vector<BuildNode> nodes;
+  nodes.reserve(count * 2);
+  uint32_t root = buildBinary(nodes, order, centroids, bounds, 0, count);
+
+  /* Reorder the triangles so that the leaves refer to contiguous ranges. */
+  std::vector<uint32_t> indices(fIndices.size());
+  for(uint32_t i = 0; i < count; i++)
+  {
+    memcpy(&indices[i * 3], &fIndices[order[i] * 3], 3 * sizeof(uint32_t));
+  }
+  fIndices.swap(indices);
+
+  /* Flatten the hierarchy. A mesh that fits in a single leaf gets a root
+   * node with one child. */
+  fNodes.reserve(nodes.size() / 2 + 1);
+  if(nodes[root].fCount == 0)
+  {
+    flatten(nodes, root);
+  }
+  else
+  {
+    BuildNode parent = BuildNode();
+    parent.fChildren[0] = root;
+    parent.fChildren[1] = root;
+    nodes.push_back(parent);
+    flatten(nodes, uint32_t(nodes.size() - 1));
+    fNodes[0].fCounts[1] = kEmptySlot;
+    fNodes[0].fMinX[1] = fNodes[0].fMinY[1] = fNodes[0].fMinZ[1] =
+      std::numeric_limits<float>::max();
+    fNodes[0].fMaxX[1] = fNodes[0].fMaxY[1] = fNodes[0].fMaxZ[1] =
+      -std::numeric_limits<float>::max();
+  }
+}
+
+/******************************************************************************/
+uint32_t BoundingMesh::buildBinary(std::vector<BuildNode> & nodes,
+                                   std::vector<uint32_t> & order,
+                                   const std::vector<Math::Vector4f> & centroids,
+                                   const std::vector<AABB> & bounds,
+                                   uint32_t first, uint32_t count)
+{
+  /* Calculate the box of the triangles and of their centroids. */
+  AABB box = bounds[order[first]];
+  AABB centroidBox(centroids[order[first]], centroids[order[first]]);
+  for(uint32_t i = first + 1; i < first + count; i++)
+  {
+    box = AABB::merge(box, bounds[order[i]]);
+    centroidBox = AABB::merge(centroidBox,
+                              AABB(centroids[order[i]], centroids[order[i]]));
+  }
+
+  /* Create the node, the children are filled in below. */
+  uint32_t index = uint32_t(nodes.size());
+  nodes.push_back(BuildNode());
+  nodes[index].fBox = box;
+  nodes[index].fFirst = first;
+  nodes[index].fCount = count;
+  if(count == 1)
+  {
+    return index;
+  }
+
+  /* Split along the axis with the largest spread of centroids. */
+  Math::Vector4f extent = centroidBox.fMax - centroidBox.fMin;
+  size_t axis = extent.y() > extent.x() ? 1 : 0;
+  axis = extent.z() > extent.memory()[axis] ? 2 : axis;
+  const float axisMin = centroidBox.fMin.memory()[axis];
+  const float axisExtent = extent.memory()[axis];
+
+  uint32_t mid = first + count / 2;
+  if(axisExtent > 0.0f)
+  {
+    /* Sort the triangles into bins along the axis. */
+    AABB binBoxes[kBinCount];
+    uint32_t binCounts[kBinCount] = {};
+    const float scale = float(kBinCount) / axisExtent;
+    auto binOf = [&](uint32_t triangle)
+    {
+      size_t bin = size_t((centroids[triangle].memory()[axis] - axisMin) *
+                          scale);
+      return std::min(bin, kBinCount - 1);
+    };
+    for(uint32_t i = first; i < first + count; i++)
+    {
+      size_t bin = binOf(order[i]);
+      binBoxes[bin] = binCounts[bin] ? AABB::merge(binBoxes[bin],
+        bounds[order[i]]) : bounds[order[i]];
+      ++binCounts[bin];
+    }
+
+    /* Calculate the cost of the triangles to the right of every split. */
+    float rightCosts[kBinCount] = {};
+    AABB sweep;
+    uint32_t sweepCount = 0;
+    for(size_t bin = kBinCount - 1; bin > 0; bin--)
+    {
+      if(binCounts[bin])
+      {
+        sweep = sweepCount ? AABB::merge(sweep, binBoxes[bin]) :
+                             binBoxes[bin];
+        sweepCount += binCounts[bin];
+      }
+      rightCosts[bin] = sweepCount ? sweep.surfaceArea() * sweepCount : 0.0f;
+    }
+
+    /* Add the cost of the triangles to the left and find the cheapest. */
+    float bestCost = std::numeric_limits<float>::max();
+    size_t bestSplit = 0;
+    sweepCount = 0;
+    for(size_t bin = 0; bin + 1 < kBinCount; bin++)
+    {
+      if(binCounts[bin])
+      {
+        sweep = sweepCount ? AABB::merge(sweep, binBoxes[bin]) :
+                             binBoxes[bin];
+        sweepCount += binCounts[bin];
+      }
+
+      /* Both sides of the split must have triangles. */
+      if(sweepCount == 0 || sweepCount == count)
+      {
+        continue;
+      }
+
+      float cost = sweep.surfaceArea() * sweepCount + rightCosts[bin + 1];
+      if(cost < bestCost)
+      {
+        bestCost = cost;
+        bestSplit = bin + 1;
+      }
+    }
+
+    /* Make a leaf if testing all the triangles is cheaper than splitting. */
+    float leafCost = box.surfaceArea() * count;
+    bestCost += kTraversalCost * box.surfaceArea();
+    if(count <= kMaxLeafTriangles && leafCost <= bestCost)
+    {
+      return index;
+    }
+
+    /* Partition the triangles at the split. */
+    mid = uint32_t(std::partition(order.begin() + first,
+      order.begin() + first + count, [&](uint32_t triangle)
+    {
+      return binOf(triangle) < bestSplit;
+    }) - order.begin());
+  }
+  else if(count <= kMaxLeafTriangles)
+  {
+    /* The centroids are all the same, there is nothing to split. */
+    return index;
+  }
+
+  /* Split in the middle if the binning failed to separate the triangles. */
+  if(mid == first || mid == first + count)
+  {
+    mid = first + count / 2;
+    std::nth_element(order.begin() + first, order.begin() + mid,
+      order.begin() + first + count, [&](uint32_t lhs, uint32_t rhs)
+    {
+      return centroids[lhs].memory()[axis] < centroids[rhs].memory()[axis];
+    });
+  }
+
+  /* Build the children. */
+  uint32_t left = buildBinary(nodes, order, centroids, bounds, first,
+                              mid - first);
+  uint32_t right = buildBinary(nodes, order, centroids, bounds, mid,
+                               first + count - mid);
+  nodes[index].fChildren[0] = left;
+  nodes[index].fChildren[1] = right;
+  nodes[index].fCount = 0;
+  return index;
+}
+
+/******************************************************************************/
+uint32_t BoundingMesh::flatten(const std::vector<BuildNode> & nodes,
+                               uint32_t index)
+{
+  /* Create the node with all slots unused. */
+  uint32_t flatIndex = uint32_t(fNodes.size());
+  fNodes.push_back(Node());
+  for(size_t k = 0; k < 4; k++)
+  {
+    Node & node = fNodes[flatIndex];
+    node.fMinX[k] = node.fMinY[k] = node.fMinZ[k] =
+      std::numeric_limits<float>::max();
+    node.fMaxX[k] = node.fMaxY[k] = node.fMaxZ[k] =
+      -std::numeric_limits<float>::max();
+    node.fChildren[k] = 0;
+    node.fCounts[k] = kEmptySlot;
+  }
+
+  /* Pull up grandchildren until there are four children, always opening the
+   * internal child with the largest surface area. */
+  uint32_t children[4] = {nodes[index].fChildren[0],
+                          nodes[index].fChildren[1]};
+  size_t childCount = 2;
+  while(childCount < 4)
+  {
+    size_t largest = childCount;
+    float largestArea = -1.0f;
+    for(size_t k = 0; k < childCount; k++)
+    {
+      const BuildNode & child = nodes[children[k]];
+      if(child.fCount == 0 && child.fBox.surfaceArea() > largestArea)
+      {
+        largest = k;
+        largestArea = child.fBox.surfaceArea();
+      }
+    }
+
+    /* All the children are leaves. */
+    if(largest == childCount)
+    {
+      break;
+    }
+
+    const BuildNode & opened = nodes[children[largest]];
+    children[largest] = opened.fChildren[0];
+    children[childCount++] = opened.fChildren[1];
+  }
+
+  /* Fill in the children, flattening the internal ones. */
+  for(size_t k = 0; k < childCount; k++)
+  {
+    const BuildNode & child = nodes[children[k]];
+    uint32_t target = child.fCount ? child.fFirst : flatten(nodes, children[k]);
+
+    Node & node = fNodes[flatIndex];
+    node.fMinX[k] = child.fBox.fMin.x();
+    node.fMinY[k] = child.fBox.fMin.y();
+    node.fMinZ[k] = child.fBox.fMin.z();
+    node.fMaxX[k] = child.fBox.fMax.x();
+    node.fMaxY[k] = child.fBox.fMax.y();
+    node.fMaxZ[k] = child.fBox.fMax.z();
+    node.fChildren[k] = target;
+    node.fCounts[k] = child.fCount;
+  }
+
+  return flatIndex;
+}
+
+/******************************************************************************/
+bool BoundingMesh::raycast(const Math::Ray & ray, float maxT, float & distance,
+                           size_t & triangle) const
+{
+  /* Nothing to hit in an empty mesh. */
+  if(fNodes.empty())
+  {
+    return false;
+  }
+
+  uint32_t hit;
+  if(!traceRay(0, ray, maxT, hit, false))
+  {
+    return false;
+  }
+  distance = maxT;
+  triangle = hit;
+  return true;
+}
+
+/******************************************************************************/
+bool BoundingMesh::traceRay(uint32_t root, const Math::Ray & ray, float & maxT,
+                            uint32_t & triangle, bool anyHit) const
+{
+  bool isHit = false;
+  const Math::Vector4f invDir = AABB::inverseDirection(ray);
+  TraversalStack<uint32_t> stack;
+  stack.push(root);
+  while(!stack.empty())
+  {
+    /* Find the children the ray hits before the closest hit so far. */
+    const Node & node = fNodes[stack.pop()];
+    float tEntry[4];
+    int mask = rayMask4(node, ray.origin(), invDir, maxT, tEntry);
+
+    /* Test the triangles of the leaves and collect the internal children. */
+    uint32_t inner[4];
+    float innerEntry[4];
+    size_t innerCount = 0;
+    while(mask)
+    {
+      int k = Common::Bits::countTrailingZeros(mask);
+      mask &= mask - 1;
+
+      uint32_t count = node.fCounts[k];
+      if(count == 0)
+      {
+        inner[innerCount] = node.fChildren[k];
+        innerEntry[innerCount++] = tEntry[k];
+      }
+      else if(count != kEmptySlot)
+      {
+        for(uint32_t i = node.fChildren[k]; i < node.fChildren[k] + count; i++)
+        {
+          float t;
+          if(this->triangle(i).intersect(ray.origin(), ray.direction(), t) &&
+             t <= maxT)
+          {
+            maxT = t;
+            triangle = i;
+            isHit = true;
+            if(anyHit)
+            {
+              return true;
+            }
+          }
+        }
+      }
+    }
+
+    /* Push the internal children so that the closest is visited first. */
+    for(size_t i = 1; i < innerCount; i++)
+    {
+      for(size_t j = i; j > 0 && innerEntry[j - 1] < innerEntry[j]; j--)
+      {
+        std::swap(innerEntry[j - 1], innerEntry[j]);
+        std::swap(inner[j - 1], inner[j]);
+      }
+    }
+    for(size_t i = 0; i < innerCount; i++)
+    {
+      stack.push(inner[i]);
+    }
+  }
+
+  return isHit;
+}
+
+/******************************************************************************/
+int BoundingMesh::intersectPacket(const Triangle & triangle,
+                                  const RayPacket & packet, float * t)
+{
+  #ifdef ANUBIS_HAS_SSE
+    /* Triangle::intersect() for four rays, in the same order of operations
+     * so the results match it. */
+    const Math::Vector4f edge1 = triangle.fB - triangle.fA;
+    const Math::Vector4f edge2 = triangle.fC - triangle.fA;
+    const __m128 e1x = _mm_set1_ps(edge1.x()), e1y = _mm_set1_ps(edge1.y());
+    const __m128 e1z = _mm_set1_ps(edge1.z()), e2x = _mm_set1_ps(edge2.x());
+    const __m128 e2y = _mm_set1_ps(edge2.y()), e2z = _mm_set1_ps(edge2.z());
+    const __m128 dx = _mm_load_ps(packet.fDirection[0]);
+    const __m128 dy = _mm_load_ps(packet.fDirection[1]);
+    const __m128 dz = _mm_load_ps(packet.fDirection[2]);
+
+    /* p = direction x edge2, det = edge1 . p */
+    const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px),
+      _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+    const __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+    /* The barycentric coordinates of the crossings. */
+    const __m128 sx = _mm_sub_ps(_mm_load_ps(packet.fOrigin[0]),
+                                 _mm_set1_ps(triangle.fA.x()));
+    const __m128 sy = _mm_sub_ps(_mm_load_ps(packet.fOrigin[1]),
+                                 _mm_set1_ps(triangle.fA.y()));
+    const __m128 sz = _mm_sub_ps(_mm_load_ps(packet.fOrigin[2]),
+                                 _mm_set1_ps(triangle.fA.z()));
+    const __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px),
+      _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDet);
+    const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+    const __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx),
+      _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+    const __m128 distance = _mm_mul_ps(_mm_add_ps(_mm_add_ps(
+      _mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+
+    /* Only the crossings inside the triangle, in front of the rays and
+     * before their closest hits count. */
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    __m128 valid = _mm_and_ps(_mm_cmpneq_ps(det, zero),
+      _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+    valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(v, zero),
+      _mm_cmple_ps(_mm_add_ps(u, v), one)));
+    valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(distance, zero),
+      _mm_cmple_ps(distance, _mm_load_ps(packet.fMaxT))));
+    _mm_storeu_ps(t, distance);
+    return _mm_movemask_ps(valid);
+  #else
+    /* Test the rays one by one. */
+    int mask = 0;
+    for(size_t k = 0; k < kPacketSize; k++)
+    {
+      Math::Vector4f origin(packet.fOrigin[0][k], packet.fOrigin[1][k],
+                            packet.fOrigin[2][k], 1.0f);
+      Math::Vector4f direction(packet.fDirection[0][k],
+        packet.fDirection[1][k], packet.fDirection[2][k], 0.0f);
+      if(triangle.intersect(origin, direction, t[k]) &&
+         t[k] <= packet.fMaxT[k])
+      {
+        mask |= 1 << k;
+      }
+    }
+    return mask;
+  #endif /* ANUBIS_HAS_SSE */
+}
+
+/******************************************************************************/
+int BoundingMesh::raycast(const Math::Ray * rays, size_t count, float * maxT,
+                          uint32_t * triangles, bool anyHit) const
+{
+  /* The lanes without a ray repeat the first ray and are never active. */
+  int active = (1 << count) - 1, hits = 0;
+  RayPacket packet;
+  for(size_t k = 0; k < kPacketSize; k++)
+  {
+    const size_t ray = k < count ? k : 0;
+    const Math::Vector4f & origin = rays[ray].origin();
+    const Math::Vector4f invDir = AABB::inverseDirection(rays[ray]);
+    packet.fOrigin[0][k] = origin.x();
+    packet.fOrigin[1][k] = origin.y();
+    packet.fOrigin[2][k] = origin.z();
+    packet.fDirection[0][k] = rays[ray].direction().x();
+    packet.fDirection[1][k] = rays[ray].direction().y();
+    packet.fDirection[2][k] = rays[ray].direction().z();
+    packet.fInvDir[0][k] = invDir.x();
+    packet.fInvDir[1][k] = invDir.y();
+    packet.fInvDir[2][k] = invDir.z();
+    packet.fMaxT[k] = maxT[ray];
+    if(k < count)
+    {
+      triangles[k] = kNoTriangle;
+    }
+  }
+
+  /* Every entry of the stack holds a node and the rays that reach it. */
+  TraversalStack<std::pair<uint32_t, int>> stack;
+  if(!fNodes.empty() && active)
+  {
+    stack.push(std::make_pair(0u, active));
+  }
+  while(!stack.empty())
+  {
+    /* The rays that stopped at a hit since the node was pushed are
+     * dropped. */
+    std::pair<uint32_t, int> entry = stack.pop();
+    const int lanes = entry.second & active;
+    if(!lanes)
+    {
+      continue;
+    }
+
+    /* A single ray tests the four children at once instead. */
+    if(!(lanes & (lanes - 1)))
+    {
+      const int k = Common::Bits::countTrailingZeros(lanes);
+      if(traceRay(entry.first, rays[k], packet.fMaxT[k], triangles[k], anyHit))
+      {
+        hits |= lanes;
+        if(anyHit)
+        {
+          active &= ~lanes;
+        }
+      }
+      continue;
+    }
+
+    /* Test every child against the rays that reach the node. */
+    const Node & node = fNodes[entry.first];
+    uint32_t inner[4];
+    int innerLanes[4];
+    float innerEntry[4];
+    size_t innerCount = 0;
+    for(size_t child = 0; child < 4; child++)
+    {
+      uint32_t count = node.fCounts[child];
+      if(count == kEmptySlot)
+      {
+        continue;
+      }
+      float tEntry[kPacketSize];
+      int mask = packetMask(node, child, packet, tEntry) & lanes & active;
+      if(!mask)
+      {
+        continue;
+      }
+
+      /* Collect the internal children with the closest entry of their
+       * rays. */
+      if(count == 0)
+      {
+        float closest = std::numeric_limits<float>::max();
+        for(int bits = mask; bits; bits &= bits - 1)
+        {
+          const int k = Common::Bits::countTrailingZeros(bits);
+          closest = std::min(closest, tEntry[k]);
+        }
+        inner[innerCount] = node.fChildren[child];
+        innerLanes[innerCount] = mask;
+        innerEntry[innerCount++] = closest;
+        continue;
+      }
+
+      /* Test the triangles of leaves against the rays that hit them. */
+      for(uint32_t i = node.fChildren[child];
+          i < node.fChildren[child] + count && mask; i++)
+      {
+        float t[kPacketSize];
+        for(int bits = intersectPacket(this->triangle(i), packet, t) & mask;
+            bits; bits &= bits - 1)
+        {
+          const int k = Common::Bits::countTrailingZeros(bits);
+          packet.fMaxT[k] = t[k];
+          triangles[k] = i;
+          hits |= 1 << k;
+          if(anyHit)
+          {
+            active &= ~(1 << k);
+            mask &= ~(1 << k);
+          }
+        }
+      }
+    }
+
+    /* Push the internal children so that the closest is visited first. */
+    for(size_t i = 1; i < innerCount; i++)
+    {
+      for(size_t j = i; j > 0 && innerEntry[j - 1] < innerEntry[j]; j--)
+      {
+        std::swap(innerEntry[j - 1], innerEntry[j]);
+        std::swap(innerLanes[j - 1], innerLanes[j]);
+        std::swap(inner[j - 1], inner[j]);
+      }
+    }
+    for(size_t i = 0; i < innerCount; i++)
+    {
+      stack.push(std::make_pair(inner[i], innerLanes[i]));
+    }
+  }
+
+  for(int bits = hits; bits; bits &= bits - 1)
+  {
+    const int k = Common::Bits::countTrailingZeros(bits);
+    maxT[k] = packet.fMaxT[k];
+  }
+  return hits;
+}
+
+/******************************************************************************/
+bool BoundingMesh::overlaps(const AABB & box) const
+{
+  /* Stop at the first triangle that overlaps the box. */
+  bool isOverlapping = false;
+  queryAABB(box, [&](size_t index)
+  {
+    isOverlapping = triangle(index).overlaps(box);
+    return !isOverlapping;
+  });
+  return isOverlapping;
+}
+
+/******************************************************************************/
+bool BoundingMesh::overlaps(const Math::Vector4f & centre, float radius) const
+{
+  /* Stop at the first triangle that overlaps the sphere. */
+  Math::Vector4f extent(radius, radius, radius, 0.0f);
+  bool isOverlapping = false;
+  queryAABB(AABB(centre - extent, centre + extent), [&](size_t index)
+  {
+    isOverlapping = triangle(index).overlaps(centre, radius);
+    return !isOverlapping;
+  });
+  return isOverlapping;
+}
+
+/******************************************************************************/
+bool BoundingMesh::closestPoint(const Math::Vector4f & position,
+                                float maxDistance, Math::Vector4f & point,
+                                size_t & triangle) const
+{
+  /* Nothing to find in an empty mesh. */
+  bool isFound = false;
+  if(fNodes.empty())
+  {
+    return false;
+  }
+
+  /* The nodes are stored with their distance so that nodes further than the
+   * closest point found so far can be skipped. */
+  float bestSq = maxDistance * maxDistance;
+  TraversalStack<std::pair<float, uint32_t>> stack;
+  stack.push(std::make_pair(0.0f, 0u));
+  while(!stack.empty())
+  {
+    std::pair<float, uint32_t> entry = stack.pop();
+    if(entry.first > bestSq)
+    {
+      continue;
+    }
+
+    /* Calculate the distance to the boxes of the children. */
+    const Node & node = fNodes[entry.second];
+    std::pair<float, uint32_t> inner[4];
+    size_t innerCount = 0;
+    for(size_t k = 0; k < 4 && node.fCounts[k] != kEmptySlot; k++)
+    {
+      float dx = std::max(std::max(node.fMinX[k] - position.x(), 0.0f),
+                          position.x() - node.fMaxX[k]);
+      float dy = std::max(std::max(node.fMinY[k] - position.y(), 0.0f),
+                          position.y() - node.fMaxY[k]);
+      float dz = std::max(std::max(node.fMinZ[k] - position.z(), 0.0f),
+                          position.z() - node.fMaxZ[k]);
+      float distanceSq = dx * dx + dy * dy + dz * dz;
+      if(distanceSq > bestSq)
+      {
+        continue;
+      }
+
+      /* Collect the internal children. */
+      if(node.fCounts[k] == 0)
+      {
+        inner[innerCount++] = std::make_pair(distanceSq, node.fChildren[k]);
+        continue;
+      }
+
+      /* Test the triangles of the leaves. */
+      for(uint32_t i = node.fChildren[k];
+          i < node.fChildren[k] + node.fCounts[k]; i++)
+      {
+        Math::Vector4f candidate = this->triangle(i).closestPoint(position);
+        Math::Vector4f offset = candidate - position;
+        float candidateSq = offset.dot(offset);
+        if(candidateSq <= bestSq)
+        {
+          bestSq = candidateSq;
+          point = candidate;
+          triangle = i;
+          isFound = true;
+        }
+      }
+    }
+
+    /* Push the internal children so that the closest is visited first. There
+     * are at most four, thus an insertion sort is enough. */
+    for(size_t i = 1; i < innerCount; i++)
+    {
+      std::pair<float, uint32_t> child = inner[i];
+      size_t j = i;
+      for(; j > 0 && inner[j - 1] < child; j--)
+      {
+        inner[j] = inner[j - 1];
+      }
+      inner[j] = child;
+    }
+    for(size_t i = 0; i < innerCount; i++)
+    {
+      stack.push(inner[i]);
+    }
+  }
+
+  return isFound;
+}
+
+/******************************************************************************/
+void BoundingMesh::serialise(std::vector<uint8_t> & data) const
+{
+  /* Write the header. */
+  const uint32_t header[5] = {kSerialMagic, kSerialVersion,
+                              uint32_t(fVertices.size()),
+                              uint32_t(fIndices.size()),
+                              uint32_t(fNodes.size())};
+  appendBytes(data, header, sizeof(header));
+
+  /* Write the bounds. */
+  const float bounds[6] = {fBounds.fMin.x(), fBounds.fMin.y(),
+                           fBounds.fMin.z(), fBounds.fMax.x(),
+                           fBounds.fMax.y(), fBounds.fMax.z()};
+  appendBytes(data, bounds, sizeof(bounds));
+
+  /* Write the vertices without their W component. */
+  for(const Math::Vector4f & vertex : fVertices)
+  {
+    appendBytes(data, vertex.memory(), 3 * sizeof(float));
+  }
+
+  /* Write the triangles and the nodes. */
+  appendBytes(data, fIndices.data(), fIndices.size() * sizeof(uint32_t));
+  appendBytes(data, fNodes.data(), fNodes.size() * sizeof(Node));
+}
+
+/******************************************************************************/
+void BoundingMesh::intersect(const Math::Ray & ray,
+                             std::vector<float> & distances)
+{
+  /* Nothing to hit in an empty mesh. */
+  if(fNodes.empty())
+  {
+    return;
+  }
+
+  /* Collect the crossings of every triangle in the leaves the ray hits. */
+  const size_t first = distances.size();
+  const Math::Vector4f invDir = AABB::inverseDirection(ray);
+  TraversalStack<uint32_t> stack;
+  stack.push(0);
+  while(!stack.empty())
+  {
+    const Node & node = fNodes[stack.pop()];
+    float tEntry[4];
+    int mask = rayMask4(node, ray.origin(), invDir,
+                        std::numeric_limits<float>::max(), tEntry);
+    while(mask)
+    {
+      int k = Common::Bits::countTrailingZeros(mask);
+      mask &= mask - 1;
+
+      /* Descend into internal children. */
+      uint32_t count = node.fCounts[k];
+      if(count == 0)
+      {
+        stack.push(node.fChildren[k]);
+        continue;
+      }
+
+      /* Test the triangles of leaves. */
+      for(uint32_t i = 0; count != kEmptySlot && i < count; i++)
+      {
+        float t;
+        if(triangle(node.fChildren[k] + i).intersect(ray.origin(),
+                                                     ray.direction(), t))
+        {
+          distances.push_back(t);
+        }
+      }
+    }
+  }
+
+  /* Return the distances in ascending order. */
+  std::sort(distances.begin() + first, distances.end());
+}
+
+/******************************************************************************/
+AABB BoundingMesh::aabb() const
+{
+  return fBounds;
+}
@@ -0,0 +1,53 @@
+#include "../../../Include/Anubis/Physics/BoundingSphere.hpp"
+
+using namespace Anubis::Physics;
+
+/******************************************************************************/
+BoundingSphere::BoundingSphere(float x, float y, float z, float radius) :
+  BoundingVolume(Types::Sphere), fCentre(x, y, z, 1.0f), fRadius(radius) {}
+
+/******************************************************************************/
+void BoundingSphere::intersect(const Math::Ray & ray,
+                               std::vector<float> & distances)
+{
+  /* Solve |origin + t * dir - centre|^2 = radius^2 for t. */
+  const Math::Vector4f & dir = ray.direction();
+  Math::Vector4f oc = ray.origin() - fCentre;
+  float a = dir.dot(dir);
+  float b = oc.dot(dir);
+  float c = oc.dot(oc) - fRadius * fRadius;
+  float discriminant = b * b - a * c;
+
+  /* The ray misses the sphere. */
+  if(discriminant < 0.0f || a == 0.0f)
+  {
+    return;
+  }
+
+  /* Calculate the entry and exit distances. */
+  float root = std::sqrt(discriminant);
+  float tEntry = (-b - root) / a;
+  float tExit = (-b + root) / a;
+
+  /* The sphere is behind the ray. */
+  if(tExit < 0.0f)
+  {
+    return;
+  }
+
+  /* The entry point is behind the ray if it starts inside the sphere. */
+  if(tEntry >= 0.0f)
+  {
+    distances.push_back(tEntry);
+  }
+
+  /* Add the exit point. */
+  distances.push_back(tExit);
+}
+
+/******************************************************************************/
+AABB BoundingSphere::aabb() const
+{
+  Math::Vector4f extent(fRadius, fRadius, fRadius, 0.0f);
+  return AABB(fCentre - extent, fCentre + extent);
+}
@@ -0,0 +1,528 @@
+#include "../../../Include/Anubis/Physics/BoundingVolumeSet.hpp"
+
+using namespace Anubis::Physics;
+
+/******************************************************************************/
+uint32_t BoundingVolumeSet::allocateSlot(Slots & slots, uint32_t dense)
+{
+  /* Get a slot, either recycled or new. */
+  uint32_t slot = slots.fFreeList;
+  if(slot != kNullVolume)
+  {
+    slots.fFreeList = slots.fDense[slot];
+    slots.fDense[slot] = dense;
+  }
+  else
+  {
+    slot = uint32_t(slots.fDense.size());
+    slots.fDense.push_back(dense);
+  }
+
+  /* Map the dense index back to the slot. */
+  slots.fSlots.push_back(slot);
+  return slot;
+}
+
+/******************************************************************************/
+uint32_t BoundingVolumeSet::releaseSlot(Slots & slots, uint32_t slot)
+{
+  /* The last dense entry is moved into the gap. */
+  uint32_t dense = slots.fDense[slot];
+  uint32_t lastSlot = slots.fSlots.back();
+  slots.fSlots[dense] = lastSlot;
+  slots.fDense[lastSlot] = dense;
+  slots.fSlots.pop_back();
+
+  /* Put the slot on the free list. */
+  slots.fDense[slot] = slots.fFreeList;
+  slots.fFreeList = slot;
+  return dense;
+}
+
+/******************************************************************************/
+void BoundingVolumeSet::reserve(size_t boxCount, size_t sphereCount)
+{
+  /* Reserve the box arrays. */
+  fBoxMinX.reserve(boxCount);
+  fBoxMinY.reserve(boxCount);
+  fBoxMinZ.reserve(boxCount);
+  fBoxMaxX.reserve(boxCount);
+  fBoxMaxY.reserve(boxCount);
+  fBoxMaxZ.reserve(boxCount);
+  fBoxSlots.fDense.reserve(boxCount);
+  fBoxSlots.fSlots.reserve(boxCount);
+
+  /* Reserve the sphere arrays. */
+  fSphereX.reserve(sphereCount);
+  fSphereY.reserve(sphereCount);
+  fSphereZ.reserve(sphereCount);
+  fSphereRadius.reserve(sphereCount);
+  fSphereSlots.fDense.reserve(sphereCount);
+  fSphereSlots.fSlots.reserve(sphereCount);
+}
+
+/******************************************************************************/
+void BoundingVolumeSet::clear()
+{
+  /* Clear the boxes. */
+  fBoxMinX.clear();
+  fBoxMinY.clear();
+  fBoxMinZ.clear();
+  fBoxMaxX.clear();
+  fBoxMaxY.clear();
+  fBoxMaxZ.clear();
+  fBoxSlots.clear();
+
+  /* Clear the spheres. */
+  fSphereX.clear();
+  fSphereY.clear();
+  fSphereZ.clear();
+  fSphereRadius.clear();
+  fSphereSlots.clear();
+}
+
+/******************************************************************************/
+BoundingVolumeSet::VolumeID BoundingVolumeSet::add(
+  const BoundingVolume & volume)
+{
+  switch(volume.type())
+  {
+    case BoundingVolume::Types::Box:
+    {
+      /* Append the box to the box arrays. */
+      uint32_t dense = uint32_t(fBoxMinX.size());
+      fBoxMinX.push_back(0.0f);
+      fBoxMinY.push_back(0.0f);
+      fBoxMinZ.push_back(0.0f);
+      fBoxMaxX.push_back(0.0f);
+      fBoxMaxY.push_back(0.0f);
+      fBoxMaxZ.push_back(0.0f);
+      VolumeID id = makeID(BoundingVolume::Types::Box,
+                           allocateSlot(fBoxSlots, dense));
+      update(id, volume);
+      return id;
+    }
+
+    case BoundingVolume::Types::Sphere:
+    {
+      /* Append the sphere to the sphere arrays. */
+      uint32_t dense = uint32_t(fSphereX.size());
+      fSphereX.push_back(0.0f);
+      fSphereY.push_back(0.0f);
+      fSphereZ.push_back(0.0f);
+      fSphereRadius.push_back(0.0f);
+      VolumeID id = makeID(BoundingVolume::Types::Sphere,
+                           allocateSlot(fSphereSlots, dense));
+      update(id, volume);
+      return id;
+    }
+
+    default:
+      ANUBIS_THROW_RUNTIME_EXCEPTION("The bounding volume type is not "
+                                     "supported by BoundingVolumeSet.");
+  }
+
+  return kNullVolume;
+}
+
+/******************************************************************************/
+void BoundingVolumeSet::update(VolumeID id, const BoundingVolume & volume)
+{
+  /* The volume must not change it's type. */
+  assert(typeOf(id) == volume.type());
+
+  switch(typeOf(id))
+  {
+    case BoundingVolume::Types::Box:
+    {
+      /* Copy the ordered corners of the box. */
+      uint32_t dense = fBoxSlots.fDense[slotOf(id)];
+      AABB box = static_cast<const BoundingBox &>(volume).aabb();
+      fBoxMinX[dense] = box.fMin.x();
+      fBoxMinY[dense] = box.fMin.y();
+      fBoxMinZ[dense] = box.fMin.z();
+      fBoxMaxX[dense] = box.fMax.x();
+      fBoxMaxY[dense] = box.fMax.y();
+      fBoxMaxZ[dense] = box.fMax.z();
+      break;
+    }
+
+    case BoundingVolume::Types::Sphere:
+    {
+      /* Copy the centre and the radius. */
+      uint32_t dense = fSphereSlots.fDense[slotOf(id)];
+      const BoundingSphere & sphere =
+        static_cast<const BoundingSphere &>(volume);
+      fSphereX[dense] = sphere.centre().x();
+      fSphereY[dense] = sphere.centre().y();
+      fSphereZ[dense] = sphere.centre().z();
+      fSphereRadius[dense] = sphere.radius();
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
+/******************************************************************************/
+void BoundingVolumeSet::remove(VolumeID id)
+{
+  switch(typeOf(id))
+  {
+    case BoundingVolume::Types::Box:
+    {
+      /* Move the last box into the gap. */
+      uint32_t dense = releaseSlot(fBoxSlots, slotOf(id));
+      fBoxMinX[dense] = fBoxMinX.back();
+      fBoxMinY[dense] = fBoxMinY.back();
+      fBoxMinZ[dense] = fBoxMinZ.back();
+      fBoxMaxX[dense] = fBoxMaxX.back();
+      fBoxMaxY[dense] = fBoxMaxY.back();
+      fBoxMaxZ[dense] = fBoxMaxZ.back();
+      fBoxMinX.pop_back();
+      fBoxMinY.pop_back();
+      fBoxMinZ.pop_back();
+      fBoxMaxX.pop_back();
+      fBoxMaxY.pop_back();
+      fBoxMaxZ.pop_back();
+      break;
+    }
+
+    case BoundingVolume::Types::Sphere:
+    {
+      /* Move the last sphere into the gap. */
+      uint32_t dense = releaseSlot(fSphereSlots, slotOf(id));
+      fSphereX[dense] = fSphereX.back();
+      fSphereY[dense] = fSphereY.back();
+      fSphereZ[dense] = fSphereZ.back();
+      fSphereRadius[dense] = fSphereRadius.back();
+      fSphereX.pop_back();
+      fSphereY.pop_back();
+      fSphereZ.pop_back();
+      fSphereRadius.pop_back();
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
+/******************************************************************************/
+template <typename Callback>
+void BoundingVolumeSet::forEachBoxHit(const Math::Ray & ray, float maxT,
+                                      Callback && callback) const
+{
+  /* The ray is shared by all the boxes. */
+  const float ox = ray.origin().x();
+  const float oy = ray.origin().y();
+  const float oz = ray.origin().z();
+  const Math::Vector4f invDir = AABB::inverseDirection(ray);
+  const float ix = invDir.x(), iy = invDir.y(), iz = invDir.z();
+  const size_t count = fBoxMinX.size();
+  size_t i = 0;
+
+  #ifdef ANUBIS_HAS_SSE
+    /* Broadcast the ray. */
+    const __m128 ox4 = _mm_set1_ps(ox), oy4 = _mm_set1_ps(oy);
+    const __m128 oz4 = _mm_set1_ps(oz);
+    const __m128 ix4 = _mm_set1_ps(ix), iy4 = _mm_set1_ps(iy);
+    const __m128 iz4 = _mm_set1_ps(iz);
+    const __m128 zero = _mm_setzero_ps(), maxT4 = _mm_set1_ps(maxT);
+    const __m128 inf4 = _mm_set1_ps(std::numeric_limits<float>::infinity());
+
+    /* Test four boxes at a time with the slab method. */
+    for(; i + 4 <= count; i += 4)
+    {
+      __m128 tEntry = _mm_sub_ps(zero, inf4), tExit = inf4;
+      __m128 isValid = AABB::clipSlab4(_mm_loadu_ps(&fBoxMinX[i]),
+        _mm_loadu_ps(&fBoxMaxX[i]), ox4, ix4, tEntry, tExit);
+      isValid = _mm_and_ps(isValid, AABB::clipSlab4(
+        _mm_loadu_ps(&fBoxMinY[i]), _mm_loadu_ps(&fBoxMaxY[i]), oy4, iy4,
+        tEntry, tExit));
+      isValid = _mm_and_ps(isValid, AABB::clipSlab4(
+        _mm_loadu_ps(&fBoxMinZ[i]), _mm_loadu_ps(&fBoxMaxZ[i]), oz4, iz4,
+        tEntry, tExit));
+
+      /* The first surface crossing is the exit if the ray starts inside. */
+      __m128 t = _mm_blendv_ps(tExit, tEntry, _mm_cmpge_ps(tEntry, zero));
+      __m128 hit = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(tEntry, tExit),
+                                         _mm_cmpge_ps(tExit, zero)),
+                              _mm_and_ps(_mm_cmple_ps(t, maxT4), isValid));
+
+      /* Report the hits. */
+      int mask = _mm_movemask_ps(hit);
+      if(mask)
+      {
+        float distances[4];
+        _mm_storeu_ps(distances, t);
+        while(mask)
+        {
+          int k = Common::Bits::countTrailingZeros(mask);
+          callback(uint32_t(i + k), distances[k]);
+          mask &= mask - 1;
+        }
+      }
+    }
+  #endif /* ANUBIS_HAS_SSE */
+
+  /* Test the remaining boxes one by one. */
+  for(; i < count; i++)
+  {
+    float tEntry = -std::numeric_limits<float>::infinity();
+    float tExit = std::numeric_limits<float>::infinity();
+    bool isValid = AABB::clipSlab(fBoxMinX[i], fBoxMaxX[i], ox, ix, tEntry,
+                                  tExit);
+    isValid &= AABB::clipSlab(fBoxMinY[i], fBoxMaxY[i], oy, iy, tEntry, tExit);
+    isValid &= AABB::clipSlab(fBoxMinZ[i], fBoxMaxZ[i], oz, iz, tEntry, tExit);
+
+    float t = tEntry >= 0.0f ? tEntry : tExit;
+    if(isValid && tEntry <= tExit && tExit >= 0.0f && t <= maxT)
+    {
+      callback(uint32_t(i), t);
+    }
+  }
+}
+
+/******************************************************************************/
+template <typename Callback>
+void BoundingVolumeSet::forEachSphereHit(const Math::Ray & ray, float maxT,
+                                         Callback && callback) const
+{
+  /* The ray is shared by all the spheres. */
+  const float ox = ray.origin().x();
+  const float oy = ray.origin().y();
+  const float oz = ray.origin().z();
+  const float dx = ray.direction().x();
+  const float dy = ray.direction().y();
+  const float dz = ray.direction().z();
+  const float a = dx * dx + dy * dy + dz * dz;
+  const size_t count = fSphereX.size();
+  size_t i = 0;
+
+  /* A ray without a direction does not cross any surface. */
+  if(a == 0.0f)
+  {
+    return;
+  }
+  const float invA = 1.0f / a;
+
+  #ifdef ANUBIS_HAS_SSE
+    /* Broadcast the ray. */
+    const __m128 ox4 = _mm_set1_ps(ox), oy4 = _mm_set1_ps(oy);
+    const __m128 oz4 = _mm_set1_ps(oz);
+    const __m128 dx4 = _mm_set1_ps(dx), dy4 = _mm_set1_ps(dy);
+    const __m128 dz4 = _mm_set1_ps(dz);
+    const __m128 a4 = _mm_set1_ps(a), invA4 = _mm_set1_ps(invA);
+    const __m128 zero = _mm_setzero_ps(), maxT4 = _mm_set1_ps(maxT);
+
+    /* Solve the quadratic for four spheres at a time. */
+    for(; i + 4 <= count; i += 4)
+    {
+      __m128 cx = _mm_sub_ps(ox4, _mm_loadu_ps(&fSphereX[i]));
+      __m128 cy = _mm_sub_ps(oy4, _mm_loadu_ps(&fSphereY[i]));
+      __m128 cz = _mm_sub_ps(oz4, _mm_loadu_ps(&fSphereZ[i]));
+      __m128 r = _mm_loadu_ps(&fSphereRadius[i]);
+
+      __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, dx4),
+                                       _mm_mul_ps(cy, dy4)),
+                            _mm_mul_ps(cz, dz4));
+      __m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, cx),
+                                                  _mm_mul_ps(cy, cy)),
+                                       _mm_mul_ps(cz, cz)),
+                            _mm_mul_ps(r, r));
+      __m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(a4, c));
+
+      /* Calculate the entry and exit distances. */
+      __m128 root = _mm_sqrt_ps(_mm_max_ps(discriminant, zero));
+      __m128 negB = _mm_sub_ps(zero, b);
+      __m128 tEntry = _mm_mul_ps(_mm_sub_ps(negB, root), invA4);
+      __m128 tExit = _mm_mul_ps(_mm_add_ps(negB, root), invA4);
+
+      /* The first surface crossing is the exit if the ray starts inside. */
+      __m128 t = _mm_blendv_ps(tExit, tEntry, _mm_cmpge_ps(tEntry, zero));
+      __m128 hit = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(discriminant, zero),
+                                         _mm_cmpge_ps(tExit, zero)),
+                              _mm_cmple_ps(t, maxT4));
+
+      /* Report the hits. */
+      int mask = _mm_movemask_ps(hit);
+      if(mask)
+      {
+        float distances[4];
+        _mm_storeu_ps(distances, t);
+        while(mask)
+        {
+          int k = Common::Bits::countTrailingZeros(mask);
+          callback(uint32_t(i + k), distances[k]);
+          mask &= mask - 1;
+        }
+      }
+    }
+  #endif /* ANUBIS_HAS_SSE */
+
+  /* Test the remaining spheres one by one. */
+  for(; i < count; i++)
+  {
+    float cx = ox - fSphereX[i];
+    float cy = oy - fSphereY[i];
+    float cz = oz - fSphereZ[i];
+    float b = cx * dx + cy * dy + cz * dz;
+    float c = cx * cx + cy * cy + cz * cz - fSphereRadius[i] * fSphereRadius[i];
+    float discriminant = b * b - a * c;
+    if(discriminant < 0.0f)
+    {
+      continue;
+    }
+
+    float root = std::sqrt(discriminant);
+    float tEntry = (-b - root) * invA;
+    float tExit = (-b + root) * invA;
+    float t = tEntry >= 0.0f ? tEntry : tExit;
+    if(tExit >= 0.0f && t <= maxT)
+    {
+      callback(uint32_t(i), t);
+    }
+  }
+}
+
+/******************************************************************************/
+size_t BoundingVolumeSet::intersect(const Math::Ray & ray, float maxT,
+                                    RayHit * hits, size_t capacity) const
+{
+  /* Count every hit but only write as many as fit into the buffer. */
+  size_t count = 0;
+
+  /* Intersect the boxes. */
+  forEachBoxHit(ray, maxT, [&](uint32_t dense, float t)
+  {
+    if(count < capacity)
+    {
+      hits[count].fVolume = makeID(BoundingVolume::Types::Box,
+                                   fBoxSlots.fSlots[dense]);
+      hits[count].fDistance = t;
+    }
+    ++count;
+  });
+
+  /* Intersect the spheres. */
+  forEachSphereHit(ray, maxT, [&](uint32_t dense, float t)
+  {
+    if(count < capacity)
+    {
+      hits[count].fVolume = makeID(BoundingVolume::Types::Sphere,
+                                   fSphereSlots.fSlots[dense]);
+      hits[count].fDistance = t;
+    }
+    ++count;
+  });
+
+  return count;
+}
+
+/******************************************************************************/
+bool BoundingVolumeSet::intersectClosest(const Math::Ray & ray, float maxT,
+                                         RayHit & hit) const
+{
+  /* Find the closest box and sphere, every hit shortens the ray. */
+  uint32_t closestBox = kNullVolume, closestSphere = kNullVolume;
+  forEachBoxHit(ray, maxT, [&](uint32_t dense, float t)
+  {
+    if(t <= maxT)
+    {
+      closestBox = dense;
+      maxT = t;
+    }
+  });
+  forEachSphereHit(ray, maxT, [&](uint32_t dense, float t)
+  {
+    if(t <= maxT)
+    {
+      closestSphere = dense;
+      maxT = t;
+    }
+  });
+
+  /* The sphere can only have been hit if it is closer than the boxes. */
+  if(closestSphere != kNullVolume)
+  {
+    hit.fVolume = makeID(BoundingVolume::Types::Sphere,
+                         fSphereSlots.fSlots[closestSphere]);
+  }
+  else if(closestBox != kNullVolume)
+  {
+    hit.fVolume = makeID(BoundingVolume::Types::Box,
+                         fBoxSlots.fSlots[closestBox]);
+  }
+  else
+  {
+    return false;
+  }
+
+  hit.fDistance = maxT;
+  return true;
+}
+
+/******************************************************************************/
+size_t BoundingVolumeSet::intersect(VolumeID id, const Math::Ray & ray,
+                                    float * distances, size_t capacity) const
+{
+  /* Calculate the entry and exit distances of the volume. */
+  float tEntry, tExit;
+  switch(typeOf(id))
+  {
+    case BoundingVolume::Types::Box:
+    {
+      uint32_t i = fBoxSlots.fDense[slotOf(id)];
+      AABB box(Math::Vector4f(fBoxMinX[i], fBoxMinY[i], fBoxMinZ[i], 1.0f),
+               Math::Vector4f(fBoxMaxX[i], fBoxMaxY[i], fBoxMaxZ[i], 1.0f));
+      if(!box.intersect(ray.origin(), AABB::inverseDirection(ray),
+                        std::numeric_limits<float>::max(), tEntry, tExit))
+      {
+        return 0;
+      }
+      break;
+    }
+
+    case BoundingVolume::Types::Sphere:
+    {
+      uint32_t i = fSphereSlots.fDense[slotOf(id)];
+      const Math::Vector4f & dir = ray.direction();
+      Math::Vector4f oc = ray.origin() - Math::Vector4f(fSphereX[i],
+        fSphereY[i], fSphereZ[i], 1.0f);
+      float a = dir.dot(dir);
+      float b = oc.dot(dir);
+      float c = oc.dot(oc) - fSphereRadius[i] * fSphereRadius[i];
+      float discriminant = b * b - a * c;
+      if(discriminant < 0.0f || a == 0.0f)
+      {
+        return 0;
+      }
+
+      float root = std::sqrt(discriminant);
+      tEntry = (-b - root) / a;
+      tExit = (-b + root) / a;
+      if(tExit < 0.0f)
+      {
+        return 0;
+      }
+      break;
+    }
+
+    default:
+      return 0;
+  }
+
+  /* Write the entry point if it's in front of the ray and the exit point. */
+  size_t count = 0;
+  if(tEntry >= 0.0f && count < capacity)
+  {
+    distances[count++] = tEntry;
+  }
+  if(count < capacity)
+  {
+    distances[count++] = tExit;
+  }
+  return count;
+}
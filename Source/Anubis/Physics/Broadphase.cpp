@@ -0,0 +1,22 @@
+#include "../../../Include/Anubis/Physics/Broadphase.hpp"
+#include "../../../Include/Anubis/Physics/AABBTree.hpp"
+#include "../../../Include/Anubis/Physics/SweepAndPrune.hpp"
+
+using namespace Anubis::Physics;
+
+/******************************************************************************/
+std::unique_ptr<Broadphase> Broadphase::create(Types type)
+{
+  /* Create the requested implementation. */
+  switch(type)
+  {
+    case Types::AABBTree:
+      return std::unique_ptr<Broadphase>(new AABBTree());
+
+    case Types::SweepAndPrune:
+      return std::unique_ptr<Broadphase>(new SweepAndPrune());
+  }
+
+  ANUBIS_THROW_RUNTIME_EXCEPTION("Unknown broadphase type.");
+  return nullptr;
+}
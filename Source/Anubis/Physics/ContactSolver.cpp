@@ -0,0 +1,543 @@
+#include "../../../Include/Anubis/Physics/ContactSolver.hpp"
+
+using namespace Anubis;
+using namespace Anubis::Physics;
+
+/** The number of blocks solved per task. */
+static const size_t kBlocksPerTask = 64;
+
+/** Cached impulses are reused by contacts of the same pair within this
+ * distance (squared). */
+static const float kWarmStartDistanceSq = 0.05f * 0.05f;
+
+/******************************************************************************/
+/* Build two unit tangents perpendicular to a unit normal. The tangents only
+ * depend on the normal so that the friction impulses can be warm started. */
+static void makeTangents(const Math::Vector4f & normal,
+                         Math::Vector4f & tangent1, Math::Vector4f & tangent2)
+{
+  if(std::fabs(normal.x()) >= 0.57735f)
+  {
+    tangent1 = Math::Vector4f(normal.y(), -normal.x(), 0.0f, 0.0f);
+  }
+  else
+  {
+    tangent1 = Math::Vector4f(0.0f, normal.z(), -normal.y(), 0.0f);
+  }
+  tangent1 = tangent1 * (1.0f / tangent1.length());
+  tangent2 = normal.cross(tangent1);
+  tangent2.w() = 0.0f;
+}
+
+/******************************************************************************/
+/* Multiply a vector by the world space inverse inertia of a body. */
+static Math::Vector4f applyInverseInertia(const RigidBodyWorld & world,
+                                          uint32_t dense,
+                                          const Math::Vector4f & v)
+{
+  typedef RigidBodyWorld::Fields Fields;
+  Math::Quaternion q(world.data(Fields::OrientationX)[dense],
+                     world.data(Fields::OrientationY)[dense],
+                     world.data(Fields::OrientationZ)[dense],
+                     world.data(Fields::OrientationW)[dense]);
+  Math::Vector4f local = q.conjugate() * v;
+  local = Math::Vector4f(local.x() * world.data(Fields::InverseInertiaX)[dense],
+                         local.y() * world.data(Fields::InverseInertiaY)[dense],
+                         local.z() * world.data(Fields::InverseInertiaZ)[dense],
+                         0.0f);
+  return q * local;
+}
+
+/******************************************************************************/
+/* Return the key of a pair of bodies in the impulse cache. */
+static uint64_t makeKey(const ContactSolver::Constraint & constraint)
+{
+  return (uint64_t(constraint.fBodyA) << 32) | constraint.fBodyB;
+}
+
+/******************************************************************************/
+/* Return whether a body can move, i.e. it's dynamic or it has a velocity. */
+static bool isMoving(const RigidBodyWorld & world, RigidBodyWorld::BodyID id)
+{
+  typedef RigidBodyWorld::Fields Fields;
+  const size_t dense = world.denseIndex(id);
+  if(world.data(Fields::InverseMass)[dense] > 0.0f)
+  {
+    return true;
+  }
+  for(size_t axis = 0; axis < 3; axis++)
+  {
+    if(world.data(Fields(size_t(Fields::LinearVelocityX) + axis))[dense] !=
+       0.0f || world.data(Fields(size_t(Fields::AngularVelocityX) +
+                                 axis))[dense] != 0.0f)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+/******************************************************************************/
+ContactSolver::ContactSolver(size_t iterations) : fIterations(iterations),
+  fBaumgarte(0.2f), fSlop(0.005f) {}
+
+/******************************************************************************/
+void ContactSolver::prepare(RigidBodyWorld & world,
+                            const Constraint * constraints, size_t count,
+                            float dt)
+{
+  typedef RigidBodyWorld::Fields Fields;
+
+  /* Wake the sleeping dynamic bodies touched by awake bodies that move.
+   * This is not repeated for the islands touched by the woken bodies, they
+   * are woken by the next step. */
+  for(size_t i = 0; i < count; i++)
+  {
+    const Constraint & constraint = constraints[i];
+    if(constraint.fBodyA == RigidBodyWorld::kNullBody ||
+       constraint.fBodyB == RigidBodyWorld::kNullBody ||
+       world.isAwake(constraint.fBodyA) == world.isAwake(constraint.fBodyB))
+    {
+      continue;
+    }
+    const bool awakeA = world.isAwake(constraint.fBodyA);
+    const RigidBodyWorld::BodyID awake = awakeA ? constraint.fBodyA :
+                                                  constraint.fBodyB;
+    const RigidBodyWorld::BodyID asleep = awakeA ? constraint.fBodyB :
+                                                   constraint.fBodyA;
+    if(isMoving(world, awake) &&
+       world.data(Fields::InverseMass)[world.denseIndex(asleep)] > 0.0f)
+    {
+      world.wake(asleep);
+    }
+  }
+  const float * invMass = world.data(Fields::InverseMass);
+
+  /* Find the dense indexes of the bodies. */
+  std::vector<uint32_t> bodies(count * 2);
+  for(size_t i = 0; i < count; i++)
+  {
+    const Constraint & constraint = constraints[i];
+    bodies[i * 2] = constraint.fBodyA == RigidBodyWorld::kNullBody ? kNoBody :
+                    uint32_t(world.denseIndex(constraint.fBodyA));
+    bodies[i * 2 + 1] = constraint.fBodyB == RigidBodyWorld::kNullBody ?
+                        kNoBody : uint32_t(world.denseIndex(constraint.fBodyB));
+  }
+
+  /* Only the constraints with an awake dynamic body are solved. */
+  auto isActive = [&](size_t i)
+  {
+    for(size_t side = 0; side < 2; side++)
+    {
+      uint32_t body = bodies[i * 2 + side];
+      if(body != kNoBody && body < world.awakeCount() && invMass[body] > 0.0f)
+      {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  /* Give every constraint the lowest colour that neither of it's dynamic
+   * bodies uses yet. Static and kinematic bodies are never written, thus
+   * they do not take part in the colouring. */
+  fBodyColours.assign(world.size(), 0);
+  std::vector<uint32_t> colours(count);
+  std::vector<uint32_t> colourSizes(kMaxColours + 1, 0);
+  size_t colourCount = 0;
+  for(size_t i = 0; i < count; i++)
+  {
+    if(!isActive(i))
+    {
+      /* Skipped constraints have no colour. */
+      colours[i] = kNoBody;
+      continue;
+    }
+
+    uint64_t used = 0;
+    for(size_t side = 0; side < 2; side++)
+    {
+      uint32_t body = bodies[i * 2 + side];
+      if(body != kNoBody && invMass[body] > 0.0f)
+      {
+        used |= fBodyColours[body];
+      }
+    }
+
+    uint32_t colour = uint32_t(kMaxColours);
+    if(used != ~uint64_t(0))
+    {
+      colour = uint32_t(Common::Bits::countTrailingZeros64(~used));
+      colourCount = std::max(colourCount, size_t(colour) + 1);
+      for(size_t side = 0; side < 2; side++)
+      {
+        uint32_t body = bodies[i * 2 + side];
+        if(body != kNoBody && invMass[body] > 0.0f)
+        {
+          fBodyColours[body] |= uint64_t(1) << colour;
+        }
+      }
+    }
+    colours[i] = colour;
+    ++colourSizes[colour];
+  }
+
+  /* Every colour is packed into whole blocks, the serial constraints get a
+   * block each. */
+  fColourStarts.clear();
+  std::vector<uint32_t> cursors(kMaxColours + 1);
+  uint32_t blockCount = 0;
+  for(size_t colour = 0; colour < colourCount; colour++)
+  {
+    fColourStarts.push_back(blockCount);
+    cursors[colour] = blockCount * kLaneWidth;
+    blockCount += uint32_t((colourSizes[colour] + kLaneWidth - 1) /
+                           kLaneWidth);
+  }
+  fColourStarts.push_back(blockCount);
+  cursors[kMaxColours] = blockCount * kLaneWidth;
+  blockCount += colourSizes[kMaxColours];
+  fColourStarts.push_back(blockCount);
+
+  /* The unused lanes have no bodies and no effective mass. */
+  fBlocks.resize(blockCount);
+  if(blockCount > 0)
+  {
+    memset(static_cast<void*>(fBlocks.data()), 0, blockCount * sizeof(Block));
+  }
+  for(Block & block : fBlocks)
+  {
+    std::fill(block.fBodyA, block.fBodyA + kLaneWidth, kNoBody);
+    std::fill(block.fBodyB, block.fBodyB + kLaneWidth, kNoBody);
+  }
+
+  /* Fill in the lanes. */
+  fLanes.resize(count);
+  const float biasScale = dt > 0.0f ? fBaumgarte / dt : 0.0f;
+  for(size_t i = 0; i < count; i++)
+  {
+    if(colours[i] == kNoBody)
+    {
+      fLanes[i] = kNoBody;
+      continue;
+    }
+
+    /* Serial constraints only use the first lane of their block. */
+    uint32_t lane = cursors[colours[i]];
+    cursors[colours[i]] += colours[i] == kMaxColours ? kLaneWidth : 1;
+    fLanes[i] = lane;
+    Block & block = fBlocks[lane / kLaneWidth];
+    const size_t k = lane % kLaneWidth;
+
+    /* The bodies and the offsets of the contact point from them. */
+    const Contact & contact = constraints[i].fContact;
+    const uint32_t a = bodies[i * 2], b = bodies[i * 2 + 1];
+    Math::Vector4f rA, rB;
+    block.fBodyA[k] = a;
+    block.fBodyB[k] = b;
+    if(a != kNoBody)
+    {
+      block.fInvMassA[k] = invMass[a];
+      rA = contact.fPoint - Math::Vector4f(world.data(Fields::PositionX)[a],
+        world.data(Fields::PositionY)[a], world.data(Fields::PositionZ)[a],
+        contact.fPoint.w());
+    }
+    if(b != kNoBody)
+    {
+      block.fInvMassB[k] = invMass[b];
+      rB = contact.fPoint - Math::Vector4f(world.data(Fields::PositionX)[b],
+        world.data(Fields::PositionY)[b], world.data(Fields::PositionZ)[b],
+        contact.fPoint.w());
+    }
+    /* A speculative contact, with a negative depth, lets the bodies close
+     * the gap in one step but no more. */
+    block.fBias[k] = contact.fDepth < 0.0f ?
+      (dt > 0.0f ? contact.fDepth / dt : 0.0f) :
+      biasScale * std::max(contact.fDepth - fSlop, 0.0f);
+    block.fFriction[k] = constraints[i].fFriction;
+
+    /* The normal and friction rows. */
+    Math::Vector4f directions[3] = {contact.fNormal};
+    directions[0].w() = 0.0f;
+    makeTangents(directions[0], directions[1], directions[2]);
+    for(size_t r = 0; r < 3; r++)
+    {
+      Row & row = block.fRows[r];
+      Math::Vector4f angularA = rA.cross(directions[r]);
+      Math::Vector4f angularB = rB.cross(directions[r]);
+      Math::Vector4f inertiaA, inertiaB;
+      float mass = block.fInvMassA[k] + block.fInvMassB[k];
+      if(a != kNoBody)
+      {
+        inertiaA = applyInverseInertia(world, a, angularA);
+        mass += angularA.dot(inertiaA);
+      }
+      if(b != kNoBody)
+      {
+        inertiaB = applyInverseInertia(world, b, angularB);
+        mass += angularB.dot(inertiaB);
+      }
+
+      for(size_t axis = 0; axis < 3; axis++)
+      {
+        row.fDirection[axis][k] = directions[r].memory()[axis];
+        row.fAngularA[axis][k] = angularA.memory()[axis];
+        row.fAngularB[axis][k] = angularB.memory()[axis];
+        row.fInertiaA[axis][k] = inertiaA.memory()[axis];
+        row.fInertiaB[axis][k] = inertiaB.memory()[axis];
+      }
+      row.fEffectiveMass[k] = mass > 0.0f ? 1.0f / mass : 0.0f;
+    }
+  }
+}
+
+/******************************************************************************/
+const ContactSolver::CachedImpulse * ContactSolver::findCached(
+  const Constraint & constraint) const
+{
+  CachedImpulse probe;
+  probe.fKey = makeKey(constraint);
+  auto range = std::equal_range(fCache.begin(), fCache.end(), probe,
+    [](const CachedImpulse & lhs, const CachedImpulse & rhs)
+  {
+    return lhs.fKey < rhs.fKey;
+  });
+
+  const CachedImpulse * cached = nullptr;
+  float bestSq = kWarmStartDistanceSq;
+  for(auto it = range.first; it != range.second; ++it)
+  {
+    Math::Vector4f offset = it->fPoint - constraint.fContact.fPoint;
+    if(offset.dot(offset) <= bestSq)
+    {
+      bestSq = offset.dot(offset);
+      cached = &*it;
+    }
+  }
+  return cached;
+}
+
+/******************************************************************************/
+void ContactSolver::warmStart(RigidBodyWorld & world,
+                              const Constraint * constraints, size_t count)
+{
+  typedef RigidBodyWorld::Fields Fields;
+  float * linear[3] = {world.data(Fields::LinearVelocityX),
+                       world.data(Fields::LinearVelocityY),
+                       world.data(Fields::LinearVelocityZ)};
+  float * angular[3] = {world.data(Fields::AngularVelocityX),
+                        world.data(Fields::AngularVelocityY),
+                        world.data(Fields::AngularVelocityZ)};
+
+  for(size_t i = 0; i < count; i++)
+  {
+    /* Find the closest cached contact of the same pair. */
+    const CachedImpulse * cached = findCached(constraints[i]);
+    if(!cached || fLanes[i] == kNoBody)
+    {
+      continue;
+    }
+
+    /* Apply the cached impulses to the bodies. */
+    const uint32_t lane = fLanes[i];
+    Block & block = fBlocks[lane / kLaneWidth];
+    const size_t k = lane % kLaneWidth;
+    for(size_t r = 0; r < 3; r++)
+    {
+      Row & row = block.fRows[r];
+      const float impulse = cached->fImpulses[r];
+      row.fImpulse[k] = impulse;
+      for(size_t axis = 0; axis < 3; axis++)
+      {
+        if(block.fInvMassA[k] > 0.0f)
+        {
+          linear[axis][block.fBodyA[k]] -= row.fDirection[axis][k] * impulse *
+                                           block.fInvMassA[k];
+          angular[axis][block.fBodyA[k]] -= row.fInertiaA[axis][k] * impulse;
+        }
+        if(block.fInvMassB[k] > 0.0f)
+        {
+          linear[axis][block.fBodyB[k]] += row.fDirection[axis][k] * impulse *
+                                           block.fInvMassB[k];
+          angular[axis][block.fBodyB[k]] += row.fInertiaB[axis][k] * impulse;
+        }
+      }
+    }
+  }
+}
+
+/******************************************************************************/
+void ContactSolver::solveBlocks(RigidBodyWorld & world, size_t begin,
+                                size_t end)
+{
+  typedef RigidBodyWorld::Fields Fields;
+  float * const linear[3] = {world.data(Fields::LinearVelocityX),
+                             world.data(Fields::LinearVelocityY),
+                             world.data(Fields::LinearVelocityZ)};
+  float * const angular[3] = {world.data(Fields::AngularVelocityX),
+                              world.data(Fields::AngularVelocityY),
+                              world.data(Fields::AngularVelocityZ)};
+
+  /* Load the velocities of the bodies of the four lanes, the lanes without
+   * a body have no velocity. */
+  auto gather = [](const uint32_t * bodies, float * const * arrays)
+  {
+    float v[3][kLaneWidth];
+    for(size_t k = 0; k < kLaneWidth; k++)
+    {
+      for(size_t axis = 0; axis < 3; axis++)
+      {
+        v[axis][k] = bodies[k] == kNoBody ? 0.0f : arrays[axis][bodies[k]];
+      }
+    }
+    return Vec3x4::load(v[0], v[1], v[2]);
+  };
+
+  /* Store the velocities of the dynamic bodies of the four lanes. */
+  auto scatter = [](const uint32_t * bodies, const float * invMass,
+                    float * const * arrays, const Vec3x4 & value)
+  {
+    float v[3][kLaneWidth];
+    value.store(v[0], v[1], v[2]);
+    for(size_t k = 0; k < kLaneWidth; k++)
+    {
+      if(invMass[k] > 0.0f)
+      {
+        for(size_t axis = 0; axis < 3; axis++)
+        {
+          arrays[axis][bodies[k]] = v[axis][k];
+        }
+      }
+    }
+  };
+
+  const Lane4 zero = Lane4::set(0.0f);
+  for(size_t index = begin; index < end; index++)
+  {
+    Block & block = fBlocks[index];
+    Vec3x4 linearA = gather(block.fBodyA, linear);
+    Vec3x4 angularA = gather(block.fBodyA, angular);
+    Vec3x4 linearB = gather(block.fBodyB, linear);
+    Vec3x4 angularB = gather(block.fBodyB, angular);
+    const Lane4 invMassA = Lane4::load(block.fInvMassA);
+    const Lane4 invMassB = Lane4::load(block.fInvMassB);
+
+    /* Solve the friction rows first, clamped by the normal impulse, then
+     * the normal row. */
+    const Lane4 limit = Lane4::load(block.fFriction) *
+                        Lane4::load(block.fRows[0].fImpulse);
+    for(size_t r : {1, 2, 0})
+    {
+      Row & row = block.fRows[r];
+      Vec3x4 direction = Vec3x4::load(row.fDirection[0], row.fDirection[1],
+                                      row.fDirection[2]);
+      Vec3x4 inertiaA = Vec3x4::load(row.fInertiaA[0], row.fInertiaA[1],
+                                     row.fInertiaA[2]);
+      Vec3x4 inertiaB = Vec3x4::load(row.fInertiaB[0], row.fInertiaB[1],
+                                     row.fInertiaB[2]);
+
+      /* The relative velocity along the row. */
+      Lane4 velocity = direction.dot(linearB - linearA) +
+        Vec3x4::load(row.fAngularB[0], row.fAngularB[1],
+                     row.fAngularB[2]).dot(angularB) -
+        Vec3x4::load(row.fAngularA[0], row.fAngularA[1],
+                     row.fAngularA[2]).dot(angularA);
+
+      /* Accumulate and clamp the impulse. */
+      const Lane4 oldImpulse = Lane4::load(row.fImpulse);
+      Lane4 impulse;
+      if(r == 0)
+      {
+        impulse = (Lane4::load(block.fBias) - velocity) *
+                  Lane4::load(row.fEffectiveMass);
+        impulse = Lane4::max(oldImpulse + impulse, zero);
+      }
+      else
+      {
+        impulse = -velocity * Lane4::load(row.fEffectiveMass);
+        impulse = Lane4::min(Lane4::max(oldImpulse + impulse, -limit), limit);
+      }
+      impulse.store(row.fImpulse);
+
+      /* Apply the change in impulse to both bodies. */
+      const Lane4 delta = impulse - oldImpulse;
+      linearA = linearA - direction * (delta * invMassA);
+      angularA = angularA - inertiaA * delta;
+      linearB = linearB + direction * (delta * invMassB);
+      angularB = angularB + inertiaB * delta;
+    }
+
+    scatter(block.fBodyA, block.fInvMassA, linear, linearA);
+    scatter(block.fBodyA, block.fInvMassA, angular, angularA);
+    scatter(block.fBodyB, block.fInvMassB, linear, linearB);
+    scatter(block.fBodyB, block.fInvMassB, angular, angularB);
+  }
+}
+
+/******************************************************************************/
+void ContactSolver::solve(RigidBodyWorld & world,
+                          const Constraint * constraints, size_t count,
+                          float dt, TaskPool * pool)
+{
+  /* Colour the constraints and apply last step's impulses. */
+  prepare(world, constraints, count, dt);
+  warmStart(world, constraints, count);
+
+  const size_t colourCount = fColourStarts.size() - 2;
+  for(size_t iteration = 0; iteration < fIterations; iteration++)
+  {
+    /* The blocks of a colour never share a dynamic body. */
+    for(size_t colour = 0; colour < colourCount; colour++)
+    {
+      const size_t begin = fColourStarts[colour];
+      const size_t end = fColourStarts[colour + 1];
+      if(pool && end - begin > kBlocksPerTask)
+      {
+        pool->parallelFor(end - begin, kBlocksPerTask,
+          [&](size_t first, size_t last)
+        {
+          solveBlocks(world, begin + first, begin + last);
+        });
+      }
+      else
+      {
+        solveBlocks(world, begin, end);
+      }
+    }
+
+    /* The constraints that did not fit in the colours. */
+    solveBlocks(world, fColourStarts[colourCount],
+                fColourStarts[colourCount + 1]);
+  }
+
+  /* Keep the impulses for the next solve. The constraints of sleeping
+   * bodies keep their old impulses, so they are warm started when the
+   * bodies wake. */
+  std::vector<CachedImpulse> cache(count);
+  for(size_t i = 0; i < count; i++)
+  {
+    cache[i].fKey = makeKey(constraints[i]);
+    cache[i].fPoint = constraints[i].fContact.fPoint;
+    const uint32_t lane = fLanes[i];
+    if(lane == kNoBody)
+    {
+      const CachedImpulse * cached = findCached(constraints[i]);
+      for(size_t r = 0; r < 3; r++)
+      {
+        cache[i].fImpulses[r] = cached ? cached->fImpulses[r] : 0.0f;
+      }
+      continue;
+    }
+    const Block & block = fBlocks[lane / kLaneWidth];
+    for(size_t r = 0; r < 3; r++)
+    {
+      cache[i].fImpulses[r] = block.fRows[r].fImpulse[lane % kLaneWidth];
+    }
+  }
+  fCache.swap(cache);
+  std::stable_sort(fCache.begin(), fCache.end(),
+    [](const CachedImpulse & lhs, const CachedImpulse & rhs)
+  {
+    return lhs.fKey < rhs.fKey;
+  });
+}
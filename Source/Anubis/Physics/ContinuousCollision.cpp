@@ -0,0 +1,152 @@
+#include "../../../Include/Anubis/Physics/ContinuousCollision.hpp"
+
+#include <algorithm>
+
+using namespace Anubis;
+using namespace Anubis::Physics;
+
+/******************************************************************************/
+ContinuousCollision::ContinuousCollision(Mode mode, float speedFactor) :
+  fMode(mode), fSpeedFactor(speedFactor), fFriction(0.5f) {}
+
+/******************************************************************************/
+void ContinuousCollision::addBody(RigidBodyWorld::BodyID id, float radius)
+{
+  fBodies.push_back(Body{id, radius});
+}
+
+/******************************************************************************/
+void ContinuousCollision::removeBody(RigidBodyWorld::BodyID id)
+{
+  fBodies.erase(std::remove_if(fBodies.begin(), fBodies.end(),
+    [id](const Body & body) { return body.fId == id; }), fBodies.end());
+}
+
+/******************************************************************************/
+void ContinuousCollision::addStatic(const BoundingBox & box)
+{
+  fBoxes.push_back(box);
+}
+
+/******************************************************************************/
+void ContinuousCollision::addStatic(const BoundingMesh & mesh)
+{
+  fMeshes.push_back(&mesh);
+}
+
+/******************************************************************************/
+bool ContinuousCollision::sweep(const BoundingSphere & sphere,
+                                const Math::Vector4f & motion, float & toi,
+                                Contact & contact) const
+{
+  bool hit = false;
+  toi = 1.0f;
+  float t;
+  Contact candidate;
+  for(const BoundingBox & box : fBoxes)
+  {
+    if(Narrowphase::sweep(sphere, motion, box, t, candidate) && t < toi)
+    {
+      toi = t;
+      contact = candidate;
+      hit = true;
+    }
+  }
+  for(const BoundingMesh * mesh : fMeshes)
+  {
+    if(Narrowphase::sweep(sphere, motion, *mesh, t, candidate) && t < toi)
+    {
+      toi = t;
+      contact = candidate;
+      hit = true;
+    }
+  }
+  return hit;
+}
+
+/******************************************************************************/
+void ContinuousCollision::beginStep(const RigidBodyWorld & world, float dt,
+  std::vector<ContactSolver::Constraint> & constraints)
+{
+  /* Only the awake bodies that move far enough in the step are swept. */
+  fSweeps.clear();
+  for(const Body & body : fBodies)
+  {
+    if(!world.isAwake(body.fId))
+    {
+      continue;
+    }
+    const float reach = fSpeedFactor * body.fRadius;
+    Math::Vector4f motion = world.linearVelocity(body.fId) * dt;
+    if(motion.dot(motion) > reach * reach)
+    {
+      fSweeps.push_back(Sweep{body, world.position(body.fId)});
+    }
+  }
+  if(fMode != Mode::Speculative)
+  {
+    return;
+  }
+
+  /* The contact at the first impact, with the gap along the normal as a
+   * negative depth. */
+  for(const Sweep & sweep : fSweeps)
+  {
+    const BoundingSphere sphere(sweep.fStart.x(), sweep.fStart.y(),
+                                sweep.fStart.z(), sweep.fBody.fRadius);
+    Math::Vector4f motion = world.linearVelocity(sweep.fBody.fId) * dt;
+    float toi;
+    Contact contact;
+    if(this->sweep(sphere, motion, toi, contact))
+    {
+      if(toi > 0.0f)
+      {
+        contact.fDepth = -std::max(motion.dot(contact.fNormal) * toi, 0.0f);
+      }
+      constraints.push_back(ContactSolver::Constraint{sweep.fBody.fId,
+        RigidBodyWorld::kNullBody, contact, fFriction});
+    }
+  }
+}
+
+/******************************************************************************/
+void ContinuousCollision::endStep(RigidBodyWorld & world)
+{
+  if(fMode != Mode::TimeOfImpact)
+  {
+    return;
+  }
+  for(const Sweep & sweep : fSweeps)
+  {
+    const BoundingSphere sphere(sweep.fStart.x(), sweep.fStart.y(),
+                                sweep.fStart.z(), sweep.fBody.fRadius);
+    Math::Vector4f motion = world.position(sweep.fBody.fId) - sweep.fStart;
+    float toi;
+    Contact contact;
+    if(!this->sweep(sphere, motion, toi, contact))
+    {
+      continue;
+    }
+
+    /* Move to the impact and slide along the surface for the rest of the
+     * step. */
+    const Math::Vector4f & normal = contact.fNormal;
+    Math::Vector4f rest = motion * (1.0f - toi);
+    const float into = rest.dot(normal);
+    if(into > 0.0f)
+    {
+      rest -= normal * into;
+    }
+    Math::Vector4f position = sweep.fStart + motion * toi + rest;
+    position.w() = sweep.fStart.w();
+    world.setPosition(sweep.fBody.fId, position);
+
+    /* Remove the velocity into the surface. */
+    Math::Vector4f velocity = world.linearVelocity(sweep.fBody.fId);
+    const float speed = velocity.dot(normal);
+    if(speed > 0.0f)
+    {
+      world.setLinearVelocity(sweep.fBody.fId, velocity - normal * speed);
+    }
+  }
+}
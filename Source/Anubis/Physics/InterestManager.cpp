@@ -0,0 +1,202 @@
+#include "../../../Include/Anubis/Physics/InterestManager.hpp"
+
+using namespace Anubis;
+using namespace Anubis::Physics;
+
+/******************************************************************************/
+InterestManager::InterestManager(float cellSize, float leaveMargin,
+                                 uint32_t maxInterval) : fGrid(cellSize),
+  fLeaveMargin(leaveMargin),
+  fMinWeight(1.0f / float(std::max<uint32_t>(maxInterval, 1))) {}
+
+/******************************************************************************/
+int32_t InterestManager::addEntity(const Math::Vector4f & position,
+                                   float priority)
+{
+  /* The grid's handles are reused, thus the records only grow to the peak
+   * entity count. */
+  const int32_t entity = fGrid.insert(position, nullptr);
+  if(size_t(entity) >= fPriorities.size())
+  {
+    fPriorities.resize(entity + 1);
+    fGenerations.resize(entity + 1, 0);
+  }
+  fPriorities[entity] = priority;
+  return entity;
+}
+
+/******************************************************************************/
+void InterestManager::removeEntity(int32_t entity)
+{
+  /* A new generation tells the clients that a reused handle is a diffirent
+   * entity. */
+  fGrid.remove(entity);
+  ++fGenerations[entity];
+}
+
+/******************************************************************************/
+int32_t InterestManager::addClient(const Math::Vector4f & position,
+                                   float radius)
+{
+  /* Reuse a free record, it's vectors keep their memory. */
+  int32_t handle;
+  if(!fFreeClients.empty())
+  {
+    handle = fFreeClients.back();
+    fFreeClients.pop_back();
+  }
+  else
+  {
+    handle = int32_t(fClients.size());
+    fClients.push_back(Client());
+  }
+
+  Client & client = fClients[handle];
+  client.fPosition = position;
+  client.fRadius = radius;
+  return handle;
+}
+
+/******************************************************************************/
+void InterestManager::removeClient(int32_t handle)
+{
+  Client & client = fClients[handle];
+  client.fRadius = -1.0f;
+  client.fRelevant.clear();
+  client.fEvents.clear();
+  client.fDue.clear();
+  fFreeClients.push_back(handle);
+}
+
+/******************************************************************************/
+void InterestManager::updateClient(int32_t handle)
+{
+  Client & client = fClients[handle];
+  client.fEvents.clear();
+  client.fDue.clear();
+  if(client.fRadius < 0.0f)
+  {
+    return;
+  }
+
+  /* Find every entity that may stay, ordered like the relevancy set. */
+  const float radius = client.fRadius;
+  fGrid.queryRadius(client.fPosition, radius * (1.0f + fLeaveMargin),
+                    client.fFound);
+  std::sort(client.fFound.begin(), client.fFound.end(),
+    [](const SpatialGrid::Neighbour & lhs, const SpatialGrid::Neighbour & rhs)
+  {
+    return lhs.fEntity < rhs.fEntity;
+  });
+
+  /* Merge the found entities with the current set. */
+  const float enterSq = radius * radius;
+  const float invRadius = radius > 0.0f ? 1.0f / radius : 0.0f;
+  auto leave = [&](const Relevant & relevant)
+  {
+    client.fEvents.push_back(Event{Event::Types::Leave, handle,
+                                   relevant.fEntity});
+  };
+  client.fScratch.clear();
+  auto old = client.fRelevant.begin();
+  for(const SpatialGrid::Neighbour & found : client.fFound)
+  {
+    /* The entities before this one are out of range or were removed. */
+    while(old != client.fRelevant.end() && old->fEntity < found.fEntity)
+    {
+      leave(*old++);
+    }
+
+    /* A matching handle with an old generation was reused. */
+    const uint32_t generation = fGenerations[found.fEntity];
+    bool kept = false;
+    Relevant relevant{found.fEntity, generation, 0.0f};
+    if(old != client.fRelevant.end() && old->fEntity == found.fEntity)
+    {
+      kept = old->fGeneration == generation;
+      if(kept)
+      {
+        relevant = *old;
+      }
+      else
+      {
+        leave(*old);
+      }
+      ++old;
+    }
+
+    if(kept)
+    {
+      /* Close and important entities gain weight faster. */
+      const float falloff = 1.0f - std::sqrt(found.fDistanceSq) * invRadius;
+      relevant.fWeight += std::max(fPriorities[found.fEntity] * falloff,
+                                   fMinWeight);
+      if(relevant.fWeight >= 1.0f)
+      {
+        relevant.fWeight -= std::floor(relevant.fWeight);
+        client.fDue.push_back(found.fEntity);
+      }
+    }
+    else if(found.fDistanceSq <= enterSq)
+    {
+      /* New entities are sent straight away. */
+      client.fEvents.push_back(Event{Event::Types::Enter, handle,
+                                     found.fEntity});
+      client.fDue.push_back(found.fEntity);
+    }
+    else
+    {
+      continue;
+    }
+    client.fScratch.push_back(relevant);
+  }
+  while(old != client.fRelevant.end())
+  {
+    leave(*old++);
+  }
+  client.fRelevant.swap(client.fScratch);
+
+  /* Report the leaves first, so a reused handle leaves before it enters. */
+  std::stable_partition(client.fEvents.begin(), client.fEvents.end(),
+    [](const Event & event) { return event.fType == Event::Types::Leave; });
+}
+
+/******************************************************************************/
+void InterestManager::update(TaskPool * pool)
+{
+  /* The clients only read the grid, thus they are updated concurrently. */
+  if(pool && pool->getThreadCount() > 1)
+  {
+    pool->parallelFor(fClients.size(), 1, [this](size_t begin, size_t end)
+    {
+      for(size_t i = begin; i < end; i++)
+      {
+        updateClient(int32_t(i));
+      }
+    });
+  }
+  else
+  {
+    for(size_t i = 0; i < fClients.size(); i++)
+    {
+      updateClient(int32_t(i));
+    }
+  }
+
+  /* Gather the events in client order. */
+  fEvents.clear();
+  for(const Client & client : fClients)
+  {
+    fEvents.insert(fEvents.end(), client.fEvents.begin(),
+                   client.fEvents.end());
+  }
+}
+
+/******************************************************************************/
+bool InterestManager::isRelevant(int32_t client, int32_t entity) const
+{
+  const std::vector<Relevant> & relevant = fClients[client].fRelevant;
+  auto it = std::lower_bound(relevant.begin(), relevant.end(),
+                             Relevant{entity, 0, 0.0f});
+  return it != relevant.end() && it->fEntity == entity;
+}
@@ -0,0 +1,122 @@
+#include "../../../Include/Anubis/Physics/Islands.hpp"
+
+#include <numeric>
+
+using namespace Anubis;
+using namespace Anubis::Physics;
+
+/** The index used for the bodies that are not awake. */
+static const uint32_t kNotAwake = 0xFFFFFFFF;
+
+/******************************************************************************/
+Islands::Islands(float linearThreshold, float angularThreshold,
+                 float timeToSleep) : fIslandCount(0),
+  fLinearThreshold(linearThreshold), fAngularThreshold(angularThreshold),
+  fTimeToSleep(timeToSleep) {}
+
+/******************************************************************************/
+void Islands::update(RigidBodyWorld & world,
+                     const ContactSolver::Constraint * constraints,
+                     size_t count, float dt)
+{
+  typedef RigidBodyWorld::Fields Fields;
+  const uint32_t awakeCount = uint32_t(world.awakeCount());
+  const float * invMass = world.data(Fields::InverseMass);
+  float * timers = world.data(Fields::SleepTimer);
+
+  /* Advance the timers of the bodies at rest and reset the others. */
+  const float linearSq = fLinearThreshold * fLinearThreshold;
+  const float angularSq = fAngularThreshold * fAngularThreshold;
+  for(uint32_t body = 0; body < awakeCount; body++)
+  {
+    float linear = 0.0f, angular = 0.0f;
+    for(size_t axis = 0; axis < 3; axis++)
+    {
+      const float v = world.data(Fields(size_t(Fields::LinearVelocityX) +
+                                        axis))[body];
+      const float w = world.data(Fields(size_t(Fields::AngularVelocityX) +
+                                        axis))[body];
+      linear += v * v;
+      angular += w * w;
+    }
+    timers[body] = linear < linearSq && angular < angularSq ?
+                   timers[body] + dt : 0.0f;
+  }
+
+  /* Every awake body starts as an island of it's own. */
+  fParents.resize(awakeCount);
+  std::iota(fParents.begin(), fParents.end(), 0);
+  fTimers.assign(timers, timers + awakeCount);
+
+  /* The dense indexes of the awake bodies of a contact. */
+  auto awakeIndex = [&](RigidBodyWorld::BodyID id)
+  {
+    return id == RigidBodyWorld::kNullBody || !world.isAwake(id) ? kNotAwake :
+           uint32_t(world.denseIndex(id));
+  };
+  auto isDynamic = [&](uint32_t body)
+  {
+    return body != kNotAwake && invMass[body] > 0.0f;
+  };
+
+  /* Join the dynamic bodies in contact, the lower index becomes the root so
+   * the islands only depend on the order of the bodies. */
+  for(size_t i = 0; i < count; i++)
+  {
+    const uint32_t a = awakeIndex(constraints[i].fBodyA);
+    const uint32_t b = awakeIndex(constraints[i].fBodyB);
+    if(isDynamic(a) && isDynamic(b))
+    {
+      const uint32_t rootA = find(a), rootB = find(b);
+      fParents[std::max(rootA, rootB)] = std::min(rootA, rootB);
+    }
+  }
+
+  /* The timer of an island is the smallest timer of it's bodies and of the
+   * kinematic bodies that touch it. */
+  for(uint32_t body = 0; body < awakeCount; body++)
+  {
+    const uint32_t root = find(body);
+    fTimers[root] = std::min(fTimers[root], timers[body]);
+  }
+  for(size_t i = 0; i < count; i++)
+  {
+    const uint32_t a = awakeIndex(constraints[i].fBodyA);
+    const uint32_t b = awakeIndex(constraints[i].fBodyB);
+    if(isDynamic(a) && b != kNotAwake && !isDynamic(b))
+    {
+      fTimers[find(a)] = std::min(fTimers[find(a)], timers[b]);
+    }
+    else if(isDynamic(b) && a != kNotAwake && !isDynamic(a))
+    {
+      fTimers[find(b)] = std::min(fTimers[find(b)], timers[a]);
+    }
+  }
+
+  /* Group the bodies by island with a counting sort, the island of root r
+   * is fMembers[fStarts[r]] to fMembers[fStarts[r + 1] - 1]. */
+  fStarts.assign(awakeCount + 1, 0);
+  fIslandCount = 0;
+  for(uint32_t body = 0; body < awakeCount; body++)
+  {
+    ++fStarts[find(body)];
+    fIslandCount += fParents[body] == body;
+  }
+  std::partial_sum(fStarts.begin(), fStarts.end(), fStarts.begin());
+  fMembers.resize(awakeCount);
+  for(uint32_t body = awakeCount; body-- > 0;)
+  {
+    fMembers[--fStarts[find(body)]] = world.bodyAt(body);
+  }
+
+  /* Put the islands at rest to sleep. The members are IDs, thus they stay
+   * valid while the bodies are moved. */
+  for(uint32_t root = 0; root < awakeCount; root++)
+  {
+    if(fParents[root] == root && fTimers[root] >= fTimeToSleep)
+    {
+      world.sleep(fMembers.data() + fStarts[root],
+                  fStarts[root + 1] - fStarts[root]);
+    }
+  }
+}
@@ -0,0 +1,1216 @@
+#include "../../../Include/Anubis/Physics/Narrowphase.hpp"
+
+using namespace Anubis;
+using namespace Anubis::Physics;
+
+/** Axes shorter than this (squared) are skipped by the separating axis tests,
+ * they are the cross products of parallel edges. */
+static const float kMinAxisLengthSq = 1e-12f;
+
+namespace
+{
+  /****************************************************************************/
+  /* An axis aligned box unpacked into floats for the primitive tests. */
+  struct Box
+  {
+    float fMin[3], fMax[3];
+  };
+
+  /****************************************************************************/
+  /* A sphere unpacked into floats for the primitive tests. */
+  struct Sphere
+  {
+    float fCentre[3], fRadius;
+  };
+
+  /****************************************************************************/
+  /* Tracks the axis of least penetration during a separating axis test. */
+  struct AxisTest
+  {
+    /** The smallest penetration depth found so far. */
+    float fDepth = std::numeric_limits<float>::max();
+
+    /** The unit length axis along which B is pushed out of A. */
+    Math::Vector4f fNormal;
+
+    /* Compare the intervals of A and B on an axis. Return false if the axis
+     * separates them. */
+    bool test(const Math::Vector4f & axis, float minA, float maxA, float minB,
+              float maxB, float lengthSq)
+    {
+      if(minB > maxA || maxB < minA)
+      {
+        return false;
+      }
+
+      /* B can be pushed out along the axis or against it. */
+      float push = maxA - minB;
+      float sign = 1.0f;
+      if(maxB - minA < push)
+      {
+        push = maxB - minA;
+        sign = -1.0f;
+      }
+
+      /* Keep the axis if it needs the smallest push. */
+      float invLength = 1.0f / std::sqrt(lengthSq);
+      float depth = push * invLength;
+      if(depth < fDepth)
+      {
+        fDepth = depth;
+        fNormal = axis * (sign * invLength);
+        fNormal.w() = 0.0f;
+      }
+      return true;
+    }
+  };
+}
+
+/******************************************************************************/
+/* Unpack a bounding box. */
+static Box makeBox(const BoundingBox & box)
+{
+  AABB bounds = box.aabb();
+  return Box{{bounds.fMin.x(), bounds.fMin.y(), bounds.fMin.z()},
+             {bounds.fMax.x(), bounds.fMax.y(), bounds.fMax.z()}};
+}
+
+/******************************************************************************/
+/* Unpack a bounding sphere. */
+static Sphere makeSphere(const BoundingSphere & sphere)
+{
+  return Sphere{{sphere.centre().x(), sphere.centre().y(),
+                 sphere.centre().z()}, sphere.radius()};
+}
+
+/******************************************************************************/
+/* Load the ith box of a batch. */
+static Box loadBox(const Narrowphase::BoxArrays & boxes, size_t i)
+{
+  return Box{{boxes.fMinX[i], boxes.fMinY[i], boxes.fMinZ[i]},
+             {boxes.fMaxX[i], boxes.fMaxY[i], boxes.fMaxZ[i]}};
+}
+
+/******************************************************************************/
+/* Load the ith sphere of a batch. */
+static Sphere loadSphere(const Narrowphase::SphereArrays & spheres, size_t i)
+{
+  return Sphere{{spheres.fX[i], spheres.fY[i], spheres.fZ[i]},
+                spheres.fRadius[i]};
+}
+
+/******************************************************************************/
+/* Fill in a contact from floats. */
+static void setContact(Contact & contact, float px, float py, float pz,
+                       float nx, float ny, float nz, float depth)
+{
+  contact.fPoint = Math::Vector4f(px, py, pz, 1.0f);
+  contact.fNormal = Math::Vector4f(nx, ny, nz, 0.0f);
+  contact.fDepth = depth;
+}
+
+/******************************************************************************/
+/* Test two boxes. The SSE batch version performs the same operations in the
+ * same order so that both produce identical contacts. */
+static bool collideBoxBox(const Box & a, const Box & b, Contact & contact)
+{
+  /* Find the distance B has to move along and against every axis to leave
+   * A. The contact point is the centre of the overlapping region. */
+  float point[3], depth[3], sign[3];
+  for(size_t axis = 0; axis < 3; axis++)
+  {
+    float forward = a.fMax[axis] - b.fMin[axis];
+    float backward = b.fMax[axis] - a.fMin[axis];
+    if(forward < 0.0f || backward < 0.0f)
+    {
+      return false;
+    }
+
+    depth[axis] = std::min(forward, backward);
+    sign[axis] = forward <= backward ? 1.0f : -1.0f;
+    point[axis] = (std::max(a.fMin[axis], b.fMin[axis]) +
+                   std::min(a.fMax[axis], b.fMax[axis])) * 0.5f;
+  }
+
+  /* The normal is the axis of least penetration. */
+  size_t axis = depth[1] < depth[0] ? 1 : 0;
+  axis = depth[2] < depth[axis] ? 2 : axis;
+  float normal[3] = {0.0f, 0.0f, 0.0f};
+  normal[axis] = sign[axis];
+
+  setContact(contact, point[0], point[1], point[2], normal[0], normal[1],
+             normal[2], depth[axis]);
+  return true;
+}
+
+/******************************************************************************/
+/* Test a box and a sphere. */
+static bool collideBoxSphere(const Box & a, const Sphere & b,
+                             Contact & contact)
+{
+  /* Find the point of the box closest to the centre of the sphere. */
+  const float * c = b.fCentre;
+  float q[3], d[3];
+  for(size_t axis = 0; axis < 3; axis++)
+  {
+    q[axis] = std::min(std::max(c[axis], a.fMin[axis]), a.fMax[axis]);
+    d[axis] = c[axis] - q[axis];
+  }
+
+  float distanceSq = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+  if(distanceSq > b.fRadius * b.fRadius)
+  {
+    return false;
+  }
+
+  /* The centre is outside the box, push along the closest point. */
+  if(distanceSq > 0.0f)
+  {
+    float distance = std::sqrt(distanceSq);
+    float invDistance = 1.0f / distance;
+    setContact(contact, q[0], q[1], q[2], d[0] * invDistance,
+               d[1] * invDistance, d[2] * invDistance, b.fRadius - distance);
+    return true;
+  }
+
+  /* The centre is inside the box, push through the nearest face. */
+  float best = c[0] - a.fMin[0];
+  float normal[3] = {-1.0f, 0.0f, 0.0f};
+  float point[3] = {a.fMin[0], c[1], c[2]};
+  for(size_t face = 1; face < 6; face++)
+  {
+    size_t axis = face / 2;
+    bool isMax = face % 2 == 1;
+    float distance = isMax ? a.fMax[axis] - c[axis] : c[axis] - a.fMin[axis];
+    if(distance < best)
+    {
+      best = distance;
+      normal[0] = normal[1] = normal[2] = 0.0f;
+      normal[axis] = isMax ? 1.0f : -1.0f;
+      point[0] = c[0];
+      point[1] = c[1];
+      point[2] = c[2];
+      point[axis] = isMax ? a.fMax[axis] : a.fMin[axis];
+    }
+  }
+
+  setContact(contact, point[0], point[1], point[2], normal[0], normal[1],
+             normal[2], b.fRadius + best);
+  return true;
+}
+
+/******************************************************************************/
+/* Test two spheres. */
+static bool collideSphereSphere(const Sphere & a, const Sphere & b,
+                                Contact & contact)
+{
+  /* The spheres overlap if their centres are closer than their radii. */
+  float dx = b.fCentre[0] - a.fCentre[0];
+  float dy = b.fCentre[1] - a.fCentre[1];
+  float dz = b.fCentre[2] - a.fCentre[2];
+  float distanceSq = dx * dx + dy * dy + dz * dz;
+  float radii = a.fRadius + b.fRadius;
+  if(distanceSq > radii * radii)
+  {
+    return false;
+  }
+
+  /* Concentric spheres are pushed apart along the up axis. */
+  float distance = std::sqrt(distanceSq);
+  float nx = 0.0f, ny = 1.0f, nz = 0.0f;
+  if(distance > 0.0f)
+  {
+    float invDistance = 1.0f / distance;
+    nx = dx * invDistance;
+    ny = dy * invDistance;
+    nz = dz * invDistance;
+  }
+
+  /* The contact point is in the middle of the overlap. */
+  float depth = radii - distance;
+  float offset = a.fRadius - depth * 0.5f;
+  setContact(contact, a.fCentre[0] + nx * offset, a.fCentre[1] + ny * offset,
+             a.fCentre[2] + nz * offset, nx, ny, nz, depth);
+  return true;
+}
+
+/******************************************************************************/
+/* Project a triangle onto an axis. */
+static void projectTriangle(const Math::Vector4f & axis,
+  const Math::Vector4f & a, const Math::Vector4f & b, const Math::Vector4f & c,
+  float & min, float & max)
+{
+  float pa = axis.dot(a), pb = axis.dot(b), pc = axis.dot(c);
+  min = std::min(std::min(pa, pb), pc);
+  max = std::max(std::max(pa, pb), pc);
+}
+
+/******************************************************************************/
+/* Test a box against a triangle with the 13 axes of Akenine-Moller's test,
+ * tracking the axis of least penetration. */
+static bool collideBoxTriangle(const AABB & box, const Math::Vector4f & a,
+  const Math::Vector4f & b, const Math::Vector4f & c, Contact & contact)
+{
+  /* Work relative to the centre of the box. */
+  Math::Vector4f centre = (box.fMin + box.fMax) * 0.5f;
+  Math::Vector4f extent = (box.fMax - box.fMin) * 0.5f;
+  Math::Vector4f v0 = a - centre, v1 = b - centre, v2 = c - centre;
+  const Math::Vector4f edges[3] = {v1 - v0, v2 - v1, v0 - v2};
+  const Math::Vector4f boxAxes[3] = {Math::Vector4f(1.0f, 0.0f, 0.0f, 0.0f),
+                                     Math::Vector4f(0.0f, 1.0f, 0.0f, 0.0f),
+                                     Math::Vector4f(0.0f, 0.0f, 1.0f, 0.0f)};
+
+  /* Test an axis, the box interval is symmetric around the origin. */
+  AxisTest sat;
+  auto testAxis = [&](const Math::Vector4f & axis)
+  {
+    float lengthSq = axis.dot(axis);
+    if(lengthSq < kMinAxisLengthSq)
+    {
+      return true;
+    }
+
+    float radius = extent.x() * std::fabs(axis.x()) +
+                   extent.y() * std::fabs(axis.y()) +
+                   extent.z() * std::fabs(axis.z());
+    float min, max;
+    projectTriangle(axis, v0, v1, v2, min, max);
+    return sat.test(axis, -radius, radius, min, max, lengthSq);
+  };
+
+  /* The face normals of the box and the triangle. */
+  for(const Math::Vector4f & axis : boxAxes)
+  {
+    if(!testAxis(axis))
+    {
+      return false;
+    }
+  }
+  if(!testAxis(edges[0].cross(edges[1])))
+  {
+    return false;
+  }
+
+  /* The cross products of the box axes and the triangle edges. */
+  for(const Math::Vector4f & boxAxis : boxAxes)
+  {
+    for(const Math::Vector4f & edge : edges)
+    {
+      if(!testAxis(boxAxis.cross(edge)))
+      {
+        return false;
+      }
+    }
+  }
+
+  /* The contact is the point of the triangle closest to the box centre,
+   * clamped into the box. */
+  Math::Vector4f point = Triangle{a, b, c}.closestPoint(centre);
+  contact.fPoint = Math::Vector4f::min(Math::Vector4f::max(point, box.fMin),
+                                       box.fMax);
+  contact.fPoint.w() = 1.0f;
+  contact.fNormal = sat.fNormal;
+  contact.fDepth = sat.fDepth;
+  return true;
+}
+
+/******************************************************************************/
+/* Test a sphere against a triangle. */
+static bool collideSphereTriangle(const Math::Vector4f & centre, float radius,
+  const Math::Vector4f & a, const Math::Vector4f & b, const Math::Vector4f & c,
+  Contact & contact)
+{
+  /* The sphere overlaps if the closest point is within the radius. */
+  Math::Vector4f point = Triangle{a, b, c}.closestPoint(centre);
+  Math::Vector4f offset = point - centre;
+  float distanceSq = offset.dot(offset);
+  if(distanceSq > radius * radius)
+  {
+    return false;
+  }
+
+  /* The normal points from the sphere towards the triangle. If the centre is
+   * on the triangle, push the sphere out of the triangle's front face. */
+  float distance = std::sqrt(distanceSq);
+  if(distance > 0.0f)
+  {
+    contact.fNormal = offset * (1.0f / distance);
+  }
+  else
+  {
+    contact.fNormal = (b - a).cross(c - a);
+    contact.fNormal = contact.fNormal *
+                      (-1.0f / std::sqrt(contact.fNormal.dot(contact.fNormal)));
+  }
+  contact.fNormal.w() = 0.0f;
+  contact.fPoint = point;
+  contact.fPoint.w() = 1.0f;
+  contact.fDepth = radius - distance;
+  return true;
+}
+
+/******************************************************************************/
+/* Find where the segment pq crosses the triangle abc. */
+static bool intersectSegmentTriangle(const Math::Vector4f & p,
+  const Math::Vector4f & q, const Math::Vector4f & a, const Math::Vector4f & b,
+  const Math::Vector4f & c, Math::Vector4f & point)
+{
+  /* The crossing must be between p and q. */
+  Math::Vector4f dir = q - p;
+  float t;
+  if(!Triangle{a, b, c}.intersect(p, dir, t) || t > 1.0f)
+  {
+    return false;
+  }
+
+  point = p + dir * t;
+  return true;
+}
+
+/******************************************************************************/
+/* Test two triangles with the separating axis test. Besides the face normals
+ * and the edge cross products, the in-plane edge normals are tested so that
+ * coplanar triangles are handled. */
+static bool collideTriangleTriangle(const Math::Vector4f * a,
+                                    const Math::Vector4f * b,
+                                    Contact & contact)
+{
+  const Math::Vector4f edgesA[3] = {a[1] - a[0], a[2] - a[1], a[0] - a[2]};
+  const Math::Vector4f edgesB[3] = {b[1] - b[0], b[2] - b[1], b[0] - b[2]};
+  const Math::Vector4f normalA = edgesA[0].cross(edgesA[1]);
+  const Math::Vector4f normalB = edgesB[0].cross(edgesB[1]);
+
+  /* Test an axis. */
+  AxisTest sat;
+  auto testAxis = [&](const Math::Vector4f & axis)
+  {
+    float lengthSq = axis.dot(axis);
+    if(lengthSq < kMinAxisLengthSq)
+    {
+      return true;
+    }
+
+    float minA, maxA, minB, maxB;
+    projectTriangle(axis, a[0], a[1], a[2], minA, maxA);
+    projectTriangle(axis, b[0], b[1], b[2], minB, maxB);
+    return sat.test(axis, minA, maxA, minB, maxB, lengthSq);
+  };
+
+  /* The face normals. */
+  if(!testAxis(normalA) || !testAxis(normalB))
+  {
+    return false;
+  }
+
+  /* The edge cross products and the in-plane edge normals. */
+  for(size_t i = 0; i < 3; i++)
+  {
+    if(!testAxis(normalA.cross(edgesA[i])) ||
+       !testAxis(normalB.cross(edgesB[i])))
+    {
+      return false;
+    }
+
+    for(size_t j = 0; j < 3; j++)
+    {
+      if(!testAxis(edgesA[i].cross(edgesB[j])))
+      {
+        return false;
+      }
+    }
+  }
+
+  /* Degenerate triangles have no axes to test. */
+  if(sat.fDepth == std::numeric_limits<float>::max())
+  {
+    return false;
+  }
+
+  /* The contact point is the centre of the points where the edges of each
+   * triangle cross the other triangle, i.e. the middle of the intersection
+   * segment. */
+  Math::Vector4f sum, point;
+  size_t count = 0;
+  for(size_t i = 0; i < 3; i++)
+  {
+    if(intersectSegmentTriangle(a[i], a[(i + 1) % 3], b[0], b[1], b[2],
+                                point))
+    {
+      sum += point;
+      ++count;
+    }
+
+    if(intersectSegmentTriangle(b[i], b[(i + 1) % 3], a[0], a[1], a[2],
+                                point))
+    {
+      sum += point;
+      ++count;
+    }
+  }
+
+  /* Coplanar triangles have no crossings, approximate the contact point by
+   * the midpoint of the closest points. */
+  if(count > 0)
+  {
+    contact.fPoint = sum * (1.0f / float(count));
+  }
+  else
+  {
+    Math::Vector4f centroidB = (b[0] + b[1] + b[2]) * (1.0f / 3.0f);
+    Math::Vector4f pointA = Triangle{a[0], a[1], a[2]}.closestPoint(centroidB);
+    Math::Vector4f pointB = Triangle{b[0], b[1], b[2]}.closestPoint(pointA);
+    contact.fPoint = (pointA + pointB) * 0.5f;
+  }
+  contact.fPoint.w() = 1.0f;
+  contact.fNormal = sat.fNormal;
+  contact.fDepth = sat.fDepth;
+  return true;
+}
+
+/******************************************************************************/
+/* Return the smallest root of a t^2 + b t + c = 0 in [0, maxRoot]. */
+static bool lowestRoot(float a, float b, float c, float maxRoot, float & root)
+{
+  const float discriminant = b * b - 4.0f * a * c;
+  if(a == 0.0f || discriminant < 0.0f)
+  {
+    return false;
+  }
+  const float sqrtDiscriminant = std::sqrt(discriminant);
+  float root1 = (-b - sqrtDiscriminant) / (2.0f * a);
+  float root2 = (-b + sqrtDiscriminant) / (2.0f * a);
+  if(root1 > root2)
+  {
+    std::swap(root1, root2);
+  }
+  for(float candidate : {root1, root2})
+  {
+    if(candidate >= 0.0f && candidate <= maxRoot)
+    {
+      root = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+/******************************************************************************/
+/* Find when a moving sphere first touches a box. The squared distance of the
+ * centre from the box is a quadratic in t between the times the centre
+ * crosses the planes of the box, so every piece is solved in order. */
+static bool sweepSphereBox(const Sphere & a, const float * motion,
+                           const Box & b, float & toi)
+{
+  /* The times the centre crosses the planes of the box, kept in order with
+   * an insertion sort as there are at most six. */
+  float breaks[8] = {0.0f};
+  size_t count = 1;
+  for(size_t axis = 0; axis < 3; axis++)
+  {
+    if(motion[axis] == 0.0f)
+    {
+      continue;
+    }
+    for(float plane : {b.fMin[axis], b.fMax[axis]})
+    {
+      float t = (plane - a.fCentre[axis]) / motion[axis];
+      if(t > 0.0f && t < 1.0f)
+      {
+        size_t i = count++;
+        for(; breaks[i - 1] > t; i--)
+        {
+          breaks[i] = breaks[i - 1];
+        }
+        breaks[i] = t;
+      }
+    }
+  }
+  breaks[count++] = 1.0f;
+
+  const float radiusSq = a.fRadius * a.fRadius;
+  for(size_t piece = 0; piece + 1 < count; piece++)
+  {
+    /* Build the quadratic from the axes the centre is outside of. */
+    const float begin = breaks[piece], end = breaks[piece + 1];
+    const float middle = 0.5f * (begin + end);
+    float qa = 0.0f, qb = 0.0f, qc = -radiusSq;
+    for(size_t axis = 0; axis < 3; axis++)
+    {
+      const float x = a.fCentre[axis] + motion[axis] * middle;
+      float offset, rate;
+      if(x < b.fMin[axis])
+      {
+        offset = b.fMin[axis] - a.fCentre[axis];
+        rate = -motion[axis];
+      }
+      else if(x > b.fMax[axis])
+      {
+        offset = a.fCentre[axis] - b.fMax[axis];
+        rate = motion[axis];
+      }
+      else
+      {
+        continue;
+      }
+      qa += rate * rate;
+      qb += 2.0f * offset * rate;
+      qc += offset * offset;
+    }
+
+    /* The sphere touches the box where the distance reaches the radius. */
+    if((qa * begin + qb) * begin + qc <= 0.0f)
+    {
+      toi = begin;
+      return true;
+    }
+    float t;
+    if(lowestRoot(qa, qb, qc, end, t) && t >= begin)
+    {
+      toi = t;
+      return true;
+    }
+  }
+  return false;
+}
+
+/******************************************************************************/
+/* Find when a moving sphere first touches a triangle, if it's before toi. The
+ * sphere either hits the face first, or one of the edges or corners. */
+static bool sweepSphereTriangle(const Math::Vector4f & centre, float radius,
+  const Math::Vector4f & motion, const Triangle & triangle, float & toi,
+  Math::Vector4f & point)
+{
+  /* A sphere that overlaps at the start hits at once. */
+  Math::Vector4f closest = triangle.closestPoint(centre);
+  Math::Vector4f offset = closest - centre;
+  if(offset.dot(offset) <= radius * radius)
+  {
+    toi = 0.0f;
+    point = closest;
+    return true;
+  }
+
+  /* The face is hit where the sphere reaches the plane, if the point where
+   * it touches the plane is inside the triangle. */
+  const Math::Vector4f & a = triangle.fA;
+  const Math::Vector4f & b = triangle.fB;
+  const Math::Vector4f & c = triangle.fC;
+  Math::Vector4f normal = (b - a).cross(c - a);
+  const float lengthSq = normal.dot(normal);
+  if(lengthSq > 0.0f)
+  {
+    Math::Vector4f unit = normal * (1.0f / std::sqrt(lengthSq));
+    float distance = unit.dot(centre - a);
+    if(distance < 0.0f)
+    {
+      unit = unit * -1.0f;
+      distance = -distance;
+    }
+    const float speed = unit.dot(motion);
+    if(speed < 0.0f && distance - radius <= -speed * toi)
+    {
+      const float t = (distance - radius) / -speed;
+      Math::Vector4f p = centre + motion * t - unit * radius;
+      if((b - a).cross(p - a).dot(normal) >= 0.0f &&
+         (c - b).cross(p - b).dot(normal) >= 0.0f &&
+         (a - c).cross(p - c).dot(normal) >= 0.0f)
+      {
+        toi = t;
+        point = p;
+        return true;
+      }
+    }
+  }
+
+  /* The corners, |centre + motion t - corner| = radius. */
+  bool hit = false;
+  const float motionSq = motion.dot(motion);
+  for(const Math::Vector4f * corner : {&a, &b, &c})
+  {
+    Math::Vector4f toCentre = centre - *corner;
+    float t;
+    if(lowestRoot(motionSq, 2.0f * motion.dot(toCentre),
+                  toCentre.dot(toCentre) - radius * radius, toi, t))
+    {
+      toi = t;
+      point = *corner;
+      hit = true;
+    }
+  }
+
+  /* The edges, the distance of the centre from the line of the edge is the
+   * radius and the closest point is between the corners. */
+  const Math::Vector4f * edges[3][2] = {{&a, &b}, {&b, &c}, {&c, &a}};
+  for(const auto & edge : edges)
+  {
+    Math::Vector4f direction = *edge[1] - *edge[0];
+    Math::Vector4f toCorner = *edge[0] - centre;
+    const float edgeSq = direction.dot(direction);
+    const float edgeMotion = direction.dot(motion);
+    const float edgeCorner = direction.dot(toCorner);
+    float t;
+    if(edgeSq > 0.0f && lowestRoot(edgeMotion * edgeMotion - edgeSq * motionSq,
+         2.0f * (edgeSq * motion.dot(toCorner) - edgeMotion * edgeCorner),
+         edgeSq * (radius * radius - toCorner.dot(toCorner)) +
+         edgeCorner * edgeCorner, toi, t))
+    {
+      const float f = (edgeMotion * t - edgeCorner) / edgeSq;
+      if(f >= 0.0f && f <= 1.0f)
+      {
+        toi = t;
+        point = *edge[0] + direction * f;
+        hit = true;
+      }
+    }
+  }
+  return hit;
+}
+
+/******************************************************************************/
+/* Fill in the contact of a sweep at the time of impact, the normal points
+ * from the centre of the sphere towards the point. */
+static void setSweepContact(const BoundingSphere & sphere,
+                            const Math::Vector4f & motion, float toi,
+                            const Math::Vector4f & point, Contact & contact)
+{
+  Math::Vector4f offset = point - (sphere.centre() + motion * toi);
+  const float distance = std::sqrt(offset.dot(offset));
+  contact.fNormal = distance > 0.0f ? offset * (1.0f / distance) :
+                                      Math::Vector4f(0.0f, -1.0f, 0.0f);
+  contact.fNormal.w() = 0.0f;
+  contact.fPoint = point;
+  contact.fPoint.w() = 1.0f;
+  contact.fDepth = std::max(sphere.radius() - distance, 0.0f);
+}
+
+/******************************************************************************/
+bool Narrowphase::collide(const BoundingBox & a, const BoundingBox & b,
+                          Contact & contact)
+{
+  return collideBoxBox(makeBox(a), makeBox(b), contact);
+}
+
+/******************************************************************************/
+bool Narrowphase::collide(const BoundingBox & a, const BoundingSphere & b,
+                          Contact & contact)
+{
+  return collideBoxSphere(makeBox(a), makeSphere(b), contact);
+}
+
+/******************************************************************************/
+bool Narrowphase::collide(const BoundingSphere & a, const BoundingSphere & b,
+                          Contact & contact)
+{
+  return collideSphereSphere(makeSphere(a), makeSphere(b), contact);
+}
+
+/******************************************************************************/
+size_t Narrowphase::collide(const BoundingBox & a, const BoundingMesh & b,
+                            Contact * contacts, size_t capacity)
+{
+  /* Test the triangles in the leaves of the hierarchy the box overlaps. */
+  AABB box = a.aabb();
+  size_t count = 0;
+  if(capacity == 0)
+  {
+    return 0;
+  }
+
+  b.queryAABB(box, [&](size_t i)
+  {
+    Triangle triangle = b.triangle(i);
+    if(box.overlaps(triangle.bounds()) &&
+       collideBoxTriangle(box, triangle.fA, triangle.fB, triangle.fC,
+                          contacts[count]))
+    {
+      ++count;
+    }
+    return count < capacity;
+  });
+  return count;
+}
+
+/******************************************************************************/
+size_t Narrowphase::collide(const BoundingSphere & a, const BoundingMesh & b,
+                            Contact * contacts, size_t capacity)
+{
+  /* Test the triangles in the leaves of the hierarchy the sphere's bounds
+   * overlap. */
+  AABB bounds = a.aabb();
+  size_t count = 0;
+  if(capacity == 0)
+  {
+    return 0;
+  }
+
+  b.queryAABB(bounds, [&](size_t i)
+  {
+    Triangle triangle = b.triangle(i);
+    if(bounds.overlaps(triangle.bounds()) &&
+       collideSphereTriangle(a.centre(), a.radius(), triangle.fA, triangle.fB,
+                             triangle.fC, contacts[count]))
+    {
+      ++count;
+    }
+    return count < capacity;
+  });
+  return count;
+}
+
+/******************************************************************************/
+size_t Narrowphase::collide(const BoundingMesh & a, const BoundingMesh & b,
+                            Contact * contacts, size_t capacity)
+{
+  /* Only the triangles inside the other mesh's bounds can overlap. */
+  AABB boundsA = a.aabb(), boundsB = b.aabb();
+  if(capacity == 0 || !boundsA.overlaps(boundsB))
+  {
+    return 0;
+  }
+
+  /* Query the hierarchy of B with every triangle of A inside B's bounds. */
+  size_t count = 0;
+  a.queryAABB(boundsB, [&](size_t i)
+  {
+    Triangle triangleA = a.triangle(i);
+    const Math::Vector4f triA[3] = {triangleA.fA, triangleA.fB, triangleA.fC};
+    AABB triBoundsA = triangleA.bounds();
+    if(!triBoundsA.overlaps(boundsB))
+    {
+      return true;
+    }
+
+    b.queryAABB(triBoundsA, [&](size_t j)
+    {
+      Triangle triangleB = b.triangle(j);
+      const Math::Vector4f triB[3] = {triangleB.fA, triangleB.fB,
+                                      triangleB.fC};
+      if(triBoundsA.overlaps(triangleB.bounds()) &&
+         collideTriangleTriangle(triA, triB, contacts[count]))
+      {
+        ++count;
+      }
+      return count < capacity;
+    });
+    return count < capacity;
+  });
+  return count;
+}
+
+/******************************************************************************/
+size_t Narrowphase::collide(const BoundingVolume & a, const BoundingVolume & b,
+                            Contact * contacts, size_t capacity)
+{
+  /* Nothing can be written to an empty buffer. */
+  if(capacity == 0)
+  {
+    return 0;
+  }
+
+  typedef BoundingVolume::Types Types;
+  size_t count = 0;
+  bool isSwapped = false;
+  switch(a.type())
+  {
+    case Types::Box:
+    {
+      const BoundingBox & box = static_cast<const BoundingBox &>(a);
+      switch(b.type())
+      {
+        case Types::Box:
+          count = collide(box, static_cast<const BoundingBox &>(b),
+                          contacts[0]) ? 1 : 0;
+          break;
+
+        case Types::Sphere:
+          count = collide(box, static_cast<const BoundingSphere &>(b),
+                          contacts[0]) ? 1 : 0;
+          break;
+
+        case Types::Mesh:
+          count = collide(box, static_cast<const BoundingMesh &>(b), contacts,
+                          capacity);
+          break;
+      }
+      break;
+    }
+
+    case Types::Sphere:
+    {
+      const BoundingSphere & sphere = static_cast<const BoundingSphere &>(a);
+      switch(b.type())
+      {
+        case Types::Box:
+          count = collide(static_cast<const BoundingBox &>(b), sphere,
+                          contacts[0]) ? 1 : 0;
+          isSwapped = true;
+          break;
+
+        case Types::Sphere:
+          count = collide(sphere, static_cast<const BoundingSphere &>(b),
+                          contacts[0]) ? 1 : 0;
+          break;
+
+        case Types::Mesh:
+          count = collide(sphere, static_cast<const BoundingMesh &>(b),
+                          contacts, capacity);
+          break;
+      }
+      break;
+    }
+
+    case Types::Mesh:
+    {
+      const BoundingMesh & mesh = static_cast<const BoundingMesh &>(a);
+      switch(b.type())
+      {
+        case Types::Box:
+          count = collide(static_cast<const BoundingBox &>(b), mesh, contacts,
+                          capacity);
+          isSwapped = true;
+          break;
+
+        case Types::Sphere:
+          count = collide(static_cast<const BoundingSphere &>(b), mesh,
+                          contacts, capacity);
+          isSwapped = true;
+          break;
+
+        case Types::Mesh:
+          count = collide(mesh, static_cast<const BoundingMesh &>(b),
+                          contacts, capacity);
+          break;
+      }
+      break;
+    }
+  }
+
+  /* Make the normals point from a to b. */
+  if(isSwapped)
+  {
+    for(size_t i = 0; i < count; i++)
+    {
+      contacts[i].fNormal = contacts[i].fNormal * -1.0f;
+    }
+  }
+  return count;
+}
+
+#ifdef ANUBIS_HAS_SSE
+/******************************************************************************/
+/* Write the contacts of the lanes set in the mask. */
+static size_t storeContacts4(int mask, size_t index, __m128 px, __m128 py,
+                             __m128 pz, __m128 nx, __m128 ny, __m128 nz,
+                             __m128 depth, uint32_t * pairs,
+                             Contact * contacts)
+{
+  /* Spill the lanes. */
+  float lanes[7][4];
+  _mm_storeu_ps(lanes[0], px);
+  _mm_storeu_ps(lanes[1], py);
+  _mm_storeu_ps(lanes[2], pz);
+  _mm_storeu_ps(lanes[3], nx);
+  _mm_storeu_ps(lanes[4], ny);
+  _mm_storeu_ps(lanes[5], nz);
+  _mm_storeu_ps(lanes[6], depth);
+
+  /* Write the contacts in lane order. */
+  size_t count = 0;
+  while(mask)
+  {
+    int k = Common::Bits::countTrailingZeros(mask);
+    pairs[count] = uint32_t(index + k);
+    setContact(contacts[count], lanes[0][k], lanes[1][k], lanes[2][k],
+               lanes[3][k], lanes[4][k], lanes[5][k], lanes[6][k]);
+    ++count;
+    mask &= mask - 1;
+  }
+  return count;
+}
+
+/******************************************************************************/
+/* Return -1 or 1 depending on the mask, 1 where the mask is set. */
+static __m128 signOf(__m128 mask)
+{
+  return _mm_blendv_ps(_mm_set1_ps(-1.0f), _mm_set1_ps(1.0f), mask);
+}
+#endif /* ANUBIS_HAS_SSE */
+
+/******************************************************************************/
+size_t Narrowphase::collide(const BoxArrays & a, const BoxArrays & b,
+                            size_t count, uint32_t * pairs, Contact * contacts)
+{
+  size_t hits = 0, i = 0;
+
+  #ifdef ANUBIS_HAS_SSE
+    const __m128 zero = _mm_setzero_ps(), half = _mm_set1_ps(0.5f);
+    for(; i + 4 <= count; i += 4)
+    {
+      /* Load the boxes. */
+      __m128 aMinX = _mm_loadu_ps(a.fMinX + i), aMaxX = _mm_loadu_ps(a.fMaxX + i);
+      __m128 aMinY = _mm_loadu_ps(a.fMinY + i), aMaxY = _mm_loadu_ps(a.fMaxY + i);
+      __m128 aMinZ = _mm_loadu_ps(a.fMinZ + i), aMaxZ = _mm_loadu_ps(a.fMaxZ + i);
+      __m128 bMinX = _mm_loadu_ps(b.fMinX + i), bMaxX = _mm_loadu_ps(b.fMaxX + i);
+      __m128 bMinY = _mm_loadu_ps(b.fMinY + i), bMaxY = _mm_loadu_ps(b.fMaxY + i);
+      __m128 bMinZ = _mm_loadu_ps(b.fMinZ + i), bMaxZ = _mm_loadu_ps(b.fMaxZ + i);
+
+      /* The distance B has to move along and against every axis. */
+      __m128 forwardX = _mm_sub_ps(aMaxX, bMinX);
+      __m128 forwardY = _mm_sub_ps(aMaxY, bMinY);
+      __m128 forwardZ = _mm_sub_ps(aMaxZ, bMinZ);
+      __m128 backwardX = _mm_sub_ps(bMaxX, aMinX);
+      __m128 backwardY = _mm_sub_ps(bMaxY, aMinY);
+      __m128 backwardZ = _mm_sub_ps(bMaxZ, aMinZ);
+      __m128 depthX = _mm_min_ps(forwardX, backwardX);
+      __m128 depthY = _mm_min_ps(forwardY, backwardY);
+      __m128 depthZ = _mm_min_ps(forwardZ, backwardZ);
+      int mask = _mm_movemask_ps(_mm_and_ps(_mm_and_ps(
+        _mm_cmpge_ps(depthX, zero), _mm_cmpge_ps(depthY, zero)),
+        _mm_cmpge_ps(depthZ, zero)));
+      if(!mask)
+      {
+        continue;
+      }
+
+      /* Select the axis of least penetration. */
+      __m128 isY = _mm_cmplt_ps(depthY, depthX);
+      __m128 depth = _mm_blendv_ps(depthX, depthY, isY);
+      __m128 isZ = _mm_cmplt_ps(depthZ, depth);
+      depth = _mm_blendv_ps(depth, depthZ, isZ);
+      isY = _mm_andnot_ps(isZ, isY);
+      __m128 isX = _mm_andnot_ps(_mm_or_ps(isY, isZ), _mm_cmpeq_ps(zero, zero));
+
+      /* The normal points in the direction B has to move. */
+      __m128 nx = _mm_and_ps(isX, signOf(_mm_cmple_ps(forwardX, backwardX)));
+      __m128 ny = _mm_and_ps(isY, signOf(_mm_cmple_ps(forwardY, backwardY)));
+      __m128 nz = _mm_and_ps(isZ, signOf(_mm_cmple_ps(forwardZ, backwardZ)));
+
+      /* The contact point is the centre of the overlapping region. */
+      hits += storeContacts4(mask, i,
+        _mm_mul_ps(_mm_add_ps(_mm_max_ps(aMinX, bMinX),
+                              _mm_min_ps(aMaxX, bMaxX)), half),
+        _mm_mul_ps(_mm_add_ps(_mm_max_ps(aMinY, bMinY),
+                              _mm_min_ps(aMaxY, bMaxY)), half),
+        _mm_mul_ps(_mm_add_ps(_mm_max_ps(aMinZ, bMinZ),
+                              _mm_min_ps(aMaxZ, bMaxZ)), half),
+        nx, ny, nz, depth, pairs + hits, contacts + hits);
+    }
+  #endif /* ANUBIS_HAS_SSE */
+
+  /* Test the remaining pairs one by one. */
+  for(; i < count; i++)
+  {
+    if(collideBoxBox(loadBox(a, i), loadBox(b, i), contacts[hits]))
+    {
+      pairs[hits++] = uint32_t(i);
+    }
+  }
+  return hits;
+}
+
+/******************************************************************************/
+size_t Narrowphase::collide(const BoxArrays & a, const SphereArrays & b,
+                            size_t count, uint32_t * pairs, Contact * contacts)
+{
+  size_t hits = 0, i = 0;
+
+  #ifdef ANUBIS_HAS_SSE
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 minusOne = _mm_set1_ps(-1.0f);
+    for(; i + 4 <= count; i += 4)
+    {
+      /* Load the boxes and the spheres. */
+      __m128 minX = _mm_loadu_ps(a.fMinX + i), maxX = _mm_loadu_ps(a.fMaxX + i);
+      __m128 minY = _mm_loadu_ps(a.fMinY + i), maxY = _mm_loadu_ps(a.fMaxY + i);
+      __m128 minZ = _mm_loadu_ps(a.fMinZ + i), maxZ = _mm_loadu_ps(a.fMaxZ + i);
+      __m128 cx = _mm_loadu_ps(b.fX + i), cy = _mm_loadu_ps(b.fY + i);
+      __m128 cz = _mm_loadu_ps(b.fZ + i), r = _mm_loadu_ps(b.fRadius + i);
+
+      /* Find the points of the boxes closest to the centres. */
+      __m128 qx = _mm_min_ps(_mm_max_ps(cx, minX), maxX);
+      __m128 qy = _mm_min_ps(_mm_max_ps(cy, minY), maxY);
+      __m128 qz = _mm_min_ps(_mm_max_ps(cz, minZ), maxZ);
+      __m128 dx = _mm_sub_ps(cx, qx), dy = _mm_sub_ps(cy, qy);
+      __m128 dz = _mm_sub_ps(cz, qz);
+      __m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx),
+                                                _mm_mul_ps(dy, dy)),
+                                     _mm_mul_ps(dz, dz));
+      int mask = _mm_movemask_ps(_mm_cmple_ps(distanceSq, _mm_mul_ps(r, r)));
+      if(!mask)
+      {
+        continue;
+      }
+
+      /* The contacts of the centres outside the boxes. */
+      __m128 distance = _mm_sqrt_ps(distanceSq);
+      __m128 invDistance = _mm_div_ps(one, distance);
+      __m128 isOutside = _mm_cmpgt_ps(distanceSq, zero);
+
+      /* The contacts of the centres inside the boxes, through the nearest
+       * face in the same order as the scalar test. */
+      __m128 best = _mm_sub_ps(cx, minX);
+      __m128 nx = minusOne, ny = zero, nz = zero;
+      __m128 px = minX, py = cy, pz = cz;
+      auto face = [&](__m128 faceDistance, __m128 fx, __m128 fy, __m128 fz,
+                      __m128 facePX, __m128 facePY, __m128 facePZ)
+      {
+        __m128 closer = _mm_cmplt_ps(faceDistance, best);
+        best = _mm_blendv_ps(best, faceDistance, closer);
+        nx = _mm_blendv_ps(nx, fx, closer);
+        ny = _mm_blendv_ps(ny, fy, closer);
+        nz = _mm_blendv_ps(nz, fz, closer);
+        px = _mm_blendv_ps(px, facePX, closer);
+        py = _mm_blendv_ps(py, facePY, closer);
+        pz = _mm_blendv_ps(pz, facePZ, closer);
+      };
+      face(_mm_sub_ps(maxX, cx), one, zero, zero, maxX, cy, cz);
+      face(_mm_sub_ps(cy, minY), zero, minusOne, zero, cx, minY, cz);
+      face(_mm_sub_ps(maxY, cy), zero, one, zero, cx, maxY, cz);
+      face(_mm_sub_ps(cz, minZ), zero, zero, minusOne, cx, cy, minZ);
+      face(_mm_sub_ps(maxZ, cz), zero, zero, one, cx, cy, maxZ);
+
+      /* Select the contact of each lane. */
+      hits += storeContacts4(mask, i,
+        _mm_blendv_ps(px, qx, isOutside), _mm_blendv_ps(py, qy, isOutside),
+        _mm_blendv_ps(pz, qz, isOutside),
+        _mm_blendv_ps(nx, _mm_mul_ps(dx, invDistance), isOutside),
+        _mm_blendv_ps(ny, _mm_mul_ps(dy, invDistance), isOutside),
+        _mm_blendv_ps(nz, _mm_mul_ps(dz, invDistance), isOutside),
+        _mm_blendv_ps(_mm_add_ps(r, best), _mm_sub_ps(r, distance),
+                      isOutside),
+        pairs + hits, contacts + hits);
+    }
+  #endif /* ANUBIS_HAS_SSE */
+
+  /* Test the remaining pairs one by one. */
+  for(; i < count; i++)
+  {
+    if(collideBoxSphere(loadBox(a, i), loadSphere(b, i), contacts[hits]))
+    {
+      pairs[hits++] = uint32_t(i);
+    }
+  }
+  return hits;
+}
+
+/******************************************************************************/
+size_t Narrowphase::collide(const SphereArrays & a, const SphereArrays & b,
+                            size_t count, uint32_t * pairs, Contact * contacts)
+{
+  size_t hits = 0, i = 0;
+
+  #ifdef ANUBIS_HAS_SSE
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    for(; i + 4 <= count; i += 4)
+    {
+      /* Load the spheres. */
+      __m128 ax = _mm_loadu_ps(a.fX + i), ay = _mm_loadu_ps(a.fY + i);
+      __m128 az = _mm_loadu_ps(a.fZ + i), ar = _mm_loadu_ps(a.fRadius + i);
+      __m128 dx = _mm_sub_ps(_mm_loadu_ps(b.fX + i), ax);
+      __m128 dy = _mm_sub_ps(_mm_loadu_ps(b.fY + i), ay);
+      __m128 dz = _mm_sub_ps(_mm_loadu_ps(b.fZ + i), az);
+      __m128 radii = _mm_add_ps(ar, _mm_loadu_ps(b.fRadius + i));
+
+      /* The spheres overlap if their centres are closer than their radii. */
+      __m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx),
+                                                _mm_mul_ps(dy, dy)),
+                                     _mm_mul_ps(dz, dz));
+      int mask = _mm_movemask_ps(_mm_cmple_ps(distanceSq,
+                                              _mm_mul_ps(radii, radii)));
+      if(!mask)
+      {
+        continue;
+      }
+
+      /* Concentric spheres are pushed apart along the up axis. */
+      __m128 distance = _mm_sqrt_ps(distanceSq);
+      __m128 invDistance = _mm_div_ps(one, distance);
+      __m128 isApart = _mm_cmpgt_ps(distance, zero);
+      __m128 nx = _mm_and_ps(isApart, _mm_mul_ps(dx, invDistance));
+      __m128 ny = _mm_blendv_ps(one, _mm_mul_ps(dy, invDistance), isApart);
+      __m128 nz = _mm_and_ps(isApart, _mm_mul_ps(dz, invDistance));
+
+      /* The contact points are in the middle of the overlaps. */
+      __m128 depth = _mm_sub_ps(radii, distance);
+      __m128 offset = _mm_sub_ps(ar, _mm_mul_ps(depth, half));
+      hits += storeContacts4(mask, i, _mm_add_ps(ax, _mm_mul_ps(nx, offset)),
+        _mm_add_ps(ay, _mm_mul_ps(ny, offset)),
+        _mm_add_ps(az, _mm_mul_ps(nz, offset)), nx, ny, nz, depth,
+        pairs + hits, contacts + hits);
+    }
+  #endif /* ANUBIS_HAS_SSE */
+
+  /* Test the remaining pairs one by one. */
+  for(; i < count; i++)
+  {
+    if(collideSphereSphere(loadSphere(a, i), loadSphere(b, i),
+                           contacts[hits]))
+    {
+      pairs[hits++] = uint32_t(i);
+    }
+  }
+  return hits;
+}
+
+/******************************************************************************/
+bool Narrowphase::sweep(const BoundingSphere & a, const Math::Vector4f & motion,
+                        const BoundingBox & b, float & toi, Contact & contact)
+{
+  const Box box = makeBox(b);
+  const float displacement[3] = {motion.x(), motion.y(), motion.z()};
+  if(!sweepSphereBox(makeSphere(a), displacement, box, toi))
+  {
+    return false;
+  }
+
+  /* The point of the box closest to the centre at the time of impact. */
+  Math::Vector4f centre = a.centre() + motion * toi;
+  Math::Vector4f point(
+    std::min(std::max(centre.x(), box.fMin[0]), box.fMax[0]),
+    std::min(std::max(centre.y(), box.fMin[1]), box.fMax[1]),
+    std::min(std::max(centre.z(), box.fMin[2]), box.fMax[2]), 1.0f);
+
+  /* A centre that starts inside the box is pushed through the nearest
+   * face, flipped to point from the sphere towards the box. */
+  if(toi == 0.0f && point.x() == centre.x() && point.y() == centre.y() &&
+     point.z() == centre.z())
+  {
+    collideBoxSphere(box, makeSphere(a), contact);
+    contact.fNormal = contact.fNormal * -1.0f;
+    return true;
+  }
+  setSweepContact(a, motion, toi, point, contact);
+  return true;
+}
+
+/******************************************************************************/
+bool Narrowphase::sweep(const BoundingSphere & a, const Math::Vector4f & motion,
+                        const BoundingMesh & b, float & toi, Contact & contact)
+{
+  /* Only the triangles that overlap the bounds of the whole motion can be
+   * hit. */
+  AABB start = a.aabb();
+  AABB bounds = AABB::merge(start, AABB(start.fMin + motion,
+                                        start.fMax + motion));
+  Math::Vector4f point;
+  bool hit = false;
+  toi = 1.0f;
+  b.queryAABB(bounds, [&](size_t i)
+  {
+    Triangle triangle = b.triangle(i);
+    if(bounds.overlaps(triangle.bounds()) &&
+       sweepSphereTriangle(a.centre(), a.radius(), motion, triangle, toi,
+                           point))
+    {
+      hit = true;
+    }
+    return toi > 0.0f;
+  });
+
+  if(hit)
+  {
+    setSweepContact(a, motion, toi, point, contact);
+  }
+  return hit;
+}
@@ -0,0 +1,456 @@
+#include "../../../Include/Anubis/Physics/RigidBodyWorld.hpp"
+
+using namespace Anubis;
+using namespace Anubis::Physics;
+
+/** The number of lane groups integrated per task. */
+static const size_t kGroupsPerTask = 256;
+
+/******************************************************************************/
+RigidBodyWorld::RigidBodyWorld() : fCount(0), fAwakeCount(0),
+  fGravity(0.0f, -9.81f, 0.0f, 0.0f), fLinearDamping(0.0f),
+  fAngularDamping(0.0f) {}
+
+/******************************************************************************/
+void RigidBodyWorld::reserve(size_t count)
+{
+  /* Round up to whole lane groups. */
+  count = (count + kLaneWidth - 1) / kLaneWidth * kLaneWidth;
+  for(std::vector<float> & field : fFields)
+  {
+    field.reserve(count);
+  }
+  fSlots.fDense.reserve(count);
+  fSlots.fSlots.reserve(count);
+  fIslandNext.reserve(count);
+}
+
+/******************************************************************************/
+void RigidBodyWorld::clear()
+{
+  for(std::vector<float> & field : fFields)
+  {
+    field.clear();
+  }
+  fSlots = Slots();
+  fIslandNext.clear();
+  fCount = 0;
+  fAwakeCount = 0;
+}
+
+/******************************************************************************/
+void RigidBodyWorld::resetLane(size_t dense)
+{
+  /* All zero except the orientation, which is the identity. */
+  for(std::vector<float> & field : fFields)
+  {
+    field[dense] = 0.0f;
+  }
+  at(Fields::OrientationW, dense) = 1.0f;
+}
+
+/******************************************************************************/
+void RigidBodyWorld::swapBodies(size_t a, size_t b)
+{
+  if(a == b)
+  {
+    return;
+  }
+  for(std::vector<float> & field : fFields)
+  {
+    std::swap(field[a], field[b]);
+  }
+  std::swap(fSlots.fSlots[a], fSlots.fSlots[b]);
+  fSlots.fDense[fSlots.fSlots[a]] = uint32_t(a);
+  fSlots.fDense[fSlots.fSlots[b]] = uint32_t(b);
+}
+
+/******************************************************************************/
+RigidBodyWorld::BodyID RigidBodyWorld::add(const BodyDesc & desc)
+{
+  /* Grow the arrays by a lane group of inert bodies when they are full. */
+  const size_t dense = fCount++;
+  if(dense == fFields[0].size())
+  {
+    for(std::vector<float> & field : fFields)
+    {
+      field.resize(dense + kLaneWidth, 0.0f);
+    }
+    for(size_t i = dense; i < dense + kLaneWidth; i++)
+    {
+      at(Fields::OrientationW, i) = 1.0f;
+    }
+  }
+
+  /* Get an ID, either recycled or new. */
+  BodyID id = fSlots.fFreeList;
+  if(id != kNullBody)
+  {
+    fSlots.fFreeList = fSlots.fDense[id];
+    fSlots.fDense[id] = uint32_t(dense);
+  }
+  else
+  {
+    id = BodyID(fSlots.fDense.size());
+    fSlots.fDense.push_back(uint32_t(dense));
+    fIslandNext.push_back(id);
+  }
+  fSlots.fSlots.push_back(id);
+
+  /* New bodies are awake, move it in front of the sleeping bodies. */
+  fIslandNext[id] = id;
+  swapBodies(dense, fAwakeCount++);
+
+  /* Store the state. Bodies without mass are not affected by gravity. */
+  setPosition(id, desc.fPosition);
+  setOrientation(id, desc.fOrientation);
+  setLinearVelocity(id, desc.fLinearVelocity);
+  setAngularVelocity(id, desc.fAngularVelocity);
+  const float invMass = desc.fMass > 0.0f ? 1.0f / desc.fMass : 0.0f;
+  const size_t index = fSlots.fDense[id];
+  at(Fields::InverseMass, index) = invMass;
+  at(Fields::GravityScale, index) = invMass > 0.0f ? desc.fGravityScale : 0.0f;
+
+  /* The inverse inertia, moments of 0 lock the axis. */
+  for(size_t axis = 0; axis < 3; axis++)
+  {
+    float moment = desc.fInertia.memory()[axis];
+    at(Fields(size_t(Fields::InverseInertiaX) + axis), index) =
+      moment > 0.0f && invMass > 0.0f ? 1.0f / moment : 0.0f;
+  }
+  return id;
+}
+
+/******************************************************************************/
+void RigidBodyWorld::remove(BodyID id)
+{
+  /* Removing a body from a sleeping island wakes the island, since the
+   * bodies that rested on it may fall. */
+  wake(id);
+
+  /* Move the body to the end of the awake bodies, then to the end of the
+   * arrays, so both ranges stay packed. */
+  swapBodies(fSlots.fDense[id], --fAwakeCount);
+  const size_t last = --fCount;
+  swapBodies(fAwakeCount, last);
+  fSlots.fSlots.pop_back();
+
+  /* Put the ID on the free list. */
+  fSlots.fDense[id] = fSlots.fFreeList;
+  fSlots.fFreeList = id;
+
+  /* The old last body becomes padding, drop lane groups that are empty. */
+  resetLane(last);
+  if(fCount % kLaneWidth == 0)
+  {
+    for(std::vector<float> & field : fFields)
+    {
+      field.resize(fCount);
+    }
+  }
+}
+
+/******************************************************************************/
+void RigidBodyWorld::wake(BodyID id)
+{
+  if(isAwake(id))
+  {
+    return;
+  }
+
+  /* Move every body of the island in front of the sleeping bodies. */
+  BodyID body = id;
+  do
+  {
+    const BodyID next = fIslandNext[body];
+    fIslandNext[body] = body;
+    swapBodies(fSlots.fDense[body], fAwakeCount++);
+    at(Fields::SleepTimer, fSlots.fDense[body]) = 0.0f;
+    body = next;
+  }
+  while(body != id);
+}
+
+/******************************************************************************/
+void RigidBodyWorld::sleep(const BodyID * bodies, size_t count)
+{
+  for(size_t i = 0; i < count; i++)
+  {
+    /* Link the island and stop the body. */
+    const BodyID id = bodies[i];
+    fIslandNext[id] = bodies[(i + 1) % count];
+    const size_t dense = fSlots.fDense[id];
+    for(Fields first : {Fields::LinearVelocityX, Fields::AngularVelocityX,
+                        Fields::ForceX, Fields::TorqueX})
+    {
+      for(size_t axis = 0; axis < 3; axis++)
+      {
+        at(Fields(size_t(first) + axis), dense) = 0.0f;
+      }
+    }
+
+    /* Move it behind the awake bodies. */
+    swapBodies(dense, --fAwakeCount);
+  }
+}
+
+/******************************************************************************/
+Math::Vector4f RigidBodyWorld::getVector(Fields first, BodyID id,
+                                         float w) const
+{
+  const size_t dense = fSlots.fDense[id];
+  return Math::Vector4f(at(first, dense),
+                        at(Fields(size_t(first) + 1), dense),
+                        at(Fields(size_t(first) + 2), dense), w);
+}
+
+/******************************************************************************/
+void RigidBodyWorld::setVector(Fields first, BodyID id,
+                               const Math::Vector4f & value)
+{
+  const size_t dense = fSlots.fDense[id];
+  at(first, dense) = value.x();
+  at(Fields(size_t(first) + 1), dense) = value.y();
+  at(Fields(size_t(first) + 2), dense) = value.z();
+}
+
+/******************************************************************************/
+Math::Vector4f RigidBodyWorld::position(BodyID id) const
+{
+  return getVector(Fields::PositionX, id, 1.0f);
+}
+
+/******************************************************************************/
+Math::Quaternion RigidBodyWorld::orientation(BodyID id) const
+{
+  Math::Vector4f xyz = getVector(Fields::OrientationX, id, 0.0f);
+  return Math::Quaternion(xyz.x(), xyz.y(), xyz.z(),
+                          at(Fields::OrientationW, fSlots.fDense[id]));
+}
+
+/******************************************************************************/
+Math::Vector4f RigidBodyWorld::linearVelocity(BodyID id) const
+{
+  return getVector(Fields::LinearVelocityX, id, 0.0f);
+}
+
+/******************************************************************************/
+Math::Vector4f RigidBodyWorld::angularVelocity(BodyID id) const
+{
+  return getVector(Fields::AngularVelocityX, id, 0.0f);
+}
+
+/******************************************************************************/
+void RigidBodyWorld::setPosition(BodyID id, const Math::Vector4f & position)
+{
+  wake(id);
+  setVector(Fields::PositionX, id, position);
+}
+
+/******************************************************************************/
+void RigidBodyWorld::setOrientation(BodyID id,
+                                    const Math::Quaternion & orientation)
+{
+  wake(id);
+  setVector(Fields::OrientationX, id, Math::Vector4f(orientation.x(),
+    orientation.y(), orientation.z(), 0.0f));
+  at(Fields::OrientationW, fSlots.fDense[id]) = orientation.w();
+}
+
+/******************************************************************************/
+void RigidBodyWorld::setLinearVelocity(BodyID id,
+                                       const Math::Vector4f & velocity)
+{
+  wake(id);
+  setVector(Fields::LinearVelocityX, id, velocity);
+}
+
+/******************************************************************************/
+void RigidBodyWorld::setAngularVelocity(BodyID id,
+                                        const Math::Vector4f & velocity)
+{
+  wake(id);
+  setVector(Fields::AngularVelocityX, id, velocity);
+}
+
+/******************************************************************************/
+void RigidBodyWorld::applyForce(BodyID id, const Math::Vector4f & force)
+{
+  wake(id);
+  setVector(Fields::ForceX, id, getVector(Fields::ForceX, id, 0.0f) + force);
+}
+
+/******************************************************************************/
+void RigidBodyWorld::applyTorque(BodyID id, const Math::Vector4f & torque)
+{
+  wake(id);
+  setVector(Fields::TorqueX, id,
+            getVector(Fields::TorqueX, id, 0.0f) + torque);
+}
+
+/******************************************************************************/
+uint64_t RigidBodyWorld::checksum() const
+{
+  uint64_t hash = 0xCBF29CE484222325ULL;
+  auto mix = [&hash](uint32_t value)
+  {
+    for(size_t byte = 0; byte < 4; byte++)
+    {
+      hash = (hash ^ ((value >> (byte * 8)) & 0xFF)) * 0x100000001B3ULL;
+    }
+  };
+
+  /* The bits of the floats, the padding is not part of the state. */
+  for(size_t dense = 0; dense < fCount; dense++)
+  {
+    mix(fSlots.fSlots[dense]);
+    for(const std::vector<float> & field : fFields)
+    {
+      uint32_t bits;
+      memcpy(&bits, &field[dense], sizeof(bits));
+      mix(bits);
+    }
+  }
+  mix(uint32_t(fAwakeCount));
+  return hash;
+}
+
+/******************************************************************************/
+Lane4 RigidBodyWorld::awakeLanes(size_t dense) const
+{
+  float lanes[kLaneWidth];
+  for(size_t k = 0; k < kLaneWidth; k++)
+  {
+    lanes[k] = dense + k < fAwakeCount ? 1.0f : 0.0f;
+  }
+  return Lane4::load(lanes);
+}
+
+/******************************************************************************/
+void RigidBodyWorld::integrateVelocityGroups(size_t begin, size_t end,
+                                             float dt)
+{
+  /* The constants shared by all the lane groups. */
+  const Lane4 step = Lane4::set(dt);
+  const Lane4 linearDamping = Lane4::set(1.0f / (1.0f + dt * fLinearDamping));
+  const Lane4 angularDamping = Lane4::set(1.0f /
+                                          (1.0f + dt * fAngularDamping));
+  const Vec3x4 gravity = {Lane4::set(fGravity.x()), Lane4::set(fGravity.y()),
+                          Lane4::set(fGravity.z())};
+  const Vec3x4 zero = {Lane4::set(0.0f), Lane4::set(0.0f), Lane4::set(0.0f)};
+
+  for(size_t group = begin; group < end; group++)
+  {
+    const size_t i = group * kLaneWidth;
+
+    /* The last group may be shared with sleeping bodies. */
+    const Lane4 awake = awakeLanes(i);
+
+    /* Update the linear velocity from gravity and the applied force. */
+    const Lane4 invMass = Lane4::load(data(Fields::InverseMass) + i);
+    const Lane4 gravityScale = Lane4::load(data(Fields::GravityScale) + i);
+    Vec3x4 linear = loadVector(Fields::LinearVelocityX, i);
+    Vec3x4 force = loadVector(Fields::ForceX, i);
+    linear = Vec3x4::select(awake, (linear + (gravity * gravityScale +
+                            force * invMass) * step) * linearDamping, linear);
+    storeVector(Fields::LinearVelocityX, i, linear);
+
+    /* Transform the torque into body space, apply the inverse inertia and
+     * transform the acceleration back into world space. */
+    Vec3x4 q = loadVector(Fields::OrientationX, i);
+    Lane4 qw = Lane4::load(data(Fields::OrientationW) + i);
+    Vec3x4 local = loadVector(Fields::TorqueX, i).rotate(zero - q, qw);
+    Vec3x4 invInertia = loadVector(Fields::InverseInertiaX, i);
+    local = Vec3x4{local.x * invInertia.x, local.y * invInertia.y,
+                   local.z * invInertia.z};
+    Vec3x4 angular = loadVector(Fields::AngularVelocityX, i);
+    angular = Vec3x4::select(awake, (angular + local.rotate(q, qw) * step) *
+                             angularDamping, angular);
+    storeVector(Fields::AngularVelocityX, i, angular);
+
+    /* The forces only last for one step. */
+    storeVector(Fields::ForceX, i, zero);
+    storeVector(Fields::TorqueX, i, zero);
+  }
+}
+
+/******************************************************************************/
+void RigidBodyWorld::integratePositionGroups(size_t begin, size_t end,
+                                             float dt)
+{
+  /* The constants shared by all the lane groups. */
+  const Lane4 step = Lane4::set(dt);
+  const Lane4 halfStep = Lane4::set(0.5f * dt);
+
+  for(size_t group = begin; group < end; group++)
+  {
+    const size_t i = group * kLaneWidth;
+
+    /* The last group may be shared with sleeping bodies. */
+    const Lane4 awake = awakeLanes(i);
+
+    /* Move the bodies with their velocity. */
+    Vec3x4 linear = loadVector(Fields::LinearVelocityX, i);
+    Vec3x4 position = loadVector(Fields::PositionX, i);
+    storeVector(Fields::PositionX, i,
+                Vec3x4::select(awake, position + linear * step, position));
+
+    /* Integrate the orientation, q' = q + dt / 2 * (w, 0) * q, and
+     * renormalise it. */
+    Vec3x4 angular = loadVector(Fields::AngularVelocityX, i);
+    Vec3x4 q = loadVector(Fields::OrientationX, i);
+    Lane4 qw = Lane4::load(data(Fields::OrientationW) + i);
+    Vec3x4 dq = angular * qw + angular.cross(q);
+    Lane4 dqw = -angular.dot(q);
+    Vec3x4 newQ = q + dq * halfStep;
+    Lane4 newQw = qw + dqw * halfStep;
+    Lane4 invLength = Lane4::set(1.0f) / (newQ.dot(newQ) + newQw *
+                                          newQw).sqrt();
+    storeVector(Fields::OrientationX, i,
+                Vec3x4::select(awake, newQ * invLength, q));
+    Lane4::select(awake, newQw * invLength,
+                  qw).store(data(Fields::OrientationW) + i);
+  }
+}
+
+/******************************************************************************/
+template <typename Kernel>
+void RigidBodyWorld::forEachGroup(TaskPool * pool, Kernel && kernel)
+{
+  /* The arrays are always whole lane groups, the sleeping bodies after the
+   * last group of awake bodies are skipped. */
+  const size_t groups = (fAwakeCount + kLaneWidth - 1) / kLaneWidth;
+  if(pool && groups > kGroupsPerTask)
+  {
+    pool->parallelFor(groups, kGroupsPerTask, kernel);
+  }
+  else
+  {
+    kernel(0, groups);
+  }
+}
+
+/******************************************************************************/
+void RigidBodyWorld::integrateVelocities(float dt, TaskPool * pool)
+{
+  forEachGroup(pool, [&](size_t begin, size_t end)
+  {
+    integrateVelocityGroups(begin, end, dt);
+  });
+}
+
+/******************************************************************************/
+void RigidBodyWorld::integratePositions(float dt, TaskPool * pool)
+{
+  forEachGroup(pool, [&](size_t begin, size_t end)
+  {
+    integratePositionGroups(begin, end, dt);
+  });
+}
+
+/******************************************************************************/
+void RigidBodyWorld::integrate(float dt, TaskPool * pool)
+{
+  integrateVelocities(dt, pool);
+  integratePositions(dt, pool);
+}
@@ -3,23 +3,315 @@
 using namespace Anubis::Common;
 using namespace Anubis::Physics;
 
+/******************************************************************************/
+Scene::Scene(bool trackChanges) : fIndexCount(0), fTrackChanges(trackChanges),
+  fRootNode(nullptr) {}
+
+/******************************************************************************/
+Scene::~Scene()
+{
+  /* Release all the nodes. */
+  clear();
+}
+
+/******************************************************************************/
+void Scene::resizeIndex(size_t count)
+{
+  /* Calculate the power of two size that keeps the load factor <= 50%. */
+  size_t size = 16;
+  while(size < count * 2)
+  {
+    size <<= 1;
+  }
+
+  /* Nothing to do if the index is allready big enough. */
+  if(size <= fIndex.size())
+  {
+    return;
+  }
+
+  /* Resize the table and reinsert the nodes. */
+  fIndex.assign(size, nullptr);
+  rebuildIndex();
+}
+
+/******************************************************************************/
+void Scene::rebuildIndex()
+{
+  /* Clear the table. */
+  std::fill(fIndex.begin(), fIndex.end(), nullptr);
+  fIndexCount = 0;
+
+  /* Walk the tree in pre-order and index every node. */
+  Node * node = fRootNode;
+  while(node)
+  {
+    indexNode(node);
+
+    /* Descend to the first child if there is one. */
+    if(node->fFirstChild)
+    {
+      node = node->fFirstChild;
+      continue;
+    }
+
+    /* Otherwise move up until a sibling is found. */
+    while(node && !node->fNextSibling)
+    {
+      node = node->fParent;
+    }
+
+    if(node)
+    {
+      node = node->fNextSibling;
+    }
+  }
+}
+
+/******************************************************************************/
+void Scene::indexNode(Node * node)
+{
+  /* Nodes without data can not be looked up. */
+  if(!node->fData)
+  {
+    return;
+  }
+
+  /* Grow the index if it is at 50% load. */
+  if((fIndexCount + 1) * 2 > fIndex.size())
+  {
+    resizeIndex(fIndexCount + 1);
+
+    /* The resize reinserted all the nodes in the tree, including this one if
+     * it is allready linked in. */
+    if(find(node->fID) == node)
+    {
+      return;
+    }
+  }
+
+  /* Probe for an empty slot. */
+  size_t mask = fIndex.size() - 1;
+  size_t i = node->fID.hash() & mask;
+  while(fIndex[i] != nullptr)
+  {
+    i = (i + 1) & mask;
+  }
+
+  /* Store the node. */
+  fIndex[i] = node;
+  ++fIndexCount;
+}
+
+/******************************************************************************/
+void Scene::unindexNode(Node * node)
+{
+  /* Nothing to do if the index is empty. */
+  if(fIndex.empty() || !node->fData)
+  {
+    return;
+  }
+
+  /* Find the slot of the node. */
+  size_t mask = fIndex.size() - 1;
+  size_t i = node->fID.hash() & mask;
+  while(fIndex[i] != node)
+  {
+    /* Stop if the node is not in the index. */
+    if(fIndex[i] == nullptr)
+    {
+      return;
+    }
+
+    i = (i + 1) & mask;
+  }
+
+  /* Remove the node and shift the following entries of the probe sequence
+   * back so that no tombstones are required. */
+  fIndex[i] = nullptr;
+  --fIndexCount;
+
+  for(size_t j = (i + 1) & mask; fIndex[j] != nullptr; j = (j + 1) & mask)
+  {
+    /* The ideal slot of the entry. */
+    size_t k = fIndex[j]->fID.hash() & mask;
+
+    /* Move the entry into the hole if the hole lies cyclically between the
+     * ideal slot and the current slot. */
+    if((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j)))
+    {
+      fIndex[i] = fIndex[j];
+      fIndex[j] = nullptr;
+      i = j;
+    }
+  }
+}
+
+/******************************************************************************/
+Scene::Node * Scene::find(const UUID & uuid) const
+{
+  /* Nothing can be found in an empty index. */
+  if(fIndexCount == 0)
+  {
+    return nullptr;
+  }
+
+  /* Probe until the node or an empty slot is found. */
+  size_t mask = fIndex.size() - 1;
+  for(size_t i = uuid.hash() & mask; fIndex[i] != nullptr; i = (i + 1) & mask)
+  {
+    if(fIndex[i]->fID == uuid)
+    {
+      return fIndex[i];
+    }
+  }
+
+  /* The node does not exist. */
+  return nullptr;
+}
+
+/******************************************************************************/
+void Scene::destroySubtree(Node * node)
+{
+  /* Destroy the nodes in post-order without recursion so that very deep trees
+   * can not overflow the stack. */
+  Node * cur = node;
+  while(true)
+  {
+    /* Descend to a leaf. */
+    while(cur->fFirstChild)
+    {
+      cur = cur->fFirstChild;
+    }
+
+    /* Stop once the root of the subtree is reached. */
+    if(cur == node)
+    {
+      break;
+    }
+
+    /* Unlink the leaf, destroy it and continue with its parent. */
+    Node * parent = cur->fParent;
+    parent->removeChild(cur);
+    unindexNode(cur);
+    fNodePool.destroy(cur);
+    cur = parent;
+  }
+
+  /* Destroy the root of the subtree. */
+  unindexNode(node);
+  fNodePool.destroy(node);
+}
+
+/******************************************************************************/
+void Scene::reserve(size_t nodeCount)
+{
+  fNodePool.reserve(nodeCount);
+  resizeIndex(nodeCount);
+}
+
+/******************************************************************************/
+void Scene::clear()
+{
+  /* Release the data held by the nodes. The nodes themselves hold no other
+   * resources, thus their memory can be returned to the pool in one go. */
+  Node * node = fRootNode;
+  while(node)
+  {
+    node->fData.reset();
+
+    if(node->fFirstChild)
+    {
+      node = node->fFirstChild;
+      continue;
+    }
+
+    while(node && !node->fNextSibling)
+    {
+      node = node->fParent;
+    }
+
+    if(node)
+    {
+      node = node->fNextSibling;
+    }
+  }
+
+  /* Bulk release all the nodes. */
+  fNodePool.reset();
+  fRootNode = nullptr;
+
+  /* Clear the index. */
+  std::fill(fIndex.begin(), fIndex.end(), nullptr);
+  fIndexCount = 0;
+}
+
 /******************************************************************************/
 void Scene::syncChildren(const Node * srcParent, Node * dstParent)
 {
-  /* Reserve space for all the children. */
-  dstParent->fChildren.reserve(srcParent->fChildren.size());
+  /* Walk both trees in pre-order in lock step. Since the children of each
+   * destination node are made to match the source node before descending,
+   * the two walks always visit matching nodes. */
+  const Node * src = srcParent;
+  Node * dst = dstParent;
 
-  /* Create each of the children. */
-  for(size_t i = 0; i < srcParent->fChildren.size(); i++)
+  while(true)
   {
-    /* Create the new child node and set it's parent and data.*/
-    dstParent->fChildren.push_back(
-          std::make_unique<Node>(dstParent,
-                                 srcParent->fChildren[i]->fData));
+    /* Mirror the children of the source node onto the destination node,
+     * reusing the existing destination children. */
+    Node * dstChild = dst->fFirstChild;
+    for(const Node * srcChild = src->fFirstChild; srcChild;
+        srcChild = srcChild->fNextSibling)
+    {
+      /* Create a new child if the destination has run out. */
+      if(dstChild == nullptr)
+      {
+        dstChild = fNodePool.create(dst);
+        dst->addChild(dstChild);
+      }
+
+      /* Copy the node's contents. */
+      dstChild->fID = srcChild->fID;
+      dstChild->fData = srcChild->fData;
+      dstChild->fTransform = srcChild->fTransform;
+      dstChild->fWorldTransform = srcChild->fWorldTransform;
+      dstChild->fBounds = srcChild->fBounds;
+
+      dstChild = dstChild->fNextSibling;
+    }
 
-    /* Now sync the children of the current child. */
-    syncChildren(srcParent->fChildren[i].get(),
-                 dstParent->fChildren[i].get());
+    /* Destroy any children that no longer exist in the source. */
+    while(dstChild)
+    {
+      Node * next = dstChild->fNextSibling;
+      dst->removeChild(dstChild);
+      destroySubtree(dstChild);
+      dstChild = next;
+    }
+
+    /* Descend into the first child. */
+    if(src->fFirstChild)
+    {
+      src = src->fFirstChild;
+      dst = dst->fFirstChild;
+      continue;
+    }
+
+    /* Otherwise move up until a sibling is found. */
+    while(src != srcParent && !src->fNextSibling)
+    {
+      src = src->fParent;
+      dst = dst->fParent;
+    }
+
+    /* Stop once the walk returned to the starting node. */
+    if(src == srcParent)
+    {
+      break;
+    }
+
+    src = src->fNextSibling;
+    dst = dst->fNextSibling;
   }
 }
 
@@ -30,16 +322,41 @@ void Scene::sync(const Scene * scene)
   if(scene == nullptr)
     return;
 
-  /* Check if the root nodes has the same data. */
-  if(fRootNode->fData == scene->fRootNode->fData)
+  /* An empty source scene simply empties this scene. */
+  if(scene->fRootNode == nullptr)
   {
+    clear();
+    return;
   }
 
-  /* Create a new root node for the scene. */
-  fRootNode = std::make_unique<Node>(nullptr, scene->fRootNode->fData);
+  /* Reuse the existing root node if there is one. */
+  if(fRootNode == nullptr)
+  {
+    fRootNode = fNodePool.create(nullptr);
+  }
 
-  /* Sync up the children of the scene. */
-  syncChildren(scene->fRootNode.get(), fRootNode.get());
+  /* Copy the root node's contents. */
+  fRootNode->fID = scene->fRootNode->fID;
+  fRootNode->fData = scene->fRootNode->fData;
+  fRootNode->fTransform = scene->fRootNode->fTransform;
+  fRootNode->fWorldTransform = scene->fRootNode->fWorldTransform;
+  fRootNode->fBounds = scene->fRootNode->fBounds;
+
+  /* Sync up the children of the scene. The index is cleared first since the
+   * reused nodes may now hold diffirent data. */
+  std::fill(fIndex.begin(), fIndex.end(), nullptr);
+  fIndexCount = 0;
+  syncChildren(scene->fRootNode, fRootNode);
+
+  /* Make sure the index can hold all the nodes and index them. */
+  if(fIndex.size() < scene->fIndexCount * 2)
+  {
+    resizeIndex(scene->fIndexCount);
+  }
+  else
+  {
+    rebuildIndex();
+  }
 }
 
 /******************************************************************************/
@@ -47,7 +364,7 @@ bool Scene::insert(const UUID & parentID,
                    std::shared_ptr<Common::SubObj> data)
 {
   /* Find where the node must be inserted. */
-  Node * insertPos = nullptr; //find(parentID);
+  Node * insertPos = find(parentID);
 
   /* Check whether the result is valid. */
   if(insertPos == nullptr && parentID != kNullUUID)
@@ -56,8 +373,14 @@ bool Scene::insert(const UUID & parentID,
     return false;
   }
 
+  /* Node UUIDs must be unique in the scene. */
+  if(data && find(data->getID()) != nullptr)
+  {
+    return false;
+  }
+
   /* Create the new node to insert. */
-  std::unique_ptr<Node> node = std::make_unique<Node>(insertPos, data);
+  Node * node = fNodePool.create(insertPos, data);
 
   /* Check if it's the root node. */
   if(insertPos == nullptr)
@@ -70,13 +393,17 @@ bool Scene::insert(const UUID & parentID,
     }
 
     /* Set the node as the new root node. */
-    fRootNode = std::move(node);
+    fRootNode = node;
   }
   /* Otherwise insert the node at the position. */
+  else
   {
-    insertPos->fChildren.push_back(std::move(node));
+    insertPos->addChild(node);
   }
 
+  /* Add the node to the index. */
+  indexNode(node);
+
   /* Check if the change should be tracked. */
   if(fTrackChanges)
   {
@@ -93,7 +420,7 @@ bool Scene::insert(const UUID & parentID,
 bool Scene::remove(const UUID & nodeID)
 {
   /* Find where the node that must be removed. */
-  Node * removePos = nullptr; //find(nodeID);
+  Node * removePos = find(nodeID);
 
   /* Check if the node was found. */
   if(removePos == nullptr)
@@ -102,6 +429,19 @@ bool Scene::remove(const UUID & nodeID)
     return false;
   }
 
+  /* Unlink the node from the tree. */
+  if(removePos->isRoot())
+  {
+    fRootNode = nullptr;
+  }
+  else
+  {
+    removePos->fParent->removeChild(removePos);
+  }
+
+  /* Destroy the node and all of it's children. */
+  destroySubtree(removePos);
+
   /* Check if the change should be tracked. */
   if(fTrackChanges)
   {
@@ -114,3 +454,170 @@ bool Scene::remove(const UUID & nodeID)
   return true;
 }
 
+/******************************************************************************/
+bool Scene::setTransform(const UUID & nodeID, const Math::Matrix4f & transform)
+{
+  /* Find the node. */
+  Node * node = find(nodeID);
+  if(node == nullptr)
+  {
+    return false;
+  }
+
+  /* Set the local transform. */
+  node->fTransform = transform;
+  return true;
+}
+
+/******************************************************************************/
+bool Scene::getWorldTransform(const UUID & nodeID,
+                              Math::Matrix4f & transform) const
+{
+  /* Find the node. */
+  const Node * node = find(nodeID);
+  if(node == nullptr)
+  {
+    return false;
+  }
+
+  /* Return the world transform. */
+  transform = node->fWorldTransform;
+  return true;
+}
+
+/******************************************************************************/
+bool Scene::setBounds(const UUID & nodeID, const AABB & bounds)
+{
+  /* Find the node. */
+  Node * node = find(nodeID);
+  if(node == nullptr)
+  {
+    return false;
+  }
+
+  /* Set the bounds. */
+  node->fBounds = bounds;
+  return true;
+}
+
+/******************************************************************************/
+bool Scene::getBounds(const UUID & nodeID, AABB & bounds) const
+{
+  /* Find the node. */
+  const Node * node = find(nodeID);
+  if(node == nullptr)
+  {
+    return false;
+  }
+
+  /* Return the bounds. */
+  bounds = node->fBounds;
+  return true;
+}
+
+/******************************************************************************/
+void Scene::updateSubtreeTransforms(Node * node)
+{
+  /* Walk the subtree in pre-order so that parents are always updated before
+   * their children. */
+  Node * cur = node;
+  while(cur)
+  {
+    /* Concatenate the parent's world transform with the local transform. */
+    if(cur->fParent)
+    {
+      cur->fWorldTransform = cur->fParent->fWorldTransform * cur->fTransform;
+    }
+    else
+    {
+      cur->fWorldTransform = cur->fTransform;
+    }
+
+    /* Descend to the first child if there is one. */
+    if(cur->fFirstChild)
+    {
+      cur = cur->fFirstChild;
+      continue;
+    }
+
+    /* Otherwise move up until a sibling is found without leaving the
+     * subtree. */
+    while(cur != node && !cur->fNextSibling)
+    {
+      cur = cur->fParent;
+    }
+
+    cur = cur == node ? nullptr : cur->fNextSibling;
+  }
+}
+
+/******************************************************************************/
+void Scene::updateTransforms(TaskPool * pool)
+{
+  /* Nothing to do for an empty scene. */
+  if(fRootNode == nullptr)
+  {
+    return;
+  }
+
+  /* Update small scenes serially. */
+  if(pool == nullptr || pool->getThreadCount() < 2 ||
+     getNodeCount() < kMinParallelTransformNodes)
+  {
+    updateSubtreeTransforms(fRootNode);
+    return;
+  }
+
+  /* The root is updated here, it's children form the first set of
+   * independent subtrees. */
+  fRootNode->fWorldTransform = fRootNode->fTransform;
+  fTransformRoots.clear();
+  for(Node * child = fRootNode->fFirstChild; child; child = child->fNextSibling)
+  {
+    fTransformRoots.push_back(child);
+  }
+
+  /* Split the subtrees one level further until there are enough of them to
+   * balance the threads, i.e. for a root with only a few large children. */
+  const size_t target = pool->getThreadCount() * kTransformSubtreesPerThread;
+  bool canSplit = true;
+  while(fTransformRoots.size() < target && canSplit)
+  {
+    canSplit = false;
+    fTransformScratch.clear();
+    for(Node * node : fTransformRoots)
+    {
+      /* Leaves can not be split. */
+      if(node->isLeaf())
+      {
+        fTransformScratch.push_back(node);
+        continue;
+      }
+
+      /* Update the node here and replace it with it's children. */
+      node->fWorldTransform = node->fParent->fWorldTransform *
+                              node->fTransform;
+
+      for(Node * child = node->fFirstChild; child; child = child->fNextSibling)
+      {
+        fTransformScratch.push_back(child);
+      }
+
+      canSplit = true;
+    }
+
+    fTransformRoots.swap(fTransformScratch);
+  }
+
+  /* Update the subtrees concurrently. */
+  const size_t grainSize = std::max<size_t>(1, fTransformRoots.size() /
+                                               target);
+  pool->parallelFor(fTransformRoots.size(), grainSize,
+                    [this](size_t begin, size_t end)
+  {
+    for(size_t i = begin; i < end; i++)
+    {
+      updateSubtreeTransforms(fTransformRoots[i]);
+    }
+  });
+}
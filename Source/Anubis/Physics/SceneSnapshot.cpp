@@ -0,0 +1,375 @@
+#include "../../../Include/Anubis/Physics/SceneSnapshot.hpp"
+
+#if ANUBIS_OS == ANUBIS_OS_UNIX || ANUBIS_OS == ANUBIS_OS_OSX
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif /* ANUBIS_OS == ANUBIS_OS_UNIX || ANUBIS_OS == ANUBIS_OS_OSX */
+
+using namespace Anubis;
+using namespace Anubis::Physics;
+
+/** The magic number at the start of a snapshot, "ANSS" in memory. */
+static const uint32_t kSnapshotMagic = 0x53534E41;
+
+/** The value written in the host's byte order to detect a mismatch. */
+static const uint32_t kSnapshotByteOrder = 0x01020304;
+
+/* The sections are read in place, thus the types must have no padding that
+ * would differ between builds. */
+static_assert(sizeof(Math::Matrix4f) == 16 * sizeof(float),
+              "Matrix4f must be 16 packed floats.");
+static_assert(sizeof(AABB) == 8 * sizeof(float),
+              "AABB must be 8 packed floats.");
+
+/******************************************************************************/
+/* Round the offset up to the alignment of the sections. */
+static ANUBIS_FORCE_INLINE uint64_t alignSection(uint64_t offset)
+{
+  const uint64_t mask = SceneSnapshot::kSectionAlignment - 1;
+  return (offset + mask) & ~mask;
+}
+
+/******************************************************************************/
+SceneSnapshot::SceneSnapshot() : fData(nullptr), fSize(0), fMapped(false),
+  fNodeCount(0), fTransforms(nullptr), fWorldTransforms(nullptr),
+  fBounds(nullptr), fIDs(nullptr), fCompIDs(nullptr), fParents(nullptr) {}
+
+/******************************************************************************/
+SceneSnapshot::~SceneSnapshot()
+{
+  close();
+}
+
+/******************************************************************************/
+void SceneSnapshot::write(const Scene & scene, std::vector<uint8_t> & buffer)
+{
+  /* Lay out the sections, the largest alignment first. */
+  const uint64_t count = scene.getNodeCount();
+  Header header;
+  header.fMagic = kSnapshotMagic;
+  header.fVersion = kVersion;
+  header.fByteOrder = kSnapshotByteOrder;
+  header.fNodeCount = uint32_t(count);
+  header.fTransforms = alignSection(sizeof(Header));
+  header.fWorldTransforms = alignSection(header.fTransforms +
+                                         count * sizeof(Math::Matrix4f));
+  header.fBounds = alignSection(header.fWorldTransforms +
+                                count * sizeof(Math::Matrix4f));
+  header.fIDs = alignSection(header.fBounds + count * sizeof(AABB));
+  header.fCompIDs = alignSection(header.fIDs +
+                                 count * Common::UUID::kOctetCount);
+  header.fParents = alignSection(header.fCompIDs +
+                                 count * Common::UUID::kOctetCount);
+  header.fSize = alignSection(header.fParents + count * sizeof(uint32_t));
+
+  /* The padding is zeroed so that equal scenes give identical files. */
+  buffer.assign(size_t(header.fSize), 0);
+  uint8_t * data = buffer.data();
+  memcpy(data, &header, sizeof(Header));
+
+  /* Walk the tree in pre-order, the stack holds the indices of the ancestors
+   * of the current node. */
+  std::vector<uint32_t> ancestors;
+  const Scene::Node * node = scene.fRootNode;
+  uint32_t index = 0;
+  while(node)
+  {
+    /* Store the node. */
+    const uint32_t parent = ancestors.empty() ? kNoParent : ancestors.back();
+    const Common::UUID compID = node->fData ? node->fData->getCompID() :
+                                              Common::kNullUUID;
+    memcpy(data + header.fTransforms + index * sizeof(Math::Matrix4f),
+           &node->fTransform, sizeof(Math::Matrix4f));
+    memcpy(data + header.fWorldTransforms + index * sizeof(Math::Matrix4f),
+           &node->fWorldTransform, sizeof(Math::Matrix4f));
+    memcpy(data + header.fBounds + index * sizeof(AABB), &node->fBounds,
+           sizeof(AABB));
+    memcpy(data + header.fIDs + index * Common::UUID::kOctetCount,
+           node->fID.octets(), Common::UUID::kOctetCount);
+    memcpy(data + header.fCompIDs + index * Common::UUID::kOctetCount,
+           compID.octets(), Common::UUID::kOctetCount);
+    memcpy(data + header.fParents + index * sizeof(uint32_t), &parent,
+           sizeof(uint32_t));
+
+    /* Descend to the first child if there is one. */
+    if(node->fFirstChild)
+    {
+      ancestors.push_back(index++);
+      node = node->fFirstChild;
+      continue;
+    }
+    ++index;
+
+    /* Otherwise move up until a sibling is found. */
+    while(node && !node->fNextSibling)
+    {
+      node = node->fParent;
+      if(node)
+      {
+        ancestors.pop_back();
+      }
+    }
+
+    if(node)
+    {
+      node = node->fNextSibling;
+    }
+  }
+  assert(index == count && "Every node of the scene must be in the tree.");
+}
+
+/******************************************************************************/
+bool SceneSnapshot::write(const Scene & scene, const std::string & path)
+{
+  std::vector<uint8_t> buffer;
+  write(scene, buffer);
+
+  /* Write the snapshot in one go. */
+  FILE * file = fopen(path.c_str(), "wb");
+  if(file == nullptr)
+  {
+    return false;
+  }
+  const bool written = fwrite(buffer.data(), 1, buffer.size(), file) ==
+                       buffer.size();
+  return fclose(file) == 0 && written;
+}
+
+/******************************************************************************/
+bool SceneSnapshot::open(const std::string & path)
+{
+  close();
+
+  #if ANUBIS_OS == ANUBIS_OS_UNIX || ANUBIS_OS == ANUBIS_OS_OSX
+    /* Map the whole file, the mapping stays valid once the file is closed. */
+    int file = ::open(path.c_str(), O_RDONLY);
+    if(file < 0)
+    {
+      return false;
+    }
+    struct stat info;
+    if(fstat(file, &info) != 0 || info.st_size <= 0)
+    {
+      ::close(file);
+      return false;
+    }
+    void * memory = mmap(nullptr, size_t(info.st_size), PROT_READ,
+                         MAP_PRIVATE, file, 0);
+    ::close(file);
+    if(memory == MAP_FAILED)
+    {
+      return false;
+    }
+
+    /* The whole file is read by a load, so ask for it to be paged in ahead
+     * of the first access. */
+    madvise(memory, size_t(info.st_size), MADV_WILLNEED);
+    fData = static_cast<const uint8_t *>(memory);
+    fSize = size_t(info.st_size);
+    fMapped = true;
+  #else
+    /* Read the file into aligned memory. */
+    FILE * file = fopen(path.c_str(), "rb");
+    if(file == nullptr)
+    {
+      return false;
+    }
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if(size <= 0)
+    {
+      fclose(file);
+      return false;
+    }
+    fBuffer.resize((size_t(size) + sizeof(Math::Matrix4f) - 1) /
+                   sizeof(Math::Matrix4f));
+    const bool read = fread(fBuffer.data(), 1, size_t(size), file) ==
+                      size_t(size);
+    fclose(file);
+    if(!read)
+    {
+      fBuffer.clear();
+      return false;
+    }
+    fData = reinterpret_cast<const uint8_t *>(fBuffer.data());
+    fSize = size_t(size);
+  #endif /* ANUBIS_OS == ANUBIS_OS_UNIX || ANUBIS_OS == ANUBIS_OS_OSX */
+
+  if(!validate())
+  {
+    close();
+    return false;
+  }
+  return true;
+}
+
+/******************************************************************************/
+bool SceneSnapshot::open(const void * data, size_t size)
+{
+  close();
+  fData = static_cast<const uint8_t *>(data);
+  fSize = size;
+  if(!validate())
+  {
+    close();
+    return false;
+  }
+  return true;
+}
+
+/******************************************************************************/
+void SceneSnapshot::close()
+{
+  #if ANUBIS_OS == ANUBIS_OS_UNIX || ANUBIS_OS == ANUBIS_OS_OSX
+    if(fMapped)
+    {
+      munmap(const_cast<uint8_t *>(fData), fSize);
+    }
+  #endif /* ANUBIS_OS == ANUBIS_OS_UNIX || ANUBIS_OS == ANUBIS_OS_OSX */
+  fBuffer.clear();
+  fData = nullptr;
+  fSize = 0;
+  fMapped = false;
+  fNodeCount = 0;
+  fTransforms = nullptr;
+  fWorldTransforms = nullptr;
+  fBounds = nullptr;
+  fIDs = nullptr;
+  fCompIDs = nullptr;
+  fParents = nullptr;
+}
+
+/******************************************************************************/
+bool SceneSnapshot::validate()
+{
+  /* Check the header. */
+  if(fData == nullptr || fSize < sizeof(Header) ||
+     reinterpret_cast<uintptr_t>(fData) % ANUBIS_SIMD_MEM_ALIGNMENT != 0)
+  {
+    return false;
+  }
+  Header header;
+  memcpy(&header, fData, sizeof(Header));
+  if(header.fMagic != kSnapshotMagic || header.fVersion != kVersion ||
+     header.fByteOrder != kSnapshotByteOrder || header.fSize > fSize)
+  {
+    return false;
+  }
+
+  /* Every section must be aligned and lie inside the snapshot. The node
+   * count is 32 bit, thus the products can't overflow. */
+  const uint64_t count = header.fNodeCount;
+  auto fits = [&](uint64_t offset, uint64_t size)
+  {
+    return offset % kSectionAlignment == 0 && offset >= sizeof(Header) &&
+           offset <= header.fSize && count * size <= header.fSize - offset;
+  };
+  if(!fits(header.fTransforms, sizeof(Math::Matrix4f)) ||
+     !fits(header.fWorldTransforms, sizeof(Math::Matrix4f)) ||
+     !fits(header.fBounds, sizeof(AABB)) ||
+     !fits(header.fIDs, Common::UUID::kOctetCount) ||
+     !fits(header.fCompIDs, Common::UUID::kOctetCount) ||
+     !fits(header.fParents, sizeof(uint32_t)))
+  {
+    return false;
+  }
+
+  /* A parent must precede it's children and only the first node may be a
+   * root, so that load() can link the nodes in a single pass. */
+  const uint32_t * parents = reinterpret_cast<const uint32_t *>(fData +
+                                                              header.fParents);
+  if(count > 0 && parents[0] != kNoParent)
+  {
+    return false;
+  }
+  for(uint64_t i = 1; i < count; i++)
+  {
+    if(parents[i] >= i)
+    {
+      return false;
+    }
+  }
+
+  /* Set up the sections. */
+  fNodeCount = header.fNodeCount;
+  fTransforms = reinterpret_cast<const Math::Matrix4f *>(fData +
+                                                         header.fTransforms);
+  fWorldTransforms = reinterpret_cast<const Math::Matrix4f *>(fData +
+                                                    header.fWorldTransforms);
+  fBounds = reinterpret_cast<const AABB *>(fData + header.fBounds);
+  fIDs = fData + header.fIDs;
+  fCompIDs = fData + header.fCompIDs;
+  fParents = parents;
+  return true;
+}
+
+/******************************************************************************/
+bool SceneSnapshot::load(Scene & scene, const DataFactory & factory) const
+{
+  if(fData == nullptr)
+  {
+    return false;
+  }
+
+  /* Size the pool and the index once for the whole snapshot. */
+  scene.clear();
+  if(fNodeCount == 0)
+  {
+    return true;
+  }
+  scene.reserve(fNodeCount);
+
+  /* Without a factory the data of all the nodes shares one block, each node
+   * holds an aliasing pointer to it's element. */
+  std::shared_ptr<std::vector<Common::SubObj>> block;
+  if(!factory)
+  {
+    block = std::make_shared<std::vector<Common::SubObj>>();
+    block->reserve(fNodeCount);
+  }
+
+  /* The nodes are created in pre-order, thus every parent allready exists.
+   * The scene's scratch memory maps the indices to the nodes. */
+  std::vector<Scene::Node*> & nodes = scene.fTransformScratch;
+  nodes.resize(fNodeCount);
+  for(uint32_t i = 0; i < fNodeCount; i++)
+  {
+    /* Create the node's data. */
+    std::shared_ptr<Common::SubObj> data;
+    const Common::UUID uuid = id(i);
+    if(uuid != Common::kNullUUID)
+    {
+      if(factory)
+      {
+        data = factory(uuid, compID(i));
+      }
+      else
+      {
+        block->emplace_back(uuid, compID(i));
+        data = std::shared_ptr<Common::SubObj>(block, &block->back());
+      }
+    }
+
+    /* Create and link the node. */
+    Scene::Node * parent = i == 0 ? nullptr : nodes[fParents[i]];
+    Scene::Node * node = scene.fNodePool.create(parent, data);
+    if(parent)
+    {
+      parent->addChild(node);
+    }
+    else
+    {
+      scene.fRootNode = node;
+    }
+    node->fTransform = fTransforms[i];
+    node->fWorldTransform = fWorldTransforms[i];
+    node->fBounds = fBounds[i];
+    scene.indexNode(node);
+    nodes[i] = node;
+  }
+  nodes.clear();
+  return true;
+}
@@ -0,0 +1,388 @@
+#include "../../../Include/Anubis/Physics/SpatialGrid.hpp"
+
+using namespace Anubis::Physics;
+
+/** The number of queries per chunk when batches are run on a pool. */
+static const size_t kQueryGrainSize = 64;
+
+/******************************************************************************/
+SpatialGrid::SpatialGrid(float cellSize) : fCellSize(cellSize),
+  fInvCellSize(1.0f / cellSize), fFreeList(kNullEntity), fEntityCount(0)
+{
+  /* Start with an empty range of cells. */
+  clear();
+}
+
+/******************************************************************************/
+void SpatialGrid::clear()
+{
+  /* Remove all the cells and entities. */
+  fCells.clear();
+  fTable.clear();
+  fEntities.clear();
+  fFreeList = kNullEntity;
+  fEntityCount = 0;
+
+  /* Reset the range of created cells to an empty range. */
+  for(size_t i = 0; i < 3; i++)
+  {
+    fMinCell[i] = std::numeric_limits<int32_t>::max();
+    fMaxCell[i] = std::numeric_limits<int32_t>::min();
+  }
+}
+
+/******************************************************************************/
+void SpatialGrid::rebuildTable(size_t size)
+{
+  /* Resize the table and clear it. */
+  fTable.assign(size, kNullEntity);
+  const size_t mask = fTable.size() - 1;
+
+  /* Reinsert all the cells. */
+  for(size_t index = 0; index < fCells.size(); index++)
+  {
+    const Cell & cell = fCells[index];
+    size_t i = hashCell(cell.fX, cell.fY, cell.fZ) & mask;
+    while(fTable[i] != kNullEntity)
+    {
+      i = (i + 1) & mask;
+    }
+    fTable[i] = int32_t(index);
+  }
+}
+
+/******************************************************************************/
+int32_t SpatialGrid::findOrCreateCell(int32_t x, int32_t y, int32_t z)
+{
+  /* Return the cell if it already exists. */
+  int32_t index = findCell(x, y, z);
+  if(index != kNullEntity)
+  {
+    return index;
+  }
+
+  /* Keep the load factor of the table at or below 50%. */
+  if((fCells.size() + 1) * 2 > fTable.size())
+  {
+    rebuildTable(std::max<size_t>(64, fTable.size() * 2));
+  }
+
+  /* Create the cell. */
+  index = int32_t(fCells.size());
+  fCells.push_back(Cell());
+  fCells.back().fX = x;
+  fCells.back().fY = y;
+  fCells.back().fZ = z;
+
+  /* Add it to the table. */
+  const size_t mask = fTable.size() - 1;
+  size_t i = hashCell(x, y, z) & mask;
+  while(fTable[i] != kNullEntity)
+  {
+    i = (i + 1) & mask;
+  }
+  fTable[i] = index;
+
+  /* Extend the range of created cells. */
+  const int32_t coords[3] = {x, y, z};
+  for(size_t axis = 0; axis < 3; axis++)
+  {
+    fMinCell[axis] = std::min(fMinCell[axis], coords[axis]);
+    fMaxCell[axis] = std::max(fMaxCell[axis], coords[axis]);
+  }
+
+  return index;
+}
+
+/******************************************************************************/
+void SpatialGrid::link(int32_t entity, int32_t cell,
+                       const Math::Vector4f & position)
+{
+  /* Append the entry to the cell. */
+  std::vector<Entry> & entries = fCells[cell].fEntries;
+  entries.push_back(Entry{position.x(), position.y(), position.z(), entity});
+
+  /* Record where the entity is stored. */
+  fEntities[entity].fCell = cell;
+  fEntities[entity].fSlot = int32_t(entries.size() - 1);
+}
+
+/******************************************************************************/
+void SpatialGrid::unlink(int32_t entity)
+{
+  /* Move the last entry of the cell into the entity's slot. */
+  Entity & record = fEntities[entity];
+  std::vector<Entry> & entries = fCells[record.fCell].fEntries;
+  entries[record.fSlot] = entries.back();
+  fEntities[entries[record.fSlot].fEntity].fSlot = record.fSlot;
+  entries.pop_back();
+}
+
+/******************************************************************************/
+int32_t SpatialGrid::insert(const Math::Vector4f & position, void * userData)
+{
+  /* Get an entity record, either recycled or new. */
+  int32_t entity = fFreeList;
+  if(entity != kNullEntity)
+  {
+    fFreeList = fEntities[entity].fSlot;
+  }
+  else
+  {
+    entity = int32_t(fEntities.size());
+    fEntities.push_back(Entity());
+  }
+
+  /* Add the entity to it's cell. */
+  fEntities[entity].fUserData = userData;
+  link(entity, findOrCreateCell(cellCoord(position.x()),
+    cellCoord(position.y()), cellCoord(position.z())), position);
+
+  ++fEntityCount;
+  return entity;
+}
+
+/******************************************************************************/
+void SpatialGrid::remove(int32_t entity)
+{
+  /* Remove the entity from it's cell. */
+  unlink(entity);
+
+  /* Put the record on the free list. */
+  fEntities[entity].fUserData = nullptr;
+  fEntities[entity].fCell = kNullEntity;
+  fEntities[entity].fSlot = fFreeList;
+  fFreeList = entity;
+  --fEntityCount;
+}
+
+/******************************************************************************/
+void SpatialGrid::move(int32_t entity, const Math::Vector4f & position)
+{
+  /* Find the cell that the entity moved to. */
+  int32_t x = cellCoord(position.x());
+  int32_t y = cellCoord(position.y());
+  int32_t z = cellCoord(position.z());
+
+  /* Update the entry in place if the entity stayed in the same cell. */
+  Entity & record = fEntities[entity];
+  Cell & cell = fCells[record.fCell];
+  if(cell.fX == x && cell.fY == y && cell.fZ == z)
+  {
+    Entry & entry = cell.fEntries[record.fSlot];
+    entry.fX = position.x();
+    entry.fY = position.y();
+    entry.fZ = position.z();
+    return;
+  }
+
+  /* Otherwise move the entity to the new cell. */
+  unlink(entity);
+  link(entity, findOrCreateCell(x, y, z), position);
+}
+
+/******************************************************************************/
+void SpatialGrid::compact()
+{
+  /* Reset the range of created cells, it's recalculated from the kept
+   * cells. */
+  for(size_t i = 0; i < 3; i++)
+  {
+    fMinCell[i] = std::numeric_limits<int32_t>::max();
+    fMaxCell[i] = std::numeric_limits<int32_t>::min();
+  }
+
+  /* Pack the cells with entities at the front and point their entities at
+   * the new indexes. */
+  size_t count = 0;
+  for(size_t index = 0; index < fCells.size(); index++)
+  {
+    if(fCells[index].fEntries.empty())
+    {
+      continue;
+    }
+
+    if(index != count)
+    {
+      fCells[count] = std::move(fCells[index]);
+    }
+
+    const Cell & cell = fCells[count];
+    for(const Entry & entry : cell.fEntries)
+    {
+      fEntities[entry.fEntity].fCell = int32_t(count);
+    }
+
+    const int32_t coords[3] = {cell.fX, cell.fY, cell.fZ};
+    for(size_t axis = 0; axis < 3; axis++)
+    {
+      fMinCell[axis] = std::min(fMinCell[axis], coords[axis]);
+      fMaxCell[axis] = std::max(fMaxCell[axis], coords[axis]);
+    }
+    count++;
+  }
+  fCells.resize(count);
+  fCells.shrink_to_fit();
+
+  /* Shrink the table to the smallest power of two that keeps the load
+   * factor at or below 50%. */
+  size_t size = 64;
+  while(size < fCells.size() * 2)
+  {
+    size *= 2;
+  }
+  if(fCells.empty())
+  {
+    fTable.clear();
+  }
+  else
+  {
+    rebuildTable(size);
+  }
+  fTable.shrink_to_fit();
+}
+
+/******************************************************************************/
+void SpatialGrid::queryRadius(const Math::Vector4f & position, float radius,
+                              std::vector<Neighbour> & neighbours) const
+{
+  /* Collect all the entities within the radius. */
+  neighbours.clear();
+  queryRadius(position, radius, [&neighbours](int32_t entity,
+                                              float distanceSq)
+  {
+    neighbours.push_back(Neighbour{entity, distanceSq});
+  });
+}
+
+/******************************************************************************/
+void SpatialGrid::queryNearest(const Math::Vector4f & position, size_t k,
+                               float maxRadius,
+                               std::vector<Neighbour> & neighbours) const
+{
+  /* Nothing to find in an empty grid. */
+  neighbours.clear();
+  if(k == 0 || fEntityCount == 0)
+  {
+    return;
+  }
+
+  /* Find the centre cell. */
+  const float px = position.x(), py = position.y(), pz = position.z();
+  const float maxRadiusSq = maxRadius * maxRadius;
+  const int32_t c[3] = {cellCoord(px), cellCoord(py), cellCoord(pz)};
+
+  /* Limit the search to the shells that can contain entities within the
+   * maximum radius and to the range of cells that exist. */
+  int64_t lastRing = 0;
+  for(size_t axis = 0; axis < 3; axis++)
+  {
+    lastRing = std::max<int64_t>(lastRing, std::max(
+      int64_t(c[axis]) - fMinCell[axis], int64_t(fMaxCell[axis]) - c[axis]));
+  }
+  if(maxRadius * fInvCellSize < float(lastRing))
+  {
+    lastRing = int64_t(maxRadius * fInvCellSize) + 1;
+  }
+
+  /* The neighbours are kept in a max heap so that the furthest of the k
+   * closest entities found so far is at the front. */
+  auto visitCell = [&](const Cell & cell)
+  {
+    for(const Entry & entry : cell.fEntries)
+    {
+      float dx = entry.fX - px;
+      float dy = entry.fY - py;
+      float dz = entry.fZ - pz;
+      Neighbour neighbour{entry.fEntity, dx * dx + dy * dy + dz * dz};
+      if(neighbour.fDistanceSq > maxRadiusSq)
+      {
+        continue;
+      }
+
+      if(neighbours.size() < k)
+      {
+        neighbours.push_back(neighbour);
+        std::push_heap(neighbours.begin(), neighbours.end());
+      }
+      else if(neighbour < neighbours.front())
+      {
+        std::pop_heap(neighbours.begin(), neighbours.end());
+        neighbours.back() = neighbour;
+        std::push_heap(neighbours.begin(), neighbours.end());
+      }
+    }
+  };
+
+  for(int64_t ring = 0; ring <= lastRing; ring++)
+  {
+    /* Visit the cells in the shell. */
+    forEachCellInRing(c[0], c[1], c[2], int32_t(ring), visitCell);
+
+    /* Every entity that was not visited yet is at least ring cells away, so
+     * the search is complete once the k closest are all closer than that. */
+    float reach = float(ring) * fCellSize;
+    if(neighbours.size() == k && neighbours.front().fDistanceSq <=
+       reach * reach)
+    {
+      break;
+    }
+  }
+
+  /* Order the neighbours from the closest to the furthest. */
+  std::sort_heap(neighbours.begin(), neighbours.end());
+}
+
+/******************************************************************************/
+void SpatialGrid::queryRadius(const std::vector<Math::Vector4f> & positions,
+                              float radius,
+                              std::vector<std::vector<Neighbour>> & results,
+                              TaskPool * pool) const
+{
+  /* Every query writes to it's own result vector. */
+  results.resize(positions.size());
+  auto runQueries = [&](size_t begin, size_t end)
+  {
+    for(size_t i = begin; i < end; i++)
+    {
+      queryRadius(positions[i], radius, results[i]);
+    }
+  };
+
+  /* Run the queries on the pool or on this thread. */
+  if(pool)
+  {
+    pool->parallelFor(positions.size(), kQueryGrainSize, runQueries);
+  }
+  else
+  {
+    runQueries(0, positions.size());
+  }
+}
+
+/******************************************************************************/
+void SpatialGrid::queryNearest(const std::vector<Math::Vector4f> & positions,
+                               size_t k, float maxRadius,
+                               std::vector<std::vector<Neighbour>> & results,
+                               TaskPool * pool) const
+{
+  /* Every query writes to it's own result vector. */
+  results.resize(positions.size());
+  auto runQueries = [&](size_t begin, size_t end)
+  {
+    for(size_t i = begin; i < end; i++)
+    {
+      queryNearest(positions[i], k, maxRadius, results[i]);
+    }
+  };
+
+  /* Run the queries on the pool or on this thread. */
+  if(pool)
+  {
+    pool->parallelFor(positions.size(), kQueryGrainSize, runQueries);
+  }
+  else
+  {
+    runQueries(0, positions.size());
+  }
+}
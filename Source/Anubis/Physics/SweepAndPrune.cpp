@@ -0,0 +1,168 @@
+#include "../../../Include/Anubis/Physics/SweepAndPrune.hpp"
+
+using namespace Anubis::Physics;
+
+/******************************************************************************/
+SweepAndPrune::SweepAndPrune(Axes sweepAxis) : fFreeList(kNullProxy)
+{
+  /* The other axes are the two that follow the sweep axis. */
+  fAxisS = static_cast<size_t>(sweepAxis);
+  fAxisA = (fAxisS + 1) % 3;
+  fAxisB = (fAxisS + 2) % 3;
+}
+
+/******************************************************************************/
+void SweepAndPrune::reserve(size_t count)
+{
+  fMinS.reserve(count);
+  fMaxS.reserve(count);
+  fMinA.reserve(count);
+  fMaxA.reserve(count);
+  fMinB.reserve(count);
+  fMaxB.reserve(count);
+  fSortedProxies.reserve(count);
+  fProxies.reserve(count);
+}
+
+/******************************************************************************/
+void SweepAndPrune::clear()
+{
+  /* Clear the sorted arrays. */
+  fMinS.clear();
+  fMaxS.clear();
+  fMinA.clear();
+  fMaxA.clear();
+  fMinB.clear();
+  fMaxB.clear();
+  fSortedProxies.clear();
+
+  /* Clear the proxy records. */
+  fProxies.clear();
+  fFreeList = kNullProxy;
+}
+
+/******************************************************************************/
+void SweepAndPrune::setBounds(size_t index, const AABB & box)
+{
+  /* Get the bounds of the box. */
+  const float * min = box.fMin.memory();
+  const float * max = box.fMax.memory();
+
+  /* Write the bounds into the sorted arrays. */
+  fMinS[index] = min[fAxisS];
+  fMaxS[index] = max[fAxisS];
+  fMinA[index] = min[fAxisA];
+  fMaxA[index] = max[fAxisA];
+  fMinB[index] = min[fAxisB];
+  fMaxB[index] = max[fAxisB];
+}
+
+/******************************************************************************/
+void SweepAndPrune::swapEntries(size_t i, size_t j)
+{
+  /* Swap the bounds. */
+  std::swap(fMinS[i], fMinS[j]);
+  std::swap(fMaxS[i], fMaxS[j]);
+  std::swap(fMinA[i], fMinA[j]);
+  std::swap(fMaxA[i], fMaxA[j]);
+  std::swap(fMinB[i], fMinB[j]);
+  std::swap(fMaxB[i], fMaxB[j]);
+
+  /* Swap the proxies and update their sorted indexes. */
+  std::swap(fSortedProxies[i], fSortedProxies[j]);
+  fProxies[fSortedProxies[i]].fSortedIndex = int32_t(i);
+  fProxies[fSortedProxies[j]].fSortedIndex = int32_t(j);
+}
+
+/******************************************************************************/
+void SweepAndPrune::restoreOrder(size_t index)
+{
+  /* Move the entry towards the front while it's predecessor is larger. */
+  while(index > 0 && fMinS[index - 1] > fMinS[index])
+  {
+    swapEntries(index - 1, index);
+    --index;
+  }
+
+  /* Move the entry towards the back while it's successor is smaller. */
+  while(index + 1 < fMinS.size() && fMinS[index + 1] < fMinS[index])
+  {
+    swapEntries(index, index + 1);
+    ++index;
+  }
+}
+
+/******************************************************************************/
+int32_t SweepAndPrune::insert(const AABB & box, void * userData)
+{
+  /* Get a proxy record, either recycled or new. */
+  int32_t proxy = fFreeList;
+  if(proxy != kNullProxy)
+  {
+    fFreeList = fProxies[proxy].fNext;
+  }
+  else
+  {
+    proxy = int32_t(fProxies.size());
+    fProxies.push_back(Proxy());
+  }
+
+  /* Append the entry to the sorted arrays. */
+  size_t index = fSortedProxies.size();
+  fMinS.push_back(0.0f);
+  fMaxS.push_back(0.0f);
+  fMinA.push_back(0.0f);
+  fMaxA.push_back(0.0f);
+  fMinB.push_back(0.0f);
+  fMaxB.push_back(0.0f);
+  fSortedProxies.push_back(proxy);
+  setBounds(index, box);
+
+  /* Initialise the proxy record. */
+  fProxies[proxy].fUserData = userData;
+  fProxies[proxy].fSortedIndex = int32_t(index);
+  fProxies[proxy].fNext = kNullProxy;
+
+  /* Move the entry into place. */
+  restoreOrder(index);
+  return proxy;
+}
+
+/******************************************************************************/
+void SweepAndPrune::remove(int32_t proxy)
+{
+  /* Shift all the following entries one place to the front. */
+  size_t index = size_t(fProxies[proxy].fSortedIndex);
+  fMinS.erase(fMinS.begin() + index);
+  fMaxS.erase(fMaxS.begin() + index);
+  fMinA.erase(fMinA.begin() + index);
+  fMaxA.erase(fMaxA.begin() + index);
+  fMinB.erase(fMinB.begin() + index);
+  fMaxB.erase(fMaxB.begin() + index);
+  fSortedProxies.erase(fSortedProxies.begin() + index);
+
+  /* Update the sorted indexes of the shifted entries. */
+  for(size_t i = index; i < fSortedProxies.size(); i++)
+  {
+    fProxies[fSortedProxies[i]].fSortedIndex = int32_t(i);
+  }
+
+  /* Put the proxy record on the free list. */
+  fProxies[proxy].fUserData = nullptr;
+  fProxies[proxy].fSortedIndex = kNullProxy;
+  fProxies[proxy].fNext = fFreeList;
+  fFreeList = proxy;
+}
+
+/******************************************************************************/
+bool SweepAndPrune::move(int32_t proxy, const AABB & box,
+                         const Math::Vector4f & displacement)
+{
+  ANUBIS_UNUSED_VAR(displacement);
+
+  /* Update the bounds and sort the entry back into place. */
+  size_t index = size_t(fProxies[proxy].fSortedIndex);
+  setBounds(index, box);
+  restoreOrder(index);
+  return true;
+}
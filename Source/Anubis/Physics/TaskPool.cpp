@@ -0,0 +1,159 @@
+#include "../../../Include/Anubis/Physics/TaskPool.hpp"
+
+using namespace Anubis::Physics;
+
+/******************************************************************************/
+TaskPool::TaskPool(size_t threadCount) : fFunc(nullptr), fCtx(nullptr),
+  fCount(0), fGrainSize(1), fNext(0), fBusyCount(0), fGeneration(0),
+  fIsExecuting(true), fException(nullptr)
+{
+  /* Use all the hardware threads if no count was specified. */
+  if(threadCount == 0)
+  {
+    threadCount = std::max<size_t>(1, std::thread::hardware_concurrency());
+  }
+
+  /* Create the worker threads. The calling thread is the last worker. */
+  fThreads.reserve(threadCount - 1);
+  for(size_t i = 1; i < threadCount; i++)
+  {
+    fThreads.push_back(std::thread(&TaskPool::threadEntry, this));
+  }
+}
+
+/******************************************************************************/
+TaskPool::~TaskPool()
+{
+  /* Tell the workers to stop. */
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fIsExecuting = false;
+  }
+  fWorkCV.notify_all();
+
+  /* Wait for all the workers to finish. */
+  for(std::thread & thread : fThreads)
+  {
+    if(thread.joinable())
+    {
+      thread.join();
+    }
+  }
+}
+
+/******************************************************************************/
+void TaskPool::threadEntry()
+{
+  /* The last job that this worker processed. */
+  uint64_t generation = 0;
+
+  while(true)
+  {
+    /* Wait for a new job or for the pool to shut down. */
+    {
+      std::unique_lock<std::mutex> lock(fMutex);
+      fWorkCV.wait(lock, [&]()
+      {
+        return !fIsExecuting || fGeneration != generation;
+      });
+
+      if(!fIsExecuting)
+      {
+        return;
+      }
+
+      generation = fGeneration;
+    }
+
+    /* Help out with the job. */
+    processChunks();
+
+    /* Let the calling thread know that this worker is done. */
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      --fBusyCount;
+    }
+    fDoneCV.notify_one();
+  }
+}
+
+/******************************************************************************/
+void TaskPool::processChunks()
+{
+  while(true)
+  {
+    /* Claim the next chunk. */
+    size_t begin = fNext.fetch_add(fGrainSize);
+    if(begin >= fCount)
+    {
+      return;
+    }
+
+    /* Process the chunk. */
+    try
+    {
+      fFunc(fCtx, begin, std::min(begin + fGrainSize, fCount));
+    }
+    catch(...)
+    {
+      /* Save the first exception and skip the remaining chunks. */
+      std::lock_guard<std::mutex> lock(fMutex);
+      if(!fException)
+      {
+        fException = std::current_exception();
+      }
+      fNext = fCount;
+    }
+  }
+}
+
+/******************************************************************************/
+void TaskPool::run(size_t count, size_t grainSize, ChunkFuncPtr func,
+                   void * ctx)
+{
+  /* Nothing to do for an empty range. */
+  if(count == 0)
+  {
+    return;
+  }
+
+  /* Run small jobs and jobs on a pool without workers on this thread. */
+  grainSize = std::max<size_t>(1, grainSize);
+  if(fThreads.empty() || count <= grainSize)
+  {
+    func(ctx, 0, count);
+    return;
+  }
+
+  /* Publish the job. */
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fFunc = func;
+    fCtx = ctx;
+    fCount = count;
+    fGrainSize = grainSize;
+    fNext = 0;
+    fBusyCount = fThreads.size();
+    fException = nullptr;
+    ++fGeneration;
+  }
+  fWorkCV.notify_all();
+
+  /* Process chunks on this thread too. */
+  processChunks();
+
+  /* Wait for the workers to finish their last chunks. */
+  std::exception_ptr exception;
+  {
+    std::unique_lock<std::mutex> lock(fMutex);
+    fDoneCV.wait(lock, [&]() { return fBusyCount == 0; });
+    exception = fException;
+    fException = nullptr;
+  }
+
+  /* Rethrow any exception on the calling thread. */
+  if(exception)
+  {
+    std::rethrow_exception(exception);
+  }
+}
@@ -164,7 +164,11 @@ void Context::updateNetwork(float dt, bool isFirstFrame) {}
 void Context::syncPhysics(bool isFirstFrame) {}
 
 /******************************************************************************/
-void Context::updatePhysics(float dt, bool isFirstFrame) {}
+void Context::updatePhysics(float dt, bool isFirstFrame)
+{
+  /* Advance the rigid bodies. */
+  fBodies.integrate(dt);
+}
 
 /******************************************************************************/
 void Context::syncAI(bool isFirstFrame) {}
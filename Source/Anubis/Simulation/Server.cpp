@@ -39,6 +39,8 @@ void Server::syncPhysics(bool isFirstFrame)
 void Server::updatePhysics(float dt, bool isFirstFrame)
 {
   ANUBIS_LOG_INFO("Update - Physics")
+
+  Context::updatePhysics(dt, isFirstFrame);
 }
 
 /******************************************************************************/
@@ -227,4 +227,19 @@ TEST(float, CompareNearZero)
                        0.000000001f));
 }
 
+/***************************************************************************//**
+ * Test that Float::sin and Float::cos match the C library closely, which
+ * covers the polynomials used when ANUBIS_DETERMINISTIC is defined.
+ ******************************************************************************/
+TEST(float, SinCos)
+{
+  for(float angle = -100.0f; angle <= 100.0f; angle += 0.0137f)
+  {
+    EXPECT_NEAR(std::sin(angle), Float::sin(angle), 2e-6f);
+    EXPECT_NEAR(std::cos(angle), Float::cos(angle), 2e-6f);
+  }
+  EXPECT_EQ(0.0f, Float::sin(0.0f));
+  EXPECT_EQ(1.0f, Float::cos(0.0f));
+}
+
 #endif /* ANUBIS_UNIT_TEST_FLOAT_TEST_HPP */
@@ -0,0 +1,759 @@
+#ifndef ANUBIS_UNIT_TEST_NETWORKING_TEST_HPP
+#define ANUBIS_UNIT_TEST_NETWORKING_TEST_HPP
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <unordered_map>
+#include "../../Include/Anubis/Networking.hpp"
+
+using namespace std;
+using namespace Anubis;
+
+/*##############################################################################
+ * PACKET POOL TESTS
+ *############################################################################*/
+TEST(PacketPool, Recycling)
+{
+  using namespace Anubis::Networking;
+
+  PacketPool pool(100, 4);
+  pool.reserve(4);
+  EXPECT_EQ(pool.capacity(), size_t(4));
+
+  /* A new packet is empty and has the pool's buffer size. */
+  PacketPool::Packet a = pool.acquire();
+  EXPECT_TRUE(a.unique());
+  EXPECT_EQ(a.size(), size_t(0));
+  EXPECT_EQ(a.capacity(), size_t(100));
+  memset(a.data(), 7, 100);
+  a.resize(10);
+
+  /* Copies share the buffer, the last one releases it. */
+  {
+    PacketPool::Packet b = a;
+    EXPECT_FALSE(a.unique());
+    EXPECT_EQ(b.data(), a.data());
+    EXPECT_EQ(b.size(), size_t(10));
+    EXPECT_EQ(pool.size(), size_t(1));
+  }
+  EXPECT_TRUE(a.unique());
+
+  /* Moving leaves the source empty. */
+  PacketPool::Packet c = std::move(a);
+  EXPECT_FALSE(a);
+  EXPECT_EQ(a.size(), size_t(0));
+  EXPECT_EQ(c.data()[9], uint8_t(7));
+
+  /* The released buffer is recycled first. */
+  const uint8_t * buffer = c.data();
+  c.reset();
+  EXPECT_EQ(pool.size(), size_t(0));
+  c = pool.acquire();
+  EXPECT_EQ(c.data(), buffer);
+
+  /* Running out of buffers grows the pool by a slab. */
+  std::vector<PacketPool::Packet> packets;
+  for(size_t i = 0; i < 5; i++)
+  {
+    packets.push_back(pool.acquire());
+  }
+  EXPECT_EQ(pool.size(), size_t(6));
+  EXPECT_EQ(pool.capacity(), size_t(8));
+
+  /* Queues move the handles in and out without keeping a reference. */
+  Common::CircularQueue<PacketPool::Packet, 4> queue;
+  EXPECT_TRUE(queue.push(std::move(packets[0])));
+  EXPECT_FALSE(packets[0]);
+  PacketPool::Packet popped;
+  EXPECT_TRUE(queue.pop(popped));
+  EXPECT_TRUE(popped.unique());
+  popped.reset();
+  packets.clear();
+  c.reset();
+  EXPECT_EQ(pool.size(), size_t(0));
+  EXPECT_EQ(pool.capacity(), size_t(8));
+}
+
+/*##############################################################################
+ * UDP SERVER TESTS
+ * ----------------
+ * The servers are bound to port 0 on the loopback interface, so the OS picks
+ * free ports.
+ *############################################################################*/
+TEST(UDPServer, Batching)
+{
+  using namespace Anubis::Networking;
+
+  const IPEndPoint localEP(0, "127.0.0.1", IPEndPoint::Preferences::IPv4Only);
+  UDPServer rx(localEP, 64, 8);
+  UDPServer tx(localEP, 64, 8);
+  const IPEndPoint rxEP = rx.getEP();
+  const IPEndPoint txEP = tx.getEP();
+  EXPECT_NE(rxEP.port(), 0);
+
+  /* Nothing is queued yet. */
+  EXPECT_EQ(rx.receive(false), size_t(0));
+
+  /* Queue more datagrams than a batch holds, the first batch is flushed by
+   * send() and the rest by flush(). Every datagram has a diffirent length,
+   * including an empty one. */
+  for(uint8_t i = 0; i < 12; i++)
+  {
+    std::vector<uint8_t> data(i, i);
+    tx.send(rxEP, data.data(), data.size());
+  }
+  EXPECT_EQ(tx.flush(), size_t(4));
+  EXPECT_EQ(tx.flush(), size_t(0));
+
+  /* Loopback keeps the order of the datagrams. */
+  size_t count = 0;
+  while(count < 12)
+  {
+    const size_t received = rx.receive();
+    ASSERT_GT(received, size_t(0));
+    const DatagramBatch & batch = rx.getReceived();
+    ASSERT_EQ(batch.size(), received);
+    for(size_t i = 0; i < received; i++, count++)
+    {
+      ASSERT_EQ(batch.length(i), count);
+      for(size_t j = 0; j < count; j++)
+      {
+        EXPECT_EQ(batch.data(i)[j], uint8_t(count));
+      }
+      EXPECT_EQ(batch.endPoint(i).port(), txEP.port());
+      EXPECT_EQ(batch.address(i), SocketAddress(txEP));
+    }
+  }
+  EXPECT_EQ(rx.receive(false), size_t(0));
+
+  /* Pooled packets are sent without copying them, and received packets are
+   * taken out of the batch without copying them either. */
+  PacketPool & pool = tx.getPool();
+  const size_t capacity = pool.capacity();
+  std::vector<PacketPool::Packet> taken;
+  for(uint8_t round = 0; round < 4; round++)
+  {
+    PacketPool::Packet packet = pool.acquire();
+    packet.data()[0] = round;
+    packet.resize(1);
+    tx.send(rxEP, packet);
+    tx.flush();
+
+    ASSERT_EQ(rx.receive(), size_t(1));
+    taken.push_back(rx.getReceived().take(0));
+    EXPECT_EQ(taken.back().size(), size_t(1));
+    EXPECT_EQ(taken.back().data()[0], round);
+  }
+  for(uint8_t round = 0; round < 4; round++)
+  {
+    EXPECT_EQ(taken[round].data()[0], round);
+  }
+  EXPECT_EQ(pool.capacity(), capacity);
+
+  /* A datagram longer than the maximum packet length is rejected. */
+  std::vector<uint8_t> tooLong(65, 0);
+  EXPECT_FALSE(tx.send(rxEP, tooLong.data(), tooLong.size()));
+  EXPECT_EQ(tx.flush(), size_t(0));
+}
+
+/******************************************************************************/
+TEST(UDPServer, UnreachablePeer)
+{
+  using namespace Anubis::Networking;
+
+  const IPEndPoint localEP(0, "127.0.0.1", IPEndPoint::Preferences::IPv4Only);
+  UDPServer rx(localEP, 64, 8);
+  UDPServer tx(localEP, 64, 8);
+  const IPEndPoint rxEP = rx.getEP();
+
+  /* Broadcasting isn't enabled on the socket, so the datagram in the middle
+   * of the batch fails to send and is dropped, the others still arrive. */
+  const IPEndPoint broadcastEP(rxEP.port(), "255.255.255.255",
+                               IPEndPoint::Preferences::IPv4Only);
+  for(uint8_t i = 0; i < 3; i++)
+  {
+    tx.send(i == 1 ? broadcastEP : rxEP, &i, 1);
+  }
+  EXPECT_EQ(tx.flush(), size_t(2));
+
+  size_t count = 0;
+  uint8_t expected[2] = {0, 2};
+  while(count < 2)
+  {
+    const size_t received = rx.receive();
+    ASSERT_GT(received, size_t(0));
+    const DatagramBatch & batch = rx.getReceived();
+    for(size_t i = 0; i < received; i++, count++)
+    {
+      ASSERT_LT(count, size_t(2));
+      ASSERT_EQ(batch.length(i), size_t(1));
+      EXPECT_EQ(batch.data(i)[0], expected[count]);
+    }
+  }
+  EXPECT_EQ(rx.receive(false), size_t(0));
+}
+
+/******************************************************************************/
+TEST(UDPServer, IOUring)
+{
+  using namespace Anubis::Networking;
+
+  /* The servers fall back to the system calls if io_uring isn't supported,
+   * the behaviour is the same either way. */
+  const IPEndPoint localEP(0, "127.0.0.1", IPEndPoint::Preferences::IPv4Only);
+  UDPServer rx(localEP, 64, 8, UDPServer::Backends::IOUring);
+  UDPServer tx(localEP, 64, 8, UDPServer::Backends::IOUring);
+  const UDPServer::Backends expected = IOUring::isSupported() ?
+                                       UDPServer::Backends::IOUring :
+                                       UDPServer::Backends::Syscalls;
+  EXPECT_EQ(rx.getBackend(), expected);
+  EXPECT_EQ(tx.getBackend(), expected);
+  const SocketAddress rxAddr(rx.getEP());
+  const SocketAddress txAddr(tx.getEP());
+  EXPECT_EQ(rx.receive(false), size_t(0));
+
+  /* Send more datagrams than the ring has receive buffers before receiving
+   * any of them, the receive is armed again once the buffers run out. */
+  const size_t kCount = 150;
+  for(size_t i = 0; i < kCount; i++)
+  {
+    std::vector<uint8_t> data(1 + i % 64, uint8_t(i));
+    EXPECT_TRUE(tx.send(rxAddr, data.data(), data.size()));
+  }
+  tx.flush();
+
+  size_t count = 0;
+  while(count < kCount)
+  {
+    const size_t received = rx.receive();
+    ASSERT_GT(received, size_t(0));
+    const DatagramBatch & batch = rx.getReceived();
+    for(size_t i = 0; i < received; i++, count++)
+    {
+      ASSERT_EQ(batch.length(i), 1 + count % 64);
+      EXPECT_EQ(batch.data(i)[0], uint8_t(count));
+      EXPECT_EQ(batch.data(i)[batch.length(i) - 1], uint8_t(count));
+      EXPECT_EQ(batch.address(i), txAddr);
+    }
+  }
+  EXPECT_EQ(rx.receive(false), size_t(0));
+
+  /* A blocking receive waits for datagrams sent by another thread. */
+  std::thread sender([&]()
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const uint8_t data[] = {42};
+    tx.send(rxAddr, data, 1);
+    tx.flush();
+  });
+  ASSERT_EQ(rx.receive(), size_t(1));
+  EXPECT_EQ(rx.getReceived().data(0)[0], uint8_t(42));
+  sender.join();
+}
+
+/******************************************************************************/
+TEST(UDPShardedServer, Steering)
+{
+  using namespace Anubis::Networking;
+
+  /* Run both backends, the servers must stop threads that are blocked in
+   * either. */
+  for(UDPServer::Backends backend : {UDPServer::Backends::Syscalls,
+                                     UDPServer::Backends::IOUring})
+  {
+    /* Echo every datagram and check that it arrived on the client's shard. */
+    const size_t kShards = 4;
+    std::atomic<size_t> received(0), misrouted(0);
+    std::vector<std::atomic<size_t>> perShard(kShards);
+    UDPShardedServer * serverPtr = nullptr;
+    UDPShardedServer server(
+      IPEndPoint(0, "127.0.0.1", IPEndPoint::Preferences::IPv4Only),
+      [&](size_t shard, UDPServer & udp)
+      {
+        const DatagramBatch & batch = udp.getReceived();
+        for(size_t i = 0; i < batch.size(); i++)
+        {
+          if(serverPtr->getShard(batch.address(i)) != shard)
+          {
+            ++misrouted;
+          }
+          ++perShard[shard];
+          ++received;
+          udp.send(batch.address(i), batch.data(i), batch.length(i));
+        }
+      },
+      kShards, 64, 8, backend);
+    serverPtr = &server;
+    ASSERT_EQ(server.getShardCount(), kShards);
+    const IPEndPoint serverEP = server.getEP();
+    EXPECT_NE(serverEP.port(), 0);
+
+    /* Every client sends a few datagrams and gets all of them back. */
+    const size_t kClients = 32, kPerClient = 4;
+    const IPEndPoint localEP(0, "127.0.0.1",
+                             IPEndPoint::Preferences::IPv4Only);
+    std::vector<std::unique_ptr<Socket>> clients;
+    for(size_t i = 0; i < kClients; i++)
+    {
+      clients.push_back(std::make_unique<Socket>(Socket::Types::UDP,
+                                                 Socket::Versions::IPv4));
+      clients.back()->bind(localEP);
+      for(size_t j = 0; j < kPerClient; j++)
+      {
+        const std::vector<uint8_t> data = {uint8_t(i), uint8_t(j)};
+        EXPECT_TRUE(clients.back()->sendTo(serverEP, data));
+      }
+    }
+    for(size_t i = 0; i < kClients; i++)
+    {
+      for(size_t j = 0; j < kPerClient; j++)
+      {
+        IPEndPoint peer(serverEP);
+        std::vector<uint8_t> echo;
+        EXPECT_TRUE(clients[i]->recvFrom(peer, echo, 64));
+        ASSERT_EQ(echo.size(), size_t(2));
+        EXPECT_EQ(echo[0], uint8_t(i));
+      }
+    }
+    EXPECT_EQ(received, kClients * kPerClient);
+    EXPECT_EQ(misrouted, size_t(0));
+
+    /* The clients are spread over more than one shard. */
+    size_t used = 0;
+    for(const std::atomic<size_t> & count : perShard)
+    {
+      used += count > 0 ? 1 : 0;
+    }
+    EXPECT_GT(used, size_t(1));
+  }
+}
+
+/*##############################################################################
+ * UDP CONNECTION TESTS
+ *############################################################################*/
+TEST(UDPConnection, Channels)
+{
+  using namespace Anubis::Networking;
+  typedef UDPConnection::ChannelTypes ChannelTypes;
+  typedef UDPConnection::Clock Clock;
+
+  const std::vector<ChannelTypes> channels = {
+    ChannelTypes::UnreliableSequenced, ChannelTypes::ReliableOrdered,
+    ChannelTypes::ReliableOrdered};
+  UDPConnection a(channels, 128), b(channels, 128);
+  PacketPool pool(128);
+  Clock::time_point now = Clock::now();
+
+  /* Write all of a connection's packets, the ones the filter rejects are
+   * lost. */
+  std::vector<PacketPool::Packet> inFlight;
+  auto write = [&](UDPConnection & from, const std::function<bool()> & keep)
+  {
+    inFlight.clear();
+    for(;;)
+    {
+      UDPPacket packet(pool.acquire());
+      if(!from.write(packet, now))
+      {
+        break;
+      }
+      if(keep())
+      {
+        inFlight.push_back(packet.getPacket());
+      }
+    }
+  };
+  std::vector<std::pair<size_t, uint8_t>> handed;
+  auto read = [&](UDPConnection & to)
+  {
+    for(const PacketPool::Packet & packet : inFlight)
+    {
+      EXPECT_TRUE(to.read(packet.data(), packet.size(),
+        [&](size_t channel, const uint8_t * data, size_t len)
+        {
+          ASSERT_EQ(len, size_t(1));
+          handed.push_back(std::make_pair(channel, data[0]));
+        }, now));
+    }
+  };
+  auto always = []() { return true; };
+  auto never = []() { return false; };
+
+  /* A lost reliable message only holds back it's own channel. */
+  const uint8_t r0 = 10, r1 = 11, other = 20, state = 30;
+  EXPECT_TRUE(a.queue(1, &r0, 1));
+  write(a, never);
+  EXPECT_TRUE(a.queue(1, &r1, 1));
+  EXPECT_TRUE(a.queue(2, &other, 1));
+  EXPECT_TRUE(a.queue(0, &state, 1));
+  write(a, always);
+  read(b);
+  ASSERT_EQ(handed.size(), size_t(2));
+  EXPECT_EQ(handed[0], std::make_pair(size_t(2), other));
+  EXPECT_EQ(handed[1], std::make_pair(size_t(0), state));
+  EXPECT_EQ(a.getUnacked(), size_t(3));
+
+  /* The acks release everything but the lost message, which is resent once
+   * it's overdue, then both messages of it's channel are handed out. */
+  now += std::chrono::milliseconds(5);
+  write(b, always);
+  read(a);
+  EXPECT_EQ(a.getUnacked(), size_t(1));
+  EXPECT_GT(a.getRTT().count(), 0);
+  write(a, always);
+  EXPECT_TRUE(inFlight.empty());
+  now += a.getResendTimeout();
+  write(a, always);
+  ASSERT_EQ(inFlight.size(), size_t(1));
+  handed.clear();
+  read(b);
+  ASSERT_EQ(handed.size(), size_t(2));
+  EXPECT_EQ(handed[0], std::make_pair(size_t(1), r0));
+  EXPECT_EQ(handed[1], std::make_pair(size_t(1), r1));
+  write(b, always);
+  read(a);
+  EXPECT_EQ(a.getUnacked(), size_t(0));
+
+  /* Over a link that loses every third packet and reorders the rest, the
+   * reliable messages all arrive in order and the unreliable ones never go
+   * backwards. */
+  handed.clear();
+  size_t drop = 0;
+  auto lossy = [&]() { return ++drop % 3 != 0; };
+  const size_t kMessages = 600;
+  size_t queued = 0;
+  for(size_t tick = 0; tick < 2000; tick++)
+  {
+    for(size_t i = 0; i < 4 && queued < kMessages; i++, queued++)
+    {
+      const uint8_t value = uint8_t(queued);
+      ASSERT_TRUE(a.queue(1 + queued % 2, &value, 1));
+      a.queue(0, &value, 1);
+    }
+    write(a, lossy);
+    std::reverse(inFlight.begin(), inFlight.end());
+    read(b);
+    write(b, lossy);
+    read(a);
+    now += std::chrono::milliseconds(5);
+    if(queued == kMessages && a.getUnacked() == 0)
+    {
+      break;
+    }
+  }
+  EXPECT_EQ(a.getUnacked(), size_t(0));
+
+  size_t reliable = 0;
+  uint8_t next[3] = {0, 0, 1};
+  bool hasState = false;
+  for(const std::pair<size_t, uint8_t> & msg : handed)
+  {
+    if(msg.first == 0)
+    {
+      EXPECT_TRUE(!hasState || int8_t(uint8_t(msg.second - next[0])) > 0);
+      next[0] = msg.second;
+      hasState = true;
+      continue;
+    }
+    EXPECT_EQ(msg.second, next[msg.first]);
+    next[msg.first] = uint8_t(next[msg.first] + 2);
+    reliable++;
+  }
+  EXPECT_EQ(reliable, kMessages);
+
+  /* Malformed packets are rejected whole. */
+  const uint8_t shortPkt[4] = {};
+  EXPECT_FALSE(b.read(shortPkt, sizeof(shortPkt), nullptr, now));
+  uint8_t badChannel[10 + 5 + 1] = {};
+  badChannel[10] = 7;
+  badChannel[13] = 1;
+  EXPECT_FALSE(b.read(badChannel, sizeof(badChannel), nullptr, now));
+}
+
+/***************************************************************************//**
+ * Test that oversized and truncated datagrams are rejected before any of
+ * their messages are used or buffered.
+ ******************************************************************************/
+TEST(UDPConnection, Malformed)
+{
+  using namespace Anubis::Networking;
+  typedef UDPConnection::ChannelTypes ChannelTypes;
+
+  UDPConnection conn({ChannelTypes::UnreliableSequenced,
+                      ChannelTypes::ReliableOrdered}, 64);
+  const size_t kPktHeaderLen = 10;
+  size_t handed = 0;
+  auto onMessage = [&](size_t, const uint8_t *, size_t) { handed++; };
+
+  /* A packet with sequence number 0 and a single reliable message with ID 1,
+   * which is buffered as it arrives before message 0. */
+  auto makePacket = [&](size_t msgLen)
+  {
+    std::vector<uint8_t> data(kPktHeaderLen + 5 + msgLen, 0xAB);
+    std::fill(data.begin(), data.begin() + kPktHeaderLen + 5, 0);
+    data[kPktHeaderLen] = 1;
+    data[kPktHeaderLen + 1] = 1;
+    data[kPktHeaderLen + 3] = uint8_t(msgLen);
+    data[kPktHeaderLen + 4] = uint8_t(msgLen >> 8);
+    return data;
+  };
+
+  /* Longer than the connection's packets. */
+  std::vector<uint8_t> data = makePacket(985);
+  EXPECT_FALSE(conn.read(data.data(), data.size(), onMessage));
+
+  /* A message that claims more bytes than the datagram holds. */
+  data = makePacket(20);
+  EXPECT_FALSE(conn.read(data.data(), data.size() - 1, onMessage));
+
+  /* A header shorter than the minimum. */
+  EXPECT_FALSE(conn.read(data.data(), kPktHeaderLen - 1, onMessage));
+
+  /* A packet that fits is buffered and the connection keeps working. */
+  data = makePacket(20);
+  EXPECT_TRUE(conn.read(data.data(), data.size(), onMessage));
+  EXPECT_EQ(handed, size_t(0));
+  const uint8_t value = 1;
+  EXPECT_TRUE(conn.queue(1, &value, 1));
+}
+
+/*##############################################################################
+ * SOCKET ADDRESS TESTS
+ *############################################################################*/
+TEST(SocketAddress, Hashing)
+{
+  using namespace Anubis::Networking;
+
+  const IPEndPoint localEP(0, "127.0.0.1", IPEndPoint::Preferences::IPv4Only);
+  Socket rx(Socket::Types::UDP, Socket::Versions::IPv4);
+  rx.bind(localEP);
+  const SocketAddress rxAddr(rx.getEP());
+  EXPECT_TRUE(rxAddr.isIPv4());
+  EXPECT_FALSE(rxAddr.isIPv6());
+  EXPECT_EQ(rxAddr.port(), rx.getEP().port());
+  EXPECT_TRUE(SocketAddress().empty());
+
+  /* The clients are found by the address their datagrams come from. */
+  std::vector<std::unique_ptr<Socket>> clients;
+  std::unordered_map<SocketAddress, size_t> index;
+  for(size_t i = 0; i < 4; i++)
+  {
+    clients.push_back(std::make_unique<Socket>(Socket::Types::UDP,
+                                               Socket::Versions::IPv4));
+    clients.back()->bind(localEP);
+    index[SocketAddress(clients.back()->getEP())] = i;
+  }
+  EXPECT_EQ(index.size(), size_t(4));
+
+  for(size_t i = 4; i-- > 0;)
+  {
+    const uint8_t id = uint8_t(i);
+    EXPECT_TRUE(clients[i]->sendTo(rxAddr, &id, 1));
+  }
+  for(size_t i = 0; i < 4; i++)
+  {
+    SocketAddress peer;
+    uint8_t id = 0xFF;
+    size_t len = 0;
+    const MutableBuffer buffer(&id, 1);
+    ASSERT_TRUE(rx.recvFrom(peer, &buffer, 1, len));
+    auto it = index.find(peer);
+    ASSERT_NE(it, index.end());
+    EXPECT_EQ(it->second, size_t(id));
+    EXPECT_EQ(peer.hash(), SocketAddress(clients[id]->getEP()).hash());
+  }
+
+  /* The address converts back to an equal end point. */
+  const IPEndPoint ep = rxAddr.toEndPoint();
+  EXPECT_EQ(ep.port(), rxAddr.port());
+  EXPECT_EQ(SocketAddress(ep), rxAddr);
+  EXPECT_NE(SocketAddress(clients[0]->getEP()), rxAddr);
+}
+
+/*##############################################################################
+ * SOCKET TESTS
+ *############################################################################*/
+TEST(Socket, ScatterGather)
+{
+  using namespace Anubis::Networking;
+
+  const IPEndPoint localEP(0, "127.0.0.1", IPEndPoint::Preferences::IPv4Only);
+  const uint8_t header[4] = {1, 2, 3, 4};
+  std::vector<uint8_t> payload(1000);
+  for(size_t i = 0; i < payload.size(); i++)
+  {
+    payload[i] = uint8_t(i * 7);
+  }
+
+  /* A datagram is gathered from a header and a payload, and scattered back
+   * into two buffers. */
+  Socket rx(Socket::Types::UDP, Socket::Versions::IPv4);
+  Socket tx(Socket::Types::UDP, Socket::Versions::IPv4);
+  rx.bind(localEP);
+  tx.bind(localEP);
+  const ConstBuffer parts[] = {ConstBuffer(header, 4), ConstBuffer(payload)};
+  EXPECT_TRUE(tx.sendTo(rx.getEP(), parts, 2));
+
+  uint8_t rxHeader[4] = {};
+  std::vector<uint8_t> rxPayload(2000);
+  const MutableBuffer rxParts[] = {MutableBuffer(rxHeader, 4),
+                                   MutableBuffer(rxPayload)};
+  IPEndPoint peer(localEP);
+  size_t len = 0;
+  EXPECT_TRUE(rx.recvFrom(peer, rxParts, 2, len));
+  EXPECT_EQ(len, size_t(1004));
+  EXPECT_EQ(peer.port(), tx.getEP().port());
+  EXPECT_EQ(memcmp(rxHeader, header, 4), 0);
+  EXPECT_EQ(memcmp(rxPayload.data(), payload.data(), payload.size()), 0);
+
+  /* A stream is gathered from more buffers than fit in one system call. */
+  Socket server(Socket::Types::TCP, Socket::Versions::IPv4);
+  server.bind(localEP);
+  const IPEndPoint serverEP = server.getEP();
+  std::unique_ptr<Socket> accepted;
+  std::thread acceptor([&]() { accepted = server.listen(1); });
+
+  /* The server may not be listening yet. */
+  std::unique_ptr<Socket> client;
+  for(size_t attempt = 0; attempt < 100 && !client; attempt++)
+  {
+    client = std::make_unique<Socket>(Socket::Types::TCP,
+                                      Socket::Versions::IPv4);
+    if(!client->connect(serverEP))
+    {
+      client.reset();
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  acceptor.join();
+  ASSERT_TRUE(client && accepted);
+
+  std::vector<ConstBuffer> chunks;
+  for(size_t i = 0; i < 3 * Socket::kMaxBuffers; i++)
+  {
+    chunks.push_back(i % 2 ? ConstBuffer(payload) : ConstBuffer(header, 4));
+  }
+  chunks.push_back(ConstBuffer(header, 0));
+  EXPECT_TRUE(client->send(chunks.data(), chunks.size()));
+
+  /* The stream is read back as one header followed by everything else. */
+  const size_t total = 3 * Socket::kMaxBuffers / 2 * 1004;
+  std::vector<uint8_t> rest(total - 4);
+  const MutableBuffer streamParts[] = {MutableBuffer(rxHeader, 4),
+                                       MutableBuffer(rest)};
+  memset(rxHeader, 0, 4);
+  EXPECT_TRUE(accepted->recv(streamParts, 2));
+  EXPECT_EQ(memcmp(rxHeader, header, 4), 0);
+  EXPECT_EQ(memcmp(rest.data(), payload.data(), payload.size()), 0);
+  EXPECT_EQ(memcmp(rest.data() + 1000 + 4, payload.data(), payload.size()),
+            0);
+  EXPECT_EQ(memcmp(rest.data() + total - 4 - 1000, payload.data(),
+                   payload.size()), 0);
+
+  /* The stream ends when the peer shuts down. */
+  client->shutdown();
+  EXPECT_FALSE(accepted->recv(rxHeader, 4));
+}
+
+/*##############################################################################
+ * TCP SERVER TESTS
+ *############################################################################*/
+TEST(TCPServer, EventLoop)
+{
+  using namespace Anubis::Networking;
+
+  /* Echo messages with a one byte length prefix, partial messages are left
+   * unconsumed. */
+  std::atomic<size_t> connects(0), disconnects(0);
+  std::mutex idsMutex;
+  std::vector<TCPServer::ConnectionID> ids;
+  TCPServer * serverPtr = nullptr;
+  TCPServer server(
+    IPEndPoint(0, "127.0.0.1", IPEndPoint::Preferences::IPv4Only),
+    [&](TCPServer::ConnectionID id, const SocketAddress & peer)
+    {
+      EXPECT_TRUE(peer.isIPv4());
+      std::lock_guard<std::mutex> lock(idsMutex);
+      ids.push_back(id);
+      ++connects;
+    },
+    [&](TCPServer::ConnectionID id, const uint8_t * data, size_t len)
+    {
+      size_t consumed = 0;
+      while(len - consumed > 0 && len - consumed >= size_t(1 + data[consumed]))
+      {
+        const size_t msgLen = 1 + data[consumed];
+        EXPECT_TRUE(serverPtr->send(id, data + consumed, msgLen));
+        consumed += msgLen;
+      }
+      return consumed;
+    },
+    [&](TCPServer::ConnectionID) { ++disconnects; },
+    2, 64 * 1024);
+  serverPtr = &server;
+  const IPEndPoint serverEP = server.getEP();
+  EXPECT_NE(serverEP.port(), 0);
+
+  auto waitFor = [](const std::function<bool()> & condition)
+  {
+    for(size_t i = 0; i < 500 && !condition(); i++)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return condition();
+  };
+
+  /* Messages that are split over several writes are echoed whole. */
+  const size_t kClients = 20;
+  std::vector<std::unique_ptr<Socket>> clients;
+  for(size_t i = 0; i < kClients; i++)
+  {
+    clients.push_back(std::make_unique<Socket>(Socket::Types::TCP,
+                                               Socket::Versions::IPv4));
+    ASSERT_TRUE(clients.back()->connect(serverEP));
+  }
+  for(size_t i = 0; i < kClients; i++)
+  {
+    const uint8_t msg[] = {3, uint8_t(i), 1, 2, 1, uint8_t(i + 100)};
+    EXPECT_TRUE(clients[i]->send(msg, 2));
+    EXPECT_TRUE(clients[i]->send(msg + 2, 4));
+  }
+  for(size_t i = 0; i < kClients; i++)
+  {
+    uint8_t echo[6] = {};
+    EXPECT_TRUE(clients[i]->recv(echo, 6));
+    EXPECT_EQ(echo[1], uint8_t(i));
+    EXPECT_EQ(echo[5], uint8_t(i + 100));
+  }
+  EXPECT_TRUE(waitFor([&]() { return connects == kClients; }));
+  EXPECT_EQ(server.getConnectionCount(), kClients);
+
+  /* A client that doesn't read is limited to the maximum buffered bytes. */
+  TCPServer::ConnectionID id;
+  {
+    std::lock_guard<std::mutex> lock(idsMutex);
+    id = ids.front();
+  }
+  std::vector<uint8_t> bulk(16 * 1024, 0);
+  size_t accepted = 0;
+  while(server.send(id, bulk.data(), bulk.size()) && accepted < 1000)
+  {
+    accepted++;
+  }
+  EXPECT_LT(accepted, size_t(1000));
+  EXPECT_LE(server.getBuffered(id), size_t(64 * 1024));
+  EXPECT_GT(server.getBuffered(id) + bulk.size(), size_t(64 * 1024));
+
+  /* Disconnecting closes the connection on the IO thread. */
+  server.disconnect(id);
+  EXPECT_TRUE(waitFor([&]() { return disconnects == 1; }));
+  EXPECT_FALSE(server.send(id, bulk.data(), 1));
+  EXPECT_EQ(server.getBuffered(id), size_t(0));
+
+  /* Clients that close are reported too. */
+  clients.clear();
+  EXPECT_TRUE(waitFor([&]() { return disconnects == kClients; }));
+  EXPECT_EQ(server.getConnectionCount(), size_t(0));
+}
+
+#endif /* ANUBIS_UNIT_TEST_NETWORKING_TEST_HPP */
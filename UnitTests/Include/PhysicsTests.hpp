@@ -2,6 +2,8 @@
 #define ANUBIS_UNIT_TEST_PHYSICS_TEST_HPP
 
 #include <gtest/gtest.h>
+#include <random>
+#include <set>
 #include "../../Include/Anubis/Physics.hpp"
 
 using namespace std;
@@ -11,4 +13,2351 @@ TEST(Physics, ComparePosBigNumbers)
 {
 }
 
+/*##############################################################################
+ * SCENE TESTS
+ * -----------
+ * The UUIDs of the scene objects are generated from a counter so that the
+ * tests do not depend on the host's UUID generator.
+ *############################################################################*/
+/***************************************************************************//**
+ * Create a sub object with a UUID derived from the specified number.
+ ******************************************************************************/
+inline std::shared_ptr<Common::SubObj> makeSceneObj(uint32_t id)
+{
+  uint8_t octets[Common::UUID::kOctetCount] = {};
+  memcpy(octets, &id, sizeof(id));
+
+  std::shared_ptr<Common::SubObj> obj = std::make_shared<Common::SubObj>();
+  obj->setID(Common::UUID(octets));
+  return obj;
+}
+
+/***************************************************************************//**
+ * Insert and remove nodes and make sure the subtrees are removed with them.
+ ******************************************************************************/
+TEST(Scene, InsertRemove)
+{
+  Physics::Scene scene;
+
+  /* Build a root with two children, each with two children. */
+  std::vector<std::shared_ptr<Common::SubObj>> objs;
+  for(uint32_t i = 1; i <= 7; i++)
+  {
+    objs.push_back(makeSceneObj(i));
+  }
+
+  EXPECT_TRUE(scene.insert(Common::kNullUUID, objs[0]));
+  EXPECT_TRUE(scene.insert(objs[0]->getID(), objs[1]));
+  EXPECT_TRUE(scene.insert(objs[0]->getID(), objs[2]));
+  EXPECT_TRUE(scene.insert(objs[1]->getID(), objs[3]));
+  EXPECT_TRUE(scene.insert(objs[1]->getID(), objs[4]));
+  EXPECT_TRUE(scene.insert(objs[2]->getID(), objs[5]));
+  EXPECT_TRUE(scene.insert(objs[2]->getID(), objs[6]));
+  EXPECT_EQ(7u, scene.getNodeCount());
+
+  /* Unknown parents and duplicate UUIDs are rejected. */
+  EXPECT_FALSE(scene.insert(makeSceneObj(100)->getID(), makeSceneObj(8)));
+  EXPECT_FALSE(scene.insert(objs[0]->getID(), objs[3]));
+
+  /* Removing a node removes its children. */
+  EXPECT_TRUE(scene.remove(objs[1]->getID()));
+  EXPECT_EQ(4u, scene.getNodeCount());
+  EXPECT_FALSE(scene.contains(objs[3]->getID()));
+  EXPECT_FALSE(scene.contains(objs[4]->getID()));
+  EXPECT_TRUE(scene.contains(objs[6]->getID()));
+  EXPECT_FALSE(scene.remove(objs[1]->getID()));
+
+  /* The released nodes are reused. */
+  EXPECT_TRUE(scene.insert(objs[6]->getID(), objs[1]));
+  EXPECT_EQ(5u, scene.getNodeCount());
+  EXPECT_TRUE(scene.contains(objs[1]->getID()));
+}
+
+/***************************************************************************//**
+ * Sync a scene twice from scenes of diffirent shapes and confirm that the
+ * destination mirrors the source each time.
+ ******************************************************************************/
+TEST(Scene, Sync)
+{
+  Physics::Scene src, dst;
+
+  /* Build a wide source scene. */
+  src.insert(Common::kNullUUID, makeSceneObj(1));
+  for(uint32_t i = 2; i < 1000; i++)
+  {
+    src.insert(makeSceneObj(1 + (i - 2) / 4)->getID(), makeSceneObj(i));
+  }
+
+  dst.sync(&src);
+  EXPECT_EQ(src.getNodeCount(), dst.getNodeCount());
+  for(uint32_t i = 1; i < 1000; i++)
+  {
+    EXPECT_TRUE(dst.contains(makeSceneObj(i)->getID()));
+  }
+
+  /* Shrink the source and sync again. */
+  src.remove(makeSceneObj(2)->getID());
+  dst.sync(&src);
+  EXPECT_EQ(src.getNodeCount(), dst.getNodeCount());
+  EXPECT_FALSE(dst.contains(makeSceneObj(2)->getID()));
+  EXPECT_FALSE(dst.contains(makeSceneObj(6)->getID()));
+  EXPECT_TRUE(dst.contains(makeSceneObj(3)->getID()));
+
+  /* An empty source empties the destination. */
+  src.clear();
+  dst.sync(&src);
+  EXPECT_EQ(0u, dst.getNodeCount());
+}
+
+/***************************************************************************//**
+ * Update the world transforms of a large scene serially and in parallel and
+ * confirm that both produce identical results.
+ ******************************************************************************/
+TEST(Scene, UpdateTransforms)
+{
+  Physics::Scene serial, parallel;
+  const uint32_t kNodeCount = 10000;
+
+  /* Build a scene with a few large subtrees and translate every node. */
+  serial.insert(Common::kNullUUID, makeSceneObj(1));
+  for(uint32_t i = 2; i <= kNodeCount; i++)
+  {
+    serial.insert(makeSceneObj(1 + (i - 2) / 3)->getID(), makeSceneObj(i));
+  }
+
+  for(uint32_t i = 1; i <= kNodeCount; i++)
+  {
+    serial.setTransform(makeSceneObj(i)->getID(), Math::Matrix4f::translate(
+      Math::Vector4f(float(i % 7), float(i % 5), float(i % 3), 1.0f)));
+  }
+
+  /* Sync copies the local transforms. */
+  parallel.sync(&serial);
+
+  /* Update the transforms. */
+  Physics::TaskPool pool(4);
+  serial.updateTransforms();
+  parallel.updateTransforms(&pool);
+
+  /* Node 5 is a child of node 2 which is a child of node 1. */
+  Math::Matrix4f world;
+  ASSERT_TRUE(serial.getWorldTransform(makeSceneObj(5)->getID(), world));
+  EXPECT_FLOAT_EQ(1.0f + 2.0f + 5.0f, world.memory()[12]);
+  EXPECT_FLOAT_EQ(1.0f + 2.0f + 0.0f, world.memory()[13]);
+
+  /* The parallel update must match the serial update exactly. */
+  for(uint32_t i = 1; i <= kNodeCount; i++)
+  {
+    Math::Matrix4f expected, actual;
+    ASSERT_TRUE(serial.getWorldTransform(makeSceneObj(i)->getID(), expected));
+    ASSERT_TRUE(parallel.getWorldTransform(makeSceneObj(i)->getID(), actual));
+    EXPECT_EQ(0, memcmp(expected.memory(), actual.memory(),
+                        sizeof(float) * Math::Matrix4f::kComponentCount));
+  }
+}
+
+/***************************************************************************//**
+ * Write a scene to a snapshot, load it back from memory and from a mapped file
+ * and confirm that the hierarchy, transforms, bounds and component UUIDs
+ * survive. Damaged snapshots must be rejected.
+ ******************************************************************************/
+TEST(Scene, Snapshot)
+{
+  const uint32_t kNodeCount = 2000;
+  Physics::Scene scene;
+  std::vector<std::shared_ptr<Common::SubObj>> objs;
+  for(uint32_t i = 1; i <= kNodeCount; i++)
+  {
+    objs.push_back(makeSceneObj(i));
+    objs.back()->setCompID(makeSceneObj(i + kNodeCount)->getID());
+  }
+
+  /* A node without data, a deep chain and fans off the chain. */
+  scene.insert(Common::kNullUUID, objs[0]);
+  scene.insert(objs[0]->getID(), nullptr);
+  for(uint32_t i = 1; i < kNodeCount; i++)
+  {
+    scene.insert(objs[i < 100 ? i - 1 : i % 100]->getID(), objs[i]);
+    scene.setTransform(objs[i]->getID(), Math::Matrix4f::translate(
+      Math::Vector4f(float(i % 7), float(i % 5), float(i % 3), 1.0f)));
+    scene.setBounds(objs[i]->getID(), Physics::AABB(
+      Math::Vector4f(-float(i), -1.0f, -1.0f, 1.0f),
+      Math::Vector4f(float(i), 1.0f, 1.0f, 1.0f)));
+  }
+  scene.updateTransforms();
+
+  std::vector<uint8_t> buffer;
+  Physics::SceneSnapshot::write(scene, buffer);
+  const std::string path = (boost::filesystem::temp_directory_path() /
+    boost::filesystem::unique_path("%%%%-%%%%.anss")).string();
+  ASSERT_TRUE(Physics::SceneSnapshot::write(scene, path));
+
+  /* The root is the first node and a parent always precedes it's children. */
+  Physics::SceneSnapshot fromMemory, fromFile;
+  ASSERT_TRUE(fromMemory.open(buffer.data(), buffer.size()));
+  ASSERT_TRUE(fromFile.open(path));
+  ASSERT_EQ(kNodeCount + 1, fromFile.getNodeCount());
+  EXPECT_EQ(objs[0]->getID(), fromFile.id(0));
+  EXPECT_EQ(Physics::SceneSnapshot::kNoParent, fromFile.parent(0));
+  EXPECT_EQ(Common::kNullUUID, fromFile.id(1));
+  EXPECT_EQ(0u, fromFile.parent(1));
+
+  /* The loaded scenes match the original without updating the transforms,
+   * with the data created by a factory or as one block. */
+  std::map<Common::UUID, Common::UUID> compIDs;
+  Physics::Scene loaded, blockLoaded;
+  ASSERT_TRUE(fromFile.load(loaded, [&](const Common::UUID & id,
+                                        const Common::UUID & compID)
+  {
+    compIDs[id] = compID;
+    return std::make_shared<Common::SubObj>(id, compID);
+  }));
+  ASSERT_TRUE(fromMemory.load(blockLoaded));
+  EXPECT_EQ(scene.getNodeCount(), loaded.getNodeCount());
+  EXPECT_EQ(scene.getNodeCount(), blockLoaded.getNodeCount());
+  for(uint32_t i = 0; i < kNodeCount; i++)
+  {
+    const Common::UUID & id = objs[i]->getID();
+    EXPECT_EQ(objs[i]->getCompID(), compIDs[id]);
+    Math::Matrix4f expected, actual, blockActual;
+    Physics::AABB bounds;
+    ASSERT_TRUE(scene.getWorldTransform(id, expected));
+    ASSERT_TRUE(loaded.getWorldTransform(id, actual));
+    ASSERT_TRUE(blockLoaded.getWorldTransform(id, blockActual));
+    EXPECT_EQ(0, memcmp(expected.memory(), actual.memory(),
+                        sizeof(float) * Math::Matrix4f::kComponentCount));
+    EXPECT_EQ(0, memcmp(expected.memory(), blockActual.memory(),
+                        sizeof(float) * Math::Matrix4f::kComponentCount));
+    ASSERT_TRUE(loaded.getBounds(id, bounds));
+    EXPECT_FLOAT_EQ(i == 0 ? 0.0f : float(i), bounds.fMax.x());
+  }
+
+  /* The hierarchy is intact, removing the end of the chain removes it's
+   * fan. */
+  EXPECT_TRUE(blockLoaded.remove(objs[99]->getID()));
+  EXPECT_FALSE(blockLoaded.contains(objs[199]->getID()));
+  EXPECT_TRUE(blockLoaded.contains(objs[198]->getID()));
+  loaded.updateTransforms();
+
+  /* A snapshot of the loaded scene is identical to the original. */
+  std::vector<uint8_t> rewritten;
+  Physics::SceneSnapshot::write(loaded, rewritten);
+  EXPECT_EQ(buffer, rewritten);
+
+  /* Damaged snapshots are rejected. */
+  Physics::SceneSnapshot damaged;
+  std::vector<uint8_t> copy = buffer;
+  EXPECT_FALSE(damaged.open(copy.data(), copy.size() / 2));
+  copy[0] ^= 1;
+  EXPECT_FALSE(damaged.open(copy.data(), copy.size()));
+  copy = buffer;
+  copy[4] += 1;
+  EXPECT_FALSE(damaged.open(copy.data(), copy.size()));
+  EXPECT_FALSE(damaged.load(loaded));
+  EXPECT_FALSE(damaged.open(path + ".missing"));
+  fromFile.close();
+  boost::filesystem::remove(path);
+}
+
+/*##############################################################################
+ * BROADPHASE TESTS
+ * ----------------
+ * The broadphase results are compared against brute force tests of the same
+ * boxes.
+ *############################################################################*/
+/***************************************************************************//**
+ * Create a random box inside a cube of the specified size.
+ ******************************************************************************/
+inline Physics::AABB makeRandomAABB(std::mt19937 & rng, float worldSize)
+{
+  std::uniform_real_distribution<float> pos(0.0f, worldSize);
+  std::uniform_real_distribution<float> size(0.1f, 2.0f);
+
+  Math::Vector4f min(pos(rng), pos(rng), pos(rng), 1.0f);
+  Math::Vector4f max(min.x() + size(rng), min.y() + size(rng),
+                     min.z() + size(rng), 1.0f);
+  return Physics::AABB(min, max);
+}
+
+/***************************************************************************//**
+ * Intersect a ray with a bounding box from the outside and the inside.
+ ******************************************************************************/
+TEST(BoundingBox, Intersect)
+{
+  Physics::BoundingBox box(1.0f, 2.0f, -1.0f, 1.0f, -1.0f, 1.0f);
+  std::vector<float> distances;
+
+  /* A ray from the outside enters and exits. */
+  box.intersect(Math::Ray(Math::Vector4f::makePosition(0.0f, 0.0f, 0.0f),
+    Math::Vector4f::makeDirection(1.0f, 0.0f, 0.0f)), distances);
+  ASSERT_EQ(2u, distances.size());
+  EXPECT_FLOAT_EQ(1.0f, distances[0]);
+  EXPECT_FLOAT_EQ(2.0f, distances[1]);
+
+  /* A ray from the inside only exits. */
+  distances.clear();
+  box.intersect(Math::Ray(Math::Vector4f::makePosition(1.5f, 0.0f, 0.0f),
+    Math::Vector4f::makeDirection(1.0f, 0.0f, 0.0f)), distances);
+  ASSERT_EQ(1u, distances.size());
+  EXPECT_FLOAT_EQ(0.5f, distances[0]);
+
+  /* A ray pointing away misses. */
+  distances.clear();
+  box.intersect(Math::Ray(Math::Vector4f::makePosition(0.0f, 0.0f, 0.0f),
+    Math::Vector4f::makeDirection(-1.0f, 0.0f, 0.0f)), distances);
+  EXPECT_TRUE(distances.empty());
+}
+
+/***************************************************************************//**
+ * Cast rays against a set of boxes and spheres and compare the hits against
+ * the virtual intersect() of the original volumes, before and after removing
+ * some of the volumes.
+ ******************************************************************************/
+TEST(BoundingVolumeSet, Intersect)
+{
+  const size_t kVolumeCount = 203;
+  const float kMaxT = 40.0f;
+  std::mt19937 rng(4321);
+  std::uniform_real_distribution<float> pos(0.0f, 30.0f);
+  std::uniform_real_distribution<float> dir(-1.0f, 1.0f);
+  std::uniform_real_distribution<float> radius(0.1f, 2.0f);
+
+  /* Create a mix of boxes and spheres. */
+  std::vector<std::unique_ptr<Physics::BoundingVolume>> volumes;
+  std::vector<Physics::BoundingVolumeSet::VolumeID> ids;
+  Physics::BoundingVolumeSet set;
+  for(size_t i = 0; i < kVolumeCount; i++)
+  {
+    if(i % 3 == 0)
+    {
+      volumes.emplace_back(new Physics::BoundingSphere(pos(rng), pos(rng),
+                                                       pos(rng), radius(rng)));
+    }
+    else
+    {
+      Physics::AABB box = makeRandomAABB(rng, 30.0f);
+      volumes.emplace_back(new Physics::BoundingBox(box.fMax.x(),
+        box.fMin.x(), box.fMin.y(), box.fMax.y(), box.fMin.z(),
+        box.fMax.z()));
+    }
+    ids.push_back(set.add(*volumes.back()));
+    EXPECT_EQ(volumes.back()->type(),
+              Physics::BoundingVolumeSet::typeOf(ids.back()));
+  }
+
+  /* Compare the hits of random rays against the virtual intersect(). */
+  auto compare = [&]()
+  {
+    for(size_t r = 0; r < 50; r++)
+    {
+      Math::Ray ray(Math::Vector4f::makePosition(pos(rng), pos(rng), pos(rng)),
+        Math::Vector4f::makeDirection(dir(rng), dir(rng), dir(rng)));
+
+      /* The first surface crossing of every volume within range. */
+      std::map<Physics::BoundingVolumeSet::VolumeID, float> expected;
+      std::vector<float> distances;
+      for(size_t i = 0; i < volumes.size(); i++)
+      {
+        distances.clear();
+        volumes[i]->intersect(ray, distances);
+        if(!distances.empty() && distances[0] <= kMaxT)
+        {
+          expected[ids[i]] = distances[0];
+        }
+
+        /* The single volume query matches the virtual call. */
+        float buffer[2];
+        ASSERT_EQ(distances.size(), set.intersect(ids[i], ray, buffer, 2));
+        for(size_t d = 0; d < distances.size(); d++)
+        {
+          EXPECT_NEAR(distances[d], buffer[d], 1e-3f);
+        }
+      }
+
+      /* All the hits fit into the buffer. */
+      Physics::BoundingVolumeSet::RayHit hits[kVolumeCount];
+      size_t count = set.intersect(ray, kMaxT, hits, kVolumeCount);
+      ASSERT_EQ(expected.size(), count);
+      for(size_t h = 0; h < count; h++)
+      {
+        ASSERT_EQ(1u, expected.count(hits[h].fVolume));
+        EXPECT_NEAR(expected[hits[h].fVolume], hits[h].fDistance, 1e-3f);
+      }
+
+      /* A small buffer returns the full count without overflowing. */
+      Physics::BoundingVolumeSet::RayHit small[3];
+      small[2].fVolume = Physics::BoundingVolumeSet::kNullVolume;
+      EXPECT_EQ(count, set.intersect(ray, kMaxT, small, 2));
+      EXPECT_EQ(Physics::BoundingVolumeSet::kNullVolume, small[2].fVolume);
+
+      /* The closest hit is the smallest expected distance. */
+      Physics::BoundingVolumeSet::RayHit closest;
+      ASSERT_EQ(!expected.empty(), set.intersectClosest(ray, kMaxT, closest));
+      for(const auto & entry : expected)
+      {
+        EXPECT_LE(closest.fDistance, entry.second + 1e-3f);
+      }
+    }
+  };
+  compare();
+
+  /* Remove every fourth volume, the other IDs must remain valid. */
+  for(size_t i = volumes.size(); i-- > 0;)
+  {
+    if(i % 4 == 1)
+    {
+      set.remove(ids[i]);
+      volumes.erase(volumes.begin() + i);
+      ids.erase(ids.begin() + i);
+    }
+  }
+  ASSERT_EQ(volumes.size(), set.size());
+  compare();
+}
+
+/***************************************************************************//**
+ * Test that adding a mesh to a set fails loudly instead of being ignored.
+ ******************************************************************************/
+TEST(BoundingVolumeSet, RejectsMesh)
+{
+  Physics::BoundingMesh mesh({Math::Vector4f::makePosition(0.0f, 0.0f, 0.0f),
+                              Math::Vector4f::makePosition(1.0f, 0.0f, 0.0f),
+                              Math::Vector4f::makePosition(0.0f, 0.0f, 1.0f)},
+                             {0, 1, 2});
+
+  /* The log's thread does not survive a fork, thus the add runs in a new
+   * process. */
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+  Physics::BoundingVolumeSet set;
+  EXPECT_EXIT(set.add(mesh), ::testing::ExitedWithCode(EXIT_FAILURE),
+              "not supported");
+  EXPECT_EQ(size_t(0), set.size());
+}
+
+/***************************************************************************//**
+ * Cast rays that lie in the face planes of a row of boxes and compare the
+ * batched hits, which test four boxes at a time with SSE, against the single
+ * volume queries.
+ ******************************************************************************/
+TEST(BoundingVolumeSet, FacePlaneRays)
+{
+  const size_t kBoxCount = 6;
+  Physics::BoundingVolumeSet set;
+  std::vector<Physics::BoundingVolumeSet::VolumeID> ids;
+  for(size_t k = 0; k < kBoxCount; k++)
+  {
+    ids.push_back(set.add(Physics::BoundingBox(float(k * 2), float(k * 2 + 1),
+                                               0.0f, 1.0f, 0.0f, 1.0f)));
+  }
+
+  for(size_t k = 0; k < kBoxCount; k++)
+  {
+    for(size_t axis = 0; axis < 3; axis++)
+    {
+      for(float side : {0.0f, 1.0f})
+      {
+        /* A ray in a face plane of box k, travelling along the next axis
+         * into the box. */
+        float origin[3] = {float(k * 2) + 0.5f, 0.5f, 0.5f};
+        float direction[3] = {0.0f, 0.0f, 0.0f};
+        origin[axis] = axis == 0 ? float(k * 2) + side : side;
+        origin[(axis + 1) % 3] = -1.0f;
+        direction[(axis + 1) % 3] = 1.0f;
+        Math::Ray ray(Math::Vector4f::makePosition(origin[0], origin[1],
+                                                   origin[2]),
+                      Math::Vector4f::makeDirection(direction[0],
+                                                    direction[1],
+                                                    direction[2]));
+
+        Physics::BoundingVolumeSet::RayHit hits[kBoxCount];
+        size_t count = set.intersect(ray, 100.0f, hits, kBoxCount);
+        std::set<Physics::BoundingVolumeSet::VolumeID> batch;
+        for(size_t i = 0; i < count; i++)
+        {
+          batch.insert(hits[i].fVolume);
+        }
+
+        /* The batch must agree with the single queries, and box k is hit. */
+        std::set<Physics::BoundingVolumeSet::VolumeID> single;
+        for(Physics::BoundingVolumeSet::VolumeID id : ids)
+        {
+          float distances[2];
+          if(set.intersect(id, ray, distances, 2) > 0)
+          {
+            single.insert(id);
+          }
+        }
+        EXPECT_EQ(single, batch) << "box " << k << " axis " << axis;
+        EXPECT_EQ(size_t(1), batch.count(ids[k]));
+      }
+    }
+  }
+}
+
+/*##############################################################################
+ * NARROWPHASE TESTS
+ * -----------------
+ * The contacts are checked against hand calculated results and the batch
+ * tests against the single pair tests.
+ *############################################################################*/
+/***************************************************************************//**
+ * Build the hierarchy over a bumpy terrain with some scattered triangles and
+ * compare the queries against testing every triangle, before and after a
+ * serialise round trip.
+ ******************************************************************************/
+TEST(BoundingMesh, Queries)
+{
+  const size_t kGridSize = 24;
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<float> height(-0.5f, 0.5f);
+  std::uniform_real_distribution<float> pos(-12.0f, 12.0f);
+  std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+
+  /* The terrain, two triangles per cell. */
+  std::vector<Math::Vector4f> vertices;
+  std::vector<uint32_t> indices;
+  for(size_t z = 0; z <= kGridSize; z++)
+  {
+    for(size_t x = 0; x <= kGridSize; x++)
+    {
+      vertices.push_back(Math::Vector4f::makePosition(float(x) - 12.0f,
+        height(rng), float(z) - 12.0f));
+    }
+  }
+  for(uint32_t z = 0; z < kGridSize; z++)
+  {
+    for(uint32_t x = 0; x < kGridSize; x++)
+    {
+      uint32_t i = z * (kGridSize + 1) + x;
+      indices.insert(indices.end(), {i, i + 1, i + uint32_t(kGridSize) + 1,
+        i + 1, i + uint32_t(kGridSize) + 2, i + uint32_t(kGridSize) + 1});
+    }
+  }
+
+  /* Small triangles floating above the terrain. */
+  for(size_t i = 0; i < 200; i++)
+  {
+    Math::Vector4f centre(pos(rng), 1.0f + height(rng) * 4.0f + 2.0f,
+                          pos(rng), 1.0f);
+    for(size_t k = 0; k < 3; k++)
+    {
+      indices.push_back(uint32_t(vertices.size()));
+      vertices.push_back(centre + Math::Vector4f(offset(rng), offset(rng),
+                                                 offset(rng), 0.0f));
+    }
+  }
+
+  Physics::BoundingMesh mesh(vertices, indices);
+  ASSERT_EQ(indices.size() / 3, mesh.triangleCount());
+  ASSERT_GT(mesh.nodeCount(), size_t(1));
+
+  std::vector<uint8_t> data;
+  mesh.serialise(data);
+  Physics::BoundingMesh loaded(data.data(), data.size());
+  ASSERT_EQ(mesh.nodeCount(), loaded.nodeCount());
+  ASSERT_EQ(mesh.indices(), loaded.indices());
+
+  for(const Physics::BoundingMesh * tested : {&mesh, &loaded})
+  {
+    for(size_t q = 0; q < 200; q++)
+    {
+      /* The closest hit of a ray. */
+      Math::Vector4f origin(pos(rng), 6.0f, pos(rng), 1.0f);
+      Math::Vector4f direction(offset(rng), -1.0f, offset(rng), 0.0f);
+      direction = direction * (1.0f / direction.length());
+      Math::Ray ray(origin, direction);
+      float expectedT = 100.0f;
+      bool expectedHit = false;
+      for(size_t i = 0; i < tested->triangleCount(); i++)
+      {
+        float t;
+        if(tested->triangle(i).intersect(origin, direction, t) &&
+           t <= expectedT)
+        {
+          expectedT = t;
+          expectedHit = true;
+        }
+      }
+
+      float t = 0.0f;
+      size_t triangle = 0;
+      ASSERT_EQ(expectedHit, tested->raycast(ray, 100.0f, t, triangle));
+      if(expectedHit)
+      {
+        EXPECT_FLOAT_EQ(expectedT, t);
+      }
+
+      /* The box and sphere overlaps. */
+      Math::Vector4f centre(pos(rng), height(rng) * 6.0f, pos(rng), 1.0f);
+      Math::Vector4f extent(0.3f, 0.3f, 0.3f, 0.0f);
+      Physics::AABB box(centre - extent, centre + extent);
+      bool expectedBox = false, expectedSphere = false;
+      for(size_t i = 0; i < tested->triangleCount(); i++)
+      {
+        expectedBox |= tested->triangle(i).overlaps(box);
+        expectedSphere |= tested->triangle(i).overlaps(centre, 0.4f);
+      }
+      EXPECT_EQ(expectedBox, tested->overlaps(box));
+      EXPECT_EQ(expectedSphere, tested->overlaps(centre, 0.4f));
+
+      /* The closest point. */
+      float expectedDistance = std::numeric_limits<float>::max();
+      for(size_t i = 0; i < tested->triangleCount(); i++)
+      {
+        Math::Vector4f d = tested->triangle(i).closestPoint(centre) - centre;
+        expectedDistance = std::min(expectedDistance, d.length());
+      }
+
+      Math::Vector4f point;
+      ASSERT_TRUE(tested->closestPoint(centre, 100.0f, point, triangle));
+      EXPECT_NEAR(expectedDistance, (point - centre).length(), 1e-4f);
+      EXPECT_FALSE(tested->closestPoint(centre, expectedDistance * 0.5f,
+                                        point, triangle));
+    }
+  }
+
+  /* A vertical ray crosses the terrain once, and maybe floating triangles. */
+  std::vector<float> distances;
+  mesh.intersect(Math::Ray(Math::Vector4f::makePosition(0.25f, 10.0f, 0.25f),
+    Math::Vector4f::makeDirection(0.0f, -1.0f, 0.0f)), distances);
+  ASSERT_FALSE(distances.empty());
+  EXPECT_TRUE(std::is_sorted(distances.begin(), distances.end()));
+  EXPECT_NEAR(10.0f, distances.back(), 0.5f);
+}
+
+/***************************************************************************//**
+ * Test that loading a truncated or corrupted serialised mesh fails loudly
+ * instead of reading out of bounds.
+ ******************************************************************************/
+TEST(BoundingMesh, CorruptData)
+{
+  /* A strip of quads, large enough for more than one node. */
+  std::vector<Math::Vector4f> vertices;
+  std::vector<uint32_t> indices;
+  for(uint32_t x = 0; x <= 64; x++)
+  {
+    vertices.push_back(Math::Vector4f::makePosition(float(x), 0.0f, 0.0f));
+    vertices.push_back(Math::Vector4f::makePosition(float(x), 0.0f, 1.0f));
+  }
+  for(uint32_t x = 0; x < 64; x++)
+  {
+    indices.insert(indices.end(), {x * 2, x * 2 + 2, x * 2 + 1,
+                                   x * 2 + 1, x * 2 + 2, x * 2 + 3});
+  }
+  Physics::BoundingMesh mesh(vertices, indices);
+  ASSERT_GT(mesh.nodeCount(), size_t(1));
+  std::vector<uint8_t> data;
+  mesh.serialise(data);
+
+  /* The log's thread does not survive a fork, thus the failing loads run in
+   * a new process. */
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+
+  /* A blob that ends inside the nodes. */
+  EXPECT_EXIT(Physics::BoundingMesh(data.data(), data.size() - 1),
+              ::testing::ExitedWithCode(EXIT_FAILURE), "truncated");
+
+  /* A header that claims more vertices than the blob holds. */
+  std::vector<uint8_t> corrupt = data;
+  uint32_t hugeCount = 0xFFFFFFFF;
+  memcpy(corrupt.data() + 2 * sizeof(uint32_t), &hugeCount, sizeof(uint32_t));
+  EXPECT_EXIT(Physics::BoundingMesh(corrupt.data(), corrupt.size()),
+              ::testing::ExitedWithCode(EXIT_FAILURE), "truncated");
+
+  /* The root's first internal child pointing back at the root. A node
+   * stores six arrays of four bounds before the children and the counts. */
+  corrupt = data;
+  size_t root = 5 * sizeof(uint32_t) + 6 * sizeof(float) +
+                vertices.size() * 3 * sizeof(float) +
+                indices.size() * sizeof(uint32_t);
+  uint8_t * childData = corrupt.data() + root + 24 * sizeof(float);
+  uint32_t children[4], counts[4];
+  memcpy(children, childData, sizeof(children));
+  memcpy(counts, childData + sizeof(children), sizeof(counts));
+  size_t k = 0;
+  while(k < 4 && counts[k] != 0)
+  {
+    k++;
+  }
+  ASSERT_LT(k, size_t(4));
+  children[k] = 0;
+  memcpy(childData, children, sizeof(children));
+  EXPECT_EXIT(Physics::BoundingMesh(corrupt.data(), corrupt.size()),
+              ::testing::ExitedWithCode(EXIT_FAILURE), "corrupt");
+}
+
+/***************************************************************************//**
+ * Test that rays lying in the faces of the hierarchy's boxes find the same
+ * hits as testing every triangle, with and without SSE.
+ ******************************************************************************/
+TEST(BoundingMesh, FacePlaneRays)
+{
+  /* Unit squares on an integer lattice, facing along all three axes. */
+  std::mt19937 rng(5);
+  std::uniform_int_distribution<int> cell(0, 7);
+  std::vector<Math::Vector4f> vertices;
+  std::vector<uint32_t> indices;
+  for(size_t i = 0; i < 150; i++)
+  {
+    size_t axis = i % 3;
+    float corner[3] = {float(cell(rng)), float(cell(rng)), float(cell(rng))};
+    for(size_t k = 0; k < 4; k++)
+    {
+      float p[3] = {corner[0], corner[1], corner[2]};
+      p[(axis + 1) % 3] += float(k & 1);
+      p[(axis + 2) % 3] += float(k >> 1);
+      vertices.push_back(Math::Vector4f::makePosition(p[0], p[1], p[2]));
+    }
+    uint32_t v = uint32_t(vertices.size()) - 4;
+    indices.insert(indices.end(), {v, v + 1, v + 2, v + 1, v + 3, v + 2});
+  }
+
+  Physics::BoundingMesh mesh(vertices, indices);
+  ASSERT_GT(mesh.nodeCount(), size_t(1));
+
+  /* Axis aligned rays along the lattice lines, in both directions. */
+  std::vector<Math::Ray> rays;
+  for(size_t axis = 0; axis < 3; axis++)
+  {
+    for(int u = 0; u <= 8; u++)
+    {
+      for(int w = 0; w <= 8; w++)
+      {
+        for(float sign : {1.0f, -1.0f})
+        {
+          float o[3], d[3] = {0.0f, 0.0f, 0.0f};
+          o[axis] = sign > 0.0f ? -1.0f : 10.0f;
+          o[(axis + 1) % 3] = float(u);
+          o[(axis + 2) % 3] = float(w);
+          d[axis] = sign;
+          rays.push_back(Math::Ray(
+            Math::Vector4f::makePosition(o[0], o[1], o[2]),
+            Math::Vector4f::makeDirection(d[0], d[1], d[2])));
+        }
+      }
+    }
+  }
+
+  const size_t kPacketSize = Physics::BoundingMesh::kPacketSize;
+  for(size_t first = 0; first < rays.size(); first += kPacketSize)
+  {
+    float maxT[kPacketSize];
+    uint32_t triangles[kPacketSize];
+    size_t count = std::min(kPacketSize, rays.size() - first);
+    std::fill(maxT, maxT + kPacketSize, 100.0f);
+    int mask = mesh.raycast(&rays[first], count, maxT, triangles);
+
+    for(size_t k = 0; k < count; k++)
+    {
+      const Math::Ray & ray = rays[first + k];
+      float expectedT = 100.0f;
+      bool expectedHit = false;
+      for(size_t i = 0; i < mesh.triangleCount(); i++)
+      {
+        float t;
+        if(mesh.triangle(i).intersect(ray.origin(), ray.direction(), t) &&
+           t <= expectedT)
+        {
+          expectedT = t;
+          expectedHit = true;
+        }
+      }
+
+      /* A single ray, and the same ray in a packet. */
+      float t = 0.0f;
+      size_t triangle = 0;
+      ASSERT_EQ(expectedHit, mesh.raycast(ray, 100.0f, t, triangle))
+        << "ray " << first + k;
+      ASSERT_EQ(expectedHit, ((mask >> k) & 1) != 0) << "ray " << first + k;
+      if(expectedHit)
+      {
+        EXPECT_EQ(expectedT, t);
+        EXPECT_EQ(expectedT, maxT[k]);
+      }
+    }
+  }
+}
+
+/***************************************************************************//**
+ * Compare a contact against the expected values.
+ ******************************************************************************/
+inline void expectContact(const Physics::Contact & contact,
+                          const Math::Vector4f & point,
+                          const Math::Vector4f & normal, float depth)
+{
+  EXPECT_NEAR(point.x(), contact.fPoint.x(), 1e-4f);
+  EXPECT_NEAR(point.y(), contact.fPoint.y(), 1e-4f);
+  EXPECT_NEAR(point.z(), contact.fPoint.z(), 1e-4f);
+  EXPECT_NEAR(normal.x(), contact.fNormal.x(), 1e-4f);
+  EXPECT_NEAR(normal.y(), contact.fNormal.y(), 1e-4f);
+  EXPECT_NEAR(normal.z(), contact.fNormal.z(), 1e-4f);
+  EXPECT_NEAR(depth, contact.fDepth, 1e-4f);
+}
+
+/***************************************************************************//**
+ * Collide the primitive pairs and check the contacts, including the flipped
+ * normals when the generic test handles the pair in the opposite order.
+ ******************************************************************************/
+TEST(Narrowphase, Primitives)
+{
+  Physics::Contact contact;
+
+  /* Two boxes overlapping the least along X. */
+  Physics::BoundingBox boxA(0.0f, 2.0f, 0.0f, 2.0f, 0.0f, 2.0f);
+  Physics::BoundingBox boxB(1.5f, 3.0f, 0.5f, 2.5f, -1.0f, 3.0f);
+  ASSERT_TRUE(Physics::Narrowphase::collide(boxA, boxB, contact));
+  expectContact(contact, Math::Vector4f(1.75f, 1.25f, 1.0f),
+                Math::Vector4f(1.0f, 0.0f, 0.0f), 0.5f);
+  EXPECT_FALSE(Physics::Narrowphase::collide(boxA,
+    Physics::BoundingBox(2.5f, 3.0f, 0.0f, 1.0f, 0.0f, 1.0f), contact));
+
+  /* A sphere touching the top of a box. */
+  Physics::BoundingSphere sphere(1.0f, 2.5f, 1.0f, 1.0f);
+  ASSERT_TRUE(Physics::Narrowphase::collide(boxA, sphere, contact));
+  expectContact(contact, Math::Vector4f(1.0f, 2.0f, 1.0f),
+                Math::Vector4f(0.0f, 1.0f, 0.0f), 0.5f);
+
+  /* A sphere with it's centre inside the box leaves through the nearest
+   * face. */
+  ASSERT_TRUE(Physics::Narrowphase::collide(boxA,
+    Physics::BoundingSphere(1.0f, 1.0f, 0.25f, 0.5f), contact));
+  expectContact(contact, Math::Vector4f(1.0f, 1.0f, 0.0f),
+                Math::Vector4f(0.0f, 0.0f, -1.0f), 0.75f);
+
+  /* Two spheres, the contact is in the middle of the overlap. */
+  Physics::BoundingSphere sphereA(0.0f, 0.0f, 0.0f, 1.0f);
+  Physics::BoundingSphere sphereB(0.0f, 0.0f, 1.5f, 1.0f);
+  ASSERT_TRUE(Physics::Narrowphase::collide(sphereA, sphereB, contact));
+  expectContact(contact, Math::Vector4f(0.0f, 0.0f, 0.75f),
+                Math::Vector4f(0.0f, 0.0f, 1.0f), 0.5f);
+  EXPECT_FALSE(Physics::Narrowphase::collide(sphereA,
+    Physics::BoundingSphere(0.0f, 3.0f, 0.0f, 1.0f), contact));
+
+  /* The generic test flips the normal of swapped pairs. */
+  Physics::Contact contacts[4];
+  ASSERT_EQ(1u, Physics::Narrowphase::collide(
+    static_cast<const Physics::BoundingVolume &>(sphere),
+    static_cast<const Physics::BoundingVolume &>(boxA), contacts, 4));
+  expectContact(contacts[0], Math::Vector4f(1.0f, 2.0f, 1.0f),
+                Math::Vector4f(0.0f, -1.0f, 0.0f), 0.5f);
+}
+
+/***************************************************************************//**
+ * Collide volumes with meshes.
+ ******************************************************************************/
+TEST(Narrowphase, Meshes)
+{
+  /* A 10 x 10 ground quad at y = 0 and a wall quad through it at x = 0. */
+  Physics::BoundingMesh ground({Math::Vector4f::makePosition(-5.0f, 0.0f, -5.0f),
+                                Math::Vector4f::makePosition(5.0f, 0.0f, -5.0f),
+                                Math::Vector4f::makePosition(5.0f, 0.0f, 5.0f),
+                                Math::Vector4f::makePosition(-5.0f, 0.0f, 5.0f)},
+                               {0, 2, 1, 0, 3, 2});
+  Physics::BoundingMesh wall({Math::Vector4f::makePosition(0.0f, -1.0f, -1.0f),
+                              Math::Vector4f::makePosition(0.0f, 1.0f, -1.0f),
+                              Math::Vector4f::makePosition(0.0f, 1.0f, 1.0f),
+                              Math::Vector4f::makePosition(0.0f, -1.0f, 1.0f)},
+                             {0, 1, 2, 0, 2, 3});
+  Physics::Contact contacts[8];
+
+  /* A sphere resting in the ground touches one triangle. */
+  ASSERT_EQ(1u, Physics::Narrowphase::collide(
+    Physics::BoundingSphere(3.0f, 0.5f, -2.0f, 1.0f), ground, contacts, 8));
+  expectContact(contacts[0], Math::Vector4f(3.0f, 0.0f, -2.0f),
+                Math::Vector4f(0.0f, -1.0f, 0.0f), 0.5f);
+
+  /* A box sunk into the ground is pushed up, the mesh is pushed down. */
+  ASSERT_EQ(1u, Physics::Narrowphase::collide(
+    Physics::BoundingBox(2.0f, 3.0f, -0.25f, 1.0f, -3.0f, -2.0f), ground,
+    contacts, 8));
+  EXPECT_NEAR(-1.0f, contacts[0].fNormal.y(), 1e-4f);
+  EXPECT_NEAR(0.25f, contacts[0].fDepth, 1e-4f);
+
+  /* Boxes and spheres above the ground do not touch it. */
+  EXPECT_EQ(0u, Physics::Narrowphase::collide(
+    Physics::BoundingBox(2.0f, 3.0f, 0.25f, 1.0f, 1.0f, 2.0f), ground,
+    contacts, 8));
+  EXPECT_EQ(0u, Physics::Narrowphase::collide(
+    Physics::BoundingSphere(2.0f, 1.5f, 1.0f, 1.0f), ground, contacts, 8));
+
+  /* The wall crosses both ground triangles, the capacity is respected. */
+  size_t count = Physics::Narrowphase::collide(wall, ground, contacts, 8);
+  EXPECT_EQ(4u, count);
+  for(size_t i = 0; i < count; i++)
+  {
+    EXPECT_NEAR(1.0f, contacts[i].fNormal.length(), 1e-4f);
+    EXPECT_NEAR(0.0f, contacts[i].fPoint.y(), 1e-4f);
+  }
+  EXPECT_EQ(1u, Physics::Narrowphase::collide(wall, ground, contacts, 1));
+
+  /* A wall moved away from the ground does not touch it. */
+  Physics::BoundingMesh raised({Math::Vector4f::makePosition(0.0f, 1.0f, -1.0f),
+                                Math::Vector4f::makePosition(0.0f, 3.0f, -1.0f),
+                                Math::Vector4f::makePosition(0.0f, 3.0f, 1.0f)},
+                               {0, 1, 2});
+  EXPECT_EQ(0u, Physics::Narrowphase::collide(raised, ground, contacts, 8));
+}
+
+/***************************************************************************//**
+ * Compare the batch tests against the single pair tests and check that the
+ * contacts separate the volumes.
+ ******************************************************************************/
+TEST(Narrowphase, Batches)
+{
+  const size_t kPairCount = 103;
+  std::mt19937 rng(99);
+  std::uniform_real_distribution<float> pos(0.0f, 4.0f);
+  std::uniform_real_distribution<float> radius(0.1f, 2.0f);
+
+  /* Create random boxes and spheres stored as structure of arrays. */
+  std::vector<float> box[2][6], sphere[2][4];
+  for(size_t side = 0; side < 2; side++)
+  {
+    for(size_t i = 0; i < kPairCount; i++)
+    {
+      Physics::AABB aabb = makeRandomAABB(rng, 4.0f);
+      for(size_t axis = 0; axis < 3; axis++)
+      {
+        box[side][axis].push_back(aabb.fMin.memory()[axis]);
+        box[side][axis + 3].push_back(aabb.fMax.memory()[axis]);
+        sphere[side][axis].push_back(pos(rng));
+      }
+      sphere[side][3].push_back(radius(rng));
+    }
+  }
+
+  Physics::Narrowphase::BoxArrays boxes[2];
+  Physics::Narrowphase::SphereArrays spheres[2];
+  for(size_t side = 0; side < 2; side++)
+  {
+    boxes[side] = {box[side][0].data(), box[side][1].data(),
+                   box[side][2].data(), box[side][3].data(),
+                   box[side][4].data(), box[side][5].data()};
+    spheres[side] = {sphere[side][0].data(), sphere[side][1].data(),
+                     sphere[side][2].data(), sphere[side][3].data()};
+  }
+
+  auto makeBox = [&](size_t side, size_t i)
+  {
+    return Physics::BoundingBox(box[side][0][i], box[side][3][i],
+      box[side][1][i], box[side][4][i], box[side][2][i], box[side][5][i]);
+  };
+  auto makeSphere = [&](size_t side, size_t i)
+  {
+    return Physics::BoundingSphere(sphere[side][0][i], sphere[side][1][i],
+                                   sphere[side][2][i], sphere[side][3][i]);
+  };
+
+  /* Check the batch results against the single pair results. */
+  uint32_t pairs[kPairCount];
+  Physics::Contact contacts[kPairCount];
+  auto check = [&](size_t hits, auto collidePair)
+  {
+    size_t expectedHits = 0;
+    for(size_t i = 0; i < kPairCount; i++)
+    {
+      Physics::Contact expected;
+      if(collidePair(i, expected))
+      {
+        ASSERT_LT(expectedHits, hits);
+        ASSERT_EQ(i, pairs[expectedHits]);
+        expectContact(contacts[expectedHits], expected.fPoint,
+                      expected.fNormal, expected.fDepth);
+        EXPECT_GE(expected.fDepth, 0.0f);
+        ++expectedHits;
+      }
+    }
+    EXPECT_EQ(expectedHits, hits);
+    EXPECT_GT(hits, 0u);
+  };
+
+  check(Physics::Narrowphase::collide(boxes[0], boxes[1], kPairCount, pairs,
+                                      contacts),
+        [&](size_t i, Physics::Contact & contact)
+  {
+    Physics::BoundingBox a = makeBox(0, i);
+    Physics::BoundingBox b = makeBox(1, i);
+    if(!Physics::Narrowphase::collide(a, b, contact))
+    {
+      return false;
+    }
+
+    /* Moving B by the contact separates the boxes. */
+    Physics::AABB moved = b.aabb();
+    Math::Vector4f push = contact.fNormal * (contact.fDepth + 1e-3f);
+    moved.fMin += push;
+    moved.fMax += push;
+    EXPECT_FALSE(a.aabb().overlaps(moved));
+    return true;
+  });
+
+  check(Physics::Narrowphase::collide(boxes[0], spheres[1], kPairCount,
+                                      pairs, contacts),
+        [&](size_t i, Physics::Contact & contact)
+  {
+    return Physics::Narrowphase::collide(makeBox(0, i), makeSphere(1, i),
+                                         contact);
+  });
+
+  check(Physics::Narrowphase::collide(spheres[0], spheres[1], kPairCount,
+                                      pairs, contacts),
+        [&](size_t i, Physics::Contact & contact)
+  {
+    Physics::BoundingSphere a = makeSphere(0, i);
+    Physics::BoundingSphere b = makeSphere(1, i);
+    if(!Physics::Narrowphase::collide(a, b, contact))
+    {
+      return false;
+    }
+
+    /* Moving B by the contact makes the spheres touch. */
+    Math::Vector4f moved = b.centre() + contact.fNormal * contact.fDepth;
+    EXPECT_NEAR(a.radius() + b.radius(), (moved - a.centre()).length(),
+                1e-3f);
+    return true;
+  });
+}
+
+/***************************************************************************//**
+ * Test that rays lying in a face plane of a box hit it on every axis and that
+ * boxes with NaN bounds are never hit.
+ ******************************************************************************/
+TEST(AABB, IntersectNaN)
+{
+  const float kNaN = std::numeric_limits<float>::quiet_NaN();
+  Physics::AABB box(Math::Vector4f::makePosition(0.0f, 0.0f, 0.0f),
+                    Math::Vector4f::makePosition(1.0f, 1.0f, 1.0f));
+  float tEntry, tExit;
+
+  for(size_t axis = 0; axis < 3; axis++)
+  {
+    for(float plane : {0.0f, 1.0f})
+    {
+      /* A ray in the min or max plane of the axis, travelling along the
+       * next axis into the box. */
+      float origin[3] = {0.5f, 0.5f, 0.5f};
+      float direction[3] = {0.0f, 0.0f, 0.0f};
+      origin[axis] = plane;
+      origin[(axis + 1) % 3] = -1.0f;
+      direction[(axis + 1) % 3] = 1.0f;
+      Math::Ray ray(Math::Vector4f::makePosition(origin[0], origin[1],
+                                                 origin[2]),
+                    Math::Vector4f::makeDirection(direction[0], direction[1],
+                                                  direction[2]));
+      Math::Vector4f invDir = Physics::AABB::inverseDirection(ray);
+      ASSERT_TRUE(box.intersect(ray.origin(), invDir, 10.0f, tEntry, tExit));
+      EXPECT_FLOAT_EQ(1.0f, tEntry);
+      EXPECT_FLOAT_EQ(2.0f, tExit);
+
+      /* The same ray misses a box with a NaN bound on any axis. */
+      for(size_t nanAxis = 0; nanAxis < 3; nanAxis++)
+      {
+        float low[3] = {0.0f, 0.0f, 0.0f}, high[3] = {1.0f, 1.0f, 1.0f};
+        low[nanAxis] = kNaN;
+        EXPECT_FALSE(Physics::AABB(
+          Math::Vector4f::makePosition(low[0], low[1], low[2]),
+          Math::Vector4f::makePosition(high[0], high[1], high[2])).intersect(
+            ray.origin(), invDir, 10.0f, tEntry, tExit));
+
+        low[nanAxis] = 0.0f;
+        high[nanAxis] = kNaN;
+        EXPECT_FALSE(Physics::AABB(
+          Math::Vector4f::makePosition(low[0], low[1], low[2]),
+          Math::Vector4f::makePosition(high[0], high[1], high[2])).intersect(
+            ray.origin(), invDir, 10.0f, tEntry, tExit));
+      }
+    }
+  }
+}
+
+/***************************************************************************//**
+ * Insert, move and remove proxies and compare the queries against brute force
+ * results after each step.
+ ******************************************************************************/
+TEST(AABBTree, Queries)
+{
+  const size_t kProxyCount = 1000;
+  std::mt19937 rng(1234);
+  Physics::AABBTree tree;
+
+  /* Insert the proxies. */
+  std::vector<int32_t> proxies;
+  for(size_t i = 0; i < kProxyCount; i++)
+  {
+    proxies.push_back(tree.insert(makeRandomAABB(rng, 50.0f),
+                                  reinterpret_cast<void*>(i)));
+  }
+  ASSERT_TRUE(tree.validate());
+  EXPECT_LT(tree.getHeight(), 32);
+
+  /* Move every proxy, half of them far enough to be reinserted. */
+  std::uniform_real_distribution<float> offset(-5.0f, 5.0f);
+  for(size_t i = 0; i < kProxyCount; i++)
+  {
+    Physics::AABB box = tree.getFatAABB(proxies[i]).fatten(-0.1f);
+    Math::Vector4f d = i % 2 ? Math::Vector4f(offset(rng), offset(rng),
+      offset(rng), 0.0f) : Math::Vector4f(0.01f, 0.0f, 0.0f, 0.0f);
+    tree.move(proxies[i], Physics::AABB(box.fMin + d, box.fMax + d), d);
+  }
+  ASSERT_TRUE(tree.validate());
+
+  /* Remove every third proxy. */
+  for(size_t i = 0; i < kProxyCount; i += 3)
+  {
+    tree.remove(proxies[i]);
+    proxies[i] = Physics::AABBTree::kNullNode;
+  }
+  ASSERT_TRUE(tree.validate());
+
+  /* Compare the box query against brute force. */
+  Physics::AABB query(Math::Vector4f(10.0f, 10.0f, 10.0f, 1.0f),
+                      Math::Vector4f(30.0f, 30.0f, 30.0f, 1.0f));
+  std::set<int32_t> expected, actual;
+  for(int32_t proxy : proxies)
+  {
+    if(proxy != Physics::AABBTree::kNullNode &&
+       tree.getFatAABB(proxy).overlaps(query))
+    {
+      expected.insert(proxy);
+    }
+  }
+  tree.queryAABB(query, [&](int32_t proxy)
+  {
+    actual.insert(proxy);
+    return true;
+  });
+  EXPECT_EQ(expected, actual);
+  EXPECT_FALSE(expected.empty());
+
+  /* Compare the pairs against brute force. */
+  std::set<std::pair<int32_t, int32_t>> expectedPairs, actualPairs;
+  for(size_t i = 0; i < kProxyCount; i++)
+  {
+    for(size_t j = i + 1; j < kProxyCount; j++)
+    {
+      if(proxies[i] != Physics::AABBTree::kNullNode &&
+         proxies[j] != Physics::AABBTree::kNullNode &&
+         tree.getFatAABB(proxies[i]).overlaps(tree.getFatAABB(proxies[j])))
+      {
+        expectedPairs.insert(std::make_pair(std::min(proxies[i], proxies[j]),
+                                            std::max(proxies[i], proxies[j])));
+      }
+    }
+  }
+  tree.queryPairs([&](int32_t a, int32_t b)
+  {
+    EXPECT_LT(a, b);
+    EXPECT_TRUE(actualPairs.insert(std::make_pair(a, b)).second);
+  });
+  EXPECT_EQ(expectedPairs, actualPairs);
+
+  /* Find the closest hit along a ray by clipping the ray. */
+  Math::Ray ray(Math::Vector4f::makePosition(-1.0f, 25.0f, 25.0f),
+                Math::Vector4f::makeDirection(1.0f, 0.01f, -0.02f));
+  Math::Vector4f invDir = Physics::AABB::inverseDirection(ray);
+  float expectedT = std::numeric_limits<float>::max(), tEntry, tExit;
+  for(int32_t proxy : proxies)
+  {
+    if(proxy != Physics::AABBTree::kNullNode &&
+       tree.getFatAABB(proxy).intersect(ray.origin(), invDir, expectedT,
+                                        tEntry, tExit))
+    {
+      expectedT = std::min(expectedT, std::max(tEntry, 0.0f));
+    }
+  }
+
+  float actualT = std::numeric_limits<float>::max();
+  tree.queryRay(ray, actualT, [&](int32_t proxy, float maxT)
+  {
+    tree.getFatAABB(proxy).intersect(ray.origin(), invDir, maxT, tEntry,
+                                     tExit);
+    actualT = std::min(actualT, std::max(tEntry, 0.0f));
+    return actualT;
+  });
+  EXPECT_FLOAT_EQ(expectedT, actualT);
+
+  /* Clearing the tree removes all the proxies. */
+  tree.clear();
+  EXPECT_EQ(0u, tree.size());
+  EXPECT_TRUE(tree.validate());
+}
+
+/***************************************************************************//**
+ * Run the same inserts, moves and removes on both broadphase implementations
+ * and compare the pairs and box queries against brute force.
+ ******************************************************************************/
+TEST(Broadphase, SweepAndPrune)
+{
+  const size_t kProxyCount = 500;
+  std::mt19937 rng(99);
+  std::unique_ptr<Physics::Broadphase> sap = Physics::Broadphase::create(
+    Physics::Broadphase::Types::SweepAndPrune);
+
+  /* Insert the boxes, keeping a copy for the brute force tests. */
+  std::vector<Physics::AABB> boxes;
+  std::vector<int32_t> proxies;
+  for(size_t i = 0; i < kProxyCount; i++)
+  {
+    boxes.push_back(makeRandomAABB(rng, 30.0f));
+    proxies.push_back(sap->insert(boxes.back(), reinterpret_cast<void*>(i)));
+  }
+
+  /* Move the boxes and remove some of them. */
+  std::uniform_real_distribution<float> offset(-3.0f, 3.0f);
+  for(size_t i = 0; i < kProxyCount; i++)
+  {
+    if(i % 5 == 0)
+    {
+      sap->remove(proxies[i]);
+      proxies[i] = Physics::Broadphase::kNullProxy;
+      continue;
+    }
+
+    Math::Vector4f d(offset(rng), offset(rng), offset(rng), 0.0f);
+    boxes[i] = Physics::AABB(boxes[i].fMin + d, boxes[i].fMax + d);
+    sap->move(proxies[i], boxes[i], d);
+  }
+  EXPECT_EQ(kProxyCount - kProxyCount / 5, sap->size());
+
+  /* Compare the pairs against brute force. */
+  std::set<Physics::Broadphase::ProxyPair> expected;
+  for(size_t i = 0; i < kProxyCount; i++)
+  {
+    for(size_t j = i + 1; j < kProxyCount; j++)
+    {
+      if(proxies[i] != Physics::Broadphase::kNullProxy &&
+         proxies[j] != Physics::Broadphase::kNullProxy &&
+         boxes[i].overlaps(boxes[j]))
+      {
+        expected.insert(std::make_pair(std::min(proxies[i], proxies[j]),
+                                       std::max(proxies[i], proxies[j])));
+      }
+    }
+  }
+
+  std::vector<Physics::Broadphase::ProxyPair> pairs;
+  sap->queryPairs(pairs);
+  EXPECT_EQ(expected.size(), pairs.size());
+  EXPECT_EQ(expected, std::set<Physics::Broadphase::ProxyPair>(pairs.begin(),
+                                                               pairs.end()));
+
+  /* Compare a box query against brute force. */
+  Physics::AABB query(Math::Vector4f(5.0f, 5.0f, 5.0f, 1.0f),
+                      Math::Vector4f(15.0f, 15.0f, 15.0f, 1.0f));
+  std::set<int32_t> expectedProxies;
+  for(size_t i = 0; i < kProxyCount; i++)
+  {
+    if(proxies[i] != Physics::Broadphase::kNullProxy &&
+       boxes[i].overlaps(query))
+    {
+      expectedProxies.insert(proxies[i]);
+      EXPECT_EQ(reinterpret_cast<void*>(i), sap->getUserData(proxies[i]));
+    }
+  }
+
+  std::vector<int32_t> actualProxies;
+  sap->queryAABB(query, actualProxies);
+  EXPECT_EQ(expectedProxies, std::set<int32_t>(actualProxies.begin(),
+                                               actualProxies.end()));
+}
+
+/***************************************************************************//**
+ * Compare the radius and nearest neighbour queries of the spatial grid against
+ * brute force, serially and on a pool, after moving the entities.
+ ******************************************************************************/
+TEST(SpatialGrid, Queries)
+{
+  const size_t kEntityCount = 2000;
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> pos(-40.0f, 40.0f);
+  std::uniform_real_distribution<float> height(0.0f, 1.0f);
+  Physics::SpatialGrid grid(4.0f);
+
+  /* Scatter the entities on a mostly flat map, then move them all. */
+  std::vector<Math::Vector4f> positions;
+  std::vector<int32_t> entities;
+  for(size_t i = 0; i < kEntityCount; i++)
+  {
+    positions.push_back(Math::Vector4f(pos(rng), height(rng), pos(rng), 1.0f));
+    entities.push_back(grid.insert(positions.back(),
+                                   reinterpret_cast<void*>(i)));
+  }
+
+  for(size_t i = 0; i < kEntityCount; i++)
+  {
+    positions[i] = Math::Vector4f(pos(rng), height(rng), pos(rng), 1.0f);
+    grid.move(entities[i], positions[i]);
+  }
+
+  /* Remove some entities and reuse their records. */
+  for(size_t i = 0; i < kEntityCount; i += 10)
+  {
+    grid.remove(entities[i]);
+    entities[i] = grid.insert(positions[i], reinterpret_cast<void*>(i));
+  }
+  ASSERT_EQ(kEntityCount, grid.size());
+
+  /* The query positions. */
+  std::vector<Math::Vector4f> queries;
+  for(size_t i = 0; i < 100; i++)
+  {
+    queries.push_back(Math::Vector4f(pos(rng), 0.5f, pos(rng), 1.0f));
+  }
+
+  /* Run the batches serially and on a pool. */
+  const float kRadius = 6.0f;
+  const size_t kNeighbourCount = 8;
+  Physics::TaskPool pool(4);
+  std::vector<std::vector<Physics::SpatialGrid::Neighbour>> radius, nearest,
+    parallelNearest;
+  grid.queryRadius(queries, kRadius, radius);
+  grid.queryNearest(queries, kNeighbourCount, 1000.0f, nearest);
+  grid.queryNearest(queries, kNeighbourCount, 1000.0f, parallelNearest, &pool);
+
+  for(size_t q = 0; q < queries.size(); q++)
+  {
+    /* Calculate the distances by brute force. */
+    std::vector<Physics::SpatialGrid::Neighbour> expected;
+    for(size_t i = 0; i < kEntityCount; i++)
+    {
+      Math::Vector4f d = positions[i] - queries[q];
+      expected.push_back(Physics::SpatialGrid::Neighbour{entities[i],
+                                                         d.dot(d)});
+    }
+    std::sort(expected.begin(), expected.end());
+
+    /* The radius query must find exactly the entities within the radius. */
+    std::set<int32_t> expectedInRadius, actualInRadius;
+    for(const Physics::SpatialGrid::Neighbour & n : expected)
+    {
+      if(n.fDistanceSq <= kRadius * kRadius)
+      {
+        expectedInRadius.insert(n.fEntity);
+      }
+    }
+    for(const Physics::SpatialGrid::Neighbour & n : radius[q])
+    {
+      actualInRadius.insert(n.fEntity);
+    }
+    EXPECT_EQ(expectedInRadius, actualInRadius);
+
+    /* The nearest query must find the k closest in order. */
+    ASSERT_EQ(kNeighbourCount, nearest[q].size());
+    ASSERT_EQ(kNeighbourCount, parallelNearest[q].size());
+    for(size_t i = 0; i < kNeighbourCount; i++)
+    {
+      EXPECT_EQ(expected[i].fEntity, nearest[q][i].fEntity);
+      EXPECT_EQ(expected[i].fEntity, parallelNearest[q][i].fEntity);
+    }
+  }
+}
+
+/***************************************************************************//**
+ * Test that compact() frees the cells that units left behind and that the
+ * grid keeps working afterwards.
+ ******************************************************************************/
+TEST(SpatialGrid, Compact)
+{
+  const size_t kEntityCount = 500;
+  std::mt19937 rng(13);
+  std::uniform_real_distribution<float> wide(-200.0f, 200.0f);
+  std::uniform_real_distribution<float> narrow(-4.0f, 4.0f);
+  Physics::SpatialGrid grid(2.0f);
+
+  /* Spread the entities over the map, then gather them in a few cells. */
+  std::vector<Math::Vector4f> positions;
+  std::vector<int32_t> entities;
+  for(size_t i = 0; i < kEntityCount; i++)
+  {
+    positions.push_back(Math::Vector4f(wide(rng), 0.0f, wide(rng), 1.0f));
+    entities.push_back(grid.insert(positions.back(),
+                                   reinterpret_cast<void*>(i)));
+  }
+  for(size_t i = 0; i < kEntityCount; i++)
+  {
+    positions[i] = Math::Vector4f(narrow(rng), 0.0f, narrow(rng), 1.0f);
+    grid.move(entities[i], positions[i]);
+  }
+
+  /* The empty cells are kept until the grid is compacted. */
+  size_t cellCount = grid.getCellCount();
+  grid.compact();
+  EXPECT_LT(grid.getCellCount(), cellCount);
+  EXPECT_LE(grid.getCellCount(), size_t(16));
+  ASSERT_EQ(kEntityCount, grid.size());
+
+  /* Keep moving, removing and inserting after the cells were packed. */
+  for(size_t i = 0; i < kEntityCount; i += 3)
+  {
+    positions[i] = Math::Vector4f(narrow(rng), 0.0f, narrow(rng) + 6.0f, 1.0f);
+    grid.move(entities[i], positions[i]);
+  }
+  grid.remove(entities[0]);
+  entities[0] = grid.insert(positions[0], nullptr);
+
+  /* The queries must still find every entity. */
+  for(size_t i = 0; i < kEntityCount; i += 25)
+  {
+    std::vector<Physics::SpatialGrid::Neighbour> nearest;
+    grid.queryNearest(positions[i], 1, 1000.0f, nearest);
+    ASSERT_EQ(size_t(1), nearest.size());
+    EXPECT_EQ(0.0f, nearest[0].fDistanceSq);
+  }
+
+  std::vector<Physics::SpatialGrid::Neighbour> all;
+  grid.queryRadius(Math::Vector4f(0.0f, 0.0f, 3.0f, 1.0f), 100.0f, all);
+  EXPECT_EQ(kEntityCount, all.size());
+
+  /* Removing every entity frees every cell. */
+  for(int32_t entity : entities)
+  {
+    grid.remove(entity);
+  }
+  grid.compact();
+  EXPECT_EQ(size_t(0), grid.getCellCount());
+  entities[0] = grid.insert(positions[0], nullptr);
+  EXPECT_EQ(size_t(1), grid.getCellCount());
+}
+
+/***************************************************************************//**
+ * Integrate projectiles, spinning and static bodies and compare against the
+ * closed form of semi-implicit Euler, then check that removal keeps the IDs
+ * valid and that the pool produces the same state as a serial update.
+ ******************************************************************************/
+TEST(RigidBodyWorld, Integrate)
+{
+  const float kStep = 1.0f / 120.0f;
+  const size_t kSteps = 120;
+  Physics::RigidBodyWorld world;
+
+  /* A projectile, a static body, a spinning body and a body with torque. */
+  Physics::RigidBodyWorld::BodyDesc desc;
+  desc.fLinearVelocity = Math::Vector4f(10.0f, 5.0f, 0.0f, 0.0f);
+  Physics::RigidBodyWorld::BodyID projectile = world.add(desc);
+
+  desc.fLinearVelocity = Math::Vector4f(1.0f, 0.0f, 0.0f, 0.0f);
+  desc.fMass = 0.0f;
+  desc.fPosition = Math::Vector4f(3.0f, 0.0f, 0.0f, 1.0f);
+  Physics::RigidBodyWorld::BodyID kinematic = world.add(desc);
+
+  desc = Physics::RigidBodyWorld::BodyDesc();
+  desc.fAngularVelocity = Math::Vector4f(0.0f, 0.0f, float(M_PI), 0.0f);
+  desc.fGravityScale = 0.0f;
+  Physics::RigidBodyWorld::BodyID spinning = world.add(desc);
+
+  desc = Physics::RigidBodyWorld::BodyDesc();
+  desc.fInertia = Math::Vector4f(2.0f, 2.0f, 2.0f, 0.0f);
+  desc.fGravityScale = 0.0f;
+  Physics::RigidBodyWorld::BodyID torqued = world.add(desc);
+
+  /* Apply the torque for a single step. */
+  ASSERT_EQ(size_t(4), world.size());
+  world.applyTorque(torqued, Math::Vector4f(0.0f, 0.0f, 4.0f, 0.0f));
+  world.applyForce(spinning, Math::Vector4f(0.0f, 2.0f, 0.0f, 0.0f));
+  world.integrate(kStep);
+  EXPECT_NEAR(2.0f * kStep, world.angularVelocity(torqued).z(), 1e-6f);
+  EXPECT_NEAR(2.0f * kStep, world.linearVelocity(spinning).y(), 1e-6f);
+  for(size_t i = 1; i < kSteps; i++)
+  {
+    world.integrate(kStep);
+  }
+
+  /* x(n) = x0 + v0 * t + g * dt^2 * n(n + 1) / 2 */
+  const float t = kStep * kSteps;
+  const float drop = -9.81f * kStep * kStep * kSteps * (kSteps + 1) * 0.5f;
+  Math::Vector4f position = world.position(projectile);
+  EXPECT_NEAR(10.0f * t, position.x(), 1e-3f);
+  EXPECT_NEAR(5.0f * t + drop, position.y(), 1e-3f);
+  EXPECT_NEAR(5.0f - 9.81f * t, world.linearVelocity(projectile).y(), 1e-3f);
+
+  /* Kinematic bodies move with their velocity but ignore gravity. */
+  EXPECT_NEAR(3.0f + t, world.position(kinematic).x(), 1e-3f);
+  EXPECT_EQ(0.0f, world.position(kinematic).y());
+
+  /* Half a turn about Z. */
+  Math::Quaternion rotation = world.orientation(spinning);
+  EXPECT_NEAR(1.0f, std::fabs(rotation.z()), 1e-3f);
+  EXPECT_NEAR(0.0f, rotation.w(), 1e-3f);
+
+  /* Removing a body keeps the other IDs valid. */
+  world.remove(kinematic);
+  ASSERT_EQ(size_t(3), world.size());
+  EXPECT_NEAR(10.0f * t, world.position(projectile).x(), 1e-3f);
+  EXPECT_NEAR(1.0f, std::fabs(world.orientation(spinning).z()), 1e-3f);
+  EXPECT_NEAR(2.0f * kStep, world.angularVelocity(torqued).z(), 1e-6f);
+
+  /* A large world integrated serially and on a pool. */
+  std::mt19937 rng(5);
+  std::uniform_real_distribution<float> value(-10.0f, 10.0f);
+  Physics::RigidBodyWorld serial, parallel;
+  std::vector<Physics::RigidBodyWorld::BodyID> ids;
+  for(size_t i = 0; i < 5003; i++)
+  {
+    desc.fPosition = Math::Vector4f(value(rng), value(rng), value(rng), 1.0f);
+    desc.fLinearVelocity = Math::Vector4f(value(rng), value(rng), value(rng),
+                                          0.0f);
+    desc.fAngularVelocity = Math::Vector4f(value(rng), value(rng), value(rng),
+                                           0.0f);
+    desc.fMass = std::fabs(value(rng));
+    ids.push_back(serial.add(desc));
+    parallel.add(desc);
+  }
+  for(size_t i = 0; i < ids.size(); i += 7)
+  {
+    serial.remove(ids[i]);
+    parallel.remove(ids[i]);
+  }
+
+  Physics::TaskPool pool(4);
+  for(size_t i = 0; i < 10; i++)
+  {
+    serial.integrate(kStep);
+    parallel.integrate(kStep, &pool);
+  }
+  for(size_t i = 1; i < ids.size(); i += 7)
+  {
+    Math::Vector4f a = serial.position(ids[i]);
+    Math::Vector4f b = parallel.position(ids[i]);
+    EXPECT_EQ(a.x(), b.x());
+    EXPECT_EQ(a.y(), b.y());
+    EXPECT_EQ(a.z(), b.z());
+    EXPECT_EQ(serial.orientation(ids[i]).w(),
+              parallel.orientation(ids[i]).w());
+  }
+}
+
+/***************************************************************************//**
+ * Step a world of unit spheres resting on the ground at y = 0, generating
+ * the contacts from the candidate pairs every step, and put the islands at
+ * rest to sleep if islands are supplied.
+ ******************************************************************************/
+inline void stepSpheres(Physics::RigidBodyWorld & world,
+  Physics::ContactSolver & solver,
+  const std::vector<Physics::RigidBodyWorld::BodyID> & bodies,
+  const std::vector<std::pair<size_t, size_t>> & pairs, float dt,
+  Physics::TaskPool * pool, Physics::Islands * islands = nullptr)
+{
+  const float kRadius = 0.5f;
+  world.integrateVelocities(dt);
+
+  /* The contacts with the ground and between the spheres. */
+  std::vector<Physics::ContactSolver::Constraint> constraints;
+  for(Physics::RigidBodyWorld::BodyID body : bodies)
+  {
+    Math::Vector4f position = world.position(body);
+    if(position.y() < kRadius)
+    {
+      Physics::Contact contact = {Math::Vector4f(position.x(), 0.0f,
+        position.z(), 1.0f), Math::Vector4f(0.0f, -1.0f, 0.0f, 0.0f),
+        kRadius - position.y()};
+      constraints.push_back({body, Physics::RigidBodyWorld::kNullBody,
+                             contact, 0.5f});
+    }
+  }
+  for(const std::pair<size_t, size_t> & pair : pairs)
+  {
+    Math::Vector4f a = world.position(bodies[pair.first]);
+    Math::Vector4f b = world.position(bodies[pair.second]);
+    Physics::Contact contact;
+    if(Physics::Narrowphase::collide(
+         Physics::BoundingSphere(a.x(), a.y(), a.z(), kRadius),
+         Physics::BoundingSphere(b.x(), b.y(), b.z(), kRadius), contact))
+    {
+      constraints.push_back({bodies[pair.first], bodies[pair.second],
+                             contact, 0.5f});
+    }
+  }
+
+  solver.solve(world, constraints.data(), constraints.size(), dt, pool);
+  world.integratePositions(dt);
+  if(islands)
+  {
+    islands->update(world, constraints.data(), constraints.size(), dt);
+  }
+}
+
+/***************************************************************************//**
+ * Settle a stack of spheres and a large pile, and check that the pile comes
+ * to the same state serially and on pools of different sizes.
+ ******************************************************************************/
+TEST(ContactSolver, Stacking)
+{
+  const float kStep = 1.0f / 120.0f;
+  typedef Physics::RigidBodyWorld::BodyID BodyID;
+
+  /* A vertical stack of five spheres. */
+  Physics::RigidBodyWorld world;
+  Physics::ContactSolver solver(10);
+  std::vector<BodyID> stack;
+  std::vector<std::pair<size_t, size_t>> stackPairs;
+  for(size_t i = 0; i < 5; i++)
+  {
+    Physics::RigidBodyWorld::BodyDesc desc;
+    desc.fPosition = Math::Vector4f(0.0f, 0.5f + float(i) * 0.99f, 0.0f, 1.0f);
+    desc.fInertia = Math::Vector4f(0.1f, 0.1f, 0.1f, 0.0f);
+    stack.push_back(world.add(desc));
+    if(i > 0)
+    {
+      stackPairs.push_back(std::make_pair(i - 1, i));
+    }
+  }
+
+  for(size_t step = 0; step < 240; step++)
+  {
+    stepSpheres(world, solver, stack, stackPairs, kStep, nullptr);
+  }
+  EXPECT_EQ(size_t(2), solver.colourCount());
+  for(size_t i = 0; i < stack.size(); i++)
+  {
+    Math::Vector4f position = world.position(stack[i]);
+    EXPECT_NEAR(0.5f + float(i), position.y(), 0.05f);
+    EXPECT_NEAR(0.0f, position.x(), 1e-4f);
+    EXPECT_NEAR(0.0f, world.linearVelocity(stack[i]).y(), 0.05f);
+  }
+
+  /* The ground carries the weight of the whole stack. */
+  EXPECT_NEAR(5.0f * 9.81f * kStep, solver.normalImpulse(0), 0.05f);
+
+  /* A pile of two layers, the second resting in the pockets of the first. */
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<float> jitter(-0.01f, 0.01f);
+  std::vector<Physics::RigidBodyWorld::BodyDesc> descs;
+  for(size_t layer = 0; layer < 2; layer++)
+  {
+    for(size_t x = 0; x < 24; x++)
+    {
+      for(size_t z = 0; z < 24; z++)
+      {
+        Physics::RigidBodyWorld::BodyDesc desc;
+        float offset = layer ? 0.49f : 0.0f;
+        desc.fPosition = Math::Vector4f(float(x) * 0.98f + offset +
+          jitter(rng), 0.5f + float(layer) * 0.75f, float(z) * 0.98f + offset,
+          1.0f);
+        desc.fInertia = Math::Vector4f(0.1f, 0.1f, 0.1f, 0.0f);
+        descs.push_back(desc);
+      }
+    }
+  }
+
+  /* The candidate pairs do not change while the pile settles. */
+  std::vector<std::pair<size_t, size_t>> pairs;
+  for(size_t i = 0; i < descs.size(); i++)
+  {
+    for(size_t j = i + 1; j < descs.size(); j++)
+    {
+      Math::Vector4f offset = descs[i].fPosition - descs[j].fPosition;
+      if(offset.dot(offset) < 1.5f * 1.5f)
+      {
+        pairs.push_back(std::make_pair(i, j));
+      }
+    }
+  }
+
+  /* Run the pile serially, on one worker and on four workers. */
+  Physics::TaskPool onePool(1), fourPool(4);
+  Physics::TaskPool * pools[3] = {nullptr, &onePool, &fourPool};
+  std::vector<Math::Vector4f> results[3];
+  for(size_t run = 0; run < 3; run++)
+  {
+    Physics::RigidBodyWorld pile;
+    Physics::ContactSolver pileSolver;
+    std::vector<BodyID> bodies;
+    for(const Physics::RigidBodyWorld::BodyDesc & desc : descs)
+    {
+      bodies.push_back(pile.add(desc));
+    }
+
+    for(size_t step = 0; step < 30; step++)
+    {
+      stepSpheres(pile, pileSolver, bodies, pairs, kStep, pools[run]);
+    }
+    EXPECT_GT(pileSolver.colourCount(), size_t(2));
+
+    for(BodyID body : bodies)
+    {
+      results[run].push_back(pile.position(body));
+    }
+  }
+
+  for(size_t i = 0; i < descs.size(); i++)
+  {
+    for(size_t run = 1; run < 3; run++)
+    {
+      EXPECT_EQ(results[0][i].x(), results[run][i].x());
+      EXPECT_EQ(results[0][i].y(), results[run][i].y());
+      EXPECT_EQ(results[0][i].z(), results[run][i].z());
+    }
+
+    /* Nothing sinks into the ground. */
+    EXPECT_GT(results[0][i].y(), 0.45f);
+  }
+}
+
+/***************************************************************************//**
+ * Let two stacks of spheres fall asleep, then wake one with an impulse and
+ * the other with a falling sphere.
+ ******************************************************************************/
+TEST(Islands, Sleeping)
+{
+  const float kStep = 1.0f / 120.0f;
+  typedef Physics::RigidBodyWorld::BodyID BodyID;
+
+  /* Two stacks of three spheres, far enough apart to be two islands. */
+  Physics::RigidBodyWorld world;
+  Physics::ContactSolver solver(10);
+  Physics::Islands islands;
+  std::vector<BodyID> bodies;
+  std::vector<std::pair<size_t, size_t>> pairs;
+  for(size_t stack = 0; stack < 2; stack++)
+  {
+    for(size_t i = 0; i < 3; i++)
+    {
+      Physics::RigidBodyWorld::BodyDesc desc;
+      desc.fPosition = Math::Vector4f(float(stack) * 5.0f,
+                                      0.5f + float(i) * 0.99f, 0.0f, 1.0f);
+      desc.fInertia = Math::Vector4f(0.1f, 0.1f, 0.1f, 0.0f);
+      bodies.push_back(world.add(desc));
+      if(i > 0)
+      {
+        pairs.push_back(std::make_pair(bodies.size() - 2, bodies.size() - 1));
+      }
+    }
+  }
+
+  /* Both stacks come to rest and sleep. */
+  for(size_t step = 0; step < 360 && world.awakeCount() > 0; step++)
+  {
+    stepSpheres(world, solver, bodies, pairs, kStep, nullptr, &islands);
+  }
+  ASSERT_EQ(size_t(0), world.awakeCount());
+  EXPECT_EQ(size_t(2), islands.islandCount());
+
+  /* Sleeping bodies do not move at all. */
+  std::vector<Math::Vector4f> rest;
+  for(BodyID body : bodies)
+  {
+    rest.push_back(world.position(body));
+    EXPECT_NEAR(0.0f, world.linearVelocity(body).y(), 0.0f);
+  }
+  for(size_t step = 0; step < 10; step++)
+  {
+    stepSpheres(world, solver, bodies, pairs, kStep, nullptr, &islands);
+  }
+  for(size_t i = 0; i < bodies.size(); i++)
+  {
+    EXPECT_EQ(rest[i].y(), world.position(bodies[i]).y());
+  }
+  EXPECT_EQ(0.0f, solver.normalImpulse(0));
+
+  /* An impulse on the top of the first stack wakes the whole stack. */
+  world.setLinearVelocity(bodies[2], Math::Vector4f(0.0f, 1.0f, 0.0f, 0.0f));
+  EXPECT_EQ(size_t(3), world.awakeCount());
+  for(size_t i = 0; i < bodies.size(); i++)
+  {
+    EXPECT_EQ(i < 3, world.isAwake(bodies[i]));
+    EXPECT_EQ(rest[i].y(), world.position(bodies[i]).y());
+  }
+
+  /* A sphere dropped on the second stack wakes it on contact. */
+  Physics::RigidBodyWorld::BodyDesc desc;
+  desc.fPosition = Math::Vector4f(5.0f, 4.0f, 0.0f, 1.0f);
+  desc.fInertia = Math::Vector4f(0.1f, 0.1f, 0.1f, 0.0f);
+  bodies.push_back(world.add(desc));
+  pairs.push_back(std::make_pair(size_t(5), bodies.size() - 1));
+  bool woken = false;
+  for(size_t step = 0; step < 120 && !woken; step++)
+  {
+    stepSpheres(world, solver, bodies, pairs, kStep, nullptr, &islands);
+    woken = world.isAwake(bodies[3]);
+  }
+  EXPECT_TRUE(woken);
+  EXPECT_TRUE(world.isAwake(bodies[4]));
+  EXPECT_TRUE(world.isAwake(bodies[5]));
+
+  /* Everything goes back to sleep, with the new sphere on top. */
+  for(size_t step = 0; step < 600 && world.awakeCount() > 0; step++)
+  {
+    stepSpheres(world, solver, bodies, pairs, kStep, nullptr, &islands);
+  }
+  EXPECT_EQ(size_t(0), world.awakeCount());
+  EXPECT_NEAR(3.5f, world.position(bodies[6]).y(), 0.05f);
+
+  /* Removing a sleeping body wakes the rest of it's island. */
+  world.remove(bodies[6]);
+  EXPECT_EQ(size_t(3), world.awakeCount());
+  EXPECT_TRUE(world.isAwake(bodies[3]));
+  EXPECT_FALSE(world.isAwake(bodies[0]));
+  EXPECT_NEAR(2.48f, world.position(bodies[5]).y(), 0.05f);
+}
+
+/***************************************************************************//**
+ * Run a pile of spheres with the solver and sleeping and compare the state
+ * against a checksum recorded from another build. The checksum must not
+ * change between the scalar and SSE builds, optimisation levels or thread
+ * counts, and with ANUBIS_DETERMINISTIC not between compilers either. Builds
+ * for CPUs with fused multiply-add only match with ANUBIS_DETERMINISTIC. A
+ * change to the physics step that changes the results must update it.
+ ******************************************************************************/
+TEST(Determinism, Checksum)
+{
+  const float kStep = 1.0f / 60.0f;
+  typedef Physics::RigidBodyWorld::BodyID BodyID;
+
+  /* Two layers of spheres with a little jitter, from a fixed generator so
+   * the initial state does not depend on the standard library. */
+  uint32_t seed = 12345;
+  auto jitter = [&seed]()
+  {
+    seed = seed * 1664525u + 1013904223u;
+    return float(seed >> 8) / float(1 << 24) * 0.02f - 0.01f;
+  };
+  std::vector<Physics::RigidBodyWorld::BodyDesc> descs;
+  for(size_t layer = 0; layer < 2; layer++)
+  {
+    for(size_t x = 0; x < 6; x++)
+    {
+      for(size_t z = 0; z < 6; z++)
+      {
+        Physics::RigidBodyWorld::BodyDesc desc;
+        float offset = layer ? 0.49f : 0.0f;
+        desc.fPosition = Math::Vector4f(float(x) * 0.98f + offset + jitter(),
+          0.6f + float(layer) * 0.8f, float(z) * 0.98f + offset + jitter(),
+          1.0f);
+        desc.fInertia = Math::Vector4f(0.1f, 0.1f, 0.1f, 0.0f);
+        desc.fAngularVelocity = Math::Vector4f(jitter(), jitter(), jitter(),
+                                               0.0f);
+        descs.push_back(desc);
+      }
+    }
+  }
+  std::vector<std::pair<size_t, size_t>> pairs;
+  for(size_t i = 0; i < descs.size(); i++)
+  {
+    for(size_t j = i + 1; j < descs.size(); j++)
+    {
+      Math::Vector4f offset = descs[i].fPosition - descs[j].fPosition;
+      if(offset.dot(offset) < 1.5f * 1.5f)
+      {
+        pairs.push_back(std::make_pair(i, j));
+      }
+    }
+  }
+
+  /* The same run serially and on a pool. */
+  Physics::TaskPool pool(3);
+  Physics::TaskPool * pools[2] = {nullptr, &pool};
+  uint64_t checksums[2];
+  for(size_t run = 0; run < 2; run++)
+  {
+    Physics::RigidBodyWorld world;
+    Physics::ContactSolver solver;
+    Physics::Islands islands;
+    std::vector<BodyID> bodies;
+    for(const Physics::RigidBodyWorld::BodyDesc & desc : descs)
+    {
+      bodies.push_back(world.add(desc));
+    }
+    for(size_t step = 0; step < 240; step++)
+    {
+      stepSpheres(world, solver, bodies, pairs, kStep, pools[run], &islands);
+    }
+    checksums[run] = world.checksum();
+  }
+  EXPECT_EQ(checksums[0], checksums[1]);
+  #if defined(ANUBIS_DETERMINISTIC) || !defined(__FMA__)
+    const uint64_t kChecksum = 0x7155D99724E78087ULL;
+    EXPECT_EQ(kChecksum, checksums[0]) << std::hex << checksums[0];
+  #endif /* ANUBIS_DETERMINISTIC || !__FMA__ */
+}
+
+/***************************************************************************//**
+ * Compare the sweeps of spheres against boxes and a mesh with the first
+ * overlap found by sampling the motion.
+ ******************************************************************************/
+TEST(Narrowphase, Sweeps)
+{
+  const size_t kSamples = 1000;
+  uint32_t seed = 777;
+  auto random = [&seed](float low, float high)
+  {
+    seed = seed * 1664525u + 1013904223u;
+    return low + float(seed >> 8) / float(1 << 24) * (high - low);
+  };
+
+  /* A bumpy 4 x 4 grid of quads. */
+  std::vector<Math::Vector4f> vertices;
+  std::vector<uint32_t> indices;
+  for(uint32_t z = 0; z < 5; z++)
+  {
+    for(uint32_t x = 0; x < 5; x++)
+    {
+      vertices.push_back(Math::Vector4f::makePosition(float(x) - 2.0f,
+        random(-0.5f, 0.5f), float(z) - 2.0f));
+      if(x > 0 && z > 0)
+      {
+        uint32_t i = z * 5 + x;
+        indices.insert(indices.end(), {i - 6, i - 1, i, i - 6, i, i - 5});
+      }
+    }
+  }
+  Physics::BoundingMesh mesh(vertices, indices);
+  const Physics::BoundingBox box(-1.0f, 1.0f, -0.5f, 0.5f, -0.25f, 0.25f);
+
+  size_t hits = 0;
+  for(size_t test = 0; test < 400; test++)
+  {
+    /* Start outside the volumes and move through or past them. */
+    Math::Vector4f start(random(-3.0f, 3.0f), random(1.2f, 3.0f),
+                         random(-3.0f, 3.0f), 1.0f);
+    Math::Vector4f end(random(-3.0f, 3.0f), random(-3.0f, 0.0f),
+                       random(-3.0f, 3.0f), 1.0f);
+    Math::Vector4f motion = end - start;
+    const float radius = random(0.05f, 0.5f);
+    const Physics::BoundingSphere sphere(start.x(), start.y(), start.z(),
+                                         radius);
+
+    for(bool testBox : {true, false})
+    {
+      float toi;
+      Physics::Contact contact;
+      bool hit = testBox ?
+        Physics::Narrowphase::sweep(sphere, motion, box, toi, contact) :
+        Physics::Narrowphase::sweep(sphere, motion, mesh, toi, contact);
+
+      /* The first sample that overlaps. */
+      size_t first = kSamples + 1;
+      for(size_t i = 0; i <= kSamples && first > kSamples; i++)
+      {
+        Math::Vector4f centre = start + motion * (float(i) / kSamples);
+        Physics::BoundingSphere moved(centre.x(), centre.y(), centre.z(),
+                                      radius);
+        Physics::Contact contacts[8];
+        if(testBox ? Physics::Narrowphase::collide(box, moved, contacts[0]) :
+           Physics::Narrowphase::collide(moved, mesh, contacts, 8) > 0)
+        {
+          first = i;
+        }
+      }
+
+      /* A sweep that grazes the volume between two samples may hit without
+       * a sample that overlaps. */
+      if(first <= kSamples)
+      {
+        ASSERT_TRUE(hit);
+        EXPECT_LE(toi, float(first) / kSamples + 1e-4f);
+        EXPECT_GE(toi, float(first - 1) / kSamples - 1e-4f);
+      }
+      if(hit)
+      {
+        hits++;
+        Math::Vector4f centre = start + motion * toi;
+        Math::Vector4f offset = contact.fPoint - centre;
+        EXPECT_NEAR(radius, offset.length(), 1e-3f);
+        EXPECT_NEAR(1.0f, contact.fNormal.length(), 1e-4f);
+        EXPECT_GT(0.0f, -contact.fNormal.dot(motion));
+      }
+    }
+  }
+  EXPECT_LT(200u, hits);
+
+  /* Spheres that already overlap hit at once, spheres that move away from
+   * the volumes do not hit. */
+  float toi;
+  Physics::Contact contact;
+  EXPECT_TRUE(Physics::Narrowphase::sweep(Physics::BoundingSphere(0.0f, 0.0f,
+    0.0f, 0.1f), Math::Vector4f(0.0f, 1.0f, 0.0f), box, toi, contact));
+  EXPECT_EQ(0.0f, toi);
+  EXPECT_FALSE(Physics::Narrowphase::sweep(Physics::BoundingSphere(0.0f, 1.0f,
+    0.0f, 0.1f), Math::Vector4f(0.0f, 1.0f, 0.0f), box, toi, contact));
+  EXPECT_FALSE(Physics::Narrowphase::sweep(Physics::BoundingSphere(0.0f, 1.0f,
+    0.0f, 0.1f), Math::Vector4f(0.0f, 1.0f, 0.0f), mesh, toi, contact));
+}
+
+/***************************************************************************//**
+ * Fire a bullet at thin walls at 120 Hz, it passes through them without
+ * continuous collision and stops at them in both modes.
+ ******************************************************************************/
+TEST(ContinuousCollision, Bullets)
+{
+  const float kStep = 1.0f / 120.0f;
+  const float kRadius = 0.05f;
+  typedef Physics::ContinuousCollision::Mode Mode;
+
+  /* A 2 cm thick box wall at x = 0 and a mesh wall at x = 0. */
+  Physics::BoundingBox box(0.0f, 0.02f, -1.0f, 1.0f, -1.0f, 1.0f);
+  Physics::BoundingMesh mesh({Math::Vector4f::makePosition(0.0f, -1.0f, -1.0f),
+                              Math::Vector4f::makePosition(0.0f, 1.0f, -1.0f),
+                              Math::Vector4f::makePosition(0.0f, 1.0f, 1.0f),
+                              Math::Vector4f::makePosition(0.0f, -1.0f, 1.0f)},
+                             {0, 1, 2, 0, 2, 3});
+
+  for(size_t run = 0; run < 5; run++)
+  {
+    Physics::RigidBodyWorld world;
+    world.setGravity(Math::Vector4f(0.0f, 0.0f, 0.0f, 0.0f));
+    Physics::RigidBodyWorld::BodyDesc desc;
+    desc.fPosition = Math::Vector4f(-1.0f, 0.0f, 0.2f, 1.0f);
+    desc.fLinearVelocity = Math::Vector4f(300.0f, 0.0f, 0.0f, 0.0f);
+    desc.fInertia = Math::Vector4f(1.0f, 1.0f, 1.0f, 0.0f);
+    Physics::RigidBodyWorld::BodyID bullet = world.add(desc);
+    desc.fPosition = Math::Vector4f(-1.0f, 0.5f, 0.0f, 1.0f);
+    desc.fLinearVelocity = Math::Vector4f(1.0f, 0.0f, 0.0f, 0.0f);
+    Physics::RigidBodyWorld::BodyID slow = world.add(desc);
+
+    /* Without continuous collision, then both modes against both walls. */
+    Physics::ContactSolver solver;
+    Physics::ContinuousCollision ccd(run < 3 ? Mode::TimeOfImpact :
+                                               Mode::Speculative);
+    if(run > 0)
+    {
+      ccd.addBody(bullet, kRadius);
+      ccd.addBody(slow, kRadius);
+      if(run % 2)
+      {
+        ccd.addStatic(box);
+      }
+      else
+      {
+        ccd.addStatic(mesh);
+      }
+    }
+
+    for(size_t step = 0; step < 10; step++)
+    {
+      std::vector<Physics::ContactSolver::Constraint> constraints;
+      world.integrateVelocities(kStep);
+      ccd.beginStep(world, kStep, constraints);
+      if(step == 0)
+      {
+        EXPECT_EQ(run > 0 ? 1u : 0u, ccd.fastBodyCount());
+      }
+      solver.solve(world, constraints.data(), constraints.size(), kStep);
+      world.integratePositions(kStep);
+      ccd.endStep(world);
+    }
+
+    Math::Vector4f position = world.position(bullet);
+    if(run == 0)
+    {
+      EXPECT_LT(10.0f, position.x());
+    }
+    else
+    {
+      EXPECT_NEAR(-kRadius, position.x(), 1e-3f);
+      EXPECT_NEAR(0.0f, world.linearVelocity(bullet).x(), 1e-2f);
+      EXPECT_NEAR(0.2f, position.z(), 1e-3f);
+    }
+    EXPECT_NEAR(-1.0f + 10.0f * kStep, world.position(slow).x(), 1e-4f);
+  }
+}
+
+/***************************************************************************//**
+ * Compare batches of queries, serially and on a pool, against the single
+ * queries.
+ ******************************************************************************/
+TEST(BatchQuery, Queries)
+{
+  uint32_t seed = 4242;
+  auto random = [&seed](float low, float high)
+  {
+    seed = seed * 1664525u + 1013904223u;
+    return low + float(seed >> 8) / float(1 << 24) * (high - low);
+  };
+
+  /* A bumpy 16 x 16 terrain. */
+  std::vector<Math::Vector4f> vertices;
+  std::vector<uint32_t> indices;
+  for(uint32_t z = 0; z < 17; z++)
+  {
+    for(uint32_t x = 0; x < 17; x++)
+    {
+      vertices.push_back(Math::Vector4f::makePosition(float(x) - 8.0f,
+        random(-1.0f, 1.0f), float(z) - 8.0f));
+      if(x > 0 && z > 0)
+      {
+        uint32_t i = z * 17 + x;
+        indices.insert(indices.end(), {i - 18, i - 1, i, i - 18, i, i - 17});
+      }
+    }
+  }
+  Physics::BoundingMesh mesh(vertices, indices);
+
+  /* Rays from a few origins to random targets, an odd count so the last
+   * packet is partial. */
+  const size_t kCount = 301;
+  std::vector<Math::Ray> rays;
+  std::vector<float> maxT;
+  std::vector<Physics::BoundingSphere> spheres;
+  std::vector<Math::Vector4f> motions;
+  for(size_t i = 0; i < kCount; i++)
+  {
+    Math::Vector4f origin(float(i / 16) - 8.0f, 2.0f, 0.0f, 1.0f);
+    Math::Vector4f target(random(-8.0f, 8.0f), random(-1.5f, 1.5f),
+                          random(-8.0f, 8.0f), 1.0f);
+    Math::Vector4f direction = target - origin;
+    const float length = direction.length();
+    rays.push_back(Math::Ray(origin, direction * (1.0f / length)));
+    maxT.push_back(length);
+    spheres.push_back(Physics::BoundingSphere(origin.x(), origin.y(),
+                                              origin.z(), random(0.1f, 1.0f)));
+    motions.push_back(direction);
+  }
+
+  Physics::TaskPool pool(3);
+  for(Physics::TaskPool * tested : {static_cast<Physics::TaskPool*>(nullptr),
+                                    &pool})
+  {
+    std::vector<Physics::BatchQuery::RayHit> hits(kCount);
+    std::vector<uint8_t> blocked(kCount), overlaps(kCount);
+    std::vector<Physics::BatchQuery::SweepHit> sweeps(kCount);
+    Physics::BatchQuery::raycast(mesh, rays.data(), maxT.data(), kCount,
+                                 hits.data(), tested);
+    Physics::BatchQuery::occluded(mesh, rays.data(), maxT.data(), kCount,
+                                  blocked.data(), tested);
+    Physics::BatchQuery::sweep(mesh, spheres.data(), motions.data(), kCount,
+                               sweeps.data(), tested);
+    Physics::BatchQuery::overlap(mesh, spheres.data(), kCount,
+                                 overlaps.data(), tested);
+
+    size_t blockedCount = 0;
+    for(size_t i = 0; i < kCount; i++)
+    {
+      float distance;
+      size_t triangle;
+      bool hit = mesh.raycast(rays[i], maxT[i], distance, triangle);
+      ASSERT_EQ(hit, hits[i].fTriangle != Physics::BoundingMesh::kNoTriangle);
+      EXPECT_EQ(hit, blocked[i] == 1);
+      blockedCount += blocked[i];
+      if(hit)
+      {
+        EXPECT_EQ(distance, hits[i].fDistance);
+        EXPECT_EQ(triangle, size_t(hits[i].fTriangle));
+      }
+      else
+      {
+        EXPECT_EQ(maxT[i], hits[i].fDistance);
+      }
+
+      float toi;
+      Physics::Contact contact;
+      ASSERT_EQ(Physics::Narrowphase::sweep(spheres[i], motions[i], mesh, toi,
+                                            contact), sweeps[i].fHit);
+      EXPECT_EQ(sweeps[i].fHit ? toi : 1.0f, sweeps[i].fTime);
+      EXPECT_EQ(mesh.overlaps(spheres[i].centre(), spheres[i].radius()),
+                overlaps[i] == 1);
+    }
+    EXPECT_LT(0u, blockedCount);
+    EXPECT_GT(kCount, blockedCount);
+  }
+
+  /* Boxes against a tree and positions against a grid. */
+  Physics::AABBTree tree;
+  Physics::SpatialGrid grid(2.0f);
+  for(size_t i = 0; i < 500; i++)
+  {
+    Math::Vector4f centre(random(-20.0f, 20.0f), random(-20.0f, 20.0f),
+                          random(-20.0f, 20.0f), 1.0f);
+    Math::Vector4f extent(0.5f, 0.5f, 0.5f, 0.0f);
+    tree.insert(Physics::AABB(centre - extent, centre + extent), nullptr);
+    grid.insert(centre, nullptr);
+  }
+  const size_t kCapacity = 4, kNearest = 5;
+  std::vector<Physics::AABB> boxes;
+  std::vector<Math::Vector4f> positions;
+  for(size_t i = 0; i < 200; i++)
+  {
+    Math::Vector4f centre(random(-20.0f, 20.0f), random(-20.0f, 20.0f),
+                          random(-20.0f, 20.0f), 1.0f);
+    Math::Vector4f extent(3.0f, 3.0f, 3.0f, 0.0f);
+    boxes.push_back(Physics::AABB(centre - extent, centre + extent));
+    positions.push_back(centre);
+  }
+  std::vector<int32_t> proxies(boxes.size() * kCapacity);
+  std::vector<Physics::SpatialGrid::Neighbour> neighbours(positions.size() *
+                                                          kNearest);
+  std::vector<uint32_t> found(boxes.size()), foundNearest(positions.size());
+  Physics::BatchQuery::overlap(tree, boxes.data(), boxes.size(), kCapacity,
+                               proxies.data(), found.data(), &pool);
+  Physics::BatchQuery::nearest(grid, positions.data(), positions.size(),
+                               kNearest, 10.0f, neighbours.data(),
+                               foundNearest.data(), &pool);
+  for(size_t i = 0; i < boxes.size(); i++)
+  {
+    std::vector<int32_t> expected;
+    tree.queryAABB(boxes[i], expected);
+    ASSERT_EQ(expected.size(), size_t(found[i]));
+    std::vector<int32_t> stored(proxies.begin() + i * kCapacity,
+      proxies.begin() + i * kCapacity + std::min(expected.size(), kCapacity));
+    for(int32_t proxy : stored)
+    {
+      EXPECT_NE(expected.end(),
+                std::find(expected.begin(), expected.end(), proxy));
+    }
+
+    std::vector<Physics::SpatialGrid::Neighbour> closest;
+    grid.queryNearest(positions[i], kNearest, 10.0f, closest);
+    ASSERT_EQ(closest.size(), size_t(foundNearest[i]));
+    for(size_t j = 0; j < closest.size(); j++)
+    {
+      EXPECT_EQ(closest[j].fEntity, neighbours[i * kNearest + j].fEntity);
+    }
+  }
+}
+
+/***************************************************************************//**
+ * Move clients and entities at random and confirm that the relevancy sets
+ * hold every entity in range, that the events rebuild the sets exactly and
+ * that the update rates follow the distance and priority.
+ ******************************************************************************/
+TEST(InterestManager, Relevancy)
+{
+  const float kRadius = 10.0f;
+  const float kMargin = 0.1f;
+  Physics::InterestManager basic(kRadius, kMargin, 8);
+  typedef Physics::InterestManager::Event Event;
+
+  /* The border of the area doesn't make entities flicker. */
+  int32_t client = basic.addClient(Math::Vector4f(0, 0, 0, 1), kRadius);
+  int32_t near = basic.addEntity(Math::Vector4f(5, 0, 0, 1));
+  int32_t border = basic.addEntity(Math::Vector4f(10.5f, 0, 0, 1));
+  basic.update();
+  ASSERT_EQ(1u, basic.getEvents().size());
+  EXPECT_EQ(Event::Types::Enter, basic.getEvents()[0].fType);
+  EXPECT_EQ(near, basic.getEvents()[0].fEntity);
+  EXPECT_FALSE(basic.isRelevant(client, border));
+  basic.moveEntity(near, Math::Vector4f(10.5f, 0, 0, 1));
+  basic.update();
+  EXPECT_TRUE(basic.getEvents().empty());
+  basic.moveEntity(near, Math::Vector4f(11.5f, 0, 0, 1));
+  basic.update();
+  ASSERT_EQ(1u, basic.getEvents().size());
+  EXPECT_EQ(Event::Types::Leave, basic.getEvents()[0].fType);
+
+  /* A removed entity leaves before a new one with it's handle enters. */
+  basic.moveEntity(near, Math::Vector4f(1, 0, 0, 1));
+  basic.update();
+  basic.removeEntity(near);
+  EXPECT_EQ(near, basic.addEntity(Math::Vector4f(2, 0, 0, 1)));
+  basic.update();
+  ASSERT_EQ(2u, basic.getEvents().size());
+  EXPECT_EQ(Event::Types::Leave, basic.getEvents()[0].fType);
+  EXPECT_EQ(Event::Types::Enter, basic.getEvents()[1].fType);
+  EXPECT_EQ(near, basic.getEvents()[1].fEntity);
+
+  /* Close entities are sent every tick, distant ones at the slowest rate
+   * unless their priority is high. */
+  basic.removeEntity(near);
+  basic.removeEntity(border);
+  int32_t close = basic.addEntity(Math::Vector4f(0, 0, 0, 1));
+  int32_t far = basic.addEntity(Math::Vector4f(9.5f, 0, 0, 1));
+  int32_t important = basic.addEntity(Math::Vector4f(0, 9.0f, 0, 1), 20.0f);
+  basic.update();
+  std::map<int32_t, int> sent;
+  for(int tick = 0; tick < 80; tick++)
+  {
+    basic.update();
+    for(int32_t entity : basic.getDue(client))
+    {
+      ++sent[entity];
+    }
+  }
+  EXPECT_EQ(80, sent[close]);
+  EXPECT_EQ(10, sent[far]);
+  EXPECT_EQ(80, sent[important]);
+
+  /* A removed client's record is reused. */
+  basic.removeClient(client);
+  EXPECT_EQ(client, basic.addClient(Math::Vector4f(50, 0, 0, 1), kRadius));
+  basic.update();
+  EXPECT_TRUE(basic.getEvents().empty());
+
+  /* Random walks of clients and entities in a 100m square, updated serially
+   * and on a pool. */
+  Physics::InterestManager serial(kRadius, kMargin, 8);
+  Physics::InterestManager parallel(kRadius, kMargin, 8);
+  Physics::TaskPool pool(4);
+  uint32_t seed = 4242;
+  auto random = [&seed](float low, float high)
+  {
+    seed = seed * 1664525u + 1013904223u;
+    return low + float(seed >> 8) / float(1 << 24) * (high - low);
+  };
+  const size_t kClients = 40, kEntities = 2000;
+  std::vector<Math::Vector4f> clients, entities;
+  std::vector<int32_t> clientHandles, entityHandles;
+  for(size_t i = 0; i < kClients; i++)
+  {
+    clients.push_back(Math::Vector4f(random(0, 100), 0, random(0, 100), 1));
+    clientHandles.push_back(serial.addClient(clients[i], kRadius));
+    parallel.addClient(clients[i], kRadius);
+  }
+  for(size_t i = 0; i < kEntities; i++)
+  {
+    entities.push_back(Math::Vector4f(random(0, 100), 0, random(0, 100), 1));
+    const float priority = random(0.5f, 2.0f);
+    entityHandles.push_back(serial.addEntity(entities[i], priority));
+    parallel.addEntity(entities[i], priority);
+  }
+
+  std::vector<std::set<int32_t>> mirrors(kClients);
+  for(int tick = 0; tick < 30; tick++)
+  {
+    for(size_t i = 0; i < kEntities; i++)
+    {
+      entities[i] += Math::Vector4f(random(-1, 1), 0, random(-1, 1), 0);
+      serial.moveEntity(entityHandles[i], entities[i]);
+      parallel.moveEntity(entityHandles[i], entities[i]);
+    }
+    for(size_t i = 0; i < kClients; i++)
+    {
+      clients[i] += Math::Vector4f(random(-2, 2), 0, random(-2, 2), 0);
+      serial.moveClient(clientHandles[i], clients[i]);
+      parallel.moveClient(clientHandles[i], clients[i]);
+    }
+    serial.update();
+    parallel.update(&pool);
+
+    /* Both updates report the same events in the same order. */
+    const std::vector<Event> & events = serial.getEvents();
+    ASSERT_EQ(events.size(), parallel.getEvents().size());
+    for(size_t i = 0; i < events.size(); i++)
+    {
+      EXPECT_EQ(events[i].fType, parallel.getEvents()[i].fType);
+      EXPECT_EQ(events[i].fClient, parallel.getEvents()[i].fClient);
+      EXPECT_EQ(events[i].fEntity, parallel.getEvents()[i].fEntity);
+      if(events[i].fType == Event::Types::Enter)
+      {
+        EXPECT_TRUE(mirrors[events[i].fClient].insert(events[i].fEntity)
+                    .second);
+      }
+      else
+      {
+        EXPECT_EQ(1u, mirrors[events[i].fClient].erase(events[i].fEntity));
+      }
+    }
+
+    /* Every entity in range is relevant and none past the margin is. */
+    for(size_t c = 0; c < kClients; c++)
+    {
+      ASSERT_EQ(mirrors[c].size(), serial.getRelevantCount(clientHandles[c]));
+      for(size_t i = 0; i < kEntities; i++)
+      {
+        Math::Vector4f offset = entities[i] - clients[c];
+        const float distance = std::sqrt(offset.dot(offset));
+        const bool relevant = serial.isRelevant(clientHandles[c],
+                                                entityHandles[i]);
+        EXPECT_EQ(relevant, mirrors[c].count(entityHandles[i]) == 1);
+        if(distance <= kRadius * 0.999f)
+        {
+          EXPECT_TRUE(relevant);
+        }
+        else if(distance > kRadius * (1.0f + kMargin) * 1.001f)
+        {
+          EXPECT_FALSE(relevant);
+        }
+      }
+    }
+  }
+}
+
 #endif /* ANUBIS_UNIT_TEST_PHYSICS_TEST_HPP */
@@ -213,4 +213,46 @@ TEST(Vector4f, DotProduct)
                 Vector4f(4.0f, 5.0f, 6.0f, 1.0f)));
 }
 
+/***************************************************************************//**
+ * Test that min and max return the rhs component for equal components, as the
+ * SSE instructions do, so zeros keep the same sign in every build.
+ ******************************************************************************/
+TEST(Vector4f, MinMax)
+{
+  Vector4f a(1.0f, -2.0f, -0.0f, 0.0f);
+  Vector4f b(-1.0f, 2.0f, 0.0f, -0.0f);
+  Vector4f low = Vector4f::min(a, b);
+  Vector4f high = Vector4f::max(a, b);
+
+  EXPECT_EQ(-1.0f, low.x());
+  EXPECT_EQ(-2.0f, low.y());
+  EXPECT_FALSE(std::signbit(low.z()));
+  EXPECT_TRUE(std::signbit(low.w()));
+  EXPECT_EQ(1.0f, high.x());
+  EXPECT_EQ(2.0f, high.y());
+  EXPECT_FALSE(std::signbit(high.z()));
+  EXPECT_TRUE(std::signbit(high.w()));
+}
+
+/***************************************************************************//**
+ * Test that the SSE code paths are compiled exactly when the engine is built
+ * for SSE4.1.
+ ******************************************************************************/
+TEST(Vector4f, SIMD)
+{
+#if ANUBIS_SIMD == ANUBIS_SIMD_SSE4
+  #ifdef ANUBIS_HAS_SSE
+    SUCCEED();
+  #else
+    FAIL() << "Built for SSE4.1 without the SSE code paths.";
+  #endif
+#else
+  #ifdef ANUBIS_HAS_SSE
+    FAIL() << "Built without SSE4.1 but with the SSE code paths.";
+  #else
+    SUCCEED();
+  #endif
+#endif
+}
+
 #endif /* ANUBIS_UNIT_TESTS_VECTOR4F_TESTS_HPP */
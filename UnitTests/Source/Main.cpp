@@ -1,6 +1,7 @@
 #include "../Include/FloatTests.hpp"
 #include "../Include/Vector4fTests.hpp"
 #include "../Include/Matrix4fTests.hpp"
+#include "../Include/NetworkingTests.hpp"
 #include "../Include/PhysicsTests.hpp"
 
 int main(int argc, char * argv[])